@@ -907,6 +907,12 @@ __SYSCALL(__NR_process_mrelease, sys_process_mrelease)
 __SYSCALL(__NR_futex_waitv, sys_futex_waitv)
 #define __NR_set_mempolicy_home_node 450
 __SYSCALL(__NR_set_mempolicy_home_node, sys_set_mempolicy_home_node)
+#define __NR_futex_wake 451
+__SYSCALL(__NR_futex_wake, sys_futex_wake)
+#define __NR_futex_wait 452
+__SYSCALL(__NR_futex_wait, sys_futex_wait)
+#define __NR_futex_requeue 453
+__SYSCALL(__NR_futex_requeue, sys_futex_requeue)
 
 /*
  * Please add new compat syscalls above this comment and update
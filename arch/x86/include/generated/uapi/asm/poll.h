@@ -0,0 +1 @@
+#include <asm-generic/poll.h>
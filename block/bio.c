@@ -1233,6 +1233,30 @@ static int bio_iov_add_zone_append_page(struct bio *bio, struct page *page,
 
 #define PAGE_PTRS_PER_BVEC     (sizeof(struct bio_vec) / sizeof(struct page *))
 
+/*
+ * Pages pinned from a large folio, e.g. of a hugetlb backed buffer, usually
+ * come in runs of consecutive pages. Count in @nr how many of the @nr_pages
+ * @pages continue the folio of the first one, and return how much of @left
+ * bytes they cover from @offset in the first page on. A page COWed in the
+ * middle of the folio ends the run.
+ */
+static size_t bio_iov_folio_run(struct page **pages, unsigned int nr_pages,
+		size_t offset, size_t left, unsigned int *nr)
+{
+	struct folio *folio = page_folio(pages[0]);
+	size_t len = min_t(size_t, PAGE_SIZE - offset, left);
+	unsigned int j;
+
+	for (j = 1; j < nr_pages && len < left; j++) {
+		if (pages[j] != nth_page(pages[0], j) ||
+		    page_folio(pages[j]) != folio)
+			break;
+		len += min_t(size_t, PAGE_SIZE, left - len);
+	}
+	*nr = j;
+	return len;
+}
+
 /**
  * __bio_iov_iter_get_pages - pin user or kernel pages and add them to a bio
  * @bio: bio to add pages to
@@ -1251,7 +1275,7 @@ static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 	struct page **pages = (struct page **)bv;
 	unsigned int gup_flags = 0;
 	ssize_t size, left;
-	unsigned len, i = 0;
+	unsigned len, nr, i = 0;
 	size_t offset, trim;
 	int ret = 0;
 
@@ -1290,17 +1314,25 @@ static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 		goto out;
 	}
 
-	for (left = size, i = 0; left > 0; left -= len, i++) {
+	for (left = size, i = 0; left > 0; left -= len, i += nr) {
 		struct page *page = pages[i];
 
-		len = min_t(size_t, PAGE_SIZE - offset, left);
 		if (bio_op(bio) == REQ_OP_ZONE_APPEND) {
+			len = min_t(size_t, PAGE_SIZE - offset, left);
+			nr = 1;
 			ret = bio_iov_add_zone_append_page(bio, page, len,
 					offset);
 			if (ret)
 				break;
-		} else
+		} else {
+			/*
+			 * Each page keeps its reference, so a run added as
+			 * one bvec is still released page by page.
+			 */
+			len = bio_iov_folio_run(pages + i, nr_pages - i, offset,
+						left, &nr);
 			bio_iov_add_page(bio, page, len, offset);
+		}
 
 		offset = 0;
 	}
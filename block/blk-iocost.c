@@ -447,6 +447,8 @@ struct ioc {
 
 struct iocg_pcpu_stat {
 	local64_t			abs_vusage;
+	/* abs_vusage at the last iocg_flush_stat_leaf(), under ioc->lock */
+	u64				flushed_abs_vusage;
 };
 
 struct iocg_stat {
@@ -535,9 +537,10 @@ struct ioc_gq {
 
 	/* statistics */
 	struct iocg_pcpu_stat __percpu	*pcpu_stat;
+	/* CPUs which may have abs_vusage not flushed yet */
+	cpumask_var_t			usage_cpus;
 	struct iocg_stat		stat;
 	struct iocg_stat		last_stat;
-	u64				last_stat_abs_vusage;
 	u64				usage_delta_us;
 	u64				wait_since;
 	u64				indebt_since;
@@ -712,17 +715,30 @@ static u64 cost_to_abs_cost(u64 cost, u32 hw_inuse)
 	return DIV64_U64_ROUND_UP(cost * hw_inuse, WEIGHT_ONE);
 }
 
-static void iocg_commit_bio(struct ioc_gq *iocg, struct bio *bio,
-			    u64 abs_cost, u64 cost)
+/*
+ * Usage is batched per CPU and collected by the period timer. The timer only
+ * looks at the CPUs in ->usage_cpus, keeping its cost proportional to the
+ * CPUs an iocg's IOs are issued from rather than to all possible CPUs.
+ */
+static void iocg_add_vusage(struct ioc_gq *iocg, u64 abs_cost)
 {
 	struct iocg_pcpu_stat *gcs;
+	int cpu = get_cpu();
+
+	gcs = per_cpu_ptr(iocg->pcpu_stat, cpu);
+	local64_add(abs_cost, &gcs->abs_vusage);
+	if (!cpumask_test_cpu(cpu, iocg->usage_cpus))
+		cpumask_set_cpu(cpu, iocg->usage_cpus);
+	put_cpu();
+}
 
+static void iocg_commit_bio(struct ioc_gq *iocg, struct bio *bio,
+			    u64 abs_cost, u64 cost)
+{
 	bio->bi_iocost_cost = cost;
 	atomic64_add(cost, &iocg->vtime);
 
-	gcs = get_cpu_ptr(iocg->pcpu_stat);
-	local64_add(abs_cost, &gcs->abs_vusage);
-	put_cpu_ptr(gcs);
+	iocg_add_vusage(iocg, abs_cost);
 }
 
 static void iocg_lock(struct ioc_gq *iocg, bool lock_ioc, unsigned long *flags)
@@ -1382,8 +1398,6 @@ static bool iocg_kick_delay(struct ioc_gq *iocg, struct ioc_now *now)
 static void iocg_incur_debt(struct ioc_gq *iocg, u64 abs_cost,
 			    struct ioc_now *now)
 {
-	struct iocg_pcpu_stat *gcs;
-
 	lockdep_assert_held(&iocg->ioc->lock);
 	lockdep_assert_held(&iocg->waitq.lock);
 	WARN_ON_ONCE(list_empty(&iocg->active_list));
@@ -1399,9 +1413,7 @@ static void iocg_incur_debt(struct ioc_gq *iocg, u64 abs_cost,
 
 	iocg->abs_vdebt += abs_cost;
 
-	gcs = get_cpu_ptr(iocg->pcpu_stat);
-	local64_add(abs_cost, &gcs->abs_vusage);
-	put_cpu_ptr(gcs);
+	iocg_add_vusage(iocg, abs_cost);
 }
 
 static void iocg_pay_debt(struct ioc_gq *iocg, u64 abs_vpay,
@@ -1664,19 +1676,29 @@ static void iocg_flush_stat_upward(struct ioc_gq *iocg)
 static void iocg_flush_stat_leaf(struct ioc_gq *iocg, struct ioc_now *now)
 {
 	struct ioc *ioc = iocg->ioc;
-	u64 abs_vusage = 0;
-	u64 vusage_delta;
+	u64 vusage_delta = 0;
 	int cpu;
 
 	lockdep_assert_held(&iocg->ioc->lock);
 
-	/* collect per-cpu counters */
-	for_each_possible_cpu(cpu) {
-		abs_vusage += local64_read(
-				per_cpu_ptr(&iocg->pcpu_stat->abs_vusage, cpu));
+	/*
+	 * Collect per-cpu counters. A CPU which didn't issue since the last
+	 * flush is dropped from usage_cpus and read once more in case it
+	 * raced with the clearing. Anything still missed is collected once
+	 * the CPU issues again and marks itself.
+	 */
+	for_each_cpu(cpu, iocg->usage_cpus) {
+		struct iocg_pcpu_stat *gcs = per_cpu_ptr(iocg->pcpu_stat, cpu);
+		u64 abs_vusage = local64_read(&gcs->abs_vusage);
+
+		if (abs_vusage == gcs->flushed_abs_vusage) {
+			cpumask_clear_cpu(cpu, iocg->usage_cpus);
+			smp_mb__after_atomic();
+			abs_vusage = local64_read(&gcs->abs_vusage);
+		}
+		vusage_delta += abs_vusage - gcs->flushed_abs_vusage;
+		gcs->flushed_abs_vusage = abs_vusage;
 	}
-	vusage_delta = abs_vusage - iocg->last_stat_abs_vusage;
-	iocg->last_stat_abs_vusage = abs_vusage;
 
 	iocg->usage_delta_us = div64_u64(vusage_delta, ioc->vtime_base_rate);
 	iocg->stat.usage_us += iocg->usage_delta_us;
@@ -2934,12 +2956,19 @@ static struct blkg_policy_data *ioc_pd_alloc(gfp_t gfp, struct request_queue *q,
 		return NULL;
 
 	iocg->pcpu_stat = alloc_percpu_gfp(struct iocg_pcpu_stat, gfp);
-	if (!iocg->pcpu_stat) {
-		kfree(iocg);
-		return NULL;
-	}
+	if (!iocg->pcpu_stat)
+		goto free_iocg;
+
+	if (!zalloc_cpumask_var_node(&iocg->usage_cpus, gfp, q->node))
+		goto free_pcpu_stat;
 
 	return &iocg->pd;
+
+free_pcpu_stat:
+	free_percpu(iocg->pcpu_stat);
+free_iocg:
+	kfree(iocg);
+	return NULL;
 }
 
 static void ioc_pd_init(struct blkg_policy_data *pd)
@@ -3003,6 +3032,7 @@ static void ioc_pd_free(struct blkg_policy_data *pd)
 
 		hrtimer_cancel(&iocg->waitq_timer);
 	}
+	free_cpumask_var(iocg->usage_cpus);
 	free_percpu(iocg->pcpu_stat);
 	kfree(iocg);
 }
@@ -136,9 +136,21 @@ struct latency_stat {
 	};
 };
 
+/*
+ * Completion latency histogram, kept for every group whether or not it has
+ * a latency target. Bucket i counts the reads or writes that took between
+ * 2^i and 2^(i+1) usecs, the first and the last buckets are open ended.
+ */
+#define BLKIOLATENCY_HIST_BUCKETS	20
+
+struct latency_hist {
+	u64 nr[2][BLKIOLATENCY_HIST_BUCKETS];
+};
+
 struct iolatency_grp {
 	struct blkg_policy_data pd;
 	struct latency_stat __percpu *stats;
+	struct latency_hist __percpu *hist;
 	struct latency_stat cur_stat;
 	struct blk_iolatency *blkiolat;
 	unsigned int max_depth;
@@ -588,6 +600,37 @@ static void iolatency_check_latencies(struct iolatency_grp *iolat, u64 now)
 	spin_unlock_irqrestore(&lat_info->lock, flags);
 }
 
+static void iolatency_record_hist(struct iolatency_grp *iolat,
+				  struct bio *bio, u64 now)
+{
+	u64 start = bio_issue_time(&bio->bi_issue), lat_us;
+	struct latency_hist *hist;
+	int dir, bucket;
+
+	switch (bio_op(bio)) {
+	case REQ_OP_READ:
+		dir = READ;
+		break;
+	case REQ_OP_WRITE:
+		dir = WRITE;
+		break;
+	default:
+		return;
+	}
+
+	now = __bio_issue_time(now);
+	if (now <= start)
+		return;
+
+	lat_us = div_u64(now - start, NSEC_PER_USEC);
+	bucket = lat_us < 2 ? 0 : min_t(int, ilog2(lat_us),
+					BLKIOLATENCY_HIST_BUCKETS - 1);
+
+	hist = get_cpu_ptr(iolat->hist);
+	hist->nr[dir][bucket]++;
+	put_cpu_ptr(hist);
+}
+
 static void blkcg_iolatency_done_bio(struct rq_qos *rqos, struct bio *bio)
 {
 	struct blkcg_gq *blkg;
@@ -606,10 +649,13 @@ static void blkcg_iolatency_done_bio(struct rq_qos *rqos, struct bio *bio)
 	if (!iolat)
 		return;
 
+	now = ktime_to_ns(ktime_get());
+	if (bio->bi_status != BLK_STS_AGAIN)
+		iolatency_record_hist(iolat, bio, now);
+
 	if (!iolat->blkiolat->enabled)
 		return;
 
-	now = ktime_to_ns(ktime_get());
 	while (blkg && blkg->parent) {
 		iolat = blkg_to_lat(blkg);
 		if (!iolat) {
@@ -930,12 +976,41 @@ static void iolatency_ssd_stat(struct iolatency_grp *iolat, struct seq_file *s)
 			iolat->max_depth);
 }
 
+static void iolatency_hist_stat(struct iolatency_grp *iolat, struct seq_file *s)
+{
+	static const char * const names[] = { [READ] = "rlat", [WRITE] = "wlat" };
+	struct latency_hist hist = { };
+	u64 total = 0;
+	int cpu, dir, i;
+
+	for_each_possible_cpu(cpu) {
+		struct latency_hist *h = per_cpu_ptr(iolat->hist, cpu);
+
+		for (dir = READ; dir <= WRITE; dir++) {
+			for (i = 0; i < BLKIOLATENCY_HIST_BUCKETS; i++) {
+				hist.nr[dir][i] += h->nr[dir][i];
+				total += h->nr[dir][i];
+			}
+		}
+	}
+	if (!total)
+		return;
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		seq_printf(s, " %s=%llu", names[dir], hist.nr[dir][0]);
+		for (i = 1; i < BLKIOLATENCY_HIST_BUCKETS; i++)
+			seq_printf(s, ",%llu", hist.nr[dir][i]);
+	}
+}
+
 static void iolatency_pd_stat(struct blkg_policy_data *pd, struct seq_file *s)
 {
 	struct iolatency_grp *iolat = pd_to_lat(pd);
 	unsigned long long avg_lat;
 	unsigned long long cur_win;
 
+	iolatency_hist_stat(iolat, s);
+
 	if (!blkcg_debug_stats)
 		return;
 
@@ -963,11 +1038,18 @@ static struct blkg_policy_data *iolatency_pd_alloc(gfp_t gfp,
 		return NULL;
 	iolat->stats = __alloc_percpu_gfp(sizeof(struct latency_stat),
 				       __alignof__(struct latency_stat), gfp);
-	if (!iolat->stats) {
-		kfree(iolat);
-		return NULL;
-	}
+	if (!iolat->stats)
+		goto free_iolat;
+	iolat->hist = alloc_percpu_gfp(struct latency_hist, gfp);
+	if (!iolat->hist)
+		goto free_stats;
 	return &iolat->pd;
+
+free_stats:
+	free_percpu(iolat->stats);
+free_iolat:
+	kfree(iolat);
+	return NULL;
 }
 
 static void iolatency_pd_init(struct blkg_policy_data *pd)
@@ -1025,6 +1107,7 @@ static void iolatency_pd_offline(struct blkg_policy_data *pd)
 static void iolatency_pd_free(struct blkg_policy_data *pd)
 {
 	struct iolatency_grp *iolat = pd_to_lat(pd);
+	free_percpu(iolat->hist);
 	free_percpu(iolat->stats);
 	kfree(iolat);
 }
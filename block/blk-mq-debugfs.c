@@ -36,12 +36,13 @@ static int queue_poll_stat_show(void *data, struct seq_file *m)
 	for (bucket = 0; bucket < (BLK_MQ_POLL_STATS_BKTS / 2); bucket++) {
 		seq_printf(m, "read  (%d Bytes): ", 1 << (9 + bucket));
 		print_stat(m, &q->poll_stat[2 * bucket]);
-		seq_puts(m, "\n");
+		seq_printf(m, ", sleep=%u\n", q->poll_sleep[2 * bucket]);
 
 		seq_printf(m, "write (%d Bytes): ",  1 << (9 + bucket));
 		print_stat(m, &q->poll_stat[2 * bucket + 1]);
-		seq_puts(m, "\n");
+		seq_printf(m, ", sleep=%u\n", q->poll_sleep[2 * bucket + 1]);
 	}
+	seq_printf(m, "wake latency: %u ns\n", q->poll_wake_nsec);
 	return 0;
 }
 
@@ -428,6 +429,28 @@ static void blk_mq_debugfs_tags_show(struct seq_file *m,
 	seq_printf(m, "nr_reserved_tags=%u\n", tags->nr_reserved_tags);
 	seq_printf(m, "active_queues=%d\n",
 		   atomic_read(&tags->active_queues));
+	if (tags->cache) {
+		unsigned long hits = 0, misses = 0, flushes = 0, throttled = 0;
+		unsigned int cached = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct blk_mq_tag_cache *cache;
+
+			cache = per_cpu_ptr(tags->cache, cpu);
+			cached += data_race(cache->nr);
+			hits += data_race(cache->hits);
+			misses += data_race(cache->misses);
+			flushes += data_race(cache->flushes);
+			throttled += data_race(cache->throttled);
+		}
+		seq_printf(m, "cache_size=%u\n", READ_ONCE(tags->cache_size));
+		seq_printf(m, "cache_cached=%u\n", cached);
+		seq_printf(m, "cache_hits=%lu\n", hits);
+		seq_printf(m, "cache_misses=%lu\n", misses);
+		seq_printf(m, "cache_flushes=%lu\n", flushes);
+		seq_printf(m, "cache_throttled=%lu\n", throttled);
+	}
 
 	seq_puts(m, "\nbitmap_tags:\n");
 	sbitmap_queue_show(&tags->bitmap_tags, m);
@@ -95,17 +95,195 @@ void __blk_mq_tag_idle(struct blk_mq_hw_ctx *hctx)
 	blk_mq_tag_wakeup_all(tags, false);
 }
 
+/*
+ * Keep at most a quarter of the tags in the per-cpu caches, so that the
+ * tags they strand can't starve the allocators of other CPUs.
+ */
+static unsigned int blk_mq_tag_cache_size(unsigned int depth)
+{
+	return min_t(unsigned int, BLK_MQ_TAG_CACHE_MAX,
+		     depth / (4 * num_possible_cpus()));
+}
+
+int blk_mq_tag_cache_init(struct blk_mq_tags *tags)
+{
+	unsigned int size = blk_mq_tag_cache_size(tags->bitmap_tags.sb.depth);
+	int cpu;
+
+	/* round robin allocation must keep handing out tags in order */
+	if (size < 2 || tags->bitmap_tags.round_robin)
+		return 0;
+
+	tags->cache = alloc_percpu(struct blk_mq_tag_cache);
+	if (!tags->cache)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(tags->cache, cpu)->lock);
+	tags->cache_size = size;
+	return 0;
+}
+
+/*
+ * Take a bitmap tag from the cache of this CPU, refilling it from the
+ * sbitmap in bulk when it is empty. Returns BLK_MQ_NO_TAG if there is no
+ * cache or no batch of free tags could be found.
+ */
+int blk_mq_tag_cache_get(struct blk_mq_tags *tags)
+{
+	unsigned int size = READ_ONCE(tags->cache_size);
+	struct blk_mq_tag_cache *cache;
+	int tag = BLK_MQ_NO_TAG;
+	unsigned long flags;
+
+	if (!tags->cache || size < 2)
+		return BLK_MQ_NO_TAG;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(tags->cache);
+	spin_lock(&cache->lock);
+	if (cache->nr) {
+		cache->hits++;
+	} else {
+		unsigned int offset;
+		unsigned long mask;
+
+		cache->misses++;
+		mask = __sbitmap_queue_get_batch(&tags->bitmap_tags, size / 2,
+						 &offset);
+		while (mask) {
+			cache->tags[cache->nr++] = offset + __ffs(mask);
+			mask &= mask - 1;
+		}
+	}
+	if (cache->nr)
+		tag = cache->tags[--cache->nr];
+	spin_unlock_irqrestore(&cache->lock, flags);
+	return tag;
+}
+
+static bool blk_mq_tag_cache_put(struct blk_mq_tags *tags, int tag)
+{
+	struct sbitmap_queue *bt = &tags->bitmap_tags;
+	unsigned int size = READ_ONCE(tags->cache_size);
+	struct blk_mq_tag_cache *cache;
+	unsigned long flags;
+
+	/* hand the tag straight to anybody sleeping on one */
+	if (!tags->cache || size < 2 || atomic_read(&bt->ws_active))
+		return false;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(tags->cache);
+	spin_lock(&cache->lock);
+	if (cache->nr >= size) {
+		unsigned int keep = size / 2;
+
+		sbitmap_queue_clear_batch(bt, 0, cache->tags + keep,
+					  cache->nr - keep);
+		cache->nr = keep;
+		cache->flushes++;
+	}
+	cache->tags[cache->nr++] = tag;
+
+	/*
+	 * Somebody may have started waiting after the check above and
+	 * drained the caches before the tag landed here. Pairs with the
+	 * smp_mb() in blk_mq_tag_cache_drain(): either the drain sees the
+	 * tag, or we see ws_active and hand the cache back ourselves.
+	 */
+	smp_mb();
+	if (unlikely(atomic_read(&bt->ws_active))) {
+		sbitmap_queue_clear_batch(bt, 0, cache->tags, cache->nr);
+		cache->nr = 0;
+		cache->flushes++;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
+	return true;
+}
+
+/*
+ * Return the tags of all caches, offline CPUs included, to the sbitmap.
+ * Called before resizing the tags, and by a waiter once it is accounted in
+ * ws_active, so that no freed tag can be parked behind its back. The
+ * sbitmap wakes the waiters for the tags returned. Must not be called with
+ * a wait queue lock of the tags held.
+ */
+void blk_mq_tag_cache_drain(struct blk_mq_tags *tags)
+{
+	int cpu;
+
+	if (!tags->cache)
+		return;
+
+	/* order ws_active against cache->nr, see blk_mq_tag_cache_put() */
+	smp_mb();
+
+	for_each_possible_cpu(cpu) {
+		struct blk_mq_tag_cache *cache = per_cpu_ptr(tags->cache, cpu);
+		unsigned long flags;
+
+		if (!READ_ONCE(cache->nr))
+			continue;
+
+		spin_lock_irqsave(&cache->lock, flags);
+		if (cache->nr)
+			sbitmap_queue_clear_batch(&tags->bitmap_tags, 0,
+						  cache->tags, cache->nr);
+		cache->nr = 0;
+		spin_unlock_irqrestore(&cache->lock, flags);
+	}
+}
+
+/*
+ * Stop caching and return all cached tags, for a hctx going offline to
+ * wait until none of its tags is held. Undone by blk_mq_tag_cache_resume().
+ */
+void blk_mq_tag_cache_suspend(struct blk_mq_tags *tags)
+{
+	if (!tags->cache)
+		return;
+
+	WRITE_ONCE(tags->cache_size, 0);
+	blk_mq_tag_cache_drain(tags);
+}
+
+void blk_mq_tag_cache_resume(struct blk_mq_tags *tags)
+{
+	if (!tags->cache)
+		return;
+
+	WRITE_ONCE(tags->cache_size,
+		   blk_mq_tag_cache_size(tags->bitmap_tags.sb.depth));
+}
+
+/* An allocation was refused by hctx_may_queue() for fairness */
+void blk_mq_tag_cache_throttled(struct blk_mq_tags *tags)
+{
+	if (tags->cache)
+		this_cpu_inc(tags->cache->throttled);
+}
+
 static int __blk_mq_get_tag(struct blk_mq_alloc_data *data,
 			    struct sbitmap_queue *bt)
 {
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	int tag;
+
 	if (!data->q->elevator && !(data->flags & BLK_MQ_REQ_RESERVED) &&
-			!hctx_may_queue(data->hctx, bt))
+			!hctx_may_queue(data->hctx, bt)) {
+		blk_mq_tag_cache_throttled(tags);
 		return BLK_MQ_NO_TAG;
+	}
 
 	if (data->shallow_depth)
 		return sbitmap_queue_get_shallow(bt, data->shallow_depth);
-	else
-		return __sbitmap_queue_get(bt);
+
+	if (bt == &tags->bitmap_tags) {
+		tag = blk_mq_tag_cache_get(tags);
+		if (tag != BLK_MQ_NO_TAG)
+			return tag;
+	}
+	return __sbitmap_queue_get(bt);
 }
 
 unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
@@ -172,6 +350,13 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 
 		sbitmap_prepare_to_wait(bt, ws, &wait, TASK_UNINTERRUPTIBLE);
 
+		/*
+		 * Tags parked in the per-cpu caches are free as well. Only
+		 * drain them now that ws_active counts us, so none can be
+		 * parked again before the retry below.
+		 */
+		blk_mq_tag_cache_drain(tags);
+
 		tag = __blk_mq_get_tag(data, bt);
 		if (tag != BLK_MQ_NO_TAG)
 			break;
@@ -222,7 +407,9 @@ void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 		const int real_tag = tag - tags->nr_reserved_tags;
 
 		BUG_ON(real_tag >= tags->nr_tags);
-		sbitmap_queue_clear(&tags->bitmap_tags, real_tag, ctx->cpu);
+		if (!blk_mq_tag_cache_put(tags, real_tag))
+			sbitmap_queue_clear(&tags->bitmap_tags, real_tag,
+					    ctx->cpu);
 	} else {
 		sbitmap_queue_clear(&tags->breserved_tags, tag, ctx->cpu);
 	}
@@ -230,6 +417,20 @@ void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 
 void blk_mq_put_tags(struct blk_mq_tags *tags, int *tag_array, int nr_tags)
 {
+	int i;
+
+	if (tags->cache) {
+		for (i = 0; i < nr_tags; i++) {
+			int real_tag = tag_array[i] - tags->nr_reserved_tags;
+
+			if (!blk_mq_tag_cache_put(tags, real_tag))
+				sbitmap_queue_clear(&tags->bitmap_tags,
+						    real_tag,
+						    raw_smp_processor_id());
+		}
+		return;
+	}
+
 	sbitmap_queue_clear_batch(&tags->bitmap_tags, tags->nr_reserved_tags,
 					tag_array, nr_tags);
 }
@@ -586,6 +787,7 @@ struct blk_mq_tags *blk_mq_init_tags(unsigned int total_tags,
 
 void blk_mq_free_tags(struct blk_mq_tags *tags)
 {
+	free_percpu(tags->cache);
 	sbitmap_queue_free(&tags->bitmap_tags);
 	sbitmap_queue_free(&tags->breserved_tags);
 	kfree(tags);
@@ -646,8 +848,12 @@ int blk_mq_tag_update_depth(struct blk_mq_hw_ctx *hctx,
 void blk_mq_tag_resize_shared_tags(struct blk_mq_tag_set *set, unsigned int size)
 {
 	struct blk_mq_tags *tags = set->shared_tags;
+	unsigned int depth = size - set->reserved_tags;
 
-	sbitmap_queue_resize(&tags->bitmap_tags, size - set->reserved_tags);
+	/* no cached tag may be left beyond the new depth */
+	WRITE_ONCE(tags->cache_size, blk_mq_tag_cache_size(depth));
+	blk_mq_tag_cache_drain(tags);
+	sbitmap_queue_resize(&tags->bitmap_tags, depth);
 }
 
 void blk_mq_tag_update_sched_shared_tags(struct request_queue *q)
@@ -4,6 +4,26 @@
 
 struct blk_mq_alloc_data;
 
+#define BLK_MQ_TAG_CACHE_MAX	16
+
+/*
+ * Free tags of a shared tag set parked on a CPU, so that allocations and
+ * completions on that CPU don't have to touch the sbitmap words and wait
+ * queues shared by all CPUs. Refilled and flushed cache_size / 2 at a
+ * time.
+ */
+struct blk_mq_tag_cache {
+	spinlock_t	lock;
+	unsigned int	nr;
+	int		tags[BLK_MQ_TAG_CACHE_MAX];
+
+	/* for debugfs */
+	unsigned long	hits;
+	unsigned long	misses;
+	unsigned long	flushes;
+	unsigned long	throttled;
+};
+
 extern struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags,
 					unsigned int reserved_tags,
 					int node, int alloc_policy);
@@ -14,6 +34,13 @@ extern int blk_mq_init_bitmaps(struct sbitmap_queue *bitmap_tags,
 			       unsigned int reserved,
 			       int node, int alloc_policy);
 
+extern int blk_mq_tag_cache_init(struct blk_mq_tags *tags);
+int blk_mq_tag_cache_get(struct blk_mq_tags *tags);
+void blk_mq_tag_cache_drain(struct blk_mq_tags *tags);
+void blk_mq_tag_cache_suspend(struct blk_mq_tags *tags);
+void blk_mq_tag_cache_resume(struct blk_mq_tags *tags);
+void blk_mq_tag_cache_throttled(struct blk_mq_tags *tags);
+
 extern unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data);
 unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 			      unsigned int *offset);
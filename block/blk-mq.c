@@ -24,6 +24,7 @@
 #include <linux/sched/sysctl.h>
 #include <linux/sched/topology.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/wake_q.h>
 #include <linux/delay.h>
 #include <linux/crash_dump.h>
 #include <linux/prefetch.h>
@@ -45,6 +46,8 @@
 #include "blk-ioprio.h"
 
 static DEFINE_PER_CPU(struct llist_head, blk_cpu_done);
+/* wakeups deferred to the end of the completion batch running on this CPU */
+static DEFINE_PER_CPU(struct wake_q_head *, blk_batch_wake_q);
 
 static void blk_mq_poll_stats_start(struct request_queue *q);
 static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb);
@@ -433,6 +436,7 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 		}
 	}
 
+	trace_block_rq_alloc(rq);
 	return rq;
 }
 
@@ -1074,16 +1078,43 @@ static inline void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx,
 	percpu_ref_put_many(&q->q_usage_counter, nr_tags);
 }
 
+/*
+ * Wake a task waiting for its I/O. Inside a batch of completions run from
+ * interrupt context, the wakeup is deferred to the end of the batch so
+ * that a task with several requests in the batch gets woken only once.
+ */
+void __blk_wake_io_task(struct task_struct *waiter)
+{
+	struct wake_q_head *wake_q = NULL;
+
+	if (in_interrupt())
+		wake_q = this_cpu_read(blk_batch_wake_q);
+	if (wake_q)
+		wake_q_add(wake_q, waiter);
+	else
+		wake_up_process(waiter);
+}
+EXPORT_SYMBOL_GPL(__blk_wake_io_task);
+
 void blk_mq_end_request_batch(struct io_comp_batch *iob)
 {
 	int tags[TAG_COMP_BATCH], nr_tags = 0;
 	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	struct wake_q_head *prev_wake_q = NULL;
+	bool defer_wake = in_interrupt();
 	struct request *rq;
+	DEFINE_WAKE_Q(wake_q);
 	u64 now = 0;
 
 	if (iob->need_ts)
 		now = ktime_get_ns();
 
+	/* a batch run from a nested interrupt keeps its own wakeups */
+	if (defer_wake) {
+		prev_wake_q = this_cpu_read(blk_batch_wake_q);
+		this_cpu_write(blk_batch_wake_q, &wake_q);
+	}
+
 	while ((rq = rq_list_pop(&iob->req_list)) != NULL) {
 		prefetch(rq->bio);
 		prefetch(rq->rq_next);
@@ -1119,6 +1150,11 @@ void blk_mq_end_request_batch(struct io_comp_batch *iob)
 
 	if (nr_tags)
 		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+
+	if (defer_wake) {
+		this_cpu_write(blk_batch_wake_q, prev_wake_q);
+		wake_up_q(&wake_q);
+	}
 }
 EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
 
@@ -1759,21 +1795,26 @@ struct request *blk_mq_dequeue_from_ctx(struct blk_mq_hw_ctx *hctx,
 
 static bool __blk_mq_alloc_driver_tag(struct request *rq)
 {
-	struct sbitmap_queue *bt = &rq->mq_hctx->tags->bitmap_tags;
-	unsigned int tag_offset = rq->mq_hctx->tags->nr_reserved_tags;
-	int tag;
+	struct blk_mq_tags *tags = rq->mq_hctx->tags;
+	struct sbitmap_queue *bt = &tags->bitmap_tags;
+	unsigned int tag_offset = tags->nr_reserved_tags;
+	int tag = BLK_MQ_NO_TAG;
 
 	blk_mq_tag_busy(rq->mq_hctx);
 
 	if (blk_mq_tag_is_reserved(rq->mq_hctx->sched_tags, rq->internal_tag)) {
-		bt = &rq->mq_hctx->tags->breserved_tags;
+		bt = &tags->breserved_tags;
 		tag_offset = 0;
 	} else {
-		if (!hctx_may_queue(rq->mq_hctx, bt))
+		if (!hctx_may_queue(rq->mq_hctx, bt)) {
+			blk_mq_tag_cache_throttled(tags);
 			return false;
+		}
+		tag = blk_mq_tag_cache_get(tags);
 	}
 
-	tag = __sbitmap_queue_get(bt);
+	if (tag == BLK_MQ_NO_TAG)
+		tag = __sbitmap_queue_get(bt);
 	if (tag == BLK_MQ_NO_TAG)
 		return false;
 
@@ -1871,6 +1912,11 @@ static bool blk_mq_mark_tag_wait(struct blk_mq_hw_ctx *hctx,
 	if (!ret) {
 		spin_unlock(&hctx->dispatch_wait_lock);
 		spin_unlock_irq(&wq->lock);
+		/*
+		 * Tags parked in the per-cpu caches are free as well. Now
+		 * that we are on the wait queue, returning them wakes us.
+		 */
+		blk_mq_tag_cache_drain(hctx->tags);
 		return false;
 	}
 
@@ -2053,6 +2099,7 @@ bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx, struct list_head *list,
 		 */
 		if (nr_budgets)
 			nr_budgets--;
+		trace_block_rq_dispatch(rq);
 		ret = q->mq_ops->queue_rq(hctx, &bd);
 		switch (ret) {
 		case BLK_STS_OK:
@@ -2586,6 +2633,8 @@ static blk_status_t __blk_mq_issue_directly(struct blk_mq_hw_ctx *hctx,
 	};
 	blk_status_t ret;
 
+	trace_block_rq_dispatch(rq);
+
 	/*
 	 * For OK queue, we are done. For error, caller may kill it.
 	 * Any other error (busy), just add it to our list as we
@@ -2728,6 +2777,14 @@ static void __blk_mq_flush_plug_list(struct request_queue *q,
 {
 	if (blk_queue_quiesced(q))
 		return;
+
+	if (trace_block_rq_dispatch_enabled()) {
+		struct request *rq;
+
+		rq_list_for_each(&plug->mq_list, rq)
+			trace_block_rq_dispatch(rq);
+	}
+
 	q->mq_ops->queue_rqs(&plug->mq_list);
 }
 
@@ -3487,8 +3544,17 @@ static int blk_mq_hctx_notify_offline(unsigned int cpu, struct hlist_node *node)
 	 * frozen and there are no requests.
 	 */
 	if (percpu_ref_tryget(&hctx->queue->q_usage_counter)) {
-		while (blk_mq_hctx_has_requests(hctx))
+		/*
+		 * A tag parked in a per-cpu cache still reads as allocated.
+		 * Stop the caching, and keep draining what puts that raced
+		 * with it parked meanwhile.
+		 */
+		blk_mq_tag_cache_suspend(hctx->tags);
+		while (blk_mq_hctx_has_requests(hctx)) {
 			msleep(5);
+			blk_mq_tag_cache_drain(hctx->tags);
+		}
+		blk_mq_tag_cache_resume(hctx->tags);
 		percpu_ref_put(&hctx->queue->q_usage_counter);
 	}
 
@@ -4255,6 +4321,7 @@ int blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	 * Default to classic polling
 	 */
 	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
+	blk_stat_poll_init(q);
 
 	blk_mq_init_cpu_queues(q, set->nr_hw_queues);
 	blk_mq_add_queue_tag_set(set, q);
@@ -4293,6 +4360,8 @@ static int __blk_mq_alloc_rq_maps(struct blk_mq_tag_set *set)
 						set->queue_depth);
 		if (!set->shared_tags)
 			return -ENOMEM;
+		/* the tags work without the caches, just slower */
+		blk_mq_tag_cache_init(set->shared_tags);
 	}
 
 	for (i = 0; i < set->nr_hw_queues; i++) {
@@ -4808,22 +4877,17 @@ static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 		return 0;
 
 	/*
-	 * As an optimistic guess, use half of the mean service time
-	 * for this type of request. We can (and should) make this smarter.
-	 * For instance, if the completion latencies are tight, we can
-	 * get closer than just half the mean. This is especially
-	 * important on devices where the completion latencies are longer
-	 * than ~10 usec. We do use the stats for the relevant IO size
-	 * if available which does lead to better estimates.
+	 * Start out with half of the mean service time for this type and
+	 * size of request. The share then gets learnt per bucket from how
+	 * long the completions kept us spinning after the sleep, see
+	 * blk_stat_poll_learn(), so devices with tight completion latencies
+	 * sleep for most of it.
 	 */
 	bucket = blk_mq_poll_stats_bkt(rq);
 	if (bucket < 0)
 		return ret;
 
-	if (q->poll_stat[bucket].nr_samples)
-		ret = (q->poll_stat[bucket].mean + 1) / 2;
-
-	return ret;
+	return blk_stat_poll_nsecs(q, bucket);
 }
 
 static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
@@ -4845,7 +4909,7 @@ static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
 	/*
 	 * If we get here, hybrid polling is enabled. Hence poll_nsec can be:
 	 *
-	 *  0:	use half of prev avg
+	 *  0:	use the learnt share of prev avg
 	 * >0:	use this specific value
 	 */
 	if (q->poll_nsec > 0)
@@ -4858,13 +4922,9 @@ static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
 
 	rq->rq_flags |= RQF_MQ_POLL_SLEPT;
 
-	/*
-	 * This will be replaced with the stats tracking code, using
-	 * 'avg_completion_time / 2' as the pre-sleep target.
-	 */
-	kt = nsecs;
+	kt = ktime_add_ns(ktime_get(), nsecs);
 
-	mode = HRTIMER_MODE_REL;
+	mode = HRTIMER_MODE_ABS;
 	hrtimer_init_sleeper_on_stack(&hs, CLOCK_MONOTONIC, mode);
 	hrtimer_set_expires(&hs.timer, kt);
 
@@ -4876,12 +4936,15 @@ static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
 		if (hs.task)
 			io_schedule();
 		hrtimer_cancel(&hs.timer);
-		mode = HRTIMER_MODE_ABS;
 	} while (hs.task && !signal_pending(current));
 
 	__set_current_state(TASK_RUNNING);
 	destroy_hrtimer_on_stack(&hs.timer);
 
+	/* the adaptive sleep is cut short by the time it takes to wake up */
+	if (!q->poll_nsec && !hs.task)
+		blk_stat_poll_woken(q, ktime_to_ns(ktime_sub(ktime_get(), kt)));
+
 	/*
 	 * If we sleep, have the caller restart the poll loop to reset the
 	 * state.  Like for the other success return cases, the caller is
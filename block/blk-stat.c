@@ -18,6 +18,18 @@ struct blk_queue_stats {
 	int accounting;
 };
 
+/*
+ * Adaptive hybrid polling sleeps for a share of the mean completion time of
+ * the request's bucket, in units of 1/(1 << BLK_POLL_SLEEP_SHIFT), and then
+ * spins. The share of each bucket is learnt from the time spent spinning.
+ */
+#define BLK_POLL_SLEEP_SHIFT	10
+#define BLK_POLL_SLEEP_DFL	(1U << (BLK_POLL_SLEEP_SHIFT - 1))
+#define BLK_POLL_SLEEP_MIN	(1U << (BLK_POLL_SLEEP_SHIFT - 2))
+#define BLK_POLL_SLEEP_MAX	((1U << BLK_POLL_SLEEP_SHIFT) - \
+				 (1U << (BLK_POLL_SLEEP_SHIFT - 4)))
+#define BLK_POLL_SLEEP_STEP	(1U << (BLK_POLL_SLEEP_SHIFT - 6))
+
 void blk_rq_stat_init(struct blk_rq_stat *stat)
 {
 	stat->min = -1ULL;
@@ -48,6 +60,44 @@ void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_samples++;
 }
 
+/*
+ * A request that was found right after its sleep most likely completed
+ * while the task still slept and paid for it in latency, so back off
+ * quickly. One that kept us spinning for a quarter of its completion time
+ * burnt CPU a longer sleep would have saved.
+ */
+static void blk_stat_poll_learn(struct request *rq, u64 value)
+{
+	struct request_queue *q = rq->q;
+	unsigned int sleep;
+	u64 mean, slept, spun;
+	int bucket;
+
+	if (q->poll_nsec || !q->poll_stat)
+		return;
+
+	bucket = q->poll_cb->bucket_fn(rq);
+	if (bucket < 0)
+		return;
+	mean = q->poll_stat[bucket].mean;
+	if (!mean)
+		return;
+
+	sleep = READ_ONCE(q->poll_sleep[bucket]);
+	slept = ((mean * sleep) >> BLK_POLL_SLEEP_SHIFT) +
+		READ_ONCE(q->poll_wake_nsec);
+	spun = value > slept ? value - slept : 0;
+
+	if (spun < mean >> 4)
+		sleep = sleep > BLK_POLL_SLEEP_MIN + 2 * BLK_POLL_SLEEP_STEP ?
+			sleep - 2 * BLK_POLL_SLEEP_STEP : BLK_POLL_SLEEP_MIN;
+	else if (spun > mean >> 2)
+		sleep = min(sleep + BLK_POLL_SLEEP_STEP, BLK_POLL_SLEEP_MAX);
+	else
+		return;
+	WRITE_ONCE(q->poll_sleep[bucket], sleep);
+}
+
 void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
@@ -60,6 +110,9 @@ void blk_stat_add(struct request *rq, u64 now)
 
 	blk_throtl_stat_add(rq, value);
 
+	if (rq->rq_flags & RQF_MQ_POLL_SLEPT)
+		blk_stat_poll_learn(rq, value);
+
 	rcu_read_lock();
 	cpu = get_cpu();
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
@@ -77,6 +130,51 @@ void blk_stat_add(struct request *rq, u64 now)
 	rcu_read_unlock();
 }
 
+/**
+ * blk_stat_poll_nsecs() - How long to sleep before polling for a request
+ * @q: The request queue.
+ * @bucket: The poll statistics bucket of the request.
+ *
+ * Return: the learnt share of the mean completion time of @bucket, less the
+ * time the task takes to wake up, or 0 if sleeping isn't worth it.
+ */
+unsigned long blk_stat_poll_nsecs(struct request_queue *q, int bucket)
+{
+	const struct blk_rq_stat *stat = &q->poll_stat[bucket];
+	unsigned int wake = READ_ONCE(q->poll_wake_nsec);
+	u64 nsecs;
+
+	if (!stat->nr_samples)
+		return 0;
+
+	nsecs = (stat->mean * READ_ONCE(q->poll_sleep[bucket])) >>
+		BLK_POLL_SLEEP_SHIFT;
+	return nsecs > wake ? nsecs - wake : 0;
+}
+
+/**
+ * blk_stat_poll_woken() - Account the wakeup latency of a hybrid poll sleep
+ * @q: The request queue.
+ * @late: How late the task woke up after its timer expired.
+ */
+void blk_stat_poll_woken(struct request_queue *q, u64 late)
+{
+	unsigned int wake = READ_ONCE(q->poll_wake_nsec);
+
+	late = min_t(u64, late, NSEC_PER_MSEC);
+	/* moving average over the last eight wakeups */
+	WRITE_ONCE(q->poll_wake_nsec, wake - (wake >> 3) + (late >> 3));
+}
+
+void blk_stat_poll_init(struct request_queue *q)
+{
+	int bucket;
+
+	for (bucket = 0; bucket < BLK_MQ_POLL_STATS_BKTS; bucket++)
+		q->poll_sleep[bucket] = BLK_POLL_SLEEP_DFL;
+	q->poll_wake_nsec = 0;
+}
+
 static void blk_stat_timer_fn(struct timer_list *t)
 {
 	struct blk_stat_callback *cb = from_timer(cb, t, timer);
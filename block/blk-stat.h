@@ -166,6 +166,10 @@ static inline void blk_stat_activate_msecs(struct blk_stat_callback *cb,
 	mod_timer(&cb->timer, jiffies + msecs_to_jiffies(msecs));
 }
 
+void blk_stat_poll_init(struct request_queue *q);
+unsigned long blk_stat_poll_nsecs(struct request_queue *q, int bucket);
+void blk_stat_poll_woken(struct request_queue *q, u64 late);
+
 void blk_rq_stat_add(struct blk_rq_stat *, u64);
 void blk_rq_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
 void blk_rq_stat_init(struct blk_rq_stat *);
@@ -16,6 +16,8 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
 
 #include <trace/events/block.h>
 
@@ -81,6 +83,16 @@ struct dd_per_prio {
 	struct io_stats_per_prio stats;
 };
 
+/*
+ * Requests inserted on a CPU, waiting for the next dispatch to move them
+ * into the per priority lists. Keeps the inserters off dd->lock.
+ */
+struct dd_insert_list {
+	spinlock_t lock;
+	struct list_head at_head;
+	struct list_head at_tail;
+};
+
 struct deadline_data {
 	/*
 	 * run time data
@@ -105,6 +117,10 @@ struct deadline_data {
 
 	spinlock_t lock;
 	spinlock_t zone_lock;
+
+	struct dd_insert_list __percpu *insert;
+	/* CPUs with a non-empty insert list */
+	cpumask_var_t insert_pending;
 };
 
 /* Maps an I/O priority class to a deadline scheduler priority. */
@@ -561,6 +577,8 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 	return NULL;
 }
 
+static void dd_flush_inserts(struct request_queue *q, struct deadline_data *dd);
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -577,6 +595,7 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	enum dd_prio prio;
 
 	spin_lock(&dd->lock);
+	dd_flush_inserts(hctx->queue, dd);
 	rq = dd_dispatch_prio_aged_requests(dd, now);
 	if (rq)
 		goto unlock;
@@ -640,6 +659,8 @@ static void dd_exit_sched(struct elevator_queue *e)
 	struct deadline_data *dd = e->elevator_data;
 	enum dd_prio prio;
 
+	WARN_ON_ONCE(!cpumask_empty(dd->insert_pending));
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
 		struct dd_per_prio *per_prio = &dd->per_prio[prio];
 		const struct io_stats_per_prio *stats = &per_prio->stats;
@@ -658,6 +679,8 @@ static void dd_exit_sched(struct elevator_queue *e)
 			  stats->dispatched, atomic_read(&stats->completed));
 	}
 
+	free_percpu(dd->insert);
+	free_cpumask_var(dd->insert_pending);
 	kfree(dd);
 }
 
@@ -670,6 +693,7 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	struct elevator_queue *eq;
 	enum dd_prio prio;
 	int ret = -ENOMEM;
+	int cpu;
 
 	eq = elevator_alloc(q, e);
 	if (!eq)
@@ -679,6 +703,19 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	if (!dd)
 		goto put_eq;
 
+	dd->insert = alloc_percpu(struct dd_insert_list);
+	if (!dd->insert)
+		goto free_dd;
+	if (!zalloc_cpumask_var_node(&dd->insert_pending, GFP_KERNEL, q->node))
+		goto free_insert;
+	for_each_possible_cpu(cpu) {
+		struct dd_insert_list *il = per_cpu_ptr(dd->insert, cpu);
+
+		spin_lock_init(&il->lock);
+		INIT_LIST_HEAD(&il->at_head);
+		INIT_LIST_HEAD(&il->at_tail);
+	}
+
 	eq->elevator_data = dd;
 
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
@@ -706,6 +743,10 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	q->elevator = eq;
 	return 0;
 
+free_insert:
+	free_percpu(dd->insert);
+free_dd:
+	kfree(dd);
 put_eq:
 	kobject_put(&eq->kobj);
 	return ret;
@@ -754,7 +795,13 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 	struct request *free = NULL;
 	bool ret;
 
-	spin_lock(&dd->lock);
+	/*
+	 * Missing a merge costs less than waiting for the lock while another
+	 * CPU is dispatching, the plug already merged most of the I/O of a
+	 * task.
+	 */
+	if (!spin_trylock(&dd->lock))
+		return false;
 	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
 	spin_unlock(&dd->lock);
 
@@ -767,10 +814,9 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 /*
  * add rq to rbtree and fifo
  */
-static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
+static void dd_insert_request(struct request_queue *q, struct request *rq,
 			      bool at_head)
 {
-	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
 	const enum dd_data_dir data_dir = rq_data_dir(rq);
 	u16 ioprio = req_get_ioprio(rq);
@@ -821,24 +867,61 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	}
 }
 
-/*
- * Called from blk_mq_sched_insert_request() or blk_mq_sched_insert_requests().
- */
-static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
-			       struct list_head *list, bool at_head)
+static void dd_insert_list(struct request_queue *q, struct list_head *list,
+			   bool at_head)
 {
-	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
-
-	spin_lock(&dd->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
 
 		rq = list_first_entry(list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
-		dd_insert_request(hctx, rq, at_head);
+		dd_insert_request(q, rq, at_head);
 	}
-	spin_unlock(&dd->lock);
+}
+
+/*
+ * Move the requests of all the insert lists into the per priority lists.
+ * Clearing a CPU from insert_pending under the lock of its insert list
+ * guarantees that a racing insert sets it again.
+ */
+static void dd_flush_inserts(struct request_queue *q, struct deadline_data *dd)
+{
+	LIST_HEAD(at_head);
+	LIST_HEAD(at_tail);
+	int cpu;
+
+	lockdep_assert_held(&dd->lock);
+
+	for_each_cpu(cpu, dd->insert_pending) {
+		struct dd_insert_list *il = per_cpu_ptr(dd->insert, cpu);
+
+		spin_lock(&il->lock);
+		cpumask_clear_cpu(cpu, dd->insert_pending);
+		list_splice_tail_init(&il->at_head, &at_head);
+		list_splice_tail_init(&il->at_tail, &at_tail);
+		spin_unlock(&il->lock);
+	}
+
+	dd_insert_list(q, &at_head, true);
+	dd_insert_list(q, &at_tail, false);
+}
+
+/*
+ * Called from blk_mq_sched_insert_request() or blk_mq_sched_insert_requests().
+ * The requests are sorted in by the next dd_dispatch_request().
+ */
+static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
+			       struct list_head *list, bool at_head)
+{
+	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	int cpu = raw_smp_processor_id();
+	struct dd_insert_list *il = per_cpu_ptr(dd->insert, cpu);
+
+	spin_lock(&il->lock);
+	list_splice_tail_init(list, at_head ? &il->at_head : &il->at_tail);
+	if (!cpumask_test_cpu(cpu, dd->insert_pending))
+		cpumask_set_cpu(cpu, dd->insert_pending);
+	spin_unlock(&il->lock);
 }
 
 /* Callback from inside blk_mq_rq_ctx_init(). */
@@ -917,6 +1000,9 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
 	enum dd_prio prio;
 
+	if (!cpumask_empty(dd->insert_pending))
+		return true;
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
 		if (dd_has_work_for_prio(&dd->per_prio[prio]))
 			return true;
@@ -15,12 +15,23 @@
 #include <linux/slab.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/topology.h>
 #include <crypto/pcrypt.h>
 
 static struct padata_instance *pencrypt;
 static struct padata_instance *pdecrypt;
 static struct kset           *pcrypt_kset;
 
+/*
+ * By default all transforms of an instance share one sequence, so a slow
+ * request of one flow (e.g. IPsec SA) holds back completions of every other
+ * flow.  With tfm_ordering each transform gets its own padata shell and is
+ * only ordered against itself, at the cost of per-CPU queues per transform.
+ */
+static bool tfm_ordering;
+module_param(tfm_ordering, bool, 0644);
+MODULE_PARM_DESC(tfm_ordering, "Preserve ordering per transform instead of per algorithm instance");
+
 struct pcrypt_instance_ctx {
 	struct crypto_aead_spawn spawn;
 	struct padata_shell *psenc;
@@ -30,6 +41,8 @@ struct pcrypt_instance_ctx {
 
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
+	struct padata_shell *psenc;
+	struct padata_shell *psdec;
 	unsigned int cb_cpu;
 };
 
@@ -114,7 +127,8 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psenc, padata, &ctx->cb_cpu);
+	err = padata_do_parallel(ctx->psenc ?: ictx->psenc, padata,
+				 &ctx->cb_cpu);
 	if (!err)
 		return -EINPROGRESS;
 
@@ -161,7 +175,8 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psdec, padata, &ctx->cb_cpu);
+	err = padata_do_parallel(ctx->psdec ?: ictx->psdec, padata,
+				 &ctx->cb_cpu);
 	if (!err)
 		return -EINPROGRESS;
 
@@ -170,23 +185,43 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 
 static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 {
-	int cpu, cpu_index;
+	const struct cpumask *node_mask = cpumask_of_node(numa_node_id());
 	struct aead_instance *inst = aead_alg_instance(tfm);
 	struct pcrypt_instance_ctx *ictx = aead_instance_ctx(inst);
 	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(tfm);
 	struct crypto_aead *cipher;
+	unsigned int count, nr_node;
+	int err;
 
-	cpu_index = (unsigned int)atomic_inc_return(&ictx->tfm_count) %
-		    cpumask_weight(cpu_online_mask);
-
-	ctx->cb_cpu = cpumask_first(cpu_online_mask);
-	for (cpu = 0; cpu < cpu_index; cpu++)
-		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_online_mask);
+	/*
+	 * Spread the callback CPUs of the transforms over the node that
+	 * allocates them, so serialization does not bounce the requests
+	 * across the interconnect.
+	 */
+	count = (unsigned int)atomic_inc_return(&ictx->tfm_count);
+	nr_node = cpumask_weight_and(node_mask, cpu_online_mask);
+	if (nr_node)
+		ctx->cb_cpu = cpumask_nth_and(count % nr_node, node_mask,
+					      cpu_online_mask);
+	else
+		ctx->cb_cpu = cpumask_nth(count % num_online_cpus(),
+					  cpu_online_mask);
+
+	if (READ_ONCE(tfm_ordering)) {
+		ctx->psenc = padata_alloc_shell(pencrypt);
+		ctx->psdec = padata_alloc_shell(pdecrypt);
+		if (!ctx->psenc || !ctx->psdec) {
+			err = -ENOMEM;
+			goto err_free_shells;
+		}
+	}
 
 	cipher = crypto_spawn_aead(&ictx->spawn);
 
-	if (IS_ERR(cipher))
-		return PTR_ERR(cipher);
+	if (IS_ERR(cipher)) {
+		err = PTR_ERR(cipher);
+		goto err_free_shells;
+	}
 
 	ctx->child = cipher;
 	crypto_aead_set_reqsize(tfm, sizeof(struct pcrypt_request) +
@@ -194,6 +229,11 @@ static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 				     crypto_aead_reqsize(cipher));
 
 	return 0;
+
+err_free_shells:
+	padata_free_shell(ctx->psdec);
+	padata_free_shell(ctx->psenc);
+	return err;
 }
 
 static void pcrypt_aead_exit_tfm(struct crypto_aead *tfm)
@@ -201,6 +241,8 @@ static void pcrypt_aead_exit_tfm(struct crypto_aead *tfm)
 	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(tfm);
 
 	crypto_free_aead(ctx->child);
+	padata_free_shell(ctx->psdec);
+	padata_free_shell(ctx->psenc);
 }
 
 static void pcrypt_free(struct aead_instance *inst)
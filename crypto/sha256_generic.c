@@ -58,13 +58,143 @@ int crypto_sha256_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL(crypto_sha256_finup);
 
+/*
+ * Two-way interleaved SHA-256 for crypto_shash_finup_mb().  The rounds of
+ * the two messages are independent, so running them side by side gives
+ * the CPU two dependency chains to overlap instead of one.
+ */
+#define SHA256_MB_WAYS	2
+
+static const u32 sha256_mb_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define e0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define s0(x)		(ror32(x, 7) ^ ror32(x, 18) ^ ((x) >> 3))
+#define s1(x)		(ror32(x, 17) ^ ror32(x, 19) ^ ((x) >> 10))
+
+static void sha256_block_mb(u32 state[SHA256_MB_WAYS][8],
+			    const u8 *src[SHA256_MB_WAYS])
+{
+	u32 W[SHA256_MB_WAYS][64], v[SHA256_MB_WAYS][8], t1, t2;
+	int i, j;
+
+	for (j = 0; j < SHA256_MB_WAYS; j++) {
+		for (i = 0; i < 16; i++)
+			W[j][i] = get_unaligned_be32(src[j] + 4 * i);
+		memcpy(v[j], state[j], sizeof(v[j]));
+	}
+
+	for (i = 16; i < 64; i++)
+		for (j = 0; j < SHA256_MB_WAYS; j++)
+			W[j][i] = s1(W[j][i - 2]) + W[j][i - 7] +
+				  s0(W[j][i - 15]) + W[j][i - 16];
+
+	for (i = 0; i < 64; i++) {
+		for (j = 0; j < SHA256_MB_WAYS; j++) {
+			u32 *x = v[j];
+
+			t1 = x[7] + e1(x[4]) + Ch(x[4], x[5], x[6]) +
+			     sha256_mb_k[i] + W[j][i];
+			t2 = e0(x[0]) + Maj(x[0], x[1], x[2]);
+			x[7] = x[6];
+			x[6] = x[5];
+			x[5] = x[4];
+			x[4] = x[3] + t1;
+			x[3] = x[2];
+			x[2] = x[1];
+			x[1] = x[0];
+			x[0] = t1 + t2;
+		}
+	}
+
+	for (j = 0; j < SHA256_MB_WAYS; j++)
+		for (i = 0; i < 8; i++)
+			state[j][i] += v[j][i];
+
+	memzero_explicit(W, sizeof(W));
+	memzero_explicit(v, sizeof(v));
+}
+
+static int crypto_sha256_finup_mb(struct shash_desc *desc,
+				  const u8 * const data[], unsigned int len,
+				  u8 * const outs[], unsigned int num_msgs)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int digest_size = crypto_shash_digestsize(desc->tfm);
+	u8 pad[SHA256_MB_WAYS][2 * SHA256_BLOCK_SIZE];
+	u32 state[SHA256_MB_WAYS][8];
+	unsigned int tail = len % SHA256_BLOCK_SIZE;
+	unsigned int nr_pad, off, i, j;
+	const u8 *src[SHA256_MB_WAYS];
+
+	/* Only a whole-block prefix, such as a padded salt, is shared */
+	if (sctx->count % SHA256_BLOCK_SIZE)
+		return -EOPNOTSUPP;
+
+	for (j = 0; j < SHA256_MB_WAYS; j++)
+		memcpy(state[j], sctx->state, sizeof(state[j]));
+
+	for (off = 0; off + SHA256_BLOCK_SIZE <= len;
+	     off += SHA256_BLOCK_SIZE) {
+		for (j = 0; j < SHA256_MB_WAYS; j++)
+			src[j] = data[j] + off;
+		sha256_block_mb(state, src);
+	}
+
+	/* The tail and padding are the same length for all the messages */
+	nr_pad = tail < SHA256_BLOCK_SIZE - sizeof(__be64) ? 1 : 2;
+	memset(pad, 0, sizeof(pad));
+	for (j = 0; j < SHA256_MB_WAYS; j++) {
+		memcpy(pad[j], data[j] + off, tail);
+		pad[j][tail] = 0x80;
+		put_unaligned_be64((sctx->count + len) << 3,
+				   &pad[j][nr_pad * SHA256_BLOCK_SIZE -
+					   sizeof(__be64)]);
+	}
+	for (i = 0; i < nr_pad; i++) {
+		for (j = 0; j < SHA256_MB_WAYS; j++)
+			src[j] = pad[j] + i * SHA256_BLOCK_SIZE;
+		sha256_block_mb(state, src);
+	}
+
+	for (j = 0; j < SHA256_MB_WAYS; j++)
+		for (i = 0; i < digest_size / sizeof(__be32); i++)
+			put_unaligned_be32(state[j][i], outs[j] + 4 * i);
+
+	memzero_explicit(pad, sizeof(pad));
+	memzero_explicit(state, sizeof(state));
+	memzero_explicit(sctx, sizeof(*sctx));
+	return 0;
+}
+
 static struct shash_alg sha256_algs[2] = { {
 	.digestsize	=	SHA256_DIGEST_SIZE,
 	.init		=	sha256_base_init,
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_mb,
 	.descsize	=	sizeof(struct sha256_state),
+	.mb_max_msgs	=	SHA256_MB_WAYS,
 	.base		=	{
 		.cra_name	=	"sha256",
 		.cra_driver_name=	"sha256-generic",
@@ -78,7 +208,9 @@ static struct shash_alg sha256_algs[2] = { {
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_mb,
 	.descsize	=	sizeof(struct sha256_state),
+	.mb_max_msgs	=	SHA256_MB_WAYS,
 	.base		=	{
 		.cra_name	=	"sha224",
 		.cra_driver_name=	"sha224-generic",
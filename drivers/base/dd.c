@@ -61,6 +61,7 @@ static bool initcalls_done;
 #define ASYNC_DRV_NAMES_MAX_LEN	256
 static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
 static bool async_probe_default;
+static char async_probe_bus_names[ASYNC_DRV_NAMES_MAX_LEN];
 
 /*
  * In some cases, like suspend to RAM or hibernation, It might be reasonable
@@ -821,6 +822,40 @@ static int driver_probe_device(struct device_driver *drv, struct device *dev)
 	return ret;
 }
 
+/*
+ * Command line control of asynchronous probing:
+ *
+ * driver_async_probe=<drv>[,<drv>...]
+ *	Probe the named drivers asynchronously. "*" makes asynchronous
+ *	probing the default, and a driver named next to "*" is then probed
+ *	synchronously instead. "!<drv>" always probes <drv> synchronously.
+ *
+ * driver_async_probe_bus=<bus>[,<bus>...]
+ *	Probe all the drivers on the named buses, such as "pci",
+ *	asynchronously. Drivers can be excluded with "!<drv>" in
+ *	driver_async_probe=.
+ *
+ * Drivers which set PROBE_PREFER_ASYNCHRONOUS or PROBE_FORCE_SYNCHRONOUS
+ * are not affected by either option.
+ */
+static bool cmdline_excluded_async_probing(const char *drv_name)
+{
+	const char *p = async_probe_drv_names;
+	size_t len = strlen(drv_name);
+
+	while (*p) {
+		if (*p == '!' && !strncmp(p + 1, drv_name, len) &&
+		    (p[len + 1] == ',' || !p[len + 1]))
+			return true;
+
+		p = strchrnul(p, ',');
+		if (*p)
+			p++;
+	}
+
+	return false;
+}
+
 static inline bool cmdline_requested_async_probing(const char *drv_name)
 {
 	bool async_drv;
@@ -843,6 +878,24 @@ static int __init save_async_options(char *buf)
 }
 __setup("driver_async_probe=", save_async_options);
 
+static inline bool bus_requested_async_probing(struct device_driver *drv)
+{
+	return drv->bus && parse_option_str(async_probe_bus_names,
+					    drv->bus->name);
+}
+
+/* The option format is "driver_async_probe_bus=bus_name1,bus_name2,..." */
+static int __init save_async_bus_options(char *buf)
+{
+	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
+		pr_warn("Too long list of bus names for 'driver_async_probe_bus'!\n");
+
+	strscpy(async_probe_bus_names, buf, ASYNC_DRV_NAMES_MAX_LEN);
+
+	return 1;
+}
+__setup("driver_async_probe_bus=", save_async_bus_options);
+
 static bool driver_allows_async_probing(struct device_driver *drv)
 {
 	switch (drv->probe_type) {
@@ -853,12 +906,18 @@ static bool driver_allows_async_probing(struct device_driver *drv)
 		return false;
 
 	default:
+		if (cmdline_excluded_async_probing(drv->name))
+			return false;
+
 		if (cmdline_requested_async_probing(drv->name))
 			return true;
 
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
+		if (bus_requested_async_probing(drv))
+			return true;
+
 		return false;
 	}
 }
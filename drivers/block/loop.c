@@ -81,6 +81,7 @@ struct loop_device {
 struct loop_cmd {
 	struct list_head list_entry;
 	bool use_aio; /* use AIO interface to handle I/O */
+	bool nowait; /* issued from ->queue_rq with IOCB_NOWAIT */
 	atomic_t ref; /* only for aio */
 	long ret;
 	struct kiocb iocb;
@@ -341,6 +342,17 @@ static void lo_complete_rq(struct request *rq)
 	struct loop_cmd *cmd = blk_mq_rq_to_pdu(rq);
 	blk_status_t ret = BLK_STS_OK;
 
+	/*
+	 * The backing file could not take a NOWAIT request without
+	 * blocking.  Requeue it, ->queue_rq will hand it to the worker.
+	 */
+	if (cmd->nowait && cmd->ret == -EAGAIN) {
+		cmd->ret = 0;
+		blk_mq_requeue_request(rq, true);
+		return;
+	}
+	cmd->nowait = false;
+
 	if (!cmd->use_aio || cmd->ret < 0 || cmd->ret == blk_rq_bytes(rq) ||
 	    req_op(rq) != REQ_OP_READ) {
 		if (cmd->ret < 0)
@@ -392,7 +404,7 @@ static void lo_rw_aio_complete(struct kiocb *iocb, long ret)
 }
 
 static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
-		     loff_t pos, int rw)
+		     loff_t pos, int rw, bool nowait)
 {
 	struct iov_iter iter;
 	struct req_iterator rq_iter;
@@ -446,6 +458,8 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	cmd->iocb.ki_filp = file;
 	cmd->iocb.ki_complete = lo_rw_aio_complete;
 	cmd->iocb.ki_flags = IOCB_DIRECT;
+	if (nowait)
+		cmd->iocb.ki_flags |= IOCB_NOWAIT;
 	cmd->iocb.ki_ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
 
 	if (rw == ITER_SOURCE)
@@ -453,6 +467,13 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	else
 		ret = call_read_iter(file, &cmd->iocb, &iter);
 
+	/* Nothing was issued, the caller retries from the worker. */
+	if (nowait && ret == -EAGAIN) {
+		kfree(cmd->bvec);
+		cmd->bvec = NULL;
+		return -EAGAIN;
+	}
+
 	lo_rw_aio_do_completion(cmd);
 
 	if (ret != -EIOCBQUEUED)
@@ -490,12 +511,12 @@ static int do_req_filebacked(struct loop_device *lo, struct request *rq)
 		return lo_fallocate(lo, rq, pos, FALLOC_FL_PUNCH_HOLE);
 	case REQ_OP_WRITE:
 		if (cmd->use_aio)
-			return lo_rw_aio(lo, cmd, pos, ITER_SOURCE);
+			return lo_rw_aio(lo, cmd, pos, ITER_SOURCE, false);
 		else
 			return lo_write_simple(lo, rq, pos);
 	case REQ_OP_READ:
 		if (cmd->use_aio)
-			return lo_rw_aio(lo, cmd, pos, ITER_DEST);
+			return lo_rw_aio(lo, cmd, pos, ITER_DEST, false);
 		else
 			return lo_read_simple(lo, rq, pos);
 	default:
@@ -1805,9 +1826,116 @@ static const struct kernel_param_ops loop_hw_qdepth_param_ops = {
 device_param_cb(hw_queue_depth, &loop_hw_qdepth_param_ops, &hw_queue_depth, 0444);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 128");
 
+static int nr_hw_queues = 1;
+
+static int loop_set_nr_hw_queues(const char *s, const struct kernel_param *p)
+{
+	int ret = kstrtoint(s, 10, &nr_hw_queues);
+
+	return (ret || (nr_hw_queues < 1)) ? -EINVAL : 0;
+}
+
+static const struct kernel_param_ops loop_nr_hw_queues_param_ops = {
+	.set	= loop_set_nr_hw_queues,
+	.get	= param_get_int,
+};
+
+device_param_cb(nr_hw_queues, &loop_nr_hw_queues_param_ops, &nr_hw_queues, 0444);
+MODULE_PARM_DESC(nr_hw_queues, "Number of hardware queues. Default: 1");
+
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
+/*
+ * The worker charges the I/O and its memory to the cgroup of the first bio.
+ * Issuing inline charges them to the submitter instead, so that is only
+ * done when the two are the same.
+ */
+static bool loop_nowait_css_match(struct request *rq)
+{
+#ifdef CONFIG_BLK_CGROUP
+	struct cgroup_subsys_state *blkcg_css;
+	bool match;
+
+	if (!rq->bio)
+		return true;
+	blkcg_css = bio_blkcg_css(rq->bio);
+	if (!blkcg_css)
+		return false;
+
+	rcu_read_lock();
+	match = blkcg_css == task_css(current, io_cgrp_id);
+	rcu_read_unlock();
+#ifdef CONFIG_MEMCG
+	if (match) {
+		struct cgroup_subsys_state *memcg_css;
+
+		memcg_css = cgroup_get_e_css(blkcg_css->cgroup,
+					     &memory_cgrp_subsys);
+		rcu_read_lock();
+		match = memcg_css == task_css(current, memory_cgrp_id);
+		rcu_read_unlock();
+		css_put(memcg_css);
+	}
+#endif
+	return match;
+#else
+	return true;
+#endif
+}
+
+/*
+ * Direct I/O reads and writes against a backing file that supports NOWAIT
+ * are first issued straight from ->queue_rq, in the context and on the CPU
+ * of the submitter.  Only if the backing file would block is the command
+ * punted to the per-cgroup worker.
+ */
+static bool loop_try_nowait(struct loop_device *lo, struct loop_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+	loff_t pos = ((loff_t) blk_rq_pos(rq) << 9) + lo->lo_offset;
+	unsigned int noio_flags;
+	int rw, ret;
+
+	if (!cmd->use_aio || !(lo->lo_backing_file->f_mode & FMODE_NOWAIT))
+		return false;
+
+	/*
+	 * A submitter inside a filesystem transaction, or in memory reclaim,
+	 * must not recurse into the backing filesystem: it could deadlock on
+	 * its own journal handle or reclaim locks.  The worker has neither.
+	 */
+	if (current->journal_info ||
+	    (current->flags & (PF_MEMALLOC | PF_MEMALLOC_NOFS | PF_MEMALLOC_NOIO)))
+		return false;
+
+	if (!loop_nowait_css_match(rq))
+		return false;
+
+	switch (req_op(rq)) {
+	case REQ_OP_READ:
+		rw = ITER_DEST;
+		break;
+	case REQ_OP_WRITE:
+		if (lo->lo_flags & LO_FLAGS_READ_ONLY)
+			return false;
+		rw = ITER_SOURCE;
+		break;
+	default:
+		return false;
+	}
+
+	cmd->nowait = true;
+	noio_flags = memalloc_noio_save();
+	ret = lo_rw_aio(lo, cmd, pos, rw, true);
+	memalloc_noio_restore(noio_flags);
+	if (ret) {
+		cmd->nowait = false;
+		return false;
+	}
+	return true;
+}
+
 static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
@@ -1831,6 +1959,12 @@ static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		break;
 	}
 
+	/* a command bounced back from a NOWAIT attempt goes to the worker */
+	if (cmd->nowait)
+		cmd->nowait = false;
+	else if (loop_try_nowait(lo, cmd))
+		return BLK_STS_OK;
+
 	/* always use the first bio's css */
 	cmd->blkcg_css = NULL;
 	cmd->memcg_css = NULL;
@@ -1977,12 +2111,12 @@ static int loop_add(int i)
 	i = err;
 
 	lo->tag_set.ops = &loop_mq_ops;
-	lo->tag_set.nr_hw_queues = 1;
+	lo->tag_set.nr_hw_queues = nr_hw_queues;
 	lo->tag_set.queue_depth = hw_queue_depth;
 	lo->tag_set.numa_node = NUMA_NO_NODE;
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
 	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_STACKING |
-		BLK_MQ_F_NO_SCHED_BY_DEFAULT;
+		BLK_MQ_F_NO_SCHED_BY_DEFAULT | BLK_MQ_F_BLOCKING;
 	lo->tag_set.driver_data = lo;
 
 	err = blk_mq_alloc_tag_set(&lo->tag_set);
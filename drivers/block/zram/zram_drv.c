@@ -650,18 +650,189 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 #define IDLE_WRITEBACK			(1<<1)
 #define INCOMPRESSIBLE_WRITEBACK	(1<<2)
 
+/*
+ * Number of pages written back per batch.  The backing device blocks are
+ * allocated in ascending order, so a batch submitted under one plug is
+ * usually merged into a few large sequential writes.
+ */
+#define ZRAM_WB_BATCH			32
+
+struct zram_wb_req {
+	unsigned long index;
+	unsigned long blk_idx;
+	struct page *page;
+	struct bio bio;
+	struct bio_vec bio_vec;
+};
+
+struct zram_wb_batch {
+	int nr_reqs;
+	atomic_t pending;
+	struct completion done;
+	struct zram_wb_req reqs[ZRAM_WB_BATCH];
+};
+
+static void zram_wb_batch_free(struct zram *zram, struct zram_wb_batch *wb)
+{
+	int i;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		struct zram_wb_req *req = &wb->reqs[i];
+
+		if (req->blk_idx)
+			free_block_bdev(zram, req->blk_idx);
+		if (req->page)
+			__free_page(req->page);
+	}
+	kfree(wb);
+}
+
+static struct zram_wb_batch *zram_wb_batch_alloc(struct zram *zram)
+{
+	struct zram_wb_batch *wb;
+	int i;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return NULL;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		wb->reqs[i].page = alloc_page(GFP_KERNEL);
+		if (!wb->reqs[i].page) {
+			zram_wb_batch_free(zram, wb);
+			return NULL;
+		}
+	}
+	init_completion(&wb->done);
+
+	return wb;
+}
+
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_batch *wb = bio->bi_private;
+
+	if (atomic_dec_and_test(&wb->pending))
+		complete(&wb->done);
+}
+
+static void zram_wb_finish_req(struct zram *zram, struct zram_wb_req *req)
+{
+	unsigned long index = req->index;
+
+	atomic64_inc(&zram->stats.bd_writes);
+	/*
+	 * We released zram_slot_lock so need to check if the slot was
+	 * changed. If there is freeing for the slot, we can catch it
+	 * easily by zram_allocated.
+	 * A subtle case is the slot is freed/reallocated/marked as
+	 * ZRAM_IDLE again. To close the race, idle_store doesn't
+	 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+	 * Thus, we could close the race by checking ZRAM_IDLE bit.
+	 */
+	zram_slot_lock(zram, index);
+	if (!zram_allocated(zram, index) ||
+		  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		goto out;
+	}
+
+	zram_free_page(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram_set_element(zram, index, req->blk_idx);
+	req->blk_idx = 0;
+	atomic64_inc(&zram->stats.pages_stored);
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+		zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+out:
+	zram_slot_unlock(zram, index);
+}
+
+/*
+ * Write out all requests of the batch and wait for them.  Requests whose
+ * block did not end up being used keep it for the next round.
+ */
+static int zram_wb_flush(struct zram *zram, struct zram_wb_batch *wb)
+{
+	struct blk_plug plug;
+	int i, ret = 0;
+
+	if (!wb->nr_reqs)
+		return 0;
+
+	atomic_set(&wb->pending, wb->nr_reqs);
+	blk_start_plug(&plug);
+	for (i = 0; i < wb->nr_reqs; i++) {
+		struct zram_wb_req *req = &wb->reqs[i];
+
+		bio_init(&req->bio, zram->bdev, &req->bio_vec, 1,
+			 REQ_OP_WRITE | REQ_SYNC);
+		req->bio.bi_iter.bi_sector = req->blk_idx * (PAGE_SIZE >> 9);
+		req->bio.bi_end_io = zram_wb_end_io;
+		req->bio.bi_private = wb;
+		__bio_add_page(&req->bio, req->page, PAGE_SIZE, 0);
+		submit_bio(&req->bio);
+	}
+	blk_finish_plug(&plug);
+	wait_for_completion(&wb->done);
+	reinit_completion(&wb->done);
+
+	for (i = 0; i < wb->nr_reqs; i++) {
+		struct zram_wb_req *req = &wb->reqs[i];
+		int err = blk_status_to_errno(req->bio.bi_status);
+
+		bio_uninit(&req->bio);
+		if (err) {
+			zram_slot_lock(zram, req->index);
+			zram_clear_flag(zram, req->index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, req->index, ZRAM_IDLE);
+			zram_slot_unlock(zram, req->index);
+			/*
+			 * BIO errors are not fatal, we continue and simply
+			 * attempt to writeback the remaining objects (pages).
+			 * At the same time we need to signal user-space that
+			 * some writes (at least one, but also could be all of
+			 * them) were not successful and we do so by returning
+			 * the most recent BIO error.
+			 */
+			ret = err;
+			continue;
+		}
+		zram_wb_finish_req(zram, req);
+	}
+	wb->nr_reqs = 0;
+
+	return ret;
+}
+
+/*
+ * Can one more page be written back on top of the ones already batched?
+ */
+static bool zram_wb_limit_ok(struct zram *zram, int nr_batched)
+{
+	bool ok;
+
+	spin_lock(&zram->wb_limit_lock);
+	ok = !zram->wb_limit_enable ||
+	     zram->bd_wb_limit > (u64)nr_batched << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+
+	return ok;
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
 	unsigned long index = 0;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
+	struct zram_wb_batch *wb;
 	ssize_t ret = len;
 	int mode, err;
-	unsigned long blk_idx = 0;
 
 	if (sysfs_streq(buf, "idle"))
 		mode = IDLE_WRITEBACK;
@@ -694,30 +865,30 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
+	wb = zram_wb_batch_alloc(zram);
+	if (!wb) {
 		ret = -ENOMEM;
 		goto release_init_lock;
 	}
 
 	for (; nr_pages != 0; index++, nr_pages--) {
+		struct zram_wb_req *req;
 		struct bio_vec bvec;
 
-		bvec.bv_page = page;
-		bvec.bv_len = PAGE_SIZE;
-		bvec.bv_offset = 0;
-
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
-			spin_unlock(&zram->wb_limit_lock);
-			ret = -EIO;
-			break;
+		if (!zram_wb_limit_ok(zram, wb->nr_reqs)) {
+			err = zram_wb_flush(zram, wb);
+			if (err)
+				ret = err;
+			if (!zram_wb_limit_ok(zram, 0)) {
+				ret = -EIO;
+				break;
+			}
 		}
-		spin_unlock(&zram->wb_limit_lock);
 
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
+		req = &wb->reqs[wb->nr_reqs];
+		if (!req->blk_idx) {
+			req->blk_idx = alloc_block_bdev(zram);
+			if (!req->blk_idx) {
 				ret = -ENOSPC;
 				break;
 			}
@@ -750,77 +921,33 @@ static ssize_t writeback_store(struct device *dev,
 		/* Need for hugepage writeback racing */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
-		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
-		}
-
-		bio_init(&bio, zram->bdev, &bio_vec, 1,
-			 REQ_OP_WRITE | REQ_SYNC);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
 
-		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
-				bvec.bv_offset);
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		err = submit_bio_wait(&bio);
-		if (err) {
+		bvec.bv_page = req->page;
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
 			zram_slot_lock(zram, index);
 			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 			zram_clear_flag(zram, index, ZRAM_IDLE);
 			zram_slot_unlock(zram, index);
-			/*
-			 * BIO errors are not fatal, we continue and simply
-			 * attempt to writeback the remaining objects (pages).
-			 * At the same time we need to signal user-space that
-			 * some writes (at least one, but also could be all of
-			 * them) were not successful and we do so by returning
-			 * the most recent BIO error.
-			 */
-			ret = err;
 			continue;
 		}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+		req->index = index;
+		if (++wb->nr_reqs == ZRAM_WB_BATCH) {
+			err = zram_wb_flush(zram, wb);
+			if (err)
+				ret = err;
 		}
-
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
+		continue;
 next:
 		zram_slot_unlock(zram, index);
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
-	__free_page(page);
+	err = zram_wb_flush(zram, wb);
+	if (err)
+		ret = err;
+	zram_wb_batch_free(zram, wb);
 release_init_lock:
 	up_read(&zram->init_lock);
 
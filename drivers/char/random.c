@@ -427,6 +427,19 @@ static ssize_t get_random_bytes_user(struct iov_iter *iter)
 	if (unlikely(!iov_iter_count(iter)))
 		return 0;
 
+	/*
+	 * Reads of a UUID or nonce worth of bytes are by far the most common
+	 * request, so serve them from the per-CPU u64 batches, which already
+	 * track the crng generation and erase each word as it is handed out.
+	 */
+	if (iov_iter_count(iter) <= sizeof(u64) * 2 && crng_ready()) {
+		u64 words[2] = { get_random_u64(), get_random_u64() };
+
+		ret = copy_to_iter(words, iov_iter_count(iter), iter);
+		memzero_explicit(words, sizeof(words));
+		return ret ? ret : -EFAULT;
+	}
+
 	/*
 	 * Immediately overwrite the ChaCha key at index 4 with random
 	 * bytes, in case userspace causes copy_to_iter() below to sleep
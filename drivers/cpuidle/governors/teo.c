@@ -99,9 +99,18 @@
  *      select the given idle state instead of the candidate one.
  *
  * 3. By default, select the candidate state.
+ *
+ * With %CONFIG_CPU_IDLE_GOV_TEO_IRQ set, the sleep length is additionally
+ * capped with the time till the next device interrupt predicted by the IRQ
+ * timings code, which keeps a separate history for every interrupt source
+ * and detects periodic ones (like network adapters doing interrupt
+ * moderation).  Wakeups by such devices are then counted as "hits" in the
+ * same way as timer wakeups and the "intercepts" metrics only reflect the
+ * sources that cannot be predicted, like IPIs.
  */
 
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/sched/clock.h>
@@ -241,6 +250,28 @@ static void teo_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	cpu_data->total += PULSE;
 }
 
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ
+/**
+ * teo_irq_sleep_length - Cap the sleep length with the next predicted IRQ.
+ * @now: Current local_clock() value.
+ * @sleep_length_ns: Time till the closest timer event.
+ */
+static s64 teo_irq_sleep_length(u64 now, s64 sleep_length_ns)
+{
+	u64 next_irq = irq_timings_next_event(now);
+
+	if (next_irq > now && next_irq - now < (u64)sleep_length_ns)
+		return next_irq - now;
+
+	return sleep_length_ns;
+}
+#else
+static s64 teo_irq_sleep_length(u64 now, s64 sleep_length_ns)
+{
+	return sleep_length_ns;
+}
+#endif
+
 static bool teo_time_ok(u64 interval_ns)
 {
 	return !tick_nohz_tick_stopped() || interval_ns >= TICK_NSEC;
@@ -308,6 +339,7 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	cpu_data->time_span_ns = local_clock();
 
 	duration_ns = tick_nohz_get_sleep_length(&delta_tick);
+	duration_ns = teo_irq_sleep_length(cpu_data->time_span_ns, duration_ns);
 	cpu_data->sleep_length_ns = duration_ns;
 
 	/* Check if there is any choice in the first place. */
@@ -528,6 +560,9 @@ static struct cpuidle_governor teo_governor = {
 
 static int __init teo_governor_init(void)
 {
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ
+	irq_timings_enable();
+#endif
 	return cpuidle_register_governor(&teo_governor);
 }
 
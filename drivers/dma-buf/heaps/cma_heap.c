@@ -264,6 +264,7 @@ static void cma_heap_dma_buf_release(struct dma_buf *dmabuf)
 }
 
 static const struct dma_buf_ops cma_heap_buf_ops = {
+	.cache_sgt_mapping = true,
 	.attach = cma_heap_attach,
 	.detach = cma_heap_detach,
 	.map_dma_buf = cma_heap_map_dma_buf,
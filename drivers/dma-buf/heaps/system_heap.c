@@ -303,6 +303,7 @@ static void system_heap_dma_buf_release(struct dma_buf *dmabuf)
 }
 
 static const struct dma_buf_ops system_heap_buf_ops = {
+	.cache_sgt_mapping = true,
 	.attach = system_heap_attach,
 	.detach = system_heap_detach,
 	.map_dma_buf = system_heap_map_dma_buf,
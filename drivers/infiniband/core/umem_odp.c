@@ -207,6 +207,30 @@ ib_umem_odp_alloc_child(struct ib_umem_odp *root, unsigned long addr,
 }
 EXPORT_SYMBOL(ib_umem_odp_alloc_child);
 
+#ifdef CONFIG_HUGETLB_PAGE
+/*
+ * The MR is backed by hugetlbfs: map it at the huge page size of the VMA
+ * it lives in, so a region in 1GB pages is not tracked and faulted in at
+ * the default huge page size. If there is no hugetlb VMA at the start of
+ * the MR yet, keep using the default huge page size as before.
+ */
+static unsigned int ib_umem_odp_hugetlb_shift(struct ib_umem_odp *umem_odp)
+{
+	struct mm_struct *mm = umem_odp->umem.owning_mm;
+	unsigned long start = umem_odp->umem.address;
+	unsigned int shift = HPAGE_SHIFT;
+	struct vm_area_struct *vma;
+
+	mmap_read_lock(mm);
+	vma = vma_lookup(mm, start);
+	if (vma && is_vm_hugetlb_page(vma))
+		shift = huge_page_shift(hstate_vma(vma));
+	mmap_read_unlock(mm);
+
+	return shift;
+}
+#endif
+
 /**
  * ib_umem_odp_get - Create a umem_odp for a userspace va
  *
@@ -244,7 +268,7 @@ struct ib_umem_odp *ib_umem_odp_get(struct ib_device *device,
 	umem_odp->page_shift = PAGE_SHIFT;
 #ifdef CONFIG_HUGETLB_PAGE
 	if (access & IB_ACCESS_HUGETLB)
-		umem_odp->page_shift = HPAGE_SHIFT;
+		umem_odp->page_shift = ib_umem_odp_hugetlb_shift(umem_odp);
 #endif
 
 	umem_odp->tgid = get_task_pid(current->group_leader, PIDTYPE_PID);
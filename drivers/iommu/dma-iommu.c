@@ -50,6 +50,10 @@ struct iommu_dma_cookie {
 			struct iova_domain	iovad;
 
 			struct iova_fq __percpu *fq;	/* Flush queue */
+			/* Entries per flush queue, a power of two */
+			unsigned int		fq_size;
+			/* Timeout (in ms) after which queued entries are flushed */
+			unsigned int		fq_timeout;
 			/* Number of TLB flushes that have been started */
 			atomic64_t		fq_flush_start_cnt;
 			/* Number of TLB flushes that have been finished */
@@ -82,12 +86,50 @@ static int __init iommu_dma_forcedac_setup(char *str)
 }
 early_param("iommu.forcedac", iommu_dma_forcedac_setup);
 
-/* Number of entries per flush queue */
+/* Default number of entries per flush queue */
 #define IOVA_FQ_SIZE	256
 
-/* Timeout (in ms) after which entries are flushed from the queue */
+/* Largest flush queue that still fits a per-CPU allocation */
+#define IOVA_FQ_MAX_SIZE	512
+
+/* Default timeout (in ms) after which entries are flushed from the queue */
 #define IOVA_FQ_TIMEOUT	10
 
+/*
+ * Bounds on how long an unmapped IOVA may stay reachable through stale
+ * IOTLB entries.  Domains pick these up when their flush queue is set up.
+ */
+static unsigned int iommu_dma_fq_size __read_mostly = IOVA_FQ_SIZE;
+static unsigned int iommu_dma_fq_timeout __read_mostly = IOVA_FQ_TIMEOUT;
+
+static int __init iommu_dma_fq_size_setup(char *str)
+{
+	unsigned int size;
+	int ret = kstrtouint(str, 0, &size);
+
+	if (ret)
+		return ret;
+	if (size < 2 || size > IOVA_FQ_MAX_SIZE)
+		return -EINVAL;
+	iommu_dma_fq_size = roundup_pow_of_two(size);
+	return 0;
+}
+early_param("iommu.fq_size", iommu_dma_fq_size_setup);
+
+static int __init iommu_dma_fq_timeout_setup(char *str)
+{
+	unsigned int timeout;
+	int ret = kstrtouint(str, 0, &timeout);
+
+	if (ret)
+		return ret;
+	if (!timeout)
+		return -EINVAL;
+	iommu_dma_fq_timeout = timeout;
+	return 0;
+}
+early_param("iommu.fq_timeout", iommu_dma_fq_timeout_setup);
+
 /* Flush queue entry for deferred flushing */
 struct iova_fq_entry {
 	unsigned long iova_pfn;
@@ -98,18 +140,19 @@ struct iova_fq_entry {
 
 /* Per-CPU flush queue structure */
 struct iova_fq {
-	struct iova_fq_entry entries[IOVA_FQ_SIZE];
-	unsigned int head, tail;
 	spinlock_t lock;
+	unsigned int head, tail;
+	unsigned int mod_mask;
+	struct iova_fq_entry entries[];
 };
 
 #define fq_ring_for_each(i, fq) \
-	for ((i) = (fq)->head; (i) != (fq)->tail; (i) = ((i) + 1) % IOVA_FQ_SIZE)
+	for ((i) = (fq)->head; (i) != (fq)->tail; (i) = ((i) + 1) & (fq)->mod_mask)
 
 static inline bool fq_full(struct iova_fq *fq)
 {
 	assert_spin_locked(&fq->lock);
-	return (((fq->tail + 1) % IOVA_FQ_SIZE) == fq->head);
+	return (((fq->tail + 1) & fq->mod_mask) == fq->head);
 }
 
 static inline unsigned int fq_ring_add(struct iova_fq *fq)
@@ -118,7 +161,7 @@ static inline unsigned int fq_ring_add(struct iova_fq *fq)
 
 	assert_spin_locked(&fq->lock);
 
-	fq->tail = (idx + 1) % IOVA_FQ_SIZE;
+	fq->tail = (idx + 1) & fq->mod_mask;
 
 	return idx;
 }
@@ -140,7 +183,7 @@ static void fq_ring_free(struct iommu_dma_cookie *cookie, struct iova_fq *fq)
 			       fq->entries[idx].iova_pfn,
 			       fq->entries[idx].pages);
 
-		fq->head = (fq->head + 1) % IOVA_FQ_SIZE;
+		fq->head = (fq->head + 1) & fq->mod_mask;
 	}
 }
 
@@ -215,7 +258,7 @@ static void queue_iova(struct iommu_dma_cookie *cookie,
 	if (!atomic_read(&cookie->fq_timer_on) &&
 	    !atomic_xchg(&cookie->fq_timer_on, 1))
 		mod_timer(&cookie->fq_timer,
-			  jiffies + msecs_to_jiffies(IOVA_FQ_TIMEOUT));
+			  jiffies + msecs_to_jiffies(cookie->fq_timeout));
 }
 
 static void iommu_dma_free_fq(struct iommu_dma_cookie *cookie)
@@ -250,7 +293,11 @@ int iommu_dma_init_fq(struct iommu_domain *domain)
 	atomic64_set(&cookie->fq_flush_start_cnt,  0);
 	atomic64_set(&cookie->fq_flush_finish_cnt, 0);
 
-	queue = alloc_percpu(struct iova_fq);
+	cookie->fq_size = READ_ONCE(iommu_dma_fq_size);
+	cookie->fq_timeout = READ_ONCE(iommu_dma_fq_timeout);
+
+	queue = __alloc_percpu(struct_size(queue, entries, cookie->fq_size),
+			       __alignof__(*queue));
 	if (!queue) {
 		pr_warn("iova flush queue initialization failed\n");
 		return -ENOMEM;
@@ -261,10 +308,11 @@ int iommu_dma_init_fq(struct iommu_domain *domain)
 
 		fq->head = 0;
 		fq->tail = 0;
+		fq->mod_mask = cookie->fq_size - 1;
 
 		spin_lock_init(&fq->lock);
 
-		for (i = 0; i < IOVA_FQ_SIZE; i++)
+		for (i = 0; i < cookie->fq_size; i++)
 			INIT_LIST_HEAD(&fq->entries[i].freelist);
 	}
 
@@ -13,6 +13,7 @@
 #include <linux/jiffies.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/seqlock.h>
 #include <linux/vmalloc.h>
 #include <linux/math64.h>
 
@@ -827,6 +828,13 @@ struct smq_policy {
 	struct stats hotspot_stats;
 	struct stats cache_stats;
 
+	/*
+	 * Cache hits taken by the lockless lookup path, folded into
+	 * cache_stats under the lock.
+	 */
+	atomic_t fast_hits;
+	atomic_t fast_misses;
+
 	/*
 	 * Keeps track of time, incremented by the core.  We use this to
 	 * avoid attributing multiple hits within the same tick.
@@ -835,8 +843,10 @@ struct smq_policy {
 
 	/*
 	 * The hash tables allows us to quickly find an entry by origin
-	 * block.
+	 * block.  Changes to the cache table are bracketed by table_seq so
+	 * that hits can be looked up without taking the lock.
 	 */
+	seqcount_spinlock_t table_seq;
 	struct smq_hash_table table;
 	struct smq_hash_table hotspot_table;
 
@@ -960,10 +970,65 @@ static void push_queue(struct smq_policy *mq, struct entry *e)
 		q_push(&mq->clean, e);
 }
 
+static void table_insert(struct smq_policy *mq, struct entry *e)
+{
+	write_seqcount_begin(&mq->table_seq);
+	h_insert(&mq->table, e);
+	write_seqcount_end(&mq->table_seq);
+}
+
+static void table_remove(struct smq_policy *mq, struct entry *e)
+{
+	write_seqcount_begin(&mq->table_seq);
+	h_remove(&mq->table, e);
+	write_seqcount_end(&mq->table_seq);
+}
+
+static struct entry *table_lookup(struct smq_policy *mq, dm_oblock_t oblock)
+{
+	struct entry *e;
+
+	/* h_lookup() moves hits to the front of their bucket */
+	write_seqcount_begin(&mq->table_seq);
+	e = h_lookup(&mq->table, oblock);
+	write_seqcount_end(&mq->table_seq);
+
+	return e;
+}
+
+/*
+ * Entries live in the preallocated entry space and are never freed, so a
+ * walk racing with an update can at worst follow a stale chain.  Give up
+ * as soon as the sequence count says so.
+ */
+static struct entry *table_lookup_lockless(struct smq_policy *mq, dm_oblock_t oblock,
+					   unsigned seq)
+{
+	struct smq_hash_table *ht = &mq->table;
+	unsigned h = hash_64(from_oblock(oblock), ht->hash_bits);
+	struct entry *e;
+
+	for (e = to_entry(ht->es, READ_ONCE(ht->buckets[h])); e; e = h_next(ht, e)) {
+		if (read_seqcount_retry(&mq->table_seq, seq))
+			return NULL;
+
+		if (e->oblock == oblock)
+			return e;
+	}
+
+	return NULL;
+}
+
+static void stats_fold_fast(struct smq_policy *mq)
+{
+	mq->cache_stats.hits += atomic_xchg(&mq->fast_hits, 0);
+	mq->cache_stats.misses += atomic_xchg(&mq->fast_misses, 0);
+}
+
 // !h, !q, a -> h, q, a
 static void push(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue(mq, e);
 }
@@ -978,7 +1043,7 @@ static void push_queue_front(struct smq_policy *mq, struct entry *e)
 
 static void push_front(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue_front(mq, e);
 }
@@ -1030,9 +1095,12 @@ static unsigned default_promote_level(struct smq_policy *mq)
 		1, 1, 1, 2, 4, 6, 7, 8, 7, 6, 4, 4, 3, 3, 2, 2, 1
 	};
 
-	unsigned hits = mq->cache_stats.hits;
-	unsigned misses = mq->cache_stats.misses;
-	unsigned index = safe_div(hits << 4u, hits + misses);
+	unsigned hits, misses, index;
+
+	stats_fold_fast(mq);
+	hits = mq->cache_stats.hits;
+	misses = mq->cache_stats.misses;
+	index = safe_div(hits << 4u, hits + misses);
 	return table[index];
 }
 
@@ -1110,6 +1178,7 @@ static void end_cache_period(struct smq_policy *mq)
 
 		q_redistribute(&mq->dirty);
 		q_redistribute(&mq->clean);
+		stats_fold_fast(mq);
 		stats_reset(&mq->cache_stats);
 
 		mq->next_cache_period = jiffies + CACHE_UPDATE_PERIOD;
@@ -1373,7 +1442,7 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 
 	*background_work = false;
 
-	e = h_lookup(&mq->table, oblock);
+	e = table_lookup(mq, oblock);
 	if (e) {
 		stats_level_accessed(&mq->cache_stats, e->level);
 
@@ -1399,6 +1468,37 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 	}
 }
 
+/*
+ * Most lookups are repeated hits on blocks that are already in the cache.
+ * Only the first hit on an entry within a cache period requeues it, so
+ * later ones can be served without the lock; they just get counted.
+ */
+static bool __lookup_fast(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblock)
+{
+	struct entry *e;
+	unsigned seq, level;
+
+	seq = read_seqcount_begin(&mq->table_seq);
+	e = table_lookup_lockless(mq, oblock, seq);
+	if (!e)
+		return false;
+
+	*cblock = infer_cblock(mq, e);
+	if (!test_bit(from_cblock(*cblock), mq->cache_hit_bits))
+		return false;
+
+	level = e->level;
+	if (read_seqcount_retry(&mq->table_seq, seq))
+		return false;
+
+	if (level >= mq->cache_stats.hit_threshold)
+		atomic_inc(&mq->fast_hits);
+	else
+		atomic_inc(&mq->fast_misses);
+
+	return true;
+}
+
 static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t *cblock,
 		      int data_dir, bool fast_copy,
 		      bool *background_work)
@@ -1407,6 +1507,11 @@ static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (__lookup_fast(mq, oblock, cblock)) {
+		*background_work = false;
+		return 0;
+	}
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock,
 		     data_dir, fast_copy,
@@ -1426,6 +1531,11 @@ static int smq_lookup_with_work(struct dm_cache_policy *p,
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (__lookup_fast(mq, oblock, cblock)) {
+		*work = NULL;
+		return 0;
+	}
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock, data_dir, fast_copy, work, &background_queued);
 	spin_unlock_irqrestore(&mq->lock, flags);
@@ -1482,7 +1592,7 @@ static void __complete_background_work(struct smq_policy *mq,
 	case POLICY_DEMOTE:
 		// h, !q, a
 		if (success) {
-			h_remove(&mq->table, e);
+			table_remove(mq, e);
 			free_entry(&mq->cache_alloc, e);
 			// !h, !q, !a
 		} else {
@@ -1560,7 +1670,9 @@ static int smq_load_mapping(struct dm_cache_policy *p,
 {
 	struct smq_policy *mq = to_smq_policy(p);
 	struct entry *e;
+	unsigned long flags;
 
+	spin_lock_irqsave(&mq->lock, flags);
 	e = alloc_particular_entry(&mq->cache_alloc, from_cblock(cblock));
 	e->oblock = oblock;
 	e->dirty = dirty;
@@ -1572,6 +1684,7 @@ static int smq_load_mapping(struct dm_cache_policy *p,
 	 * allow demotions and cleaning to occur immediately.
 	 */
 	push_front(mq, e);
+	spin_unlock_irqrestore(&mq->lock, flags);
 
 	return 0;
 }
@@ -1580,14 +1693,17 @@ static int smq_invalidate_mapping(struct dm_cache_policy *p, dm_cblock_t cblock)
 {
 	struct smq_policy *mq = to_smq_policy(p);
 	struct entry *e = get_entry(&mq->cache_alloc, from_cblock(cblock));
+	unsigned long flags;
 
 	if (!e->allocated)
 		return -ENODATA;
 
 	// FIXME: what if this block has pending background work?
+	spin_lock_irqsave(&mq->lock, flags);
 	del_queue(mq, e);
-	h_remove(&mq->table, e);
+	table_remove(mq, e);
 	free_entry(&mq->cache_alloc, e);
+	spin_unlock_irqrestore(&mq->lock, flags);
 	return 0;
 }
 
@@ -1780,6 +1896,9 @@ static struct dm_cache_policy *__smq_create(dm_cblock_t cache_size,
 
 	mq->tick = 0;
 	spin_lock_init(&mq->lock);
+	seqcount_spinlock_init(&mq->table_seq, &mq->lock);
+	atomic_set(&mq->fast_hits, 0);
+	atomic_set(&mq->fast_misses, 0);
 
 	q_init(&mq->hotspot, &mq->es, NR_HOTSPOT_LEVELS);
 	mq->hotspot.nr_top_levels = 8;
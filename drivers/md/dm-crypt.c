@@ -16,6 +16,7 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/blk-integrity.h>
+#include <linux/blk-crypto.h>
 #include <linux/mempool.h>
 #include <linux/slab.h>
 #include <linux/crypto.h>
@@ -134,7 +135,8 @@ struct iv_elephant_private {
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
 	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
 	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE,
-	     DM_CRYPT_WRITE_INLINE };
+	     DM_CRYPT_WRITE_INLINE, DM_CRYPT_WANT_INLINE_ENCRYPTION,
+	     DM_CRYPT_INLINE_ENCRYPTION };
 
 enum cipher_flags {
 	CRYPT_MODE_INTEGRITY_AEAD,	/* Use authenticated mode for cipher */
@@ -221,6 +223,10 @@ struct crypt_config {
 	struct mutex bio_alloc_lock;
 
 	u8 *authenc_key; /* space for keys in authenc() format (if used) */
+
+	/* key for the underlying device's inline encryption (if used) */
+	struct blk_crypto_key *inline_key;
+
 	u8 key[];
 };
 
@@ -2372,6 +2378,114 @@ static void crypt_copy_authenckey(char *p, const void *key,
 	memcpy(p, key, enckeylen);
 }
 
+#ifdef CONFIG_BLK_INLINE_ENCRYPTION
+/*
+ * XTS with a plain64 IV that counts encryption sectors produces exactly
+ * what blk-crypto produces with the same sector number as DUN, so such
+ * mappings can use the inline encryption engine of the underlying device
+ * without changing the on-disk format.
+ */
+static enum blk_crypto_mode_num crypt_inline_mode(struct crypt_config *cc)
+{
+	const char *alg;
+
+	if (!test_bit(DM_CRYPT_WANT_INLINE_ENCRYPTION, &cc->flags) ||
+	    crypt_integrity_aead(cc) || cc->integrity_iv_size ||
+	    cc->on_disk_tag_size || cc->tfms_count != 1 ||
+	    cc->key_extra_size || cc->iv_gen_ops != &crypt_iv_plain64_ops)
+		return BLK_ENCRYPTION_MODE_INVALID;
+
+	/* Without iv_large_sectors the IV counts 512-byte sectors */
+	if (cc->sector_size != (1 << SECTOR_SHIFT) &&
+	    !test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags))
+		return BLK_ENCRYPTION_MODE_INVALID;
+
+	alg = crypto_tfm_alg_name(crypto_skcipher_tfm(any_tfm(cc)));
+	if (!strcmp(alg, "xts(aes)") && cc->key_size == 64)
+		return BLK_ENCRYPTION_MODE_AES_256_XTS;
+	if (!strcmp(alg, "xts(sm4)") && cc->key_size == 32)
+		return BLK_ENCRYPTION_MODE_SM4_XTS;
+
+	return BLK_ENCRYPTION_MODE_INVALID;
+}
+
+static void crypt_inline_alloc(struct crypt_config *cc)
+{
+	if (crypt_inline_mode(cc) != BLK_ENCRYPTION_MODE_INVALID)
+		cc->inline_key = kzalloc(sizeof(*cc->inline_key), GFP_KERNEL);
+}
+
+static int crypt_inline_setkey(struct crypt_config *cc)
+{
+	/* The device may still hold the old key in one of its keyslots */
+	if (test_bit(DM_CRYPT_INLINE_ENCRYPTION, &cc->flags))
+		blk_crypto_evict_key(cc->dev->bdev, cc->inline_key);
+
+	return blk_crypto_init_key(cc->inline_key, cc->key, crypt_inline_mode(cc),
+				   sizeof(u64), cc->sector_size);
+}
+
+/*
+ * Only hand the key to the device if it can do the job in hardware;
+ * the blk-crypto fallback would just be a slower dm-crypt.
+ */
+static void crypt_inline_start(struct crypt_config *cc)
+{
+	if (!cc->inline_key)
+		return;
+
+	if (blk_crypto_config_supported_natively(cc->dev->bdev,
+						 &cc->inline_key->crypto_cfg) &&
+	    !blk_crypto_start_using_key(cc->dev->bdev, cc->inline_key)) {
+		DMINFO("%s: using inline encryption of %pg",
+		       cc->cipher_string, cc->dev->bdev);
+		set_bit(DM_CRYPT_INLINE_ENCRYPTION, &cc->flags);
+		return;
+	}
+
+	kfree_sensitive(cc->inline_key);
+	cc->inline_key = NULL;
+}
+
+static void crypt_inline_free(struct crypt_config *cc)
+{
+	if (!cc->inline_key)
+		return;
+
+	if (test_bit(DM_CRYPT_INLINE_ENCRYPTION, &cc->flags))
+		blk_crypto_evict_key(cc->dev->bdev, cc->inline_key);
+	kfree_sensitive(cc->inline_key);
+	cc->inline_key = NULL;
+}
+
+static int crypt_map_inline(struct dm_target *ti, struct bio *bio)
+{
+	struct crypt_config *cc = ti->private;
+	sector_t sector = dm_target_offset(ti, bio->bi_iter.bi_sector);
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE] = { 0 };
+
+	dun[0] = sector + cc->iv_offset;
+	if (test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags))
+		dun[0] >>= cc->sector_shift;
+
+	bio_set_dev(bio, cc->dev->bdev);
+	bio->bi_iter.bi_sector = cc->start + sector;
+	bio_crypt_set_ctx(bio, cc->inline_key, dun, GFP_NOIO);
+
+	return DM_MAPIO_REMAPPED;
+}
+#else
+static inline void crypt_inline_alloc(struct crypt_config *cc) { }
+static inline int crypt_inline_setkey(struct crypt_config *cc) { return 0; }
+static inline void crypt_inline_start(struct crypt_config *cc) { }
+static inline void crypt_inline_free(struct crypt_config *cc) { }
+
+static inline int crypt_map_inline(struct dm_target *ti, struct bio *bio)
+{
+	return DM_MAPIO_KILL;
+}
+#endif
+
 static int crypt_setkey(struct crypt_config *cc)
 {
 	unsigned subkey_size;
@@ -2408,6 +2522,9 @@ static int crypt_setkey(struct crypt_config *cc)
 	if (crypt_integrity_hmac(cc))
 		memzero_explicit(cc->authenc_key, crypt_authenckey_size(cc));
 
+	if (!err && cc->inline_key)
+		err = crypt_inline_setkey(cc);
+
 	return err;
 }
 
@@ -2716,6 +2833,8 @@ static void crypt_dtr(struct dm_target *ti)
 	if (cc->iv_gen_ops && cc->iv_gen_ops->dtr)
 		cc->iv_gen_ops->dtr(cc);
 
+	crypt_inline_free(cc);
+
 	if (cc->dev)
 		dm_put_device(ti, cc->dev);
 
@@ -3029,6 +3148,9 @@ static int crypt_ctr_cipher(struct dm_target *ti, char *cipher_in, char *key)
 	if (ret < 0)
 		return ret;
 
+	/* Prepare for inline encryption, if the mapping allows it */
+	crypt_inline_alloc(cc);
+
 	/* Initialize and set key */
 	ret = crypt_set_key(cc, key);
 	if (ret < 0) {
@@ -3066,7 +3188,7 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 	struct crypt_config *cc = ti->private;
 	struct dm_arg_set as;
 	static const struct dm_arg _args[] = {
-		{0, 8, "Invalid number of feature args"},
+		{0, 9, "Invalid number of feature args"},
 	};
 	unsigned int opt_params, val;
 	const char *opt_string, *sval;
@@ -3100,6 +3222,8 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 			set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		else if (!strcasecmp(opt_string, "no_write_workqueue"))
 			set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		else if (!strcasecmp(opt_string, "inline_encryption"))
+			set_bit(DM_CRYPT_WANT_INLINE_ENCRYPTION, &cc->flags);
 		else if (sscanf(opt_string, "integrity:%u:", &val) == 1) {
 			if (val == 0 || val > MAX_TAG_SIZE) {
 				ti->error = "Invalid integrity arguments";
@@ -3360,6 +3484,8 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	crypt_inline_start(cc);
+
 	ti->num_flush_bios = 1;
 	ti->limit_swap_bios = true;
 	ti->accounts_remapped_io = true;
@@ -3409,6 +3535,14 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 	if (unlikely(bio->bi_iter.bi_size & (cc->sector_size - 1)))
 		return DM_MAPIO_KILL;
 
+	/*
+	 * Let the device encrypt, unless an upper layer already asked for
+	 * inline encryption of its own.
+	 */
+	if (test_bit(DM_CRYPT_INLINE_ENCRYPTION, &cc->flags) &&
+	    !bio_has_crypt_ctx(bio))
+		return crypt_map_inline(ti, bio);
+
 	io = dm_per_bio_data(bio, cc->per_bio_data_size);
 	crypt_io_init(io, cc, bio, dm_target_offset(ti, bio->bi_iter.bi_sector));
 
@@ -3479,6 +3613,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_WANT_INLINE_ENCRYPTION, &cc->flags);
 		num_feature_args += cc->sector_size != (1 << SECTOR_SHIFT);
 		num_feature_args += test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags);
 		if (cc->on_disk_tag_size)
@@ -3495,6 +3630,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" no_read_workqueue");
 			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
 				DMEMIT(" no_write_workqueue");
+			if (test_bit(DM_CRYPT_WANT_INLINE_ENCRYPTION, &cc->flags))
+				DMEMIT(" inline_encryption");
 			if (cc->on_disk_tag_size)
 				DMEMIT(" integrity:%u:%s", cc->on_disk_tag_size, cc->cipher_auth);
 			if (cc->sector_size != (1 << SECTOR_SHIFT))
@@ -3516,6 +3653,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		       'y' : 'n');
 		DMEMIT(",iv_large_sectors=%c", test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags) ?
 		       'y' : 'n');
+		DMEMIT(",inline_encryption=%c",
+		       test_bit(DM_CRYPT_INLINE_ENCRYPTION, &cc->flags) ? 'y' : 'n');
 
 		if (cc->on_disk_tag_size)
 			DMEMIT(",integrity_tag_size=%u,cipher_auth=%s",
@@ -3635,7 +3774,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 24, 0},
+	.version = {1, 25, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -322,6 +322,7 @@ static void release_inactive_stripe_list(struct r5conf *conf,
 					 struct list_head *temp_inactive_list,
 					 int hash)
 {
+	struct stripe_head *sh;
 	int size;
 	bool do_wakeup = false;
 	unsigned long flags;
@@ -343,6 +344,8 @@ static void release_inactive_stripe_list(struct r5conf *conf,
 			if (list_empty(conf->inactive_list + hash) &&
 			    !list_empty(list))
 				atomic_dec(&conf->empty_inactive_list_nr);
+			list_for_each_entry(sh, list, lru)
+				set_bit(STRIPE_ON_INACTIVE_LIST, &sh->state);
 			list_splice_tail_init(list, conf->inactive_list + hash);
 			do_wakeup = true;
 			spin_unlock_irqrestore(conf->hash_locks + hash, flags);
@@ -449,6 +452,7 @@ static struct stripe_head *get_free_stripe(struct r5conf *conf, int hash)
 	first = (conf->inactive_list + hash)->next;
 	sh = list_entry(first, struct stripe_head, lru);
 	list_del_init(first);
+	clear_bit(STRIPE_ON_INACTIVE_LIST, &sh->state);
 	remove_hash(sh);
 	atomic_inc(&conf->active_stripes);
 	BUG_ON(hash != sh->hash_lock_index);
@@ -632,6 +636,7 @@ static struct stripe_head *find_get_stripe(struct r5conf *conf,
 {
 	int inc_empty_inactive_list_flag;
 	struct stripe_head *sh;
+	bool inactive;
 
 	sh = __find_stripe(conf, sector, generation);
 	if (!sh)
@@ -643,10 +648,13 @@ static struct stripe_head *find_get_stripe(struct r5conf *conf,
 	/*
 	 * Slow path. The reference count is zero which means the stripe must
 	 * be on a list (sh->lru). Must remove the stripe from the list that
-	 * references it with the device_lock held.
+	 * references it with the device_lock held, unless that list is the
+	 * inactive list: it is only ever touched under the hash lock, which
+	 * we already hold.
 	 */
-
-	spin_lock(&conf->device_lock);
+	inactive = test_and_clear_bit(STRIPE_ON_INACTIVE_LIST, &sh->state);
+	if (!inactive)
+		spin_lock(&conf->device_lock);
 	if (!atomic_read(&sh->count)) {
 		if (!test_bit(STRIPE_HANDLE, &sh->state))
 			atomic_inc(&conf->active_stripes);
@@ -660,12 +668,14 @@ static struct stripe_head *find_get_stripe(struct r5conf *conf,
 		    inc_empty_inactive_list_flag)
 			atomic_inc(&conf->empty_inactive_list_nr);
 		if (sh->group) {
+			WARN_ON_ONCE(inactive);
 			sh->group->stripes_cnt--;
 			sh->group = NULL;
 		}
 	}
 	atomic_inc(&sh->count);
-	spin_unlock(&conf->device_lock);
+	if (!inactive)
+		spin_unlock(&conf->device_lock);
 
 	return sh;
 }
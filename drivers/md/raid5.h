@@ -399,6 +399,9 @@ enum {
 				 * in conf->r5c_full_stripe_list)
 				 */
 	STRIPE_R5C_PREFLUSH,	/* need to flush journal device */
+	STRIPE_ON_INACTIVE_LIST,	/* on conf->inactive_list, which is
+					 * protected by the hash lock alone
+					 */
 };
 
 #define STRIPE_EXPAND_SYNC_FLAGS \
@@ -437,8 +437,12 @@ static int ice_setup_rx_ctx(struct ice_rx_ring *ring)
 	 * multiple buffers, thus letting us skip that
 	 * handling in the fast-path.
 	 */
+	/* Let the hardware chain buffers only if the socket takes
+	 * multi-buffer packets, and no more than it can take
+	 */
 	if (ring->xsk_pool)
-		chain_len = 1;
+		chain_len = min_t(u32, chain_len,
+				  xsk_pool_get_max_segs(ring->xsk_pool));
 	/* Max packet size for this queue - must not be set to a larger value
 	 * than 5 x DBUF
 	 */
@@ -3467,6 +3467,9 @@ static int ice_cfg_netdev(struct ice_vsi *vsi)
 	netdev->min_mtu = ETH_MIN_MTU;
 	netdev->max_mtu = ICE_MAX_MTU;
 
+	/* a non-TSO packet may take up to ICE_MAX_BUF_TXD Tx descriptors */
+	netdev->xdp_zc_max_segs = ICE_MAX_BUF_TXD;
+
 	return 0;
 }
 
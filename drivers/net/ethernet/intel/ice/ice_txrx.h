@@ -302,6 +302,7 @@ struct ice_rx_ring {
 	struct ice_tx_ring *xdp_ring;
 	struct xsk_buff_pool *xsk_pool;
 	struct sk_buff *skb;
+	struct xdp_buff *xsk_first;	/* partial AF_XDP multi-buffer packet */
 	dma_addr_t dma;			/* physical address of ring */
 	u64 cached_phctime;
 	u8 dcb_tc;			/* Traffic class of ring */
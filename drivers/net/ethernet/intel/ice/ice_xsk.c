@@ -567,7 +567,9 @@ static void ice_bump_ntc(struct ice_rx_ring *rx_ring)
  * @rx_ring: Rx ring
  * @xdp: Pointer to XDP buffer
  *
- * This function allocates a new skb from a zero-copy Rx buffer.
+ * This function allocates a new skb from a zero-copy Rx buffer, together
+ * with the fragments chained onto it. The buffer is given back to the pool
+ * either way.
  *
  * Returns the skb on success, NULL on failure.
  */
@@ -576,14 +578,16 @@ ice_construct_skb_zc(struct ice_rx_ring *rx_ring, struct xdp_buff *xdp)
 {
 	unsigned int totalsize = xdp->data_end - xdp->data_meta;
 	unsigned int metasize = xdp->data - xdp->data_meta;
+	struct skb_shared_info *sinfo;
 	struct sk_buff *skb;
+	u32 i;
 
 	net_prefetch(xdp->data_meta);
 
 	skb = __napi_alloc_skb(&rx_ring->q_vector->napi, totalsize,
 			       GFP_ATOMIC | __GFP_NOWARN);
 	if (unlikely(!skb))
-		return NULL;
+		goto out;
 
 	memcpy(__skb_put(skb, totalsize), xdp->data_meta,
 	       ALIGN(totalsize, sizeof(long)));
@@ -593,6 +597,28 @@ ice_construct_skb_zc(struct ice_rx_ring *rx_ring, struct xdp_buff *xdp)
 		__skb_pull(skb, metasize);
 	}
 
+	if (likely(!xdp_buff_has_frags(xdp)))
+		goto out;
+
+	/* the frags live in the umem too, copy them out like the head */
+	sinfo = xdp_get_shared_info_from_buff(xdp);
+	for (i = 0; i < sinfo->nr_frags; i++) {
+		skb_frag_t *frag = &sinfo->frags[i];
+		u32 size = skb_frag_size(frag);
+		struct page *page;
+
+		page = dev_alloc_page();
+		if (unlikely(!page)) {
+			dev_kfree_skb(skb);
+			skb = NULL;
+			goto out;
+		}
+
+		memcpy(page_address(page), skb_frag_address(frag), size);
+		skb_add_rx_frag(skb, i, page, 0, size, PAGE_SIZE);
+	}
+
+out:
 	xsk_buff_free(xdp);
 	return skb;
 }
@@ -660,6 +686,7 @@ ice_run_xdp_zc(struct ice_rx_ring *rx_ring, struct xdp_buff *xdp,
 int ice_clean_rx_irq_zc(struct ice_rx_ring *rx_ring, int budget)
 {
 	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+	struct xdp_buff *first = rx_ring->xsk_first;
 	struct ice_tx_ring *xdp_ring;
 	unsigned int xdp_xmit = 0;
 	struct bpf_prog *xdp_prog;
@@ -700,21 +727,50 @@ int ice_clean_rx_irq_zc(struct ice_rx_ring *rx_ring, int budget)
 
 		size = le16_to_cpu(rx_desc->wb.pkt_len) &
 				   ICE_RX_FLX_DESC_PKT_LEN_M;
-		if (!size) {
+		if (!size && !first) {
 			xdp->data = NULL;
 			xdp->data_end = NULL;
 			xdp->data_hard_start = NULL;
 			xdp->data_meta = NULL;
+			xdp->flags = 0;
+			ice_bump_ntc(rx_ring);
 			goto construct_skb;
 		}
 
 		xsk_buff_set_size(xdp, size);
 		xsk_buff_dma_sync_for_cpu(xdp, rx_ring->xsk_pool);
+		ice_bump_ntc(rx_ring);
+
+		/* The hardware chains no more buffers than the pool takes,
+		 * see ice_setup_rx_ctx(), so adding a fragment can't fail.
+		 */
+		if (!first)
+			first = xdp;
+		else if (WARN_ON_ONCE(!xsk_buff_add_frag(first, xdp)))
+			xsk_buff_free(xdp);
+
+		if (!ice_test_staterr(rx_desc->wb.status_error0,
+				      BIT(ICE_RX_FLEX_DESC_STATUS0_EOF_S))) {
+			rx_ring->ring_stats->rx_stats.non_eop_descs++;
+			continue;
+		}
+
+		xdp = first;
+		first = NULL;
+		size = xdp_get_buff_len(xdp);
 
 		xdp_res = ice_run_xdp_zc(rx_ring, xdp, xdp_prog, xdp_ring);
 		if (likely(xdp_res & (ICE_XDP_TX | ICE_XDP_REDIR))) {
 			xdp_xmit |= xdp_res;
 		} else if (xdp_res == ICE_XDP_EXIT) {
+			/* Retry once user space made room on the socket's Rx
+			 * ring. A multi-buffer packet can't be put back onto
+			 * the descriptor ring, drop it.
+			 */
+			if (xdp_buff_has_frags(xdp))
+				xsk_buff_free(xdp);
+			else if (!rx_ring->next_to_clean--)
+				rx_ring->next_to_clean = rx_ring->count - 1;
 			failure = true;
 			break;
 		} else if (xdp_res == ICE_XDP_CONSUMED) {
@@ -725,8 +781,6 @@ int ice_clean_rx_irq_zc(struct ice_rx_ring *rx_ring, int budget)
 
 		total_rx_bytes += size;
 		total_rx_packets++;
-
-		ice_bump_ntc(rx_ring);
 		continue;
 
 construct_skb:
@@ -737,8 +791,6 @@ int ice_clean_rx_irq_zc(struct ice_rx_ring *rx_ring, int budget)
 			break;
 		}
 
-		ice_bump_ntc(rx_ring);
-
 		if (eth_skb_pad(skb)) {
 			skb = NULL;
 			continue;
@@ -756,6 +808,8 @@ int ice_clean_rx_irq_zc(struct ice_rx_ring *rx_ring, int budget)
 		ice_receive_skb(rx_ring, skb, vlan_tag);
 	}
 
+	rx_ring->xsk_first = first;
+
 	entries_to_alloc = ICE_DESC_UNUSED(rx_ring);
 	if (entries_to_alloc > ICE_RING_QUARTER(rx_ring))
 		failure |= !ice_alloc_rx_bufs_zc(rx_ring, entries_to_alloc);
@@ -861,7 +915,8 @@ static void ice_xmit_pkt(struct ice_tx_ring *xdp_ring, struct xdp_desc *desc,
 
 	tx_desc = ICE_TX_DESC(xdp_ring, xdp_ring->next_to_use++);
 	tx_desc->buf_addr = cpu_to_le64(dma);
-	tx_desc->cmd_type_offset_bsz = ice_build_ctob(ICE_TX_DESC_CMD_EOP,
+	tx_desc->cmd_type_offset_bsz = ice_build_ctob(xsk_is_eop_desc(desc) ?
+						      ICE_TX_DESC_CMD_EOP : 0,
 						      0, desc->len, 0);
 
 	*total_bytes += desc->len;
@@ -888,8 +943,10 @@ static void ice_xmit_pkt_batch(struct ice_tx_ring *xdp_ring, struct xdp_desc *de
 
 		tx_desc = ICE_TX_DESC(xdp_ring, ntu++);
 		tx_desc->buf_addr = cpu_to_le64(dma);
-		tx_desc->cmd_type_offset_bsz = ice_build_ctob(ICE_TX_DESC_CMD_EOP,
-							      0, descs[i].len, 0);
+		tx_desc->cmd_type_offset_bsz =
+			ice_build_ctob(xsk_is_eop_desc(&descs[i]) ?
+				       ICE_TX_DESC_CMD_EOP : 0,
+				       0, descs[i].len, 0);
 
 		*total_bytes += descs[i].len;
 	}
@@ -1043,6 +1100,11 @@ void ice_xsk_clean_rx_ring(struct ice_rx_ring *rx_ring)
 	u16 ntc = rx_ring->next_to_clean;
 	u16 ntu = rx_ring->next_to_use;
 
+	if (rx_ring->xsk_first) {
+		xsk_buff_free(rx_ring->xsk_first);
+		rx_ring->xsk_first = NULL;
+	}
+
 	while (ntc != ntu) {
 		struct xdp_buff *xdp = *ice_xdp_buf(rx_ring, ntc);
 
@@ -3315,6 +3315,7 @@ int mlx4_en_init_netdev(struct mlx4_en_dev *mdev, int port,
 	netif_set_real_num_rx_queues(dev, priv->rx_ring_num);
 
 	dev->ethtool_ops = &mlx4_en_ethtool_ops;
+	dev->xdp_metadata_ops = &mlx4_xdp_metadata_ops;
 
 	/*
 	 * Set driver features
@@ -661,6 +661,65 @@ static int check_csum(struct mlx4_cqe *cqe, struct sk_buff *skb, void *va,
 #define MLX4_CQE_STATUS_IP_ANY (MLX4_CQE_STATUS_IPV4)
 #endif
 
+struct mlx4_en_xdp_buff {
+	struct xdp_buff xdp;
+	struct mlx4_cqe *cqe;
+	struct mlx4_en_dev *mdev;
+	struct mlx4_en_rx_ring *ring;
+	struct net_device *dev;
+};
+
+static int mlx4_en_xdp_rx_timestamp(const struct xdp_md *ctx, u64 *timestamp)
+{
+	struct mlx4_en_xdp_buff *_ctx = (void *)ctx;
+	struct skb_shared_hwtstamps hwts;
+
+	if (unlikely(_ctx->ring->hwtstamp_rx_filter != HWTSTAMP_FILTER_ALL))
+		return -ENODATA;
+
+	mlx4_en_fill_hwtstamps(_ctx->mdev, &hwts,
+			       mlx4_en_get_cqe_ts(_ctx->cqe));
+	*timestamp = ktime_to_ns(hwts.hwtstamp);
+	return 0;
+}
+
+static int mlx4_en_xdp_rx_hash(const struct xdp_md *ctx, u32 *hash)
+{
+	struct mlx4_en_xdp_buff *_ctx = (void *)ctx;
+
+	if (unlikely(!(_ctx->dev->features & NETIF_F_RXHASH)))
+		return -ENODATA;
+
+	*hash = be32_to_cpu(_ctx->cqe->immed_rss_invalid);
+	return 0;
+}
+
+static int mlx4_en_xdp_rx_vlan_tag(const struct xdp_md *ctx,
+				   __be16 *vlan_proto, u16 *vlan_tci)
+{
+	struct mlx4_en_xdp_buff *_ctx = (void *)ctx;
+	struct mlx4_cqe *cqe = _ctx->cqe;
+
+	if ((cqe->vlan_my_qpn & cpu_to_be32(MLX4_CQE_CVLAN_PRESENT_MASK)) &&
+	    (_ctx->dev->features & NETIF_F_HW_VLAN_CTAG_RX))
+		*vlan_proto = htons(ETH_P_8021Q);
+	else if ((cqe->vlan_my_qpn &
+		  cpu_to_be32(MLX4_CQE_SVLAN_PRESENT_MASK)) &&
+		 (_ctx->dev->features & NETIF_F_HW_VLAN_STAG_RX))
+		*vlan_proto = htons(ETH_P_8021AD);
+	else
+		return -ENODATA;
+
+	*vlan_tci = be16_to_cpu(cqe->sl_vid);
+	return 0;
+}
+
+const struct xdp_metadata_ops mlx4_xdp_metadata_ops = {
+	.xmo_rx_timestamp	= mlx4_en_xdp_rx_timestamp,
+	.xmo_rx_hash		= mlx4_en_xdp_rx_hash,
+	.xmo_rx_vlan_tag	= mlx4_en_xdp_rx_vlan_tag,
+};
+
 int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int budget)
 {
 	struct mlx4_en_priv *priv = netdev_priv(dev);
@@ -671,7 +730,7 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 	bool doorbell_pending;
 	bool xdp_redir_flush;
 	struct mlx4_cqe *cqe;
-	struct xdp_buff xdp;
+	struct mlx4_en_xdp_buff mxbuf = {};
 	int polled = 0;
 	int index;
 
@@ -681,7 +740,12 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 	ring = priv->rx_ring[cq_ring];
 
 	xdp_prog = rcu_dereference_bh(ring->xdp_prog);
-	xdp_init_buff(&xdp, priv->frag_info[0].frag_stride, &ring->xdp_rxq);
+	xdp_init_buff(&mxbuf.xdp, priv->frag_info[0].frag_stride,
+		      &ring->xdp_rxq);
+	xdp_buff_set_rx_metadata(&mxbuf.xdp);
+	mxbuf.mdev = priv->mdev;
+	mxbuf.ring = ring;
+	mxbuf.dev = dev;
 	doorbell_pending = false;
 	xdp_redir_flush = false;
 
@@ -776,24 +840,26 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 						priv->frag_info[0].frag_size,
 						DMA_FROM_DEVICE);
 
-			xdp_prepare_buff(&xdp, va - frags[0].page_offset,
+			xdp_prepare_buff(&mxbuf.xdp, va - frags[0].page_offset,
 					 frags[0].page_offset, length, false);
-			orig_data = xdp.data;
+			orig_data = mxbuf.xdp.data;
+			mxbuf.cqe = cqe;
 
-			act = bpf_prog_run_xdp(xdp_prog, &xdp);
+			act = bpf_prog_run_xdp(xdp_prog, &mxbuf.xdp);
 
-			length = xdp.data_end - xdp.data;
-			if (xdp.data != orig_data) {
-				frags[0].page_offset = xdp.data -
-					xdp.data_hard_start;
-				va = xdp.data;
+			length = mxbuf.xdp.data_end - mxbuf.xdp.data;
+			if (mxbuf.xdp.data != orig_data) {
+				frags[0].page_offset = mxbuf.xdp.data -
+					mxbuf.xdp.data_hard_start;
+				va = mxbuf.xdp.data;
 			}
 
 			switch (act) {
 			case XDP_PASS:
 				break;
 			case XDP_REDIRECT:
-				if (likely(!xdp_do_redirect(dev, &xdp, xdp_prog))) {
+				if (likely(!xdp_do_redirect(dev, &mxbuf.xdp,
+							    xdp_prog))) {
 					ring->xdp_redirect++;
 					xdp_redir_flush = true;
 					frags[0].page = NULL;
@@ -809,6 +809,7 @@ void mlx4_en_remove_timestamp(struct mlx4_en_dev *mdev);
 /* Globals
  */
 extern const struct ethtool_ops mlx4_en_ethtool_ops;
+extern const struct xdp_metadata_ops mlx4_xdp_metadata_ops;
 
 
 
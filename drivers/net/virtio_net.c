@@ -570,11 +570,18 @@ static int __virtnet_xdp_xmit_one(struct virtnet_info *vi,
 				   struct xdp_frame *xdpf)
 {
 	struct virtio_net_hdr_mrg_rxbuf *hdr;
-	int err;
+	struct skb_shared_info *shinfo = NULL;
+	u8 nr_frags = 0;
+	int err, i;
 
 	if (unlikely(xdpf->headroom < vi->hdr_len))
 		return -EOVERFLOW;
 
+	if (unlikely(xdp_frame_has_frags(xdpf))) {
+		shinfo = xdp_get_shared_info_from_frame(xdpf);
+		nr_frags = shinfo->nr_frags;
+	}
+
 	/* Make room for virtqueue hdr (also change xdpf->headroom?) */
 	xdpf->data -= vi->hdr_len;
 	/* Zero header and leave csum up to XDP layers */
@@ -582,10 +589,17 @@ static int __virtnet_xdp_xmit_one(struct virtnet_info *vi,
 	memset(hdr, 0, vi->hdr_len);
 	xdpf->len   += vi->hdr_len;
 
-	sg_init_one(sq->sg, xdpf->data, xdpf->len);
+	sg_init_table(sq->sg, nr_frags + 1);
+	sg_set_buf(sq->sg, xdpf->data, xdpf->len);
+	for (i = 0; i < nr_frags; i++) {
+		skb_frag_t *frag = &shinfo->frags[i];
+
+		sg_set_page(&sq->sg[i + 1], skb_frag_page(frag),
+			    skb_frag_size(frag), skb_frag_off(frag));
+	}
 
-	err = virtqueue_add_outbuf(sq->vq, sq->sg, 1, xdp_to_ptr(xdpf),
-				   GFP_ATOMIC);
+	err = virtqueue_add_outbuf(sq->vq, sq->sg, nr_frags + 1,
+				   xdp_to_ptr(xdpf), GFP_ATOMIC);
 	if (unlikely(err))
 		return -ENOSPC; /* Caller handle free/refcnt */
 
@@ -938,6 +952,110 @@ static struct sk_buff *receive_big(struct net_device *dev,
 	return NULL;
 }
 
+static void put_xdp_frags(struct xdp_buff *xdp)
+{
+	struct skb_shared_info *shinfo;
+	int i;
+
+	if (!xdp_buff_has_frags(xdp))
+		return;
+
+	shinfo = xdp_get_shared_info_from_buff(xdp);
+	for (i = 0; i < shinfo->nr_frags; i++)
+		put_page(skb_frag_page(&shinfo->frags[i]));
+	shinfo->nr_frags = 0;
+	xdp_buff_clear_frags_flag(xdp);
+}
+
+/* Attach the remaining buffers of a mergeable packet to @xdp as frags, so
+ * that a frags aware program sees the whole packet without a copy.
+ * *num_buf is decremented for every buffer taken off the ring; on error
+ * the buffers attached so far are released.
+ */
+static int virtnet_build_xdp_frags(struct net_device *dev,
+				   struct virtnet_info *vi,
+				   struct receive_queue *rq,
+				   struct xdp_buff *xdp,
+				   u16 *num_buf,
+				   unsigned int *xdp_frags_truesize,
+				   struct virtnet_rq_stats *stats)
+{
+	struct skb_shared_info *shinfo = xdp_get_shared_info_from_buff(xdp);
+	unsigned int truesize, len;
+	struct page *page;
+	skb_frag_t *frag;
+	void *buf, *ctx;
+
+	shinfo->nr_frags = 0;
+	shinfo->xdp_frags_size = 0;
+	*xdp_frags_truesize = 0;
+	xdp_buff_set_frags_flag(xdp);
+
+	if (unlikely(*num_buf - 1 > MAX_SKB_FRAGS))
+		return -EINVAL;
+
+	while (*num_buf > 1) {
+		buf = virtqueue_get_buf_ctx(rq->vq, &len, &ctx);
+		if (unlikely(!buf)) {
+			dev->stats.rx_length_errors++;
+			*num_buf = 1;
+			goto err;
+		}
+		(*num_buf)--;
+
+		stats->bytes += len;
+		page = virt_to_head_page(buf);
+
+		truesize = mergeable_ctx_to_truesize(ctx);
+		if (unlikely(len > truesize)) {
+			dev->stats.rx_length_errors++;
+			put_page(page);
+			goto err;
+		}
+
+		frag = &shinfo->frags[shinfo->nr_frags++];
+		__skb_frag_set_page(frag, page);
+		skb_frag_off_set(frag, buf - page_address(page));
+		skb_frag_size_set(frag, len);
+		if (page_is_pfmemalloc(page))
+			xdp_buff_set_frag_pfmemalloc(xdp);
+
+		shinfo->xdp_frags_size += len;
+		*xdp_frags_truesize += truesize;
+	}
+
+	return 0;
+
+err:
+	put_xdp_frags(xdp);
+	return -EINVAL;
+}
+
+static struct sk_buff *build_skb_from_xdp_buff(struct net_device *dev,
+					       struct xdp_buff *xdp,
+					       unsigned int xdp_frags_truesize)
+{
+	struct skb_shared_info *shinfo = xdp_get_shared_info_from_buff(xdp);
+	unsigned int metasize = xdp->data - xdp->data_meta;
+	u8 nr_frags = shinfo->nr_frags;
+	struct sk_buff *skb;
+
+	skb = build_skb(xdp->data_hard_start, xdp->frame_sz);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, xdp->data - xdp->data_hard_start);
+	__skb_put(skb, xdp->data_end - xdp->data);
+	if (metasize)
+		skb_metadata_set(skb, metasize);
+
+	xdp_update_skb_shared_info(skb, nr_frags, shinfo->xdp_frags_size,
+				   xdp_frags_truesize,
+				   xdp_buff_is_frag_pfmemalloc(xdp));
+
+	return skb;
+}
+
 static struct sk_buff *receive_mergeable(struct net_device *dev,
 					 struct virtnet_info *vi,
 					 struct receive_queue *rq,
@@ -955,6 +1073,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 	struct bpf_prog *xdp_prog;
 	unsigned int truesize = mergeable_ctx_to_truesize(ctx);
 	unsigned int headroom = mergeable_ctx_to_headroom(ctx);
+	unsigned int xdp_frags_truesize = 0;
 	unsigned int metasize = 0;
 	unsigned int frame_sz;
 	int err;
@@ -999,9 +1118,10 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		 * or headroom is not enough because of the buffer
 		 * was refilled before XDP is set. This should only
 		 * happen for the first several packets, so we don't
-		 * care much about its performance.
+		 * care much about its performance. Programs that
+		 * handle frags get the extra buffers attached instead.
 		 */
-		if (unlikely(num_buf > 1 ||
+		if (unlikely((num_buf > 1 && !xdp_prog->aux->xdp_has_frags) ||
 			     headroom < virtnet_get_headroom(vi))) {
 			/* linearize data for XDP */
 			xdp_page = xdp_linearize_page(rq, &num_buf,
@@ -1025,11 +1145,32 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		xdp_prepare_buff(&xdp, data - VIRTIO_XDP_HEADROOM + vi->hdr_len,
 				 VIRTIO_XDP_HEADROOM, len - vi->hdr_len, true);
 
+		/* only left over after the linearize step above for a
+		 * frags aware program
+		 */
+		if (num_buf > 1 &&
+		    virtnet_build_xdp_frags(dev, vi, rq, &xdp, &num_buf,
+					    &xdp_frags_truesize, stats))
+			goto err_xdp;
+
 		act = bpf_prog_run_xdp(xdp_prog, &xdp);
 		stats->xdp_packets++;
 
 		switch (act) {
 		case XDP_PASS:
+			if (unlikely(xdp_buff_has_frags(&xdp))) {
+				rcu_read_unlock();
+				head_skb = build_skb_from_xdp_buff(dev, &xdp,
+								   xdp_frags_truesize);
+				if (unlikely(!head_skb)) {
+					put_xdp_frags(&xdp);
+					goto err_skb;
+				}
+				ewma_pkt_len_add(&rq->mrg_avg_pkt_len,
+						 head_skb->len);
+				return head_skb;
+			}
+
 			metasize = xdp.data - xdp.data_meta;
 
 			/* recalculate offset to account for any header
@@ -1077,6 +1218,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			stats->xdp_tx++;
 			xdpf = xdp_convert_buff_to_frame(&xdp);
 			if (unlikely(!xdpf)) {
+				put_xdp_frags(&xdp);
 				if (unlikely(xdp_page != page))
 					put_page(xdp_page);
 				goto err_xdp;
@@ -1086,6 +1228,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 				xdp_return_frame_rx_napi(xdpf);
 			} else if (unlikely(err < 0)) {
 				trace_xdp_exception(vi->dev, xdp_prog, act);
+				put_xdp_frags(&xdp);
 				if (unlikely(xdp_page != page))
 					put_page(xdp_page);
 				goto err_xdp;
@@ -1099,6 +1242,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			stats->xdp_redirects++;
 			err = xdp_do_redirect(dev, &xdp, xdp_prog);
 			if (err) {
+				put_xdp_frags(&xdp);
 				if (unlikely(xdp_page != page))
 					put_page(xdp_page);
 				goto err_xdp;
@@ -1115,6 +1259,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			trace_xdp_exception(vi->dev, xdp_prog, act);
 			fallthrough;
 		case XDP_DROP:
+			put_xdp_frags(&xdp);
 			if (unlikely(xdp_page != page))
 				__free_pages(xdp_page, 0);
 			goto err_xdp;
@@ -3101,7 +3246,11 @@ static int virtnet_xdp_set(struct net_device *dev, struct bpf_prog *prog,
 		return -EINVAL;
 	}
 
-	if (dev->mtu > max_sz) {
+	/* Larger packets span several mergeable buffers, which only a
+	 * frags aware program can be given without linearizing.
+	 */
+	if (prog && dev->mtu > max_sz &&
+	    !(prog->aux->xdp_has_frags && vi->mergeable_rx_bufs)) {
 		NL_SET_ERR_MSG_MOD(extack, "MTU too large to enable XDP");
 		netdev_warn(dev, "XDP requires MTU less than %lu\n", max_sz);
 		return -EINVAL;
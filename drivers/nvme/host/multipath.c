@@ -17,6 +17,8 @@ MODULE_PARM_DESC(multipath,
 static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_QD]	= "queue-depth",
+	[NVME_IOPOLICY_ST]	= "service-time",
 };
 
 static int iopolicy = NVME_IOPOLICY_NUMA;
@@ -29,6 +31,10 @@ static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
 		iopolicy = NVME_IOPOLICY_NUMA;
 	else if (!strncmp(val, "round-robin", 11))
 		iopolicy = NVME_IOPOLICY_RR;
+	else if (!strncmp(val, "queue-depth", 11))
+		iopolicy = NVME_IOPOLICY_QD;
+	else if (!strncmp(val, "service-time", 12))
+		iopolicy = NVME_IOPOLICY_ST;
 	else
 		return -EINVAL;
 
@@ -43,7 +49,7 @@ static int nvme_get_iopolicy(char *buf, const struct kernel_param *kp)
 module_param_call(iopolicy, nvme_set_iopolicy, nvme_get_iopolicy,
 	&iopolicy, 0644);
 MODULE_PARM_DESC(iopolicy,
-	"Default multipath I/O policy; 'numa' (default) or 'round-robin'");
+	"Default multipath I/O policy; 'numa' (default), 'round-robin', 'queue-depth' or 'service-time'");
 
 void nvme_mpath_default_iopolicy(struct nvme_subsystem *subsys)
 {
@@ -99,6 +105,11 @@ void nvme_failover_req(struct request *req)
 		queue_work(nvme_wq, &ns->ctrl->ana_work);
 	}
 
+	if (nvme_req(req)->flags & NVME_MPATH_CNT_ACTIVE) {
+		atomic_dec(&ns->ctrl->nr_active);
+		nvme_req(req)->flags &= ~NVME_MPATH_CNT_ACTIVE;
+	}
+
 	spin_lock_irqsave(&ns->head->requeue_lock, flags);
 	for (bio = req->bio; bio; bio = bio->bi_next) {
 		bio_set_dev(bio, ns->head->disk->part0);
@@ -118,6 +129,19 @@ void nvme_mpath_start_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
 	struct gendisk *disk = ns->head->disk;
+	int policy = READ_ONCE(ns->head->subsys->iopolicy);
+
+	if (policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST) {
+		/* a retried request is still accounted */
+		if (!(nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE)) {
+			atomic_inc(&ns->ctrl->nr_active);
+			nvme_req(rq)->flags |= NVME_MPATH_CNT_ACTIVE;
+		}
+		if (policy == NVME_IOPOLICY_ST)
+			nvme_req(rq)->path_start_ns = ktime_get_ns();
+		else
+			nvme_req(rq)->path_start_ns = 0;
+	}
 
 	if (!blk_queue_io_stat(disk->queue) || blk_rq_is_passthrough(rq))
 		return;
@@ -129,10 +153,32 @@ void nvme_mpath_start_request(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(nvme_mpath_start_request);
 
+/* weight of a new latency sample is 1/8, as in dm-historical-service-time */
+#define NVME_MPATH_LAT_SHIFT	3
+
+static void nvme_mpath_end_active(struct nvme_ns *ns, struct request *rq)
+{
+	u64 start = nvme_req(rq)->path_start_ns, lat, ewma;
+
+	atomic_dec(&ns->ctrl->nr_active);
+	if (!start)
+		return;
+
+	lat = ktime_get_ns() - start;
+	ewma = READ_ONCE(ns->lat_ewma_ns);
+	if (ewma)
+		lat = ewma - (ewma >> NVME_MPATH_LAT_SHIFT) +
+			(lat >> NVME_MPATH_LAT_SHIFT);
+	WRITE_ONCE(ns->lat_ewma_ns, lat);
+}
+
 void nvme_mpath_end_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
 
+	if (nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE)
+		nvme_mpath_end_active(ns, rq);
+
 	if (!(nvme_req(rq)->flags & NVME_MPATH_IO_STATS))
 		return;
 	bdev_end_io_acct(ns->head->disk->part0, req_op(rq),
@@ -321,6 +367,57 @@ static struct nvme_ns *nvme_round_robin_path(struct nvme_ns_head *head,
 	return found;
 }
 
+/*
+ * The cost of queueing an I/O on a path: the requests in flight on its
+ * controller for queue-depth, and for service-time how long they take to
+ * complete, estimated from the average latency of the path. Paths without
+ * latency samples yet cost nothing so that they get sampled.
+ */
+static u64 nvme_path_cost(struct nvme_ns *ns, int policy)
+{
+	u64 depth = atomic_read(&ns->ctrl->nr_active);
+
+	if (policy == NVME_IOPOLICY_QD)
+		return depth;
+	return (depth + 1) * READ_ONCE(ns->lat_ewma_ns);
+}
+
+static struct nvme_ns *nvme_load_balance_path(struct nvme_ns_head *head,
+		int policy)
+{
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL, *ns;
+	u64 min_opt = U64_MAX, min_nonopt = U64_MAX, cost;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		cost = nvme_path_cost(ns, policy);
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (cost < min_opt) {
+				min_opt = cost;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (cost < min_nonopt) {
+				min_nonopt = cost;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+
+		/* an idle optimized path can't be beaten */
+		if (min_opt == 0)
+			break;
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
 static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 {
 	return ns->ctrl->state == NVME_CTRL_LIVE &&
@@ -329,14 +426,18 @@ static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 
 inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 {
+	int policy = READ_ONCE(head->subsys->iopolicy);
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	if (policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST)
+		return nvme_load_balance_path(head, policy);
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
 	if (unlikely(!ns))
 		return __nvme_find_path(head, node);
 
-	if (READ_ONCE(head->subsys->iopolicy) == NVME_IOPOLICY_RR)
+	if (policy == NVME_IOPOLICY_RR)
 		return nvme_round_robin_path(head, node, ns);
 	if (unlikely(!nvme_path_is_optimized(ns)))
 		return __nvme_find_path(head, node);
@@ -896,6 +997,7 @@ void nvme_mpath_init_ctrl(struct nvme_ctrl *ctrl)
 	mutex_init(&ctrl->ana_lock);
 	timer_setup(&ctrl->anatt_timer, nvme_anatt_timeout, 0);
 	INIT_WORK(&ctrl->ana_work, nvme_ana_work);
+	atomic_set(&ctrl->nr_active, 0);
 }
 
 int nvme_mpath_init_identify(struct nvme_ctrl *ctrl, struct nvme_id_ctrl *id)
@@ -30,6 +30,9 @@ static int so_priority;
 module_param(so_priority, int, 0644);
 MODULE_PARM_DESC(so_priority, "nvme tcp socket optimize priority");
 
+/* number of queues whose io_work runs on a cpu, to spread them out */
+static DEFINE_PER_CPU(atomic_t, nvme_tcp_cpu_queues);
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 /* lockdep can detect a circular dependency of the form
  *   sk_lock -> mmap_lock (page fault) -> fs locks -> sk_lock
@@ -103,6 +106,7 @@ enum nvme_tcp_queue_flags {
 	NVME_TCP_Q_ALLOCATED	= 0,
 	NVME_TCP_Q_LIVE		= 1,
 	NVME_TCP_Q_POLLING	= 2,
+	NVME_TCP_Q_IO_CPU_SET	= 3,
 };
 
 enum nvme_tcp_recv_state {
@@ -1468,12 +1472,65 @@ static bool nvme_tcp_poll_queue(struct nvme_tcp_queue *queue)
 			  ctrl->io_queues[HCTX_TYPE_POLL];
 }
 
+/*
+ * Run io_work on a CPU blk-mq maps to the queue's hctx, so that requests
+ * submitted on that CPU are sent inline and completions reach a CPU the
+ * submitters share caches with. Among those CPUs the one running the
+ * fewest queues is picked.
+ */
+static bool nvme_tcp_set_queue_mapped_cpu(struct nvme_tcp_queue *queue)
+{
+	struct blk_mq_tag_set *set = &queue->ctrl->tag_set;
+	int hctx_idx = nvme_tcp_queue_id(queue) - 1;
+	int cpu, io_cpu = -1, min_queues = INT_MAX;
+	unsigned int *mq_map;
+
+	if (nvme_tcp_default_queue(queue))
+		mq_map = set->map[HCTX_TYPE_DEFAULT].mq_map;
+	else if (nvme_tcp_read_queue(queue))
+		mq_map = set->map[HCTX_TYPE_READ].mq_map;
+	else if (nvme_tcp_poll_queue(queue))
+		mq_map = set->map[HCTX_TYPE_POLL].mq_map;
+	else
+		return false;
+	if (!mq_map)
+		return false;
+
+	for_each_online_cpu(cpu) {
+		int nr_queues = atomic_read(per_cpu_ptr(&nvme_tcp_cpu_queues, cpu));
+
+		if (mq_map[cpu] != hctx_idx || nr_queues >= min_queues)
+			continue;
+		io_cpu = cpu;
+		min_queues = nr_queues;
+	}
+	if (io_cpu < 0)
+		return false;
+
+	queue->io_cpu = io_cpu;
+	atomic_inc(per_cpu_ptr(&nvme_tcp_cpu_queues, io_cpu));
+	set_bit(NVME_TCP_Q_IO_CPU_SET, &queue->flags);
+	return true;
+}
+
+static void nvme_tcp_clear_queue_io_cpu(struct nvme_tcp_queue *queue)
+{
+	if (test_and_clear_bit(NVME_TCP_Q_IO_CPU_SET, &queue->flags))
+		atomic_dec(per_cpu_ptr(&nvme_tcp_cpu_queues,
+				       queue->io_cpu));
+}
+
 static void nvme_tcp_set_queue_io_cpu(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_ctrl *ctrl = queue->ctrl;
 	int qid = nvme_tcp_queue_id(queue);
 	int n = 0;
 
+	nvme_tcp_clear_queue_io_cpu(queue);
+	if (nvme_tcp_set_queue_mapped_cpu(queue))
+		return;
+
+	/* no queue map yet, spread the queues by their number */
 	if (nvme_tcp_default_queue(queue))
 		n = qid - 1;
 	else if (nvme_tcp_read_queue(queue))
@@ -1670,6 +1727,7 @@ static void nvme_tcp_stop_queue(struct nvme_ctrl *nctrl, int qid)
 	mutex_lock(&queue->queue_lock);
 	if (test_and_clear_bit(NVME_TCP_Q_LIVE, &queue->flags))
 		__nvme_tcp_stop_queue(queue);
+	nvme_tcp_clear_queue_io_cpu(queue);
 	mutex_unlock(&queue->queue_lock);
 }
 
@@ -1678,10 +1736,13 @@ static int nvme_tcp_start_queue(struct nvme_ctrl *nctrl, int idx)
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 	int ret;
 
-	if (idx)
+	if (idx) {
+		/* the queue map is only known once the tag set exists */
+		nvme_tcp_set_queue_io_cpu(&ctrl->queues[idx]);
 		ret = nvmf_connect_io_queue(nctrl, idx);
-	else
+	} else {
 		ret = nvmf_connect_admin_queue(nctrl);
+	}
 
 	if (!ret) {
 		set_bit(NVME_TCP_Q_LIVE, &ctrl->queues[idx].flags);
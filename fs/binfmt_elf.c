@@ -46,6 +46,10 @@
 #include <linux/cred.h>
 #include <linux/dax.h>
 #include <linux/uaccess.h>
+#include <linux/hash.h>
+#include <linux/rcupdate.h>
+#include <linux/iversion.h>
+#include <linux/shmem_fs.h>
 #include <asm/param.h>
 #include <asm/page.h>
 
@@ -288,6 +292,10 @@ create_elf_tables(struct linux_binprm *bprm, const struct elfhdr *exec,
 	if (bprm->have_execfd) {
 		NEW_AUX_ENT(AT_EXECFD, bprm->execfd);
 	}
+#ifdef CONFIG_RSEQ
+	NEW_AUX_ENT(AT_RSEQ_FEATURE_SIZE, offsetof(struct rseq, end));
+	NEW_AUX_ENT(AT_RSEQ_ALIGN, __alignof__(struct rseq));
+#endif
 #undef NEW_AUX_ENT
 	/* AT_NULL is zero; clear the rest too */
 	memset(elf_info, 0, (char *)mm->saved_auxv +
@@ -429,6 +437,177 @@ static int elf_read(struct file *file, void *buf, size_t len, loff_t pos)
 	return 0;
 }
 
+/*
+ * Cache of the parsed layout of recently exec'd binaries and interpreters:
+ * the ELF header, the program headers and the interpreter path.  Hot
+ * binaries such as shells are exec'd over and over and this saves reading
+ * and checking the headers again each time.
+ *
+ * An entry is keyed by the identity of the inode and only trusted while
+ * its size, mtime, ctime and, where the filesystem maintains it, i_version
+ * are unchanged.  Entries are only created for files whose timestamps are
+ * older than the current time, so that a later write or truncate moves a
+ * timestamp even with coarse timestamp granularity.  Inodes that don't
+ * update their timestamps reliably (S_NOCMTIME, or shmem, where stores
+ * through a shared mapping never reach file_update_time()) are not cached.
+ * The cache is direct mapped, a colliding binary simply replaces the
+ * previous entry.
+ */
+#define ELF_LAYOUT_CACHE_BITS	8
+
+struct elf_layout {
+	struct rcu_head		rcu;
+	dev_t			dev;
+	unsigned long		ino;
+	u32			generation;
+	loff_t			size;
+	u64			iversion;
+	struct timespec64	mtime;
+	struct timespec64	ctime;
+	struct elfhdr		ehdr;
+	unsigned int		interp_len;	/* 0 if not cached */
+	char			*interp;
+	struct elf_phdr		phdrs[];
+};
+
+static struct elf_layout __rcu *elf_layout_cache[1 << ELF_LAYOUT_CACHE_BITS];
+static DEFINE_SPINLOCK(elf_layout_lock);
+
+static struct elf_layout __rcu **elf_layout_slot(struct inode *inode)
+{
+	unsigned long key = inode->i_ino ^ inode->i_sb->s_dev;
+
+	return &elf_layout_cache[hash_long(key, ELF_LAYOUT_CACHE_BITS)];
+}
+
+static bool elf_layout_match(const struct elf_layout *l, struct inode *inode)
+{
+	return l->ino == inode->i_ino && l->dev == inode->i_sb->s_dev &&
+	       l->generation == inode->i_generation &&
+	       l->size == i_size_read(inode) &&
+	       (!IS_I_VERSION(inode) ||
+		l->iversion == inode_peek_iversion(inode)) &&
+	       timespec64_equal(&l->mtime, &inode->i_mtime) &&
+	       timespec64_equal(&l->ctime, &inode->i_ctime);
+}
+
+/* Look up @file's layout, must be called under rcu_read_lock() */
+static struct elf_layout *elf_layout_lookup(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct elf_layout *l;
+
+	l = rcu_dereference(*elf_layout_slot(inode));
+	if (l && elf_layout_match(l, inode))
+		return l;
+	return NULL;
+}
+
+/*
+ * Remember the layout of @file whose ELF header is @elf_ex and whose
+ * program headers @phdrs of @size bytes have just been read.  The path of
+ * the interpreter, if any, is read and checked here as well.
+ */
+static void elf_layout_add(struct file *file, const struct elfhdr *elf_ex,
+			   const struct elf_phdr *phdrs, unsigned int size)
+{
+	struct inode *inode = file_inode(file);
+	struct timespec64 now = current_time(inode);
+	struct elf_layout __rcu **slot;
+	struct elf_layout *l, *old;
+	unsigned int i, interp_len = 0;
+	loff_t interp_off = 0;
+
+	if (IS_NOCMTIME(inode) || shmem_mapping(inode->i_mapping))
+		return;
+	if (timespec64_compare(&inode->i_mtime, &now) >= 0 ||
+	    timespec64_compare(&inode->i_ctime, &now) >= 0)
+		return;
+
+	for (i = 0; i < elf_ex->e_phnum; i++) {
+		if (phdrs[i].p_type != PT_INTERP)
+			continue;
+		if (phdrs[i].p_filesz >= 2 && phdrs[i].p_filesz <= PATH_MAX) {
+			interp_len = phdrs[i].p_filesz;
+			interp_off = phdrs[i].p_offset;
+		}
+		break;
+	}
+
+	l = kmalloc(sizeof(*l) + size + interp_len, GFP_KERNEL);
+	if (!l)
+		return;
+
+	l->dev = inode->i_sb->s_dev;
+	l->ino = inode->i_ino;
+	l->generation = inode->i_generation;
+	l->size = i_size_read(inode);
+	/* querying makes the next change bump i_version */
+	l->iversion = IS_I_VERSION(inode) ? inode_query_iversion(inode) : 0;
+	l->mtime = inode->i_mtime;
+	l->ctime = inode->i_ctime;
+	l->ehdr = *elf_ex;
+	memcpy(l->phdrs, phdrs, size);
+	l->interp = (char *)l->phdrs + size;
+	l->interp_len = interp_len;
+	if (interp_len &&
+	    (elf_read(file, l->interp, interp_len, interp_off) ||
+	     l->interp[interp_len - 1] != '\0'))
+		l->interp_len = 0;
+
+	slot = elf_layout_slot(inode);
+	spin_lock(&elf_layout_lock);
+	old = rcu_dereference_protected(*slot, lockdep_is_held(&elf_layout_lock));
+	rcu_assign_pointer(*slot, l);
+	spin_unlock(&elf_layout_lock);
+
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+static void elf_layout_cache_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(elf_layout_cache); i++)
+		kfree(rcu_dereference_protected(elf_layout_cache[i], true));
+}
+
+/* Read the ELF header of @file, from the layout cache if possible */
+static int elf_read_ehdr(struct file *file, struct elfhdr *elf_ex)
+{
+	struct elf_layout *l;
+
+	rcu_read_lock();
+	l = elf_layout_lookup(file);
+	if (l) {
+		*elf_ex = l->ehdr;
+		rcu_read_unlock();
+		return 0;
+	}
+	rcu_read_unlock();
+
+	return elf_read(file, elf_ex, sizeof(*elf_ex), 0);
+}
+
+/* Read the PT_INTERP path @phdr of @file, from the layout cache if possible */
+static int elf_read_interp(struct file *file, const struct elf_phdr *phdr,
+			   char *buf)
+{
+	struct elf_layout *l;
+
+	rcu_read_lock();
+	l = elf_layout_lookup(file);
+	if (l && l->interp_len == phdr->p_filesz) {
+		memcpy(buf, l->interp, l->interp_len);
+		rcu_read_unlock();
+		return 0;
+	}
+	rcu_read_unlock();
+
+	return elf_read(file, buf, phdr->p_filesz, phdr->p_offset);
+}
+
 static unsigned long maximum_alignment(struct elf_phdr *cmds, int nr)
 {
 	unsigned long alignment = 0;
@@ -457,11 +636,15 @@ static unsigned long maximum_alignment(struct elf_phdr *cmds, int nr)
  * Loads ELF program headers from the binary file elf_file, which has the ELF
  * header pointed to by elf_ex, into a newly allocated array. The caller is
  * responsible for freeing the allocated data. Returns NULL upon failure.
+ *
+ * The program headers are taken from the layout cache if elf_file's layout
+ * is cached and unchanged, and are added to it otherwise.
  */
 static struct elf_phdr *load_elf_phdrs(const struct elfhdr *elf_ex,
 				       struct file *elf_file)
 {
 	struct elf_phdr *elf_phdata = NULL;
+	struct elf_layout *l;
 	int retval = -1;
 	unsigned int size;
 
@@ -482,8 +665,21 @@ static struct elf_phdr *load_elf_phdrs(const struct elfhdr *elf_ex,
 	if (!elf_phdata)
 		goto out;
 
+	rcu_read_lock();
+	l = elf_layout_lookup(elf_file);
+	if (l && l->ehdr.e_phoff == elf_ex->e_phoff &&
+	    l->ehdr.e_phnum == elf_ex->e_phnum) {
+		memcpy(elf_phdata, l->phdrs, size);
+		rcu_read_unlock();
+		retval = 0;
+		goto out;
+	}
+	rcu_read_unlock();
+
 	/* Read in the program headers */
 	retval = elf_read(elf_file, elf_phdata, size, elf_ex->e_phoff);
+	if (!retval)
+		elf_layout_add(elf_file, elf_ex, elf_phdata, size);
 
 out:
 	if (retval) {
@@ -881,8 +1077,7 @@ static int load_elf_binary(struct linux_binprm *bprm)
 		if (!elf_interpreter)
 			goto out_free_ph;
 
-		retval = elf_read(bprm->file, elf_interpreter, elf_ppnt->p_filesz,
-				  elf_ppnt->p_offset);
+		retval = elf_read_interp(bprm->file, elf_ppnt, elf_interpreter);
 		if (retval < 0)
 			goto out_free_interp;
 		/* make sure path is NULL terminated */
@@ -909,8 +1104,7 @@ static int load_elf_binary(struct linux_binprm *bprm)
 		}
 
 		/* Get the exec headers */
-		retval = elf_read(interpreter, interp_elf_ex,
-				  sizeof(*interp_elf_ex), 0);
+		retval = elf_read_ehdr(interpreter, interp_elf_ex);
 		if (retval < 0)
 			goto out_free_dentry;
 
@@ -2165,6 +2359,7 @@ static void __exit exit_elf_binfmt(void)
 {
 	/* Remove the COFF and ELF loaders. */
 	unregister_binfmt(&elf_format);
+	elf_layout_cache_free();
 }
 
 core_initcall(init_elf_binfmt);
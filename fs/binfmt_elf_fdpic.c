@@ -592,6 +592,9 @@ static int create_elf_fdpic_tables(struct linux_binprm *bprm,
 
 	if (bprm->have_execfd)
 		nitems++;
+#ifdef CONFIG_RSEQ
+	nitems += 2;
+#endif
 
 	csp = sp;
 	sp -= nitems * 2 * sizeof(unsigned long);
@@ -638,6 +641,13 @@ static int create_elf_fdpic_tables(struct linux_binprm *bprm,
 		NEW_AUX_ENT(AT_EXECFD, bprm->execfd);
 	}
 
+#ifdef CONFIG_RSEQ
+	nr = 0;
+	csp -= 2 * 2 * sizeof(unsigned long);
+	NEW_AUX_ENT(AT_RSEQ_FEATURE_SIZE, offsetof(struct rseq, end));
+	NEW_AUX_ENT(AT_RSEQ_ALIGN, __alignof__(struct rseq));
+#endif
+
 	nr = 0;
 	csp -= DLINFO_ITEMS * 2 * sizeof(unsigned long);
 	NEW_AUX_ENT(AT_HWCAP,	ELF_HWCAP);
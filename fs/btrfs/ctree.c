@@ -1527,28 +1527,19 @@ static noinline void unlock_up(struct btrfs_path *path, int level,
  * whole btree search, starting again from the current root node.
  */
 static int
-read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
-		      struct extent_buffer **eb_ret, int level, int slot,
-		      const struct btrfs_key *key)
+__read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
+			struct extent_buffer **eb_ret, int level, int slot,
+			const struct btrfs_key *key, u64 blocknr,
+			struct btrfs_tree_parent_check *check)
 {
 	struct btrfs_fs_info *fs_info = root->fs_info;
-	struct btrfs_tree_parent_check check = { 0 };
-	u64 blocknr;
-	u64 gen;
+	const u64 gen = check->transid;
+	const int parent_level = check->level + 1;
 	struct extent_buffer *tmp;
 	int ret;
-	int parent_level;
 	bool unlock_up;
 
 	unlock_up = ((level + 1 < BTRFS_MAX_LEVEL) && p->locks[level + 1]);
-	blocknr = btrfs_node_blockptr(*eb_ret, slot);
-	gen = btrfs_node_ptr_generation(*eb_ret, slot);
-	parent_level = btrfs_header_level(*eb_ret);
-	btrfs_node_key_to_cpu(*eb_ret, &check.first_key, slot);
-	check.has_first_key = true;
-	check.level = parent_level - 1;
-	check.transid = gen;
-	check.owner_root = root->root_key.objectid;
 
 	/*
 	 * If we need to read an extent buffer from disk and we are holding locks
@@ -1570,7 +1561,7 @@ read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
 			 * parents (shared tree blocks).
 			 */
 			if (btrfs_verify_level_key(tmp,
-					parent_level - 1, &check.first_key, gen)) {
+					parent_level - 1, &check->first_key, gen)) {
 				free_extent_buffer(tmp);
 				return -EUCLEAN;
 			}
@@ -1587,7 +1578,7 @@ read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
 			btrfs_unlock_up_safe(p, level + 1);
 
 		/* now we're allowed to do a blocking uptodate check */
-		ret = btrfs_read_extent_buffer(tmp, &check);
+		ret = btrfs_read_extent_buffer(tmp, check);
 		if (ret) {
 			free_extent_buffer(tmp);
 			btrfs_release_path(p);
@@ -1617,7 +1608,7 @@ read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
 	if (p->reada != READA_NONE)
 		reada_for_search(fs_info, p, level, slot, key->objectid);
 
-	tmp = read_tree_block(fs_info, blocknr, &check);
+	tmp = read_tree_block(fs_info, blocknr, check);
 	if (IS_ERR(tmp)) {
 		btrfs_release_path(p);
 		return PTR_ERR(tmp);
@@ -1642,6 +1633,25 @@ read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
 	return ret;
 }
 
+static int
+read_block_for_search(struct btrfs_root *root, struct btrfs_path *p,
+		      struct extent_buffer **eb_ret, int level, int slot,
+		      const struct btrfs_key *key)
+{
+	struct btrfs_tree_parent_check check = { 0 };
+	u64 blocknr;
+
+	blocknr = btrfs_node_blockptr(*eb_ret, slot);
+	btrfs_node_key_to_cpu(*eb_ret, &check.first_key, slot);
+	check.has_first_key = true;
+	check.level = btrfs_header_level(*eb_ret) - 1;
+	check.transid = btrfs_node_ptr_generation(*eb_ret, slot);
+	check.owner_root = root->root_key.objectid;
+
+	return __read_block_for_search(root, p, eb_ret, level, slot, key,
+				       blocknr, &check);
+}
+
 /*
  * helper function for btrfs_search_slot.  This does all of the checks
  * for node-level blocks and does any balancing required based on
@@ -2000,6 +2010,93 @@ static int search_leaf(struct btrfs_trans_handle *trans,
 	return ret;
 }
 
+/*
+ * Every read-only search starts by read locking the root node of the tree,
+ * which makes its lock the most contended one under parallel lookups.  Those
+ * searches go through the root node without taking its lock instead: the slot
+ * and the child pointer are read optimistically and validated with the write
+ * sequence of the root node, and the root node is validated once more after
+ * the child got locked.  As a writer has to write lock the root node to change
+ * the pointer or to replace the root node, passing both checks means the same
+ * as having coupled the locks of the root node and its child.
+ *
+ * Returns 0 with the child read locked in the path and in @eb_ret, the root
+ * node referenced but unlocked in the path, 1 if the caller must do a regular
+ * locked search, or a negative errno.
+ */
+static int search_root_nolock(struct btrfs_root *root,
+			      const struct btrfs_key *key,
+			      struct btrfs_path *p,
+			      struct extent_buffer **eb_ret, int *prev_cmp)
+{
+	struct btrfs_tree_parent_check check = { 0 };
+	struct extent_buffer *b;
+	struct extent_buffer *child;
+	unsigned int seq;
+	u64 blocknr;
+	int level;
+	int slot;
+	int cmp;
+	int ret;
+
+	b = btrfs_root_node(root);
+	seq = btrfs_tree_read_seq_begin(b);
+	level = btrfs_header_level(b);
+	if ((seq & 1) || level == 0 || level <= p->lowest_level ||
+	    !extent_buffer_uptodate(b))
+		goto fallback;
+
+	cmp = search_for_key_slot(b, 0, key, -1, &slot);
+	if (cmp < 0)
+		goto fallback;
+	if (cmp && slot > 0)
+		slot--;
+
+	blocknr = btrfs_node_blockptr(b, slot);
+	btrfs_node_key_to_cpu(b, &check.first_key, slot);
+	check.has_first_key = true;
+	check.level = level - 1;
+	check.transid = btrfs_node_ptr_generation(b, slot);
+	check.owner_root = root->root_key.objectid;
+	if (btrfs_tree_read_seq_retry(b, seq))
+		goto fallback;
+
+	/*
+	 * The child may have been freed and reused since, then reading it fails
+	 * the level and first key checks, which is only an error if the root
+	 * node didn't change.
+	 */
+	ret = __read_block_for_search(root, p, &child, level, slot, key,
+				      blocknr, &check);
+	if (ret) {
+		if (btrfs_tree_read_seq_retry(b, seq))
+			goto fallback;
+		free_extent_buffer(b);
+		return ret;
+	}
+
+	btrfs_maybe_reset_lockdep_class(root, child);
+	btrfs_tree_read_lock(child);
+	if (btrfs_tree_read_seq_retry(b, seq) ||
+	    rcu_access_pointer(root->node) != b) {
+		btrfs_tree_read_unlock(child);
+		free_extent_buffer(child);
+		goto fallback;
+	}
+
+	p->nodes[level] = b;
+	p->slots[level] = slot;
+	p->nodes[level - 1] = child;
+	p->locks[level - 1] = BTRFS_READ_LOCK;
+	*eb_ret = child;
+	*prev_cmp = cmp;
+	return 0;
+
+fallback:
+	free_extent_buffer(b);
+	return 1;
+}
+
 /*
  * btrfs_search_slot - look for a key in a tree and perform necessary
  * modifications to preserve tree invariants.
@@ -2047,6 +2144,7 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 	u8 lowest_level = 0;
 	int min_write_lock_level;
 	int prev_cmp;
+	bool try_nolock;
 
 	might_sleep();
 
@@ -2086,6 +2184,11 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 
 	min_write_lock_level = write_lock_level;
 
+	/* see search_root_nolock() */
+	try_nolock = !cow && !p->keep_locks && !p->skip_locking &&
+		     !p->search_commit_root && !p->nowait &&
+		     p->reada == READA_NONE;
+
 	if (p->need_commit_sem) {
 		ASSERT(p->search_commit_root);
 		if (p->nowait) {
@@ -2098,12 +2201,22 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 
 again:
 	prev_cmp = -1;
+	if (try_nolock) {
+		ret = search_root_nolock(root, key, p, &b, &prev_cmp);
+		if (ret < 0)
+			goto done;
+		if (ret == 0)
+			goto descend;
+		/* don't keep retrying against a busy root */
+		try_nolock = false;
+	}
 	b = btrfs_search_slot_get_root(root, p, write_lock_level);
 	if (IS_ERR(b)) {
 		ret = PTR_ERR(b);
 		goto done;
 	}
 
+descend:
 	while (b) {
 		int dec = 0;
 
@@ -2178,6 +2178,107 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	return 0;
 }
 
+/*
+ * Below this many ready heads a single thread gets through them quickly enough,
+ * above it the heads get spread over up to BTRFS_DELAYED_REFS_MAX_WORKERS
+ * threads.  More workers than that mostly contend on the extent tree locks.
+ */
+#define BTRFS_DELAYED_REFS_PARALLEL_MIN		4096
+#define BTRFS_DELAYED_REFS_MAX_WORKERS		8
+
+struct delayed_refs_ctl {
+	struct btrfs_fs_info *fs_info;
+	struct btrfs_transaction *transaction;
+	/* number of heads each worker runs */
+	unsigned long count;
+	atomic_t pending;
+	struct completion done;
+	int error;
+};
+
+struct delayed_refs_work {
+	struct work_struct work;
+	struct delayed_refs_ctl *ctl;
+};
+
+static void delayed_refs_work_fn(struct work_struct *work)
+{
+	struct delayed_refs_work *drw =
+		container_of(work, struct delayed_refs_work, work);
+	struct delayed_refs_ctl *ctl = drw->ctl;
+	struct btrfs_trans_handle *trans;
+	int ret;
+
+	trans = btrfs_join_transaction_nostart(ctl->fs_info->tree_root);
+	if (IS_ERR(trans))
+		goto out;
+
+	/* Only help out the transaction we were started for */
+	if (trans->transaction == ctl->transaction) {
+		ret = btrfs_run_delayed_refs(trans, ctl->count);
+		if (ret)
+			WRITE_ONCE(ctl->error, ret);
+	}
+	btrfs_end_transaction(trans);
+out:
+	if (atomic_dec_and_test(&ctl->pending))
+		complete(&ctl->done);
+}
+
+/*
+ * Make a pass through the delayed refs that are ready, like
+ * btrfs_run_delayed_refs() with a count of 0, but spread the heads over a few
+ * worker threads if there are many of them.  Every worker joins the running
+ * transaction and takes heads the usual way, the head mutex already keeps two
+ * of them from running the same head.
+ *
+ * Returns 0 on success or if called with an aborted transaction
+ * Returns <0 on error and aborts the transaction
+ */
+int btrfs_run_delayed_refs_parallel(struct btrfs_trans_handle *trans)
+{
+	struct btrfs_fs_info *fs_info = trans->fs_info;
+	struct btrfs_delayed_ref_root *delayed_refs;
+	struct delayed_refs_work *works;
+	struct delayed_refs_ctl ctl;
+	unsigned long heads;
+	int nr_workers;
+	int ret;
+	int i;
+
+	delayed_refs = &trans->transaction->delayed_refs;
+	heads = READ_ONCE(delayed_refs->num_heads_ready);
+	nr_workers = min_t(int, num_online_cpus(),
+			   BTRFS_DELAYED_REFS_MAX_WORKERS);
+	if (heads < BTRFS_DELAYED_REFS_PARALLEL_MIN || nr_workers < 2)
+		return btrfs_run_delayed_refs(trans, 0);
+
+	works = kcalloc(nr_workers - 1, sizeof(*works), GFP_NOFS);
+	if (!works)
+		return btrfs_run_delayed_refs(trans, 0);
+
+	ctl.fs_info = fs_info;
+	ctl.transaction = trans->transaction;
+	ctl.count = DIV_ROUND_UP(heads, nr_workers);
+	atomic_set(&ctl.pending, nr_workers - 1);
+	init_completion(&ctl.done);
+	ctl.error = 0;
+
+	for (i = 0; i < nr_workers - 1; i++) {
+		works[i].ctl = &ctl;
+		INIT_WORK(&works[i].work, delayed_refs_work_fn);
+		queue_work(fs_info->delayed_refs_workers, &works[i].work);
+	}
+
+	/* Our own share, with our own handle */
+	ret = btrfs_run_delayed_refs(trans, ctl.count);
+
+	wait_for_completion(&ctl.done);
+	kfree(works);
+
+	return ret ?: READ_ONCE(ctl.error);
+}
+
 int btrfs_set_disk_extent_flags(struct btrfs_trans_handle *trans,
 				struct extent_buffer *eb, u64 flags,
 				int level)
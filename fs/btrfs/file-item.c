@@ -782,6 +782,35 @@ int btrfs_lookup_csums_bitmap(struct btrfs_root *root, u64 start, u64 end,
 	return ret;
 }
 
+/* Most sectors handed to crypto_shash_finup_mb() at once */
+#define BTRFS_CSUM_MB_MAX	8
+
+/*
+ * Checksum @nr consecutive sectors at @data into @csums.  The sectors are
+ * independent messages of the same length, so a hash algorithm which can
+ * interleave several messages takes all of them in one call.
+ */
+static void csum_sectors(struct btrfs_fs_info *fs_info,
+			 struct shash_desc *shash, const u8 *data, u8 *csums,
+			 unsigned int nr)
+{
+	const u8 *datas[BTRFS_CSUM_MB_MAX];
+	u8 *outs[BTRFS_CSUM_MB_MAX];
+	unsigned int i;
+
+	if (nr == 1) {
+		crypto_shash_digest(shash, data, fs_info->sectorsize, csums);
+		return;
+	}
+
+	for (i = 0; i < nr; i++) {
+		datas[i] = data + i * fs_info->sectorsize;
+		outs[i] = csums + i * fs_info->csum_size;
+	}
+	crypto_shash_init(shash);
+	crypto_shash_finup_mb(shash, datas, fs_info->sectorsize, outs, nr);
+}
+
 /*
  * Calculate checksums of the data contained inside a bio.
  *
@@ -808,6 +837,8 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 	unsigned int blockcount;
 	unsigned long total_bytes = 0;
 	unsigned long this_sum_bytes = 0;
+	unsigned int mb_max;
+	unsigned int nr;
 	int i;
 	unsigned nofs_flag;
 
@@ -826,6 +857,8 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 	index = 0;
 
 	shash->tfm = fs_info->csum_shash;
+	mb_max = min_t(unsigned int, BTRFS_CSUM_MB_MAX,
+		       crypto_shash_mb_max_msgs(fs_info->csum_shash));
 
 	bio_for_each_segment(bvec, bio, iter) {
 		if (use_page_offsets)
@@ -851,7 +884,9 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 						 bvec.bv_len + fs_info->sectorsize
 						 - 1);
 
-		for (i = 0; i < blockcount; i++) {
+		/* checksum all the sectors of the page under one mapping */
+		data = bvec_kmap_local(&bvec);
+		for (i = 0; i < blockcount; i += nr) {
 			if (!one_ordered &&
 			    !in_range(offset, ordered->file_offset,
 				      ordered->num_bytes)) {
@@ -878,17 +913,23 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 				index = 0;
 			}
 
-			data = bvec_kmap_local(&bvec);
-			crypto_shash_digest(shash,
-					    data + (i * fs_info->sectorsize),
-					    fs_info->sectorsize,
-					    sums->sums + index);
-			kunmap_local(data);
-			index += fs_info->csum_size;
-			offset += fs_info->sectorsize;
-			this_sum_bytes += fs_info->sectorsize;
-			total_bytes += fs_info->sectorsize;
+			/* Batch the sectors of this ordered extent */
+			nr = min_t(unsigned int, blockcount - i, mb_max);
+			if (!one_ordered)
+				nr = min_t(u64, nr,
+					   (ordered->file_offset +
+					    ordered->num_bytes - offset) >>
+					   fs_info->sectorsize_bits);
+
+			csum_sectors(fs_info, shash,
+				     data + (i * fs_info->sectorsize),
+				     sums->sums + index, nr);
+			index += nr * fs_info->csum_size;
+			offset += nr * fs_info->sectorsize;
+			this_sum_bytes += nr * fs_info->sectorsize;
+			total_bytes += nr * fs_info->sectorsize;
 		}
+		kunmap_local(data);
 
 	}
 	this_sum_bytes = 0;
@@ -534,6 +534,8 @@ struct btrfs_fs_info {
 	struct workqueue_struct *endio_meta_workers;
 	struct workqueue_struct *rmw_workers;
 	struct workqueue_struct *compressed_write_workers;
+	/* helpers for btrfs_run_delayed_refs_parallel(), waited on by commit */
+	struct workqueue_struct *delayed_refs_workers;
 	struct btrfs_workqueue *endio_write_workers;
 	struct btrfs_workqueue *endio_freespace_worker;
 	struct btrfs_workqueue *caching_workers;
@@ -2723,6 +2723,24 @@ static blk_status_t extract_ordered_extent(struct btrfs_inode *inode,
 	return errno_to_blk_status(ret);
 }
 
+/*
+ * Checksumming data in the async submit workers spreads it over all CPUs, at
+ * the cost of a context switch and a trip through the ordered work queue for
+ * every bio.  Writes issued by fsync and friends (->sync_writers != 0) don't
+ * take that detour, and neither do synchronous writes when crc32c is
+ * accelerated: checksumming the bio takes less than the hop, and whoever
+ * waits for the write is better served by doing it right away.
+ */
+static bool btrfs_should_async_csum(struct btrfs_inode *inode, struct bio *bio)
+{
+	if (atomic_read(&inode->sync_writers))
+		return false;
+	if (op_is_sync(bio->bi_opf) &&
+	    test_bit(BTRFS_FS_CSUM_IMPL_FAST, &inode->root->fs_info->flags))
+		return false;
+	return true;
+}
+
 void btrfs_submit_data_write_bio(struct btrfs_inode *inode, struct bio *bio, int mirror_num)
 {
 	struct btrfs_fs_info *fs_info = inode->root->fs_info;
@@ -2738,9 +2756,8 @@ void btrfs_submit_data_write_bio(struct btrfs_inode *inode, struct bio *bio, int
 	}
 
 	/*
-	 * If we need to checksum, and the I/O is not issued by fsync and
-	 * friends, that is ->sync_writers != 0, defer the submission to a
-	 * workqueue to parallelize it.
+	 * If we need to checksum, and btrfs_should_async_csum() says so, defer
+	 * the submission to a workqueue to parallelize it.
 	 *
 	 * Csum items for reloc roots have already been cloned at this point,
 	 * so they are handled as part of the no-checksum case.
@@ -2748,7 +2765,7 @@ void btrfs_submit_data_write_bio(struct btrfs_inode *inode, struct bio *bio, int
 	if (!(inode->flags & BTRFS_INODE_NODATASUM) &&
 	    !test_bit(BTRFS_FS_STATE_NO_CSUMS, &fs_info->fs_state) &&
 	    !btrfs_is_data_reloc_root(inode->root)) {
-		if (!atomic_read(&inode->sync_writers) &&
+		if (btrfs_should_async_csum(inode, bio) &&
 		    btrfs_wq_submit_bio(inode, bio, mirror_num, 0, WQ_SUBMIT_DATA))
 			return;
 
@@ -8002,7 +8019,7 @@ static void btrfs_submit_dio_bio(struct bio *bio, struct btrfs_inode *inode,
 
 	if (btrfs_op(bio) == BTRFS_MAP_WRITE) {
 		/* Check btrfs_submit_data_write_bio() for async submit rules */
-		if (async_submit && !atomic_read(&inode->sync_writers) &&
+		if (async_submit && btrfs_should_async_csum(inode, bio) &&
 		    btrfs_wq_submit_bio(inode, bio, 0, file_offset,
 					WQ_SUBMIT_DATA_DIO))
 			return;
@@ -172,6 +172,25 @@ struct extent_buffer *btrfs_lock_root_node(struct btrfs_root *root);
 struct extent_buffer *btrfs_read_lock_root_node(struct btrfs_root *root);
 struct extent_buffer *btrfs_try_read_lock_root_node(struct btrfs_root *root);
 
+/*
+ * Lockless reads of an extent buffer.  The write lock makes eb->lock_seq odd
+ * while it is held and so every change of the contents advances it, the reader
+ * samples it before looking at the contents, gives up if it's odd, and throws
+ * away what it read if btrfs_tree_read_seq_retry() says it changed since.  The
+ * writer may sleep with the lock held, hence the raw seqcount primitives that
+ * neither spin on an odd count nor require preemption to be disabled.
+ */
+static inline unsigned int btrfs_tree_read_seq_begin(struct extent_buffer *eb)
+{
+	return raw_read_seqcount(&eb->lock_seq);
+}
+
+static inline bool btrfs_tree_read_seq_retry(struct extent_buffer *eb,
+					     unsigned int seq)
+{
+	return read_seqcount_retry(&eb->lock_seq, seq);
+}
+
 #ifdef CONFIG_BTRFS_DEBUG
 static inline void btrfs_assert_tree_write_locked(struct extent_buffer *eb)
 {
@@ -51,6 +51,17 @@ struct scrub_ctx;
 #define SCRUB_SECTORS_PER_BIO	32	/* 128KiB per bio for 4KiB pages */
 #define SCRUB_BIOS_PER_SCTX	64	/* 8MiB per device in flight for 4KiB pages */
 
+/*
+ * The read bios actually in flight are kept between these two, depending on
+ * how much the completion latency rises above what the device does when it's
+ * not busy, see scrub_update_rd_depth().
+ */
+#define SCRUB_RD_DEPTH_MIN	2
+#define SCRUB_RD_DEPTH_MAX	SCRUB_BIOS_PER_SCTX
+
+/* Completions over which the unloaded latency of a device is sampled */
+#define SCRUB_LAT_WINDOW	1024
+
 /*
  * The following value times PAGE_SIZE needs to be large enough to match the
  * largest node/leaf/sector size that shall be supported.
@@ -102,6 +113,8 @@ struct scrub_bio {
 	struct scrub_sector	*sectors[SCRUB_SECTORS_PER_BIO];
 	int			sector_count;
 	int			next_free;
+	ktime_t			submit_time;
+	s64			latency_us;
 	struct work_struct	work;
 };
 
@@ -188,6 +201,15 @@ struct scrub_ctx {
 	ktime_t			throttle_deadline;
 	u64			throttle_sent;
 
+	/* Latency based read depth, protected by list_lock */
+	atomic_t		rd_in_flight;
+	int			rd_depth;
+	int			rd_depth_acks;
+	s64			lat_avg_us;
+	s64			lat_base_us;
+	s64			lat_win_min_us;
+	int			lat_win_count;
+
 	int			is_dev_replace;
 	u64			write_pointer;
 
@@ -791,6 +813,8 @@ static noinline_for_stack struct scrub_ctx *scrub_setup_ctx(
 	spin_lock_init(&sctx->stat_lock);
 	init_waitqueue_head(&sctx->list_wait);
 	sctx->throttle_deadline = 0;
+	atomic_set(&sctx->rd_in_flight, 0);
+	sctx->rd_depth = SCRUB_RD_DEPTH_MAX;
 
 	WARN_ON(sctx->wr_curr_bio != NULL);
 	mutex_init(&sctx->wr_lock);
@@ -2212,6 +2236,54 @@ static void scrub_throttle(struct scrub_ctx *sctx)
 	sctx->throttle_deadline = 0;
 }
 
+/*
+ * Adjust the number of scrub reads kept in flight to the completion latency of
+ * the device, called for every completed read with list_lock held.
+ *
+ * The latency of an otherwise idle device follows the lowest one seen: a lower
+ * completion pulls it down at once, while the minimum of a window of
+ * completions only moves it up by an eighth of the difference.  Sustained
+ * foreground load thus can't make itself the new baseline within a window or
+ * two, but a device that really got slower is followed eventually.
+ *
+ * As long as the average stays within twice that, the depth grows by one per
+ * depth completions, like a congestion window.  Once it goes above, the device
+ * is busy with something else, foreground IO most likely, and the depth gets
+ * halved at most once per depth completions, so scrub backs off quickly and
+ * creeps back up when the foreground load goes away.
+ */
+static void scrub_update_rd_depth(struct scrub_ctx *sctx, s64 lat)
+{
+	lockdep_assert_held(&sctx->list_lock);
+
+	/* A zero baseline would make any average look like a slowdown */
+	lat = max_t(s64, lat, 1);
+
+	if (sctx->lat_win_count == 0 || lat < sctx->lat_win_min_us)
+		sctx->lat_win_min_us = lat;
+	if (sctx->lat_base_us == 0 || lat < sctx->lat_base_us)
+		sctx->lat_base_us = lat;
+	if (++sctx->lat_win_count >= SCRUB_LAT_WINDOW) {
+		sctx->lat_base_us += (sctx->lat_win_min_us -
+				      sctx->lat_base_us) / 8;
+		sctx->lat_win_count = 0;
+	}
+
+	if (sctx->lat_avg_us == 0)
+		sctx->lat_avg_us = lat;
+	else
+		sctx->lat_avg_us = (sctx->lat_avg_us * 7 + lat) / 8;
+
+	if (++sctx->rd_depth_acks < sctx->rd_depth)
+		return;
+	sctx->rd_depth_acks = 0;
+
+	if (sctx->lat_avg_us > 2 * sctx->lat_base_us)
+		sctx->rd_depth = max(sctx->rd_depth / 2, SCRUB_RD_DEPTH_MIN);
+	else if (sctx->rd_depth < SCRUB_RD_DEPTH_MAX)
+		sctx->rd_depth++;
+}
+
 static void scrub_submit(struct scrub_ctx *sctx)
 {
 	struct scrub_bio *sbio;
@@ -2221,8 +2293,14 @@ static void scrub_submit(struct scrub_ctx *sctx)
 
 	scrub_throttle(sctx);
 
+	/* Don't queue up more reads than the device serves without delay */
+	wait_event(sctx->list_wait, atomic_read(&sctx->rd_in_flight) <
+				    READ_ONCE(sctx->rd_depth));
+	atomic_inc(&sctx->rd_in_flight);
+
 	sbio = sctx->bios[sctx->curr];
 	sctx->curr = -1;
+	sbio->submit_time = ktime_get();
 	scrub_pending_bio_inc(sctx);
 	btrfsic_check_bio(sbio->bio);
 	submit_bio(sbio->bio);
@@ -2499,6 +2577,7 @@ static void scrub_bio_end_io(struct bio *bio)
 
 	sbio->status = bio->bi_status;
 	sbio->bio = bio;
+	sbio->latency_us = ktime_us_delta(ktime_get(), sbio->submit_time);
 
 	queue_work(fs_info->scrub_workers, &sbio->work);
 }
@@ -2534,6 +2613,8 @@ static void scrub_bio_end_io_worker(struct work_struct *work)
 	spin_lock(&sctx->list_lock);
 	sbio->next_free = sctx->first_free;
 	sctx->first_free = sbio->index;
+	scrub_update_rd_depth(sctx, sbio->latency_us);
+	atomic_dec(&sctx->rd_in_flight);
 	spin_unlock(&sctx->list_lock);
 
 	if (sctx->is_dev_replace && sctx->flush_all_writes) {
@@ -2148,7 +2148,7 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 		 * Make a pass through all the delayed refs we have so far.
 		 * Any running threads may add more while we are here.
 		 */
-		ret = btrfs_run_delayed_refs(trans, 0);
+		ret = btrfs_run_delayed_refs_parallel(trans);
 		if (ret)
 			goto lockdep_trans_commit_start_release;
 	}
@@ -2112,7 +2112,8 @@ static void ceph_send_cap_releases(struct ceph_mds_client *mdsc,
 	while (!list_empty(&tmp_list)) {
 		if (!msg) {
 			msg = ceph_msg_new(CEPH_MSG_CLIENT_CAPRELEASE,
-					PAGE_SIZE, GFP_NOFS, false);
+					CEPH_CAP_RELEASE_MSG_PAGES * PAGE_SIZE,
+					GFP_NOFS, false);
 			if (!msg)
 				goto out_err;
 			head = msg->front.iov_base;
@@ -2140,7 +2141,7 @@ static void ceph_send_cap_releases(struct ceph_mds_client *mdsc,
 
 		ceph_put_cap(mdsc, cap);
 
-		if (le32_to_cpu(head->num) == CEPH_CAPS_PER_RELEASE) {
+		if (le32_to_cpu(head->num) == CEPH_CAPS_PER_RELEASE_MSG) {
 			// Append cap_barrier field
 			cap_barrier = msg->front.iov_base + msg->front.iov_len;
 			*cap_barrier = barrier;
@@ -2218,7 +2219,7 @@ void __ceph_queue_cap_release(struct ceph_mds_session *session,
 	list_add_tail(&cap->session_caps, &session->s_cap_releases);
 	session->s_num_cap_releases++;
 
-	if (!(session->s_num_cap_releases % CEPH_CAPS_PER_RELEASE))
+	if (!(session->s_num_cap_releases % CEPH_CAPS_PER_RELEASE_MSG))
 		ceph_flush_cap_releases(session->s_mdsc, session);
 }
 
@@ -161,6 +161,16 @@ struct ceph_mds_reply_info_parsed {
 				sizeof(struct ceph_mds_cap_release)) /	\
 			        sizeof(struct ceph_mds_cap_item))
 
+/*
+ * A release message spans several pages, so trimming or dropping a large
+ * number of caps takes a fraction of the messages and MDS dispatches.
+ */
+#define CEPH_CAP_RELEASE_MSG_PAGES	4
+#define CEPH_CAPS_PER_RELEASE_MSG					\
+	((CEPH_CAP_RELEASE_MSG_PAGES * PAGE_SIZE - sizeof(u32) -	\
+	  sizeof(struct ceph_mds_cap_release)) /			\
+	 sizeof(struct ceph_mds_cap_item))
+
 
 /*
  * state associated with each MDS<->client session
@@ -32,6 +32,7 @@
 #include <linux/bit_spinlock.h>
 #include <linux/rculist_bl.h>
 #include <linux/list_lru.h>
+#include <linux/seq_file.h>
 #include "internal.h"
 #include "mount.h"
 
@@ -128,6 +129,13 @@ static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
 static DEFINE_PER_CPU(long, nr_dentry_negative);
 
+/*
+ * Unused negative dentries a superblock may keep on its LRU, 0 for no limit.
+ * Going over it kicks a work pruning the oldest ones, and past twice the
+ * limit negative dentries are no longer retained at all.
+ */
+static unsigned long negative_dentry_limit __read_mostly;
+
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 /* Statistics gathering. */
 static struct dentry_stat_t dentry_stat = {
@@ -191,6 +199,13 @@ static struct ctl_table fs_dcache_sysctls[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_nr_dentry,
 	},
+	{
+		.procname	= "negative-dentry-limit",
+		.data		= &negative_dentry_limit,
+		.maxlen		= sizeof(negative_dentry_limit),
+		.mode		= 0644,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
 	{ }
 };
 
@@ -336,6 +351,38 @@ void release_dentry_name_snapshot(struct name_snapshot *name)
 }
 EXPORT_SYMBOL(release_dentry_name_snapshot);
 
+static inline void dentry_negative_inc(struct dentry *dentry)
+{
+	this_cpu_inc(nr_dentry_negative);
+	percpu_counter_inc(&dentry->d_sb->s_nr_dentry_negative);
+}
+
+static inline void dentry_negative_dec(struct dentry *dentry)
+{
+	this_cpu_dec(nr_dentry_negative);
+	percpu_counter_dec(&dentry->d_sb->s_nr_dentry_negative);
+}
+
+static inline bool sb_negative_over_limit(struct super_block *sb, int mult)
+{
+	unsigned long limit = READ_ONCE(negative_dentry_limit);
+
+	return limit &&
+	       percpu_counter_read_positive(&sb->s_nr_dentry_negative) >
+	       limit * mult;
+}
+
+/* called when a negative dentry went on the LRU */
+static void dentry_negative_added(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+
+	dentry_negative_inc(dentry);
+	if (unlikely(sb_negative_over_limit(sb, 1)) &&
+	    !work_pending(&sb->s_dentry_negative_work))
+		queue_work(system_unbound_wq, &sb->s_dentry_negative_work);
+}
+
 static inline void __d_set_inode_and_type(struct dentry *dentry,
 					  struct inode *inode,
 					  unsigned type_flags)
@@ -357,7 +404,7 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_inc(nr_dentry_negative);
+		dentry_negative_added(dentry);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -427,7 +474,7 @@ static void d_lru_add(struct dentry *dentry)
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_inc(nr_dentry_negative);
+		dentry_negative_added(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -437,7 +484,7 @@ static void d_lru_del(struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		dentry_negative_dec(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -469,7 +516,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		dentry_negative_dec(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -479,7 +526,7 @@ static void d_lru_shrink_move(struct list_lru_one *lru, struct dentry *dentry,
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags |= DCACHE_SHRINK_LIST;
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		dentry_negative_dec(dentry);
 	list_lru_isolate_move(lru, &dentry->d_lru, list);
 }
 
@@ -679,6 +726,12 @@ static inline bool retain_dentry(struct dentry *dentry)
 	if (unlikely(dentry->d_flags & DCACHE_DONTCACHE))
 		return false;
 
+	/* the pruning doesn't keep up, stop caching lookup failures */
+	if (unlikely(d_is_negative(dentry)) &&
+	    !(dentry->d_flags & DCACHE_LRU_LIST) &&
+	    unlikely(sb_negative_over_limit(dentry->d_sb, 2)))
+		return false;
+
 	/* retain; LRU fodder */
 	dentry->d_lockref.count--;
 	if (unlikely(!(dentry->d_flags & DCACHE_LRU_LIST)))
@@ -1202,21 +1255,10 @@ void shrink_dentry_list(struct list_head *list)
 	}
 }
 
-static enum lru_status dentry_lru_isolate(struct list_head *item,
-		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+/* called with the d_lock of @dentry held, drops it */
+static enum lru_status __dentry_lru_isolate(struct dentry *dentry,
+		struct list_lru_one *lru, struct list_head *freeable)
 {
-	struct list_head *freeable = arg;
-	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
-
-
-	/*
-	 * we are inverting the lru lock/dentry->d_lock here,
-	 * so use a trylock. If we fail to get the lock, just skip
-	 * it
-	 */
-	if (!spin_trylock(&dentry->d_lock))
-		return LRU_SKIP;
-
 	/*
 	 * Referenced dentries are still in use. If they have active
 	 * counts, just remove them from the LRU. Otherwise give them
@@ -1260,6 +1302,24 @@ static enum lru_status dentry_lru_isolate(struct list_head *item,
 	return LRU_REMOVED;
 }
 
+static enum lru_status dentry_lru_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+
+	/*
+	 * we are inverting the lru lock/dentry->d_lock here,
+	 * so use a trylock. If we fail to get the lock, just skip
+	 * it
+	 */
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	return __dentry_lru_isolate(dentry, lru, freeable);
+}
+
 /**
  * prune_dcache_sb - shrink the dcache
  * @sb: superblock
@@ -1283,6 +1343,86 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+static enum lru_status dentry_lru_isolate_negative(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	/*
+	 * Positive dentries are rotated so that the next batch gets to
+	 * see entries further down the list.
+	 */
+	if (!d_is_negative(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+	return __dentry_lru_isolate(dentry, lru, freeable);
+}
+
+#define PRUNE_NEGATIVE_BATCH	1024
+
+/**
+ * prune_dcache_sb_negative - trim the unused negative dentries of a superblock
+ * @sb: superblock
+ *
+ * Frees the oldest unused negative dentries of @sb until it is back to 7/8 of
+ * fs.negative-dentry-limit, walking the LRU at most once. Runs from the work
+ * d_lru_add() kicks when the limit is exceeded, so that the cost of a large
+ * dcache isn't left to the shrinker alone.
+ *
+ * Returns the number of dentries freed.
+ */
+long prune_dcache_sb_negative(struct super_block *sb)
+{
+	unsigned long limit = READ_ONCE(negative_dentry_limit);
+	unsigned long walk = list_lru_count(&sb->s_dentry_lru);
+	long freed = 0;
+
+	while (limit && walk) {
+		unsigned long nr_to_walk = min_t(unsigned long, walk,
+						 PRUNE_NEGATIVE_BATCH);
+		LIST_HEAD(dispose);
+
+		if (percpu_counter_sum_positive(&sb->s_nr_dentry_negative) <=
+		    limit - limit / 8)
+			break;
+
+		walk -= nr_to_walk;
+		freed += list_lru_walk(&sb->s_dentry_lru,
+				       dentry_lru_isolate_negative, &dispose,
+				       nr_to_walk);
+		shrink_dentry_list(&dispose);
+		cond_resched();
+	}
+
+	WRITE_ONCE(sb->s_dentry_negative_pruned,
+		   sb->s_dentry_negative_pruned + freed);
+	return freed;
+}
+
+/**
+ * dcache_show_stats - report the dcache state of a superblock
+ * @m: seq_file to print to
+ * @sb: superblock
+ *
+ * Prints the number of unused dentries of @sb, how many of them are
+ * negative, and how many negative ones fs.negative-dentry-limit pruned so
+ * far. Meant for ->show_stats() hooks, which decide where it goes in their
+ * mountstats output.
+ */
+void dcache_show_stats(struct seq_file *m, struct super_block *sb)
+{
+	seq_printf(m, "unused %lu negative %lld pruned %lu",
+		   list_lru_count(&sb->s_dentry_lru),
+		   percpu_counter_sum_positive(&sb->s_nr_dentry_negative),
+		   READ_ONCE(sb->s_dentry_negative_pruned));
+}
+EXPORT_SYMBOL_GPL(dcache_show_stats);
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -2003,7 +2143,7 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 	 * Decrement negative dentry count if it was in the LRU list.
 	 */
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_dec(nr_dentry_negative);
+		dentry_negative_dec(dentry);
 	hlist_add_head(&dentry->d_u.d_alias, &inode->i_dentry);
 	raw_write_seqcount_begin(&dentry->d_seq);
 	__d_set_inode_and_type(dentry, inode, add_flags);
@@ -436,8 +436,16 @@ static int erofs_file_mmap(struct file *file, struct vm_area_struct *vma)
 #define erofs_file_mmap	generic_file_readonly_mmap
 #endif
 
+static int erofs_file_open(struct inode *inode, struct file *file)
+{
+	/* buffered reads take no locks, filemap_read() handles IOCB_WAITQ */
+	file->f_mode |= FMODE_BUF_RASYNC;
+	return 0;
+}
+
 const struct file_operations erofs_file_fops = {
 	.llseek		= generic_file_llseek,
+	.open		= erofs_file_open,
 	.read_iter	= erofs_file_read_iter,
 	.mmap		= erofs_file_mmap,
 	.splice_read	= generic_file_splice_read,
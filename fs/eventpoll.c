@@ -14,10 +14,12 @@
 #include <linux/signal.h>
 #include <linux/errno.h>
 #include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/string.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/hash.h>
 #include <linux/spinlock.h>
 #include <linux/syscalls.h>
@@ -32,6 +34,7 @@
 #include <linux/uaccess.h>
 #include <asm/io.h>
 #include <asm/mman.h>
+#include <asm/shmparam.h>
 #include <linux/atomic.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
@@ -45,18 +48,19 @@
  *
  * 1) epmutex (mutex)
  * 2) ep->mtx (mutex)
- * 3) ep->lock (rwlock)
+ * 3) ep->lock (spinlock)
  *
  * The acquire order is the one listed above, from 1 to 3.
- * We need a rwlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
- * user space) we could end up sleeping due a copy_to_user(), so
- * we need a lock that will allow us to sleep. This lock is a
- * mutex (ep->mtx). It is acquired during the event transfer loop,
- * during epoll_ctl(EPOLL_CTL_DEL) and during eventpoll_release_file().
+ * The poll callback, that might be triggered from a wake_up() that in
+ * turn might be called from IRQ context, takes no epoll lock at all: it
+ * pushes the item on the lockless ep->pending list. ep->lock protects
+ * the ready list, the pending items are moved there under it by whoever
+ * is about to look at the ready list.
+ * During the event transfer loop (from kernel to user space) we could
+ * end up sleeping due a copy_to_user(), so we need a lock that will
+ * allow us to sleep. This lock is a mutex (ep->mtx). It is acquired
+ * during the event transfer loop, during epoll_ctl(EPOLL_CTL_DEL) and
+ * during eventpoll_release_file().
  * Then we also need a global mutex to serialize eventpoll_release_file()
  * and ep_free().
  * This mutex is acquired by ep_free() during the epoll file
@@ -100,6 +104,8 @@
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
+#define EP_RING_MAX_ENTRIES (1U << 16)
+
 #define EP_UNACTIVE_PTR ((void *) -1L)
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
@@ -145,10 +151,10 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links the item on "struct eventpoll"->pending, ->llink.next is
+	 * EP_UNACTIVE_PTR while it is not queued there.
 	 */
-	struct epitem *next;
+	struct llist_node llink;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -169,6 +175,19 @@ struct epitem {
 	struct epoll_event event;
 };
 
+/* Kernel side of the event ring mapped by userspace, see EPIOCSRING */
+struct ep_ring {
+	/* Serializes the producers, the poll callback and ep_send_events() */
+	spinlock_t lock;
+
+	/* Producer index, userspace only ever gets a copy of it */
+	u32 tail;
+	u32 mask;
+
+	struct epoll_ring *hdr;
+	size_t size;
+};
+
 /*
  * This structure is stored inside the "private_data" member of the file
  * structure and represents the main data structure for the eventpoll
@@ -192,22 +211,25 @@ struct eventpoll {
 	/* List of ready file descriptors */
 	struct list_head rdllist;
 
-	/* Lock which protects rdllist and ovflist */
-	rwlock_t lock;
+	/* Lock which protects rdllist */
+	spinlock_t lock;
 
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root_cached rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Items reported ready by the poll callback, still to be moved to
+	 * rdllist. Pushed to without any lock, so that events coming from
+	 * many CPUs at once don't serialize on ->lock.
 	 */
-	struct epitem *ovflist;
+	struct llist_head pending;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
 
+	/* Event ring, set once under "mtx" and freed by ep_free() */
+	struct ep_ring *ring;
+
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
 
@@ -368,6 +390,20 @@ static inline struct epitem *ep_item_from_wait(wait_queue_entry_t *p)
 	return container_of(p, struct eppoll_entry, wait)->base;
 }
 
+/*
+ * Number of ring entries not consumed by userspace yet. A bogus head
+ * written by userspace can only make the ring look full.
+ */
+static inline u32 ep_ring_avail(struct ep_ring *ring)
+{
+	u32 avail;
+
+	if (!ring)
+		return 0;
+	avail = READ_ONCE(ring->tail) - READ_ONCE(ring->hdr->head);
+	return min(avail, ring->mask + 1);
+}
+
 /**
  * ep_events_available - Checks if ready events might be available.
  *
@@ -379,7 +415,8 @@ static inline struct epitem *ep_item_from_wait(wait_queue_entry_t *p)
 static inline int ep_events_available(struct eventpoll *ep)
 {
 	return !list_empty_careful(&ep->rdllist) ||
-		READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR;
+		!llist_empty(&ep->pending) ||
+		ep_ring_avail(READ_ONCE(ep->ring));
 }
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
@@ -605,6 +642,68 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 }
 
 
+/*
+ * Publishes an event into the ring, must be called with ring->lock held.
+ *
+ * Return: %false if the ring is full.
+ */
+static bool ep_ring_post(struct ep_ring *ring, __poll_t revents, __u64 data)
+{
+	struct epoll_ring *hdr = ring->hdr;
+	struct epoll_event *uev;
+
+	lockdep_assert_held(&ring->lock);
+
+	/* pairs with the release of head by userspace, done with the slot */
+	if (ring->tail - smp_load_acquire(&hdr->head) > ring->mask)
+		return false;
+
+	uev = &hdr->events[ring->tail & ring->mask];
+	uev->events = revents;
+	uev->data = data;
+	/* entry before tail, pairs with the acquire of tail by userspace */
+	smp_store_release(&hdr->tail, ring->tail + 1);
+	WRITE_ONCE(ring->tail, ring->tail + 1);
+	return true;
+}
+
+static void ep_ring_free(struct ep_ring *ring)
+{
+	if (!ring)
+		return;
+	vfree(ring->hdr);
+	kfree(ring);
+}
+
+/*
+ * Moves the items queued by the poll callback to the tail of the ready
+ * list, in the order they were reported. Items already linked, because
+ * they are on the ready list or on the "txlist" of a scan, stay where they
+ * are. Must be called with ep->lock held.
+ */
+static void ep_drain_pending(struct eventpoll *ep)
+{
+	struct llist_node *node;
+	struct epitem *epi, *tmp;
+
+	lockdep_assert_held(&ep->lock);
+
+	node = llist_del_all(&ep->pending);
+	if (!node)
+		return;
+
+	/* ->pending is LIFO */
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(epi, tmp, node, llink) {
+		/* from now on the poll callback may queue the item again */
+		smp_store_release(&epi->llink.next, EP_UNACTIVE_PTR);
+		if (!ep_is_linked(epi)) {
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+			ep_pm_stay_awake(epi);
+		}
+	}
+}
+
 /*
  * ep->mutex needs to be held because we could be hit by
  * eventpoll_release_file() and epoll_ctl().
@@ -613,58 +712,33 @@ static void ep_start_scan(struct eventpoll *ep, struct list_head *txlist)
 {
 	/*
 	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * empty list. Events happening while looping w/out locks are
+	 * queued on ep->pending by the poll callback, which never touches
+	 * the ready list, so the "sproc" callback is free to put items
+	 * back on it in a lockless way.
 	 */
 	lockdep_assert_irqs_enabled();
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
+	ep_drain_pending(ep);
 	list_splice_init(&ep->rdllist, txlist);
-	WRITE_ONCE(ep->ovflist, NULL);
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 }
 
 static void ep_done_scan(struct eventpoll *ep,
 			 struct list_head *txlist)
 {
-	struct epitem *epi, *nepi;
-
-	write_lock_irq(&ep->lock);
-	/*
-	 * During the time we spent inside the "sproc" callback, some
-	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
-	 */
-	for (nepi = READ_ONCE(ep->ovflist); (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(epi)) {
-			/*
-			 * ->ovflist is LIFO, so we have to reverse it in order
-			 * to keep in FIFO.
-			 */
-			list_add(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
+	spin_lock_irq(&ep->lock);
 	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
+	 * Quickly re-inject items left on "txlist".
 	 */
-	WRITE_ONCE(ep->ovflist, EP_UNACTIVE_PTR);
+	list_splice(txlist, &ep->rdllist);
 
 	/*
-	 * Quickly re-inject items left on "txlist".
+	 * During the time we spent inside the "sproc" callback, some
+	 * other events might have been queued by the poll callback.
+	 * We insert them inside the main ready-list here.
 	 */
-	list_splice(txlist, &ep->rdllist);
+	ep_drain_pending(ep);
 	__pm_relax(ep->ws);
 
 	if (!list_empty(&ep->rdllist)) {
@@ -672,7 +746,7 @@ static void ep_done_scan(struct eventpoll *ep,
 			wake_up(&ep->wq);
 	}
 
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 }
 
 static void epi_rcu_free(struct rcu_head *head)
@@ -717,10 +791,12 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase_cached(&epi->rbn, &ep->rbr);
 
-	write_lock_irq(&ep->lock);
+	/* the poll callbacks are gone, but the item may still be pending */
+	spin_lock_irq(&ep->lock);
+	ep_drain_pending(ep);
 	if (ep_is_linked(epi))
 		list_del_init(&epi->rdllink);
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 	/*
@@ -786,6 +862,8 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	/* the mappings of the ring hold a reference on the file */
+	ep_ring_free(ep->ring);
 	kfree(ep);
 }
 
@@ -814,6 +892,9 @@ static __poll_t __ep_eventpoll_poll(struct file *file, poll_table *wait, int dep
 	/* Insert inside our poll wait queue */
 	poll_wait(file, &ep->poll_wait, wait);
 
+	if (ep_ring_avail(READ_ONCE(ep->ring)))
+		return EPOLLIN | EPOLLRDNORM;
+
 	/*
 	 * Proceed to find out if wanted events are really available inside
 	 * the ready list.
@@ -863,6 +944,72 @@ static __poll_t ep_eventpoll_poll(struct file *file, poll_table *wait)
 	return __ep_eventpoll_poll(file, wait, 0);
 }
 
+static int ep_ring_setup(struct eventpoll *ep, unsigned long entries)
+{
+	struct ep_ring *ring;
+	int error = -ENOMEM;
+
+	if (!entries || entries > EP_RING_MAX_ENTRIES)
+		return -EINVAL;
+	entries = roundup_pow_of_two(entries);
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL_ACCOUNT);
+	if (!ring)
+		return -ENOMEM;
+	spin_lock_init(&ring->lock);
+	ring->mask = entries - 1;
+	ring->size = PAGE_ALIGN(struct_size(ring->hdr, events, entries));
+	/* vmalloc_user(), but charged to the memcg of the task setting it up */
+	ring->hdr = __vmalloc_node_range(ring->size, SHMLBA, VMALLOC_START,
+					 VMALLOC_END,
+					 GFP_KERNEL_ACCOUNT | __GFP_ZERO,
+					 PAGE_KERNEL, VM_USERMAP, NUMA_NO_NODE,
+					 __builtin_return_address(0));
+	if (!ring->hdr)
+		goto out_free;
+	ring->hdr->ring_entries = entries;
+
+	mutex_lock(&ep->mtx);
+	error = -EBUSY;
+	if (!ep->ring) {
+		/* pairs with the poll callback, which runs without "mtx" */
+		smp_store_release(&ep->ring, ring);
+		error = 0;
+	}
+	mutex_unlock(&ep->mtx);
+	if (!error)
+		return 0;
+out_free:
+	ep_ring_free(ring);
+	return error;
+}
+
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+
+	switch (cmd) {
+	case EPIOCSRING:
+		return ep_ring_setup(ep, arg);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+static int ep_eventpoll_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct eventpoll *ep = file->private_data;
+	struct ep_ring *ring = smp_load_acquire(&ep->ring);
+
+	if (!ring)
+		return -ENXIO;
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > ring->size)
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYEXEC;
+	return remap_vmalloc_range(vma, ring->hdr, 0);
+}
+
 #ifdef CONFIG_PROC_FS
 static void ep_show_fdinfo(struct seq_file *m, struct file *f)
 {
@@ -894,6 +1041,9 @@ static const struct file_operations eventpoll_fops = {
 #endif
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.mmap		= ep_eventpoll_mmap,
 	.llseek		= noop_llseek,
 };
 
@@ -948,12 +1098,12 @@ static int ep_alloc(struct eventpoll **pep)
 		goto free_uid;
 
 	mutex_init(&ep->mtx);
-	rwlock_init(&ep->lock);
+	spin_lock_init(&ep->lock);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT_CACHED;
-	ep->ovflist = EP_UNACTIVE_PTR;
+	init_llist_head(&ep->pending);
 	ep->user = user;
 
 	*pep = ep;
@@ -1039,80 +1189,43 @@ struct file *get_epoll_tfile_raw_ptr(struct file *file, int tfd,
 #endif /* CONFIG_KCMP */
 
 /*
- * Adds a new entry to the tail of the list in a lockless way, i.e.
- * multiple CPUs are allowed to call this function concurrently.
- *
- * Beware: it is necessary to prevent any other modifications of the
- *         existing list until all changes are completed, in other words
- *         concurrent list_add_tail_lockless() calls should be protected
- *         with a read lock, where write lock acts as a barrier which
- *         makes sure all list_add_tail_lockless() calls are fully
- *         completed.
- *
- *        Also an element can be locklessly added to the list only in one
- *        direction i.e. either to the tail or to the head, otherwise
- *        concurrent access will corrupt the list.
+ * Queues @epi on ep->pending in a lockless way, i.e. multiple CPUs are
+ * allowed to call this function concurrently, for the same item as well.
  *
- * Return: %false if element has been already added to the list, %true
- * otherwise.
+ * Return: %false if the item has been already queued, %true otherwise.
  */
-static inline bool list_add_tail_lockless(struct list_head *new,
-					  struct list_head *head)
+static inline bool ep_queue_pending(struct epitem *epi)
 {
-	struct list_head *prev;
+	struct llist_node *unactive = EP_UNACTIVE_PTR;
 
-	/*
-	 * This is simple 'new->next = head' operation, but cmpxchg()
-	 * is used in order to detect that same element has been just
-	 * added to the list from another CPU: the winner observes
-	 * new->next == new.
-	 */
-	if (!try_cmpxchg(&new->next, &new, head))
+	/* Fast preliminary check */
+	if (READ_ONCE(epi->llink.next) != unactive)
 		return false;
 
-	/*
-	 * Initially ->next of a new element must be updated with the head
-	 * (we are inserting to the tail) and only then pointers are atomically
-	 * exchanged.  XCHG guarantees memory ordering, thus ->next should be
-	 * updated before pointers are actually swapped and pointers are
-	 * swapped before prev->next is updated.
-	 */
-
-	prev = xchg(&head->prev, new);
+	/* Check that the same epi has not been just queued from another CPU */
+	if (!try_cmpxchg(&epi->llink.next, &unactive, NULL))
+		return false;
 
 	/*
-	 * It is safe to modify prev->next and new->prev, because a new element
-	 * is added only to the tail and new->next is updated before XCHG.
+	 * llist_add() is a fully ordered cmpxchg(), the waitqueue_active()
+	 * checks of the caller can't be reordered before it.
 	 */
-
-	prev->next = new;
-	new->prev = prev;
+	llist_add(&epi->llink, &epi->ep->pending);
 
 	return true;
 }
 
 /*
- * Chains a new epi entry to the tail of the ep->ovflist in a lockless way,
- * i.e. multiple CPUs are allowed to call this function concurrently.
- *
- * Return: %false if epi element has been already chained, %true otherwise.
+ * Tells whether an event reported to the poll callback can be published
+ * straight into the event ring.
  */
-static inline bool chain_epi_lockless(struct epitem *epi)
+static inline bool ep_ring_direct(struct epitem *epi, __poll_t pollflags)
 {
-	struct eventpoll *ep = epi->ep;
-
-	/* Fast preliminary check */
-	if (epi->next != EP_UNACTIVE_PTR)
+	if ((epi->event.events & (EPOLLET | EPOLLONESHOT | EPOLLWAKEUP)) !=
+	    EPOLLET)
 		return false;
-
-	/* Check that the same epi has not been just chained from another CPU */
-	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
-		return false;
-
-	/* Atomically exchange tail */
-	epi->next = xchg(&ep->ovflist, epi);
-
-	return true;
+	return !(pollflags & POLLFREE) &&
+		(pollflags & epi->event.events & ~EP_PRIVATE_BITS);
 }
 
 /*
@@ -1120,11 +1233,9 @@ static inline bool chain_epi_lockless(struct epitem *epi)
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
  *
- * This callback takes a read lock in order not to contend with concurrent
- * events from another file descriptor, thus all modifications to ->rdllist
- * or ->ovflist are lockless.  Read lock is paired with the write lock from
- * ep_scan_ready_list(), which stops all list modifications and guarantees
- * that lists state is seen correctly.
+ * This callback takes no epoll lock in order not to contend with concurrent
+ * events from other file descriptors: the item is pushed on ->pending and
+ * moved to ->rdllist by the next one to look at it under ->lock.
  *
  * Another thing worth to mention is that ep_poll_callback() can be called
  * concurrently for the same @epi from different CPUs if poll table was inited
@@ -1139,11 +1250,9 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 	__poll_t pollflags = key_to_poll(key);
-	unsigned long flags;
+	struct ep_ring *ring;
 	int ewake = 0;
 
-	read_lock_irqsave(&ep->lock, flags);
-
 	ep_set_busy_poll_napi_id(epi);
 
 	/*
@@ -1153,7 +1262,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -1162,23 +1271,37 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (pollflags && !(pollflags & epi->event.events))
-		goto out_unlock;
+		goto out;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * With an event ring, edge-triggered events are published right away.
+	 * The others need the f_op->poll() call of ep_send_events(), for
+	 * level-triggered items or to disable EPOLLONESHOT ones under
+	 * "mtx", so they go through the ready list as usual. So do events
+	 * that don't fit in the ring, flagging it for userspace.
 	 */
-	if (READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR) {
-		if (chain_epi_lockless(epi))
-			ep_pm_stay_awake_rcu(epi);
-	} else if (!ep_is_linked(epi)) {
-		/* In the usual case, add event to ready list. */
-		if (list_add_tail_lockless(&epi->rdllink, &ep->rdllist))
-			ep_pm_stay_awake_rcu(epi);
+	ring = READ_ONCE(ep->ring);
+	if (ring && ep_ring_direct(epi, pollflags)) {
+		unsigned long flags;
+		bool posted;
+
+		spin_lock_irqsave(&ring->lock, flags);
+		posted = ep_ring_post(ring, pollflags & epi->event.events &
+				      ~EP_PRIVATE_BITS, epi->event.data);
+		if (!posted)
+			ring->hdr->flags |= EPOLL_RING_OVERFLOW;
+		spin_unlock_irqrestore(&ring->lock, flags);
+
+		/* tail before waitqueue_active(), pairs with ep_poll() */
+		smp_mb();
+		if (posted)
+			goto wake;
 	}
 
+	if (ep_queue_pending(epi))
+		ep_pm_stay_awake_rcu(epi);
+
+wake:
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
@@ -1205,10 +1328,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
-out_unlock:
-	read_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
+out:
 	if (pwake)
 		ep_poll_safewake(ep, epi, pollflags & EPOLL_URING_WAKE);
 
@@ -1472,7 +1592,7 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	epi->ep = ep;
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->llink.next = EP_UNACTIVE_PTR;
 
 	if (tep)
 		mutex_lock_nested(&tep->mtx, 1);
@@ -1534,7 +1654,7 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	}
 
 	/* We have to drop the new item inside our item list to keep track of it */
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
 
 	/* record NAPI ID of new item if present */
 	ep_set_busy_poll_napi_id(epi);
@@ -1551,7 +1671,7 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 			pwake++;
 	}
 
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 
 	/* We have to call this outside the lock */
 	if (pwake)
@@ -1595,8 +1715,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
 	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    changing epi above (and ep_poll_callback takes no
+	 *    lock at all).
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1615,7 +1735,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 * list, push it inside.
 	 */
 	if (ep_item_poll(epi, &pt, 1)) {
-		write_lock_irq(&ep->lock);
+		spin_lock_irq(&ep->lock);
 		if (!ep_is_linked(epi)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
@@ -1626,7 +1746,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
-		write_unlock_irq(&ep->lock);
+		spin_unlock_irq(&ep->lock);
 	}
 
 	/* We have to call this outside the lock */
@@ -1636,9 +1756,28 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	return 0;
 }
 
+/*
+ * Like epoll_put_uevent(), for the event ring.
+ */
+static bool ep_ring_send(struct ep_ring *ring, __poll_t revents, __u64 data)
+{
+	bool posted;
+
+	spin_lock_irq(&ring->lock);
+	posted = ep_ring_post(ring, revents, data);
+	spin_unlock_irq(&ring->lock);
+	return posted;
+}
+
+/*
+ * Transfers the ready events to userspace: into @events, or into the event
+ * ring when one is set up, in which case the number of entries waiting in
+ * the ring is returned.
+ */
 static int ep_send_events(struct eventpoll *ep,
 			  struct epoll_event __user *events, int maxevents)
 {
+	struct ep_ring *ring = ep->ring;
 	struct epitem *epi, *tmp;
 	LIST_HEAD(txlist);
 	poll_table pt;
@@ -1655,6 +1794,12 @@ static int ep_send_events(struct eventpoll *ep,
 	init_poll_funcptr(&pt, NULL);
 
 	mutex_lock(&ep->mtx);
+	if (ring) {
+		/* overflows that happen from now on are seen by the scan */
+		spin_lock_irq(&ring->lock);
+		ring->hdr->flags &= ~EPOLL_RING_OVERFLOW;
+		spin_unlock_irq(&ring->lock);
+	}
 	ep_start_scan(ep, &txlist);
 
 	/*
@@ -1695,13 +1840,23 @@ static int ep_send_events(struct eventpoll *ep,
 		if (!revents)
 			continue;
 
-		events = epoll_put_uevent(revents, epi->event.data, events);
-		if (!events) {
-			list_add(&epi->rdllink, &txlist);
-			ep_pm_stay_awake(epi);
-			if (!res)
-				res = -EFAULT;
-			break;
+		if (ring) {
+			if (!ep_ring_send(ring, revents, epi->event.data)) {
+				/* ring full, left for the next call */
+				list_add(&epi->rdllink, &txlist);
+				ep_pm_stay_awake(epi);
+				break;
+			}
+		} else {
+			events = epoll_put_uevent(revents, epi->event.data,
+						  events);
+			if (!events) {
+				list_add(&epi->rdllink, &txlist);
+				ep_pm_stay_awake(epi);
+				if (!res)
+					res = -EFAULT;
+				break;
+			}
 		}
 		res++;
 		if (epi->event.events & EPOLLONESHOT)
@@ -1716,7 +1871,7 @@ static int ep_send_events(struct eventpoll *ep,
 			 * into ep->rdllist besides us. The epoll_ctl()
 			 * callers are locked out by
 			 * ep_scan_ready_list() holding "mtx" and the
-			 * poll callback will queue them in ep->ovflist.
+			 * poll callback queues on ep->pending.
 			 */
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
@@ -1725,6 +1880,8 @@ static int ep_send_events(struct eventpoll *ep,
 	ep_done_scan(ep, &txlist);
 	mutex_unlock(&ep->mtx);
 
+	if (ring)
+		res = ep_ring_avail(ring);
 	return res;
 }
 
@@ -1843,8 +2000,8 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 * chance to harvest new event. Otherwise wakeup can be
 		 * lost. This is also good performance-wise, because on
 		 * normal wakeup path no need to call __remove_wait_queue()
-		 * explicitly, thus ep->lock is not taken, which halts the
-		 * event delivery.
+		 * explicitly, thus ep->wq.lock is not taken, which halts
+		 * the event delivery.
 		 *
 		 * In fact, we now use an even more aggressive function that
 		 * unconditionally removes, because we don't reuse the wait
@@ -1855,26 +2012,31 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		init_wait(&wait);
 		wait.func = ep_autoremove_wake_function;
 
-		write_lock_irq(&ep->lock);
-		/*
-		 * Barrierless variant, waitqueue_active() is called under
-		 * the same lock on wakeup ep_poll_callback() side, so it
-		 * is safe to avoid an explicit barrier.
-		 */
+		spin_lock_irq(&ep->lock);
 		__set_current_state(TASK_INTERRUPTIBLE);
 
 		/*
-		 * Do the final check under the lock. ep_scan_ready_list()
-		 * plays with two lists (->rdllist and ->ovflist) and there
-		 * is always a race when both lists are empty for short
-		 * period of time although events are pending, so lock is
-		 * important.
+		 * ep_poll_callback() queues events without any lock and
+		 * then does waitqueue_active(), so get on the wait queue
+		 * before the final check, with a full barrier pairing with
+		 * the one in ep_queue_pending(), or the one following the
+		 * publishing of an event into the ring. The check is done under
+		 * ep->lock, ep_drain_pending() empties ->pending before it
+		 * fills ->rdllist.
 		 */
+		spin_lock(&ep->wq.lock);
+		__add_wait_queue_exclusive(&ep->wq, &wait);
+		spin_unlock(&ep->wq.lock);
+		smp_mb();
+
 		eavail = ep_events_available(ep);
-		if (!eavail)
-			__add_wait_queue_exclusive(&ep->wq, &wait);
+		if (eavail) {
+			spin_lock(&ep->wq.lock);
+			__remove_wait_queue(&ep->wq, &wait);
+			spin_unlock(&ep->wq.lock);
+		}
 
-		write_unlock_irq(&ep->lock);
+		spin_unlock_irq(&ep->lock);
 
 		if (!eavail)
 			timed_out = !schedule_hrtimeout_range(to, slack,
@@ -1889,7 +2051,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		eavail = 1;
 
 		if (!list_empty_careful(&wait.entry)) {
-			write_lock_irq(&ep->lock);
+			spin_lock_irq(&ep->wq.lock);
 			/*
 			 * If the thread timed out and is not on the wait queue,
 			 * it means that the thread was woken up after its
@@ -1900,7 +2062,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 			if (timed_out)
 				eavail = list_empty(&wait.entry);
 			__remove_wait_queue(&ep->wq, &wait);
-			write_unlock_irq(&ep->lock);
+			spin_unlock_irq(&ep->wq.lock);
 		}
 	}
 }
@@ -1822,6 +1822,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 	 */
 	check_unsafe_exec(bprm);
 	current->in_execve = 1;
+	sched_mm_cid_before_execve(current);
 
 	file = do_open_execat(fd, filename, flags);
 	retval = PTR_ERR(file);
@@ -1856,6 +1857,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
 	rseq_execve(current);
+	sched_mm_cid_after_execve(current);
 	acct_update_integrals(current);
 	task_numa_free(current, false);
 	return retval;
@@ -1873,6 +1875,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 out_unmark:
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
+	sched_mm_cid_after_execve(current);
 
 	return retval;
 }
@@ -2041,6 +2044,26 @@ static int do_execveat(int fd, struct filename *filename,
 	return do_execveat_common(fd, filename, argv, envp, flags);
 }
 
+/*
+ * Exec on behalf of a clone3(CLONE_SPAWN) child.  The child still shares
+ * the parent's mm, so the user pointers are the parent's and @compat tells
+ * how the parent laid out @argv and @envp.
+ */
+int spawn_execveat(int fd, const char __user *filename,
+		   const void __user *argv, const void __user *envp,
+		   int flags, bool compat)
+{
+	struct user_arg_ptr uargv = { .ptr.native = argv };
+	struct user_arg_ptr uenvp = { .ptr.native = envp };
+
+#ifdef CONFIG_COMPAT
+	uargv.is_compat = compat;
+	uenvp.is_compat = compat;
+#endif
+	return do_execveat_common(fd, getname_uflags(filename, flags),
+				  uargv, uenvp, flags);
+}
+
 #ifdef CONFIG_COMPAT
 static int compat_do_execve(struct filename *filename,
 	const compat_uptr_t __user *__argv,
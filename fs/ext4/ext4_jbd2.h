@@ -410,6 +410,19 @@ static inline int ext4_journal_blocks_per_page(struct inode *inode)
 	return 0;
 }
 
+/*
+ * Journal credits are reserved before the folio is known, assume the
+ * largest folio the mapping may hold.
+ */
+static inline int ext4_journal_blocks_per_folio(struct inode *inode)
+{
+	int bpp = ext4_journal_blocks_per_page(inode);
+
+	if (mapping_large_folio_support(inode->i_mapping))
+		return bpp << EXT4_MAX_FOLIO_ORDER;
+	return bpp;
+}
+
 static inline int ext4_journal_force_commit(journal_t *journal)
 {
 	if (journal)
@@ -1180,6 +1180,61 @@ static void ext4_fc_update_stats(struct super_block *sb, int status,
 	trace_ext4_fc_commit_stop(sb, nblks, status, commit_tid);
 }
 
+/* Account the time an fsync spent in ext4_fc_commit(), batched ones included */
+static void ext4_fc_update_fsync_stats(struct super_block *sb,
+				       ktime_t start_time)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fc_stats *stats = &sbi->s_fc_stats;
+	u64 fsync_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
+
+	spin_lock(&sbi->s_fc_lock);
+	stats->fc_num_fsyncs++;
+	if (likely(stats->s_fc_avg_fsync_time))
+		stats->s_fc_avg_fsync_time =
+			(fsync_time + stats->s_fc_avg_fsync_time * 3) / 4;
+	else
+		stats->s_fc_avg_fsync_time = fsync_time;
+	if (fsync_time > stats->s_fc_max_fsync_time)
+		stats->s_fc_max_fsync_time = fsync_time;
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * Group commit, as jbd2_journal_stop() does for synchronous handles: if the
+ * previous fsync came from another task, more are likely on their way. Give
+ * them about one commit time to queue their inodes, they then wait for this
+ * fast commit in jbd2_fc_begin_commit() and find their updates covered by it
+ * instead of each writing its own.
+ *
+ * This runs before the fast commit barrier is taken, so that handles are
+ * not held up for the window, and not at all when a fast commit is already
+ * running: the fsync will wait for that one anyway.
+ */
+static void ext4_fc_batch_wait(struct super_block *sb, journal_t *journal)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	pid_t pid = current->pid;
+	u64 batch_time;
+	ktime_t expires;
+
+	if (!journal->j_max_batch_time ||
+	    READ_ONCE(journal->j_flags) & JBD2_FAST_COMMIT_ONGOING ||
+	    READ_ONCE(sbi->s_fc_last_fsync_pid) == pid)
+		return;
+	WRITE_ONCE(sbi->s_fc_last_fsync_pid, pid);
+
+	batch_time = max_t(u64, sbi->s_fc_stats.s_fc_avg_commit_time,
+			   1000 * journal->j_min_batch_time);
+	batch_time = min_t(u64, batch_time, 1000 * journal->j_max_batch_time);
+	if (!batch_time)
+		return;
+
+	expires = ktime_add_ns(ktime_get(), batch_time);
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+}
+
 /*
  * The main commit entry point. Performs a fast commit for transaction
  * commit_tid if needed. If it's not possible to perform a fast commit
@@ -1193,13 +1248,15 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 	int nblks = 0, ret, bsize = journal->j_blocksize;
 	int subtid = atomic_read(&sbi->s_fc_subtid);
 	int status = EXT4_FC_STATUS_OK, fc_bufs_before = 0;
-	ktime_t start_time, commit_time;
+	ktime_t fsync_start, start_time, commit_time;
 
 	if (!test_opt2(sb, JOURNAL_FAST_COMMIT))
 		return jbd2_complete_transaction(journal, commit_tid);
 
 	trace_ext4_fc_commit_start(sb, commit_tid);
 
+	fsync_start = ktime_get();
+	ext4_fc_batch_wait(sb, journal);
 	start_time = ktime_get();
 
 restart_fc:
@@ -1211,6 +1268,7 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 			goto restart_fc;
 		ext4_fc_update_stats(sb, EXT4_FC_STATUS_SKIPPED, 0, 0,
 				commit_tid);
+		ext4_fc_update_fsync_stats(sb, fsync_start);
 		return 0;
 	} else if (ret) {
 		/*
@@ -1219,7 +1277,9 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 		 */
 		ext4_fc_update_stats(sb, EXT4_FC_STATUS_FAILED, 0, 0,
 				commit_tid);
-		return jbd2_complete_transaction(journal, commit_tid);
+		ret = jbd2_complete_transaction(journal, commit_tid);
+		ext4_fc_update_fsync_stats(sb, fsync_start);
+		return ret;
 	}
 
 	/*
@@ -1251,11 +1311,13 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 	 */
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 	ext4_fc_update_stats(sb, status, commit_time, nblks, commit_tid);
+	ext4_fc_update_fsync_stats(sb, fsync_start);
 	return ret;
 
 fallback:
 	ret = jbd2_fc_end_commit_fallback(journal);
 	ext4_fc_update_stats(sb, status, 0, 0, commit_tid);
+	ext4_fc_update_fsync_stats(sb, fsync_start);
 	return ret;
 }
 
@@ -2271,6 +2333,11 @@ int ext4_fc_info_show(struct seq_file *seq, void *v)
 		   stats->fc_num_commits, stats->fc_ineligible_commits,
 		   stats->fc_numblks,
 		   div_u64(stats->s_fc_avg_commit_time, 1000));
+	seq_printf(seq,
+		"%ld fsyncs\n%ld batched\n%lluus avg_fsync_time\n%lluus max_fsync_time\n",
+		   stats->fc_num_fsyncs, stats->fc_skipped_commits,
+		   div_u64(stats->s_fc_avg_fsync_time, 1000),
+		   div_u64(stats->s_fc_max_fsync_time, 1000));
 	seq_puts(seq, "Ineligible reasons:\n");
 	for (i = 0; i < EXT4_FC_REASON_MAX; i++)
 		seq_printf(seq, "\"%s\":\t%d\n", fc_ineligible_reasons[i],
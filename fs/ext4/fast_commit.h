@@ -123,6 +123,10 @@ struct ext4_fc_stats {
 	unsigned long fc_skipped_commits;
 	unsigned long fc_numblks;
 	u64 s_fc_avg_commit_time;
+	/* fsyncs handled by ext4_fc_commit() and the time they took */
+	unsigned long fc_num_fsyncs;
+	u64 s_fc_avg_fsync_time;
+	u64 s_fc_max_fsync_time;
 };
 
 #define EXT4_FC_REPLAY_REALLOC_INCREMENT	4
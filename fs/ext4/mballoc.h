@@ -162,6 +162,12 @@ struct ext4_locality_group {
 	spinlock_t		lg_prealloc_lock;
 };
 
+/* per-CPU goal of stream allocations, where the last one ended */
+struct ext4_mb_last_goal {
+	ext4_group_t		group;
+	ext4_grpblk_t		start;
+};
+
 struct ext4_allocation_context {
 	struct inode *ac_inode;
 	struct super_block *ac_sb;
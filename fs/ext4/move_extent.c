@@ -158,6 +158,18 @@ mext_page_double_lock(struct inode *inode1, struct inode *inode2,
 	 */
 	wait_on_page_writeback(page[0]);
 	wait_on_page_writeback(page[1]);
+	/*
+	 * Blocks are moved a page at a time, split the large folios
+	 * readahead may have left in either file.
+	 */
+	if ((PageTransCompound(page[0]) && split_huge_page(page[0])) ||
+	    (PageTransCompound(page[1]) && split_huge_page(page[1]))) {
+		unlock_page(page[1]);
+		put_page(page[1]);
+		unlock_page(page[0]);
+		put_page(page[0]);
+		return -EBUSY;
+	}
 	if (inode1 > inode2)
 		swap(page[0], page[1]);
 
@@ -49,6 +49,7 @@ struct wb_writeback_work {
 	unsigned int for_background:1;
 	unsigned int for_sync:1;	/* sync(2) WB_SYNC_ALL writeback */
 	unsigned int auto_free:1;	/* free on completion */
+	unsigned int flusher:1;		/* run by an extra flusher */
 	enum wb_reason reason;		/* why was writeback initiated? */
 
 	struct list_head list;		/* pending work list */
@@ -1994,6 +1995,8 @@ static long writeback_inodes_wb(struct bdi_writeback *wb, long nr_pages,
 	return nr_pages - work.nr_pages;
 }
 
+static void wb_kick_flushers(struct bdi_writeback *wb);
+
 /*
  * Explicit flushing or periodic writeback of "old" data.
  *
@@ -2044,6 +2047,9 @@ static long wb_writeback(struct bdi_writeback *wb,
 		if (work->for_background && !wb_over_bg_thresh(wb))
 			break;
 
+		if (work->for_background && !work->flusher)
+			wb_kick_flushers(wb);
+
 		/*
 		 * Kupdate and background works are special and we want to
 		 * include all inodes that need writing. Livelock avoidance is
@@ -2134,6 +2140,60 @@ static long wb_check_background_flush(struct bdi_writeback *wb)
 	return 0;
 }
 
+/*
+ * Background writeback of a wb is normally done by its wb_workfn() alone,
+ * which can't keep a fast device busy. bdi->max_flushers lets that many
+ * workers write back the wb at once. Each extra worker writes back about
+ * half a second's worth of the wb's estimated write bandwidth, then gives
+ * its slot back. The slots are shared by all the wbs of the bdi, and
+ * wb_writeback() asks for them again on every pass. That way the cgroup
+ * wbs over their background threshold take turns instead of one of them
+ * keeping all the flushers.
+ */
+static void wb_kick_flushers(struct bdi_writeback *wb)
+{
+	struct backing_dev_info *bdi = wb->bdi;
+	int nr = READ_ONCE(bdi->max_flushers) - 1;
+	int i;
+
+	if (!test_bit(WB_registered, &wb->state))
+		return;
+
+	for (i = 0; i < nr; i++) {
+		if (work_pending(&wb->flushers[i].work))
+			continue;
+		if (atomic_inc_return(&bdi->nr_flushers) > nr) {
+			atomic_dec(&bdi->nr_flushers);
+			return;
+		}
+		if (!queue_work(bdi_wq, &wb->flushers[i].work))
+			atomic_dec(&bdi->nr_flushers);
+	}
+}
+
+void wb_flusher_workfn(struct work_struct *work)
+{
+	struct wb_flusher *flusher = container_of(work, struct wb_flusher,
+						  work);
+	struct bdi_writeback *wb = flusher->wb;
+	struct wb_writeback_work wbw = {
+		.nr_pages	= max(READ_ONCE(wb->avg_write_bandwidth) / 2,
+				      MIN_WRITEBACK_PAGES),
+		.sync_mode	= WB_SYNC_NONE,
+		.for_background	= 1,
+		.range_cyclic	= 1,
+		.flusher	= 1,
+		.reason		= WB_REASON_BACKGROUND,
+	};
+
+	set_worker_desc("flush-%s", bdi_dev_name(wb->bdi));
+
+	/* don't take the emergency worker from wb_workfn() */
+	if (!current_is_workqueue_rescuer())
+		wb_writeback(wb, &wbw);
+	atomic_dec(&wb->bdi->nr_flushers);
+}
+
 static long wb_check_old_data_flush(struct bdi_writeback *wb)
 {
 	unsigned long expired;
@@ -0,0 +1,610 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE: Filesystem in Userspace
+ * io_uring transport for requests and replies
+ *
+ * The server registers request buffers with uring_cmds on /dev/fuse, one
+ * queue per CPU.  A request is queued on the queue of the CPU it is sent
+ * from, copied into the buffer of an entry in the context of the server
+ * and handed over by completing the command of the entry.  The reply comes
+ * back in the same buffer with a COMMIT_AND_FETCH command, which then waits
+ * for the next request.  Neither direction takes fiq->lock.
+ */
+
+#include "fuse_i.h"
+#include "fuse_dev_i.h"
+#include "dev_uring_i.h"
+
+#include <linux/io_uring.h>
+#include <linux/uio.h>
+
+/*
+ * Requests sent over the ring take their IDs from their queue, with the top
+ * bit set so that they never collide with the IDs of fuse_get_unique().
+ */
+#define FUSE_RING_REQ_ID_BIT	(1ULL << 63)
+#define FUSE_RING_QID_SHIFT	48
+#define FUSE_RING_REQCTR_MASK	((1ULL << FUSE_RING_QID_SHIFT) - 1)
+
+static void fuse_uring_send_cb(struct io_uring_cmd *cmd);
+
+static struct fuse_ring_ent *fuse_uring_cmd_ent(struct io_uring_cmd *cmd)
+{
+	return *(struct fuse_ring_ent **)cmd->pdu;
+}
+
+static void fuse_uring_cmd_set_ent(struct io_uring_cmd *cmd,
+				   struct fuse_ring_ent *ent)
+{
+	*(struct fuse_ring_ent **)cmd->pdu = ent;
+}
+
+static bool fuse_uring_ready(struct fuse_conn *fc)
+{
+	struct fuse_ring *ring = smp_load_acquire(&fc->ring);
+
+	return ring && smp_load_acquire(&ring->ready);
+}
+
+static struct fuse_ring_queue *fuse_uring_get_queue(struct fuse_conn *fc,
+						    unsigned int qid)
+{
+	struct fuse_ring *ring = smp_load_acquire(&fc->ring);
+	struct fuse_ring_queue *queue = NULL, *new_queue;
+	struct fuse_ring *new_ring = NULL;
+	unsigned int i;
+
+	if (ring) {
+		queue = smp_load_acquire(&ring->queues[qid]);
+		if (queue)
+			return queue;
+	} else {
+		new_ring = kzalloc(struct_size(new_ring, queues, nr_cpu_ids),
+				   GFP_KERNEL_ACCOUNT);
+		if (!new_ring)
+			return NULL;
+	}
+
+	new_queue = kzalloc(sizeof(*new_queue), GFP_KERNEL_ACCOUNT);
+	if (!new_queue)
+		goto out_free;
+	new_queue->processing = kcalloc(FUSE_PQ_HASH_SIZE,
+					sizeof(struct list_head),
+					GFP_KERNEL_ACCOUNT);
+	if (!new_queue->processing)
+		goto out_free;
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&new_queue->processing[i]);
+	spin_lock_init(&new_queue->lock);
+	INIT_LIST_HEAD(&new_queue->ent_avail);
+	INIT_LIST_HEAD(&new_queue->req_pending);
+	new_queue->fc = fc;
+	new_queue->qid = qid;
+
+	spin_lock(&fc->lock);
+	if (!fc->ring) {
+		smp_store_release(&fc->ring, new_ring);
+		new_ring = NULL;
+	}
+	ring = fc->ring;
+	queue = ring->queues[qid];
+	if (!queue) {
+		queue = new_queue;
+		new_queue = NULL;
+		/* fuse_abort_conn() stops the queues under fc->lock */
+		queue->stopped = !fc->connected;
+		smp_store_release(&ring->queues[qid], queue);
+		if (++ring->nr_queues == num_possible_cpus())
+			smp_store_release(&ring->ready, true);
+	}
+	spin_unlock(&fc->lock);
+
+out_free:
+	if (new_queue)
+		kfree(new_queue->processing);
+	kfree(new_queue);
+	kfree(new_ring);
+	return queue;
+}
+
+/* Look up an entry on the processing chains by request ID */
+static struct fuse_ring_ent *fuse_uring_find_ent(struct fuse_ring_queue *queue,
+						 u64 unique)
+{
+	unsigned int hash = fuse_req_hash(unique);
+	struct fuse_ring_ent *ent;
+
+	lockdep_assert_held(&queue->lock);
+
+	list_for_each_entry(ent, &queue->processing[hash], list) {
+		if (ent->req->in.h.unique == unique)
+			return ent;
+	}
+	return NULL;
+}
+
+static void fuse_uring_assign(struct fuse_ring_ent *ent, struct fuse_req *req)
+{
+	lockdep_assert_held(&ent->queue->lock);
+
+	clear_bit(FR_PENDING, &req->flags);
+	ent->req = req;
+	ent->state = FRRS_SENDING;
+}
+
+static void fuse_uring_release_cb(struct io_uring_cmd *cmd)
+{
+	struct fuse_ring_ent *ent = fuse_uring_cmd_ent(cmd);
+
+	io_uring_cmd_done(cmd, -ENOTCONN, 0);
+	kfree(ent);
+}
+
+/* Make @ent wait for the next request on @cmd */
+static void fuse_uring_fetch(struct fuse_ring_ent *ent,
+			     struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+	struct fuse_ring_queue *queue = ent->queue;
+	struct fuse_req *req;
+
+	/*
+	 * Marking the command cancelable may drop the ring lock, and a cancel
+	 * then only takes entries in FRRS_AVAIL: a new entry is in FRRS_INIT
+	 * and one coming from a commit in FRRS_COMMITTING.
+	 */
+	WARN_ON_ONCE(ent->state == FRRS_AVAIL);
+	fuse_uring_cmd_set_ent(cmd, ent);
+	io_uring_cmd_mark_cancelable(cmd, issue_flags);
+
+	spin_lock(&queue->lock);
+	ent->cmd = cmd;
+	if (unlikely(queue->stopped)) {
+		ent->state = FRRS_RELEASED;
+		spin_unlock(&queue->lock);
+		io_uring_cmd_complete_in_task(cmd, fuse_uring_release_cb);
+		return;
+	}
+
+	req = list_first_entry_or_null(&queue->req_pending, struct fuse_req,
+				       list);
+	if (req) {
+		list_del_init(&req->list);
+		fuse_uring_assign(ent, req);
+	} else {
+		ent->state = FRRS_AVAIL;
+		list_add(&ent->list, &queue->ent_avail);
+	}
+	spin_unlock(&queue->lock);
+
+	if (req)
+		io_uring_cmd_complete_in_task(cmd, fuse_uring_send_cb);
+}
+
+static int fuse_uring_copy_to_ring(struct fuse_ring_ent *ent,
+				   struct fuse_req *req)
+{
+	struct fuse_args *args = req->args;
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	struct iovec iov;
+	int err;
+
+	if (ent->buf_len < req->in.h.len)
+		return -E2BIG;
+
+	err = import_single_range(ITER_DEST, ent->buf, ent->buf_len, &iov,
+				  &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 1, &iter);
+	cs.req = req;
+	err = fuse_copy_one(&cs, &req->in.h, sizeof(req->in.h));
+	if (!err)
+		err = fuse_copy_args(&cs, args->in_numargs, args->in_pages,
+				     (struct fuse_arg *) args->in_args, 0);
+	fuse_copy_finish(&cs);
+	clear_bit(FR_LOCKED, &req->flags);
+
+	return err;
+}
+
+/* Runs in the context of the server, to copy into its buffer */
+static void fuse_uring_send_cb(struct io_uring_cmd *cmd)
+{
+	struct fuse_ring_ent *ent = fuse_uring_cmd_ent(cmd);
+	struct fuse_ring_queue *queue = ent->queue;
+	struct fuse_req *req = ent->req;
+	int err;
+
+	err = fuse_uring_copy_to_ring(ent, req);
+
+	spin_lock(&queue->lock);
+	if (!err && queue->stopped)
+		err = -ENOTCONN;
+	if (err) {
+		ent->req = NULL;
+		ent->state = FRRS_RELEASED;
+		spin_unlock(&queue->lock);
+
+		if (err == -ENOTCONN)
+			req->out.h.error = -ECONNABORTED;
+		/* SETXATTR is special, since it may contain too large data */
+		else if (err == -E2BIG && req->args->opcode == FUSE_SETXATTR)
+			req->out.h.error = -E2BIG;
+		else
+			req->out.h.error = -EIO;
+		fuse_request_end(req);
+
+		io_uring_cmd_done(cmd, err, 0);
+		kfree(ent);
+		return;
+	}
+
+	ent->cmd = NULL;
+	ent->state = FRRS_USERSPACE;
+	list_add(&ent->list,
+		 &queue->processing[fuse_req_hash(req->in.h.unique)]);
+	set_bit(FR_SENT, &req->flags);
+	/* matches barrier in request_wait_answer() */
+	smp_mb__after_atomic();
+	/* Under the lock, fuse_uring_abort() may end the request otherwise */
+	if (test_bit(FR_INTERRUPTED, &req->flags))
+		fuse_dev_queue_interrupt(req);
+	spin_unlock(&queue->lock);
+
+	io_uring_cmd_done(cmd, 0, 0);
+}
+
+static int fuse_uring_copy_from_ring(struct fuse_ring_ent *ent,
+				     struct fuse_req *req)
+{
+	struct fuse_copy_state cs;
+	struct fuse_out_header oh;
+	struct iov_iter iter;
+	struct iovec iov;
+	int err;
+
+	err = import_single_range(ITER_SOURCE, ent->buf, ent->buf_len, &iov,
+				  &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 0, &iter);
+	err = fuse_copy_one(&cs, &oh, sizeof(oh));
+	if (err)
+		goto out;
+
+	err = -EINVAL;
+	if (oh.unique != req->in.h.unique || oh.len < sizeof(oh) ||
+	    oh.len > ent->buf_len || oh.error <= -512 || oh.error > 0)
+		goto out;
+
+	req->out.h = oh;
+	cs.req = req;
+	if (oh.error)
+		err = oh.len != sizeof(oh) ? -EINVAL : 0;
+	else
+		err = fuse_copy_out_args(&cs, req->args, oh.len);
+out:
+	fuse_copy_finish(&cs);
+	clear_bit(FR_LOCKED, &req->flags);
+
+	return err;
+}
+
+static int fuse_uring_commit_fetch(struct io_uring_cmd *cmd,
+				   unsigned int issue_flags,
+				   struct fuse_conn *fc, unsigned int qid)
+{
+	const struct fuse_uring_cmd_req *cmd_req = cmd->cmd;
+	u64 commit_id = READ_ONCE(cmd_req->commit_id);
+	struct fuse_ring *ring = smp_load_acquire(&fc->ring);
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+	struct fuse_req *req;
+
+	if (!ring)
+		return -EINVAL;
+	queue = smp_load_acquire(&ring->queues[qid]);
+	if (!queue)
+		return -EINVAL;
+
+	spin_lock(&queue->lock);
+	if (queue->stopped) {
+		spin_unlock(&queue->lock);
+		return -ENOTCONN;
+	}
+	ent = fuse_uring_find_ent(queue, commit_id);
+	if (!ent) {
+		spin_unlock(&queue->lock);
+		return -ENOENT;
+	}
+	list_del_init(&ent->list);
+	ent->state = FRRS_COMMITTING;
+	req = ent->req;
+	ent->req = NULL;
+	clear_bit(FR_SENT, &req->flags);
+	spin_unlock(&queue->lock);
+
+	if (fuse_uring_copy_from_ring(ent, req))
+		req->out.h.error = -EIO;
+	fuse_request_end(req);
+
+	fuse_uring_fetch(ent, cmd, issue_flags);
+	return -EIOCBQUEUED;
+}
+
+static int fuse_uring_register(struct io_uring_cmd *cmd,
+			       unsigned int issue_flags,
+			       struct fuse_conn *fc, unsigned int qid)
+{
+	const struct fuse_uring_cmd_req *cmd_req = cmd->cmd;
+	void __user *buf = u64_to_user_ptr(READ_ONCE(cmd_req->buf_addr));
+	size_t buf_len = READ_ONCE(cmd_req->buf_len);
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+
+	/* Same minimum as for read() buffers, see fuse_dev_do_read() */
+	if (buf_len < max_t(size_t, FUSE_MIN_READ_BUFFER,
+			    sizeof(struct fuse_in_header) +
+			    sizeof(struct fuse_write_in) +
+			    fc->max_write))
+		return -EINVAL;
+	if (!access_ok(buf, buf_len))
+		return -EFAULT;
+
+	queue = fuse_uring_get_queue(fc, qid);
+	if (!queue)
+		return -ENOMEM;
+
+	ent = kzalloc(sizeof(*ent), GFP_KERNEL_ACCOUNT);
+	if (!ent)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&ent->list);
+	ent->state = FRRS_INIT;
+	ent->queue = queue;
+	ent->buf = buf;
+	ent->buf_len = buf_len;
+
+	fuse_uring_fetch(ent, cmd, issue_flags);
+	return -EIOCBQUEUED;
+}
+
+/*
+ * Stop @queue: requests waiting for an entry and requests that are with the
+ * server are moved to @to_end, entries waiting for a request are released.
+ * Entries in between notice the stop themselves.
+ */
+static void fuse_uring_stop_queue(struct fuse_ring_queue *queue,
+				  struct list_head *to_end)
+{
+	struct fuse_ring_ent *ent, *next;
+	LIST_HEAD(to_release);
+	struct fuse_req *req;
+	unsigned int i;
+
+	spin_lock(&queue->lock);
+	queue->stopped = true;
+	list_for_each_entry(req, &queue->req_pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&queue->req_pending, to_end);
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++) {
+		list_for_each_entry_safe(ent, next, &queue->processing[i],
+					 list) {
+			list_add_tail(&ent->req->list, to_end);
+			list_del(&ent->list);
+			kfree(ent);
+		}
+	}
+	list_for_each_entry(ent, &queue->ent_avail, list)
+		ent->state = FRRS_RELEASED;
+	list_splice_init(&queue->ent_avail, &to_release);
+	spin_unlock(&queue->lock);
+
+	list_for_each_entry_safe(ent, next, &to_release, list) {
+		list_del_init(&ent->list);
+		io_uring_cmd_complete_in_task(ent->cmd, fuse_uring_release_cb);
+	}
+}
+
+/*
+ * Called by io_uring when the ring or the task that issued @cmd goes away.
+ * The server can no longer fetch requests nor commit replies through this
+ * ring, so stop the queue and send new requests through /dev/fuse again;
+ * otherwise requests would keep being handed to entries that are being torn
+ * down and io_uring would never see the last command complete.
+ */
+static void fuse_uring_cancel(struct io_uring_cmd *cmd)
+{
+	struct fuse_ring_ent *ent = fuse_uring_cmd_ent(cmd);
+	struct fuse_ring_queue *queue = ent->queue;
+	struct fuse_conn *fc = queue->fc;
+	LIST_HEAD(to_end);
+
+	spin_lock(&fc->lock);
+	WRITE_ONCE(fc->ring->ready, false);
+	spin_unlock(&fc->lock);
+
+	/* Entries in states other than FRRS_AVAIL complete on their own */
+	fuse_uring_stop_queue(queue, &to_end);
+	fuse_dev_end_requests(&to_end);
+}
+
+int fuse_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+	const struct fuse_uring_cmd_req *cmd_req = cmd->cmd;
+	struct fuse_dev *fud;
+	struct fuse_conn *fc;
+	unsigned int qid;
+
+	if (unlikely(issue_flags & IO_URING_F_CANCEL)) {
+		fuse_uring_cancel(cmd);
+		return 0;
+	}
+
+	if (!(issue_flags & IO_URING_F_SQE128))
+		return -EINVAL;
+	/* Completions come from the kernel side, nothing to poll for */
+	if (issue_flags & IO_URING_F_IOPOLL)
+		return -EOPNOTSUPP;
+
+	fud = fuse_get_dev(cmd->file);
+	if (!fud)
+		return -EPERM;
+	fc = fud->fc;
+
+	/* The buffer size depends on max_write, only known after INIT */
+	if (!fc->initialized)
+		return -EAGAIN;
+	/* Matches smp_wmb() in fuse_set_initialized() */
+	smp_rmb();
+	if (!READ_ONCE(fc->connected))
+		return -ENOTCONN;
+
+	if (READ_ONCE(cmd_req->flags) || READ_ONCE(cmd_req->padding))
+		return -EINVAL;
+	qid = READ_ONCE(cmd_req->qid);
+	if (qid >= nr_cpu_ids || !cpu_possible(qid))
+		return -EINVAL;
+
+	switch (cmd->cmd_op) {
+	case FUSE_IO_URING_CMD_REGISTER:
+		return fuse_uring_register(cmd, issue_flags, fc, qid);
+	case FUSE_IO_URING_CMD_COMMIT_AND_FETCH:
+		return fuse_uring_commit_fetch(cmd, issue_flags, fc, qid);
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Queue a request on the queue of the current CPU.  Returns false if it has
+ * to go through /dev/fuse instead, because the server did not set up the
+ * ring, or the connection is being aborted.
+ */
+bool fuse_uring_queue_req(struct fuse_req *req)
+{
+	struct fuse_conn *fc = req->fm->fc;
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+
+	/* Requests taking no reply go through /dev/fuse, like forgets */
+	if (!test_bit(FR_ISREPLY, &req->flags) || !fuse_uring_ready(fc))
+		return false;
+
+	queue = fc->ring->queues[raw_smp_processor_id()];
+	req->in.h.len = sizeof(struct fuse_in_header) +
+		fuse_len_args(req->args->in_numargs,
+			      (struct fuse_arg *) req->args->in_args);
+
+	spin_lock(&queue->lock);
+	if (unlikely(queue->stopped)) {
+		spin_unlock(&queue->lock);
+		return false;
+	}
+	queue->reqctr += FUSE_REQ_ID_STEP;
+	req->in.h.unique = FUSE_RING_REQ_ID_BIT |
+			   ((u64)queue->qid << FUSE_RING_QID_SHIFT) |
+			   (queue->reqctr & FUSE_RING_REQCTR_MASK);
+	req->ring_queue = queue;
+
+	ent = list_first_entry_or_null(&queue->ent_avail, struct fuse_ring_ent,
+				       list);
+	if (ent) {
+		list_del_init(&ent->list);
+		fuse_uring_assign(ent, req);
+	} else {
+		list_add_tail(&req->list, &queue->req_pending);
+	}
+	spin_unlock(&queue->lock);
+
+	if (ent)
+		io_uring_cmd_complete_in_task(ent->cmd, fuse_uring_send_cb);
+	return true;
+}
+
+bool fuse_uring_remove_pending_req(struct fuse_req *req)
+{
+	struct fuse_ring_queue *queue = req->ring_queue;
+	bool removed = false;
+
+	spin_lock(&queue->lock);
+	if (test_bit(FR_PENDING, &req->flags)) {
+		list_del(&req->list);
+		removed = true;
+	}
+	spin_unlock(&queue->lock);
+
+	return removed;
+}
+
+/* Find a request that is with the server, for an interrupt reply */
+struct fuse_req *fuse_uring_find_req(struct fuse_conn *fc, u64 unique)
+{
+	struct fuse_ring *ring = smp_load_acquire(&fc->ring);
+	u64 qid = (unique & ~FUSE_RING_REQ_ID_BIT) >> FUSE_RING_QID_SHIFT;
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+	struct fuse_req *req = NULL;
+
+	if (!ring || !(unique & FUSE_RING_REQ_ID_BIT) || qid >= nr_cpu_ids)
+		return NULL;
+	queue = smp_load_acquire(&ring->queues[qid]);
+	if (!queue)
+		return NULL;
+
+	spin_lock(&queue->lock);
+	ent = fuse_uring_find_ent(queue, unique);
+	if (ent) {
+		req = ent->req;
+		refcount_inc(&req->count);
+	}
+	spin_unlock(&queue->lock);
+
+	return req;
+}
+
+/* Stop the queues, called by fuse_abort_conn() under fc->lock */
+void fuse_uring_abort(struct fuse_conn *fc, struct list_head *to_end)
+{
+	struct fuse_ring *ring = fc->ring;
+	unsigned int qid;
+
+	lockdep_assert_held(&fc->lock);
+
+	if (!ring)
+		return;
+
+	WRITE_ONCE(ring->ready, false);
+	for (qid = 0; qid < nr_cpu_ids; qid++) {
+		struct fuse_ring_queue *queue = ring->queues[qid];
+
+		if (queue)
+			fuse_uring_stop_queue(queue, to_end);
+	}
+}
+
+void fuse_uring_destroy(struct fuse_conn *fc)
+{
+	struct fuse_ring *ring = fc->ring;
+	unsigned int qid;
+
+	if (!ring)
+		return;
+
+	for (qid = 0; qid < nr_cpu_ids; qid++) {
+		struct fuse_ring_queue *queue = ring->queues[qid];
+
+		if (!queue)
+			continue;
+
+		/* fuse_uring_abort() has emptied the queue */
+		WARN_ON(!list_empty(&queue->ent_avail));
+		WARN_ON(!list_empty(&queue->req_pending));
+		kfree(queue->processing);
+		kfree(queue);
+	}
+	kfree(ring);
+	fc->ring = NULL;
+}
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * FUSE: Filesystem in Userspace
+ * io_uring transport for requests and replies
+ */
+#ifndef _FS_FUSE_DEV_URING_I_H
+#define _FS_FUSE_DEV_URING_I_H
+
+#include "fuse_i.h"
+
+struct io_uring_cmd;
+
+#ifdef CONFIG_FUSE_IO_URING
+
+enum fuse_ring_ent_state {
+	/* just registered, not yet on any list */
+	FRRS_INIT,
+	/* waiting on queue->ent_avail for a request */
+	FRRS_AVAIL,
+	/* request assigned, being copied into the buffer */
+	FRRS_SENDING,
+	/* request is with the server, entry on a queue->processing chain */
+	FRRS_USERSPACE,
+	/* reply being copied from the buffer */
+	FRRS_COMMITTING,
+	/* command being completed with an error, entry about to be freed */
+	FRRS_RELEASED,
+};
+
+/* A request buffer registered by the server */
+struct fuse_ring_ent {
+	struct fuse_ring_queue *queue;
+
+	/* Entry on queue->ent_avail or on a queue->processing chain */
+	struct list_head list;
+
+	enum fuse_ring_ent_state state;
+
+	/* The command the entry waits on, unless in FRRS_USERSPACE */
+	struct io_uring_cmd *cmd;
+
+	/* The request in the buffer, from FRRS_SENDING to FRRS_COMMITTING */
+	struct fuse_req *req;
+
+	void __user *buf;
+	size_t buf_len;
+};
+
+/* Per CPU queue of requests and of the entries serving them */
+struct fuse_ring_queue {
+	struct fuse_conn *fc;
+	unsigned int qid;
+
+	/* Protects all members below */
+	spinlock_t lock;
+
+	/*
+	 * Set when the connection is aborted or the ring goes away, no more
+	 * requests or entries
+	 */
+	bool stopped;
+
+	/* The next unique request ID */
+	u64 reqctr;
+
+	/* Entries waiting for a request */
+	struct list_head ent_avail;
+
+	/* Requests waiting for an entry */
+	struct list_head req_pending;
+
+	/* Entries whose request is with the server, hashed by request ID */
+	struct list_head *processing;
+};
+
+struct fuse_ring {
+	/* Number of queues set up, under fc->lock */
+	unsigned int nr_queues;
+
+	/* Set once every possible CPU has a queue */
+	bool ready;
+
+	/* Indexed by CPU, published under fc->lock */
+	struct fuse_ring_queue *queues[];
+};
+
+int fuse_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags);
+bool fuse_uring_queue_req(struct fuse_req *req);
+bool fuse_uring_remove_pending_req(struct fuse_req *req);
+struct fuse_req *fuse_uring_find_req(struct fuse_conn *fc, u64 unique);
+void fuse_uring_abort(struct fuse_conn *fc, struct list_head *to_end);
+void fuse_uring_destroy(struct fuse_conn *fc);
+
+static inline bool fuse_uring_req_queued(struct fuse_req *req)
+{
+	return req->ring_queue != NULL;
+}
+
+#else /* CONFIG_FUSE_IO_URING */
+
+static inline bool fuse_uring_queue_req(struct fuse_req *req)
+{
+	return false;
+}
+
+static inline bool fuse_uring_remove_pending_req(struct fuse_req *req)
+{
+	return false;
+}
+
+static inline struct fuse_req *fuse_uring_find_req(struct fuse_conn *fc,
+						   u64 unique)
+{
+	return NULL;
+}
+
+static inline void fuse_uring_abort(struct fuse_conn *fc,
+				    struct list_head *to_end)
+{
+}
+
+static inline void fuse_uring_destroy(struct fuse_conn *fc)
+{
+}
+
+static inline bool fuse_uring_req_queued(struct fuse_req *req)
+{
+	return false;
+}
+
+#endif /* CONFIG_FUSE_IO_URING */
+
+#endif /* _FS_FUSE_DEV_URING_I_H */
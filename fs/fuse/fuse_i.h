@@ -31,6 +31,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
 #include <linux/user_namespace.h>
+#include <linux/idr.h>
 
 /** Default max number of pages that can be used in a single read request */
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
@@ -226,6 +227,14 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing file given by the server with FOPEN_PASSTHROUGH */
+	struct fuse_backing *backing;
+
+	/** Backing file opened for this file, I/O is passed through to it */
+	struct file *passthrough;
+#endif
 };
 
 /** One input argument of a request */
@@ -372,6 +381,11 @@ struct fuse_req {
 	void *argbuf;
 #endif
 
+#ifdef CONFIG_FUSE_IO_URING
+	/** io_uring queue the request was sent on, if any */
+	struct fuse_ring_queue *ring_queue;
+#endif
+
 	/** fuse_mount this request belongs to */
 	struct fuse_mount *fm;
 };
@@ -787,6 +801,9 @@ struct fuse_conn {
 	/* Is tmpfile not implemented by fs? */
 	unsigned int no_tmpfile:1;
 
+	/* Can files be opened in passthrough mode? */
+	unsigned int passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -836,6 +853,16 @@ struct fuse_conn {
 
 	/* New writepages go into this bucket */
 	struct fuse_sync_bucket __rcu *curr_bucket;
+
+#ifdef CONFIG_FUSE_IO_URING
+	/** io_uring transport, set up on the first ring registration */
+	struct fuse_ring *ring;
+#endif
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing files registered by the server, indexed by backing ID */
+	struct idr backing_files_map;
+#endif
 };
 
 /*
@@ -1319,4 +1346,45 @@ struct fuse_file *fuse_file_open(struct fuse_mount *fm, u64 nodeid,
 void fuse_file_release(struct inode *inode, struct fuse_file *ff,
 		       unsigned int open_flags, fl_owner_t id, bool isdir);
 
+/* passthrough.c */
+
+static inline struct file *fuse_file_passthrough(struct fuse_file *ff)
+{
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	return ff->passthrough;
+#else
+	return NULL;
+#endif
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+void fuse_backing_files_init(struct fuse_conn *fc);
+void fuse_backing_files_free(struct fuse_conn *fc);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    int backing_id);
+int fuse_passthrough_open(struct fuse_file *ff, struct file *file);
+void fuse_passthrough_release(struct fuse_file *ff);
+#else
+static inline void fuse_backing_files_init(struct fuse_conn *fc) {}
+static inline void fuse_backing_files_free(struct fuse_conn *fc) {}
+static inline void fuse_passthrough_setup(struct fuse_conn *fc,
+					  struct fuse_file *ff, int backing_id)
+{
+	/* Not supported, so FOPEN_PASSTHROUGH is never granted */
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+}
+static inline int fuse_passthrough_open(struct fuse_file *ff,
+					struct file *file)
+{
+	return 0;
+}
+static inline void fuse_passthrough_release(struct fuse_file *ff) {}
+#endif
+
 #endif /* _FS_FUSE_I_H */
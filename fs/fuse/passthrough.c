@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE passthrough to backing files
+ *
+ * The server registers a backing file with the FUSE_DEV_IOC_BACKING_OPEN
+ * ioctl and replies to OPEN or CREATE with FOPEN_PASSTHROUGH and the ID of
+ * the backing file.  Reads, writes and mmap of such a file then go to the
+ * backing file directly, with the credentials of the server, in the same
+ * way overlayfs does for its real files.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/uio.h>
+
+struct fuse_backing {
+	struct file *file;
+	const struct cred *cred;
+	refcount_t count;
+	struct rcu_head rcu;
+};
+
+static struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
+{
+	if (fb && refcount_inc_not_zero(&fb->count))
+		return fb;
+	return NULL;
+}
+
+static void fuse_backing_free(struct fuse_backing *fb)
+{
+	fput(fb->file);
+	put_cred(fb->cred);
+	kfree_rcu(fb, rcu);
+}
+
+static void fuse_backing_put(struct fuse_backing *fb)
+{
+	if (fb && refcount_dec_and_test(&fb->count))
+		fuse_backing_free(fb);
+}
+
+void fuse_backing_files_init(struct fuse_conn *fc)
+{
+	idr_init(&fc->backing_files_map);
+}
+
+static int fuse_backing_id_free(int id, void *p, void *data)
+{
+	fuse_backing_put(p);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->backing_files_map, fuse_backing_id_free, NULL);
+	idr_destroy(&fc->backing_files_map);
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct fuse_backing *fb;
+	struct file *file;
+	int res;
+
+	res = -EPERM;
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		goto out;
+
+	res = -EINVAL;
+	if (map->flags || map->padding)
+		goto out;
+
+	res = -EBADF;
+	file = fget(map->fd);
+	if (!file)
+		goto out;
+
+	res = -EOPNOTSUPP;
+	if (!file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	/* Only one level of stacking, see process_init_reply() */
+	res = -ELOOP;
+	if (file_inode(file)->i_sb->s_stack_depth)
+		goto out_fput;
+
+	res = -ENOMEM;
+	fb = kmalloc(sizeof(*fb), GFP_KERNEL);
+	if (!fb)
+		goto out_fput;
+
+	fb->file = file;
+	fb->cred = prepare_creds();
+	refcount_set(&fb->count, 1);
+	if (!fb->cred) {
+		kfree(fb);
+		goto out_fput;
+	}
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, fb, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+
+	if (res < 0)
+		fuse_backing_free(fb);
+out:
+	return res;
+
+out_fput:
+	fput(file);
+	goto out;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	fb = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!fb)
+		return -ENOENT;
+
+	/* Files opened with it keep their own reference */
+	fuse_backing_put(fb);
+	return 0;
+}
+
+/* Called with the reply to OPEN or CREATE */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    int backing_id)
+{
+	if (!(ff->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	if (!fc->passthrough) {
+		ff->open_flags &= ~FOPEN_PASSTHROUGH;
+		return;
+	}
+
+	rcu_read_lock();
+	ff->backing = fuse_backing_get(idr_find(&fc->backing_files_map,
+						backing_id));
+	rcu_read_unlock();
+}
+
+/*
+ * Open the backing file for @file, with the flags of @file, so that O_DIRECT,
+ * O_APPEND and friends behave as the caller asked for.
+ */
+int fuse_passthrough_open(struct fuse_file *ff, struct file *file)
+{
+	struct file *backing_file;
+
+	if (!(ff->open_flags & FOPEN_PASSTHROUGH))
+		return 0;
+
+	if (!ff->backing)
+		return -EBADF;
+
+	backing_file = dentry_open(&ff->backing->file->f_path,
+				   file->f_flags & ~(O_CREAT | O_EXCL |
+						     O_NOCTTY | O_TRUNC),
+				   ff->backing->cred);
+	if (IS_ERR(backing_file))
+		return PTR_ERR(backing_file);
+
+	ff->passthrough = backing_file;
+	return 0;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough) {
+		fput(ff->passthrough);
+		ff->passthrough = NULL;
+	}
+	fuse_backing_put(ff->backing);
+	ff->backing = NULL;
+}
+
+static rwf_t fuse_passthrough_iocb_to_rwf(int ifl)
+{
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+
+	return flags;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	old_cred = override_creds(ff->backing->cred);
+	ret = vfs_iter_read(backing_file, iter, &iocb->ki_pos,
+			    fuse_passthrough_iocb_to_rwf(iocb->ki_flags));
+	revert_creds(old_cred);
+
+	fuse_invalidate_atime(file_inode(file));
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	inode_lock(inode);
+	old_cred = override_creds(ff->backing->cred);
+	file_start_write(backing_file);
+	ret = vfs_iter_write(backing_file, iter, &iocb->ki_pos,
+			     fuse_passthrough_iocb_to_rwf(iocb->ki_flags));
+	file_end_write(backing_file);
+	revert_creds(old_cred);
+
+	if (ret > 0)
+		fuse_write_update_attr(inode, iocb->ki_pos, ret);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!backing_file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma_set_file(vma, backing_file);
+
+	old_cred = override_creds(ff->backing->cred);
+	ret = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+
+	fuse_invalidate_atime(file_inode(file));
+	return ret;
+}
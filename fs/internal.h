@@ -61,6 +61,7 @@ extern int filename_lookup(int dfd, struct filename *name, unsigned flags,
 			   struct path *path, struct path *root);
 extern int vfs_path_lookup(struct dentry *, struct vfsmount *,
 			   const char *, unsigned int, struct path *);
+void walk_prefix_cache_free(struct mount *mnt);
 int do_rmdir(int dfd, struct filename *name);
 int do_unlinkat(int dfd, struct filename *name);
 int may_linkat(struct user_namespace *mnt_userns, const struct path *link);
@@ -165,6 +166,7 @@ extern int invalidate_inodes(struct super_block *, bool);
  */
 extern int d_set_mounted(struct dentry *dentry);
 extern long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc);
+extern long prune_dcache_sb_negative(struct super_block *sb);
 extern struct dentry *d_alloc_cursor(struct dentry *);
 extern struct dentry * d_alloc_pseudo(struct super_block *, const struct qstr *);
 extern char *simple_dname(struct dentry *, char *, int);
@@ -197,6 +199,14 @@ int sb_init_dio_done_wq(struct super_block *sb);
 int getname_statx_lookup_flags(int flags);
 int do_statx(int dfd, struct filename *filename, unsigned int flags,
 	     unsigned int mask, struct statx __user *buffer);
+int cp_statx(const struct kstat *stat, struct statx __user *buffer);
+
+/*
+ * fs/readdir.c:
+ */
+int vfs_getdents_statx(struct file *file, struct dirent_statx __user *dirent,
+		       unsigned int count, unsigned int flags,
+		       unsigned int mask);
 
 /*
  * fs/splice.c:
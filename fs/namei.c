@@ -583,6 +583,8 @@ struct nameidata {
 	int		dfd;
 	vfsuid_t	dir_vfsuid;
 	umode_t		dir_mode;
+	unsigned int	prefix_hit;	/* bytes taken from the prefix cache */
+	struct dentry	*prefix_put;	/* to dput() once out of RCU mode */
 } __randomize_layout;
 
 #define ND_ROOT_PRESET 1
@@ -598,6 +600,7 @@ static void __set_nameidata(struct nameidata *p, int dfd, struct filename *name)
 	p->name = name;
 	p->path.mnt = NULL;
 	p->path.dentry = NULL;
+	p->prefix_put = NULL;
 	p->total_link_count = old ? old->total_link_count : 0;
 	p->saved = old;
 	current->nameidata = p;
@@ -690,6 +693,10 @@ static void terminate_walk(struct nameidata *nd)
 	nd->depth = 0;
 	nd->path.mnt = NULL;
 	nd->path.dentry = NULL;
+	if (nd->prefix_put) {
+		dput(nd->prefix_put);
+		nd->prefix_put = NULL;
+	}
 }
 
 /* path_put is needed afterwards regardless of success or failure */
@@ -2227,6 +2234,296 @@ static inline u64 hash_name(const void *salt, const char *name)
 
 #endif
 
+/*
+ * Per-mount cache of resolved path prefixes.
+ *
+ * Opens under the same deep directories resolve the same leading components
+ * over and over. Once a walk got to the directory holding its last
+ * component, that directory is remembered, pinned, together with the string
+ * that led to it. A later RCU walk starting with the same string takes the
+ * directory from the cache instead of looking up the components one by one.
+ *
+ * Nothing in the cache is trusted. A hit goes up the parents of the cached
+ * dentry, checking under each d_seq that the names are the components of
+ * the string, that the dentries are hashed directories without mounts or
+ * ->d_revalidate(), and that the walker may search the parents. It must end
+ * up at the starting point of the walk. That drops the name hashing and the
+ * hash chain walks from every component but the last.
+ *
+ * The cached dentries are pinned, so the cache goes with the mount in
+ * cleanup_mnt(), before the superblock is shut down.
+ */
+#define WALK_PREFIX_SLOTS	8
+#define WALK_PREFIX_MAX		128
+#define WALK_PREFIX_MIN_DEPTH	3
+#define WALK_PREFIX_DEAD	((struct walk_prefix_cache *)ERR_PTR(-ENOENT))
+
+struct walk_prefix {
+	struct dentry	*dentry;
+	unsigned int	candidate;	/* hash of the last prefix that missed */
+	unsigned short	len;
+	unsigned short	depth;
+	char		name[WALK_PREFIX_MAX];
+};
+
+struct walk_prefix_cache {
+	spinlock_t		lock;
+	seqcount_spinlock_t	seq;
+	bool			dead;
+	struct rcu_head		rcu;
+	struct walk_prefix	slot[WALK_PREFIX_SLOTS];
+};
+
+/* end of the component of @name before @end, skipping slashes */
+static const char *walk_prefix_prev(const char *name, const char *end)
+{
+	while (end > name && end[-1] == '/')
+		end--;
+	return end;
+}
+
+/*
+ * Does the cached @dentry still sit at @name[0..@len) below @start? Called
+ * in RCU mode, returns the d_seq of @dentry in @seqp if it does.
+ */
+static bool walk_prefix_valid(struct user_namespace *mnt_userns,
+			      struct dentry *start, struct dentry *dentry,
+			      const char *name, unsigned int len,
+			      unsigned int depth, unsigned *seqp)
+{
+	const char *end = name + len;
+	unsigned int i;
+
+	for (i = 0; i < depth; i++) {
+		const unsigned char *dname;
+		const char *comp = end;
+		struct dentry *parent;
+		struct inode *dir;
+		unsigned seq;
+
+		while (comp > name && comp[-1] != '/')
+			comp--;
+
+		seq = raw_seqcount_begin(&dentry->d_seq);
+		if (dentry->d_flags & (DCACHE_OP_REVALIDATE |
+				       DCACHE_MANAGED_DENTRY))
+			return false;
+		if (!d_can_lookup(dentry) || d_unhashed(dentry))
+			return false;
+		dname = READ_ONCE(dentry->d_name.name);
+		if (READ_ONCE(dentry->d_name.len) != end - comp ||
+		    memcmp(dname, comp, end - comp))
+			return false;
+		parent = READ_ONCE(dentry->d_parent);
+		if (read_seqcount_retry(&dentry->d_seq, seq))
+			return false;
+		if (!i)
+			*seqp = seq;
+
+		if (parent->d_flags & (DCACHE_OP_HASH | DCACHE_OP_COMPARE))
+			return false;
+		dir = READ_ONCE(parent->d_inode);
+		if (!dir || inode_permission(mnt_userns, dir,
+					     MAY_EXEC | MAY_NOT_BLOCK))
+			return false;
+
+		dentry = parent;
+		end = walk_prefix_prev(name, comp);
+	}
+	return dentry == start && end == name;
+}
+
+/*
+ * Look for the longest cached prefix of @name below nd->path and move the
+ * walk to it. Returns the number of bytes of @name it covered.
+ */
+static unsigned int walk_prefix_lookup(struct nameidata *nd, const char *name)
+{
+	struct walk_prefix_cache *c;
+	struct user_namespace *mnt_userns = mnt_user_ns(nd->path.mnt);
+	struct dentry *found = NULL;
+	unsigned int i, best = 0;
+	unsigned found_seq = 0;
+
+	c = READ_ONCE(real_mount(nd->path.mnt)->mnt_prefix_cache);
+	if (IS_ERR_OR_NULL(c))
+		return 0;
+
+	for (i = 0; i < WALK_PREFIX_SLOTS; i++) {
+		struct walk_prefix *p = &c->slot[i];
+		unsigned int len, depth, rest;
+		struct dentry *dentry;
+		unsigned seq, dseq;
+
+		seq = raw_seqcount_begin(&c->seq);
+		dentry = READ_ONCE(p->dentry);
+		len = READ_ONCE(p->len);
+		depth = READ_ONCE(p->depth);
+		if (!dentry || len <= best || len > WALK_PREFIX_MAX ||
+		    strncmp(name, p->name, len))
+			continue;
+		if (read_seqcount_retry(&c->seq, seq))
+			continue;
+
+		/* there must be a component left after the prefix */
+		if (name[len] != '/')
+			continue;
+		for (rest = len; name[rest] == '/'; rest++)
+			;
+		if (!name[rest])
+			continue;
+
+		if (!walk_prefix_valid(mnt_userns, nd->path.dentry, dentry,
+				       name, len, depth, &dseq))
+			continue;
+		found = dentry;
+		found_seq = dseq;
+		best = len;
+	}
+
+	if (found) {
+		/*
+		 * The inode must belong to the same d_seq section as the
+		 * checks above; a negative or changed dentry makes the walk
+		 * start from the beginning instead.
+		 */
+		struct inode *inode = READ_ONCE(found->d_inode);
+
+		if (unlikely(!inode) ||
+		    read_seqcount_retry(&found->d_seq, found_seq))
+			return 0;
+		nd->path.dentry = found;
+		nd->inode = inode;
+		nd->seq = found_seq;
+		nd->state &= ~ND_JUMPED;
+	}
+	return best;
+}
+
+/*
+ * Remember nd->path, the directory holding the last component of @name,
+ * if the walk got there from @mnt with plain names only. Whether the names
+ * led there from the start of the walk is left to walk_prefix_valid().
+ *
+ * A prefix only replaces the entry of its slot when it misses twice in a
+ * row, so that walks of one-off paths don't keep evicting the useful ones.
+ */
+static void walk_prefix_remember(struct nameidata *nd, struct vfsmount *mnt,
+				 int nr_links, const char *name)
+{
+	struct mount *m = real_mount(mnt);
+	struct dentry *dentry = nd->path.dentry;
+	struct walk_prefix_cache *c, *new;
+	struct walk_prefix *p;
+	unsigned int len, hash, depth = 0;
+	const char *s, *end;
+
+	if (nd->path.mnt != mnt || nd->total_link_count != nr_links ||
+	    nd->prefix_put)
+		return;
+	/* walk_prefix_valid() would never accept these */
+	if (dentry->d_flags & (DCACHE_OP_HASH | DCACHE_OP_COMPARE |
+			       DCACHE_OP_REVALIDATE | DCACHE_MANAGED_DENTRY))
+		return;
+	if (d_unhashed(dentry))
+		return;
+
+	end = walk_prefix_prev(name, nd->last.name);
+	len = end - name;
+	if (!len || len > WALK_PREFIX_MAX || len <= nd->prefix_hit)
+		return;
+	for (s = name; s < end; depth++) {
+		const char *comp = s;
+
+		while (s < end && *s != '/')
+			s++;
+		if (comp[0] == '.' &&
+		    (s - comp == 1 || (s - comp == 2 && comp[1] == '.')))
+			return;
+		while (s < end && *s == '/')
+			s++;
+	}
+	if (depth < WALK_PREFIX_MIN_DEPTH)
+		return;
+
+	c = READ_ONCE(m->mnt_prefix_cache);
+	if (c == WALK_PREFIX_DEAD)
+		return;
+	if (!c) {
+		new = kzalloc(sizeof(*new), GFP_NOWAIT | __GFP_NOWARN);
+		if (!new)
+			return;
+		spin_lock_init(&new->lock);
+		seqcount_spinlock_init(&new->seq, &new->lock);
+		c = cmpxchg(&m->mnt_prefix_cache, NULL, new);
+		if (c) {
+			kfree(new);
+			if (c == WALK_PREFIX_DEAD)
+				return;
+		} else {
+			c = new;
+		}
+	}
+
+	hash = full_name_hash(NULL, name, len);
+	p = &c->slot[hash % WALK_PREFIX_SLOTS];
+	/* Already cached, the lookup just could not use it */
+	if (READ_ONCE(p->dentry) == dentry && READ_ONCE(p->len) == len)
+		return;
+	if (READ_ONCE(p->candidate) != hash) {
+		WRITE_ONCE(p->candidate, hash);
+		return;
+	}
+
+	if (nd->flags & LOOKUP_RCU) {
+		if (!lockref_get_not_dead(&dentry->d_lockref))
+			return;
+	} else {
+		dget(dentry);
+	}
+
+	spin_lock(&c->lock);
+	if (c->dead) {
+		spin_unlock(&c->lock);
+		nd->prefix_put = dentry;
+		return;
+	}
+	write_seqcount_begin(&c->seq);
+	nd->prefix_put = p->dentry;
+	p->dentry = dentry;
+	p->len = len;
+	p->depth = depth;
+	memcpy(p->name, name, len);
+	write_seqcount_end(&c->seq);
+	spin_unlock(&c->lock);
+}
+
+void walk_prefix_cache_free(struct mount *mnt)
+{
+	struct walk_prefix_cache *c;
+	struct dentry *pinned[WALK_PREFIX_SLOTS];
+	int i;
+
+	c = xchg(&mnt->mnt_prefix_cache, WALK_PREFIX_DEAD);
+	if (!c)
+		return;
+
+	spin_lock(&c->lock);
+	c->dead = true;
+	write_seqcount_begin(&c->seq);
+	for (i = 0; i < WALK_PREFIX_SLOTS; i++) {
+		pinned[i] = c->slot[i].dentry;
+		c->slot[i].dentry = NULL;
+	}
+	write_seqcount_end(&c->seq);
+	spin_unlock(&c->lock);
+
+	for (i = 0; i < WALK_PREFIX_SLOTS; i++)
+		dput(pinned[i]);
+	/* RCU walkers may still be looking at it */
+	kfree_rcu(c, rcu);
+}
+
 /*
  * Name resolution.
  * This is the basic name resolution function, turning a pathname into
@@ -2238,6 +2535,9 @@ static inline u64 hash_name(const void *salt, const char *name)
 static int link_path_walk(const char *name, struct nameidata *nd)
 {
 	int depth = 0; // depth <= nd->depth
+	struct vfsmount *start_mnt;
+	const char *start_name;
+	int nr_links;
 	int err;
 
 	nd->last_type = LAST_ROOT;
@@ -2251,6 +2551,17 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 		return 0;
 	}
 
+	start_mnt = nd->path.mnt;
+	start_name = name;
+	nr_links = nd->total_link_count;
+	nd->prefix_hit = 0;
+	if (nd->flags & LOOKUP_RCU) {
+		nd->prefix_hit = walk_prefix_lookup(nd, name);
+		name += nd->prefix_hit;
+		while (*name == '/')
+			name++;
+	}
+
 	/* At this point we know we have a real path component. */
 	for(;;) {
 		struct user_namespace *mnt_userns;
@@ -2310,6 +2621,8 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 				nd->dir_vfsuid = i_uid_into_vfsuid(mnt_userns, nd->inode);
 				nd->dir_mode = nd->inode->i_mode;
 				nd->flags &= ~LOOKUP_PARENT;
+				walk_prefix_remember(nd, start_mnt, nr_links,
+						     start_name);
 				return 0;
 			}
 			/* last component of nested symlink */
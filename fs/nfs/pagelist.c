@@ -485,10 +485,31 @@ nfs_create_request(struct nfs_open_context *ctx, struct page *page,
 
 	if (IS_ERR(l_ctx))
 		return ERR_CAST(l_ctx);
+	ret = nfs_create_request_lctx(l_ctx, page, offset, count);
+	nfs_put_lock_context(l_ctx);
+	return ret;
+}
+
+/**
+ * nfs_create_request_lctx - Create an NFS read/write request
+ * @l_ctx: lock context to use, held by the caller
+ * @page: page to write
+ * @offset: starting offset within the page for the write
+ * @count: number of bytes to read/write
+ *
+ * Same as nfs_create_request(), for callers that build requests for many
+ * pages under the same open context and look up the lock context once
+ * instead of once per page.
+ */
+struct nfs_page *
+nfs_create_request_lctx(struct nfs_lock_context *l_ctx, struct page *page,
+			unsigned int offset, unsigned int count)
+{
+	struct nfs_page *ret;
+
 	ret = __nfs_create_request(l_ctx, page, offset, offset, count);
 	if (!IS_ERR(ret))
 		nfs_page_group_init(ret, NULL);
-	nfs_put_lock_context(l_ctx);
 	return ret;
 }
 
@@ -130,6 +130,7 @@ static void nfs_readpage_release(struct nfs_page *req, int error)
 struct nfs_readdesc {
 	struct nfs_pageio_descriptor pgio;
 	struct nfs_open_context *ctx;
+	struct nfs_lock_context *l_ctx;	/* NULL: look up per request */
 };
 
 static void nfs_page_group_set_uptodate(struct nfs_page *req)
@@ -302,7 +303,11 @@ readpage_async_filler(struct nfs_readdesc *desc, struct page *page)
 			goto out_unlock;
 	}
 
-	new = nfs_create_request(desc->ctx, page, 0, aligned_len);
+	if (desc->l_ctx)
+		new = nfs_create_request_lctx(desc->l_ctx, page, 0,
+					      aligned_len);
+	else
+		new = nfs_create_request(desc->ctx, page, 0, aligned_len);
 	if (IS_ERR(new))
 		goto out_error;
 
@@ -365,6 +370,7 @@ int nfs_read_folio(struct file *file, struct folio *folio)
 		desc.ctx = get_nfs_open_context(nfs_file_open_context(file));
 
 	xchg(&desc.ctx->error, 0);
+	desc.l_ctx = NULL;
 	nfs_pageio_init_read(&desc.pgio, inode, false,
 			     &nfs_async_read_completion_ops);
 
@@ -413,6 +419,14 @@ void nfs_readahead(struct readahead_control *ractl)
 	} else
 		desc.ctx = get_nfs_open_context(nfs_file_open_context(file));
 
+	/*
+	 * All pages of the readahead window share the open context, so
+	 * resolve its lock context once rather than for every page.
+	 */
+	desc.l_ctx = nfs_get_lock_context(desc.ctx);
+	if (IS_ERR(desc.l_ctx))
+		desc.l_ctx = NULL;
+
 	nfs_pageio_init_read(&desc.pgio, inode, false,
 			     &nfs_async_read_completion_ops);
 
@@ -425,6 +439,8 @@ void nfs_readahead(struct readahead_control *ractl)
 
 	nfs_pageio_complete_read(&desc.pgio);
 
+	if (desc.l_ctx)
+		nfs_put_lock_context(desc.l_ctx);
 	put_nfs_open_context(desc.ctx);
 out:
 	trace_nfs_aop_readahead_done(inode, nr_pages, ret);
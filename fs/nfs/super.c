@@ -713,6 +713,8 @@ int nfs_show_stats(struct seq_file *m, struct dentry *root)
 			seq_printf(m, "%Lu ", totals.fscache[i]);
 	}
 #endif
+	seq_puts(m, "\n\tdcache:\t");
+	dcache_show_stats(m, root->d_sb);
 	seq_putc(m, '\n');
 
 	rpc_clnt_show_stats(m, nfss->client);
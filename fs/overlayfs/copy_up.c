@@ -231,6 +231,25 @@ static int ovl_copy_fileattr(struct inode *inode, const struct path *old,
 	return ovl_real_fileattr_set(new, &newfa);
 }
 
+/*
+ * Try the copy_file_range method of the upper fs, which can offload the copy
+ * or share blocks where clone could not, e.g. for ranges that were not block
+ * aligned or on filesystems that implement copy but not clone.  The method is
+ * called directly, like do_clone_file_range(), because ovl_want_write()
+ * already holds freeze protection on the upper fs.
+ */
+static ssize_t ovl_copy_up_range(struct file *old_file, loff_t old_pos,
+				 struct file *new_file, loff_t new_pos,
+				 size_t len)
+{
+	if (!new_file->f_op->copy_file_range ||
+	    new_file->f_op->copy_file_range != old_file->f_op->copy_file_range)
+		return -EOPNOTSUPP;
+
+	return new_file->f_op->copy_file_range(old_file, old_pos, new_file,
+					       new_pos, len, 0);
+}
+
 static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 			    struct file *new_file, loff_t len)
 {
@@ -242,6 +261,7 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 	loff_t data_pos = -1;
 	loff_t hole_len;
 	bool skip_hole = false;
+	bool try_copy_range = true;
 	int error = 0;
 
 	ovl_path_lowerdata(dentry, &datapath);
@@ -304,6 +324,19 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 			}
 		}
 
+		if (try_copy_range) {
+			bytes = ovl_copy_up_range(old_file, old_pos,
+						  new_file, new_pos, this_len);
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				len -= bytes;
+				continue;
+			}
+			/* Not supported here, don't try again */
+			try_copy_range = false;
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
@@ -607,10 +607,18 @@ static int ovl_create_or_link(struct dentry *dentry, struct inode *inode,
 		put_cred(override_cred);
 	}
 
-	if (!ovl_dentry_is_whiteout(dentry))
+	if (!ovl_dentry_is_whiteout(dentry)) {
 		err = ovl_create_upper(dentry, inode, attr);
-	else
+		/*
+		 * A negative dentry that is not a whiteout was not found in
+		 * any lower layer, and lower layers don't change, so unlink
+		 * and rename need not look them up again.
+		 */
+		if (!err)
+			ovl_dentry_set_flag(OVL_E_LOWER_NEGATIVE, dentry);
+	} else {
 		err = ovl_create_over_whiteout(dentry, inode, attr);
+	}
 
 out_revert_creds:
 	revert_creds(old_cred);
@@ -1260,6 +1268,10 @@ static int ovl_rename(struct user_namespace *mnt_userns, struct inode *olddir,
 	if (cleanup_whiteout)
 		ovl_cleanup(ofs, old_upperdir->d_inode, newdentry);
 
+	/* The dentries are about to change names */
+	ovl_dentry_clear_flag(OVL_E_LOWER_NEGATIVE, old);
+	ovl_dentry_clear_flag(OVL_E_LOWER_NEGATIVE, new);
+
 	if (overwrite && d_inode(new)) {
 		if (new_is_dir)
 			clear_nlink(d_inode(new));
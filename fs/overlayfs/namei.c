@@ -1176,6 +1176,10 @@ bool ovl_lower_positive(struct dentry *dentry)
 	if (!ovl_dentry_upper(dentry))
 		return true;
 
+	/* Created over a plain negative dentry */
+	if (ovl_dentry_test_flag(OVL_E_LOWER_NEGATIVE, dentry))
+		return false;
+
 	old_cred = ovl_override_creds(dentry->d_sb);
 	/* Positive upper -> have to look up lower to see whether it exists */
 	for (i = 0; !done && !positive && i < poe->numlower; i++) {
@@ -55,6 +55,8 @@ enum ovl_entry_flag {
 	OVL_E_UPPER_ALIAS,
 	OVL_E_OPAQUE,
 	OVL_E_CONNECTED,
+	/* No lower layer has this name, so ovl_lower_positive() is false */
+	OVL_E_LOWER_NEGATIVE,
 };
 
 enum {
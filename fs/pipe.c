@@ -59,6 +59,9 @@ static unsigned int pipe_max_size = 1048576;
 static unsigned long pipe_user_pages_hard;
 static unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/* Largest buffer pipe_write() allocates, see pipe_alloc_large_page() */
+#define PIPE_MAX_BUF_ORDER PAGE_ALLOC_COSTLY_ORDER
+
 /*
  * We use head and tail indices that aren't masked off, except at the point of
  * dereference, but rather they're allowed to wrap naturally.  This means there
@@ -132,7 +135,7 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	 * temporary page, let's keep track of it as a one-deep
 	 * allocation cache. (Otherwise just release our reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
+	if (page_count(page) == 1 && !pipe->tmp_page && !PageCompound(page))
 		pipe->tmp_page = page;
 	else
 		put_page(page);
@@ -143,7 +146,8 @@ static bool anon_pipe_buf_try_steal(struct pipe_inode_info *pipe,
 {
 	struct page *page = buf->page;
 
-	if (page_count(page) != 1)
+	/* the page cache only wants order-0 pages from us */
+	if (page_count(page) != 1 || PageCompound(page))
 		return false;
 	memcg_kmem_uncharge_page(page, 0);
 	__SetPageLocked(page);
@@ -412,6 +416,38 @@ static inline bool pipe_writable(const struct pipe_inode_info *pipe)
 		!READ_ONCE(pipe->readers);
 }
 
+/*
+ * Large writes get buffers of up to 1 << PIPE_MAX_BUF_ORDER pages, cutting
+ * the per-page cost of both ends of the pipe. A pipe only holds up to
+ * max_usage >> order buffers of a given order, so that the memory it pins
+ * stays within 2.5 times its size.
+ *
+ * The buffers come from lowmem: consumers such as fuse_copy_do() and
+ * sock_no_sendpage() kmap only the first page of a buffer and access the
+ * whole buffer through that mapping.
+ */
+static struct page *pipe_alloc_large_page(struct pipe_inode_info *pipe,
+					  size_t len)
+{
+	unsigned int occupancy = pipe_occupancy(pipe->head, pipe->tail);
+	struct page *page;
+	int order;
+
+	if (len < 2 * PAGE_SIZE)
+		return NULL;
+
+	order = min_t(int, ilog2(len >> PAGE_SHIFT), PIPE_MAX_BUF_ORDER);
+	for (; order > 0; order--) {
+		if (occupancy >= pipe->max_usage >> order)
+			continue;
+		page = alloc_pages(GFP_USER | __GFP_ACCOUNT | __GFP_COMP |
+				   __GFP_NOWARN | __GFP_NORETRY, order);
+		if (page)
+			return page;
+	}
+	return NULL;
+}
+
 static ssize_t
 pipe_write(struct kiocb *iocb, struct iov_iter *from)
 {
@@ -460,7 +496,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		int offset = buf->offset + buf->len;
 
 		if ((buf->flags & PIPE_BUF_FLAG_CAN_MERGE) &&
-		    offset + chars <= PAGE_SIZE) {
+		    offset + chars <= page_size(buf->page)) {
 			ret = pipe_buf_confirm(pipe, buf);
 			if (ret)
 				goto out;
@@ -489,9 +525,15 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (!pipe_full(head, pipe->tail, pipe->max_usage)) {
 			unsigned int mask = pipe->ring_size - 1;
 			struct pipe_buffer *buf = &pipe->bufs[head & mask];
-			struct page *page = pipe->tmp_page;
+			struct page *page = NULL;
+			size_t size;
 			int copied;
 
+			if (!is_packetized(filp))
+				page = pipe_alloc_large_page(pipe,
+							     iov_iter_count(from));
+			if (!page)
+				page = pipe->tmp_page;
 			if (!page) {
 				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
 				if (unlikely(!page)) {
@@ -511,6 +553,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			head = pipe->head;
 			if (pipe_full(head, pipe->tail, pipe->max_usage)) {
 				spin_unlock_irq(&pipe->rd_wait.lock);
+				if (page != pipe->tmp_page)
+					put_page(page);
 				continue;
 			}
 
@@ -527,10 +571,12 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			else
 				buf->flags = PIPE_BUF_FLAG_CAN_MERGE;
-			pipe->tmp_page = NULL;
+			if (page == pipe->tmp_page)
+				pipe->tmp_page = NULL;
 
-			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
-			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+			size = page_size(page);
+			copied = copy_page_from_iter(page, 0, size, from);
+			if (unlikely(copied < size && iov_iter_count(from))) {
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -60,6 +60,12 @@ static int seq_show(struct seq_file *m, void *v)
 		   real_mount(file->f_path.mnt)->mnt_id,
 		   file_inode(file)->i_ino);
 
+	/* racy, the readahead state is not locked even by its users */
+	if (S_ISREG(file_inode(file)->i_mode))
+		seq_printf(m, "ra_hits:\t%lu\nra_misses:\t%lu\n",
+			   READ_ONCE(file->f_ra.nr_hits),
+			   READ_ONCE(file->f_ra.nr_misses));
+
 	/* show_fd_locks() never deferences files so a stale value is safe */
 	show_fd_locks(m, file, files);
 	if (seq_has_overflowed(m))
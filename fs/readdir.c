@@ -17,6 +17,8 @@
 #include <linux/fsnotify.h>
 #include <linux/dirent.h>
 #include <linux/security.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
 #include <linux/compat.h>
@@ -24,6 +26,8 @@
 
 #include <asm/unaligned.h>
 
+#include "internal.h"
+
 /*
  * Note the "unsafe_put_user() semantics: we goto a
  * label for errors.
@@ -383,6 +387,192 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	return error;
 }
 
+/*
+ * getdents64 with the statx attributes of every entry, for
+ * IORING_OP_GETDENTS_STATX.
+ *
+ * The entries can't be looked up from the actor, the filesystem holds the
+ * directory lock there. They are gathered in a kernel buffer instead and
+ * looked up relative to the directory once the iteration is done, which
+ * finds the dentries it just made hot without a path walk per entry.
+ */
+#define GETDENTS_STATX_BUF_MAX	(64 * 1024)
+
+struct getdents_statx_callback {
+	struct dir_context ctx;
+	struct linux_dirent64 *current_dir;
+	struct linux_dirent64 *prev;
+	char *end;
+	int count;
+	int error;
+};
+
+static int dirent_statx_reclen(int namlen)
+{
+	return ALIGN(offsetof(struct dirent_statx, d_name) + namlen + 1,
+		     sizeof(u64));
+}
+
+static bool filldir_statx(struct dir_context *ctx, const char *name,
+			  int namlen, loff_t offset, u64 ino,
+			  unsigned int d_type)
+{
+	struct getdents_statx_callback *buf =
+		container_of(ctx, struct getdents_statx_callback, ctx);
+	struct linux_dirent64 *dirent = buf->current_dir;
+	int reclen = ALIGN(offsetof(struct linux_dirent64, d_name) + namlen + 1,
+		sizeof(u64));
+	int ureclen = dirent_statx_reclen(namlen);
+
+	buf->error = verify_dirent_name(name, namlen);
+	if (unlikely(buf->error))
+		return false;
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (ureclen > buf->count || (char *)dirent + reclen > buf->end)
+		return false;
+	if (buf->prev && signal_pending(current))
+		return false;
+
+	if (buf->prev)
+		buf->prev->d_off = offset;
+	dirent->d_ino = ino;
+	dirent->d_reclen = reclen;
+	dirent->d_type = d_type;
+	memcpy(dirent->d_name, name, namlen);
+	dirent->d_name[namlen] = 0;
+
+	buf->prev = dirent;
+	buf->current_dir = (void *)dirent + reclen;
+	buf->count -= ureclen;
+	return true;
+}
+
+static struct dentry *getdents_statx_lookup(struct file *dir,
+					    const char *name, int namlen)
+{
+	struct dentry *parent = dir->f_path.dentry;
+
+	if (name[0] == '.' && namlen == 1)
+		return dget(parent);
+	if (name[0] == '.' && name[1] == '.' && namlen == 2)
+		return dget_parent(parent);
+	return lookup_one_unlocked(file_mnt_user_ns(dir), name, parent,
+				   namlen);
+}
+
+static int getdents_statx_one(struct file *dir, struct linux_dirent64 *de,
+			      int namlen, struct statx __user *buffer,
+			      unsigned int mask, unsigned int flags)
+{
+	struct path path;
+	struct kstat stat;
+	int error;
+
+	path.dentry = getdents_statx_lookup(dir, de->d_name, namlen);
+	if (IS_ERR(path.dentry))
+		return PTR_ERR(path.dentry);
+	path.mnt = mntget(dir->f_path.mnt);
+
+	/* the entry may have been removed since the iteration saw it */
+	error = -ENOENT;
+	if (d_really_is_positive(path.dentry)) {
+		/* report what is mounted on the entry, like a lookup does */
+		if (d_mountpoint(path.dentry))
+			follow_down(&path);
+		error = vfs_getattr(&path, &stat, mask, flags);
+	}
+	path_put(&path);
+	if (error)
+		return error;
+	return cp_statx(&stat, buffer);
+}
+
+/**
+ * vfs_getdents_statx - read directory entries with their attributes
+ * @file: the directory
+ * @dirent: user buffer for the struct dirent_statx records
+ * @count: size of @dirent
+ * @flags: AT_STATX_* sync flags
+ * @mask: STATX_* attributes wanted, as for statx(2)
+ *
+ * Entries are looked up without following symlinks or triggering automounts,
+ * so they report what fstatat(AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT) would.
+ * An entry which can't be looked up is still returned, with a zero stx_mask.
+ *
+ * Return: the number of bytes filled in, 0 at the end of the directory.
+ */
+int vfs_getdents_statx(struct file *file, struct dirent_statx __user *dirent,
+		       unsigned int count, unsigned int flags,
+		       unsigned int mask)
+{
+	struct getdents_statx_callback buf = {
+		.ctx.actor = filldir_statx,
+		.count = count,
+	};
+	struct dirent_statx __user *out = dirent;
+	unsigned int size = min_t(unsigned int, count, GETDENTS_STATX_BUF_MAX);
+	struct linux_dirent64 *kbuf, *de;
+	bool pos_lock = file->f_mode & FMODE_ATOMIC_POS;
+	int error;
+
+	if (flags & ~AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if ((flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+
+	kbuf = kvmalloc(size, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	buf.current_dir = kbuf;
+	buf.end = (char *)kbuf + size;
+
+	if (pos_lock)
+		mutex_lock(&file->f_pos_lock);
+	error = iterate_dir(file, &buf.ctx);
+	if (pos_lock)
+		mutex_unlock(&file->f_pos_lock);
+	if (error >= 0)
+		error = buf.error;
+	if (!buf.prev)
+		goto out;
+	buf.prev->d_off = buf.ctx.pos;
+
+	for (de = kbuf; de <= buf.prev; de = (void *)de + de->d_reclen) {
+		int namlen = strlen(de->d_name);
+		int reclen = dirent_statx_reclen(namlen);
+
+		if (!user_write_access_begin(out, reclen))
+			goto efault;
+		unsafe_put_user(de->d_ino, &out->d_ino, efault_end);
+		unsafe_put_user(de->d_off, &out->d_off, efault_end);
+		unsafe_put_user(reclen, &out->d_reclen, efault_end);
+		unsafe_put_user(de->d_type, &out->d_type, efault_end);
+		unsafe_copy_dirent_name(out->d_name, de->d_name, namlen,
+					efault_end);
+		user_write_access_end();
+
+		if (getdents_statx_one(file, de, namlen, &out->d_stx,
+				       mask, flags) &&
+		    clear_user(&out->d_stx, sizeof(out->d_stx)))
+			goto efault;
+
+		out = (void __user *)out + reclen;
+		cond_resched();
+	}
+	error = count - buf.count;
+out:
+	kvfree(kbuf);
+	return error;
+
+efault_end:
+	user_write_access_end();
+efault:
+	error = -EFAULT;
+	goto out;
+}
+
 #ifdef CONFIG_COMPAT
 struct compat_old_linux_dirent {
 	compat_ulong_t	d_ino;
@@ -793,6 +793,43 @@ static long do_splice_to(struct file *in, loff_t *ppos,
 	return in->f_op->splice_read(in, ppos, pipe, len, flags);
 }
 
+/*
+ * Get the process-private pipe used for splicing between two non-pipes,
+ * allocating it on first use.
+ */
+static struct pipe_inode_info *splice_get_direct_pipe(void)
+{
+	struct pipe_inode_info *pipe = current->splice_pipe;
+
+	if (unlikely(!pipe)) {
+		pipe = alloc_pipe_info();
+		if (!pipe)
+			return NULL;
+
+		/*
+		 * We don't have an immediate reader, but we'll read the stuff
+		 * out of the pipe right after the splice_to_pipe(). So set
+		 * PIPE_READERS appropriately.
+		 */
+		pipe->readers = 1;
+
+		current->splice_pipe = pipe;
+	}
+	return pipe;
+}
+
+static void splice_release_direct_pipe(struct pipe_inode_info *pipe)
+{
+	int i;
+
+	for (i = 0; i < pipe->ring_size; i++) {
+		struct pipe_buffer *buf = &pipe->bufs[i];
+
+		if (buf->ops)
+			pipe_buf_release(pipe, buf);
+	}
+}
+
 /**
  * splice_direct_to_actor - splices data directly between two non-pipes
  * @in:		file to splice from
@@ -812,7 +849,7 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 	struct pipe_inode_info *pipe;
 	long ret, bytes;
 	size_t len;
-	int i, flags, more;
+	int flags, more;
 
 	/*
 	 * We require the input to be seekable, as we don't want to randomly
@@ -826,21 +863,9 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 	 * neither in nor out is a pipe, setup an internal pipe attached to
 	 * 'out' and transfer the wanted data from 'in' to 'out' through that
 	 */
-	pipe = current->splice_pipe;
-	if (unlikely(!pipe)) {
-		pipe = alloc_pipe_info();
-		if (!pipe)
-			return -ENOMEM;
-
-		/*
-		 * We don't have an immediate reader, but we'll read the stuff
-		 * out of the pipe right after the splice_to_pipe(). So set
-		 * PIPE_READERS appropriately.
-		 */
-		pipe->readers = 1;
-
-		current->splice_pipe = pipe;
-	}
+	pipe = splice_get_direct_pipe();
+	if (unlikely(!pipe))
+		return -ENOMEM;
 
 	/*
 	 * Do the splice.
@@ -909,12 +934,7 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 	 * If we did an incomplete transfer we must release
 	 * the pipe buffers in question:
 	 */
-	for (i = 0; i < pipe->ring_size; i++) {
-		struct pipe_buffer *buf = &pipe->bufs[i];
-
-		if (buf->ops)
-			pipe_buf_release(pipe, buf);
-	}
+	splice_release_direct_pipe(pipe);
 
 	if (!bytes)
 		bytes = ret;
@@ -979,6 +999,99 @@ long do_splice_direct(struct file *in, loff_t *ppos, struct file *out,
 }
 EXPORT_SYMBOL(do_splice_direct);
 
+/**
+ * do_splice_direct_stream - splices data from a stream to a file
+ * @in:		non-seekable file to splice from, eg a socket
+ * @out:	file to splice to
+ * @opos:	output file offset
+ * @len:	maximum number of bytes to splice
+ * @flags:	splice modifier flags
+ *
+ * Description:
+ *    Like do_splice_direct(), but for an input that can't be rewound, which
+ *    splice_direct_to_actor() refuses. Each chunk read from @in is written
+ *    out completely before more is read, and a short write ends the call
+ *    with a short count once that chunk is out, rather than consuming more
+ *    of @in that @out may not take. Data consumed from @in can't be put
+ *    back, so if @out then fails outright the rest of the chunk is lost;
+ *    the count returned covers only what reached @out, and the error is
+ *    returned if nothing did.
+ *
+ *    Only the first read honours blocking @flags; once some data has been
+ *    moved, this returns when @in has nothing more ready, like a read from
+ *    a socket would.
+ */
+long do_splice_direct_stream(struct file *in, struct file *out, loff_t *opos,
+			     size_t len, unsigned int flags)
+{
+	struct pipe_inode_info *pipe;
+	long ret, bytes = 0;
+	loff_t pos;
+
+	if (unlikely(!(out->f_mode & FMODE_WRITE)))
+		return -EBADF;
+
+	if (unlikely(out->f_flags & O_APPEND))
+		return -EINVAL;
+
+	ret = rw_verify_area(WRITE, out, opos, len);
+	if (unlikely(ret < 0))
+		return ret;
+
+	pipe = splice_get_direct_pipe();
+	if (unlikely(!pipe))
+		return -ENOMEM;
+
+	WARN_ON_ONCE(!pipe_empty(pipe->head, pipe->tail));
+
+	/*
+	 * ->splice_read() implementations such as generic_file_splice_read()
+	 * expect a position even for files that can't seek, feed them f_pos.
+	 */
+	pos = in->f_pos;
+	while (len) {
+		bool short_write = false;
+		size_t read_len;
+
+		ret = do_splice_to(in, &pos, pipe, len, flags);
+		if (ret <= 0)
+			break;
+
+		read_len = ret;
+		len -= read_len;
+		while (read_len) {
+			unsigned int out_flags = flags & ~SPLICE_F_NONBLOCK;
+
+			if (len)
+				out_flags |= SPLICE_F_MORE;
+			ret = do_splice_from(pipe, out, opos, read_len,
+					     out_flags);
+			if (unlikely(ret <= 0)) {
+				splice_release_direct_pipe(pipe);
+				goto out;
+			}
+			bytes += ret;
+			read_len -= ret;
+			if (read_len)
+				short_write = true;
+		}
+
+		/* @out is filling up, don't read what it may refuse */
+		if (short_write)
+			break;
+
+		/* got something, don't wait for more */
+		flags |= SPLICE_F_NONBLOCK;
+	}
+out:
+	in->f_pos = pos;
+	pipe->tail = pipe->head = 0;
+	if (bytes)
+		return bytes;
+	return ret;
+}
+EXPORT_SYMBOL(do_splice_direct_stream);
+
 static int wait_for_space(struct pipe_inode_info *pipe, unsigned flags)
 {
 	for (;;) {
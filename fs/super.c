@@ -153,6 +153,22 @@ static unsigned long super_cache_count(struct shrinker *shrink,
 	return total_objects;
 }
 
+/*
+ * Kicked by the dcache when the superblock went over the negative dentry
+ * limit. Like the shrinker it stays away from superblocks being set up or
+ * torn down, a later negative dentry kicks it again.
+ */
+static void super_prune_negative_dentries(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_dentry_negative_work);
+
+	if (!trylock_super(sb))
+		return;
+	prune_dcache_sb_negative(sb);
+	up_read(&sb->s_umount);
+}
+
 static void destroy_super_work(struct work_struct *work)
 {
 	struct super_block *s = container_of(work, struct super_block,
@@ -161,6 +177,7 @@ static void destroy_super_work(struct work_struct *work)
 
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_free_rwsem(&s->s_writers.rw_sem[i]);
+	percpu_counter_destroy(&s->s_nr_dentry_negative);
 	kfree(s);
 }
 
@@ -271,6 +288,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 		goto fail;
 	if (list_lru_init_memcg(&s->s_inode_lru, &s->s_shrink))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_dentry_negative, 0, GFP_KERNEL))
+		goto fail;
+	INIT_WORK(&s->s_dentry_negative_work, super_prune_negative_dentries);
 	return s;
 
 fail:
@@ -330,6 +350,8 @@ void deactivate_locked_super(struct super_block *s)
 	if (atomic_dec_and_test(&s->s_active)) {
 		unregister_shrinker(&s->s_shrink);
 		fs->kill_sb(s);
+		/* we hold s_umount, a running prune work bails out */
+		cancel_work_sync(&s->s_dentry_negative_work);
 
 		/*
 		 * Since list_lru_destroy() may sleep, we cannot call it from
@@ -31,6 +31,7 @@
 #include <linux/hugetlb.h>
 #include <linux/swapops.h>
 #include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
 
 int sysctl_unprivileged_userfaultfd __read_mostly;
 
@@ -73,6 +74,10 @@ struct userfaultfd_ctx {
 	atomic_t mmap_changing;
 	/* mm with one ore more vmas attached to this userfaultfd_ctx */
 	struct mm_struct *mm;
+	/* fault ring mapped by userland, protected by fault_pending_wqh lock */
+	struct uffd_ring *ring;
+	unsigned int ring_mask;
+	unsigned int ring_tail;
 };
 
 struct userfaultfd_fork_ctx {
@@ -98,6 +103,9 @@ struct userfaultfd_wait_queue {
 struct userfaultfd_wake_range {
 	unsigned long start;
 	unsigned long len;
+	/* if set, wake the faults in any of the @nr ranges of @vec instead */
+	const struct uffdio_vec *vec;
+	unsigned long nr;
 };
 
 /* internal indication that UFFD_API ioctl was successfully executed */
@@ -108,21 +116,33 @@ static bool userfaultfd_is_initialized(struct userfaultfd_ctx *ctx)
 	return ctx->features & UFFD_FEATURE_INITIALIZED;
 }
 
+static bool userfaultfd_wake_match(struct userfaultfd_wake_range *range,
+				   unsigned long address)
+{
+	unsigned long i;
+
+	if (range->vec) {
+		for (i = 0; i < range->nr; i++)
+			if (address >= range->vec[i].dst &&
+			    address < range->vec[i].dst + range->vec[i].len)
+				return true;
+		return false;
+	}
+	/* len == 0 means wake all */
+	return !range->len || (address >= range->start &&
+			       address < range->start + range->len);
+}
+
 static int userfaultfd_wake_function(wait_queue_entry_t *wq, unsigned mode,
 				     int wake_flags, void *key)
 {
 	struct userfaultfd_wake_range *range = key;
 	int ret;
 	struct userfaultfd_wait_queue *uwq;
-	unsigned long start, len;
 
 	uwq = container_of(wq, struct userfaultfd_wait_queue, wq);
 	ret = 0;
-	/* len == 0 means wake all */
-	start = range->start;
-	len = range->len;
-	if (len && (start > uwq->msg.arg.pagefault.address ||
-		    start + len <= uwq->msg.arg.pagefault.address))
+	if (!userfaultfd_wake_match(range, uwq->msg.arg.pagefault.address))
 		goto out;
 	WRITE_ONCE(uwq->waken, true);
 	/*
@@ -177,6 +197,7 @@ static void userfaultfd_ctx_put(struct userfaultfd_ctx *ctx)
 		VM_BUG_ON(waitqueue_active(&ctx->event_wqh));
 		VM_BUG_ON(spin_is_locked(&ctx->fd_wqh.lock));
 		VM_BUG_ON(waitqueue_active(&ctx->fd_wqh));
+		vfree(ctx->ring);
 		mmdrop(ctx->mm);
 		kmem_cache_free(userfaultfd_ctx_cachep, ctx);
 	}
@@ -359,6 +380,37 @@ static inline unsigned int userfaultfd_get_blocking_state(unsigned int flags)
 	return TASK_UNINTERRUPTIBLE;
 }
 
+/*
+ * Append a fault message to the ring mapped by userland, if any.
+ * fault_pending_wqh.lock must be held by the caller.
+ */
+static bool userfaultfd_ring_push(struct userfaultfd_ctx *ctx,
+				  struct uffd_msg *msg)
+{
+	struct uffd_ring *ring = ctx->ring;
+	unsigned int tail = ctx->ring_tail;
+
+	if (!ring)
+		return false;
+	/* pairs with the release of head by userland */
+	if (tail - smp_load_acquire(&ring->head) > ctx->ring_mask) {
+		WRITE_ONCE(ring->overflow, ring->overflow + 1);
+		return false;
+	}
+	ring->msgs[tail & ctx->ring_mask] = *msg;
+	ctx->ring_tail = ++tail;
+	/* the message must be visible before the new tail */
+	smp_store_release(&ring->tail, tail);
+	return true;
+}
+
+static bool userfaultfd_ring_pending(struct userfaultfd_ctx *ctx)
+{
+	struct uffd_ring *ring = READ_ONCE(ctx->ring);
+
+	return ring && READ_ONCE(ring->head) != READ_ONCE(ctx->ring_tail);
+}
+
 /*
  * The locking rules involved in returning VM_FAULT_RETRY depending on
  * FAULT_FLAG_ALLOW_RETRY, FAULT_FLAG_RETRY_NOWAIT and
@@ -496,9 +548,16 @@ vm_fault_t handle_userfault(struct vm_fault *vmf, unsigned long reason)
 	spin_lock_irq(&ctx->fault_pending_wqh.lock);
 	/*
 	 * After the __add_wait_queue the uwq is visible to userland
-	 * through poll/read().
+	 * through poll/read(). A fault delivered through the ring has
+	 * been "read" already and waits in fault_wqh right away.
 	 */
-	__add_wait_queue(&ctx->fault_pending_wqh, &uwq.wq);
+	if (userfaultfd_ring_push(ctx, &uwq.msg)) {
+		spin_lock(&ctx->fault_wqh.lock);
+		__add_wait_queue(&ctx->fault_wqh, &uwq.wq);
+		spin_unlock(&ctx->fault_wqh.lock);
+	} else {
+		__add_wait_queue(&ctx->fault_pending_wqh, &uwq.wq);
+	}
 	/*
 	 * The smp_mb() after __set_current_state prevents the reads
 	 * following the spin_unlock to happen before the list_add in
@@ -680,6 +739,7 @@ int dup_userfaultfd(struct vm_area_struct *vma, struct list_head *fcs)
 		atomic_set(&ctx->mmap_changing, 0);
 		ctx->mm = vma->vm_mm;
 		mmgrab(ctx->mm);
+		ctx->ring = NULL;
 
 		userfaultfd_ctx_get(octx);
 		atomic_inc(&octx->mmap_changing);
@@ -895,6 +955,7 @@ static int userfaultfd_release(struct inode *inode, struct file *file)
 			prev = vma;
 		}
 
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx = NULL_VM_UFFD_CTX;
 	}
@@ -982,6 +1043,8 @@ static __poll_t userfaultfd_poll(struct file *file, poll_table *wait)
 		ret = EPOLLIN;
 	else if (waitqueue_active(&ctx->event_wqh))
 		ret = EPOLLIN;
+	else if (userfaultfd_ring_pending(ctx))
+		ret = EPOLLIN;
 
 	return ret;
 }
@@ -1463,6 +1526,7 @@ static int userfaultfd_register(struct userfaultfd_ctx *ctx,
 		 * the next vma was merged into the current one and
 		 * the current one has not been updated yet.
 		 */
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx.ctx = ctx;
 
@@ -1613,7 +1677,7 @@ static int userfaultfd_unregister(struct userfaultfd_ctx *ctx,
 			 * permanently and it avoids userland to call
 			 * UFFDIO_WAKE explicitly.
 			 */
-			struct userfaultfd_wake_range range;
+			struct userfaultfd_wake_range range = { };
 			range.start = start;
 			range.len = vma_end - start;
 			wake_userfault(vma->vm_userfaultfd_ctx.ctx, &range);
@@ -1651,6 +1715,7 @@ static int userfaultfd_unregister(struct userfaultfd_ctx *ctx,
 		 * the next vma was merged into the current one and
 		 * the current one has not been updated yet.
 		 */
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx = NULL_VM_UFFD_CTX;
 
@@ -1675,7 +1740,7 @@ static int userfaultfd_wake(struct userfaultfd_ctx *ctx,
 {
 	int ret;
 	struct uffdio_range uffdio_wake;
-	struct userfaultfd_wake_range range;
+	struct userfaultfd_wake_range range = { };
 	const void __user *buf = (void __user *)arg;
 
 	ret = -EFAULT;
@@ -1708,7 +1773,7 @@ static int userfaultfd_copy(struct userfaultfd_ctx *ctx,
 	__s64 ret;
 	struct uffdio_copy uffdio_copy;
 	struct uffdio_copy __user *user_uffdio_copy;
-	struct userfaultfd_wake_range range;
+	struct userfaultfd_wake_range range = { };
 
 	user_uffdio_copy = (struct uffdio_copy __user *) arg;
 
@@ -1765,7 +1830,7 @@ static int userfaultfd_zeropage(struct userfaultfd_ctx *ctx,
 	__s64 ret;
 	struct uffdio_zeropage uffdio_zeropage;
 	struct uffdio_zeropage __user *user_uffdio_zeropage;
-	struct userfaultfd_wake_range range;
+	struct userfaultfd_wake_range range = { };
 
 	user_uffdio_zeropage = (struct uffdio_zeropage __user *) arg;
 
@@ -1817,7 +1882,7 @@ static int userfaultfd_writeprotect(struct userfaultfd_ctx *ctx,
 	int ret;
 	struct uffdio_writeprotect uffdio_wp;
 	struct uffdio_writeprotect __user *user_uffdio_wp;
-	struct userfaultfd_wake_range range;
+	struct userfaultfd_wake_range range = { };
 	bool mode_wp, mode_dontwake;
 
 	if (atomic_read(&ctx->mmap_changing))
@@ -1869,7 +1934,7 @@ static int userfaultfd_continue(struct userfaultfd_ctx *ctx, unsigned long arg)
 	__s64 ret;
 	struct uffdio_continue uffdio_continue;
 	struct uffdio_continue __user *user_uffdio_continue;
-	struct userfaultfd_wake_range range;
+	struct userfaultfd_wake_range range = { };
 
 	user_uffdio_continue = (struct uffdio_continue __user *)arg;
 
@@ -1924,6 +1989,98 @@ static int userfaultfd_continue(struct userfaultfd_ctx *ctx, unsigned long arg)
 	return ret;
 }
 
+static int userfaultfd_copyv(struct userfaultfd_ctx *ctx, unsigned long arg,
+			     bool cont)
+{
+	__s64 ret;
+	struct uffdio_copyv uffdio_copyv;
+	struct uffdio_copyv __user *user_uffdio_copyv;
+	struct userfaultfd_wake_range range = { };
+	struct uffdio_vec *vec;
+	__u64 i, nr, len, left, mode_mask, dontwake;
+
+	user_uffdio_copyv = (struct uffdio_copyv __user *) arg;
+
+	ret = -EAGAIN;
+	if (atomic_read(&ctx->mmap_changing))
+		goto out;
+
+	ret = -EFAULT;
+	if (copy_from_user(&uffdio_copyv, user_uffdio_copyv,
+			   /* don't copy "copied" last field */
+			   sizeof(uffdio_copyv)-sizeof(__s64)))
+		goto out;
+
+	if (cont) {
+		mode_mask = UFFDIO_CONTINUE_MODE_DONTWAKE;
+		dontwake = UFFDIO_CONTINUE_MODE_DONTWAKE;
+	} else {
+		mode_mask = UFFDIO_COPY_MODE_DONTWAKE|UFFDIO_COPY_MODE_WP;
+		dontwake = UFFDIO_COPY_MODE_DONTWAKE;
+	}
+	ret = -EINVAL;
+	nr = uffdio_copyv.nr;
+	if (!nr || nr > UFFDIO_VEC_MAX)
+		goto out;
+	if (uffdio_copyv.mode & ~mode_mask)
+		goto out;
+
+	vec = vmemdup_user(u64_to_user_ptr(uffdio_copyv.vec),
+			   nr * sizeof(*vec));
+	if (IS_ERR(vec))
+		return PTR_ERR(vec);
+
+	len = 0;
+	for (i = 0; i < nr; i++) {
+		ret = validate_range(ctx->mm, vec[i].dst, vec[i].len);
+		if (ret)
+			goto out_free;
+		/* double check for wraparound, see userfaultfd_copy() */
+		ret = -EINVAL;
+		if (!cont && vec[i].src + vec[i].len <= vec[i].src)
+			goto out_free;
+		len += vec[i].len;
+	}
+
+	if (mmget_not_zero(ctx->mm)) {
+		if (cont)
+			ret = mcopy_continue_vec(ctx->mm, vec, nr,
+						 &ctx->mmap_changing);
+		else
+			ret = mcopy_atomic_vec(ctx->mm, vec, nr,
+					       &ctx->mmap_changing,
+					       uffdio_copyv.mode);
+		mmput(ctx->mm);
+	} else {
+		ret = -ESRCH;
+		goto out_free;
+	}
+	if (unlikely(put_user(ret, &user_uffdio_copyv->copied))) {
+		ret = -EFAULT;
+		goto out_free;
+	}
+	if (ret < 0)
+		goto out_free;
+	BUG_ON(!ret);
+
+	/* trim the vector to what got resolved and wake it in one pass */
+	left = ret;
+	for (i = 0; i < nr && left; i++) {
+		vec[i].len = min(vec[i].len, left);
+		left -= vec[i].len;
+	}
+	if (!(uffdio_copyv.mode & dontwake)) {
+		range.vec = vec;
+		range.nr = i;
+		wake_userfault(ctx, &range);
+	}
+	ret = ret == len ? 0 : -EAGAIN;
+out_free:
+	kvfree(vec);
+out:
+	return ret;
+}
+
 static inline unsigned int uffd_ctx_features(__u64 user_features)
 {
 	/*
@@ -2022,6 +2179,12 @@ static long userfaultfd_ioctl(struct file *file, unsigned cmd,
 	case UFFDIO_CONTINUE:
 		ret = userfaultfd_continue(ctx, arg);
 		break;
+	case UFFDIO_COPYV:
+		ret = userfaultfd_copyv(ctx, arg, false);
+		break;
+	case UFFDIO_CONTINUEV:
+		ret = userfaultfd_copyv(ctx, arg, true);
+		break;
 	}
 	return ret;
 }
@@ -2054,6 +2217,54 @@ static void userfaultfd_show_fdinfo(struct seq_file *m, struct file *f)
 }
 #endif
 
+/*
+ * Map the fault ring of UFFD_FEATURE_FAULT_RING. It is sized by the
+ * mapping and can only be set up once per uffd.
+ */
+static int userfaultfd_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct userfaultfd_ctx *ctx = file->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct uffd_ring *ring;
+	unsigned int nr;
+	int ret;
+
+	if (!(ctx->features & UFFD_FEATURE_FAULT_RING))
+		return -EINVAL;
+	if (vma->vm_pgoff || !(vma->vm_flags & VM_SHARED) || size > SZ_16M)
+		return -EINVAL;
+	if (READ_ONCE(ctx->ring))
+		return -EBUSY;
+
+	ring = vmalloc_user(size);
+	if (!ring)
+		return -ENOMEM;
+	nr = rounddown_pow_of_two((size - sizeof(*ring)) /
+				  sizeof(struct uffd_msg));
+	ring->mask = nr - 1;
+
+	ret = remap_vmalloc_range(vma, ring, 0);
+	if (ret) {
+		vfree(ring);
+		return ret;
+	}
+	vma->vm_flags |= VM_DONTCOPY;
+
+	ret = -EBUSY;
+	spin_lock_irq(&ctx->fault_pending_wqh.lock);
+	if (!ctx->ring) {
+		ctx->ring_mask = nr - 1;
+		ctx->ring_tail = 0;
+		WRITE_ONCE(ctx->ring, ring);
+		ret = 0;
+	}
+	spin_unlock_irq(&ctx->fault_pending_wqh.lock);
+	/* the pages stay mapped until the failed mmap is torn down */
+	if (ret)
+		vfree(ring);
+	return ret;
+}
+
 static const struct file_operations userfaultfd_fops = {
 #ifdef CONFIG_PROC_FS
 	.show_fdinfo	= userfaultfd_show_fdinfo,
@@ -2061,6 +2272,7 @@ static const struct file_operations userfaultfd_fops = {
 	.release	= userfaultfd_release,
 	.poll		= userfaultfd_poll,
 	.read		= userfaultfd_read,
+	.mmap		= userfaultfd_mmap,
 	.unlocked_ioctl = userfaultfd_ioctl,
 	.compat_ioctl	= compat_ptr_ioctl,
 	.llseek		= noop_llseek,
@@ -2104,9 +2316,11 @@ static int new_userfaultfd(int flags)
 	ctx->mm = current->mm;
 	/* prevent the mm struct to be freed */
 	mmgrab(ctx->mm);
+	ctx->ring = NULL;
 
+	/* writable so that the fault ring can be mapped shared */
 	fd = anon_inode_getfd_secure("[userfaultfd]", &userfaultfd_fops, ctx,
-			O_RDONLY | (flags & UFFD_SHARED_FCNTL_FLAGS), NULL);
+			O_RDWR | (flags & UFFD_SHARED_FCNTL_FLAGS), NULL);
 	if (fd < 0) {
 		mmdrop(ctx->mm);
 		kmem_cache_free(userfaultfd_ctx_cachep, ctx);
@@ -15,6 +15,7 @@
 #include "xfs_ialloc.h"
 #include "xfs_ialloc_btree.h"
 #include "xfs_iwalk.h"
+#include "xfs_pwork.h"
 #include "xfs_itable.h"
 #include "xfs_error.h"
 #include "xfs_icache.h"
@@ -37,48 +38,35 @@ struct xfs_bstat_chunk {
 };
 
 /*
- * Fill out the bulkstat info for a single inode and report it somewhere.
- *
- * bc->breq->lastino is effectively the inode cursor as we walk through the
- * filesystem.  Therefore, we update it any time we need to move the cursor
- * forward, regardless of whether or not we're sending any bstat information
- * back to userspace.  If the inode is internal metadata or, has been freed
- * out from under us, we just simply keep going.
- *
- * However, if any other type of error happens we want to stop right where we
- * are so that userspace will call back with exact number of the bad inode and
- * we can send back an error code.
- *
- * Note that if the formatter tells us there's no space left in the buffer we
- * move the cursor forward and abort the walk.
+ * Fill out the bulkstat info for a single inode.  Returns -ENOENT or -EINVAL
+ * if the inode is internal metadata or no longer allocated, which the callers
+ * skip over.
  */
 STATIC int
-xfs_bulkstat_one_int(
+xfs_bulkstat_fill(
 	struct xfs_mount	*mp,
 	struct user_namespace	*mnt_userns,
 	struct xfs_trans	*tp,
 	xfs_ino_t		ino,
-	struct xfs_bstat_chunk	*bc)
+	unsigned int		breq_flags,
+	struct xfs_bulkstat	*buf)
 {
 	struct user_namespace	*sb_userns = mp->m_super->s_user_ns;
 	struct xfs_inode	*ip;		/* incore inode pointer */
 	struct inode		*inode;
-	struct xfs_bulkstat	*buf = bc->buf;
 	xfs_extnum_t		nextents;
-	int			error = -EINVAL;
+	int			error;
 	vfsuid_t		vfsuid;
 	vfsgid_t		vfsgid;
 
 	if (xfs_internal_inum(mp, ino))
-		goto out_advance;
+		return -EINVAL;
 
 	error = xfs_iget(mp, tp, ino,
 			 (XFS_IGET_DONTCACHE | XFS_IGET_UNTRUSTED),
 			 XFS_ILOCK_SHARED, &ip);
-	if (error == -ENOENT || error == -EINVAL)
-		goto out_advance;
 	if (error)
-		goto out;
+		return error;
 
 	ASSERT(ip != NULL);
 	ASSERT(ip->i_imap.im_blkno != 0);
@@ -109,7 +97,7 @@ xfs_bulkstat_one_int(
 	buf->bs_extsize_blks = ip->i_extsize;
 
 	nextents = xfs_ifork_nextents(&ip->i_df);
-	if (!(bc->breq->flags & XFS_IBULK_NREXT64))
+	if (!(breq_flags & XFS_IBULK_NREXT64))
 		buf->bs_extents = min(nextents, XFS_MAX_EXTCNT_DATA_FORK_SMALL);
 	else
 		buf->bs_extents64 = nextents;
@@ -146,8 +134,43 @@ xfs_bulkstat_one_int(
 	}
 	xfs_iunlock(ip, XFS_ILOCK_SHARED);
 	xfs_irele(ip);
+	return 0;
+}
 
-	error = bc->formatter(bc->breq, buf);
+/*
+ * Fill out the bulkstat info for a single inode and report it somewhere.
+ *
+ * bc->breq->lastino is effectively the inode cursor as we walk through the
+ * filesystem.  Therefore, we update it any time we need to move the cursor
+ * forward, regardless of whether or not we're sending any bstat information
+ * back to userspace.  If the inode is internal metadata or, has been freed
+ * out from under us, we just simply keep going.
+ *
+ * However, if any other type of error happens we want to stop right where we
+ * are so that userspace will call back with exact number of the bad inode and
+ * we can send back an error code.
+ *
+ * Note that if the formatter tells us there's no space left in the buffer we
+ * move the cursor forward and abort the walk.
+ */
+STATIC int
+xfs_bulkstat_one_int(
+	struct xfs_mount	*mp,
+	struct user_namespace	*mnt_userns,
+	struct xfs_trans	*tp,
+	xfs_ino_t		ino,
+	struct xfs_bstat_chunk	*bc)
+{
+	int			error;
+
+	error = xfs_bulkstat_fill(mp, mnt_userns, tp, ino, bc->breq->flags,
+			bc->buf);
+	if (error == -ENOENT || error == -EINVAL)
+		goto out_advance;
+	if (error)
+		goto out;
+
+	error = bc->formatter(bc->breq, bc->buf);
 	if (error == -ECANCELED)
 		goto out_advance;
 	if (error)
@@ -256,6 +279,200 @@ xfs_bulkstat_already_done(
 	       startino != XFS_AGINO_TO_INO(mp, agno, agino);
 }
 
+/*
+ * Parallel Bulk Stat
+ * ==================
+ *
+ * Walking the inode btree is cheap, it's loading and formatting the inodes that
+ * makes bulkstat of a large filesystem slow.  For requests big enough to be
+ * worth it we walk the inobt in the calling thread to collect a batch of
+ * allocated inode numbers, stat them in chunks on a pwork queue, and report the
+ * results to the formatter in inode order once the batch is done.  The caller
+ * gets the same records and the same cursor as from the serial walk.
+ */
+
+/* Requests for fewer inodes get done by the calling thread alone. */
+#define XFS_BULKSTAT_PAR_MIN	256
+
+/* Inodes collected per batch, and inodes stat'ed per work item. */
+#define XFS_BULKSTAT_PAR_BATCH	1024
+#define XFS_BULKSTAT_PAR_CHUNK	XFS_INODES_PER_CHUNK
+
+struct xfs_bstat_batch {
+	struct xfs_ibulk	*breq;
+	xfs_ino_t		*inos;
+	struct xfs_bulkstat	*bufs;
+	int			*errors;
+	unsigned int		nr;
+	unsigned int		max;
+};
+
+struct xfs_bstat_work {
+	struct xfs_pwork	pwork;
+	struct xfs_bstat_batch	*batch;
+	unsigned int		first;
+	unsigned int		nr;
+};
+
+/* Collect the inode numbers of a batch. */
+static int
+xfs_bulkstat_par_collect(
+	struct xfs_mount	*mp,
+	struct xfs_trans	*tp,
+	xfs_ino_t		ino,
+	void			*data)
+{
+	struct xfs_bstat_batch	*batch = data;
+
+	batch->inos[batch->nr++] = ino;
+	return batch->nr == batch->max ? -ECANCELED : 0;
+}
+
+/* Stat a chunk of a batch, the errors are reported per inode. */
+static int
+xfs_bulkstat_par_work(
+	struct xfs_mount	*mp,
+	struct xfs_pwork	*pwork)
+{
+	struct xfs_bstat_work	*bw;
+	struct xfs_bstat_batch	*batch;
+	struct xfs_trans	*tp;
+	unsigned int		i;
+	int			error;
+
+	bw = container_of(pwork, struct xfs_bstat_work, pwork);
+	batch = bw->batch;
+
+	/*
+	 * Grab an empty transaction so that we can use its recursive buffer
+	 * locking abilities to detect cycles in the inobt without deadlocking.
+	 */
+	error = xfs_trans_alloc_empty(mp, &tp);
+	for (i = bw->first; i < bw->first + bw->nr; i++) {
+		if (error) {
+			batch->errors[i] = error;
+			continue;
+		}
+		memset(&batch->bufs[i], 0, sizeof(struct xfs_bulkstat));
+		batch->errors[i] = xfs_bulkstat_fill(mp, batch->breq->mnt_userns,
+				tp, batch->inos[i], batch->breq->flags,
+				&batch->bufs[i]);
+	}
+	if (!error)
+		xfs_trans_cancel(tp);
+	return 0;
+}
+
+/*
+ * Hand a batch to the formatter in inode order, moving the cursor the same way
+ * xfs_bulkstat_one_int does.
+ */
+static int
+xfs_bulkstat_par_report(
+	struct xfs_bstat_batch	*batch,
+	bulkstat_one_fmt_pf	formatter)
+{
+	struct xfs_ibulk	*breq = batch->breq;
+	unsigned int		i;
+	int			error;
+
+	for (i = 0; i < batch->nr; i++) {
+		error = batch->errors[i];
+		if (error == -ENOENT || error == -EINVAL) {
+			breq->startino = batch->inos[i] + 1;
+			continue;
+		}
+		if (error)
+			return error;
+
+		error = formatter(breq, &batch->bufs[i]);
+		if (error && error != -ECANCELED)
+			return error;
+		breq->startino = batch->inos[i] + 1;
+		if (error)
+			return error;
+	}
+	return 0;
+}
+
+static int
+xfs_bulkstat_parallel(
+	struct xfs_ibulk	*breq,
+	struct xfs_trans	*tp,
+	unsigned int		iwalk_flags,
+	bulkstat_one_fmt_pf	formatter)
+{
+	struct xfs_mount	*mp = breq->mp;
+	xfs_agnumber_t		agno = XFS_INO_TO_AGNO(mp, breq->startino);
+	struct xfs_bstat_batch	batch = {
+		.breq		= breq,
+	};
+	struct xfs_bstat_work	*works;
+	struct xfs_pwork_ctl	pctl;
+	unsigned int		i;
+	int			walk_error;
+	int			error = -ENOMEM;
+
+	batch.inos = kvcalloc(XFS_BULKSTAT_PAR_BATCH, sizeof(xfs_ino_t),
+			GFP_KERNEL);
+	batch.bufs = kvcalloc(XFS_BULKSTAT_PAR_BATCH,
+			sizeof(struct xfs_bulkstat), GFP_KERNEL);
+	batch.errors = kvcalloc(XFS_BULKSTAT_PAR_BATCH, sizeof(int),
+			GFP_KERNEL);
+	works = kcalloc(XFS_BULKSTAT_PAR_BATCH / XFS_BULKSTAT_PAR_CHUNK,
+			sizeof(struct xfs_bstat_work), GFP_KERNEL);
+	if (!batch.inos || !batch.bufs || !batch.errors || !works)
+		goto out_free;
+
+	error = xfs_pwork_init(mp, &pctl, xfs_bulkstat_par_work,
+			"xfs_bulkstat");
+	if (error)
+		goto out_free;
+
+	for (;;) {
+		batch.nr = 0;
+		batch.max = min_t(unsigned int, XFS_BULKSTAT_PAR_BATCH,
+				breq->icount - breq->ocount);
+		walk_error = xfs_iwalk(mp, tp, breq->startino, iwalk_flags,
+				xfs_bulkstat_par_collect, batch.max, &batch);
+
+		for (i = 0; i < batch.nr; i += XFS_BULKSTAT_PAR_CHUNK) {
+			struct xfs_bstat_work	*bw;
+
+			bw = &works[i / XFS_BULKSTAT_PAR_CHUNK];
+			bw->batch = &batch;
+			bw->first = i;
+			bw->nr = min_t(unsigned int, XFS_BULKSTAT_PAR_CHUNK,
+					batch.nr - i);
+			xfs_pwork_queue(&pctl, &bw->pwork);
+		}
+		xfs_pwork_poll(&pctl);
+
+		error = xfs_bulkstat_par_report(&batch, formatter);
+		if (error)
+			break;
+
+		/* the walk hit the end of the filesystem or an error */
+		if (walk_error != -ECANCELED) {
+			error = walk_error;
+			break;
+		}
+		if (xfs_bulkstat_already_done(mp, breq->startino))
+			break;
+		if ((iwalk_flags & XFS_IWALK_SAME_AG) &&
+		    XFS_INO_TO_AGNO(mp, breq->startino) != agno)
+			break;
+	}
+
+	xfs_pwork_destroy(&pctl);
+out_free:
+	kfree(works);
+	kvfree(batch.errors);
+	kvfree(batch.bufs);
+	kvfree(batch.inos);
+	return error;
+}
+
 /* Return stat information in bulk (by-inode) for the filesystem. */
 int
 xfs_bulkstat(
@@ -294,8 +511,11 @@ xfs_bulkstat(
 	if (breq->flags & XFS_IBULK_SAME_AG)
 		iwalk_flags |= XFS_IWALK_SAME_AG;
 
-	error = xfs_iwalk(breq->mp, tp, breq->startino, iwalk_flags,
-			xfs_bulkstat_iwalk, breq->icount, &bc);
+	if (breq->icount >= XFS_BULKSTAT_PAR_MIN && num_online_cpus() > 1)
+		error = xfs_bulkstat_parallel(breq, tp, iwalk_flags, formatter);
+	else
+		error = xfs_iwalk(breq->mp, tp, breq->startino, iwalk_flags,
+				xfs_bulkstat_iwalk, breq->icount, &bc);
 	xfs_trans_cancel(tp);
 out:
 	kmem_free(bc.buf);
@@ -205,6 +205,133 @@ xlog_grant_head_init(
 	spin_lock_init(&head->lock);
 }
 
+/*
+ * Every CPU may cache up to two batches of grant space, and all the caches
+ * together must not hold more than a sixteenth of the log, so that they don't
+ * change when the AIL gets pushed by much. Reservations larger than a batch
+ * always go to the grant heads, so there's no point in caching space on logs
+ * too small for a batch to hold a couple of typical transactions.
+ */
+#define XLOG_GRANT_BATCH_MIN	(256 * 1024)
+#define XLOG_GRANT_BATCH_MAX	(4 * 1024 * 1024)
+
+static void
+xlog_grant_pcp_init(
+	struct xlog		*log)
+{
+	int			batch;
+	int			cpu;
+
+	batch = (log->l_logsize >> 5) / num_online_cpus();
+	if (batch < XLOG_GRANT_BATCH_MIN)
+		return;
+
+	log->l_grant_pcp = alloc_percpu(struct xlog_grant_pcp);
+	if (!log->l_grant_pcp)
+		return;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(log->l_grant_pcp, cpu)->lock);
+	log->l_grant_batch = min(batch, XLOG_GRANT_BATCH_MAX);
+}
+
+/*
+ * Hand out @bytes from the grant space cached on this CPU, refilling the cache
+ * with a batch from the grant heads if it runs short. Returns false if the
+ * reservation has to go through the grant heads, which it always does once
+ * someone is waiting for log space so that the waiters go first.
+ */
+static bool
+xlog_grant_pcp_get(
+	struct xlog		*log,
+	int			bytes)
+{
+	struct xlog_grant_pcp	*gp;
+	bool			ret = true;
+
+	if (bytes > log->l_grant_batch)
+		return false;
+	if (!list_empty_careful(&log->l_reserve_head.waiters) ||
+	    !list_empty_careful(&log->l_write_head.waiters))
+		return false;
+
+	gp = raw_cpu_ptr(log->l_grant_pcp);
+	spin_lock(&gp->lock);
+	if (gp->bytes < bytes) {
+		if (xlog_space_left(log, &log->l_reserve_head.grant) <
+		    log->l_grant_batch) {
+			ret = false;
+			goto out_unlock;
+		}
+		xlog_grant_add_space(log, &log->l_reserve_head.grant,
+				     log->l_grant_batch);
+		xlog_grant_add_space(log, &log->l_write_head.grant,
+				     log->l_grant_batch);
+		gp->bytes += log->l_grant_batch;
+	}
+	gp->bytes -= bytes;
+out_unlock:
+	spin_unlock(&gp->lock);
+	return ret;
+}
+
+/*
+ * Stash the @bytes released by a ticket in this CPU's cache rather than giving
+ * them back to the grant heads, unless the cache is full or someone waits.
+ */
+static bool
+xlog_grant_pcp_put(
+	struct xlog		*log,
+	int			bytes)
+{
+	struct xlog_grant_pcp	*gp;
+	bool			ret = false;
+
+	if (!log->l_grant_batch)
+		return false;
+	if (!list_empty_careful(&log->l_reserve_head.waiters) ||
+	    !list_empty_careful(&log->l_write_head.waiters))
+		return false;
+
+	gp = raw_cpu_ptr(log->l_grant_pcp);
+	spin_lock(&gp->lock);
+	if (gp->bytes + bytes <= 2 * log->l_grant_batch) {
+		gp->bytes += bytes;
+		ret = true;
+	}
+	spin_unlock(&gp->lock);
+	return ret;
+}
+
+/*
+ * Give the space cached on all CPUs back to the grant heads. Called before
+ * anyone goes to sleep on the grant heads, and whenever the grant heads have to
+ * match the space actually used by the tickets out there.
+ */
+static void
+xlog_grant_pcp_drain(
+	struct xlog		*log)
+{
+	struct xlog_grant_pcp	*gp;
+	int			bytes = 0;
+	int			cpu;
+
+	if (!log->l_grant_batch)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		gp = per_cpu_ptr(log->l_grant_pcp, cpu);
+		spin_lock(&gp->lock);
+		bytes += gp->bytes;
+		gp->bytes = 0;
+		spin_unlock(&gp->lock);
+	}
+	if (!bytes)
+		return;
+
+	xlog_grant_sub_space(log, &log->l_reserve_head.grant, bytes);
+	xlog_grant_sub_space(log, &log->l_write_head.grant, bytes);
+}
+
 STATIC void
 xlog_grant_head_wake_all(
 	struct xlog_grant_head	*head)
@@ -356,6 +483,12 @@ xlog_grant_head_check(
 	 */
 	*need_bytes = xlog_ticket_reservation(log, head, tic);
 	free_bytes = xlog_space_left(log, &head->grant);
+	if (log->l_grant_batch &&
+	    (free_bytes < *need_bytes || !list_empty_careful(&head->waiters))) {
+		/* don't sleep for space sitting in the per-CPU caches */
+		xlog_grant_pcp_drain(log);
+		free_bytes = xlog_space_left(log, &head->grant);
+	}
 	if (!list_empty_careful(&head->waiters)) {
 		spin_lock(&head->lock);
 		if (!xlog_grant_head_wake(log, head, &free_bytes) ||
@@ -483,6 +616,10 @@ xfs_log_reserve(
 
 	trace_xfs_log_reserve(log, tic);
 
+	need_bytes = xlog_ticket_reservation(log, &log->l_reserve_head, tic);
+	if (xlog_grant_pcp_get(log, need_bytes))
+		goto out_granted;
+
 	error = xlog_grant_head_check(log, &log->l_reserve_head, tic,
 				      &need_bytes);
 	if (error)
@@ -490,6 +627,7 @@ xfs_log_reserve(
 
 	xlog_grant_add_space(log, &log->l_reserve_head.grant, need_bytes);
 	xlog_grant_add_space(log, &log->l_write_head.grant, need_bytes);
+out_granted:
 	trace_xfs_log_reserve_exit(log, tic);
 	xlog_verify_grant_tail(log);
 	return 0;
@@ -1106,6 +1244,9 @@ xfs_log_quiesce(
 	xfs_buf_lock(mp->m_sb_bp);
 	xfs_buf_unlock(mp->m_sb_bp);
 
+	/* the log is idle, let the grant heads account for all of it again */
+	xlog_grant_pcp_drain(mp->m_log);
+
 	return xfs_log_cover(mp);
 }
 
@@ -1687,6 +1828,8 @@ xlog_alloc_log(
 	error = xlog_cil_init(log);
 	if (error)
 		goto out_destroy_workqueue;
+
+	xlog_grant_pcp_init(log);
 	return log;
 
 out_destroy_workqueue:
@@ -2157,6 +2300,7 @@ xlog_dealloc_log(
 
 	log->l_mp->m_log = NULL;
 	destroy_workqueue(log->l_ioend_workqueue);
+	free_percpu(log->l_grant_pcp);
 	kmem_free(log);
 }
 
@@ -3095,8 +3239,10 @@ xfs_log_ticket_ungrant(
 		bytes += ticket->t_unit_res*ticket->t_cnt;
 	}
 
-	xlog_grant_sub_space(log, &log->l_reserve_head.grant, bytes);
-	xlog_grant_sub_space(log, &log->l_write_head.grant, bytes);
+	if (!xlog_grant_pcp_put(log, bytes)) {
+		xlog_grant_sub_space(log, &log->l_reserve_head.grant, bytes);
+		xlog_grant_sub_space(log, &log->l_write_head.grant, bytes);
+	}
 
 	trace_xfs_log_ticket_ungrant_exit(log, ticket);
 
@@ -386,6 +386,18 @@ struct xlog_grant_head {
 	atomic64_t		grant;
 };
 
+/*
+ * Log space taken ahead from both the reserve and the write grant heads and
+ * cached on a CPU, so that small reservations made on that CPU don't have to
+ * bounce the global grant head cachelines between CPUs. The lock, not
+ * disabled preemption, protects the cache: a task migrating after picking
+ * it only makes it use another CPU's cache.
+ */
+struct xlog_grant_pcp {
+	spinlock_t		lock;
+	int			bytes;
+};
+
 /*
  * The reservation head lsn is not made up of a cycle number and block number.
  * Instead, it uses a cycle number and byte number.  Logs don't expect to
@@ -439,6 +451,10 @@ struct xlog {
 	struct xlog_grant_head	l_reserve_head;
 	struct xlog_grant_head	l_write_head;
 
+	/* per-CPU grant caches, disabled if l_grant_batch is zero */
+	struct xlog_grant_pcp __percpu *l_grant_pcp;
+	int			l_grant_batch;
+
 	struct xfs_kobj		l_kobj;
 
 	/* log recovery lsn tracking (for buffer submission */
@@ -1067,7 +1067,14 @@ static ssize_t zonefs_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	}
 
 	/* Limit read operations to written data */
-	mutex_lock(&zi->i_truncate_mutex);
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		if (!mutex_trylock(&zi->i_truncate_mutex)) {
+			ret = -EAGAIN;
+			goto inode_unlock;
+		}
+	} else {
+		mutex_lock(&zi->i_truncate_mutex);
+	}
 	isize = i_size_read(inode);
 	if (iocb->ki_pos >= isize) {
 		mutex_unlock(&zi->i_truncate_mutex);
@@ -1164,6 +1171,8 @@ static int zonefs_file_open(struct inode *inode, struct file *file)
 	if (ret)
 		return ret;
 
+	file->f_mode |= FMODE_BUF_RASYNC;
+
 	if (zonefs_seq_file_need_wro(inode, file))
 		return zonefs_seq_file_write_open(inode);
 
@@ -173,6 +173,14 @@ struct shash_desc {
  * @update: see struct ahash_alg
  * @final: see struct ahash_alg
  * @finup: see struct ahash_alg
+ * @finup_mb: **[optional]** Multi-buffer hashing support.  Finish calculating
+ *	      the digests of multiple messages, interleaving the instructions to
+ *	      potentially achieve better performance than hashing each message
+ *	      individually.  The messages all start from the state in
+ *	      @desc, are @len bytes each, and their digests go to @outs.
+ *	      @num_msgs is at least 2 and at most @mb_max_msgs.  The descriptor
+ *	      state is undefined afterwards.  May return -EOPNOTSUPP to make
+ *	      the caller fall back to hashing the messages one by one.
  * @digest: see struct ahash_alg
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
@@ -193,6 +201,8 @@ struct shash_desc {
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
+ * @mb_max_msgs: Maximum supported value of num_msgs in @finup_mb, or 1 if
+ *		 @finup_mb is not implemented.
  * @base: internally used
  */
 struct shash_alg {
@@ -202,6 +212,9 @@ struct shash_alg {
 	int (*final)(struct shash_desc *desc, u8 *out);
 	int (*finup)(struct shash_desc *desc, const u8 *data,
 		     unsigned int len, u8 *out);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 	int (*digest)(struct shash_desc *desc, const u8 *data,
 		      unsigned int len, u8 *out);
 	int (*export)(struct shash_desc *desc, void *out);
@@ -212,6 +225,7 @@ struct shash_alg {
 	void (*exit_tfm)(struct crypto_shash *tfm);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	/* These fields must match hash_alg_common. */
 	unsigned int digestsize
@@ -830,6 +844,20 @@ static inline unsigned int crypto_shash_descsize(struct crypto_shash *tfm)
 	return tfm->descsize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - get max number of messages for multi-buffer
+ * @tfm: cipher handle
+ *
+ * Return: the maximum number of messages that crypto_shash_finup_mb() hashes
+ *	   in an interleaved fashion, or 1 if the algorithm has no
+ *	   multi-buffer support.  Larger batches are still accepted but gain
+ *	   nothing.
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline void *shash_desc_ctx(struct shash_desc *desc)
 {
 	return desc->__ctx;
@@ -998,6 +1026,29 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - finish hashing multiple messages
+ * @desc: the starting state that is common to all the messages
+ * @data: the data of each message (not including any prefix from @desc)
+ * @len: length of each data buffer in bytes
+ * @outs: output buffer for each message digest
+ * @num_msgs: number of messages
+ *
+ * Finish hashing @num_msgs equal-length messages that share the prefix
+ * already absorbed into @desc, e.g. a salt.  Algorithms that support it
+ * interleave the messages to make better use of the CPU; otherwise, or
+ * when @num_msgs exceeds crypto_shash_mb_max_msgs(), the messages are
+ * hashed one after another.
+ *
+ * The state in @desc is undefined on return.
+ *
+ * Context: Any context.
+ * Return: 0 on success; a negative errno value on failure.
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
@@ -80,6 +80,15 @@ struct wb_completion {
 #define DEFINE_WB_COMPLETION(cmpl, bdi)	\
 	struct wb_completion cmpl = WB_COMPLETION_INIT(bdi)
 
+/* Upper limit of backing_dev_info->max_flushers */
+#define WB_MAX_FLUSHERS		8
+
+/* Extra background flusher of a wb, see wb_kick_flushers() */
+struct wb_flusher {
+	struct work_struct work;
+	struct bdi_writeback *wb;
+};
+
 /*
  * Each wb (bdi_writeback) can perform writeback operations, is measured
  * and throttled, independently.  Without cgroup writeback, each bdi
@@ -140,6 +149,7 @@ struct bdi_writeback {
 	struct list_head work_list;
 	struct delayed_work dwork;	/* work item used for writeback */
 	struct delayed_work bw_dwork;	/* work item used for bandwidth estimate */
+	struct wb_flusher flushers[WB_MAX_FLUSHERS - 1];
 
 	unsigned long dirty_sleep;	/* last wait */
 
@@ -174,6 +184,10 @@ struct backing_dev_info {
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
 
+	/* background flushers per wb, and extra ones currently running */
+	unsigned int max_flushers;
+	atomic_t nr_flushers;
+
 	/*
 	 * Sum of avg_write_bw of wbs with dirty inodes.  > 0 if there are
 	 * any dirty wbs, which is depended upon by bdi_has_dirty().
@@ -130,5 +130,8 @@ extern ssize_t read_code(struct file *, unsigned long, loff_t, size_t);
 
 int kernel_execve(const char *filename,
 		  const char *const *argv, const char *const *envp);
+int spawn_execveat(int fd, const char __user *filename,
+		   const void __user *argv, const void __user *envp,
+		   int flags, bool compat);
 
 #endif /* _LINUX_BINFMTS_H */
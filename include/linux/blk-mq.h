@@ -748,6 +748,10 @@ struct blk_mq_tags {
 	struct sbitmap_queue bitmap_tags;
 	struct sbitmap_queue breserved_tags;
 
+	/* per-cpu caches of free bitmap_tags, shared tag sets only */
+	struct blk_mq_tag_cache __percpu *cache;
+	unsigned int cache_size;
+
 	struct request **rqs;
 	struct request **static_rqs;
 	struct list_head page_list;
@@ -468,6 +468,9 @@ struct request_queue {
 
 	unsigned int		rq_timeout;
 	int			poll_nsec;
+	/* adaptive hybrid polling state, see blk_stat_poll_nsecs() */
+	unsigned short		poll_sleep[BLK_MQ_POLL_STATS_BKTS];
+	unsigned int		poll_wake_nsec;
 
 	struct blk_stat_callback	*poll_cb;
 	struct blk_rq_stat	*poll_stat;
@@ -1421,6 +1424,8 @@ extern int bdev_read_page(struct block_device *, sector_t, struct page *);
 extern int bdev_write_page(struct block_device *, sector_t, struct page *,
 						struct writeback_control *);
 
+void __blk_wake_io_task(struct task_struct *waiter);
+
 static inline void blk_wake_io_task(struct task_struct *waiter)
 {
 	/*
@@ -1431,7 +1436,7 @@ static inline void blk_wake_io_task(struct task_struct *waiter)
 	if (waiter == current)
 		__set_current_state(TASK_RUNNING);
 	else
-		wake_up_process(waiter);
+		__blk_wake_io_task(waiter);
 }
 
 unsigned long bdev_start_io_acct(struct block_device *bdev,
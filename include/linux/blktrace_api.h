@@ -107,6 +107,7 @@ struct compat_blk_user_trace_setup {
 #endif
 
 void blk_fill_rwbs(char *rwbs, blk_opf_t opf);
+u64 blk_rq_trace_cgroup_id(struct request *rq);
 
 static inline sector_t blk_rq_trace_sector(struct request *rq)
 {
@@ -973,6 +973,14 @@ int arch_prepare_bpf_trampoline(struct bpf_tramp_image *tr, void *image, void *i
 				const struct btf_func_model *m, u32 flags,
 				struct bpf_tramp_links *tlinks,
 				void *orig_call);
+/* Size of the image arch_prepare_bpf_trampoline() needs for these
+ * arguments, and the allocator the image comes from.
+ */
+int arch_bpf_trampoline_size(const struct btf_func_model *m, u32 flags,
+			     struct bpf_tramp_links *tlinks, void *orig_call);
+void *arch_alloc_bpf_trampoline(unsigned int size);
+void arch_free_bpf_trampoline(void *image, unsigned int size);
+void arch_protect_bpf_trampoline(void *image, unsigned int size);
 u64 notrace __bpf_prog_enter_sleepable_recur(struct bpf_prog *prog,
 					     struct bpf_tramp_run_ctx *run_ctx);
 void notrace __bpf_prog_exit_sleepable_recur(struct bpf_prog *prog, u64 start,
@@ -1005,6 +1013,7 @@ enum bpf_tramp_prog_type {
 
 struct bpf_tramp_image {
 	void *image;
+	int size;
 	struct bpf_ksym ksym;
 	struct percpu_ref pcref;
 	void *ip_after_call;
@@ -1156,7 +1165,7 @@ int arch_prepare_bpf_dispatcher(void *image, void *buf, s64 *funcs, int num_func
 void bpf_dispatcher_change_prog(struct bpf_dispatcher *d, struct bpf_prog *from,
 				struct bpf_prog *to);
 /* Called only from JIT-enabled code, so there's no need for stubs. */
-void bpf_image_ksym_add(void *data, struct bpf_ksym *ksym);
+void bpf_image_ksym_add(void *data, unsigned int size, struct bpf_ksym *ksym);
 void bpf_image_ksym_del(struct bpf_ksym *ksym);
 void bpf_ksym_add(struct bpf_ksym *ksym);
 void bpf_ksym_del(struct bpf_ksym *ksym);
@@ -1976,8 +1985,31 @@ struct bpf_iter_aux_info {
 		enum bpf_iter_task_type	type;
 		u32 pid;
 	} task;
+
+	/* for map_elem and task iter, zero nr_shards means not sharded */
+	u32 shard;
+	u32 nr_shards;
 };
 
+int bpf_iter_shard_check(struct bpf_iter_aux_info *aux, u32 shard,
+			 u32 nr_shards);
+
+/* The [*start, *end) slice of @n buckets or indexes covered by the shard
+ * of @aux
+ */
+static inline void bpf_iter_shard_range(const struct bpf_iter_aux_info *aux,
+					u32 n, u32 *start, u32 *end)
+{
+	if (!aux->nr_shards) {
+		*start = 0;
+		*end = n;
+		return;
+	}
+
+	*start = div_u64((u64)n * aux->shard, aux->nr_shards);
+	*end = div_u64((u64)n * (aux->shard + 1), aux->nr_shards);
+}
+
 typedef int (*bpf_iter_attach_target_t)(struct bpf_prog *prog,
 					union bpf_iter_link_info *linfo,
 					struct bpf_iter_aux_info *aux);
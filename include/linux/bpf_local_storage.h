@@ -81,8 +81,22 @@ struct bpf_local_storage_elem {
 	struct bpf_local_storage_data sdata ____cacheline_aligned;
 };
 
+/* The sdata of every map the owner has storage in, in an open
+ * addressing table keyed by the map.  It is sized from the number of
+ * elems of this owner and is replaced by a rebuilt copy under
+ * local_storage->lock before it gets too full.
+ */
+struct bpf_local_storage_slots {
+	struct rcu_head rcu;
+	u32 bits;
+	u32 used;	/* Non-NULL slots, including unlinked ones */
+	bool overflow;	/* An elem did not fit, lookups walk the list */
+	struct bpf_local_storage_data __rcu *data[];
+};
+
 struct bpf_local_storage {
 	struct bpf_local_storage_data __rcu *cache[BPF_LOCAL_STORAGE_CACHE_SIZE];
+	struct bpf_local_storage_slots __rcu *slots;
 	struct hlist_head list; /* List of bpf_local_storage_elem */
 	void *owner;		/* The object that owns the above "list" of
 				 * bpf_local_storage_elem.
@@ -139,6 +153,11 @@ int bpf_local_storage_map_check_btf(const struct bpf_map *map,
 				    const struct btf_type *key_type,
 				    const struct btf_type *value_type);
 
+int bpf_local_storage_slot_prepare(void *owner,
+				   struct bpf_local_storage *local_storage,
+				   struct bpf_local_storage_map *smap,
+				   gfp_t gfp_flags);
+
 void bpf_selem_link_storage_nolock(struct bpf_local_storage *local_storage,
 				   struct bpf_local_storage_elem *selem);
 
@@ -165,4 +184,7 @@ bpf_local_storage_update(void *owner, struct bpf_local_storage_map *smap,
 
 void bpf_local_storage_free_rcu(struct rcu_head *rcu);
 
+void bpf_local_storage_free(struct bpf_local_storage *local_storage,
+			    bool use_trace_rcu);
+
 #endif /* _BPF_LOCAL_STORAGE_H */
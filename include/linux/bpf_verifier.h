@@ -566,6 +566,13 @@ struct bpf_verifier_env {
 	u32 peak_states;
 	/* longest register parentage chain walked for liveness marking */
 	u32 longest_mark_read_walk;
+	/* number of explored states compared against the current one,
+	 * and how many of those comparisons pruned the search
+	 */
+	u32 states_compared;
+	u32 states_pruned;
+	/* time spent looking for equivalent states, BPF_LOG_STATS only */
+	u64 prune_time;
 	bpfptr_t fd_array;
 
 	/* bit mask to keep track of whether a register has been accessed
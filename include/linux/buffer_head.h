@@ -170,7 +170,9 @@ static __always_inline int buffer_uptodate(const struct buffer_head *bh)
 	return test_bit_acquire(BH_Uptodate, &bh->b_state);
 }
 
-#define bh_offset(bh)		((unsigned long)(bh)->b_data & ~PAGE_MASK)
+/* Offset of the buffer in its folio, b_page is the head of a large folio */
+#define bh_offset(bh)		((unsigned long)(bh)->b_data &		\
+				 (page_size((bh)->b_page) - 1))
 
 /* If we *know* page->private refers to buffer_heads */
 #define page_buffers(page)					\
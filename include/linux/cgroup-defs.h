@@ -10,6 +10,7 @@
 
 #include <linux/limits.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/idr.h>
 #include <linux/wait.h>
 #include <linux/mutex.h>
@@ -191,8 +192,8 @@ struct cgroup_subsys_state {
 	 */
 	atomic_t online_cnt;
 
-	/* percpu_ref killing and RCU release */
-	struct work_struct destroy_work;
+	/* percpu_ref killing and RCU release, see css_destroy_batch */
+	struct llist_node destroy_llnode;
 	struct rcu_work destroy_rwork;
 
 	/*
@@ -18,6 +18,7 @@
 struct path;
 struct file;
 struct vfsmount;
+struct seq_file;
 
 /*
  * linux/include/linux/dcache.h
@@ -243,6 +244,7 @@ extern struct dentry * d_obtain_root(struct inode *);
 extern void shrink_dcache_sb(struct super_block *);
 extern void shrink_dcache_parent(struct dentry *);
 extern void shrink_dcache_for_umount(struct super_block *);
+extern void dcache_show_stats(struct seq_file *, struct super_block *);
 extern void d_invalidate(struct dentry *);
 
 /* only used at mount-time */
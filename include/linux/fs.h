@@ -31,6 +31,7 @@
 #include <linux/uidgid.h>
 #include <linux/lockdep.h>
 #include <linux/percpu-rwsem.h>
+#include <linux/percpu_counter.h>
 #include <linux/workqueue.h>
 #include <linux/delayed_call.h>
 #include <linux/uuid.h>
@@ -905,6 +906,12 @@ struct fown_struct {
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * Cache misses remembered for stride detection, enough for a few
+ * interleaved strided streams on the same file.
+ */
+#define RA_STRIDE_HISTORY	8
+
 /**
  * struct file_ra_state - Track a file's readahead state.
  * @start: Where the most recent readahead started.
@@ -915,6 +922,10 @@ struct fown_struct {
  * @ra_pages: Maximum size of a readahead request, copied from the bdi.
  * @mmap_miss: How many mmap accesses missed in the page cache.
  * @prev_pos: The last byte in the most recent read request.
+ * @stride_hist: Indices of recent cache misses, used to detect strided reads.
+ * @stride_next: Next slot of @stride_hist to overwrite.
+ * @nr_hits: Number of reads that hit an async readahead marker.
+ * @nr_misses: Number of reads that missed in the page cache.
  *
  * When this structure is passed to ->readahead(), the "most recent"
  * readahead means the current readahead.
@@ -926,6 +937,10 @@ struct file_ra_state {
 	unsigned int ra_pages;
 	unsigned int mmap_miss;
 	loff_t prev_pos;
+	pgoff_t stride_hist[RA_STRIDE_HISTORY];
+	unsigned int stride_next;
+	unsigned long nr_hits;
+	unsigned long nr_misses;
 };
 
 /*
@@ -1586,6 +1601,12 @@ struct super_block {
 	 */
 	struct list_lru		s_dentry_lru;
 	struct list_lru		s_inode_lru;
+
+	/* unused negative dentries on s_dentry_lru, see fs.negative-dentry-limit */
+	struct percpu_counter	s_nr_dentry_negative;
+	unsigned long		s_dentry_negative_pruned;
+	struct work_struct	s_dentry_negative_work;
+
 	struct rcu_head		rcu;
 	struct work_struct	destroy_work;
 
@@ -3171,6 +3192,8 @@ extern ssize_t generic_splice_sendpage(struct pipe_inode_info *pipe,
 		struct file *out, loff_t *, size_t len, unsigned int flags);
 extern long do_splice_direct(struct file *in, loff_t *ppos, struct file *out,
 		loff_t *opos, size_t len, unsigned int flags);
+extern long do_splice_direct_stream(struct file *in, struct file *out,
+		loff_t *opos, size_t len, unsigned int flags);
 
 
 extern void
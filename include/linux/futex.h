@@ -16,8 +16,9 @@ struct task_struct;
  * The key type depends on whether it's a shared or private mapping.
  * Don't rearrange members without looking at hash_futex().
  *
- * offset is aligned to a multiple of sizeof(u32) (== 4) by definition.
- * We use the two low order bits of offset to tell what is the kind of key :
+ * offset holds the offset of the futex within its page, shifted left by
+ * FUT_OFF_SHIFT: futexes may be as small as a byte, and we use the two low
+ * order bits of offset to tell what is the kind of key :
  *  00 : Private process futex (PTHREAD_PROCESS_PRIVATE)
  *       (no reference on an inode or mm)
  *  01 : Shared futex (PTHREAD_PROCESS_SHARED)
@@ -28,12 +29,19 @@ struct task_struct;
 
 #define FUT_OFF_INODE    1 /* We set bit 0 if key has a reference on inode */
 #define FUT_OFF_MMSHARED 2 /* We set bit 1 if key has a reference on mm */
+#define FUT_OFF_SHIFT    2
+
+/*
+ * node is the NUMA node hint of a FUTEX2_NUMA futex plus one, 0 if there is
+ * none. It selects the hash table, and is not part of the match.
+ */
 
 union futex_key {
 	struct {
 		u64 i_seq;
 		unsigned long pgoff;
 		unsigned int offset;
+		unsigned int node;
 	} shared;
 	struct {
 		union {
@@ -42,11 +50,13 @@ union futex_key {
 		};
 		unsigned long address;
 		unsigned int offset;
+		unsigned int node;
 	} private;
 	struct {
 		u64 ptr;
 		unsigned long word;
 		unsigned int offset;
+		unsigned int node;
 	} both;
 };
 
@@ -75,6 +85,10 @@ void futex_exit_recursive(struct task_struct *tsk);
 void futex_exit_release(struct task_struct *tsk);
 void futex_exec_release(struct task_struct *tsk);
 
+void futex_mm_init(struct mm_struct *mm);
+void futex_private_hash_alloc(struct mm_struct *mm);
+void futex_private_hash_free(struct mm_struct *mm);
+
 long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	      u32 __user *uaddr2, u32 val2, u32 val3);
 #else
@@ -82,6 +96,9 @@ static inline void futex_init_task(struct task_struct *tsk) { }
 static inline void futex_exit_recursive(struct task_struct *tsk) { }
 static inline void futex_exit_release(struct task_struct *tsk) { }
 static inline void futex_exec_release(struct task_struct *tsk) { }
+static inline void futex_mm_init(struct mm_struct *mm) { }
+static inline void futex_private_hash_alloc(struct mm_struct *mm) { }
+static inline void futex_private_hash_free(struct mm_struct *mm) { }
 static inline long do_futex(u32 __user *uaddr, int op, u32 val,
 			    ktime_t *timeout, u32 __user *uaddr2,
 			    u32 val2, u32 val3)
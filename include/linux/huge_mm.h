@@ -101,6 +101,28 @@ ssize_t single_hugepage_flag_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf,
 				  enum transparent_hugepage_flag flag);
 extern struct kobj_attribute shmem_enabled_attr;
+extern struct kobj_attribute thpsize_shmem_enabled_attr;
+
+/* A hugepages-<size>kB directory of the transparent_hugepage sysfs tree */
+struct thpsize {
+	struct kobject kobj;
+	struct list_head node;
+	int order;
+};
+
+#define to_thpsize(kobj) container_of(kobj, struct thpsize, kobj)
+
+static inline int highest_order(unsigned long orders)
+{
+	return fls_long(orders) - 1;
+}
+
+static inline int next_order(unsigned long *orders, int prev)
+{
+	*orders &= ~BIT(prev);
+	return highest_order(*orders);
+}
+
 
 #define HPAGE_PMD_ORDER (HPAGE_PMD_SHIFT-PAGE_SHIFT)
 #define HPAGE_PMD_NR (1<<HPAGE_PMD_ORDER)
@@ -171,6 +193,20 @@ static inline bool file_thp_enabled(struct vm_area_struct *vma)
 bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 			bool smaps, bool in_pf, bool enforce_sysfs);
 
+/*
+ * Orders below the PMD one that anonymous page faults can allocate, each
+ * enabled through its own hugepages-<size>kB directory. Order 1 is left
+ * out, such folios have no room for the deferred split list.
+ */
+#define THP_ORDERS_ANON_PTE						\
+	((BIT(min_t(int, HPAGE_PMD_ORDER, MAX_ORDER)) - 1) & ~(BIT(0) | BIT(1)))
+
+extern unsigned long huge_anon_orders_always;
+extern unsigned long huge_anon_orders_madvise;
+extern unsigned long huge_anon_orders_inherit;
+
+unsigned long thp_vma_anon_orders(struct vm_area_struct *vma);
+
 #define transparent_hugepage_use_zero_page()				\
 	(transparent_hugepage_flags &					\
 	 (1<<TRANSPARENT_HUGEPAGE_USE_ZERO_PAGE_FLAG))
@@ -329,6 +365,11 @@ static inline bool hugepage_vma_check(struct vm_area_struct *vma,
 	return false;
 }
 
+static inline unsigned long thp_vma_anon_orders(struct vm_area_struct *vma)
+{
+	return 0;
+}
+
 static inline void prep_transhuge_page(struct page *page) {}
 
 #define transparent_hugepage_flags 0UL
@@ -5,6 +5,7 @@
 #include <linux/task_work.h>
 #include <linux/bitmap.h>
 #include <linux/llist.h>
+#include <linux/hashtable.h>
 #include <uapi/linux/io_uring.h>
 
 struct io_wq_work_node {
@@ -29,8 +30,12 @@ struct io_fixed_file {
 };
 
 struct io_file_table {
-	struct io_fixed_file *files;
+	/* chunks of IO_FILE_TABLE_MAX slots, allocated on first use */
+	struct io_fixed_file **files;
 	unsigned long *bitmap;
+	/* chunks with every slot in use, skipped when allocating */
+	unsigned long *full_map;
+	unsigned int nr_files;
 	unsigned int alloc_hint;
 };
 
@@ -303,6 +308,9 @@ struct io_ring_ctx {
 		struct io_wq_work_list	iopoll_list;
 		struct io_hash_table	cancel_table;
 
+		/* uring_cmds to cancel, protected by ->uring_lock */
+		struct hlist_head	cancelable_uring_cmd;
+
 		struct llist_head	work_llist;
 
 		struct list_head	io_buffers_comp;
@@ -358,9 +366,25 @@ struct io_ring_ctx {
 	bool				iowq_limits_set;
 
 	struct list_head		defer_list;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	struct list_head	napi_list;	/* track busy poll napi_id */
+	spinlock_t		napi_lock;	/* napi_list lock */
+
+	DECLARE_HASHTABLE(napi_ht, 4);
+	/* napi busy poll default timeout, in usec */
+	unsigned int		napi_busy_poll_to;
+	bool			napi_prefer_busy_poll;
+#endif
+
 	unsigned			sq_thread_idle;
+	/* share of a shared SQPOLL thread, see IORING_REGISTER_SQ_WEIGHT */
+	unsigned			sq_weight;
 	/* protected by ->completion_lock */
 	unsigned			evfd_last_cq_tail;
+
+	/* see IORING_SETUP_LAT_STATS */
+	struct io_lat_stats		*lat_stats;
 };
 
 enum {
@@ -559,7 +583,10 @@ struct io_kiocb {
 	atomic_t			refs;
 	atomic_t			poll_refs;
 	struct io_task_work		io_task_work;
-	/* for polled requests, i.e. IORING_OP_POLL_ADD and async armed poll */
+	/*
+	 * for polled requests, i.e. IORING_OP_POLL_ADD and async armed poll,
+	 * and cancelable uring_cmds
+	 */
 	union {
 		struct hlist_node	hash_node;
 		struct {
@@ -575,6 +602,8 @@ struct io_kiocb {
 	struct io_kiocb			*link;
 	/* custom credentials, valid IFF REQ_F_CREDS is set */
 	const struct cred		*creds;
+	/* submission time, valid IFF IORING_SETUP_LAT_STATS is set */
+	u64				lat_stamp;
 	struct io_wq_work		work;
 };
 
@@ -234,6 +234,10 @@ extern void static_key_enable(struct static_key *key);
 extern void static_key_disable(struct static_key *key);
 extern void static_key_enable_cpuslocked(struct static_key *key);
 extern void static_key_disable_cpuslocked(struct static_key *key);
+extern void static_key_batch_begin(void);
+extern void static_key_batch_enable(struct static_key *key);
+extern void static_key_batch_disable(struct static_key *key);
+extern void static_key_batch_end(void);
 extern enum jump_label_type jump_label_init_type(struct jump_entry *entry);
 
 /*
@@ -339,6 +343,11 @@ static inline void static_key_disable(struct static_key *key)
 #define static_key_enable_cpuslocked(k)		static_key_enable((k))
 #define static_key_disable_cpuslocked(k)	static_key_disable((k))
 
+static inline void static_key_batch_begin(void) {}
+static inline void static_key_batch_end(void) {}
+#define static_key_batch_enable(k)		static_key_enable((k))
+#define static_key_batch_disable(k)		static_key_disable((k))
+
 #define STATIC_KEY_INIT_TRUE	{ .enabled = ATOMIC_INIT(1) }
 #define STATIC_KEY_INIT_FALSE	{ .enabled = ATOMIC_INIT(0) }
 
@@ -531,6 +540,8 @@ extern bool ____wrong_branch_error(void);
 #define static_branch_disable(x)		static_key_disable(&(x)->key)
 #define static_branch_enable_cpuslocked(x)	static_key_enable_cpuslocked(&(x)->key)
 #define static_branch_disable_cpuslocked(x)	static_key_disable_cpuslocked(&(x)->key)
+#define static_branch_batch_enable(x)		static_key_batch_enable(&(x)->key)
+#define static_branch_batch_disable(x)		static_key_batch_disable(&(x)->key)
 
 #endif /* __ASSEMBLY__ */
 
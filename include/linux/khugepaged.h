@@ -16,6 +16,7 @@ extern void khugepaged_enter_vma(struct vm_area_struct *vma,
 				 unsigned long vm_flags);
 extern void khugepaged_min_free_kbytes_update(void);
 extern bool current_is_khugepaged(void);
+extern void __khugepaged_hot(struct vm_area_struct *vma, unsigned long addr);
 #ifdef CONFIG_SHMEM
 extern int collapse_pte_mapped_thp(struct mm_struct *mm, unsigned long addr,
 				   bool install_pmd);
@@ -38,6 +39,17 @@ static inline void khugepaged_exit(struct mm_struct *mm)
 	if (test_bit(MMF_VM_HUGEPAGE, &mm->flags))
 		__khugepaged_exit(mm);
 }
+
+/*
+ * Report that the PMD range around @addr is being accessed heavily, so
+ * that khugepaged collapses it ahead of its periodic scan.
+ */
+static inline void khugepaged_hot(struct vm_area_struct *vma,
+				  unsigned long addr)
+{
+	if (test_bit(MMF_VM_HUGEPAGE, &vma->vm_mm->flags))
+		__khugepaged_hot(vma, addr);
+}
 #else /* CONFIG_TRANSPARENT_HUGEPAGE */
 static inline void khugepaged_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
@@ -49,6 +61,10 @@ static inline void khugepaged_enter_vma(struct vm_area_struct *vma,
 					unsigned long vm_flags)
 {
 }
+static inline void khugepaged_hot(struct vm_area_struct *vma,
+				  unsigned long addr)
+{
+}
 static inline int collapse_pte_mapped_thp(struct mm_struct *mm,
 					  unsigned long addr, bool install_pmd)
 {
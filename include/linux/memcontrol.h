@@ -224,8 +224,24 @@ struct mem_cgroup {
 	/* Range enforcement for interrupt charges */
 	struct work_struct high_work;
 
+	/* Proactive reclaim driven by "memory.reclaim.refault_target" */
+	struct delayed_work proactive_work;
+	/* refaults per 1000 reclaimed pages to aim for, 0 when disabled */
+	unsigned int refault_target;
+	/* refaults per 1000 reclaimed pages seen in the last period */
+	unsigned long refault_ratio;
+	/* pages to reclaim per period */
+	unsigned long proactive_step;
+	/* refaults as of the last period */
+	unsigned long proactive_refaults;
+	/* pages reclaimed by the last period that reclaimed */
+	unsigned long proactive_last_reclaimed;
+	atomic_long_t proactive_reclaimed;
+
 #if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
 	unsigned long zswap_max;
+	/* zswap pool of the compressor picked for this cgroup, if any */
+	struct zswap_pool __rcu *zswap_pool;
 #endif
 
 	unsigned long soft_limit;
@@ -323,6 +339,12 @@ struct mem_cgroup {
 #ifdef CONFIG_LRU_GEN
 	/* per-memcg mm_struct list */
 	struct lru_gen_mm_list mm_list;
+
+	/* bin boundaries of "memory.page_age" in ms, ascending */
+	unsigned int page_age_intervals[MAX_NR_AGE_INTERVALS];
+	int nr_page_age_intervals;
+	/* handle for "memory.page_age", notified after each aging */
+	struct cgroup_file page_age_file;
 #endif
 
 	struct mem_cgroup_per_node *nodeinfo[];
@@ -1024,7 +1046,7 @@ static inline unsigned long lruvec_page_state_local(struct lruvec *lruvec,
 	return x;
 }
 
-void mem_cgroup_flush_stats(void);
+void mem_cgroup_flush_stats(struct mem_cgroup *memcg);
 void mem_cgroup_flush_stats_delayed(void);
 
 void __mod_memcg_lruvec_state(struct lruvec *lruvec, enum node_stat_item idx,
@@ -1083,8 +1105,9 @@ static inline void count_memcg_folio_events(struct folio *folio,
 		count_memcg_events(memcg, idx, nr);
 }
 
-static inline void count_memcg_event_mm(struct mm_struct *mm,
-					enum vm_event_item idx)
+static inline void count_memcg_events_mm(struct mm_struct *mm,
+					 enum vm_event_item idx,
+					 unsigned long count)
 {
 	struct mem_cgroup *memcg;
 
@@ -1094,10 +1117,16 @@ static inline void count_memcg_event_mm(struct mm_struct *mm,
 	rcu_read_lock();
 	memcg = mem_cgroup_from_task(rcu_dereference(mm->owner));
 	if (likely(memcg))
-		count_memcg_events(memcg, idx, 1);
+		count_memcg_events(memcg, idx, count);
 	rcu_read_unlock();
 }
 
+static inline void count_memcg_event_mm(struct mm_struct *mm,
+					enum vm_event_item idx)
+{
+	count_memcg_events_mm(mm, idx, 1);
+}
+
 static inline void memcg_memory_event(struct mem_cgroup *memcg,
 				      enum memcg_memory_event event)
 {
@@ -1509,7 +1538,7 @@ static inline unsigned long lruvec_page_state_local(struct lruvec *lruvec,
 	return node_page_state(lruvec_pgdat(lruvec), idx);
 }
 
-static inline void mem_cgroup_flush_stats(void)
+static inline void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
 {
 }
 
@@ -1560,6 +1589,12 @@ static inline void count_memcg_folio_events(struct folio *folio,
 {
 }
 
+static inline void count_memcg_events_mm(struct mm_struct *mm,
+					 enum vm_event_item idx,
+					 unsigned long count)
+{
+}
+
 static inline
 void count_memcg_event_mm(struct mm_struct *mm, enum vm_event_item idx)
 {
@@ -1856,15 +1891,22 @@ static inline void count_objcg_event(struct obj_cgroup *objcg,
 
 #endif /* CONFIG_MEMCG_KMEM */
 
+struct zswap_pool;
+
 #if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
 bool obj_cgroup_may_zswap(struct obj_cgroup *objcg);
 void obj_cgroup_charge_zswap(struct obj_cgroup *objcg, size_t size);
 void obj_cgroup_uncharge_zswap(struct obj_cgroup *objcg, size_t size);
+struct zswap_pool *mem_cgroup_zswap_pool(struct mem_cgroup *memcg);
 #else
 static inline bool obj_cgroup_may_zswap(struct obj_cgroup *objcg)
 {
 	return true;
 }
+static inline struct zswap_pool *mem_cgroup_zswap_pool(struct mem_cgroup *memcg)
+{
+	return NULL;
+}
 static inline void obj_cgroup_charge_zswap(struct obj_cgroup *objcg,
 					   size_t size)
 {
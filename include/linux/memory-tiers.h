@@ -40,6 +40,7 @@ void clear_node_memory_type(int node, struct memory_dev_type *memtype);
 int next_demotion_node(int node);
 void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets);
 bool node_is_toptier(int node);
+bool node_promotion_rate_limited(int node, int nr);
 #else
 static inline int next_demotion_node(int node)
 {
@@ -55,6 +56,11 @@ static inline bool node_is_toptier(int node)
 {
 	return true;
 }
+
+static inline bool node_promotion_rate_limited(int node, int nr)
+{
+	return false;
+}
 #endif
 
 #else
@@ -97,5 +103,10 @@ static inline bool node_is_toptier(int node)
 {
 	return true;
 }
+
+static inline bool node_promotion_rate_limited(int node, int nr)
+{
+	return false;
+}
 #endif	/* CONFIG_NUMA */
 #endif  /* _LINUX_MEMORY_TIERS_H */
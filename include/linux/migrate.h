@@ -16,8 +16,11 @@ struct migration_target_control;
  * Return values from addresss_space_operations.migratepage():
  * - negative errno on page migration failure;
  * - zero on page migration success;
+ * MIGRATEPAGE_UNMAP is only used internally by migrate_pages() for folios
+ * unmapped but not moved yet.
  */
 #define MIGRATEPAGE_SUCCESS		0
+#define MIGRATEPAGE_UNMAP		1
 
 /**
  * struct movable_operations - Driver page migration
@@ -548,6 +548,20 @@ struct vm_area_struct {
 	pgprot_t vm_page_prot;
 	unsigned long vm_flags;		/* Flags, see mm.h. */
 
+#ifdef CONFIG_PER_VMA_LOCK
+	/*
+	 * Page faults can run under vm_lock held for read instead of
+	 * mmap_lock, see lock_vma_under_rcu(). The vma is write-locked while
+	 * vm_lock_seq equals the mm_lock_seq of its mm.
+	 */
+	int vm_lock_seq;
+	struct rw_semaphore vm_lock;
+	/* Set once the vma got removed from the mm->mm_mt tree */
+	bool detached;
+	/* Lockless lookups may still see the vma, it is freed after a GP */
+	struct rcu_head vm_rcu;
+#endif
+
 	/*
 	 * For areas with an address space and backing store,
 	 * linkage into the address_space->i_mmap interval tree.
@@ -598,6 +612,7 @@ struct vm_area_struct {
 } __randomize_layout;
 
 struct kioctx_table;
+struct futex_private_hash;
 struct mm_struct {
 	struct {
 		struct maple_tree mm_mt;
@@ -673,6 +688,13 @@ struct mm_struct {
 					  * init_mm.mmlist, and are protected
 					  * by mmlist_lock
 					  */
+#ifdef CONFIG_PER_VMA_LOCK
+		/*
+		 * Bumped on every release of mmap_lock held for write, which
+		 * releases all the vmas write-locked under it at once.
+		 */
+		int mm_lock_seq;
+#endif
 
 
 		unsigned long hiwater_rss; /* High-watermark of RSS usage */
@@ -714,6 +736,17 @@ struct mm_struct {
 		spinlock_t			ioctx_lock;
 		struct kioctx_table __rcu	*ioctx_table;
 #endif
+#ifdef CONFIG_FUTEX
+		/*
+		 * Private futex hash of a multi-threaded process, see
+		 * futex_hash(). NULL when its private futexes are hashed
+		 * in the global hash. futex_phash_lock serializes growing
+		 * it, futex_phash_seq lets lookups retry meanwhile.
+		 */
+		struct futex_private_hash	*futex_phash;
+		spinlock_t			futex_phash_lock;
+		seqcount_spinlock_t		futex_phash_seq;
+#endif
 #ifdef CONFIG_MEMCG
 		/*
 		 * "owner" points to a task that is regarded as the canonical
@@ -769,6 +802,15 @@ struct mm_struct {
 		atomic_long_t hugetlb_usage;
 #endif
 		struct work_struct async_put_work;
+#ifdef CONFIG_PT_RECLAIM
+		/* frees the PTE tables MADV_DONTNEED left empty */
+		struct delayed_work pt_reclaim_work;
+		/* protects the range below */
+		spinlock_t pt_reclaim_lock;
+		/* PMD-aligned range holding the tables to check */
+		unsigned long pt_reclaim_start;
+		unsigned long pt_reclaim_end;
+#endif
 
 #ifdef CONFIG_IOMMU_SVA
 		u32 pasid;
@@ -784,6 +826,12 @@ struct mm_struct {
 		 * including merged and not merged.
 		 */
 		unsigned long ksm_rmap_items;
+		/*
+		 * Represent how many pages ksmd compared against the stable
+		 * and unstable trees, pages skipped by smart scan are not
+		 * included.
+		 */
+		unsigned long ksm_pages_scanned;
 #endif
 #ifdef CONFIG_LRU_GEN
 		struct {
@@ -801,16 +849,38 @@ struct mm_struct {
 #endif
 		} lru_gen;
 #endif /* CONFIG_LRU_GEN */
+#ifdef CONFIG_SCHED_MM_CID
+		/**
+		 * @pcpu_cid: Per-cpu concurrency ID of this mm.
+		 *
+		 * The ID a cpu took for the tasks of this mm it runs. It
+		 * is kept across switches and only given back to the
+		 * cidmask once the cpu has not run the mm for a while.
+		 */
+		struct mm_cid __percpu *pcpu_cid;
+		/**
+		 * @mm_cid_next_scan: Next mm_cid scan (in jiffies).
+		 *
+		 * When the next scan for per-cpu IDs to reclaim is due.
+		 */
+		unsigned long mm_cid_next_scan;
+#endif
 	} __randomize_layout;
 
 	/*
 	 * The mm_cpumask needs to be at the end of mm_struct, because it
-	 * is dynamically sized based on nr_cpu_ids.
+	 * is dynamically sized based on nr_cpu_ids.  With
+	 * CONFIG_SCHED_MM_CID, the concurrency ID bitmap follows it.
 	 */
 	unsigned long cpu_bitmap[];
 };
 
+#ifdef CONFIG_PER_VMA_LOCK
+#define MM_MT_FLAGS	(MT_FLAGS_ALLOC_RANGE | MT_FLAGS_LOCK_EXTERN | \
+			 MT_FLAGS_USE_RCU)
+#else
 #define MM_MT_FLAGS	(MT_FLAGS_ALLOC_RANGE | MT_FLAGS_LOCK_EXTERN)
+#endif
 extern struct mm_struct init_mm;
 
 /* Pointer magic because the dynamic array size confuses some compilers. */
@@ -828,6 +898,65 @@ static inline cpumask_t *mm_cpumask(struct mm_struct *mm)
 	return (struct cpumask *)&mm->cpu_bitmap;
 }
 
+#ifdef CONFIG_SCHED_MM_CID
+struct mm_cid {
+	unsigned long time;	/* jiffies when last used */
+	int cid;
+};
+
+/* Accessor for struct mm_struct's cidmask. */
+static inline cpumask_t *mm_cidmask(struct mm_struct *mm)
+{
+	unsigned long cid_bitmap = (unsigned long)mm;
+
+	cid_bitmap += offsetof(struct mm_struct, cpu_bitmap);
+	/* Skip cpu_bitmap */
+	cid_bitmap += cpumask_size();
+	return (struct cpumask *)cid_bitmap;
+}
+
+static inline void mm_init_cid(struct mm_struct *mm)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct mm_cid *pcpu_cid = per_cpu_ptr(mm->pcpu_cid, i);
+
+		pcpu_cid->cid = -1;
+		pcpu_cid->time = 0;
+	}
+	mm->mm_cid_next_scan = jiffies;
+	cpumask_clear(mm_cidmask(mm));
+}
+
+static inline int mm_alloc_cid(struct mm_struct *mm)
+{
+	mm->pcpu_cid = alloc_percpu(struct mm_cid);
+	if (!mm->pcpu_cid)
+		return -ENOMEM;
+	mm_init_cid(mm);
+	return 0;
+}
+
+static inline void mm_destroy_cid(struct mm_struct *mm)
+{
+	free_percpu(mm->pcpu_cid);
+	mm->pcpu_cid = NULL;
+}
+
+static inline unsigned int mm_cid_size(void)
+{
+	return cpumask_size();
+}
+#else /* CONFIG_SCHED_MM_CID */
+static inline int mm_alloc_cid(struct mm_struct *mm) { return 0; }
+static inline void mm_destroy_cid(struct mm_struct *mm) { }
+static inline unsigned int mm_cid_size(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SCHED_MM_CID */
+
 #ifdef CONFIG_LRU_GEN
 
 struct lru_gen_mm_list {
@@ -888,6 +1017,22 @@ static inline void lru_gen_use_mm(struct mm_struct *mm)
 
 #endif /* CONFIG_LRU_GEN */
 
+#ifdef CONFIG_PT_RECLAIM
+void pt_reclaim_work_fn(struct work_struct *work);
+
+static inline void pt_reclaim_init_mm(struct mm_struct *mm)
+{
+	INIT_DELAYED_WORK(&mm->pt_reclaim_work, pt_reclaim_work_fn);
+	spin_lock_init(&mm->pt_reclaim_lock);
+	mm->pt_reclaim_start = ULONG_MAX;
+	mm->pt_reclaim_end = 0;
+}
+#else
+static inline void pt_reclaim_init_mm(struct mm_struct *mm)
+{
+}
+#endif
+
 struct vma_iterator {
 	struct ma_state mas;
 };
@@ -1044,6 +1189,10 @@ typedef struct {
  *                      mapped after the fault.
  * @FAULT_FLAG_ORIG_PTE_VALID: whether the fault has vmf->orig_pte cached.
  *                        We should only access orig_pte if this flag set.
+ * @FAULT_FLAG_VMA_LOCK: The fault is handled under the VMA lock instead of
+ *                       mmap_lock. The handler must not drop the lock and
+ *                       returns VM_FAULT_RETRY for the cases that need
+ *                       mmap_lock.
  *
  * About @FAULT_FLAG_ALLOW_RETRY and @FAULT_FLAG_TRIED: we can specify
  * whether we would allow page faults to retry by specifying these two
@@ -1081,6 +1230,7 @@ enum fault_flag {
 	FAULT_FLAG_INTERRUPTIBLE =	1 << 9,
 	FAULT_FLAG_UNSHARE =		1 << 10,
 	FAULT_FLAG_ORIG_PTE_VALID =	1 << 11,
+	FAULT_FLAG_VMA_LOCK =		1 << 12,
 };
 
 typedef unsigned int __bitwise zap_flags_t;
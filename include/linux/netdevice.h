@@ -1618,6 +1618,22 @@ struct net_device_ops {
 						  bool cycles);
 };
 
+struct xdp_md;
+
+/*
+ * Driver callbacks behind the bpf_xdp_metadata_*() kfuncs. They are only
+ * called for an xdp_buff the driver marked with xdp_buff_set_rx_metadata(),
+ * so @ctx can be taken back to the driver's own structure wrapping it.
+ * They return 0 on success, -ENODATA if the descriptor of the packet does
+ * not carry the information.
+ */
+struct xdp_metadata_ops {
+	int	(*xmo_rx_timestamp)(const struct xdp_md *ctx, u64 *timestamp);
+	int	(*xmo_rx_hash)(const struct xdp_md *ctx, u32 *hash);
+	int	(*xmo_rx_vlan_tag)(const struct xdp_md *ctx, __be16 *vlan_proto,
+				   u16 *vlan_tci);
+};
+
 /**
  * enum netdev_priv_flags - &struct net_device priv_flags
  *
@@ -1801,6 +1817,7 @@ enum netdev_ml_priv_type {
  *
  *	@netdev_ops:	Includes several pointers to callbacks,
  *			if one wants to override the ndo_*() functions
+ *	@xdp_metadata_ops:	Includes pointers to XDP metadata callbacks.
  *	@ethtool_ops:	Management operations
  *	@l3mdev_ops:	Layer 3 master device operations
  *	@ndisc_ops:	Includes callbacks for different IPv6 neighbour
@@ -1990,6 +2007,8 @@ enum netdev_ml_priv_type {
  *				offload capabilities of the device
  *	@udp_tunnel_nic:	UDP tunnel offload state
  *	@xdp_state:		stores info on attached XDP BPF programs
+ *	@xdp_zc_max_segs:	maximum number of buffers the driver can chain
+ *				for one packet in AF_XDP zero-copy mode
  *
  *	@nested_level:	Used as a parameter of spin_lock_nested() of
  *			dev->addr_list_lock.
@@ -2050,6 +2069,7 @@ struct net_device {
 	unsigned int		flags;
 	unsigned long long	priv_flags;
 	const struct net_device_ops *netdev_ops;
+	const struct xdp_metadata_ops *xdp_metadata_ops;
 	int			ifindex;
 	unsigned short		gflags;
 	unsigned short		hard_header_len;
@@ -2354,6 +2374,7 @@ struct net_device {
 
 	/* protected by rtnl_lock */
 	struct bpf_xdp_entity	xdp_state[__MAX_XDP_MODE];
+	u8			xdp_zc_max_segs;
 
 	u8 dev_addr_shadow[MAX_ADDR_LEN];
 	netdevice_tracker	linkwatch_dev_tracker;
@@ -3134,6 +3155,8 @@ static inline bool dev_has_header(const struct net_device *dev)
 /*
  * Incoming packets are placed on per-CPU queues
  */
+#define NET_WAKE_BATCH_MAX	64
+
 struct softnet_data {
 	struct list_head	poll_list;
 	struct sk_buff_head	process_queue;
@@ -3161,6 +3184,10 @@ struct softnet_data {
 		u8  skip_txqueue;
 #endif
 	} xmit;
+	/* sockets to wake up at the end of net_rx_action(), owning cpu only */
+	unsigned int		wake_batch;
+	unsigned int		wake_count;
+	struct sock		*wake_list[NET_WAKE_BATCH_MAX];
 #ifdef CONFIG_RPS
 	/* input_queue_head should be written by cpu owning this struct,
 	 * and only read by other cpus. Worth using a cache line.
@@ -4661,6 +4688,7 @@ extern int		netdev_max_backlog;
 extern int		dev_rx_weight;
 extern int		dev_tx_weight;
 extern int		gro_normal_batch;
+extern int		sk_wake_batch;
 
 enum {
 	NESTED_SYNC_IMM_BIT,
@@ -121,6 +121,10 @@ extern	struct nfs_page *nfs_create_request(struct nfs_open_context *ctx,
 					    struct page *page,
 					    unsigned int offset,
 					    unsigned int count);
+extern	struct nfs_page *nfs_create_request_lctx(struct nfs_lock_context *l_ctx,
+						 struct page *page,
+						 unsigned int offset,
+						 unsigned int count);
 extern	void nfs_release_request(struct nfs_page *);
 
 
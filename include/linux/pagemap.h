@@ -306,6 +306,33 @@ static inline void mapping_set_large_folios(struct address_space *mapping)
 	__set_bit(AS_LARGE_FOLIO_SUPPORT, &mapping->flags);
 }
 
+/**
+ * mapping_clear_large_folios() - Stop using large folios for a file.
+ * @mapping: The file.
+ *
+ * Unlike mapping_set_large_folios() this may be called on an active
+ * inode. The caller must have evicted any large folio from the page
+ * cache and keep new ones from being added until the flag is clear,
+ * e.g. by holding the invalidate_lock.
+ */
+static inline void mapping_clear_large_folios(struct address_space *mapping)
+{
+	clear_bit(AS_LARGE_FOLIO_SUPPORT, &mapping->flags);
+}
+
+/*
+ * There are some parts of the kernel which assume that PMD entries
+ * are exactly HPAGE_PMD_ORDER.  Those should be fixed, but until then,
+ * limit the maximum allocation order to PMD size.  I'm not aware of any
+ * assumptions about maximum order if THP are disabled, but 8 seems like
+ * a good order (that's 1MB if you're using 4kB pages)
+ */
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define MAX_PAGECACHE_ORDER	HPAGE_PMD_ORDER
+#else
+#define MAX_PAGECACHE_ORDER	8
+#endif
+
 /*
  * Large folio support currently depends on THP.  These dependencies are
  * being worked on but are not yet fixed.
@@ -506,6 +533,27 @@ pgoff_t page_cache_prev_miss(struct address_space *mapping,
 #define FGP_FOR_MMAP		0x00000040
 #define FGP_ENTRY		0x00000080
 #define FGP_STABLE		0x00000100
+/* The top bits carry the order of the folio %FGP_CREAT should allocate */
+#define FGP_ORDER_SHIFT		26
+#define FGP_ORDER(fgp)		(((unsigned int)(fgp)) >> FGP_ORDER_SHIFT)
+
+/**
+ * fgf_set_order - Encode a length in the fgp flags.
+ * @size: The suggested size of the folio to create.
+ *
+ * The caller of __filemap_get_folio() can use this to suggest a preferred
+ * size for the folio that is created.  If there is already a folio at
+ * the index, it will be returned, no matter what its size.  If a folio
+ * is freshly created, it may be smaller than requested due to alignment
+ * constraints, memory pressure, or the presence of other folios at
+ * nearby indices.
+ */
+static inline int fgf_set_order(size_t size)
+{
+	if (size <= PAGE_SIZE)
+		return 0;
+	return (unsigned int)(ilog2(size) - PAGE_SHIFT) << FGP_ORDER_SHIFT;
+}
 
 struct folio *__filemap_get_folio(struct address_space *mapping, pgoff_t index,
 		int fgp_flags, gfp_t gfp);
@@ -175,11 +175,13 @@ struct psi_group {
 	u64 total[NR_PSI_AGGREGATORS][NR_PSI_STATES - 1];
 	unsigned long avg[NR_PSI_STATES - 1][3];
 
-	/* Monitor work control */
-	struct task_struct __rcu *poll_task;
+	/*
+	 * Monitor work control. poll_worker points to the psimon worker
+	 * shared by all groups while this group has triggers.
+	 */
+	struct kthread_worker __rcu *poll_worker;
+	struct kthread_work poll_work;
 	struct timer_list poll_timer;
-	wait_queue_head_t poll_wait;
-	atomic_t poll_wakeup;
 	atomic_t poll_scheduled;
 
 	/* Protects data used by the monitor */
@@ -29,7 +29,7 @@ struct restart_block {
 		/* For futex_wait and futex_wait_requeue_pi */
 		struct {
 			u32 __user *uaddr;
-			u32 val;
+			u64 val;
 			u32 flags;
 			u32 bitset;
 			u64 time;
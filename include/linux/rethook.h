@@ -14,6 +14,20 @@
 
 struct rethook_node;
 
+#define RETHOOK_PCP_NODES	8
+
+/**
+ * struct rethook_pcp - Per-cpu cache of struct rethook_node.
+ * @busy: Set while the cache is being modified, protects against NMIs.
+ * @nr: The number of cached nodes.
+ * @nodes: The cached nodes.
+ */
+struct rethook_pcp {
+	int			busy;
+	unsigned int		nr;
+	struct rethook_node	*nodes[RETHOOK_PCP_NODES];
+};
+
 typedef void (*rethook_handler_t) (struct rethook_node *, void *, struct pt_regs *);
 
 /**
@@ -21,6 +35,9 @@ typedef void (*rethook_handler_t) (struct rethook_node *, void *, struct pt_regs
  * @data: The user-defined data storage.
  * @handler: The user-defined return hook handler.
  * @pool: The pool of struct rethook_node.
+ * @pcp: The per-cpu caches in front of @pool.
+ * @pcp_max: How many nodes each per-cpu cache may hold.
+ * @nr_nodes: The number of nodes added to the rethook.
  * @ref: The reference counter.
  * @rcu: The rcu_head for deferred freeing.
  *
@@ -31,6 +48,9 @@ struct rethook {
 	void			*data;
 	rethook_handler_t	handler;
 	struct freelist_head	pool;
+	struct rethook_pcp __percpu *pcp;
+	unsigned int		pcp_max;
+	unsigned int		nr_nodes;
 	refcount_t		ref;
 	struct rcu_head		rcu;
 };
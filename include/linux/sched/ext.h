@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_SCHED_EXT_H
+#define _LINUX_SCHED_EXT_H
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock_types.h>
+
+struct task_struct;
+
+#define SCX_OPS_NAME_LEN	128
+
+/* default time slice of a task dispatched without an explicit one */
+#define SCX_SLICE_DFL		(20 * NSEC_PER_MSEC)
+
+/* a task left runnable this long without running disables the scheduler */
+#define SCX_WATCHDOG_TIMEOUT	(30 * HZ)
+
+/*
+ * Dispatch queue IDs. The top bit marks the built-in queues, everything
+ * below it is free for the BPF scheduler to create with scx_bpf_create_dsq().
+ */
+enum scx_dsq_id_flags {
+	SCX_DSQ_FLAG_BUILTIN	= 1LLU << 63,
+
+	SCX_DSQ_GLOBAL		= SCX_DSQ_FLAG_BUILTIN | 0,
+	SCX_DSQ_LOCAL		= SCX_DSQ_FLAG_BUILTIN | 1,
+};
+
+/*
+ * A FIFO of runnable tasks. Every CPU has a local one the class picks from,
+ * tasks on the global and user created queues get moved to a local queue by
+ * scx_bpf_consume().
+ */
+struct scx_dispatch_q {
+	raw_spinlock_t		lock;
+	struct list_head	list;
+	u32			nr;
+	u64			id;
+	struct rcu_head		rcu;
+};
+
+/* sched_ext_entity->flags */
+enum scx_ent_flags {
+	SCX_TASK_QUEUED		= 1 << 0, /* on the ext class of its rq */
+	SCX_TASK_ENQ_LOCAL	= 1 << 1, /* next enqueue goes to local dsq */
+};
+
+/* scx_bpf_dispatch() enq_flags */
+enum scx_enq_flags {
+	SCX_ENQ_HEAD		= 1LLU << 0,
+};
+
+struct sched_ext_entity {
+	struct scx_dispatch_q	*dsq;
+	struct list_head	dsq_node;
+	u32			flags;
+	/* CPU consuming the task off a shared dsq, see consume_dispatch_q() */
+	s32			holding_cpu;
+	u64			slice;
+	/* on rq->scx.runnable_list while queued and not running */
+	struct list_head	runnable_node;
+	unsigned long		runnable_at;
+};
+
+/**
+ * struct sched_ext_ops - Operation table for a BPF scheduler
+ *
+ * Every callback but @enqueue is optional. While an operation table is
+ * attached, tasks of policy SCHED_EXT run in the ext scheduling class and
+ * the callbacks below decide where and when they run. Once it is detached,
+ * they return to the fair class.
+ */
+struct sched_ext_ops {
+	/**
+	 * select_cpu - Pick the target CPU of a waking task
+	 * @p: task being woken up
+	 * @prev_cpu: CPU @p last ran on
+	 * @wake_flags: WF_* flags
+	 *
+	 * Return a CPU in @p->cpus_ptr, @prev_cpu is used otherwise.
+	 */
+	s32 (*select_cpu)(struct task_struct *p, s32 prev_cpu, u64 wake_flags);
+
+	/**
+	 * enqueue - A task became runnable
+	 * @p: task being enqueued
+	 * @enq_flags: ENQUEUE_* flags
+	 *
+	 * Must place @p on a dispatch queue with scx_bpf_dispatch(). A task
+	 * left undispatched is put on the global queue.
+	 */
+	void (*enqueue)(struct task_struct *p, u64 enq_flags);
+
+	/**
+	 * dequeue - A task stopped being runnable or is changing class
+	 * @p: task being dequeued
+	 * @deq_flags: DEQUEUE_* flags
+	 *
+	 * Notification only, the kernel takes @p off its dispatch queue.
+	 */
+	void (*dequeue)(struct task_struct *p, u64 deq_flags);
+
+	/**
+	 * dispatch - The local queue of a CPU ran dry
+	 * @cpu: CPU looking for work
+	 * @prev: task that was running on @cpu, may be NULL
+	 *
+	 * Move tasks to the local queue of @cpu with scx_bpf_consume(). The
+	 * global queue is consumed if nothing was found.
+	 */
+	void (*dispatch)(s32 cpu, struct task_struct *prev);
+
+	/**
+	 * init - Called before the table is attached
+	 *
+	 * Create the dispatch queues the scheduler needs here.
+	 */
+	s32 (*init)(void);
+
+	/**
+	 * exit - Called after the table was detached and all tasks left
+	 */
+	void (*exit)(void);
+
+	/* name of the scheduler, used in its warnings */
+	char name[SCX_OPS_NAME_LEN];
+};
+
+#endif /* CONFIG_SCHED_CLASS_EXT */
+#endif /* _LINUX_SCHED_EXT_H */
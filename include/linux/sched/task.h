@@ -36,6 +36,7 @@ struct kernel_clone_args {
 	int idle;
 	int (*fn)(void *);
 	void *fn_arg;
+	struct clone_spawn_args __user *spawn;
 	struct cgroup *cgrp;
 	struct css_set *cset;
 };
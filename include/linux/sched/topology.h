@@ -167,7 +167,7 @@ static inline struct cpumask *sched_domain_span(struct sched_domain *sd)
 	return to_cpumask(sd->span);
 }
 
-extern void partition_sched_domains_locked(int ndoms_new,
+extern bool partition_sched_domains_locked(int ndoms_new,
 					   cpumask_var_t doms_new[],
 					   struct sched_domain_attr *dattr_new);
 
@@ -215,10 +215,11 @@ extern void set_sched_topology(struct sched_domain_topology_level *tl);
 
 struct sched_domain_attr;
 
-static inline void
+static inline bool
 partition_sched_domains_locked(int ndoms_new, cpumask_var_t doms_new[],
 			       struct sched_domain_attr *dattr_new)
 {
+	return true;
 }
 
 static inline void
@@ -39,6 +39,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_MAGAZINE,		/* Allocation from cpu magazine */
+	FREE_MAGAZINE,		/* Free to cpu magazine */
+	MAGAZINE_REFILL,	/* Refill of an empty cpu magazine */
+	MAGAZINE_FLUSH,		/* Flush of objects from a cpu magazine */
 	NR_SLUB_STAT_ITEMS };
 
 #ifndef CONFIG_SLUB_TINY
@@ -58,6 +62,17 @@ struct kmem_cache_cpu {
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
 };
+
+/*
+ * Optional per cpu array of free objects in front of the cpu slab, set up
+ * through the magazine_size sysfs attribute of a cache.
+ */
+struct slub_magazine {
+	local_lock_t lock;	/* Protects the fields below */
+	unsigned int size;	/* Number of objects in the array */
+	unsigned int capacity;
+	void *objects[];
+};
 #endif /* CONFIG_SLUB_TINY */
 
 #ifdef CONFIG_SLUB_CPU_PARTIAL
@@ -92,6 +107,8 @@ struct kmem_cache_order_objects {
 struct kmem_cache {
 #ifndef CONFIG_SLUB_TINY
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	/* RCU protected, NULL unless magazines are enabled */
+	struct slub_magazine __percpu *magazine;
 #endif
 	/* Used for retrieving partial slabs, etc. */
 	slab_flags_t flags;
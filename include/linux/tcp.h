@@ -339,6 +339,8 @@ struct tcp_sock {
 	u32	sacked_out;	/* SACK'd packets			*/
 
 	struct hrtimer	pacing_timer;
+	struct list_head pacing_node;	/* entry on a per-CPU pacing wheel */
+	int		pacing_cpu;	/* CPU of that wheel, or -1 */
 	struct hrtimer	compressed_ack_timer;
 
 	/* from STCP, retrans queue hinting */
@@ -461,6 +463,7 @@ enum tsq_enum {
 	TCP_MTU_REDUCED_DEFERRED,  /* tcp_v{4|6}_err() could not call
 				    * tcp_v{4|6}_mtu_reduced()
 				    */
+	TCP_PACING_QUEUED,	   /* socket is on a pacing wheel */
 };
 
 enum tsq_flags {
@@ -470,6 +473,7 @@ enum tsq_flags {
 	TCPF_WRITE_TIMER_DEFERRED	= (1UL << TCP_WRITE_TIMER_DEFERRED),
 	TCPF_DELACK_TIMER_DEFERRED	= (1UL << TCP_DELACK_TIMER_DEFERRED),
 	TCPF_MTU_REDUCED_DEFERRED	= (1UL << TCP_MTU_REDUCED_DEFERRED),
+	TCPF_PACING_QUEUED		= (1UL << TCP_PACING_QUEUED),
 };
 
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
@@ -85,6 +85,11 @@ struct udp_sock {
 						struct sk_buff *skb,
 						int nhoff);
 
+	/* Producers add packets here, lockless, see
+	 * __udp_enqueue_schedule_skb()
+	 */
+	struct llist_head	prod_queue ____cacheline_aligned_in_smp;
+
 	/* udp_recvmsg try to use this before splicing sk_receive_queue */
 	struct sk_buff_head	reader_queue ____cacheline_aligned_in_smp;
 
@@ -51,4 +51,44 @@ struct user_reg {
 /* Requests to delete a user_event */
 #define DIAG_IOCSDEL _IOW(DIAG_IOC_MAGIC, 1, char*)
 
+/*
+ * Describes a batch of events to commit with a single DIAG_IOCSBATCH ioctl.
+ * The data buffer holds the events back to back, each one starting with a
+ * struct user_batch_entry followed by the event payload. Each entry starts
+ * 8 byte aligned from the start of the buffer, so the payload is padded.
+ * Callers append events to a per-thread buffer and commit it at their own
+ * flush points, events are committed to the trace in buffer order.
+ */
+struct user_batch {
+
+	/* Input: Size of the user_batch structure being used */
+	__u32 size;
+
+	/* Input: Flags, must be zero */
+	__u32 flags;
+
+	/* Input: Pointer to the first user_batch_entry */
+	__u64 data;
+
+	/* Input: Length in bytes of the entries */
+	__u64 data_len;
+
+	/* Output: Number of entries committed */
+	__u32 committed;
+} __attribute__((__packed__));
+
+struct user_batch_entry {
+
+	/* Size of the payload following this header */
+	__u32 size;
+
+	/* Index of the event, as returned by DIAG_IOCSREG */
+	__u32 write_index;
+} __attribute__((__packed__));
+
+#define USER_BATCH_ALIGN 8
+
+/* Requests to commit a batch of events */
+#define DIAG_IOCSBATCH _IOWR(DIAG_IOC_MAGIC, 2, struct user_batch*)
+
 #endif /* _UAPI_LINUX_USER_EVENTS_H */
@@ -70,6 +70,12 @@ extern ssize_t mfill_zeropage(struct mm_struct *dst_mm,
 			      atomic_t *mmap_changing);
 extern ssize_t mcopy_continue(struct mm_struct *dst_mm, unsigned long dst_start,
 			      unsigned long len, atomic_t *mmap_changing);
+extern ssize_t mcopy_atomic_vec(struct mm_struct *dst_mm,
+				const struct uffdio_vec *vec, unsigned long nr,
+				atomic_t *mmap_changing, __u64 mode);
+extern ssize_t mcopy_continue_vec(struct mm_struct *dst_mm,
+				  const struct uffdio_vec *vec,
+				  unsigned long nr, atomic_t *mmap_changing);
 extern int mwriteprotect_range(struct mm_struct *dst_mm,
 			       unsigned long start, unsigned long len,
 			       bool enable_wp, atomic_t *mmap_changing);
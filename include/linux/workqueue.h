@@ -98,6 +98,9 @@ struct work_struct {
 	atomic_long_t data;
 	struct list_head entry;
 	work_func_t func;
+#ifdef CONFIG_WQ_STATS
+	u64 queued_at;		/* local_clock() when last queued */
+#endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
@@ -141,7 +144,24 @@ struct workqueue_attrs {
 	cpumask_var_t cpumask;
 
 	/**
-	 * @no_numa: disable NUMA affinity
+	 * @__pod_cpumask: internal attribute used to create per-pod pools
+	 *
+	 * Internal use only.  The CPUs of the pod a pool prefers.  Equals
+	 * @cpumask for strict pools and for the default pool of a workqueue.
+	 */
+	cpumask_var_t __pod_cpumask;
+
+	/**
+	 * @affn_strict: affinity scope is strict
+	 *
+	 * If set, workers of a per-pod pool are confined to the pod.  If
+	 * clear, they may run on any CPU in @cpumask and the pod is only
+	 * preferred when waking them up.
+	 */
+	bool affn_strict;
+
+	/**
+	 * @no_numa: disable pod affinity
 	 *
 	 * Unlike other fields, ``no_numa`` isn't a property of a worker_pool. It
 	 * only modifies how :c:func:`apply_workqueue_attrs` select pools and thus
@@ -711,5 +731,6 @@ int workqueue_offline_cpu(unsigned int cpu);
 
 void __init workqueue_init_early(void);
 void __init workqueue_init(void);
+void __init workqueue_init_topology(void);
 
 #endif
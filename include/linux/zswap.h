@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_ZSWAP_H
+#define _LINUX_ZSWAP_H
+
+#include <linux/types.h>
+#include <linux/err.h>
+
+struct zswap_pool;
+
+#ifdef CONFIG_ZSWAP
+
+struct zswap_pool *zswap_pool_get_compressor(const char *compressor);
+const char *zswap_pool_compressor(struct zswap_pool *pool);
+void zswap_pool_release(struct zswap_pool *pool);
+
+#else
+
+static inline struct zswap_pool *zswap_pool_get_compressor(const char *compressor)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline const char *zswap_pool_compressor(struct zswap_pool *pool)
+{
+	return NULL;
+}
+
+static inline void zswap_pool_release(struct zswap_pool *pool) {}
+
+#endif
+
+#endif /* _LINUX_ZSWAP_H */
@@ -401,6 +401,10 @@ INDIRECT_CALLABLE_DECLARE(int udp6_gro_complete(struct sk_buff *, int));
 
 struct sk_buff *udp_gro_receive(struct list_head *head, struct sk_buff *skb,
 				struct udphdr *uh, struct sock *sk);
+struct sk_buff *udp_gro_receive_segment(struct list_head *head,
+					struct sk_buff *skb);
+bool udp_gro_flow_held(struct list_head *head, struct sk_buff *skb,
+		       struct udphdr *uh);
 int udp_gro_complete(struct sk_buff *skb, int nhoff, udp_lookup_t lookup);
 
 static inline struct udphdr *udp_gro_udphdr(struct sk_buff *skb)
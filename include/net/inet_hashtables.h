@@ -15,6 +15,7 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/list.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
 #include <linux/socket.h>
 #include <linux/spinlock.h>
@@ -158,6 +159,16 @@ struct inet_hashinfo {
 	unsigned int			ehash_mask;
 	unsigned int			ehash_locks_mask;
 
+	/* While the ehash is resized, sockets are moved to ehash_next
+	 * one lock at a time: the ones under the first ehash_next_locks locks
+	 * are already there.  Lockless lookups retry on ehash_seq if they
+	 * miss, see inet_ehash_resize().
+	 */
+	struct inet_ehash_bucket	*ehash_next;
+	unsigned int			ehash_next_mask;
+	unsigned int			ehash_next_locks;
+	seqcount_t			ehash_seq;
+
 	/* Ok, let's try this, I give up, we do need a local binding
 	 * TCP hash as well as the others for fast bind/connect.
 	 */
@@ -195,11 +206,53 @@ inet_lhash2_bucket(struct inet_hashinfo *h, u32 hash)
 	return &h->lhash2[hash & h->lhash2_mask];
 }
 
+/* Bucket of @hash, either with the lock of @hash held or, for lockless
+ * lookups, followed by a read_seqcount_retry() on ehash_seq.
+ */
+static inline struct inet_ehash_bucket *__inet_ehash_bucket(
+	struct inet_hashinfo *hashinfo,
+	unsigned int hash, unsigned int *slot)
+{
+	struct inet_ehash_bucket *next = smp_load_acquire(&hashinfo->ehash_next);
+
+	if (unlikely(next) &&
+	    (hash & hashinfo->ehash_locks_mask) <
+	    READ_ONCE(hashinfo->ehash_next_locks)) {
+		*slot = hash & hashinfo->ehash_next_mask;
+		return &next[*slot];
+	}
+
+	*slot = hash & READ_ONCE(hashinfo->ehash_mask);
+	return &READ_ONCE(hashinfo->ehash)[*slot];
+}
+
 static inline struct inet_ehash_bucket *inet_ehash_bucket(
 	struct inet_hashinfo *hashinfo,
 	unsigned int hash)
 {
-	return &hashinfo->ehash[hash & hashinfo->ehash_mask];
+	unsigned int slot;
+
+	return __inet_ehash_bucket(hashinfo, hash, &slot);
+}
+
+/* Chain @slot of the ehash for walkers, NULL past its end.  Must be called
+ * under rcu_read_lock() or with the lock of @slot held.  Sockets already
+ * moved by a resize in progress are not seen.
+ */
+static inline struct hlist_nulls_head *inet_ehash_chain(
+	struct inet_hashinfo *hashinfo,
+	unsigned int slot)
+{
+	struct inet_ehash_bucket *ehash;
+	unsigned int mask, seq;
+
+	do {
+		seq = read_seqcount_begin(&hashinfo->ehash_seq);
+		ehash = READ_ONCE(hashinfo->ehash);
+		mask = READ_ONCE(hashinfo->ehash_mask);
+	} while (read_seqcount_retry(&hashinfo->ehash_seq, seq));
+
+	return slot <= mask ? &ehash[slot].chain : NULL;
 }
 
 static inline spinlock_t *inet_ehash_lockp(
@@ -226,6 +279,8 @@ static inline void inet_ehash_locks_free(struct inet_hashinfo *hashinfo)
 struct inet_hashinfo *inet_pernet_hashinfo_alloc(struct inet_hashinfo *hashinfo,
 						 unsigned int ehash_entries);
 void inet_pernet_hashinfo_free(struct inet_hashinfo *hashinfo);
+int inet_ehash_resize(struct inet_hashinfo *hashinfo,
+		      unsigned int ehash_entries);
 
 struct inet_bind_bucket *
 inet_bind_bucket_create(struct kmem_cache *cachep, struct net *net,
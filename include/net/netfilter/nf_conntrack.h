@@ -15,6 +15,7 @@
 
 #include <linux/bitops.h>
 #include <linux/compiler.h>
+#include <linux/percpu_counter.h>
 
 #include <linux/netfilter/nf_conntrack_common.h>
 #include <linux/netfilter/nf_conntrack_tcp.h>
@@ -51,7 +52,7 @@ struct nf_conntrack_net_ecache {
 
 struct nf_conntrack_net {
 	/* only used when new connection is allocated: */
-	atomic_t count;
+	struct percpu_counter count;
 	unsigned int expect_count;
 
 	/* only used from work queues, configuration plane, and so on: */
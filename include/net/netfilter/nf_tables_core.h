@@ -70,6 +70,19 @@ struct nft_payload {
 
 extern const struct nft_expr_ops nft_payload_fast_ops;
 
+/* A fast payload load and the compare of the loaded register which follows
+ * it, fused into one expression when the rule blob is built.
+ */
+struct nft_payload_cmp_fast_expr {
+	struct nft_payload	 payload;
+	struct nft_cmp_fast_expr cmp;
+};
+
+extern const struct nft_expr_ops nft_payload_cmp_fast_ops;
+
+bool nft_expr_fuse(struct nft_expr *dst, const struct nft_expr *expr,
+		   const struct nft_expr *next);
+
 extern const struct nft_expr_ops nft_bitwise_fast_ops;
 
 extern struct static_key_false nft_counters_enabled;
@@ -94,6 +94,7 @@ struct page_pool_alloc_stats {
 		    */
 	u64 refill; /* allocations via successful refill */
 	u64 waive;  /* failed refills due to numa zone mismatch */
+	u64 node;   /* slow-path pages taken from the per-node cache */
 };
 
 struct page_pool_recycle_stats {
@@ -106,6 +107,9 @@ struct page_pool_recycle_stats {
 	u64 released_refcnt; /* page released because of elevated
 			      * refcnt
 			      */
+	u64 node;	/* page given to the per-node cache instead of
+			 * being released to the page allocator
+			 */
 };
 
 /* This struct wraps the above stats structs so users of the
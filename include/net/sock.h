@@ -276,6 +276,8 @@ struct sk_filter;
   *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
   *	@sk_pacing_status: Pacing status (requested, handled by sch_fq)
   *	@sk_max_pacing_rate: Maximum pacing rate (%SO_MAX_PACING_RATE)
+  *	@sk_pacing_next: earliest time (ns) sch_fq lets the next packet leave,
+  *			 shared by all the fq instances the socket's packets go through
   *	@sk_sndbuf: size of send buffer in bytes
   *	@__sk_flags_offset: empty field used to determine location of bitfield
   *	@sk_padding: unused element for alignment
@@ -463,6 +465,7 @@ struct sock {
 	__u32			sk_mark;
 	unsigned long		sk_pacing_rate; /* bytes per second */
 	unsigned long		sk_max_pacing_rate;
+	u64			sk_pacing_next;
 	struct page_frag	sk_frag;
 	netdev_features_t	sk_route_caps;
 	int			sk_gso_type;
@@ -2949,6 +2952,7 @@ static inline bool sk_dev_equal_l3scope(struct sock *sk, int dif)
 }
 
 void sock_def_readable(struct sock *sk);
+void sock_wake_flush(struct softnet_data *sd);
 
 int sock_bindtoindex(struct sock *sk, int ifindex, bool lock_sk);
 void sock_set_timestamp(struct sock *sk, int optname, bool valbool);
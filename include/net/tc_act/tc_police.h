@@ -11,6 +11,8 @@ struct tcf_police_params {
 	u32			tcfp_mtu;
 	s64			tcfp_mtu_ptoks;
 	s64			tcfp_pkt_burst;
+	u32			tcfp_batch;
+	s64			tcfp_batch_toks;
 	struct psched_ratecfg	rate;
 	bool			rate_present;
 	struct psched_ratecfg	peak;
@@ -29,6 +31,9 @@ struct tcf_police {
 	s64			tcfp_ptoks;
 	s64			tcfp_pkttoks;
 	s64			tcfp_t_c;
+
+	/* Tokens taken from the bucket by each CPU, see TCA_POLICE_BATCH */
+	s64 __percpu		*tcfp_pcpu_toks;
 };
 
 #define to_police(pc) ((struct tcf_police *)pc)
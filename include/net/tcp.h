@@ -428,6 +428,8 @@ void tcp_data_ready(struct sock *sk);
 #ifdef CONFIG_MMU
 int tcp_mmap(struct file *file, struct socket *sock,
 	     struct vm_area_struct *vma);
+int tcp_zerocopy_recv(struct sock *sk, struct tcp_zerocopy_receive *zc,
+		      bool nonblock);
 #endif
 void tcp_parse_options(const struct net *net, const struct sk_buff *skb,
 		       struct tcp_options_received *opt_rx,
@@ -635,11 +637,15 @@ void tcp_check_space(struct sock *sk);
 
 /* tcp_timer.c */
 void tcp_init_xmit_timers(struct sock *);
+void tcp_pacing_wheel_cancel(struct sock *sk);
 static inline void tcp_clear_xmit_timers(struct sock *sk)
 {
 	if (hrtimer_try_to_cancel(&tcp_sk(sk)->pacing_timer) == 1)
 		__sock_put(sk);
 
+	if (test_bit(TCP_PACING_QUEUED, &sk->sk_tsq_flags))
+		tcp_pacing_wheel_cancel(sk);
+
 	if (hrtimer_try_to_cancel(&tcp_sk(sk)->compressed_ack_timer) == 1)
 		__sock_put(sk);
 
@@ -106,12 +106,18 @@ struct tls_sw_context_tx {
 	struct crypto_wait async_wait;
 	struct tx_work tx_work;
 	struct tls_rec *open_rec;
+	/* a transmitted record kept for reuse, under the socket lock */
+	struct tls_rec *free_rec;
 	struct list_head tx_list;
 	atomic_t encrypt_pending;
 	/* protect crypto_wait with encrypt_pending */
 	spinlock_t encrypt_compl_lock;
 	int async_notify;
 	u8 async_capable:1;
+	/* sendmsg() has more full records to encrypt right after this one */
+	u8 tx_batch:1;
+	/* records encrypted but not yet handed to TCP */
+	u8 tx_batched;
 
 #define BIT_TX_SCHEDULED	0
 #define BIT_TX_CLOSING		1
@@ -72,6 +72,9 @@ enum xdp_buff_flags {
 	XDP_FLAGS_FRAGS_PF_MEMALLOC	= BIT(1), /* xdp paged memory is under
 						   * pressure
 						   */
+	XDP_FLAGS_RX_METADATA		= BIT(2), /* rxq->dev's xdp_metadata_ops
+						   * apply, never kept in frames
+						   */
 };
 
 struct xdp_buff {
@@ -110,6 +113,16 @@ static __always_inline void xdp_buff_set_frag_pfmemalloc(struct xdp_buff *xdp)
 	xdp->flags |= XDP_FLAGS_FRAGS_PF_MEMALLOC;
 }
 
+static __always_inline bool xdp_buff_has_rx_metadata(struct xdp_buff *xdp)
+{
+	return !!(xdp->flags & XDP_FLAGS_RX_METADATA);
+}
+
+static __always_inline void xdp_buff_set_rx_metadata(struct xdp_buff *xdp)
+{
+	xdp->flags |= XDP_FLAGS_RX_METADATA;
+}
+
 static __always_inline void
 xdp_init_buff(struct xdp_buff *xdp, u32 frame_sz, struct xdp_rxq_info *rxq)
 {
@@ -280,7 +293,7 @@ int xdp_update_frame_from_buff(struct xdp_buff *xdp,
 	xdp_frame->headroom = headroom - sizeof(*xdp_frame);
 	xdp_frame->metasize = metasize;
 	xdp_frame->frame_sz = xdp->frame_sz;
-	xdp_frame->flags = xdp->flags;
+	xdp_frame->flags = xdp->flags & ~XDP_FLAGS_RX_METADATA;
 
 	return 0;
 }
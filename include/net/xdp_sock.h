@@ -33,6 +33,12 @@ struct xdp_umem {
 	int id;
 	struct list_head xsk_dma_list;
 	struct work_struct work;
+	/* Fill ring entries given up by one queue for the others to use,
+	 * with XDP_UMEM_BALANCE_FILL_FLAG.
+	 */
+	spinlock_t spare_lock;
+	u32 spare_cnt;
+	u64 *spare;
 };
 
 struct xsk_map {
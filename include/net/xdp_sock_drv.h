@@ -38,7 +38,26 @@ static inline u32 xsk_pool_get_chunk_size(struct xsk_buff_pool *pool)
 
 static inline u32 xsk_pool_get_rx_frame_size(struct xsk_buff_pool *pool)
 {
-	return xsk_pool_get_chunk_size(pool) - xsk_pool_get_headroom(pool);
+	u32 frame_size = xsk_pool_get_chunk_size(pool) -
+			 xsk_pool_get_headroom(pool);
+
+	/* The skb_shared_info of a multi-buffer packet lives at the end of
+	 * its first chunk, keep the hardware off it.
+	 */
+	if (pool->sg)
+		frame_size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+
+	return frame_size;
+}
+
+static inline u32 xsk_pool_get_max_segs(struct xsk_buff_pool *pool)
+{
+	return pool->max_segs;
+}
+
+static inline bool xsk_is_eop_desc(struct xdp_desc *desc)
+{
+	return !xp_mb_desc(desc);
 }
 
 static inline void xsk_pool_set_rxq_info(struct xsk_buff_pool *pool,
@@ -103,15 +122,91 @@ static inline bool xsk_buff_can_alloc(struct xsk_buff_pool *pool, u32 count)
 static inline void xsk_buff_free(struct xdp_buff *xdp)
 {
 	struct xdp_buff_xsk *xskb = container_of(xdp, struct xdp_buff_xsk, xdp);
+	struct list_head *xskb_list = &xskb->pool->xskb_list;
+	struct xdp_buff_xsk *pos, *tmp;
+
+	if (likely(!xdp_buff_has_frags(xdp)))
+		goto out;
+
+	list_for_each_entry_safe(pos, tmp, xskb_list, xskb_list_node) {
+		list_del(&pos->xskb_list_node);
+		xp_free(pos);
+	}
 
+	xdp_get_shared_info_from_buff(xdp)->nr_frags = 0;
+	xdp_buff_clear_frags_flag(xdp);
+out:
 	xp_free(xskb);
 }
 
+/* Chain @frag, the next buffer of the packet being received into @first,
+ * onto it. Returns false when the packet cannot take more fragments, in
+ * which case the driver drops it with xsk_buff_free(@first) and frees @frag.
+ */
+static inline bool xsk_buff_add_frag(struct xdp_buff *first,
+				     struct xdp_buff *frag)
+{
+	struct xdp_buff_xsk *xskb = container_of(frag, struct xdp_buff_xsk, xdp);
+	struct skb_shared_info *sinfo = xdp_get_shared_info_from_buff(first);
+	struct xsk_buff_pool *pool = xskb->pool;
+	u32 size = frag->data_end - frag->data;
+	u64 addr = frag->data - pool->addrs;
+
+	if (!xdp_buff_has_frags(first)) {
+		sinfo->nr_frags = 0;
+		sinfo->xdp_frags_size = 0;
+		xdp_buff_set_frags_flag(first);
+	}
+
+	if (unlikely(sinfo->nr_frags + 1 >= pool->max_segs))
+		return false;
+
+	__skb_fill_page_desc_noacc(sinfo, sinfo->nr_frags++,
+				   pool->umem->pgs[addr >> PAGE_SHIFT],
+				   offset_in_page(frag->data), size);
+	sinfo->xdp_frags_size += size;
+	list_add_tail(&xskb->xskb_list_node, &pool->xskb_list);
+	return true;
+}
+
+/* Unlink and return the first fragment chained onto @first, if any */
+static inline struct xdp_buff *xsk_buff_get_frag(struct xdp_buff *first)
+{
+	struct xdp_buff_xsk *xskb = container_of(first, struct xdp_buff_xsk, xdp);
+	struct xdp_buff_xsk *frag;
+
+	frag = list_first_entry_or_null(&xskb->pool->xskb_list,
+					struct xdp_buff_xsk, xskb_list_node);
+	if (!frag)
+		return NULL;
+
+	list_del(&frag->xskb_list_node);
+	return &frag->xdp;
+}
+
+static inline struct xdp_buff *xsk_buff_get_tail(struct xdp_buff *first)
+{
+	struct xdp_buff_xsk *xskb = container_of(first, struct xdp_buff_xsk, xdp);
+	struct xdp_buff_xsk *frag;
+
+	frag = list_last_entry(&xskb->pool->xskb_list, struct xdp_buff_xsk,
+			       xskb_list_node);
+	return &frag->xdp;
+}
+
+static inline void xsk_buff_del_tail(struct xdp_buff *tail)
+{
+	struct xdp_buff_xsk *xskb = container_of(tail, struct xdp_buff_xsk, xdp);
+
+	list_del(&xskb->xskb_list_node);
+}
+
 static inline void xsk_buff_set_size(struct xdp_buff *xdp, u32 size)
 {
 	xdp->data = xdp->data_hard_start + XDP_PACKET_HEADROOM;
 	xdp->data_meta = xdp->data;
 	xdp->data_end = xdp->data + size;
+	xdp->flags = 0;
 }
 
 static inline dma_addr_t xsk_buff_raw_get_dma(struct xsk_buff_pool *pool,
@@ -205,6 +300,16 @@ static inline u32 xsk_pool_get_rx_frame_size(struct xsk_buff_pool *pool)
 	return 0;
 }
 
+static inline u32 xsk_pool_get_max_segs(struct xsk_buff_pool *pool)
+{
+	return 0;
+}
+
+static inline bool xsk_is_eop_desc(struct xdp_desc *desc)
+{
+	return true;
+}
+
 static inline void xsk_pool_set_rxq_info(struct xsk_buff_pool *pool,
 					 struct xdp_rxq_info *rxq)
 {
@@ -255,6 +360,26 @@ static inline void xsk_buff_free(struct xdp_buff *xdp)
 {
 }
 
+static inline bool xsk_buff_add_frag(struct xdp_buff *first,
+				     struct xdp_buff *frag)
+{
+	return false;
+}
+
+static inline struct xdp_buff *xsk_buff_get_frag(struct xdp_buff *first)
+{
+	return NULL;
+}
+
+static inline struct xdp_buff *xsk_buff_get_tail(struct xdp_buff *first)
+{
+	return NULL;
+}
+
+static inline void xsk_buff_del_tail(struct xdp_buff *tail)
+{
+}
+
 static inline void xsk_buff_discard(struct xdp_buff *xdp)
 {
 }
@@ -26,6 +26,8 @@ struct xdp_buff_xsk {
 	struct xsk_buff_pool *pool;
 	u64 orig_addr;
 	struct list_head free_list_node;
+	/* Entry on pool->xskb_list while a fragment of a packet */
+	struct list_head xskb_list_node;
 };
 
 struct xsk_dma_map {
@@ -61,6 +63,8 @@ struct xsk_buff_pool {
 	dma_addr_t *dma_pages;
 	struct xdp_buff_xsk *heads;
 	struct xdp_desc *tx_descs;
+	/* Buffers after the first one of the packet being received */
+	struct list_head xskb_list;
 	u64 chunk_mask;
 	u64 addrs_cnt;
 	u32 free_list_cnt;
@@ -70,10 +74,13 @@ struct xsk_buff_pool {
 	u32 chunk_size;
 	u32 chunk_shift;
 	u32 frame_len;
+	/* Longest chain of descriptors a packet may use */
+	u32 max_segs;
 	u8 cached_need_wakeup;
 	bool uses_need_wakeup;
 	bool dma_need_sync;
 	bool unaligned;
+	bool sg;
 	void *addrs;
 	/* Mutual exclusion of the completion ring in the SKB mode. Two cases to protect:
 	 * NAPI TX thread and sendmsg error paths in the SKB destructor callback and when
@@ -216,6 +223,11 @@ static inline void xp_release(struct xdp_buff_xsk *xskb)
 		xskb->pool->free_heads[xskb->pool->free_heads_cnt++] = xskb;
 }
 
+static inline bool xp_mb_desc(struct xdp_desc *desc)
+{
+	return desc->options & XDP_PKT_CONTD;
+}
+
 static inline u64 xp_get_handle(struct xdp_buff_xsk *xskb)
 {
 	u64 offset = xskb->xdp.data - xskb->xdp.data_hard_start;
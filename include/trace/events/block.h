@@ -245,6 +245,72 @@ DEFINE_EVENT(block_rq, block_rq_merge,
 	TP_ARGS(rq)
 );
 
+DECLARE_EVENT_CLASS(block_rq_tag,
+
+	TP_PROTO(struct request *rq),
+
+	TP_ARGS(rq),
+
+	TP_STRUCT__entry(
+		__field(  dev_t,	dev			)
+		__field(  sector_t,	sector			)
+		__field(  unsigned int,	nr_sector		)
+		__field(  unsigned int,	hctx			)
+		__field(  int,		tag			)
+		__field(  int,		internal_tag		)
+		__field(  u64,		cgroup			)
+		__array(  char,		rwbs,	RWBS_LEN	)
+	),
+
+	TP_fast_assign(
+		__entry->dev	      = rq->q->disk ? disk_devt(rq->q->disk) : 0;
+		__entry->sector       = blk_rq_trace_sector(rq);
+		__entry->nr_sector    = blk_rq_trace_nr_sectors(rq);
+		__entry->hctx	      = rq->mq_hctx ? rq->mq_hctx->queue_num : 0;
+		__entry->tag	      = rq->tag;
+		__entry->internal_tag = rq->internal_tag;
+		__entry->cgroup	      = blk_rq_trace_cgroup_id(rq);
+
+		blk_fill_rwbs(__entry->rwbs, rq->cmd_flags);
+	),
+
+	TP_printk("%d,%d %s %llu + %u hctx=%u tag=%d sched_tag=%d cgroup=%llu",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  __entry->rwbs, (unsigned long long)__entry->sector,
+		  __entry->nr_sector, __entry->hctx, __entry->tag,
+		  __entry->internal_tag, (unsigned long long)__entry->cgroup)
+);
+
+/**
+ * block_rq_alloc - allocate a block IO request
+ * @rq: block IO operation request
+ *
+ * Called when the request @rq got its tag, either a driver tag or, with
+ * an I/O scheduler, a scheduler tag.  The request has no bio yet, so
+ * the sector and the cgroup are not known at this point.
+ */
+DEFINE_EVENT(block_rq_tag, block_rq_alloc,
+
+	TP_PROTO(struct request *rq),
+
+	TP_ARGS(rq)
+);
+
+/**
+ * block_rq_dispatch - dispatch a block IO request to the device driver
+ * @rq: block IO operation request
+ *
+ * Called right before the request @rq, holding a driver tag, is handed
+ * to the ->queue_rq() or ->queue_rqs() handler of the driver.  The time
+ * to the following block_rq_issue is spent in the driver.
+ */
+DEFINE_EVENT(block_rq_tag, block_rq_dispatch,
+
+	TP_PROTO(struct request *rq),
+
+	TP_ARGS(rq)
+);
+
 /**
  * block_bio_complete - completed all work on the block operation
  * @q: queue holding the block operation
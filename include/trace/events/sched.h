@@ -735,6 +735,14 @@ DECLARE_TRACE(sched_update_nr_running_tp,
 	TP_PROTO(struct rq *rq, int change),
 	TP_ARGS(rq, change));
 
+DECLARE_TRACE(sched_ttwu_queue_tp,
+	TP_PROTO(struct task_struct *p, int cpu),
+	TP_ARGS(p, cpu));
+
+DECLARE_TRACE(sched_wakeup_preempt_tp,
+	TP_PROTO(struct task_struct *p, bool preempt),
+	TP_ARGS(p, preempt));
+
 #endif /* _TRACE_SCHED_H */
 
 /* This part must be outside protection */
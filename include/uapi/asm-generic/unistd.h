@@ -886,8 +886,15 @@ __SYSCALL(__NR_futex_waitv, sys_futex_waitv)
 #define __NR_set_mempolicy_home_node 450
 __SYSCALL(__NR_set_mempolicy_home_node, sys_set_mempolicy_home_node)
 
+#define __NR_futex_wake 451
+__SYSCALL(__NR_futex_wake, sys_futex_wake)
+#define __NR_futex_wait 452
+__SYSCALL(__NR_futex_wait, sys_futex_wait)
+#define __NR_futex_requeue 453
+__SYSCALL(__NR_futex_requeue, sys_futex_requeue)
+
 #undef __NR_syscalls
-#define __NR_syscalls 451
+#define __NR_syscalls 454
 
 /*
  * 32 bit systems traditionally used different
@@ -18,6 +18,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -85,6 +86,34 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * Event ring, set up with EPIOCSRING and mapped with mmap() at offset 0 of
+ * the epoll file. Once it is set up, epoll_wait() publishes the ready
+ * events into the ring instead of copying them to its events argument, and
+ * returns the number of entries waiting in the ring. Edge-triggered events
+ * are published as they happen, with no epoll_wait() call.
+ *
+ * Userspace consumes the entries from head to tail, then stores the new head
+ * with release semantics. It only needs to call epoll_wait() once the ring
+ * is empty or when EPOLL_RING_OVERFLOW is set.
+ */
+struct epoll_ring {
+	__u32 head;		/* written by userspace */
+	__u32 resv1[15];
+	__u32 tail;		/* written by the kernel */
+	__u32 ring_entries;	/* power of 2 */
+	__u32 flags;
+	__u32 resv2[13];
+	struct epoll_event events[];
+};
+
+/* epoll_ring->flags */
+#define EPOLL_RING_OVERFLOW	(1U << 0)	/* events left for epoll_wait() */
+
+#define EPOLL_IOC_TYPE		0x8A
+/* Sets up an event ring of at least arg entries */
+#define EPIOCSRING		_IO(EPOLL_IOC_TYPE, 0x01)
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
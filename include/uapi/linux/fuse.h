@@ -201,6 +201,12 @@
  *  7.38
  *  - add FUSE_EXPIRE_ONLY flag to fuse_notify_inval_entry
  *  - add FOPEN_PARALLEL_DIRECT_WRITES
+ *
+ *  7.39
+ *  - add FUSE_IO_URING_CMD_REGISTER and FUSE_IO_URING_CMD_COMMIT_AND_FETCH
+ *  - add FUSE_PASSTHROUGH init flag and FOPEN_PASSTHROUGH open flag
+ *  - add backing_id to fuse_open_out, replacing padding
+ *  - add FUSE_DEV_IOC_BACKING_OPEN and FUSE_DEV_IOC_BACKING_CLOSE
  */
 
 #ifndef _LINUX_FUSE_H
@@ -236,7 +242,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 38
+#define FUSE_KERNEL_MINOR_VERSION 39
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -309,6 +315,7 @@ struct fuse_file_lock {
  * FOPEN_STREAM: the file is stream-like (no file position at all)
  * FOPEN_NOFLUSH: don't flush data cache on close (unless FUSE_WRITEBACK_CACHE)
  * FOPEN_PARALLEL_DIRECT_WRITES: Allow concurrent direct writes on the same inode
+ * FOPEN_PASSTHROUGH: pass reads, writes and mmap through to the backing file
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
@@ -317,6 +324,7 @@ struct fuse_file_lock {
 #define FOPEN_STREAM		(1 << 4)
 #define FOPEN_NOFLUSH		(1 << 5)
 #define FOPEN_PARALLEL_DIRECT_WRITES	(1 << 6)
+#define FOPEN_PASSTHROUGH	(1 << 7)
 
 /**
  * INIT request/reply flags
@@ -362,6 +370,7 @@ struct fuse_file_lock {
  * FUSE_SECURITY_CTX:	add security context to create, mkdir, symlink, and
  *			mknod
  * FUSE_HAS_INODE_DAX:  use per inode DAX
+ * FUSE_PASSTHROUGH: kernel supports passthrough of I/O to backing files
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -398,6 +407,7 @@ struct fuse_file_lock {
 /* bits 32..63 get shifted down 32 bits into the flags2 field */
 #define FUSE_SECURITY_CTX	(1ULL << 32)
 #define FUSE_HAS_INODE_DAX	(1ULL << 33)
+#define FUSE_PASSTHROUGH	(1ULL << 34)
 
 /**
  * CUSE INIT request/reply flags
@@ -679,7 +689,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	int32_t		backing_id;
 };
 
 struct fuse_release_in {
@@ -966,9 +976,59 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+/*
+ * Register an open file as backing file for FOPEN_PASSTHROUGH, the ioctl
+ * returns the backing ID to put in fuse_open_out.
+ */
+struct fuse_backing_map {
+	int32_t		fd;
+	uint32_t	flags;
+	uint64_t	padding;
+};
+
 /* Device ioctls: */
 #define FUSE_DEV_IOC_MAGIC		229
 #define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
+#define FUSE_DEV_IOC_BACKING_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 1, \
+					     struct fuse_backing_map)
+#define FUSE_DEV_IOC_BACKING_CLOSE	_IOW(FUSE_DEV_IOC_MAGIC, 2, uint32_t)
+
+/*
+ * io_uring commands on the /dev/fuse file, the ring must be set up with
+ * IORING_SETUP_SQE128.
+ *
+ * The server registers request buffers ("entries") on per CPU queues, qid
+ * being the CPU.  Once every possible CPU has a queue, requests are put into
+ * the buffers of the queue of the CPU they are sent from, in the format
+ * read() of /dev/fuse returns, and the command of the entry completes.  The
+ * server writes the reply into the same buffer, in the format write() takes,
+ * and submits FUSE_IO_URING_CMD_COMMIT_AND_FETCH with the unique ID of the
+ * request, which completes when the next request is in the buffer.  An
+ * entry whose command fails is dropped and has to be registered again.
+ *
+ * FORGET and INTERRUPT requests, and requests taking no reply, are still
+ * read from /dev/fuse.
+ */
+enum fuse_uring_cmd {
+	FUSE_IO_URING_CMD_INVALID		= 0,
+	FUSE_IO_URING_CMD_REGISTER		= 1,
+	FUSE_IO_URING_CMD_COMMIT_AND_FETCH	= 2,
+};
+
+struct fuse_uring_cmd_req {
+	uint64_t	flags;
+
+	/* Buffer of the entry, for FUSE_IO_URING_CMD_REGISTER */
+	uint64_t	buf_addr;
+	uint32_t	buf_len;
+
+	/* Queue of the entry */
+	uint16_t	qid;
+	uint16_t	padding;
+
+	/* Request the reply is for, for FUSE_IO_URING_CMD_COMMIT_AND_FETCH */
+	uint64_t	commit_id;
+};
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -44,10 +44,31 @@
 					 FUTEX_PRIVATE_FLAG)
 
 /*
- * Flags to specify the bit length of the futex word for futex2 syscalls.
- * Currently, only 32 is supported.
+ * Flags for futex2 syscalls.
+ *
+ * The size of the futex word, naturally aligned. 64-bit futexes are only
+ * supported on 64-bit kernels.
+ */
+#define FUTEX2_SIZE_U8		0x00
+#define FUTEX2_SIZE_U16		0x01
+#define FUTEX2_SIZE_U32		0x02
+#define FUTEX2_SIZE_U64		0x03
+#define FUTEX2_SIZE_MASK	0x03
+
+/*
+ * The futex word is followed by a word of the same size holding the NUMA
+ * node whose memory should host the waiter queue, or FUTEX_NO_NODE (all
+ * bits set) to let the kernel choose. All the waiters and wakers of a futex
+ * must agree on its node.
  */
-#define FUTEX_32		2
+#define FUTEX2_NUMA		0x04
+
+#define FUTEX2_PRIVATE		FUTEX_PRIVATE_FLAG
+
+#define FUTEX_NO_NODE		(-1)
+
+/* The old name of FUTEX2_SIZE_U32 */
+#define FUTEX_32		FUTEX2_SIZE_U32
 
 /*
  * Max numbers of elements in a futex_waitv array
@@ -25,9 +25,20 @@
  * application.
  */
 #define XDP_USE_NEED_WAKEUP (1 << 3)
+/* By setting this option, userspace application indicates that it can
+ * handle packets spread over multiple buffers, chained with the
+ * XDP_PKT_CONTD option in the Rx and Tx descriptors. In zero-copy mode
+ * this needs driver support; binding with XDP_ZEROCOPY fails with
+ * EOPNOTSUPP on devices without it, and falls back to copy mode otherwise.
+ */
+#define XDP_USE_SG	(1 << 4)
 
 /* Flags for xsk_umem_config flags */
 #define XDP_UMEM_UNALIGNED_CHUNK_FLAG (1 << 0)
+/* Let the queues sharing the umem pass fill ring entries to each other, so
+ * that buffers follow the traffic instead of sitting in idle fill rings.
+ */
+#define XDP_UMEM_BALANCE_FILL_FLAG (1 << 1)
 
 struct sockaddr_xdp {
 	__u16 sxdp_family;
@@ -106,6 +117,9 @@ struct xdp_desc {
 	__u32 options;
 };
 
+/* Flag indicating packet constitutes of multiple buffers */
+#define XDP_PKT_CONTD (1 << 0)
+
 /* UMEM descriptor is __u64 */
 
 #endif /* _LINUX_IF_XDP_H */
@@ -173,6 +173,20 @@ enum {
  */
 #define IORING_SETUP_DEFER_TASKRUN	(1U << 13)
 
+/*
+ * Let the SQPOLL thread go to sleep early if submissions don't usually
+ * arrive within sq_thread_idle, rather than spinning for the whole idle
+ * period. Only applies when a new SQPOLL thread is created.
+ */
+#define IORING_SETUP_SQPOLL_ADAPTIVE	(1U << 14)
+
+/*
+ * Keep per-opcode histograms of the time from submission to completion,
+ * split by whether the request completed inline, waited on poll or was
+ * punted to io-wq. Shown in the ring's fdinfo.
+ */
+#define IORING_SETUP_LAT_STATS		(1U << 15)
+
 enum io_uring_op {
 	IORING_OP_NOP,
 	IORING_OP_READV,
@@ -223,6 +237,9 @@ enum io_uring_op {
 	IORING_OP_URING_CMD,
 	IORING_OP_SEND_ZC,
 	IORING_OP_SENDMSG_ZC,
+	IORING_OP_RECV_ZC,
+	IORING_OP_SPLICE_DIRECT,
+	IORING_OP_GETDENTS_STATX,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -312,11 +329,22 @@ enum io_uring_op {
  *				0 is reported if zerocopy was actually possible.
  *				IORING_NOTIF_USAGE_ZC_COPIED if data was copied
  *				(at least partially).
+ *
+ * IORING_RECVSEND_BUNDLE	Used with IOSQE_BUFFER_SELECT and a ring
+ *				provided buffer group. A recv may fill several
+ *				consecutive buffers from the ring and post one
+ *				CQE for all of them. The buffer ID in cqe->flags
+ *				is the first buffer used, cqe->res the total
+ *				number of bytes. The buffers used are the ones
+ *				following that ID in ring order, up to the byte
+ *				count. Can be combined with
+ *				IORING_RECV_MULTISHOT.
  */
 #define IORING_RECVSEND_POLL_FIRST	(1U << 0)
 #define IORING_RECV_MULTISHOT		(1U << 1)
 #define IORING_RECVSEND_FIXED_BUF	(1U << 2)
 #define IORING_SEND_ZC_REPORT_USAGE	(1U << 3)
+#define IORING_RECVSEND_BUNDLE		(1U << 4)
 
 /*
  * cqe.res for IORING_CQE_F_NOTIF if
@@ -516,6 +544,13 @@ enum {
 	/* register a range of fixed file slots for automatic slot allocation */
 	IORING_REGISTER_FILE_ALLOC_RANGE	= 25,
 
+	/* register/unregister NAPI busy polling settings */
+	IORING_REGISTER_NAPI			= 26,
+	IORING_UNREGISTER_NAPI			= 27,
+
+	/* set the share of a shared SQPOLL thread this ring gets */
+	IORING_REGISTER_SQ_WEIGHT		= 28,
+
 	/* this goes last */
 	IORING_REGISTER_LAST
 };
@@ -685,6 +720,18 @@ struct io_uring_file_index_range {
 	__u64	resv;
 };
 
+/*
+ * Argument for IORING_(UN)REGISTER_NAPI. busy_poll_to is the busy poll
+ * budget, in usec, spent on the NAPI instances of polled sockets before
+ * io_uring_enter(2) goes to sleep waiting for completions.
+ */
+struct io_uring_napi {
+	__u32	busy_poll_to;
+	__u8	prefer_busy_poll;
+	__u8	pad[3];
+	__u64	resv;
+};
+
 struct io_uring_recvmsg_out {
 	__u32 namelen;
 	__u32 controllen;
@@ -158,8 +158,28 @@ enum membarrier_cmd {
 	MEMBARRIER_CMD_SHARED			= MEMBARRIER_CMD_GLOBAL,
 };
 
+/**
+ * enum membarrier_cmd_flag - membarrier system call command flags
+ * @MEMBARRIER_CMD_FLAG_CPU:
+ *                          Only restart the rseq critical section on the
+ *                          CPU given by the cpu_id argument. Only valid
+ *                          with MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ.
+ * @MEMBARRIER_CMD_FLAG_PIDFDS:
+ *                          Issue MEMBARRIER_CMD_PRIVATE_EXPEDITED,
+ *                          MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE or
+ *                          MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ on the
+ *                          processes referred to by the array of pidfds
+ *                          passed as fourth argument, instead of on the
+ *                          caller's process. The cpu_id argument holds the
+ *                          number of pidfds in the array. Every process must
+ *                          have registered for the command, and the caller
+ *                          needs PTRACE_MODE_READ access to it. All of the
+ *                          CPUs running one of the processes are interrupted
+ *                          in a single round.
+ */
 enum membarrier_cmd_flag {
 	MEMBARRIER_CMD_FLAG_CPU		= (1 << 0),
+	MEMBARRIER_CMD_FLAG_PIDFDS	= (1 << 1),
 };
 
 #endif /* _UAPI_LINUX_MEMBARRIER_H */
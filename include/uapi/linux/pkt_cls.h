@@ -196,6 +196,7 @@ enum {
 	TCA_POLICE_PEAKRATE64,
 	TCA_POLICE_PKTRATE64,
 	TCA_POLICE_PKTBURST64,
+	TCA_POLICE_BATCH,	/* u32, bytes a CPU takes from the bucket at once */
 	__TCA_POLICE_MAX
 #define TCA_POLICE_RESULT TCA_POLICE_RESULT
 };
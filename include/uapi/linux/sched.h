@@ -36,6 +36,7 @@
 /* Flags for the clone3() syscall. */
 #define CLONE_CLEAR_SIGHAND 0x100000000ULL /* Clear any signal handler and reset to SIG_DFL. */
 #define CLONE_INTO_CGROUP 0x200000000ULL /* Clone into a specific cgroup given the right permissions. */
+#define CLONE_SPAWN 0x400000000ULL /* Exec a new program in the child without copying the mm. */
 
 /*
  * cloning flags intersect with CSIGNAL so can be used with unshare and clone3
@@ -84,6 +85,9 @@
  *                kernel's limit of nested PID namespaces.
  * @cgroup:       If CLONE_INTO_CGROUP is specified set this to
  *                a file descriptor for the cgroup.
+ * @spawn:        If CLONE_SPAWN is specified set this to a pointer
+ *                to a struct clone_spawn_args describing the
+ *                program the child executes.
  *
  * The structure is versioned by size and thus extensible.
  * New struct members must go at the end of the struct and
@@ -101,12 +105,63 @@ struct clone_args {
 	__aligned_u64 set_tid;
 	__aligned_u64 set_tid_size;
 	__aligned_u64 cgroup;
+	__aligned_u64 spawn;
+};
+
+/**
+ * struct clone_spawn_fd - file descriptor action for CLONE_SPAWN
+ * @fd:    The descriptor to duplicate, or -1 to close @newfd.
+ * @newfd: The descriptor number in the child.  Unlike @fd it is
+ *         not close-on-exec after the duplication.
+ */
+struct clone_spawn_fd {
+	__s32 fd;
+	__s32 newfd;
+};
+
+/**
+ * struct clone_spawn_args - program executed by a CLONE_SPAWN child
+ * @filename:   Pointer to the path of the program, see execveat(2).
+ * @argv:       Pointer to the argument vector.
+ * @envp:       Pointer to the environment vector.
+ * @fds:        Pointer to an array of @nr_fds struct clone_spawn_fd
+ *              which are applied in order before the exec.
+ * @sigmask:    The signal mask of the child if CLONE_SPAWN_SETSIGMASK
+ *              is set, one bit per signal starting with signal 1.
+ * @nr_fds:     Number of elements in @fds.
+ * @dirfd:      Directory file descriptor, see execveat(2).
+ * @exec_flags: AT_* flags, see execveat(2).
+ * @flags:      CLONE_SPAWN_* flags.
+ *
+ * The child never runs in userspace before the exec and shares the
+ * parent's memory until then, so all pointers are interpreted in the
+ * parent's address space.  clone3() only returns once the exec has
+ * succeeded or failed.  On failure no child is left behind and the
+ * error of the failed step is returned.  The exec and the fd actions are
+ * carried out by the kernel and never reach a seccomp filter, so a task
+ * running under seccomp gets EPERM.
+ */
+struct clone_spawn_args {
+	__aligned_u64 filename;
+	__aligned_u64 argv;
+	__aligned_u64 envp;
+	__aligned_u64 fds;
+	__aligned_u64 sigmask;
+	__u32 nr_fds;
+	__s32 dirfd;
+	__u32 exec_flags;
+	__u32 flags;
 };
 #endif
 
 #define CLONE_ARGS_SIZE_VER0 64 /* sizeof first published struct */
 #define CLONE_ARGS_SIZE_VER1 80 /* sizeof second published struct */
 #define CLONE_ARGS_SIZE_VER2 88 /* sizeof third published struct */
+#define CLONE_ARGS_SIZE_VER3 96 /* sizeof fourth published struct */
+
+/* Flags for struct clone_spawn_args */
+#define CLONE_SPAWN_SETSID	0x01 /* Create a new session in the child. */
+#define CLONE_SPAWN_SETSIGMASK	0x02 /* Set the signal mask of the child. */
 
 /*
  * Scheduling policies
@@ -118,6 +173,7 @@ struct clone_args {
 /* SCHED_ISO: reserved but not implemented yet */
 #define SCHED_IDLE		5
 #define SCHED_DEADLINE		6
+#define SCHED_EXT		7
 
 /* Can be ORed in to make sure the process is reverted back to SCHED_NORMAL on fork */
 #define SCHED_RESET_ON_FORK     0x40000000
@@ -132,6 +188,7 @@ struct clone_args {
 #define SCHED_FLAG_KEEP_PARAMS		0x10
 #define SCHED_FLAG_UTIL_CLAMP_MIN	0x20
 #define SCHED_FLAG_UTIL_CLAMP_MAX	0x40
+#define SCHED_FLAG_LATENCY_NICE		0x80
 
 #define SCHED_FLAG_KEEP_ALL	(SCHED_FLAG_KEEP_POLICY | \
 				 SCHED_FLAG_KEEP_PARAMS)
@@ -143,6 +200,7 @@ struct clone_args {
 			 SCHED_FLAG_RECLAIM		| \
 			 SCHED_FLAG_DL_OVERRUN		| \
 			 SCHED_FLAG_KEEP_ALL		| \
-			 SCHED_FLAG_UTIL_CLAMP)
+			 SCHED_FLAG_UTIL_CLAMP		| \
+			 SCHED_FLAG_LATENCY_NICE)
 
 #endif /* _UAPI_LINUX_SCHED_H */
@@ -10,6 +10,7 @@ struct sched_param {
 
 #define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
 #define SCHED_ATTR_SIZE_VER1	56	/* add: util_{min,max} */
+#define SCHED_ATTR_SIZE_VER2	60	/* add: latency_nice */
 
 /*
  * Extended scheduling parameters data structure.
@@ -98,6 +99,21 @@ struct sched_param {
  * scheduled on a CPU with no more capacity than the specified value.
  *
  * A task utilization boundary can be reset by setting the attribute to -1.
+ *
+ * Latency Tolerance Attributes
+ * ============================
+ *
+ * A latency-nice attribute tells the scheduler how much the task cares about
+ * being picked quickly once it becomes runnable, independently of how much
+ * CPU bandwidth it gets:
+ *
+ *  @sched_latency_nice	task's latency_nice value
+ *
+ * The value is in the range [-20..19], like nice. A negative value makes a
+ * task preempt the running one sooner on wakeup, bounds how long it waits
+ * behind CPU bound tasks and favours fully idle cores when placing it. A
+ * positive value does the opposite. Lowering the value below the current one
+ * requires CAP_SYS_NICE. It is set when SCHED_FLAG_LATENCY_NICE is passed.
  */
 struct sched_attr {
 	__u32 size;
@@ -120,6 +136,8 @@ struct sched_attr {
 	__u32 sched_util_min;
 	__u32 sched_util_max;
 
+	/* latency requirement hints */
+	__s32 sched_latency_nice;
 };
 
 #endif /* _UAPI_LINUX_SCHED_TYPES_H */
@@ -131,6 +131,21 @@ struct statx {
 	/* 0x100 */
 };
 
+/*
+ * Directory entry returned by IORING_OP_GETDENTS_STATX: the fields of a
+ * linux_dirent64 with the statx attributes of the entry before the name.
+ * An entry that could not be looked up has a zero d_stx.stx_mask.
+ */
+struct dirent_statx {
+	__u64	d_ino;
+	__s64	d_off;		/* position of the next entry */
+	__u16	d_reclen;
+	__u8	d_type;
+	__u8	__spare[5];
+	struct statx d_stx;
+	char	d_name[];
+};
+
 /*
  * Flags to be stx_mask
  *
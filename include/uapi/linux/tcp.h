@@ -351,6 +351,10 @@ struct tcp_diag_md5sig {
 /* setsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, ...) */
 
 #define TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT 0x1
+/* Copy data preceding the first mappable page to copybuf, ahead of the
+ * mapped data, rather than data following the mapped data.
+ */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD 0x2
 struct tcp_zerocopy_receive {
 	__u64 address;		/* in: address of mapping */
 	__u32 length;		/* in/out: number of bytes to map/mapped */
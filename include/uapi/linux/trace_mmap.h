@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _TRACE_MMAP_H_
+#define _TRACE_MMAP_H_
+
+#include <linux/types.h>
+
+/**
+ * struct trace_buffer_meta - Ring-buffer Meta-page description
+ * @meta_page_size:	Size of this meta-page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each sub-buffer, including its header.
+ * @nr_subbufs:		Number of sub-buffers in the ring-buffer, including the reader.
+ * @reader.lost_events:	Number of events lost before the reader sub-buffer.
+ * @reader.id:		ID of the sub-buffer currently owned by the reader.
+ * @reader.read:	Number of bytes read on the reader sub-buffer.
+ * @flags:		Placeholder for now, 0 until new features are supported.
+ * @entries:		Number of entries in the ring-buffer.
+ * @overrun:		Number of entries lost in the ring-buffer.
+ * @read:		Number of entries that have been read.
+ * @Reserved1:		Reserved, 0.
+ * @Reserved2:		Reserved, 0.
+ *
+ * The meta-page is the first page of a trace_pipe_raw mapping, it is
+ * followed by the sub-buffers, ordered by ID. The reader sub-buffer
+ * is never written by the kernel unless the writer caught up with it.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+	} reader;
+
+	__u64	flags;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+
+	__u64	Reserved1;
+	__u64	Reserved2;
+};
+
+/*
+ * TRACE_MMAP_IOCTL_GET_READER - Get the next sub-buffer to read
+ *
+ * The reader sub-buffer described by the meta-page is considered
+ * consumed and a new one is swapped in from the ring-buffer. On return,
+ * the meta-page has been updated and the whole content of the new
+ * reader sub-buffer, up to its commit, can be read. A blocking file
+ * waits for data first.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('R', 0x20)
+
+#endif /* _TRACE_MMAP_H_ */
@@ -38,7 +38,8 @@
 			   UFFD_FEATURE_MINOR_HUGETLBFS |	\
 			   UFFD_FEATURE_MINOR_SHMEM |		\
 			   UFFD_FEATURE_EXACT_ADDRESS |		\
-			   UFFD_FEATURE_WP_HUGETLBFS_SHMEM)
+			   UFFD_FEATURE_WP_HUGETLBFS_SHMEM |	\
+			   UFFD_FEATURE_FAULT_RING)
 #define UFFD_API_IOCTLS				\
 	((__u64)1 << _UFFDIO_REGISTER |		\
 	 (__u64)1 << _UFFDIO_UNREGISTER |	\
@@ -48,12 +49,16 @@
 	 (__u64)1 << _UFFDIO_COPY |		\
 	 (__u64)1 << _UFFDIO_ZEROPAGE |		\
 	 (__u64)1 << _UFFDIO_WRITEPROTECT |	\
-	 (__u64)1 << _UFFDIO_CONTINUE)
+	 (__u64)1 << _UFFDIO_CONTINUE |		\
+	 (__u64)1 << _UFFDIO_COPYV |		\
+	 (__u64)1 << _UFFDIO_CONTINUEV)
 #define UFFD_API_RANGE_IOCTLS_BASIC		\
 	((__u64)1 << _UFFDIO_WAKE |		\
 	 (__u64)1 << _UFFDIO_COPY |		\
 	 (__u64)1 << _UFFDIO_CONTINUE |		\
-	 (__u64)1 << _UFFDIO_WRITEPROTECT)
+	 (__u64)1 << _UFFDIO_WRITEPROTECT |	\
+	 (__u64)1 << _UFFDIO_COPYV |		\
+	 (__u64)1 << _UFFDIO_CONTINUEV)
 
 /*
  * Valid ioctl command number range with this API is from 0x00 to
@@ -70,6 +75,8 @@
 #define _UFFDIO_ZEROPAGE		(0x04)
 #define _UFFDIO_WRITEPROTECT		(0x06)
 #define _UFFDIO_CONTINUE		(0x07)
+#define _UFFDIO_COPYV			(0x08)
+#define _UFFDIO_CONTINUEV		(0x09)
 #define _UFFDIO_API			(0x3F)
 
 /* userfaultfd ioctl ids */
@@ -90,6 +97,10 @@
 				      struct uffdio_writeprotect)
 #define UFFDIO_CONTINUE		_IOWR(UFFDIO, _UFFDIO_CONTINUE,	\
 				      struct uffdio_continue)
+#define UFFDIO_COPYV		_IOWR(UFFDIO, _UFFDIO_COPYV,	\
+				      struct uffdio_copyv)
+#define UFFDIO_CONTINUEV	_IOWR(UFFDIO, _UFFDIO_CONTINUEV, \
+				      struct uffdio_copyv)
 
 /* read() structure */
 struct uffd_msg {
@@ -132,6 +143,22 @@ struct uffd_msg {
 	} arg;
 } __packed;
 
+/*
+ * mmap() layout of the fault ring. The kernel advances "tail" after
+ * writing a message, userland advances "head" once it consumed one.
+ * The ring holds "mask" + 1 messages, the largest power of two that
+ * fits in the mapping after the header. "overflow" counts the faults
+ * that found the ring full and were queued for read() instead.
+ */
+struct uffd_ring {
+	__u32	head;
+	__u32	tail;
+	__u32	mask;
+	__u32	overflow;
+	__u64	reserved[6];
+	struct uffd_msg msgs[];
+};
+
 /*
  * Start at 0x12 and not at 0 to be more strict against bugs.
  */
@@ -203,6 +230,11 @@ struct uffdio_api {
 	 *
 	 * UFFD_FEATURE_WP_HUGETLBFS_SHMEM indicates that userfaultfd
 	 * write-protection mode is supported on both shmem and hugetlbfs.
+	 *
+	 * UFFD_FEATURE_FAULT_RING allows to mmap() the uffd to get a
+	 * struct uffd_ring. UFFD_EVENT_PAGEFAULT messages are then
+	 * appended to the ring instead of being returned by read(),
+	 * until the ring is full. Other events still go through read().
 	 */
 #define UFFD_FEATURE_PAGEFAULT_FLAG_WP		(1<<0)
 #define UFFD_FEATURE_EVENT_FORK			(1<<1)
@@ -217,6 +249,7 @@ struct uffdio_api {
 #define UFFD_FEATURE_MINOR_SHMEM		(1<<10)
 #define UFFD_FEATURE_EXACT_ADDRESS		(1<<11)
 #define UFFD_FEATURE_WP_HUGETLBFS_SHMEM		(1<<12)
+#define UFFD_FEATURE_FAULT_RING			(1<<13)
 	__u64 features;
 
 	__u64 ioctls;
@@ -306,6 +339,34 @@ struct uffdio_continue {
 	__s64 mapped;
 };
 
+struct uffdio_vec {
+	__u64 dst;
+	/* ignored by UFFDIO_CONTINUEV */
+	__u64 src;
+	__u64 len;
+};
+
+/*
+ * UFFDIO_COPYV and UFFDIO_CONTINUEV resolve up to UFFDIO_VEC_MAX
+ * ranges per call. "mode" takes the UFFDIO_COPY_MODE_* or the
+ * UFFDIO_CONTINUE_MODE_* flags and applies to every range. Ranges
+ * are resolved in order and the faults in all of them are woken at
+ * the end of the call.
+ */
+#define UFFDIO_VEC_MAX				1024
+struct uffdio_copyv {
+	__u64 vec;
+	__u64 nr;
+	__u64 mode;
+
+	/*
+	 * "copied" is written by the ioctl and must be at the end: the
+	 * bytes resolved over all ranges, or a negative error if none
+	 * could be.
+	 */
+	__s64 copied;
+};
+
 /*
  * Flags for the userfaultfd(2) system call itself.
  */
@@ -27,6 +27,22 @@ struct vhost_vring_file {
 
 };
 
+struct vhost_worker_state {
+	/*
+	 * For VHOST_NEW_WORKER the kernel returns the id of the new worker.
+	 * For VHOST_FREE_WORKER this must be set to the id of the worker to
+	 * free.
+	 */
+	unsigned int worker_id;
+};
+
+struct vhost_vring_worker {
+	/* vring index */
+	unsigned int index;
+	/* The id of a worker returned from VHOST_NEW_WORKER */
+	unsigned int worker_id;
+};
+
 struct vhost_vring_addr {
 	unsigned int index;
 	/* Option flags. */
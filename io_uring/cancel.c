@@ -221,7 +221,7 @@ static int __io_sync_cancel(struct io_uring_task *tctx,
 		if (unlikely(fd >= ctx->nr_user_files))
 			return -EBADF;
 		fd = array_index_nospec(fd, ctx->nr_user_files);
-		file_ptr = io_fixed_file_slot(&ctx->file_table, fd)->file_ptr;
+		file_ptr = io_fixed_file_ptr(&ctx->file_table, fd);
 		cd->file = (struct file *) (file_ptr & FFS_MASK);
 		if (!cd->file)
 			return -EBADF;
@@ -14,8 +14,44 @@
 #include "fdinfo.h"
 #include "cancel.h"
 #include "rsrc.h"
+#include "tctx.h"
 
 #ifdef CONFIG_PROC_FS
+static const char * const io_lat_path_names[IO_LAT_NR_PATHS] = {
+	[IO_LAT_INLINE]	= "inline",
+	[IO_LAT_POLL]	= "poll",
+	[IO_LAT_IOWQ]	= "iowq",
+};
+
+/*
+ * One line per opcode and issue path that saw completions, listing the
+ * counts of each latency bucket up to the last non-empty one.
+ */
+static __cold void io_uring_show_lat_stats(struct seq_file *m,
+					   struct io_lat_stats *stats)
+{
+	int op, path, i, last;
+
+	seq_puts(m, "Latency (usec, log2 buckets):\n");
+	for (op = 0; op < IORING_OP_LAST; op++) {
+		for (path = 0; path < IO_LAT_NR_PATHS; path++) {
+			u64 *hist = stats->hist[op][path];
+
+			for (last = IO_LAT_BUCKETS - 1; last >= 0; last--)
+				if (data_race(hist[last]))
+					break;
+			if (last < 0)
+				continue;
+
+			seq_printf(m, "  %s/%s:", io_uring_get_opcode(op),
+				   io_lat_path_names[path]);
+			for (i = 0; i <= last; i++)
+				seq_printf(m, " %llu", data_race(hist[i]));
+			seq_putc(m, '\n');
+		}
+	}
+}
+
 static __cold int io_uring_show_cred(struct seq_file *m, unsigned int id,
 		const struct cred *cred)
 {
@@ -170,8 +206,20 @@ static __cold void __io_uring_show_fdinfo(struct io_ring_ctx *ctx,
 		xa_for_each(&ctx->personalities, index, cred)
 			io_uring_show_cred(m, index, cred);
 	}
-	if (has_lock)
+	if (has_lock) {
+		unsigned long nr_stolen = 0;
+		struct io_tctx_node *node;
+
+		/* io_wq stays alive while we hold uring_lock */
+		list_for_each_entry(node, &ctx->tctx_list, ctx_node) {
+			struct io_uring_task *tctx = node->task->io_uring;
+
+			if (tctx && tctx->io_wq)
+				nr_stolen += io_wq_nr_stolen(tctx->io_wq);
+		}
+		seq_printf(m, "IoWqStolen:\t%lu\n", nr_stolen);
 		mutex_unlock(&ctx->uring_lock);
+	}
 
 	seq_puts(m, "PollList:\n");
 	for (i = 0; i < (1U << ctx->cancel_table.hash_bits); i++) {
@@ -196,6 +244,9 @@ static __cold void __io_uring_show_fdinfo(struct io_ring_ctx *ctx,
 	}
 
 	spin_unlock(&ctx->completion_lock);
+
+	if (ctx->lat_stats)
+		io_uring_show_lat_stats(m, ctx->lat_stats);
 }
 
 __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
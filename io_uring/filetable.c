@@ -13,48 +13,119 @@
 #include "rsrc.h"
 #include "filetable.h"
 
+/*
+ * Find a free slot in [from, to), skipping over chunks that are full without
+ * looking at their slots.
+ */
+static int io_file_table_find(struct io_file_table *table, unsigned int from,
+			      unsigned int to)
+{
+	unsigned int nr_chunks = DIV_ROUND_UP(table->nr_files, IO_FILE_TABLE_MAX);
+
+	while (from < to) {
+		unsigned int chunk = from >> IO_FILE_TABLE_SHIFT;
+		unsigned int end;
+		unsigned long bit;
+
+		if (test_bit(chunk, table->full_map)) {
+			chunk = find_next_zero_bit(table->full_map, nr_chunks,
+						   chunk);
+			if (chunk >= nr_chunks)
+				break;
+			from = chunk << IO_FILE_TABLE_SHIFT;
+			if (from >= to)
+				break;
+		}
+
+		end = min((chunk + 1) << IO_FILE_TABLE_SHIFT, to);
+		bit = find_next_zero_bit(table->bitmap, end, from);
+		if (bit < end)
+			return bit;
+		from = end;
+	}
+
+	return -ENFILE;
+}
+
 static int io_file_bitmap_get(struct io_ring_ctx *ctx)
 {
 	struct io_file_table *table = &ctx->file_table;
-	unsigned long nr = ctx->file_alloc_end;
+	unsigned int start = ctx->file_alloc_start;
+	unsigned int end = ctx->file_alloc_end;
+	unsigned int hint = table->alloc_hint;
 	int ret;
 
-	do {
-		ret = find_next_zero_bit(table->bitmap, nr, table->alloc_hint);
-		if (ret != nr)
-			return ret;
-
-		if (table->alloc_hint == ctx->file_alloc_start)
-			break;
-		nr = table->alloc_hint;
-		table->alloc_hint = ctx->file_alloc_start;
-	} while (1);
+	if (hint < start || hint >= end)
+		hint = start;
 
-	return -ENFILE;
+	ret = io_file_table_find(table, hint, end);
+	if (ret < 0 && hint != start)
+		ret = io_file_table_find(table, start, hint);
+	return ret;
 }
 
 bool io_alloc_file_tables(struct io_file_table *table, unsigned nr_files)
 {
-	table->files = kvcalloc(nr_files, sizeof(table->files[0]),
+	unsigned int nr_chunks = DIV_ROUND_UP(nr_files, IO_FILE_TABLE_MAX);
+
+	table->files = kvcalloc(nr_chunks, sizeof(table->files[0]),
 				GFP_KERNEL_ACCOUNT);
 	if (unlikely(!table->files))
 		return false;
 
 	table->bitmap = bitmap_zalloc(nr_files, GFP_KERNEL_ACCOUNT);
-	if (unlikely(!table->bitmap)) {
-		kvfree(table->files);
-		return false;
-	}
+	if (unlikely(!table->bitmap))
+		goto free_files;
+
+	table->full_map = bitmap_zalloc(nr_chunks, GFP_KERNEL_ACCOUNT);
+	if (unlikely(!table->full_map))
+		goto free_bitmap;
 
+	table->nr_files = nr_files;
 	return true;
+free_bitmap:
+	bitmap_free(table->bitmap);
+	table->bitmap = NULL;
+free_files:
+	kvfree(table->files);
+	table->files = NULL;
+	return false;
 }
 
 void io_free_file_tables(struct io_file_table *table)
 {
+	unsigned int i, nr_chunks = DIV_ROUND_UP(table->nr_files,
+						 IO_FILE_TABLE_MAX);
+
+	for (i = 0; table->files && i < nr_chunks; i++)
+		kfree(table->files[i]);
 	kvfree(table->files);
 	bitmap_free(table->bitmap);
+	bitmap_free(table->full_map);
 	table->files = NULL;
 	table->bitmap = NULL;
+	table->full_map = NULL;
+	table->nr_files = 0;
+}
+
+/*
+ * Get slot @i for installing a file, populating its chunk if this is the
+ * first file going into it. Chunks stay around until the table is freed.
+ */
+struct io_fixed_file *io_fixed_file_slot_alloc(struct io_file_table *table,
+					       unsigned int i)
+{
+	struct io_fixed_file **chunk = &table->files[i >> IO_FILE_TABLE_SHIFT];
+
+	if (unlikely(!*chunk)) {
+		unsigned int nr = min(table->nr_files - (i & ~IO_FILE_TABLE_MASK),
+				      IO_FILE_TABLE_MAX);
+
+		*chunk = kcalloc(nr, sizeof(**chunk), GFP_KERNEL_ACCOUNT);
+		if (!*chunk)
+			return NULL;
+	}
+	return &(*chunk)[i & IO_FILE_TABLE_MASK];
 }
 
 static int io_install_fixed_file(struct io_ring_ctx *ctx, struct file *file,
@@ -73,7 +144,9 @@ static int io_install_fixed_file(struct io_ring_ctx *ctx, struct file *file,
 		return -EINVAL;
 
 	slot_index = array_index_nospec(slot_index, ctx->nr_user_files);
-	file_slot = io_fixed_file_slot(&ctx->file_table, slot_index);
+	file_slot = io_fixed_file_slot_alloc(&ctx->file_table, slot_index);
+	if (!file_slot)
+		return -ENOMEM;
 
 	if (file_slot->file_ptr) {
 		struct file *old_file;
@@ -158,11 +231,11 @@ int io_fixed_fd_remove(struct io_ring_ctx *ctx, unsigned int offset)
 		return ret;
 
 	offset = array_index_nospec(offset, ctx->nr_user_files);
-	file_slot = io_fixed_file_slot(&ctx->file_table, offset);
-	if (!file_slot->file_ptr)
+	file = io_file_from_index(&ctx->file_table, offset);
+	if (!file)
 		return -EBADF;
 
-	file = (struct file *)(file_slot->file_ptr & FFS_MASK);
+	file_slot = io_fixed_file_slot(&ctx->file_table, offset);
 	ret = io_queue_rsrc_removal(ctx->file_data, offset, ctx->rsrc_node, file);
 	if (ret)
 		return ret;
@@ -9,8 +9,14 @@
 #define FFS_ISREG		0x2UL
 #define FFS_MASK		~(FFS_NOWAIT|FFS_ISREG)
 
+#define IO_FILE_TABLE_SHIFT	(PAGE_SHIFT - 3)
+#define IO_FILE_TABLE_MAX	(1U << IO_FILE_TABLE_SHIFT)
+#define IO_FILE_TABLE_MASK	(IO_FILE_TABLE_MAX - 1)
+
 bool io_alloc_file_tables(struct io_file_table *table, unsigned nr_files);
 void io_free_file_tables(struct io_file_table *table);
+struct io_fixed_file *io_fixed_file_slot_alloc(struct io_file_table *table,
+					       unsigned int i);
 
 int io_fixed_fd_install(struct io_kiocb *req, unsigned int issue_flags,
 			struct file *file, unsigned int file_slot);
@@ -27,28 +33,47 @@ static inline void io_file_bitmap_clear(struct io_file_table *table, int bit)
 {
 	WARN_ON_ONCE(!test_bit(bit, table->bitmap));
 	__clear_bit(bit, table->bitmap);
+	__clear_bit(bit >> IO_FILE_TABLE_SHIFT, table->full_map);
 	table->alloc_hint = bit;
 }
 
 static inline void io_file_bitmap_set(struct io_file_table *table, int bit)
 {
+	unsigned int start = bit & ~IO_FILE_TABLE_MASK;
+	unsigned int end = min(start + IO_FILE_TABLE_MAX, table->nr_files);
+
 	WARN_ON_ONCE(test_bit(bit, table->bitmap));
 	__set_bit(bit, table->bitmap);
+	if (find_next_zero_bit(table->bitmap, end, start) == end)
+		__set_bit(bit >> IO_FILE_TABLE_SHIFT, table->full_map);
 	table->alloc_hint = bit + 1;
 }
 
+/*
+ * Only valid for slots whose chunk has been populated already, which is the
+ * case for any slot holding a file. Use io_fixed_file_slot_alloc() to
+ * install into a slot, or io_fixed_file_ptr() for a lookup.
+ */
 static inline struct io_fixed_file *
 io_fixed_file_slot(struct io_file_table *table, unsigned i)
 {
-	return &table->files[i];
+	return &table->files[i >> IO_FILE_TABLE_SHIFT][i & IO_FILE_TABLE_MASK];
+}
+
+static inline unsigned long io_fixed_file_ptr(struct io_file_table *table,
+					      unsigned i)
+{
+	struct io_fixed_file *chunk = table->files[i >> IO_FILE_TABLE_SHIFT];
+
+	if (!chunk)
+		return 0;
+	return chunk[i & IO_FILE_TABLE_MASK].file_ptr;
 }
 
 static inline struct file *io_file_from_index(struct io_file_table *table,
 					      int index)
 {
-	struct io_fixed_file *slot = io_fixed_file_slot(table, index);
-
-	return (struct file *) (slot->file_ptr & FFS_MASK);
+	return (struct file *) (io_fixed_file_ptr(table, index) & FFS_MASK);
 }
 
 static inline void io_fixed_file_set(struct io_fixed_file *file_slot,
@@ -23,6 +23,9 @@
 
 #define WORKER_IDLE_TIMEOUT	(5 * HZ)
 
+/* max work items a worker takes from other nodes before rechecking its own */
+#define IO_WQ_STEAL_MAX		8
+
 enum {
 	IO_WORKER_F_UP		= 1,	/* up and active */
 	IO_WORKER_F_RUNNING	= 2,	/* account as running */
@@ -127,6 +130,9 @@ struct io_wq {
 
 	struct task_struct *task;
 
+	/* work items run by a worker of another node than they were queued on */
+	atomic_long_t nr_stolen;
+
 	struct io_wqe *wqes[];
 };
 
@@ -464,13 +470,12 @@ static bool io_wait_on_hash(struct io_wqe *wqe, unsigned int hash)
 }
 
 static struct io_wq_work *io_get_next_work(struct io_wqe_acct *acct,
-					   struct io_worker *worker)
+					   struct io_wqe *wqe)
 	__must_hold(acct->lock)
 {
 	struct io_wq_work_node *node, *prev;
 	struct io_wq_work *work, *tail;
 	unsigned int stall_hash = -1U;
-	struct io_wqe *wqe = worker->wqe;
 
 	wq_list_for_each(node, prev, &acct->work_list) {
 		unsigned int hash;
@@ -520,6 +525,100 @@ static struct io_wq_work *io_get_next_work(struct io_wqe_acct *acct,
 	return NULL;
 }
 
+/*
+ * A node is worth stealing from if it has runnable work queued, but no idle
+ * worker of its own left to run it.
+ */
+static inline bool io_wqe_overloaded(struct io_wqe *wqe,
+				     struct io_wqe_acct *acct)
+{
+	return !wq_list_empty(&acct->work_list) &&
+		!test_bit(IO_ACCT_STALLED_BIT, &acct->flags) &&
+		hlist_nulls_empty(&wqe->free_list);
+}
+
+/*
+ * Find the closest node, by NUMA distance, that has work for an acct of
+ * type @index that @wqe's workers could take over.
+ */
+static struct io_wqe *io_wq_steal_victim(struct io_wqe *wqe, int index)
+{
+	struct io_wq *wq = wqe->wq;
+	struct io_wqe *victim = NULL;
+	int node, best = INT_MAX;
+
+	if (num_online_nodes() < 2 || wqe->node == NUMA_NO_NODE)
+		return NULL;
+
+	for_each_online_node(node) {
+		struct io_wqe *other = wq->wqes[node];
+		int dist;
+
+		if (other == wqe || !io_wqe_overloaded(other, &other->acct[index]))
+			continue;
+		dist = node_distance(wqe->node, node);
+		if (dist < best) {
+			best = dist;
+			victim = other;
+		}
+	}
+	return victim;
+}
+
+static struct io_wq_work *io_wq_steal_work(struct io_worker *worker,
+					   struct io_wqe_acct **work_acct)
+{
+	int index = io_wqe_get_acct(worker)->index;
+	struct io_wqe *victim;
+	struct io_wqe_acct *acct;
+	struct io_wq_work *work;
+
+	victim = io_wq_steal_victim(worker->wqe, index);
+	if (!victim)
+		return NULL;
+
+	acct = &victim->acct[index];
+	raw_spin_lock(&acct->lock);
+	work = io_get_next_work(acct, victim);
+	raw_spin_unlock(&acct->lock);
+	if (work) {
+		atomic_long_inc(&victim->wq->nr_stolen);
+		*work_acct = acct;
+	}
+	return work;
+}
+
+/*
+ * Wake an idle worker on the closest other node to pick up work that
+ * @wqe has no worker left for. See io_worker_handle_work().
+ */
+static bool io_wqe_activate_remote_worker(struct io_wqe *wqe, int index)
+	__must_hold(RCU)
+{
+	struct io_wq *wq = wqe->wq;
+	struct io_wqe *target = NULL;
+	int node, best = INT_MAX;
+
+	if (num_online_nodes() < 2 || wqe->node == NUMA_NO_NODE)
+		return false;
+
+	for_each_online_node(node) {
+		struct io_wqe *other = wq->wqes[node];
+		int dist;
+
+		if (other == wqe || hlist_nulls_empty(&other->free_list))
+			continue;
+		dist = node_distance(wqe->node, node);
+		if (dist < best) {
+			best = dist;
+			target = other;
+		}
+	}
+	if (!target)
+		return false;
+	return io_wqe_activate_free_worker(target, &target->acct[index]);
+}
+
 static void io_assign_current_work(struct io_worker *worker,
 				   struct io_wq_work *work)
 {
@@ -542,8 +641,10 @@ static void io_worker_handle_work(struct io_worker *worker)
 	struct io_wqe *wqe = worker->wqe;
 	struct io_wq *wq = wqe->wq;
 	bool do_kill = test_bit(IO_WQ_BIT_EXIT, &wq->state);
+	int nr_stolen = 0;
 
 	do {
+		struct io_wqe_acct *work_acct = acct;
 		struct io_wq_work *work;
 
 		/*
@@ -554,8 +655,19 @@ static void io_worker_handle_work(struct io_worker *worker)
 		 * clear the stalled flag.
 		 */
 		raw_spin_lock(&acct->lock);
-		work = io_get_next_work(acct, worker);
+		work = io_get_next_work(acct, wqe);
 		raw_spin_unlock(&acct->lock);
+
+		/*
+		 * Our own node is out of work, help out the nearest node that
+		 * has more queued than it has workers for. Bounded, so that
+		 * local work gets a look in regularly.
+		 */
+		if (!work && nr_stolen < IO_WQ_STEAL_MAX) {
+			work = io_wq_steal_work(worker, &work_acct);
+			if (work)
+				nr_stolen++;
+		}
 		if (work) {
 			__io_worker_busy(wqe, worker);
 
@@ -601,7 +713,7 @@ static void io_worker_handle_work(struct io_worker *worker)
 				/* serialize hash clear with wake_up() */
 				spin_lock_irq(&wq->hash->wait.lock);
 				clear_bit(hash, &wq->hash->map);
-				clear_bit(IO_ACCT_STALLED_BIT, &acct->flags);
+				clear_bit(IO_ACCT_STALLED_BIT, &work_acct->flags);
 				spin_unlock_irq(&wq->hash->wait.lock);
 				if (wq_has_sleeper(&wq->hash->wait))
 					wake_up(&wq->hash->wait);
@@ -628,7 +740,8 @@ static int io_wqe_worker(void *data)
 		long ret;
 
 		set_current_state(TASK_INTERRUPTIBLE);
-		while (io_acct_run_queue(acct))
+		while (io_acct_run_queue(acct) ||
+		       io_wq_steal_victim(wqe, acct->index))
 			io_worker_handle_work(worker);
 
 		raw_spin_lock(&wqe->lock);
@@ -925,6 +1038,9 @@ static void io_wqe_enqueue(struct io_wqe *wqe, struct io_wq_work *work)
 	raw_spin_lock(&wqe->lock);
 	rcu_read_lock();
 	do_create = !io_wqe_activate_free_worker(wqe, acct);
+	/* no room for another local worker, see if another node can help */
+	if (do_create && acct->nr_workers >= acct->max_workers)
+		do_create = !io_wqe_activate_remote_worker(wqe, acct->index);
 	rcu_read_unlock();
 
 	raw_spin_unlock(&wqe->lock);
@@ -1352,6 +1468,11 @@ int io_wq_cpu_affinity(struct io_wq *wq, cpumask_var_t mask)
 	return 0;
 }
 
+unsigned long io_wq_nr_stolen(struct io_wq *wq)
+{
+	return atomic_long_read(&wq->nr_stolen);
+}
+
 /*
  * Set max number of unbounded workers, returns old value. If new_count is 0,
  * then just return the old value.
@@ -125,26 +125,35 @@ static void __user *io_provided_buffer_select(struct io_kiocb *req, size_t *len,
 	return NULL;
 }
 
-static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
-					  struct io_buffer_list *bl,
-					  unsigned int issue_flags)
+static struct io_uring_buf *io_ring_head_to_buf(struct io_buffer_list *bl,
+						__u16 head)
 {
-	struct io_uring_buf_ring *br = bl->buf_ring;
 	struct io_uring_buf *buf;
-	__u16 head = bl->head;
-
-	if (unlikely(smp_load_acquire(&br->tail) == head))
-		return NULL;
 
 	head &= bl->mask;
 	if (head < IO_BUFFER_LIST_BUF_PER_PAGE) {
-		buf = &br->bufs[head];
+		buf = &bl->buf_ring->bufs[head];
 	} else {
 		int off = head & (IO_BUFFER_LIST_BUF_PER_PAGE - 1);
 		int index = head / IO_BUFFER_LIST_BUF_PER_PAGE;
 		buf = page_address(bl->buf_pages[index]);
 		buf += off;
 	}
+	return buf;
+}
+
+static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
+					  struct io_buffer_list *bl,
+					  unsigned int issue_flags)
+{
+	struct io_uring_buf_ring *br = bl->buf_ring;
+	struct io_uring_buf *buf;
+	__u16 head = bl->head;
+
+	if (unlikely(smp_load_acquire(&br->tail) == head))
+		return NULL;
+
+	buf = io_ring_head_to_buf(bl, head);
 	if (*len == 0 || *len > buf->len)
 		*len = buf->len;
 	req->flags |= REQ_F_BUFFER_RING;
@@ -188,6 +197,92 @@ void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
 	return ret;
 }
 
+static int io_ring_buffers_peek(struct io_kiocb *req, struct iovec *iovs,
+				int nr_iovs, size_t *len,
+				struct io_buffer_list *bl)
+{
+	struct io_uring_buf_ring *br = bl->buf_ring;
+	size_t max_len = *len, total = 0;
+	struct io_uring_buf *buf;
+	__u16 head = bl->head;
+	int nr_avail, nr;
+
+	nr_avail = (__u16) (smp_load_acquire(&br->tail) - head);
+	if (unlikely(!nr_avail))
+		return -ENOBUFS;
+	nr_avail = min(nr_avail, nr_iovs);
+
+	buf = io_ring_head_to_buf(bl, head);
+	req->buf_index = buf->bid;
+
+	for (nr = 0; nr < nr_avail; nr++) {
+		size_t buf_len = READ_ONCE(buf->len);
+
+		if (max_len && buf_len > max_len - total)
+			buf_len = max_len - total;
+		iovs[nr].iov_base = u64_to_user_ptr(buf->addr);
+		iovs[nr].iov_len = buf_len;
+		total += buf_len;
+		if (max_len && total >= max_len) {
+			nr++;
+			break;
+		}
+		buf = io_ring_head_to_buf(bl, ++head);
+	}
+
+	req->flags |= REQ_F_BUFFER_RING;
+	req->buf_list = bl;
+	*len = total;
+	return nr;
+}
+
+/*
+ * Select a run of consecutive buffers from a ring provided buffer group, for
+ * requests that post a single CQE for several buffers. Returns the number of
+ * iovecs filled in, with *len updated to their total length. On input *len
+ * caps the total length, if non-zero. req->buf_index is set to the ID of the
+ * first buffer, the caller commits the buffers it ended up using through
+ * io_put_kbufs().
+ */
+int io_buffers_select(struct io_kiocb *req, struct iovec *iovs, int nr_iovs,
+		      size_t *len, unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_list *bl;
+	bool commit_now;
+	int ret = -ENOBUFS;
+
+	io_ring_submit_lock(ctx, issue_flags);
+
+	bl = io_buffer_get_list(ctx, req->buf_index);
+	if (unlikely(!bl))
+		goto out;
+	if (unlikely(!bl->buf_nr_pages)) {
+		/* only ring provided buffers can be used in bulk */
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/*
+	 * Like io_ring_buffer_select(), an unlocked caller must consume what
+	 * it picks right away. Limit it to one buffer, so that the buffers
+	 * consumed always match what the CQE reports.
+	 */
+	commit_now = issue_flags & IO_URING_F_UNLOCKED ||
+			!file_can_poll(req->file);
+	if (commit_now)
+		nr_iovs = 1;
+
+	ret = io_ring_buffers_peek(req, iovs, nr_iovs, len, bl);
+	if (ret > 0 && commit_now) {
+		req->buf_list = NULL;
+		bl->head++;
+	}
+out:
+	io_ring_submit_unlock(ctx, issue_flags);
+	return ret;
+}
+
 static __cold int io_init_bl_list(struct io_ring_ctx *ctx)
 {
 	int i;
@@ -35,6 +35,8 @@ struct io_buffer {
 
 void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
 			      unsigned int issue_flags);
+int io_buffers_select(struct io_kiocb *req, struct iovec *iovs, int nr_iovs,
+		      size_t *len, unsigned int issue_flags);
 void io_destroy_buffers(struct io_ring_ctx *ctx);
 
 int io_remove_buffers_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe);
@@ -129,4 +131,19 @@ static inline unsigned int io_put_kbuf(struct io_kiocb *req,
 		return 0;
 	return __io_put_kbuf(req, issue_flags);
 }
+
+/*
+ * Put a run of ring provided buffers picked by io_buffers_select(), of which
+ * @nbufs were consumed. The ring head is only moved here for the locked
+ * case, unlocked selection already consumed its (single) buffer.
+ */
+static inline unsigned int io_put_kbufs(struct io_kiocb *req, int nbufs,
+					unsigned issue_flags)
+{
+	if (!(req->flags & REQ_F_BUFFER_RING))
+		return 0;
+	if (req->buf_list && nbufs > 1)
+		req->buf_list->head += nbufs - 1;
+	return __io_put_kbuf(req, issue_flags);
+}
 #endif
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef IOU_LATENCY_H
+#define IOU_LATENCY_H
+
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/io_uring_types.h>
+
+/*
+ * Submission to completion latency, see IORING_SETUP_LAT_STATS. Bucket 0
+ * counts completions within 1 usec, bucket N those in [2^(N-1), 2^N) usecs.
+ * The last bucket is open ended.
+ */
+#define IO_LAT_BUCKETS		24
+
+enum {
+	IO_LAT_INLINE,		/* completed from the submission path */
+	IO_LAT_POLL,		/* waited on internal poll first */
+	IO_LAT_IOWQ,		/* punted to io-wq */
+
+	IO_LAT_NR_PATHS,
+};
+
+/* req->lat_stamp is in nsecs, the low bit is used to flag io-wq punts */
+#define IO_LAT_STAMP_IOWQ	1ULL
+
+struct io_lat_stats {
+	u64			hist[IORING_OP_LAST][IO_LAT_NR_PATHS][IO_LAT_BUCKETS];
+};
+
+static inline void io_lat_start(struct io_ring_ctx *ctx, struct io_kiocb *req)
+{
+	if (ctx->flags & IORING_SETUP_LAT_STATS)
+		req->lat_stamp = ktime_get_ns() & ~IO_LAT_STAMP_IOWQ;
+}
+
+static inline void io_lat_mark_iowq(struct io_kiocb *req)
+{
+	if (req->ctx->flags & IORING_SETUP_LAT_STATS)
+		req->lat_stamp |= IO_LAT_STAMP_IOWQ;
+}
+
+/*
+ * Called when posting the final CQE of a request, which is serialised like
+ * any other CQ update, so the counters don't need to be atomic.
+ */
+static inline void io_lat_account(struct io_ring_ctx *ctx,
+				  struct io_kiocb *req)
+{
+	u64 stamp, usecs;
+	int path, bucket;
+
+	if (!(ctx->flags & IORING_SETUP_LAT_STATS))
+		return;
+
+	stamp = req->lat_stamp;
+	if (stamp & IO_LAT_STAMP_IOWQ)
+		path = IO_LAT_IOWQ;
+	else if (req->flags & REQ_F_POLLED)
+		path = IO_LAT_POLL;
+	else
+		path = IO_LAT_INLINE;
+
+	usecs = div_u64(ktime_get_ns() - (stamp & ~IO_LAT_STAMP_IOWQ),
+			NSEC_PER_USEC);
+	bucket = min_t(int, fls64(usecs), IO_LAT_BUCKETS - 1);
+	ctx->lat_stats->hist[req->opcode][path][bucket]++;
+}
+
+#endif
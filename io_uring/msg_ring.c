@@ -111,7 +111,7 @@ static struct file *io_msg_grab_file(struct io_kiocb *req, unsigned int issue_fl
 	io_ring_submit_lock(ctx, issue_flags);
 	if (likely(idx < ctx->nr_user_files)) {
 		idx = array_index_nospec(idx, ctx->nr_user_files);
-		file_ptr = io_fixed_file_slot(&ctx->file_table, idx)->file_ptr;
+		file_ptr = io_fixed_file_ptr(&ctx->file_table, idx);
 		file = (struct file *) (file_ptr & FFS_MASK);
 		if (file)
 			get_file(file);
@@ -6,6 +6,7 @@
 #include <linux/net.h>
 #include <linux/compat.h>
 #include <net/compat.h>
+#include <net/tcp.h>
 #include <linux/io_uring.h>
 
 #include <uapi/linux/io_uring.h>
@@ -49,6 +50,13 @@ struct io_connect {
 	bool				in_progress;
 };
 
+struct io_recv_zc {
+	struct file			*file;
+	u64				addr;
+	u32				len;
+	u16				flags;
+};
+
 struct io_sr_msg {
 	struct file			*file;
 	union {
@@ -553,7 +561,8 @@ int io_recvmsg_prep_async(struct io_kiocb *req)
 	return ret;
 }
 
-#define RECVMSG_FLAGS (IORING_RECVSEND_POLL_FIRST | IORING_RECV_MULTISHOT)
+#define RECVMSG_FLAGS (IORING_RECVSEND_POLL_FIRST | IORING_RECV_MULTISHOT | \
+			IORING_RECVSEND_BUNDLE)
 
 int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
@@ -581,6 +590,14 @@ int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 			return -EINVAL;
 		req->flags |= REQ_F_APOLL_MULTISHOT;
 	}
+	if (sr->flags & IORING_RECVSEND_BUNDLE) {
+		if (req->opcode != IORING_OP_RECV)
+			return -EINVAL;
+		if (!(req->flags & REQ_F_BUFFER_SELECT))
+			return -EINVAL;
+		if (sr->msg_flags & MSG_WAITALL)
+			return -EINVAL;
+	}
 
 #ifdef CONFIG_COMPAT
 	if (req->ctx->compat)
@@ -830,15 +847,31 @@ int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 	return ret;
 }
 
+/*
+ * Number of bundle buffers covered by a receive of @ret bytes. Buffers are
+ * filled in order, so that's every buffer up to the one the data ends in.
+ */
+static int io_bundle_nbufs(const struct iovec *iovs, int nr_iovs, int ret)
+{
+	int nbufs = 0;
+
+	while (ret > 0 && nbufs < nr_iovs) {
+		ret -= min_t(size_t, ret, iovs[nbufs].iov_len);
+		nbufs++;
+	}
+	return nbufs;
+}
+
 int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 {
 	struct io_sr_msg *sr = io_kiocb_to_cmd(req, struct io_sr_msg);
+	struct iovec iovs[UIO_FASTIOV];
 	struct msghdr msg;
 	struct socket *sock;
 	struct iovec iov;
 	unsigned int cflags;
 	unsigned flags;
-	int ret, min_ret = 0;
+	int ret, min_ret = 0, nr_bufs = 0;
 	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
 	size_t len = sr->len;
 
@@ -854,18 +887,33 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 		return -ENOTSOCK;
 
 retry_multishot:
-	if (io_do_buffer_select(req)) {
-		void __user *buf;
+	if (sr->flags & IORING_RECVSEND_BUNDLE) {
+		/*
+		 * Receive into as many ring buffers as are available and post
+		 * a single CQE for all of them, see IORING_RECVSEND_BUNDLE.
+		 */
+		len = sr->len;
+		ret = io_buffers_select(req, iovs, ARRAY_SIZE(iovs), &len,
+					issue_flags);
+		if (unlikely(ret < 0))
+			return ret;
+		nr_bufs = ret;
+		iov_iter_init(&msg.msg_iter, ITER_DEST, iovs, nr_bufs, len);
+	} else {
+		if (io_do_buffer_select(req)) {
+			void __user *buf;
 
-		buf = io_buffer_select(req, &len, issue_flags);
-		if (!buf)
-			return -ENOBUFS;
-		sr->buf = buf;
-	}
+			buf = io_buffer_select(req, &len, issue_flags);
+			if (!buf)
+				return -ENOBUFS;
+			sr->buf = buf;
+		}
 
-	ret = import_single_range(ITER_DEST, sr->buf, len, &iov, &msg.msg_iter);
-	if (unlikely(ret))
-		goto out_free;
+		ret = import_single_range(ITER_DEST, sr->buf, len, &iov,
+					  &msg.msg_iter);
+		if (unlikely(ret))
+			goto out_free;
+	}
 
 	msg.msg_name = NULL;
 	msg.msg_namelen = 0;
@@ -914,7 +962,11 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	else
 		io_kbuf_recycle(req, issue_flags);
 
-	cflags = io_put_kbuf(req, issue_flags);
+	if (nr_bufs)
+		cflags = io_put_kbufs(req, io_bundle_nbufs(iovs, nr_bufs, ret),
+				      issue_flags);
+	else
+		cflags = io_put_kbuf(req, issue_flags);
 	if (msg.msg_inq)
 		cflags |= IORING_CQE_F_SOCK_NONEMPTY;
 
@@ -924,6 +976,107 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	return ret;
 }
 
+int io_recv_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_recv_zc *zc = io_kiocb_to_cmd(req, struct io_recv_zc);
+
+	if (unlikely(sqe->file_index || sqe->addr2 || sqe->msg_flags ||
+		     sqe->addr3))
+		return -EINVAL;
+
+	zc->addr = READ_ONCE(sqe->addr);
+	zc->len = READ_ONCE(sqe->len);
+	zc->flags = READ_ONCE(sqe->ioprio);
+	if (zc->flags & ~IORING_RECVSEND_POLL_FIRST)
+		return -EINVAL;
+	if (req->flags & REQ_F_BUFFER_SELECT) {
+		if (zc->addr || zc->len)
+			return -EINVAL;
+	} else if (!PAGE_ALIGNED(zc->addr)) {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Map payload pages of a TCP receive queue into an area the application has
+ * mmap()ed from the socket, rather than copying them. The target is either
+ * sqe->addr/len or, with IOSQE_BUFFER_SELECT, a chunk of that area picked
+ * from a provided buffer ring. Ring entries are refilled by the application
+ * once it is done with the data, mapping over them again drops the old pages.
+ *
+ * cqe->res is the number of bytes mapped. If nothing could be mapped but
+ * data is pending (e.g. a partial page at the tail of a segment), cqe->res
+ * is 0 and IORING_CQE_F_SOCK_NONEMPTY is set, and the application must fall
+ * back to a copying receive for that data. A res of 0 without that flag
+ * means the peer has shut down the connection.
+ */
+int io_recv_zc(struct io_kiocb *req, unsigned int issue_flags)
+{
+#if defined(CONFIG_INET) && defined(CONFIG_MMU)
+	struct io_recv_zc *zc = io_kiocb_to_cmd(req, struct io_recv_zc);
+	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
+	struct tcp_zerocopy_receive tzc = {};
+	unsigned int cflags = 0;
+	struct socket *sock;
+	int ret;
+
+	if (!(req->flags & REQ_F_POLLED) &&
+	    (zc->flags & IORING_RECVSEND_POLL_FIRST))
+		return -EAGAIN;
+
+	sock = sock_from_file(req->file);
+	if (unlikely(!sock))
+		return -ENOTSOCK;
+	if (!sk_is_tcp(sock->sk))
+		return -EOPNOTSUPP;
+
+	if (io_do_buffer_select(req)) {
+		void __user *buf;
+		size_t len = 0;
+
+		buf = io_buffer_select(req, &len, issue_flags);
+		if (!buf)
+			return -ENOBUFS;
+		zc->addr = (unsigned long) buf;
+		zc->len = len;
+	}
+
+	tzc.address = zc->addr;
+	tzc.length = zc->len;
+	ret = tcp_zerocopy_recv(sock->sk, &tzc, force_nonblock);
+	if (!ret && !tzc.length) {
+		if (tzc.err) {
+			ret = tzc.err;
+		} else if (!tzc.recv_skip_hint && force_nonblock) {
+			io_kbuf_recycle(req, issue_flags);
+			return -EAGAIN;
+		}
+	}
+	if (ret == -EIO && sock_flag(sock->sk, SOCK_DONE))
+		ret = 0;
+
+	if (ret < 0) {
+		if (ret == -ERESTARTSYS)
+			ret = -EINTR;
+		io_kbuf_recycle(req, issue_flags);
+		req_set_fail(req);
+	} else {
+		ret = tzc.length;
+		if (ret)
+			cflags = io_put_kbuf(req, issue_flags);
+		else
+			io_kbuf_recycle(req, issue_flags);
+		if (tzc.recv_skip_hint)
+			cflags |= IORING_CQE_F_SOCK_NONEMPTY;
+	}
+	io_req_set_res(req, ret, cflags);
+	return IOU_OK;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
 void io_send_zc_cleanup(struct io_kiocb *req)
 {
 	struct io_sr_msg *zc = io_kiocb_to_cmd(req, struct io_sr_msg);
@@ -61,6 +61,9 @@ int io_sendmsg_zc(struct io_kiocb *req, unsigned int issue_flags);
 int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe);
 void io_send_zc_cleanup(struct io_kiocb *req);
 
+int io_recv_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe);
+int io_recv_zc(struct io_kiocb *req, unsigned int issue_flags);
+
 void io_netmsg_cache_free(struct io_cache_entry *entry);
 #else
 static inline void io_netmsg_cache_free(struct io_cache_entry *entry)
@@ -531,6 +531,37 @@ const struct io_op_def io_op_defs[] = {
 		.prep			= io_eopnotsupp_prep,
 #endif
 	},
+	[IORING_OP_RECV_ZC] = {
+		.name			= "RECV_ZC",
+		.needs_file		= 1,
+		.unbound_nonreg_file	= 1,
+		.pollin			= 1,
+		.buffer_select		= 1,
+		.audit_skip		= 1,
+		.ioprio			= 1,
+#if defined(CONFIG_NET)
+		.prep			= io_recv_zc_prep,
+		.issue			= io_recv_zc,
+#else
+		.prep			= io_eopnotsupp_prep,
+#endif
+	},
+	[IORING_OP_SPLICE_DIRECT] = {
+		.needs_file		= 1,
+		.hash_reg_file		= 1,
+		.unbound_nonreg_file	= 1,
+		.audit_skip		= 1,
+		.name			= "SPLICE_DIRECT",
+		.prep			= io_splice_prep,
+		.issue			= io_splice_direct,
+	},
+	[IORING_OP_GETDENTS_STATX] = {
+		.needs_file		= 1,
+		.audit_skip		= 1,
+		.name			= "GETDENTS_STATX",
+		.prep			= io_getdents_statx_prep,
+		.issue			= io_getdents_statx,
+	},
 };
 
 const char *io_uring_get_opcode(u8 opcode)
@@ -19,6 +19,7 @@
 #include "kbuf.h"
 #include "poll.h"
 #include "cancel.h"
+#include "napi.h"
 
 struct io_poll_update {
 	struct file			*file;
@@ -575,6 +576,7 @@ static int __io_arm_poll_handler(struct io_kiocb *req,
 		req->flags &= ~REQ_F_HASH_LOCKED;
 
 	mask = vfs_poll(req->file, &ipt->pt) & poll->events;
+	io_napi_add(req);
 
 	if (unlikely(ipt->error || !ipt->nr_entries)) {
 		io_poll_remove_entries(req);
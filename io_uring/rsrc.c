@@ -479,13 +479,12 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 			continue;
 
 		i = array_index_nospec(up->offset + done, ctx->nr_user_files);
-		file_slot = io_fixed_file_slot(&ctx->file_table, i);
-
-		if (file_slot->file_ptr) {
-			file = (struct file *)(file_slot->file_ptr & FFS_MASK);
+		file = io_file_from_index(&ctx->file_table, i);
+		if (file) {
 			err = io_queue_rsrc_removal(data, i, ctx->rsrc_node, file);
 			if (err)
 				break;
+			file_slot = io_fixed_file_slot(&ctx->file_table, i);
 			file_slot->file_ptr = 0;
 			io_file_bitmap_clear(&ctx->file_table, i);
 			needs_switch = true;
@@ -509,6 +508,12 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 				err = -EBADF;
 				break;
 			}
+			file_slot = io_fixed_file_slot_alloc(&ctx->file_table, i);
+			if (!file_slot) {
+				fput(file);
+				err = -ENOMEM;
+				break;
+			}
 			err = io_scm_file_account(ctx, file);
 			if (err) {
 				fput(file);
@@ -1010,12 +1015,17 @@ int io_sqe_files_register(struct io_ring_ctx *ctx, void __user *arg,
 			fput(file);
 			goto fail;
 		}
+		file_slot = io_fixed_file_slot_alloc(&ctx->file_table, i);
+		if (!file_slot) {
+			fput(file);
+			ret = -ENOMEM;
+			goto fail;
+		}
 		ret = io_scm_file_account(ctx, file);
 		if (ret) {
 			fput(file);
 			goto fail;
 		}
-		file_slot = io_fixed_file_slot(&ctx->file_table, i);
 		io_fixed_file_set(file_slot, file);
 		io_file_bitmap_set(&ctx->file_table, i);
 	}
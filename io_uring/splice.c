@@ -120,3 +120,57 @@ int io_splice(struct io_kiocb *req, unsigned int issue_flags)
 	io_req_set_res(req, ret, 0);
 	return IOU_OK;
 }
+
+/*
+ * Move data from splice_fd_in to the request file without either having to
+ * be a pipe, using the task's internal splice pipe instead. Seekable inputs
+ * go through do_splice_direct() like sendfile(2) does; streams such as
+ * sockets are drained into @out with do_splice_direct_stream().
+ */
+int io_splice_direct(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_splice *sp = io_kiocb_to_cmd(req, struct io_splice);
+	struct file *out = sp->file_out;
+	unsigned int flags = sp->flags & ~SPLICE_F_FD_IN_FIXED;
+	size_t len = min_t(u64, sp->len, MAX_RW_COUNT);
+	loff_t pos_in, pos_out;
+	struct file *in;
+	long ret = 0;
+
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		return -EAGAIN;
+
+	if (sp->flags & SPLICE_F_FD_IN_FIXED)
+		in = io_file_get_fixed(req, sp->splice_fd_in, issue_flags);
+	else
+		in = io_file_get_normal(req, sp->splice_fd_in);
+	if (!in) {
+		ret = -EBADF;
+		goto done;
+	}
+
+	if (!len)
+		goto put_in;
+
+	pos_out = (sp->off_out == -1) ? out->f_pos : sp->off_out;
+	if (in->f_mode & FMODE_LSEEK) {
+		pos_in = (sp->off_in == -1) ? in->f_pos : sp->off_in;
+		ret = do_splice_direct(in, &pos_in, out, &pos_out, len, flags);
+		if (ret > 0 && sp->off_in == -1)
+			in->f_pos = pos_in;
+	} else if (sp->off_in != -1) {
+		ret = -ESPIPE;
+	} else {
+		ret = do_splice_direct_stream(in, out, &pos_out, len, flags);
+	}
+	if (ret > 0 && sp->off_out == -1)
+		out->f_pos = pos_out;
+put_in:
+	if (!(sp->flags & SPLICE_F_FD_IN_FIXED))
+		io_put_file(in);
+done:
+	if (ret != sp->len)
+		req_set_fail(req);
+	io_req_set_res(req, ret, 0);
+	return IOU_OK;
+}
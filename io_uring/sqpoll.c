@@ -16,8 +16,10 @@
 
 #include "io_uring.h"
 #include "sqpoll.h"
+#include "napi.h"
 
 #define IORING_SQPOLL_CAP_ENTRIES_VALUE 8
+#define IORING_SQPOLL_MAX_WEIGHT	64
 
 enum {
 	IO_SQ_THREAD_SHOULD_STOP = 0,
@@ -170,9 +172,17 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 	int ret = 0;
 
 	to_submit = io_sqring_entries(ctx);
-	/* if we're handling multiple rings, cap submit size for fairness */
-	if (cap_entries && to_submit > IORING_SQPOLL_CAP_ENTRIES_VALUE)
-		to_submit = IORING_SQPOLL_CAP_ENTRIES_VALUE;
+	/*
+	 * If we're handling multiple rings, cap submit size for fairness. The
+	 * cap scales with the ring's weight, see IORING_REGISTER_SQ_WEIGHT.
+	 */
+	if (cap_entries) {
+		unsigned int cap = IORING_SQPOLL_CAP_ENTRIES_VALUE *
+					READ_ONCE(ctx->sq_weight);
+
+		if (to_submit > cap)
+			to_submit = cap;
+	}
 
 	if (!wq_list_empty(&ctx->iopoll_list) || to_submit) {
 		const struct cred *creds = NULL;
@@ -199,6 +209,9 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 			revert_creds(creds);
 	}
 
+	if (io_napi(ctx))
+		ret += io_napi_sqpoll_busy_poll(ctx);
+
 	return ret;
 }
 
@@ -218,6 +231,33 @@ static bool io_sqd_handle_event(struct io_sq_data *sqd)
 	return did_sig || test_bit(IO_SQ_THREAD_SHOULD_STOP, &sqd->state);
 }
 
+/*
+ * Track how far apart the passes that found work are, as an EWMA with a
+ * 1/8 weight kept scaled by 8. Gaps are clamped to twice the idle period,
+ * which is all io_sqd_idle_timeout() cares about.
+ */
+static void io_sqd_account_work(struct io_sq_data *sqd)
+{
+	unsigned long gap = jiffies - sqd->last_work;
+
+	sqd->last_work = jiffies;
+	gap = min(gap, 2UL * sqd->sq_thread_idle);
+	sqd->work_gap_avg += gap - (sqd->work_gap_avg >> 3);
+}
+
+/*
+ * How long to keep spinning once we run out of work. With adaptive idle,
+ * if new work doesn't usually show up within the idle period then spinning
+ * for it is a waste of a CPU, so go to sleep right away.
+ */
+static unsigned long io_sqd_idle_timeout(struct io_sq_data *sqd)
+{
+	if (sqd->adaptive_idle &&
+	    (sqd->work_gap_avg >> 3) >= sqd->sq_thread_idle)
+		return jiffies + 1;
+	return jiffies + sqd->sq_thread_idle;
+}
+
 static int io_sq_thread(void *data)
 {
 	struct io_sq_data *sqd = data;
@@ -242,7 +282,7 @@ static int io_sq_thread(void *data)
 		if (io_sqd_events_pending(sqd) || signal_pending(current)) {
 			if (io_sqd_handle_event(sqd))
 				break;
-			timeout = jiffies + sqd->sq_thread_idle;
+			timeout = io_sqd_idle_timeout(sqd);
 		}
 
 		cap_entries = !list_is_singular(&sqd->ctx_list);
@@ -252,13 +292,21 @@ static int io_sq_thread(void *data)
 			if (!sqt_spin && (ret > 0 || !wq_list_empty(&ctx->iopoll_list)))
 				sqt_spin = true;
 		}
+		/*
+		 * Rotate the ring list, so the same ring doesn't always get the
+		 * first go at submitting.
+		 */
+		if (cap_entries)
+			list_rotate_left(&sqd->ctx_list);
 		if (io_run_task_work())
 			sqt_spin = true;
 
 		if (sqt_spin || !time_after(jiffies, timeout)) {
 			cond_resched();
-			if (sqt_spin)
-				timeout = jiffies + sqd->sq_thread_idle;
+			if (sqt_spin) {
+				io_sqd_account_work(sqd);
+				timeout = io_sqd_idle_timeout(sqd);
+			}
 			continue;
 		}
 
@@ -298,7 +346,7 @@ static int io_sq_thread(void *data)
 		}
 
 		finish_wait(&sqd->wait, &wait);
-		timeout = jiffies + sqd->sq_thread_idle;
+		timeout = io_sqd_idle_timeout(sqd);
 	}
 
 	io_uring_cancel_generic(true, sqd);
@@ -366,6 +414,7 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 
 		ctx->sq_creds = get_current_cred();
 		ctx->sq_data = sqd;
+		ctx->sq_weight = 1;
 		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
 		if (!ctx->sq_thread_idle)
 			ctx->sq_thread_idle = HZ;
@@ -395,6 +444,8 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 
 		sqd->task_pid = current->pid;
 		sqd->task_tgid = current->tgid;
+		sqd->adaptive_idle = !!(p->flags & IORING_SETUP_SQPOLL_ADAPTIVE);
+		sqd->last_work = jiffies;
 		tsk = create_io_thread(io_sq_thread, sqd, NUMA_NO_NODE);
 		if (IS_ERR(tsk)) {
 			ret = PTR_ERR(tsk);
@@ -406,8 +457,9 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 		wake_up_new_task(tsk);
 		if (ret)
 			goto err;
-	} else if (p->flags & IORING_SETUP_SQ_AFF) {
-		/* Can't have SQ_AFF without SQPOLL */
+	} else if (p->flags & (IORING_SETUP_SQ_AFF |
+			       IORING_SETUP_SQPOLL_ADAPTIVE)) {
+		/* Can't have SQ_AFF or SQPOLL_ADAPTIVE without SQPOLL */
 		ret = -EINVAL;
 		goto err;
 	}
@@ -419,3 +471,26 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 	io_sq_thread_finish(ctx);
 	return ret;
 }
+
+/*
+ * Set the weight of a ring attached to a shared SQPOLL thread. A ring with
+ * weight N gets to submit up to N times as many SQEs per pass as a ring
+ * with weight 1. The previous weight is copied back to the application.
+ */
+__cold int io_register_sq_weight(struct io_ring_ctx *ctx, void __user *arg)
+{
+	__u32 weight, old;
+
+	if (!(ctx->flags & IORING_SETUP_SQPOLL))
+		return -EINVAL;
+	if (copy_from_user(&weight, arg, sizeof(weight)))
+		return -EFAULT;
+	if (!weight || weight > IORING_SQPOLL_MAX_WEIGHT)
+		return -EINVAL;
+
+	old = ctx->sq_weight;
+	if (copy_to_user(arg, &old, sizeof(old)))
+		return -EFAULT;
+	WRITE_ONCE(ctx->sq_weight, weight);
+	return 0;
+}
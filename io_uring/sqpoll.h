@@ -18,6 +18,11 @@ struct io_sq_data {
 
 	unsigned long		state;
 	struct completion	exited;
+
+	/* see io_sqd_idle_timeout() */
+	bool			adaptive_idle;
+	unsigned long		last_work;
+	unsigned long		work_gap_avg;
 };
 
 int io_sq_offload_create(struct io_ring_ctx *ctx, struct io_uring_params *p);
@@ -27,3 +32,4 @@ void io_sq_thread_park(struct io_sq_data *sqd);
 void io_sq_thread_unpark(struct io_sq_data *sqd);
 void io_put_sq_data(struct io_sq_data *sqd);
 int io_sqpoll_wait_sq(struct io_ring_ctx *ctx);
+int io_register_sq_weight(struct io_ring_ctx *ctx, void __user *arg);
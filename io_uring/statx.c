@@ -71,3 +71,44 @@ void io_statx_cleanup(struct io_kiocb *req)
 	if (sx->filename)
 		putname(sx->filename);
 }
+
+struct io_getdents_statx {
+	struct file			*file;
+	unsigned int			count;
+	unsigned int			mask;
+	unsigned int			flags;
+	struct dirent_statx __user	*dirent;
+};
+
+int io_getdents_statx_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_getdents_statx *gd = io_kiocb_to_cmd(req, struct io_getdents_statx);
+	u64 mask;
+
+	if (sqe->off || sqe->buf_index || sqe->splice_fd_in)
+		return -EINVAL;
+
+	mask = READ_ONCE(sqe->addr3);
+	if (mask > U32_MAX)
+		return -EINVAL;
+
+	gd->dirent = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	gd->count = READ_ONCE(sqe->len);
+	gd->flags = READ_ONCE(sqe->statx_flags);
+	gd->mask = mask;
+	return 0;
+}
+
+int io_getdents_statx(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_getdents_statx *gd = io_kiocb_to_cmd(req, struct io_getdents_statx);
+	int ret;
+
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		return -EAGAIN;
+
+	ret = vfs_getdents_statx(req->file, gd->dirent, gd->count, gd->flags,
+				 gd->mask);
+	io_req_set_res(req, ret, 0);
+	return IOU_OK;
+}
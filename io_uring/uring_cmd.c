@@ -12,10 +12,64 @@
 #include "rsrc.h"
 #include "uring_cmd.h"
 
+/**
+ * io_uring_cmd_mark_cancelable - let the ring cancel a pending command
+ * @cmd: the command, issued and not completed yet
+ * @issue_flags: the flags the command was issued with
+ *
+ * When the ring exits, or the task that issued @cmd does, the ->uring_cmd()
+ * handler of the file is called again with IO_URING_F_CANCEL. A cancelable
+ * command must be completed with io_uring_cmd_complete_in_task(), which
+ * takes it off the cancel list before running the callback.
+ */
+void io_uring_cmd_mark_cancelable(struct io_uring_cmd *cmd,
+				  unsigned int issue_flags)
+{
+	struct io_kiocb *req = cmd_to_io_kiocb(cmd);
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (cmd->flags & IORING_URING_CMD_CANCELABLE)
+		return;
+
+	io_ring_submit_lock(ctx, issue_flags);
+	cmd->flags |= IORING_URING_CMD_CANCELABLE;
+	hlist_add_head(&req->hash_node, &ctx->cancelable_uring_cmd);
+	io_ring_submit_unlock(ctx, issue_flags);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_mark_cancelable);
+
+bool io_uring_try_cancel_uring_cmd(struct io_ring_ctx *ctx,
+				   struct task_struct *task, bool cancel_all)
+{
+	struct hlist_node *tmp;
+	struct io_kiocb *req;
+	bool ret = false;
+
+	lockdep_assert_held(&ctx->uring_lock);
+
+	hlist_for_each_entry_safe(req, tmp, &ctx->cancelable_uring_cmd,
+				  hash_node) {
+		struct io_uring_cmd *cmd = io_kiocb_to_cmd(req,
+							   struct io_uring_cmd);
+
+		if (!cancel_all && req->task != task)
+			continue;
+		/* the handler completes it in task context, if it can */
+		req->file->f_op->uring_cmd(cmd, IO_URING_F_CANCEL);
+		ret = true;
+	}
+	return ret;
+}
+
 static void io_uring_cmd_work(struct io_kiocb *req, bool *locked)
 {
 	struct io_uring_cmd *ioucmd = io_kiocb_to_cmd(req, struct io_uring_cmd);
 
+	if (ioucmd->flags & IORING_URING_CMD_CANCELABLE) {
+		io_tw_lock(req->ctx, locked);
+		hlist_del(&req->hash_node);
+		ioucmd->flags &= ~IORING_URING_CMD_CANCELABLE;
+	}
 	ioucmd->task_work_cb(ioucmd);
 }
 
@@ -46,13 +100,16 @@ void io_uring_cmd_done(struct io_uring_cmd *ioucmd, ssize_t ret, ssize_t res2)
 {
 	struct io_kiocb *req = cmd_to_io_kiocb(ioucmd);
 
+	/* see io_uring_cmd_mark_cancelable() */
+	WARN_ON_ONCE(ioucmd->flags & IORING_URING_CMD_CANCELABLE);
+
 	if (ret < 0)
 		req_set_fail(req);
 
 	io_req_set_res(req, ret, 0);
 	if (req->ctx->flags & IORING_SETUP_CQE32)
 		io_req_set_cqe32_extra(req, res2, 0);
-	if (req->ctx->flags & IORING_SETUP_IOPOLL)
+	if (ioucmd->flags & IORING_URING_CMD_POLLED)
 		/* order with io_iopoll_req_issued() checking ->iopoll_complete */
 		smp_store_release(&req->iopoll_completed, 1);
 	else
@@ -121,6 +178,7 @@ int io_uring_cmd(struct io_kiocb *req, unsigned int issue_flags)
 		issue_flags |= IO_URING_F_CQE32;
 	if (ctx->flags & IORING_SETUP_IOPOLL) {
 		issue_flags |= IO_URING_F_IOPOLL;
+		ioucmd->flags |= IORING_URING_CMD_POLLED;
 		req->iopoll_completed = 0;
 		WRITE_ONCE(ioucmd->cookie, NULL);
 	}
@@ -379,12 +379,45 @@ static void complexmode_tryleave(struct sem_array *sma)
 }
 
 #define SEM_GLOBAL_LOCK	(-1)
+
+/*
+ * Check whether all operations in @sops target the same semaphore.
+ */
+static inline bool sem_ops_single(struct sembuf *sops, int nsops)
+{
+	int i;
+
+	if (!sops || nsops < 1)
+		return false;
+
+	for (i = 1; i < nsops; i++) {
+		if (sops[i].sem_num != sops[0].sem_num)
+			return false;
+	}
+	return true;
+}
+
 /*
- * If the request contains only one semaphore operation, and there are
+ * Complex operation - acquire a full lock.
+ */
+static inline int sem_lock_complex(struct sem_array *sma)
+{
+	ipc_lock_object(&sma->sem_perm);
+
+	/* Prevent parallel simple ops */
+	complexmode_enter(sma);
+	return SEM_GLOBAL_LOCK;
+}
+
+/*
+ * If all operations of the request affect one semaphore, and there are
  * no complex transactions pending, lock only the semaphore involved.
  * Otherwise, lock the entire semaphore array, since we either have
  * multiple semaphores in our own semops, or we need to look at
  * semaphores from other pending complex operations.
+ *
+ * Note that only requests with a single operation may sleep in the
+ * per-semaphore queues, see __do_semtimedop().
  */
 static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 			      int nsops)
@@ -392,14 +425,8 @@ static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 	struct sem *sem;
 	int idx;
 
-	if (nsops != 1) {
-		/* Complex operation - acquire a full lock */
-		ipc_lock_object(&sma->sem_perm);
-
-		/* Prevent parallel simple ops */
-		complexmode_enter(sma);
-		return SEM_GLOBAL_LOCK;
-	}
+	if (!sem_ops_single(sops, nsops))
+		return sem_lock_complex(sma);
 
 	/*
 	 * Only one semaphore affected - try to optimize locking.
@@ -2076,10 +2103,11 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	/*
 	 * We eventually might perform the following check in a lockless
 	 * fashion, considering ipc_valid_object() locking constraints.
-	 * If nsops == 1 and there is no contention for sem_perm.lock, then
-	 * only a per-semaphore lock is held and it's OK to proceed with the
-	 * check below. More details on the fine grained locking scheme
-	 * entangled here and why it's RMID race safe on comments at sem_lock()
+	 * If all sops target one semaphore and there is no contention for
+	 * sem_perm.lock, then only a per-semaphore lock is held and it's OK
+	 * to proceed with the check below. More details on the fine grained
+	 * locking scheme entangled here and why it's RMID race safe on
+	 * comments at sem_lock()
 	 */
 	if (!ipc_valid_object(&sma->sem_perm))
 		goto out_unlock;
@@ -2101,6 +2129,24 @@ long __do_semtimedop(int semid, struct sembuf *sops,
 	queue.dupsop = dupsop;
 
 	error = perform_atomic_semop(sma, &queue);
+	if (error > 0 && nsops > 1 && locknum != SEM_GLOBAL_LOCK) {
+		/*
+		 * Multiple operations on one semaphore may run under its
+		 * lock, but they cannot sleep in the per-semaphore queues:
+		 * update_queue() assumes those only hold single decrements.
+		 * Retry under the global lock and queue as a complex op.
+		 */
+		sem_unlock(sma, locknum);
+		locknum = sem_lock_complex(sma);
+
+		error = -EIDRM;
+		if (!ipc_valid_object(&sma->sem_perm))
+			goto out_unlock;
+		if (un && un->semid == -1)
+			goto out_unlock;
+
+		error = perform_atomic_semop(sma, &queue);
+	}
 	if (error == 0) { /* non-blocking successful path */
 		DEFINE_WAKE_Q(wake_q);
 
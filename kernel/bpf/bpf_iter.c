@@ -504,6 +504,20 @@ bool bpf_link_is_iter(struct bpf_link *link)
 	return link->ops == &bpf_iter_link_lops;
 }
 
+/* Called by the attach_target callbacks of the targets that can be sharded */
+int bpf_iter_shard_check(struct bpf_iter_aux_info *aux, u32 shard,
+			 u32 nr_shards)
+{
+	if (!nr_shards)
+		return shard ? -EINVAL : 0;
+	if (shard >= nr_shards)
+		return -EINVAL;
+
+	aux->shard = shard;
+	aux->nr_shards = nr_shards;
+	return 0;
+}
+
 int bpf_iter_link_attach(const union bpf_attr *attr, bpfptr_t uattr,
 			 struct bpf_prog *prog)
 {
@@ -16,6 +16,9 @@
 #include <linux/rcupdate_wait.h>
 
 #define BPF_LOCAL_STORAGE_CREATE_FLAG_MASK (BPF_F_NO_PREALLOC | BPF_F_CLONE)
+#define BPF_LOCAL_STORAGE_SLOTS_MIN_BITS	2
+#define BPF_LOCAL_STORAGE_SLOT_DEAD \
+	((struct bpf_local_storage_data *)1UL)
 
 static struct bpf_local_storage_map_bucket *
 select_bucket(struct bpf_local_storage_map *smap,
@@ -84,18 +87,237 @@ bpf_selem_alloc(struct bpf_local_storage_map *smap, void *owner,
 	return NULL;
 }
 
-void bpf_local_storage_free_rcu(struct rcu_head *rcu)
+static void __bpf_local_storage_free(struct bpf_local_storage *local_storage)
 {
-	struct bpf_local_storage *local_storage;
+	kfree(rcu_dereference_protected(local_storage->slots, true));
+	kfree(local_storage);
+}
 
-	/* If RCU Tasks Trace grace period implies RCU grace period, do
-	 * kfree(), else do kfree_rcu().
+static void bpf_local_storage_free_rcu_gp(struct rcu_head *rcu)
+{
+	__bpf_local_storage_free(container_of(rcu, struct bpf_local_storage,
+					      rcu));
+}
+
+void bpf_local_storage_free_rcu(struct rcu_head *rcu)
+{
+	/* If RCU Tasks Trace grace period implies RCU grace period, free
+	 * now, else wait for a RCU grace period too.
 	 */
-	local_storage = container_of(rcu, struct bpf_local_storage, rcu);
 	if (rcu_trace_implies_rcu_gp())
-		kfree(local_storage);
+		bpf_local_storage_free_rcu_gp(rcu);
 	else
-		kfree_rcu(local_storage, rcu);
+		call_rcu(rcu, bpf_local_storage_free_rcu_gp);
+}
+
+void bpf_local_storage_free(struct bpf_local_storage *local_storage,
+			    bool use_trace_rcu)
+{
+	if (use_trace_rcu)
+		call_rcu_tasks_trace(&local_storage->rcu,
+				     bpf_local_storage_free_rcu);
+	else
+		call_rcu(&local_storage->rcu, bpf_local_storage_free_rcu_gp);
+}
+
+static void bpf_local_storage_slots_free_rcu(struct rcu_head *rcu)
+{
+	struct bpf_local_storage_slots *slots;
+
+	slots = container_of(rcu, struct bpf_local_storage_slots, rcu);
+	if (rcu_trace_implies_rcu_gp())
+		kfree(slots);
+	else
+		kfree_rcu(slots, rcu);
+}
+
+static u32 bpf_local_storage_slots_size(struct bpf_local_storage_slots *slots)
+{
+	return slots ? struct_size(slots, data, 1U << slots->bits) : 0;
+}
+
+/* Charged to the owner like the storage itself, so sk storage counts
+ * against the socket's optmem.
+ */
+static struct bpf_local_storage_slots *
+bpf_local_storage_slots_alloc(struct bpf_local_storage_map *smap, void *owner,
+			      u32 nr, gfp_t gfp_flags)
+{
+	struct bpf_local_storage_slots *slots;
+	u32 bits, size;
+
+	/* At most half full after a rebuild */
+	bits = max_t(u32, ilog2(roundup_pow_of_two(2 * nr)),
+		     BPF_LOCAL_STORAGE_SLOTS_MIN_BITS);
+	size = struct_size(slots, data, 1U << bits);
+	if (mem_charge(smap, owner, size))
+		return NULL;
+
+	slots = bpf_map_kzalloc(&smap->map, size, gfp_flags | __GFP_NOWARN);
+	if (!slots) {
+		mem_uncharge(smap, owner, size);
+		return NULL;
+	}
+	slots->bits = bits;
+	return slots;
+}
+
+static struct bpf_local_storage_data *
+bpf_local_storage_slot_find(struct bpf_local_storage_slots *slots,
+			    struct bpf_local_storage_map *smap)
+{
+	u32 mask = (1U << slots->bits) - 1;
+	u32 i = hash_ptr(smap, slots->bits);
+	struct bpf_local_storage_data *sdata;
+	u32 n;
+
+	for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+		sdata = rcu_dereference_check(slots->data[i],
+					      bpf_rcu_lock_held());
+		if (!sdata)
+			break;
+		if (sdata != BPF_LOCAL_STORAGE_SLOT_DEAD &&
+		    rcu_access_pointer(sdata->smap) == smap)
+			return sdata;
+	}
+	return NULL;
+}
+
+/* local_storage->lock must be held.  A replacing sdata takes over the
+ * slot of the one it replaces, otherwise the first unlinked or empty
+ * slot is used.  One empty slot is always kept so that misses stop
+ * early.
+ */
+static void bpf_local_storage_slot_set(struct bpf_local_storage_slots *slots,
+				       struct bpf_local_storage_map *smap,
+				       struct bpf_local_storage_data *sdata)
+{
+	struct bpf_local_storage_data __rcu **slot = NULL;
+	struct bpf_local_storage_data *cur;
+	u32 mask = (1U << slots->bits) - 1;
+	u32 i = hash_ptr(smap, slots->bits);
+	u32 n;
+
+	for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+		cur = rcu_dereference_protected(slots->data[i], true);
+		if (!cur)
+			break;
+		if (cur == BPF_LOCAL_STORAGE_SLOT_DEAD) {
+			if (!slot)
+				slot = &slots->data[i];
+			continue;
+		}
+		if (rcu_access_pointer(cur->smap) == smap) {
+			slot = &slots->data[i];
+			break;
+		}
+	}
+
+	if (!slot) {
+		if (n > mask || slots->used + 1 > mask) {
+			WRITE_ONCE(slots->overflow, true);
+			return;
+		}
+		slot = &slots->data[i];
+		WRITE_ONCE(slots->used, slots->used + 1);
+	}
+	rcu_assign_pointer(*slot, sdata);
+}
+
+/* local_storage->lock must be held */
+static void bpf_local_storage_slot_clear(struct bpf_local_storage_slots *slots,
+					 struct bpf_local_storage_map *smap,
+					 struct bpf_local_storage_data *sdata)
+{
+	u32 mask = (1U << slots->bits) - 1;
+	u32 i = hash_ptr(smap, slots->bits);
+	struct bpf_local_storage_data *cur;
+	u32 n;
+
+	for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+		cur = rcu_dereference_protected(slots->data[i], true);
+		if (!cur)
+			return;
+		/* Keep the probe sequence of the following slots intact */
+		if (cur == sdata) {
+			RCU_INIT_POINTER(slots->data[i],
+					 BPF_LOCAL_STORAGE_SLOT_DEAD);
+			return;
+		}
+	}
+}
+
+static bool bpf_local_storage_slots_fit(struct bpf_local_storage_slots *slots,
+					struct bpf_local_storage_map *smap)
+{
+	if (!slots || READ_ONCE(slots->overflow))
+		return false;
+	if (bpf_local_storage_slot_find(slots, smap))
+		return true;
+	/* Rebuild at 3/4 full, unlinked slots included */
+	return (READ_ONCE(slots->used) + 1) * 4 <= 3U << slots->bits;
+}
+
+/* Make sure local_storage->slots has room for an elem of smap before it
+ * is linked by bpf_selem_link_storage_nolock().  The table is rebuilt
+ * from local_storage->list, which drops the unlinked slots and sizes it
+ * for the elems the owner has now.
+ */
+int bpf_local_storage_slot_prepare(void *owner,
+				   struct bpf_local_storage *local_storage,
+				   struct bpf_local_storage_map *smap,
+				   gfp_t gfp_flags)
+{
+	struct bpf_local_storage_slots *slots, *old_slots;
+	struct bpf_local_storage_elem *selem;
+	unsigned long flags;
+	u32 nr = 1;
+	int err = 0;
+
+	old_slots = rcu_dereference_check(local_storage->slots,
+					  bpf_rcu_lock_held());
+	if (bpf_local_storage_slots_fit(old_slots, smap))
+		return 0;
+
+	hlist_for_each_entry_rcu(selem, &local_storage->list, snode,
+				 bpf_rcu_lock_held())
+		nr++;
+	slots = bpf_local_storage_slots_alloc(smap, owner, nr, gfp_flags);
+	if (!slots)
+		return -ENOMEM;
+
+	raw_spin_lock_irqsave(&local_storage->lock, flags);
+	old_slots = rcu_dereference_protected(local_storage->slots,
+				lockdep_is_held(&local_storage->lock));
+	if (unlikely(hlist_empty(&local_storage->list))) {
+		/* Going away, see bpf_local_storage_update() */
+		err = -EAGAIN;
+		goto unlock_free;
+	}
+	if (bpf_local_storage_slots_fit(old_slots, smap))
+		/* Rebuilt by a parallel update */
+		goto unlock_free;
+
+	hlist_for_each_entry(selem, &local_storage->list, snode)
+		bpf_local_storage_slot_set(slots,
+			rcu_dereference_protected(SDATA(selem)->smap, true),
+			SDATA(selem));
+	rcu_assign_pointer(local_storage->slots, slots);
+	raw_spin_unlock_irqrestore(&local_storage->lock, flags);
+
+	if (old_slots) {
+		mem_uncharge(smap, owner,
+			     bpf_local_storage_slots_size(old_slots));
+		call_rcu_tasks_trace(&old_slots->rcu,
+				     bpf_local_storage_slots_free_rcu);
+	}
+	return 0;
+
+unlock_free:
+	raw_spin_unlock_irqrestore(&local_storage->lock, flags);
+	mem_uncharge(smap, owner, bpf_local_storage_slots_size(slots));
+	kfree(slots);
+	return err;
 }
 
 static void bpf_selem_free_rcu(struct rcu_head *rcu)
@@ -117,6 +339,7 @@ static bool bpf_selem_unlink_storage_nolock(struct bpf_local_storage *local_stor
 					    struct bpf_local_storage_elem *selem,
 					    bool uncharge_mem, bool use_trace_rcu)
 {
+	struct bpf_local_storage_slots *slots;
 	struct bpf_local_storage_map *smap;
 	bool free_local_storage;
 	void *owner;
@@ -131,10 +354,13 @@ static bool bpf_selem_unlink_storage_nolock(struct bpf_local_storage *local_stor
 	if (uncharge_mem)
 		mem_uncharge(smap, owner, smap->elem_size);
 
+	slots = rcu_dereference_protected(local_storage->slots,
+					  lockdep_is_held(&local_storage->lock));
 	free_local_storage = hlist_is_singular_node(&selem->snode,
 						    &local_storage->list);
 	if (free_local_storage) {
-		mem_uncharge(smap, owner, sizeof(struct bpf_local_storage));
+		mem_uncharge(smap, owner, sizeof(struct bpf_local_storage) +
+			     bpf_local_storage_slots_size(slots));
 		local_storage->owner = NULL;
 
 		/* After this RCU_INIT, owner may be freed and cannot be used */
@@ -158,6 +384,9 @@ static bool bpf_selem_unlink_storage_nolock(struct bpf_local_storage *local_stor
 	if (rcu_access_pointer(local_storage->cache[smap->cache_idx]) ==
 	    SDATA(selem))
 		RCU_INIT_POINTER(local_storage->cache[smap->cache_idx], NULL);
+	/* A replacing selem has already taken over the slot */
+	if (slots)
+		bpf_local_storage_slot_clear(slots, smap, SDATA(selem));
 
 	if (use_trace_rcu)
 		call_rcu_tasks_trace(&selem->rcu, bpf_selem_free_rcu);
@@ -186,20 +415,26 @@ static void __bpf_selem_unlink_storage(struct bpf_local_storage_elem *selem,
 			local_storage, selem, true, use_trace_rcu);
 	raw_spin_unlock_irqrestore(&local_storage->lock, flags);
 
-	if (free_local_storage) {
-		if (use_trace_rcu)
-			call_rcu_tasks_trace(&local_storage->rcu,
-				     bpf_local_storage_free_rcu);
-		else
-			kfree_rcu(local_storage, rcu);
-	}
+	if (free_local_storage)
+		bpf_local_storage_free(local_storage, use_trace_rcu);
 }
 
+/* bpf_local_storage_slot_prepare() should have made room in the slots.
+ * If the elem still does not fit, lookups walk the list until the next
+ * rebuild.
+ */
 void bpf_selem_link_storage_nolock(struct bpf_local_storage *local_storage,
 				   struct bpf_local_storage_elem *selem)
 {
+	struct bpf_local_storage_slots *slots;
+	struct bpf_local_storage_map *smap;
+
+	smap = rcu_dereference_protected(SDATA(selem)->smap, true);
+	slots = rcu_dereference_protected(local_storage->slots, true);
 	RCU_INIT_POINTER(selem->local_storage, local_storage);
 	hlist_add_head_rcu(&selem->snode, &local_storage->list);
+	if (slots)
+		bpf_local_storage_slot_set(slots, smap, SDATA(selem));
 }
 
 void bpf_selem_unlink_map(struct bpf_local_storage_elem *selem)
@@ -248,6 +483,7 @@ bpf_local_storage_lookup(struct bpf_local_storage *local_storage,
 			 struct bpf_local_storage_map *smap,
 			 bool cacheit_lockit)
 {
+	struct bpf_local_storage_slots *slots;
 	struct bpf_local_storage_data *sdata;
 	struct bpf_local_storage_elem *selem;
 
@@ -257,16 +493,24 @@ bpf_local_storage_lookup(struct bpf_local_storage *local_storage,
 	if (sdata && rcu_access_pointer(sdata->smap) == smap)
 		return sdata;
 
-	/* Slow path (cache miss) */
-	hlist_for_each_entry_rcu(selem, &local_storage->list, snode,
-				  rcu_read_lock_trace_held())
-		if (rcu_access_pointer(SDATA(selem)->smap) == smap)
-			break;
+	/* Slow path (cache miss), O(1) unless the slots overflowed */
+	sdata = NULL;
+	slots = rcu_dereference_check(local_storage->slots, bpf_rcu_lock_held());
+	if (slots)
+		sdata = bpf_local_storage_slot_find(slots, smap);
+	if (!sdata && (!slots || READ_ONCE(slots->overflow))) {
+		hlist_for_each_entry_rcu(selem, &local_storage->list, snode,
+					 rcu_read_lock_trace_held())
+			if (rcu_access_pointer(SDATA(selem)->smap) == smap)
+				break;
+		if (selem)
+			sdata = SDATA(selem);
+	}
 
-	if (!selem)
+	if (!sdata)
 		return NULL;
 
-	sdata = SDATA(selem);
+	selem = SELEM(sdata);
 	if (cacheit_lockit) {
 		unsigned long flags;
 
@@ -322,9 +566,17 @@ int bpf_local_storage_alloc(void *owner,
 	INIT_HLIST_HEAD(&storage->list);
 	raw_spin_lock_init(&storage->lock);
 	storage->owner = owner;
+	RCU_INIT_POINTER(storage->slots,
+			 bpf_local_storage_slots_alloc(smap, owner, 1,
+						       gfp_flags));
+	if (!rcu_access_pointer(storage->slots)) {
+		err = -ENOMEM;
+		goto uncharge;
+	}
 
-	bpf_selem_link_storage_nolock(storage, first_selem);
+	/* link_map sets the selem's smap that link_storage needs */
 	bpf_selem_link_map(smap, first_selem);
+	bpf_selem_link_storage_nolock(storage, first_selem);
 
 	owner_storage_ptr =
 		(struct bpf_local_storage **)owner_storage(smap, owner);
@@ -358,7 +610,11 @@ int bpf_local_storage_alloc(void *owner,
 	return 0;
 
 uncharge:
-	kfree(storage);
+	if (storage) {
+		mem_uncharge(smap, owner, bpf_local_storage_slots_size(
+			rcu_dereference_protected(storage->slots, true)));
+		__bpf_local_storage_free(storage);
+	}
 	mem_uncharge(smap, owner, sizeof(*storage));
 	return err;
 }
@@ -427,6 +683,11 @@ bpf_local_storage_update(void *owner, struct bpf_local_storage_map *smap,
 		}
 	}
 
+	err = bpf_local_storage_slot_prepare(owner, local_storage, smap,
+					     gfp_flags);
+	if (err)
+		return ERR_PTR(err);
+
 	if (gfp_flags == GFP_KERNEL) {
 		selem = bpf_selem_alloc(smap, owner, value, true, gfp_flags);
 		if (!selem)
@@ -4,6 +4,7 @@
 #include <linux/cpumask.h>
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
+#include <linux/slab.h>
 
 #include "bpf_lru_list.h"
 
@@ -13,12 +14,25 @@
 #define PERCPU_FREE_TARGET		(4)
 #define PERCPU_NR_SCANS			PERCPU_FREE_TARGET
 
+#define LRU_CPUS_PER_SHARD		(4)
+#define LRU_MAX_SHARDS			(16)
+/* One in LRU_REBALANCE_INTERVAL refills of a local free list is taken
+ * from a remote shard
+ */
+#define LRU_REBALANCE_INTERVAL		(16)
+
 /* Helpers to get the local list index */
 #define LOCAL_LIST_IDX(t)	((t) - BPF_LOCAL_LIST_T_OFFSET)
 #define LOCAL_FREE_LIST_IDX	LOCAL_LIST_IDX(BPF_LRU_LOCAL_LIST_T_FREE)
 #define LOCAL_PENDING_LIST_IDX	LOCAL_LIST_IDX(BPF_LRU_LOCAL_LIST_T_PENDING)
 #define IS_LOCAL_LIST_TYPE(t)	((t) >= BPF_LOCAL_LIST_T_OFFSET)
 
+static struct bpf_lru_list *bpf_common_lru_shard(struct bpf_common_lru *clru,
+						  int cpu)
+{
+	return &clru->shards[cpu % clru->nr_shards];
+}
+
 static int get_next_cpu(int cpu)
 {
 	cpu = cpumask_next(cpu, cpu_possible_mask);
@@ -315,33 +329,85 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
-static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+static unsigned int
+__bpf_lru_list_pop_free_to_local(struct bpf_lru *lru, struct bpf_lru_list *l,
+				 struct bpf_lru_locallist *loc_l,
+				 unsigned int tgt_nfree, bool flush)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
 	raw_spin_lock(&l->lock);
 
-	__local_list_flush(l, loc_l);
+	if (flush)
+		__local_list_flush(l, loc_l);
 
 	__bpf_lru_list_rotate(lru, l);
 
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
 				 list) {
+		if (nfree == tgt_nfree)
+			break;
 		__bpf_lru_node_move_to_free(l, node, local_free_list(loc_l),
 					    BPF_LRU_LOCAL_LIST_T_FREE);
-		if (++nfree == LOCAL_FREE_TARGET)
-			break;
+		nfree++;
 	}
 
-	if (nfree < LOCAL_FREE_TARGET)
-		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
-				      local_free_list(loc_l),
-				      BPF_LRU_LOCAL_LIST_T_FREE);
+	if (nfree < tgt_nfree)
+		nfree += __bpf_lru_list_shrink(lru, l, tgt_nfree - nfree,
+					       local_free_list(loc_l),
+					       BPF_LRU_LOCAL_LIST_T_FREE);
 
 	raw_spin_unlock(&l->lock);
+
+	return nfree;
+}
+
+/* The pending nodes of @cpu always go to its own shard, so a node on a
+ * shard's lists has node->cpu mapping to that shard.  Free nodes are
+ * normally taken from the own shard too.  If it has none, or once every
+ * LRU_REBALANCE_INTERVAL refills, they are taken from the remote shards
+ * in round robin instead.  The latter keeps the CPUs that insert the most
+ * from only recycling their own recently used entries while the shards of
+ * idle CPUs hold on to old ones, and lets the nodes migrate to the shards
+ * where they are needed.
+ */
+static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+					   struct bpf_lru_locallist *loc_l,
+					   int cpu)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	unsigned int tgt_nfree = LOCAL_FREE_TARGET;
+	unsigned int home, shard, nfree, i;
+
+	home = cpu % clru->nr_shards;
+	if (clru->nr_shards > 1 &&
+	    !(++loc_l->nr_refills % LRU_REBALANCE_INTERVAL))
+		tgt_nfree = 0;
+
+	nfree = __bpf_lru_list_pop_free_to_local(lru, &clru->shards[home],
+						 loc_l, tgt_nfree, true);
+
+	for (i = 0; i < clru->nr_shards && !nfree; i++) {
+		shard = loc_l->next_shard;
+		loc_l->next_shard = (shard + 1) % clru->nr_shards;
+		if (shard == home)
+			continue;
+
+		nfree = __bpf_lru_list_pop_free_to_local(lru,
+							 &clru->shards[shard],
+							 loc_l,
+							 LOCAL_FREE_TARGET,
+							 false);
+	}
+
+	/* A rebalancing refill skipped the home shard, and the remote ones
+	 * had nothing to give: fall back to it rather than fail the update.
+	 */
+	if (!nfree && !tgt_nfree)
+		__bpf_lru_list_pop_free_to_local(lru, &clru->shards[home],
+						 loc_l, LOCAL_FREE_TARGET,
+						 false);
 }
 
 static void __local_list_add_pending(struct bpf_lru *lru,
@@ -444,7 +510,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 	node = __local_list_pop_free(loc_l);
 	if (!node) {
-		bpf_lru_list_pop_free_to_local(lru, loc_l);
+		bpf_lru_list_pop_free_to_local(lru, loc_l, cpu);
 		node = __local_list_pop_free(loc_l);
 	}
 
@@ -457,7 +523,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 		return node;
 
 	/* No free nodes found from the local free list and
-	 * the global LRU list.
+	 * the shards of the LRU list.
 	 *
 	 * Steal from the local free/pending list of the
 	 * current CPU and remote CPU in RR.  It starts
@@ -530,7 +596,8 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	bpf_lru_list_push_free(bpf_common_lru_shard(&lru->common_lru,
+						    node->cpu), node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -560,15 +627,22 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
+	struct bpf_common_lru *clru = &lru->common_lru;
+	struct bpf_lru_list *l;
 	u32 i;
 
 	for (i = 0; i < nr_elems; i++) {
 		struct bpf_lru_node *node;
 
+		/* Spread the nodes evenly over the shards, node->cpu
+		 * only needs to map to the right one until the node
+		 * is handed out.
+		 */
 		node = (struct bpf_lru_node *)(buf + node_offset);
+		node->cpu = i % clru->nr_shards;
 		node->type = BPF_LRU_LIST_T_FREE;
 		node->ref = 0;
+		l = bpf_common_lru_shard(clru, node->cpu);
 		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
 		buf += elem_size;
 	}
@@ -662,19 +736,33 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		lru->nr_scans = PERCPU_NR_SCANS;
 	} else {
 		struct bpf_common_lru *clru = &lru->common_lru;
+		unsigned int i;
+
+		clru->nr_shards = clamp_t(unsigned int,
+					  DIV_ROUND_UP(num_possible_cpus(),
+						       LRU_CPUS_PER_SHARD),
+					  1, LRU_MAX_SHARDS);
+		clru->shards = kcalloc(clru->nr_shards, sizeof(*clru->shards),
+				       GFP_KERNEL);
+		if (!clru->shards)
+			return -ENOMEM;
 
 		clru->local_list = alloc_percpu(struct bpf_lru_locallist);
-		if (!clru->local_list)
+		if (!clru->local_list) {
+			kfree(clru->shards);
 			return -ENOMEM;
+		}
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
 
 			loc_l = per_cpu_ptr(clru->local_list, cpu);
 			bpf_lru_locallist_init(loc_l, cpu);
+			loc_l->next_shard = (cpu + 1) % clru->nr_shards;
 		}
 
-		bpf_lru_list_init(&clru->lru_list);
+		for (i = 0; i < clru->nr_shards; i++)
+			bpf_lru_list_init(&clru->shards[i]);
 		lru->nr_scans = LOCAL_NR_SCANS;
 	}
 
@@ -688,8 +776,10 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
 		free_percpu(lru->common_lru.local_list);
+		kfree(lru->common_lru.shards);
+	}
 }
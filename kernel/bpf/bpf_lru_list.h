@@ -40,11 +40,19 @@ struct bpf_lru_list {
 struct bpf_lru_locallist {
 	struct list_head lists[NR_BPF_LRU_LOCAL_LIST_T];
 	u16 next_steal;
+	/* The next remote shard to refill from */
+	u16 next_shard;
+	u16 nr_refills;
 	raw_spinlock_t lock;
 };
 
 struct bpf_common_lru {
-	struct bpf_lru_list lru_list;
+	/* The LRU list is split into nr_shards lists with a lock each.
+	 * A CPU flushes its pending nodes to, and refills its free list
+	 * from, the shard its id maps to.
+	 */
+	struct bpf_lru_list *shards;
+	unsigned int nr_shards;
 	struct bpf_lru_locallist __percpu *local_list;
 };
 
@@ -1939,6 +1939,7 @@ struct bpf_iter_seq_hash_map_info {
 	struct bpf_htab *htab;
 	void *percpu_value_buf; // non-zero means percpu hash
 	u32 bucket_id;
+	u32 bucket_end;
 	u32 skip_elems;
 };
 
@@ -1955,7 +1956,7 @@ bpf_hash_map_seq_find_next(struct bpf_iter_seq_hash_map_info *info,
 	struct bucket *b;
 	u32 i, count;
 
-	if (bucket_id >= htab->n_buckets)
+	if (bucket_id >= info->bucket_end)
 		return NULL;
 
 	/* try to find next elem in the same bucket */
@@ -1974,7 +1975,7 @@ bpf_hash_map_seq_find_next(struct bpf_iter_seq_hash_map_info *info,
 		skip_elems = 0;
 	}
 
-	for (i = bucket_id; i < htab->n_buckets; i++) {
+	for (i = bucket_id; i < info->bucket_end; i++) {
 		b = &htab->buckets[i];
 		rcu_read_lock();
 
@@ -2094,6 +2095,8 @@ static int bpf_iter_init_hash_map(void *priv_data,
 	bpf_map_inc_with_uref(map);
 	seq_info->map = map;
 	seq_info->htab = container_of(map, struct bpf_htab, map);
+	bpf_iter_shard_range(aux, seq_info->htab->n_buckets,
+			     &seq_info->bucket_id, &seq_info->bucket_end);
 	return 0;
 }
 
@@ -136,6 +136,10 @@ static int bpf_iter_attach_map(struct bpf_prog *prog,
 		goto put_map;
 	}
 
+	err = bpf_iter_shard_check(aux, linfo->map.shard, linfo->map.nr_shards);
+	if (err)
+		goto put_map;
+
 	aux->map = map;
 	return 0;
 
@@ -153,6 +157,8 @@ void bpf_iter_map_show_fdinfo(const struct bpf_iter_aux_info *aux,
 			      struct seq_file *seq)
 {
 	seq_printf(seq, "map_id:\t%u\n", aux->map->id);
+	if (aux->nr_shards)
+		seq_printf(seq, "shard:\t%u/%u\n", aux->shard, aux->nr_shards);
 }
 
 int bpf_iter_map_fill_link_info(const struct bpf_iter_aux_info *aux,
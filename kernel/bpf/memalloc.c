@@ -31,7 +31,8 @@
  * of freeing objects allocated by one cpu and freed on another.
  *
  * Every allocated objected is padded with extra 8 bytes that contains
- * struct llist_node.
+ * struct llist_node. While an object from bpf_mem_alloc() is handed out,
+ * the same 8 bytes hold the index of its size class.
  */
 #define LLIST_NODE_SZ sizeof(struct llist_node)
 
@@ -643,18 +644,28 @@ void notrace *bpf_mem_alloc(struct bpf_mem_alloc *ma, size_t size)
 		return NULL;
 
 	ret = unit_alloc(this_cpu_ptr(ma->caches)->cache + idx);
-	return !ret ? NULL : ret + LLIST_NODE_SZ;
+	if (!ret)
+		return NULL;
+
+	/* The llist_node is unused while the object is allocated, keep the
+	 * size class in there for bpf_mem_free().
+	 */
+	*(unsigned long *)ret = idx;
+	return ret + LLIST_NODE_SZ;
 }
 
 void notrace bpf_mem_free(struct bpf_mem_alloc *ma, void *ptr)
 {
-	int idx;
+	unsigned long idx;
 
 	if (!ptr)
 		return;
 
-	idx = bpf_mem_cache_idx(ksize(ptr - LLIST_NODE_SZ));
-	if (idx < 0)
+	/* Stored by bpf_mem_alloc(), cheaper than asking the slab allocator
+	 * with ksize() and valid for every cpu's set of caches.
+	 */
+	idx = *(unsigned long *)(ptr - LLIST_NODE_SZ);
+	if (WARN_ON_ONCE(idx >= NUM_CACHES))
 		return;
 
 	unit_free(this_cpu_ptr(ma->caches)->cache + idx, ptr);
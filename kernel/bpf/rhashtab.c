@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Resizable hash table map
+ *
+ * BPF_MAP_TYPE_RHASH keeps its elements in an rhashtable, so the number of
+ * buckets follows the number of elements instead of being fixed by
+ * max_entries at creation time.  max_entries only caps the number of
+ * elements.  Lookups walk the table under RCU without taking any lock,
+ * updates and deletes take the bit lock of a single bucket, and the table
+ * is grown and shrunk from a worker in the background.
+ */
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <linux/filter.h>
+#include <linux/rhashtable.h>
+#include <linux/rcupdate_trace.h>
+
+#define RHTAB_CREATE_FLAG_MASK \
+	(BPF_F_NO_PREALLOC | BPF_F_NUMA_NODE | BPF_F_ACCESS_MASK)
+
+/* rhashtable allows twice as many elements as buckets */
+#define RHTAB_MAX_ENTRIES	(1U << 30)
+
+struct bpf_rhtab {
+	struct bpf_map map;
+	struct rhashtable ht;
+	struct rhashtable_params params;
+	atomic_t count;
+	u32 elem_size;
+	/* Guards against a program attached inside the rhashtable code
+	 * updating the map it interrupted on the same CPU.
+	 */
+	int __percpu *map_locked;
+};
+
+struct rhtab_elem {
+	struct rhash_head node;
+	struct rcu_head rcu;
+	char key[] __aligned(8);
+};
+
+static inline void *rhtab_elem_value(struct rhtab_elem *l, u32 key_size)
+{
+	return l->key + round_up(key_size, 8);
+}
+
+static int rhtab_map_alloc_check(union bpf_attr *attr)
+{
+	if (attr->map_flags & ~RHTAB_CREATE_FLAG_MASK ||
+	    !bpf_map_flags_access_ok(attr->map_flags))
+		return -EINVAL;
+
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return -EINVAL;
+
+	if (attr->max_entries > RHTAB_MAX_ENTRIES)
+		return -E2BIG;
+
+	if ((u64)attr->key_size + attr->value_size >= KMALLOC_MAX_SIZE -
+	    sizeof(struct rhtab_elem))
+		/* Same limit as for BPF_MAP_TYPE_HASH, elements are kmalloc'ed
+		 * one by one and copied to user space in one go.
+		 */
+		return -E2BIG;
+
+	return 0;
+}
+
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_rhtab *rhtab;
+	int err;
+
+	rhtab = bpf_map_area_alloc(sizeof(*rhtab), NUMA_NO_NODE);
+	if (!rhtab)
+		return ERR_PTR(-ENOMEM);
+
+	bpf_map_init_from_attr(&rhtab->map, attr);
+
+	rhtab->elem_size = sizeof(struct rhtab_elem) +
+			   round_up(rhtab->map.key_size, 8) +
+			   round_up(rhtab->map.value_size, 8);
+	atomic_set(&rhtab->count, 0);
+
+	err = -ENOMEM;
+	rhtab->map_locked = bpf_map_alloc_percpu(&rhtab->map, sizeof(int),
+						 sizeof(int), GFP_USER);
+	if (!rhtab->map_locked)
+		goto free_rhtab;
+
+	rhtab->params = (struct rhashtable_params) {
+		.head_offset		= offsetof(struct rhtab_elem, node),
+		.key_offset		= offsetof(struct rhtab_elem, key),
+		.key_len		= rhtab->map.key_size,
+		.max_size		= roundup_pow_of_two(rhtab->map.max_entries),
+		.automatic_shrinking	= true,
+	};
+
+	err = rhashtable_init(&rhtab->ht, &rhtab->params);
+	if (err)
+		goto free_map_locked;
+
+	return &rhtab->map;
+
+free_map_locked:
+	free_percpu(rhtab->map_locked);
+free_rhtab:
+	bpf_map_area_free(rhtab);
+	return ERR_PTR(err);
+}
+
+static void rhtab_free_elem(void *ptr, void *arg)
+{
+	kfree(ptr);
+}
+
+/* Called when map->refcnt goes to zero, either from workqueue or from syscall */
+static void rhtab_map_free(struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	/* No program can reach the table any more, but elements replaced or
+	 * deleted before that may still be waiting for their grace period.
+	 * They are off the table already and only need kfree().
+	 */
+	rhashtable_free_and_destroy(&rhtab->ht, rhtab_free_elem, NULL);
+	free_percpu(rhtab->map_locked);
+	bpf_map_area_free(rhtab);
+}
+
+/* Called from syscall or from eBPF program directly, so
+ * arguments have to match bpf_map_lookup_elem() exactly.
+ * The return value is adjusted by BPF instructions
+ * in rhtab_map_gen_lookup().
+ */
+static void *__rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_trace_held() &&
+		     !rcu_read_lock_bh_held());
+
+	return rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+}
+
+static void *rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct rhtab_elem *l = __rhtab_map_lookup_elem(map, key);
+
+	if (l)
+		return rhtab_elem_value(l, map->key_size);
+
+	return NULL;
+}
+
+/* inline bpf_map_lookup_elem() call.
+ * Instead of:
+ * bpf_prog
+ *   bpf_map_lookup_elem
+ *     map->ops->map_lookup_elem
+ *       rhtab_map_lookup_elem
+ *         __rhtab_map_lookup_elem
+ * do:
+ * bpf_prog
+ *   __rhtab_map_lookup_elem
+ */
+static int rhtab_map_gen_lookup(struct bpf_map *map, struct bpf_insn *insn_buf)
+{
+	struct bpf_insn *insn = insn_buf;
+	const int ret = BPF_REG_0;
+
+	BUILD_BUG_ON(!__same_type(&__rhtab_map_lookup_elem,
+		     (void *(*)(struct bpf_map *map, void *key))NULL));
+	*insn++ = BPF_EMIT_CALL(__rhtab_map_lookup_elem);
+	*insn++ = BPF_JMP_IMM(BPF_JEQ, ret, 0, 1);
+	*insn++ = BPF_ALU64_IMM(BPF_ADD, ret,
+				offsetof(struct rhtab_elem, key) +
+				round_up(map->key_size, 8));
+	return insn - insn_buf;
+}
+
+/* The bucket locks of rhashtable are taken with bottom halves disabled, so
+ * updates cannot be done from hard interrupt or NMI context, or with
+ * interrupts disabled.
+ */
+static int rhtab_lock(struct bpf_rhtab *rhtab)
+{
+	if (unlikely(in_hardirq() || in_nmi() || irqs_disabled()))
+		return -EBUSY;
+
+	preempt_disable();
+	if (unlikely(__this_cpu_inc_return(*rhtab->map_locked) != 1)) {
+		__this_cpu_dec(*rhtab->map_locked);
+		preempt_enable();
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+static void rhtab_unlock(struct bpf_rhtab *rhtab)
+{
+	__this_cpu_dec(*rhtab->map_locked);
+	preempt_enable();
+}
+
+static struct rhtab_elem *rhtab_alloc_elem(struct bpf_rhtab *rhtab,
+					   void *key, void *value)
+{
+	struct bpf_map *map = &rhtab->map;
+	struct rhtab_elem *l;
+
+	l = bpf_map_kmalloc_node(map, rhtab->elem_size,
+				 GFP_ATOMIC | __GFP_NOWARN, map->numa_node);
+	if (!l)
+		return NULL;
+
+	memcpy(l->key, key, map->key_size);
+	copy_map_value(map, rhtab_elem_value(l, map->key_size), value);
+	return l;
+}
+
+static int rhtab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				 u64 map_flags)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l_old, *l_new;
+	int ret;
+
+	if (unlikely(map_flags > BPF_EXIST))
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_trace_held() &&
+		     !rcu_read_lock_bh_held());
+
+	ret = rhtab_lock(rhtab);
+	if (ret)
+		return ret;
+
+	l_new = rhtab_alloc_elem(rhtab, key, value);
+	if (!l_new) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+again:
+	l_old = rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+	if (l_old && map_flags == BPF_NOEXIST) {
+		ret = -EEXIST;
+		goto free_new;
+	}
+	if (!l_old && map_flags == BPF_EXIST) {
+		ret = -ENOENT;
+		goto free_new;
+	}
+
+	if (l_old) {
+		/* Readers see either the old or the new value, never a
+		 * partially copied one.
+		 */
+		ret = rhashtable_replace_fast(&rhtab->ht, &l_old->node,
+					      &l_new->node, rhtab->params);
+		if (ret == -ENOENT)
+			/* deleted or replaced under us */
+			goto again;
+		if (ret)
+			goto free_new;
+		kfree_rcu(l_old, rcu);
+		goto unlock;
+	}
+
+	if (atomic_inc_return(&rhtab->count) > map->max_entries) {
+		atomic_dec(&rhtab->count);
+		ret = -E2BIG;
+		goto free_new;
+	}
+
+	ret = rhashtable_lookup_insert_fast(&rhtab->ht, &l_new->node,
+					    rhtab->params);
+	if (ret) {
+		atomic_dec(&rhtab->count);
+		if (ret == -EEXIST)
+			/* inserted under us */
+			goto again;
+		goto free_new;
+	}
+
+unlock:
+	rhtab_unlock(rhtab);
+	return ret;
+
+free_new:
+	kfree(l_new);
+	goto unlock;
+}
+
+static int rhtab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+	int ret;
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_trace_held() &&
+		     !rcu_read_lock_bh_held());
+
+	ret = rhtab_lock(rhtab);
+	if (ret)
+		return ret;
+
+	l = rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+	if (!l) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+
+	ret = rhashtable_remove_fast(&rhtab->ht, &l->node, rhtab->params);
+	if (!ret) {
+		atomic_dec(&rhtab->count);
+		kfree_rcu(l, rcu);
+	}
+
+unlock:
+	rhtab_unlock(rhtab);
+	return ret;
+}
+
+/* Called from syscall under rcu_read_lock().  Elements are returned in
+ * bucket order.  Like for BPF_MAP_TYPE_HASH, a key that is not in the map
+ * restarts the walk from the first element, and a walk running while the
+ * table is being resized may return some keys twice or miss them.
+ */
+static int rhtab_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l, *cur = NULL;
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	unsigned int hash = 0;
+	bool skip = false;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+
+	if (key)
+		cur = rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+	if (cur) {
+		hash = rht_head_hashfn(&rhtab->ht, tbl, &cur->node,
+				       rhtab->params);
+		skip = true;
+	}
+
+	for (; hash < tbl->size; hash++) {
+		rht_for_each_entry_rcu(l, pos, tbl, hash, node) {
+			if (skip) {
+				if (l == cur)
+					skip = false;
+				continue;
+			}
+
+			memcpy(next_key, l->key, map->key_size);
+			return 0;
+		}
+		skip = false;
+	}
+
+	return -ENOENT;
+}
+
+BTF_ID_LIST_SINGLE(rhtab_map_btf_ids, struct, bpf_rhtab)
+const struct bpf_map_ops rhtab_map_ops = {
+	.map_meta_equal = bpf_map_meta_equal,
+	.map_alloc_check = rhtab_map_alloc_check,
+	.map_alloc = rhtab_map_alloc,
+	.map_free = rhtab_map_free,
+	.map_get_next_key = rhtab_map_get_next_key,
+	.map_lookup_elem = rhtab_map_lookup_elem,
+	.map_update_elem = rhtab_map_update_elem,
+	.map_delete_elem = rhtab_map_delete_elem,
+	.map_gen_lookup = rhtab_map_gen_lookup,
+	.map_lookup_batch = generic_map_lookup_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_btf_id = &rhtab_map_btf_ids[0],
+};
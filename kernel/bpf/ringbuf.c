@@ -9,6 +9,7 @@
 #include <linux/wait.h>
 #include <linux/poll.h>
 #include <linux/kmemleak.h>
+#include <linux/timer.h>
 #include <uapi/linux/btf.h>
 #include <linux/btf_ids.h>
 
@@ -22,6 +23,9 @@
 
 #define RINGBUF_MAX_RECORD_SZ (UINT_MAX/4)
 
+/* longest a record below the wakeup watermark waits for its notification */
+#define RINGBUF_WAKEUP_DELAY msecs_to_jiffies(10)
+
 /* Maximum size of ring buffer area is limited by 32-bit page offset within
  * record header, counted in pages. Reserve 8 bits for extensibility, and take
  * into account few extra pages for consumer/producer pages and
@@ -35,6 +39,16 @@ struct bpf_ringbuf {
 	wait_queue_head_t waitq;
 	struct irq_work work;
 	u64 mask;
+	/* kernel-producer only: bytes to accumulate before waking up the
+	 * consumer, 0 to wake it up as soon as it has data to read
+	 */
+	u64 wakeup_watermark;
+	/* bounds the wait of records below the watermark: armed from
+	 * timer_work by the first such record, cleared when it fires
+	 */
+	struct timer_list wakeup_timer;
+	struct irq_work timer_work;
+	unsigned long timer_armed;
 	struct page **pages;
 	int nr_pages;
 	spinlock_t spinlock ____cacheline_aligned_in_smp;
@@ -160,6 +174,22 @@ static void bpf_ringbuf_notify(struct irq_work *work)
 	wake_up_all(&rb->waitq);
 }
 
+static void bpf_ringbuf_arm_timer(struct irq_work *work)
+{
+	struct bpf_ringbuf *rb = container_of(work, struct bpf_ringbuf,
+					      timer_work);
+
+	mod_timer(&rb->wakeup_timer, jiffies + RINGBUF_WAKEUP_DELAY);
+}
+
+static void bpf_ringbuf_wakeup_timeout(struct timer_list *t)
+{
+	struct bpf_ringbuf *rb = from_timer(rb, t, wakeup_timer);
+
+	clear_bit(0, &rb->timer_armed);
+	wake_up_all(&rb->waitq);
+}
+
 static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 {
 	struct bpf_ringbuf *rb;
@@ -172,6 +202,9 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	atomic_set(&rb->busy, 0);
 	init_waitqueue_head(&rb->waitq);
 	init_irq_work(&rb->work, bpf_ringbuf_notify);
+	init_irq_work(&rb->timer_work, bpf_ringbuf_arm_timer);
+	timer_setup(&rb->wakeup_timer, bpf_ringbuf_wakeup_timeout, 0);
+	rb->timer_armed = 0;
 
 	rb->mask = data_sz - 1;
 	rb->consumer_pos = 0;
@@ -192,6 +225,10 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 	    !PAGE_ALIGNED(attr->max_entries))
 		return ERR_PTR(-EINVAL);
 
+	/* map_extra is the wakeup watermark, see bpf_ringbuf_need_wakeup() */
+	if (attr->map_extra >= attr->max_entries)
+		return ERR_PTR(-EINVAL);
+
 #ifdef CONFIG_64BIT
 	/* on 32-bit arch, it's impossible to overflow record's hdr->pgoff */
 	if (attr->max_entries > RINGBUF_MAX_DATA_SZ)
@@ -209,6 +246,7 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 		bpf_map_area_free(rb_map);
 		return ERR_PTR(-ENOMEM);
 	}
+	rb_map->rb->wakeup_watermark = attr->map_extra;
 
 	return &rb_map->map;
 }
@@ -221,6 +259,8 @@ static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
 	struct page **pages = rb->pages;
 	int i, nr_pages = rb->nr_pages;
 
+	irq_work_sync(&rb->timer_work);
+	timer_shutdown_sync(&rb->wakeup_timer);
 	vunmap(rb);
 	for (i = 0; i < nr_pages; i++)
 		__free_page(pages[i]);
@@ -453,6 +493,34 @@ const struct bpf_func_proto bpf_ringbuf_reserve_proto = {
 	.arg3_type	= ARG_ANYTHING,
 };
 
+/* Without a watermark, notify the consumer when it caught up and is waiting
+ * for this very record. With a watermark, hold notifications back until that
+ * many bytes are waiting to be consumed, and then notify when this record is
+ * the one crossing the watermark, or when the consumer is stuck on it with
+ * enough data queued behind it. Records are committed out of order, so the
+ * latter catches the record that held up a consumer woken by a later one.
+ * Records that don't get there are notified by wakeup_timer instead, see
+ * bpf_ringbuf_commit().
+ */
+static bool bpf_ringbuf_need_wakeup(struct bpf_ringbuf *rb,
+				    unsigned long rec_pos,
+				    unsigned long cons_pos, u32 len)
+{
+	unsigned long rec_off, rec_end, avail;
+	u64 watermark = rb->wakeup_watermark;
+
+	rec_off = (rec_pos - cons_pos) & rb->mask;
+	if (!watermark)
+		return rec_off == 0;
+
+	avail = smp_load_acquire(&rb->producer_pos) - cons_pos;
+	if (avail < watermark)
+		return false;
+
+	rec_end = rec_off + round_up(len + BPF_RINGBUF_HDR_SZ, 8);
+	return rec_off == 0 || (rec_off < watermark && rec_end >= watermark);
+}
+
 static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 {
 	unsigned long rec_pos, cons_pos;
@@ -473,12 +541,20 @@ static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 	 * new data availability
 	 */
 	rec_pos = (void *)hdr - (void *)rb->data;
-	cons_pos = smp_load_acquire(&rb->consumer_pos) & rb->mask;
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
 
-	if (flags & BPF_RB_FORCE_WAKEUP)
+	if (flags & BPF_RB_FORCE_WAKEUP) {
 		irq_work_queue(&rb->work);
-	else if (cons_pos == rec_pos && !(flags & BPF_RB_NO_WAKEUP))
+	} else if (flags & BPF_RB_NO_WAKEUP) {
+		return;
+	} else if (bpf_ringbuf_need_wakeup(rb, rec_pos, cons_pos,
+					   new_len & ~BPF_RINGBUF_DISCARD_BIT)) {
 		irq_work_queue(&rb->work);
+	} else if (rb->wakeup_watermark && !test_bit(0, &rb->timer_armed) &&
+		   !test_and_set_bit(0, &rb->timer_armed)) {
+		/* may run in NMI, so arm the timer from irq_work */
+		irq_work_queue(&rb->timer_work);
+	}
 }
 
 BPF_CALL_2(bpf_ringbuf_submit, void *, sample, u64, flags)
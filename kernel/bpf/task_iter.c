@@ -21,6 +21,8 @@ struct bpf_iter_seq_task_common {
 	enum bpf_iter_task_type	type;
 	u32 pid;
 	u32 pid_visiting;
+	u32 shard;
+	u32 nr_shards;
 };
 
 struct bpf_iter_seq_task_info {
@@ -140,6 +142,13 @@ static struct task_struct *task_seq_get_next(struct bpf_iter_seq_task_common *co
 	pid = find_ge_pid(*tid, common->ns);
 	if (pid) {
 		*tid = pid_nr_ns(pid, common->ns);
+		if (common->nr_shards &&
+		    *tid % common->nr_shards != common->shard) {
+			/* Skip to the next tid of this shard */
+			*tid += (common->shard + common->nr_shards -
+				 *tid % common->nr_shards) % common->nr_shards;
+			goto retry;
+		}
 		task = get_pid_task(pid, PIDTYPE_PID);
 		if (!task) {
 			++*tid;
@@ -230,10 +239,20 @@ static int bpf_iter_attach_task(struct bpf_prog *prog,
 	unsigned int flags;
 	struct pid *pid;
 	pid_t tgid;
+	int err;
 
 	if ((!!linfo->task.tid + !!linfo->task.pid + !!linfo->task.pid_fd) > 1)
 		return -EINVAL;
 
+	/* Only an iterator over all tasks can be sharded */
+	err = bpf_iter_shard_check(aux, linfo->task.shard,
+				   linfo->task.nr_shards);
+	if (err)
+		return err;
+	if (aux->nr_shards &&
+	    (linfo->task.tid || linfo->task.pid || linfo->task.pid_fd))
+		return -EINVAL;
+
 	aux->task.type = BPF_TASK_ITER_ALL;
 	if (linfo->task.tid != 0) {
 		aux->task.type = BPF_TASK_ITER_TID;
@@ -414,6 +433,8 @@ static int init_seq_pidns(void *priv_data, struct bpf_iter_aux_info *aux)
 	common->ns = get_pid_ns(task_active_pid_ns(current));
 	common->type = aux->task.type;
 	common->pid = aux->task.pid;
+	common->shard = aux->shard;
+	common->nr_shards = aux->nr_shards;
 
 	return 0;
 }
@@ -715,6 +736,8 @@ static void bpf_iter_task_show_fdinfo(const struct bpf_iter_aux_info *aux, struc
 		seq_printf(seq, "tid:\t%u\n", aux->task.pid);
 	else if (aux->task.type == BPF_TASK_ITER_TGID)
 		seq_printf(seq, "pid:\t%u\n", aux->task.pid);
+	if (aux->nr_shards)
+		seq_printf(seq, "shard:\t%u/%u\n", aux->shard, aux->nr_shards);
 }
 
 static struct bpf_iter_reg task_reg_info = {
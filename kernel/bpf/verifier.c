@@ -9088,7 +9088,7 @@ static int check_kfunc_call(struct bpf_verifier_env *env, struct bpf_insn *insn,
 	func_name = btf_name_by_offset(desc_btf, func->name_off);
 	func_proto = btf_type_by_id(desc_btf, func->type);
 
-	kfunc_flags = btf_kfunc_id_set_contains(desc_btf, resolve_prog_type(env->prog), func_id);
+	kfunc_flags = btf_kfunc_id_set_contains(desc_btf, func_id, env->prog);
 	if (!kfunc_flags) {
 		verbose(env, "calling kernel function %s is not allowed\n",
 			func_name);
@@ -13290,6 +13290,8 @@ static bool states_equal(struct bpf_verifier_env *env,
 {
 	int i;
 
+	env->states_compared++;
+
 	if (old->curframe != cur->curframe)
 		return false;
 
@@ -13470,9 +13472,9 @@ static bool states_maybe_looping(struct bpf_verifier_state *old,
 }
 
 
-static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
+static int __is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 {
-	struct bpf_verifier_state_list *new_sl;
+	struct bpf_verifier_state_list *new_sl, **head;
 	struct bpf_verifier_state_list *sl, **pprev;
 	struct bpf_verifier_state *cur = env->cur_state, *new;
 	int i, j, err, states_cnt = 0;
@@ -13490,7 +13492,8 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	    env->insn_processed - env->prev_insn_processed >= 8)
 		add_new_state = true;
 
-	pprev = explored_state(env, insn_idx);
+	head = explored_state(env, insn_idx);
+	pprev = head;
 	sl = *pprev;
 
 	clean_live_states(env, insn_idx, cur);
@@ -13541,6 +13544,17 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 		}
 		if (states_equal(env, &sl->state, cur)) {
 			sl->hit_cnt++;
+			env->states_pruned++;
+			/* States that prune once tend to prune again: move it
+			 * to the head of the list, so that the next lookup at
+			 * this instruction compares against it first instead
+			 * of walking past the states that keep missing.
+			 */
+			if (pprev != head) {
+				*pprev = sl->next;
+				sl->next = *head;
+				*head = sl;
+			}
 			/* reached equivalent register/stack state,
 			 * prune the search.
 			 * Registers read by the continuation are read by us.
@@ -13689,6 +13703,21 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	return 0;
 }
 
+static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
+{
+	u64 start_time;
+	int ret;
+
+	if (!(env->log.level & BPF_LOG_STATS))
+		return __is_state_visited(env, insn_idx);
+
+	start_time = ktime_get_ns();
+	ret = __is_state_visited(env, insn_idx);
+	env->prune_time += ktime_get_ns() - start_time;
+
+	return ret;
+}
+
 /* Return true if it's OK to have the same insn return a different type. */
 static bool reg_type_mismatch_ok(enum bpf_reg_type type)
 {
@@ -15920,6 +15949,33 @@ static int do_misc_fixups(struct bpf_verifier_env *env)
 			goto patch_call_imm;
 		}
 
+#if defined(CONFIG_X86_64) && defined(CONFIG_SMP)
+		/* Implement bpf_get_smp_processor_id() inline. */
+		if (insn->imm == BPF_FUNC_get_smp_processor_id &&
+		    prog->jit_requested && bpf_jit_supports_percpu_insn()) {
+			/* Read pcpu_hot.cpu_number the way
+			 * raw_smp_processor_id() does. This is only an
+			 * optimization, if the layout of pcpu_hot ever
+			 * changes the call can simply stay a call.
+			 */
+			insn_buf[0] = BPF_MOV32_IMM(BPF_REG_0,
+						    (u32)(unsigned long)&pcpu_hot.cpu_number);
+			insn_buf[1] = BPF_MOV64_PERCPU_REG(BPF_REG_0, BPF_REG_0);
+			insn_buf[2] = BPF_LDX_MEM(BPF_W, BPF_REG_0, BPF_REG_0, 0);
+			cnt = 3;
+
+			new_prog = bpf_patch_insn_data(env, i + delta, insn_buf,
+						       cnt);
+			if (!new_prog)
+				return -ENOMEM;
+
+			delta    += cnt - 1;
+			env->prog = prog = new_prog;
+			insn      = new_prog->insnsi + i + delta;
+			continue;
+		}
+#endif
+
 		/* Implement bpf_jiffies64 inline. */
 		if (prog->jit_requested && BITS_PER_LONG == 64 &&
 		    insn->imm == BPF_FUNC_jiffies64) {
@@ -16372,6 +16428,9 @@ static void print_verification_stats(struct bpf_verifier_env *env)
 	if (env->log.level & BPF_LOG_STATS) {
 		verbose(env, "verification time %lld usec\n",
 			div_u64(env->verification_time, 1000));
+		verbose(env, "state pruning time %lld usec states_compared %u states_pruned %u\n",
+			div_u64(env->prune_time, 1000), env->states_compared,
+			env->states_pruned);
 		verbose(env, "stack depth ");
 		for (i = 0; i < env->subprog_cnt; i++) {
 			u32 depth = env->subprog_info[i].stack_depth;
@@ -125,6 +125,39 @@ DEFINE_PERCPU_RWSEM(cgroup_threadgroup_rwsem);
  */
 static struct workqueue_struct *cgroup_destroy_wq;
 
+/*
+ * Offlining and releasing csses both need cgroup_mutex.  With many
+ * short-lived cgroups, taking it once per css makes the destruction path
+ * contend with cgroup creation for every single css.  Instead, killed and
+ * released csses are queued on lockless lists and a single work item per
+ * stage processes them in batches of up to CSS_DESTROY_BATCH per
+ * cgroup_mutex acquisition.
+ */
+#define CSS_DESTROY_BATCH	64
+
+struct css_destroy_batch {
+	struct llist_head	list;
+	struct work_struct	work;
+	void			(*fn)(struct cgroup_subsys_state *css);
+};
+
+static void css_destroy_batch_workfn(struct work_struct *work);
+
+static void css_offline_locked(struct cgroup_subsys_state *css);
+static void css_release_locked(struct cgroup_subsys_state *css);
+
+static struct css_destroy_batch css_offline_batch = {
+	.work	= __WORK_INITIALIZER(css_offline_batch.work,
+				     css_destroy_batch_workfn),
+	.fn	= css_offline_locked,
+};
+
+static struct css_destroy_batch css_release_batch = {
+	.work	= __WORK_INITIALIZER(css_release_batch.work,
+				     css_destroy_batch_workfn),
+	.fn	= css_release_locked,
+};
+
 /* generate an array of cgroup subsystem pointers */
 #define SUBSYS(_x) [_x ## _cgrp_id] = &_x ## _cgrp_subsys,
 struct cgroup_subsys *cgroup_subsys[] = {
@@ -5324,9 +5357,10 @@ static struct cftype cgroup_psi_files[] = {
  * 4. After the grace period, the css can be freed.  Implemented in
  *    css_free_work_fn().
  *
- * It is actually hairier because both step 2 and 4 require process context
- * and thus involve punting to css->destroy_work adding two additional
- * steps to the already complex sequence.
+ * It is actually hairier because steps 2, 3 and 4 require process context
+ * and thus involve punting to css_offline_batch, css_release_batch and
+ * css->destroy_rwork, adding additional steps to the already complex
+ * sequence.
  */
 static void css_free_rwork_fn(struct work_struct *work)
 {
@@ -5378,14 +5412,46 @@ static void css_free_rwork_fn(struct work_struct *work)
 	}
 }
 
-static void css_release_work_fn(struct work_struct *work)
+static void css_destroy_batch_workfn(struct work_struct *work)
+{
+	struct css_destroy_batch *batch =
+		container_of(work, struct css_destroy_batch, work);
+	struct cgroup_subsys_state *css, *next;
+	struct llist_node *head;
+	int nr;
+
+	while ((head = llist_del_all(&batch->list))) {
+		/* llist is LIFO, process in queueing order */
+		head = llist_reverse_order(head);
+		nr = 0;
+
+		mutex_lock(&cgroup_mutex);
+		llist_for_each_entry_safe(css, next, head, destroy_llnode) {
+			batch->fn(css);
+			if (!(++nr % CSS_DESTROY_BATCH)) {
+				mutex_unlock(&cgroup_mutex);
+				cond_resched();
+				mutex_lock(&cgroup_mutex);
+			}
+		}
+		mutex_unlock(&cgroup_mutex);
+	}
+}
+
+static void css_destroy_batch_add(struct css_destroy_batch *batch,
+				  struct cgroup_subsys_state *css)
+{
+	/* the first one to add to an empty list kicks the work item */
+	if (llist_add(&css->destroy_llnode, &batch->list))
+		queue_work(cgroup_destroy_wq, &batch->work);
+}
+
+static void css_release_locked(struct cgroup_subsys_state *css)
 {
-	struct cgroup_subsys_state *css =
-		container_of(work, struct cgroup_subsys_state, destroy_work);
 	struct cgroup_subsys *ss = css->ss;
 	struct cgroup *cgrp = css->cgroup;
 
-	mutex_lock(&cgroup_mutex);
+	lockdep_assert_held(&cgroup_mutex);
 
 	css->flags |= CSS_RELEASED;
 	list_del_rcu(&css->sibling);
@@ -5426,8 +5492,6 @@ static void css_release_work_fn(struct work_struct *work)
 					 NULL);
 	}
 
-	mutex_unlock(&cgroup_mutex);
-
 	INIT_RCU_WORK(&css->destroy_rwork, css_free_rwork_fn);
 	queue_rcu_work(cgroup_destroy_wq, &css->destroy_rwork);
 }
@@ -5437,8 +5501,7 @@ static void css_release(struct percpu_ref *ref)
 	struct cgroup_subsys_state *css =
 		container_of(ref, struct cgroup_subsys_state, refcnt);
 
-	INIT_WORK(&css->destroy_work, css_release_work_fn);
-	queue_work(cgroup_destroy_wq, &css->destroy_work);
+	css_destroy_batch_add(&css_release_batch, css);
 }
 
 static void init_and_link_css(struct cgroup_subsys_state *css,
@@ -5769,12 +5832,9 @@ int cgroup_mkdir(struct kernfs_node *parent_kn, const char *name, umode_t mode)
  * css_tryget_online() is now guaranteed to fail.  Tell the subsystem to
  * initiate destruction and put the css ref from kill_css().
  */
-static void css_killed_work_fn(struct work_struct *work)
+static void css_offline_locked(struct cgroup_subsys_state *css)
 {
-	struct cgroup_subsys_state *css =
-		container_of(work, struct cgroup_subsys_state, destroy_work);
-
-	mutex_lock(&cgroup_mutex);
+	lockdep_assert_held(&cgroup_mutex);
 
 	do {
 		offline_css(css);
@@ -5782,8 +5842,6 @@ static void css_killed_work_fn(struct work_struct *work)
 		/* @css can't go away while we're holding cgroup_mutex */
 		css = css->parent;
 	} while (css && atomic_dec_and_test(&css->online_cnt));
-
-	mutex_unlock(&cgroup_mutex);
 }
 
 /* css kill confirmation processing requires process context, bounce */
@@ -5792,10 +5850,8 @@ static void css_killed_ref_fn(struct percpu_ref *ref)
 	struct cgroup_subsys_state *css =
 		container_of(ref, struct cgroup_subsys_state, refcnt);
 
-	if (atomic_dec_and_test(&css->online_cnt)) {
-		INIT_WORK(&css->destroy_work, css_killed_work_fn);
-		queue_work(cgroup_destroy_wq, &css->destroy_work);
-	}
+	if (atomic_dec_and_test(&css->online_cnt))
+		css_destroy_batch_add(&css_offline_batch, css);
 }
 
 /**
@@ -6159,8 +6215,8 @@ static int __init cgroup_wq_init(void)
 {
 	/*
 	 * There isn't much point in executing destruction path in
-	 * parallel.  Good chunk is serialized with cgroup_mutex anyway.
-	 * Use 1 for @max_active.
+	 * parallel.  Good chunk is serialized with cgroup_mutex anyway and
+	 * offlining and releasing are batched.  Use 1 for @max_active.
 	 *
 	 * We would prefer to do this in cgroup_init() above, but that
 	 * is called before init_workqueues(): so leave this until after.
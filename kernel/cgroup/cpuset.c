@@ -1120,8 +1120,12 @@ partition_and_rebuild_sched_domains(int ndoms_new, cpumask_var_t doms_new[],
 				    struct sched_domain_attr *dattr_new)
 {
 	mutex_lock(&sched_domains_mutex);
-	partition_sched_domains_locked(ndoms_new, doms_new, dattr_new);
-	rebuild_root_domains();
+	/*
+	 * Rebuilding the root domains walks every task in the system, skip
+	 * it when the partitioning did not actually change.
+	 */
+	if (partition_sched_domains_locked(ndoms_new, doms_new, dattr_new))
+		rebuild_root_domains();
 	mutex_unlock(&sched_domains_mutex);
 }
 
@@ -1224,6 +1228,14 @@ static void update_tasks_cpumask(struct cpuset *cs)
 		if (top_cs && (task->flags & PF_KTHREAD) &&
 		    kthread_is_per_cpu(task))
 			continue;
+		/*
+		 * Nothing to do for tasks already confined to the new mask,
+		 * which avoids taking their rq locks. A concurrent
+		 * sched_setaffinity() rechecks the cpuset mask itself.
+		 */
+		if (!task->user_cpus_ptr &&
+		    cpumask_equal(&task->cpus_mask, cs->effective_cpus))
+			continue;
 		set_cpus_allowed_ptr(task, cs->effective_cpus);
 	}
 	css_task_iter_end(&it);
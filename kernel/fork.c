@@ -474,17 +474,41 @@ struct vm_area_struct *vm_area_dup(struct vm_area_struct *orig)
 		 */
 		*new = data_race(*orig);
 		INIT_LIST_HEAD(&new->anon_vma_chain);
+		vma_init_lock(new);
+		vma_mark_detached(new, false);
 		dup_anon_vma_name(orig, new);
 	}
 	return new;
 }
 
-void vm_area_free(struct vm_area_struct *vma)
+static void __vm_area_free(struct vm_area_struct *vma)
 {
 	free_anon_vma_name(vma);
 	kmem_cache_free(vm_area_cachep, vma);
 }
 
+#ifdef CONFIG_PER_VMA_LOCK
+static void vm_area_free_rcu_cb(struct rcu_head *head)
+{
+	struct vm_area_struct *vma = container_of(head, struct vm_area_struct,
+						  vm_rcu);
+
+	/* The vma should not be locked while being destroyed. */
+	VM_BUG_ON_VMA(rwsem_is_locked(&vma->vm_lock), vma);
+	__vm_area_free(vma);
+}
+#endif
+
+void vm_area_free(struct vm_area_struct *vma)
+{
+#ifdef CONFIG_PER_VMA_LOCK
+	/* lock_vma_under_rcu() may still be looking at the vma */
+	call_rcu(&vma->vm_rcu, vm_area_free_rcu_cb);
+#else
+	__vm_area_free(vma);
+#endif
+}
+
 static void account_kernel_stack(struct task_struct *tsk, int account)
 {
 	if (IS_ENABLED(CONFIG_VMAP_STACK)) {
@@ -620,6 +644,8 @@ static __latent_entropy int dup_mmap(struct mm_struct *mm,
 	mas_for_each(&old_mas, mpnt, ULONG_MAX) {
 		struct file *file;
 
+		/* copy_page_range() write-protects the ptes of the parent */
+		vma_start_write(mpnt);
 		if (mpnt->vm_flags & VM_DONTCOPY) {
 			vm_stat_account(mm, mpnt->vm_flags, -vma_pages(mpnt));
 			continue;
@@ -798,6 +824,8 @@ void __mmdrop(struct mm_struct *mm)
 	check_mm(mm);
 	put_user_ns(mm->user_ns);
 	mm_pasid_drop(mm);
+	futex_private_hash_free(mm);
+	mm_destroy_cid(mm);
 
 	for (i = 0; i < NR_MM_COUNTERS; i++)
 		percpu_counter_destroy(&mm->rss_stat[i]);
@@ -1034,6 +1062,10 @@ static struct task_struct *dup_task_struct(struct task_struct *orig, int node)
 	tsk->task_frag.page = NULL;
 	tsk->wake_q.next = NULL;
 	tsk->worker_private = NULL;
+#ifdef CONFIG_SCHED_MM_CID
+	tsk->mm_cid = -1;
+	tsk->mm_cid_active = 0;
+#endif
 
 	kcov_task_init(tsk);
 	kmsan_task_create(tsk);
@@ -1138,6 +1170,7 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	spin_lock_init(&mm->arg_lock);
 	mm_init_cpumask(mm);
 	mm_init_aio(mm);
+	futex_mm_init(mm);
 	mm_init_owner(mm, p);
 	mm_pasid_init(mm);
 	RCU_INIT_POINTER(mm->exe_file, NULL);
@@ -1163,17 +1196,22 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	if (init_new_context(p, mm))
 		goto fail_nocontext;
 
+	if (mm_alloc_cid(mm))
+		goto fail_nocontext;
+
 	for (i = 0; i < NR_MM_COUNTERS; i++)
 		if (percpu_counter_init(&mm->rss_stat[i], 0, GFP_KERNEL_ACCOUNT))
 			goto fail_pcpu;
 
 	mm->user_ns = get_user_ns(user_ns);
 	lru_gen_init_mm(mm);
+	pt_reclaim_init_mm(mm);
 	return mm;
 
 fail_pcpu:
 	while (i > 0)
 		percpu_counter_destroy(&mm->rss_stat[--i]);
+	mm_destroy_cid(mm);
 fail_nocontext:
 	mm_free_pgd(mm);
 fail_nopgd:
@@ -1591,6 +1629,9 @@ static int copy_mm(unsigned long clone_flags, struct task_struct *tsk)
 		return 0;
 
 	if (clone_flags & CLONE_VM) {
+		/* A vfork child runs no futex code until it execs or exits */
+		if (!(clone_flags & CLONE_VFORK))
+			futex_private_hash_alloc(oldmm);
 		mmget(oldmm);
 		mm = oldmm;
 	} else {
@@ -1601,6 +1642,7 @@ static int copy_mm(unsigned long clone_flags, struct task_struct *tsk)
 
 	tsk->mm = mm;
 	tsk->active_mm = mm;
+	sched_mm_cid_fork(tsk);
 	return 0;
 }
 
@@ -2213,6 +2255,10 @@ static __latent_entropy struct task_struct *copy_process(
 	p->softirqs_enabled		= 1;
 	p->softirq_context		= 0;
 #endif
+#ifdef CONFIG_WAKEUP_LATENCY_PROFILER
+	/* The parent may be in the middle of a wakeup of its own */
+	memset(&p->wakeup_latency, 0, sizeof(p->wakeup_latency));
+#endif
 
 	p->pagefault_disabled = 0;
 
@@ -2839,7 +2885,9 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 		     CLONE_ARGS_SIZE_VER1);
 	BUILD_BUG_ON(offsetofend(struct clone_args, cgroup) !=
 		     CLONE_ARGS_SIZE_VER2);
-	BUILD_BUG_ON(sizeof(struct clone_args) != CLONE_ARGS_SIZE_VER2);
+	BUILD_BUG_ON(offsetofend(struct clone_args, spawn) !=
+		     CLONE_ARGS_SIZE_VER3);
+	BUILD_BUG_ON(sizeof(struct clone_args) != CLONE_ARGS_SIZE_VER3);
 
 	if (unlikely(usize > PAGE_SIZE))
 		return -E2BIG;
@@ -2871,6 +2919,10 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 	    (args.cgroup > INT_MAX || usize < CLONE_ARGS_SIZE_VER2))
 		return -EINVAL;
 
+	if ((args.flags & CLONE_SPAWN) &&
+	    (!args.spawn || usize < CLONE_ARGS_SIZE_VER3))
+		return -EINVAL;
+
 	*kargs = (struct kernel_clone_args){
 		.flags		= args.flags,
 		.pidfd		= u64_to_user_ptr(args.pidfd),
@@ -2882,6 +2934,7 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 		.tls		= args.tls,
 		.set_tid_size	= args.set_tid_size,
 		.cgroup		= args.cgroup,
+		.spawn		= u64_to_user_ptr(args.spawn),
 	};
 
 	if (args.set_tid &&
@@ -2926,7 +2979,8 @@ static bool clone3_args_valid(struct kernel_clone_args *kargs)
 {
 	/* Verify that no unknown flags are passed along. */
 	if (kargs->flags &
-	    ~(CLONE_LEGACY_FLAGS | CLONE_CLEAR_SIGHAND | CLONE_INTO_CGROUP))
+	    ~(CLONE_LEGACY_FLAGS | CLONE_CLEAR_SIGHAND | CLONE_INTO_CGROUP |
+	      CLONE_SPAWN))
 		return false;
 
 	/*
@@ -2947,9 +3001,263 @@ static bool clone3_args_valid(struct kernel_clone_args *kargs)
 	if (!clone3_stack_valid(kargs))
 		return false;
 
+	/*
+	 * A spawned child shares nothing with the parent which the exec
+	 * would have to undo and never runs userspace code before it.
+	 */
+	if ((kargs->flags & CLONE_SPAWN) &&
+	    ((kargs->flags & (CLONE_VM | CLONE_VFORK | CLONE_FILES |
+			      CLONE_SIGHAND | CLONE_THREAD | CLONE_PARENT |
+			      CLONE_SETTLS | CLONE_CHILD_SETTID |
+			      CLONE_CHILD_CLEARTID)) || kargs->stack))
+		return false;
+
 	return true;
 }
 
+/*
+ * State shared between the parent and the child of clone3(CLONE_SPAWN).
+ * The parent may stop waiting for the child early if it gets killed, so
+ * both hold a reference.
+ */
+struct spawn_request {
+	refcount_t		refs;
+	int			error;
+	bool			compat;
+	bool			want_pidfd;
+	struct file		*pidfile;
+	struct clone_spawn_args	args;
+	struct clone_spawn_fd	*fds;
+};
+
+static void spawn_request_put(struct spawn_request *req)
+{
+	if (refcount_dec_and_test(&req->refs)) {
+		if (req->pidfile)
+			fput(req->pidfile);
+		kfree(req->fds);
+		kfree(req);
+	}
+}
+
+static struct spawn_request *
+spawn_request_alloc(struct clone_spawn_args __user *uargs)
+{
+	struct spawn_request *req;
+	int err = -EFAULT;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return ERR_PTR(-ENOMEM);
+
+	if (copy_from_user(&req->args, uargs, sizeof(req->args)))
+		goto err_free;
+
+	err = -EINVAL;
+	if (req->args.flags & ~(CLONE_SPAWN_SETSID | CLONE_SPAWN_SETSIGMASK))
+		goto err_free;
+	if (req->args.nr_fds > rlimit(RLIMIT_NOFILE))
+		goto err_free;
+
+	if (req->args.nr_fds) {
+		req->fds = memdup_user(u64_to_user_ptr(req->args.fds),
+				       req->args.nr_fds * sizeof(*req->fds));
+		if (IS_ERR(req->fds)) {
+			err = PTR_ERR(req->fds);
+			req->fds = NULL;
+			goto err_free;
+		}
+	}
+
+	req->compat = in_compat_syscall();
+	refcount_set(&req->refs, 2);
+	return req;
+
+err_free:
+	kfree(req);
+	return ERR_PTR(err);
+}
+
+/* apply the fd actions and attributes, called in the child */
+static int spawn_setup(struct spawn_request *req)
+{
+	u32 i;
+	int ret;
+
+	for (i = 0; i < req->args.nr_fds; i++) {
+		struct clone_spawn_fd *sfd = &req->fds[i];
+		struct file *file;
+
+		if (sfd->newfd < 0)
+			return -EBADF;
+
+		if (sfd->fd < 0) {
+			close_fd(sfd->newfd);
+			continue;
+		}
+
+		file = fget(sfd->fd);
+		if (!file)
+			return -EBADF;
+		ret = replace_fd(sfd->newfd, file, 0);
+		fput(file);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (req->args.flags & CLONE_SPAWN_SETSID) {
+		ret = ksys_setsid();
+		if (ret < 0)
+			return ret;
+	}
+
+	if (req->args.flags & CLONE_SPAWN_SETSIGMASK) {
+		sigset_t mask;
+
+		sigemptyset(&mask);
+		for (i = 0; i < _NSIG_WORDS && i * _NSIG_BPW < 64; i++)
+			mask.sig[i] = req->args.sigmask >> (i * _NSIG_BPW);
+		set_current_blocked(&mask);
+	}
+
+	return 0;
+}
+
+/*
+ * First and only kernel code a spawned child runs.  On success it returns
+ * to userspace in the new program.  The parent is released from its vfork
+ * wait when the exec drops the shared mm or when the child exits.
+ */
+static int spawn_child(void *arg)
+{
+	struct spawn_request *req = arg;
+	int ret = 0;
+
+	/*
+	 * The pidfd file is created here, where our struct pid is at hand,
+	 * and only installed by the parent once the exec has succeeded, so
+	 * a failed spawn never exposes a descriptor it would have to close.
+	 */
+	if (req->want_pidfd) {
+		struct file *file;
+
+		file = anon_inode_getfile("[pidfd]", &pidfd_fops,
+					  get_pid(task_pid(current)),
+					  O_RDWR | O_CLOEXEC);
+		if (IS_ERR(file)) {
+			put_pid(task_pid(current));
+			ret = PTR_ERR(file);
+		} else {
+			req->pidfile = file;
+		}
+	}
+
+	if (!ret)
+		ret = spawn_setup(req);
+	if (!ret)
+		ret = spawn_execveat(req->args.dirfd,
+				     u64_to_user_ptr(req->args.filename),
+				     u64_to_user_ptr(req->args.argv),
+				     u64_to_user_ptr(req->args.envp),
+				     req->args.exec_flags, req->compat);
+	if (!ret) {
+		spawn_request_put(req);
+		return 0;
+	}
+
+	req->error = ret;
+	spawn_request_put(req);
+	do_exit(127 << 8);
+}
+
+/*
+ * clone3(CLONE_SPAWN) creates a vfork child which shares the parent's mm
+ * and immediately execs in the kernel, so the cost of copying a large
+ * address space, which the exec would throw away anyway, is never paid.
+ */
+static pid_t clone3_spawn(struct kernel_clone_args *kargs)
+{
+	struct spawn_request *req;
+	int pidfd = -1;
+	pid_t nr;
+	int err;
+
+	/*
+	 * The exec and the fd actions run in the kernel on behalf of the
+	 * child and are never seen by a seccomp filter, which would let a
+	 * filtered task that may clone3() exec regardless.
+	 */
+	if (seccomp_mode(&current->seccomp) != SECCOMP_MODE_DISABLED)
+		return -EPERM;
+
+	req = spawn_request_alloc(kargs->spawn);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	if (kargs->flags & CLONE_PIDFD) {
+		pidfd = get_unused_fd_flags(O_RDWR | O_CLOEXEC);
+		if (pidfd < 0) {
+			err = pidfd;
+			goto err_put;
+		}
+		err = put_user(pidfd, kargs->pidfd);
+		if (err)
+			goto err_put;
+		req->want_pidfd = true;
+	}
+
+	kargs->flags &= ~(CLONE_SPAWN | CLONE_PIDFD);
+	kargs->flags |= CLONE_VM | CLONE_VFORK;
+	kargs->fn = spawn_child;
+	kargs->fn_arg = req;
+
+	nr = kernel_clone(kargs);
+	if (nr < 0) {
+		err = nr;
+		goto err_put;
+	}
+
+	/*
+	 * The vfork wait is killable: if we were killed, the child may still
+	 * be in spawn_child() and own req->pidfile, which goes away with the
+	 * last reference. We won't return to userspace, just bail out.
+	 */
+	if (fatal_signal_pending(current)) {
+		if (pidfd >= 0)
+			put_unused_fd(pidfd);
+		spawn_request_put(req);
+		return -EINTR;
+	}
+
+	err = READ_ONCE(req->error);
+	if (!err) {
+		if (pidfd >= 0) {
+			fd_install(pidfd, req->pidfile);
+			req->pidfile = NULL;
+		}
+		spawn_request_put(req);
+		return nr;
+	}
+
+	if (pidfd >= 0)
+		put_unused_fd(pidfd);
+	spawn_request_put(req);
+	/*
+	 * The exec failed and the child has exited, don't leave it behind.
+	 * __WALL as exit_signal need not be SIGCHLD.
+	 */
+	kernel_wait4(nr, NULL, __WALL, NULL);
+	return err;
+
+err_put:
+	if (pidfd >= 0)
+		put_unused_fd(pidfd);
+	/* the child never ran, drop its reference too */
+	refcount_dec(&req->refs);
+	spawn_request_put(req);
+	return err;
+}
+
 /**
  * clone3 - create a new process with specific properties
  * @uargs: argument structure
@@ -2977,6 +3285,9 @@ SYSCALL_DEFINE2(clone3, struct clone_args __user *, uargs, size_t, size)
 	if (!clone3_args_valid(&kargs))
 		return -EINVAL;
 
+	if (kargs.flags & CLONE_SPAWN)
+		return clone3_spawn(&kargs);
+
 	return kernel_clone(&kargs);
 }
 #endif
@@ -3034,7 +3345,7 @@ void __init mm_cache_init(void)
 	 * dynamically sized based on the maximum CPU number this system
 	 * can have, taking hotplug into account (nr_cpu_ids).
 	 */
-	mm_size = sizeof(struct mm_struct) + cpumask_size();
+	mm_size = sizeof(struct mm_struct) + cpumask_size() + mm_cid_size();
 
 	mm_cachep = kmem_cache_create_usercopy("mm_struct",
 			mm_size, ARCH_MIN_MMSTRUCT_ALIGN,
@@ -34,7 +34,6 @@
 #include <linux/compat.h>
 #include <linux/jhash.h>
 #include <linux/pagemap.h>
-#include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
 
@@ -42,16 +41,52 @@
 #include "../locking/rtmutex_common.h"
 
 /*
- * The base of the bucket array and its size are always used together
- * (after initialization only in futex_hash()), so ensure that they
- * reside in the same cacheline.
+ * The global hash is split in one bucket array per node, each allocated on
+ * its node. The arrays and their size are always used together (after
+ * initialization only in futex_hash()), so ensure that the size comes
+ * first, in the same cacheline as the first arrays.
  */
 static struct {
-	struct futex_hash_bucket *queues;
-	unsigned long            hashsize;
+	unsigned long            hashmask;
+	unsigned int             hashshift;
+	struct futex_hash_bucket *queues[MAX_NUMNODES];
 } __futex_data __read_mostly __aligned(2*sizeof(long));
-#define futex_queues   (__futex_data.queues)
-#define futex_hashsize (__futex_data.hashsize)
+#define futex_queues    (__futex_data.queues)
+#define futex_hashmask  (__futex_data.hashmask)
+#define futex_hashshift (__futex_data.hashshift)
+
+/*
+ * Upper bound for the number of buckets of the private hash of a
+ * multi-threaded process, 0 when private futexes are hashed in the global
+ * hash.
+ */
+static unsigned long futex_private_hashsize __read_mostly;
+
+/*
+ * The private hash of a process. It grows with the number of threads of
+ * the process; a replaced table is kept on the @prev chain until the mm
+ * goes away, so that an operation which looked up one of its buckets can
+ * still take the bucket lock, notice with futex_hash_stale() that it has
+ * been replaced and look the key up again.
+ */
+struct futex_private_hash {
+	struct futex_private_hash	*prev;
+	unsigned long			mask;
+	struct futex_hash_bucket	queues[];
+};
+static long futex_private_hashsize_param __initdata = -1;
+
+static int __init setup_futex_private_hash(char *str)
+{
+	unsigned long size;
+
+	if (kstrtoul(str, 0, &size))
+		return 0;
+
+	futex_private_hashsize_param = size ? roundup_pow_of_two(size) : 0;
+	return 1;
+}
+__setup("futex_private_hash=", setup_futex_private_hash);
 
 
 /*
@@ -106,18 +141,247 @@ late_initcall(fail_futex_debugfs);
 #endif /* CONFIG_FAIL_FUTEX */
 
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash - Return the hash bucket of a futex key
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket. The keys of FUTEX2_NUMA futexes are hashed in
+ * the global hash of their node. Private keys of a process which has its
+ * own private hash are hashed there, so that unrelated processes never
+ * share buckets. All the other keys go to the global hash, whose upper hash
+ * bits select the node.
  */
+static inline u32 futex_hash_val(union futex_key *key)
+{
+	return jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
+		      key->both.offset);
+}
+
+static inline bool futex_key_is_private(union futex_key *key)
+{
+	return !key->both.node &&
+	       !(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED));
+}
+
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
-	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
-			  key->both.offset);
+	u32 hash = futex_hash_val(key);
+	unsigned int node;
+
+	if (key->both.node)
+		return &futex_queues[key->both.node - 1][hash & futex_hashmask];
+
+	if (futex_key_is_private(key)) {
+		struct mm_struct *mm = key->private.mm;
+		struct futex_hash_bucket *hb = NULL;
+		struct futex_private_hash *ph;
+		unsigned int seq;
+
+		do {
+			seq = read_seqcount_begin(&mm->futex_phash_seq);
+			/* Pairs with smp_store_release() in futex_private_hash_alloc() */
+			ph = smp_load_acquire(&mm->futex_phash);
+			if (ph)
+				hb = &ph->queues[hash & ph->mask];
+		} while (read_seqcount_retry(&mm->futex_phash_seq, seq));
+
+		if (hb)
+			return hb;
+	}
+
+	node = (hash >> futex_hashshift) % nr_node_ids;
+	return &futex_queues[node][hash & futex_hashmask];
+}
+
+static void futex_hash_bucket_init(struct futex_hash_bucket *hb)
+{
+	atomic_set(&hb->waiters, 0);
+	plist_head_init(&hb->chain);
+	spin_lock_init(&hb->lock);
+}
+
+/**
+ * futex_hash_stale - Check whether a bucket of a private key was replaced
+ * @key:	The futex key @hb was looked up for
+ * @hb:		The bucket returned by futex_hash()
+ *
+ * The private hash of a process is replaced when it grows, and the waiters
+ * are moved to the new table bucket by bucket. A caller which finds @hb
+ * stale must drop its lock and look @key up again. Called either with the
+ * lock of @hb held, or after seeing no waiters on @hb and a read barrier,
+ * in which case waiters which were moved away are not missed.
+ *
+ * Return: true if @hb no longer belongs to the current table of @key.
+ */
+bool futex_hash_stale(union futex_key *key, struct futex_hash_bucket *hb)
+{
+	struct futex_private_hash *ph;
+	struct mm_struct *mm;
+
+	if (!futex_key_is_private(key))
+		return false;
+
+	mm = key->private.mm;
+	/*
+	 * futex_private_hash_grow() publishes the new table before it moves
+	 * the waiters of the first bucket, so once the lock of a bucket which
+	 * has been moved is held, either the sequence count is odd or the new
+	 * table is visible.
+	 */
+	if (raw_read_seqcount(&mm->futex_phash_seq) & 1)
+		return true;
+
+	ph = READ_ONCE(mm->futex_phash);
+	return ph && (hb < ph->queues || hb > &ph->queues[ph->mask]);
+}
+
+/**
+ * futex_q_lockptr_lock - Lock the hash bucket a futex_q is queued on
+ * @q:		The futex_q to lock
+ *
+ * For a futex_q which has been queued and the bucket lock dropped since:
+ * the futex_q may have been requeued, or moved to a grown private hash, in
+ * the meantime, so q->lock_ptr is rechecked once the lock is held.
+ */
+void futex_q_lockptr_lock(struct futex_q *q)
+{
+	spinlock_t *lock_ptr;
+
+retry:
+	lock_ptr = READ_ONCE(q->lock_ptr);
+	spin_lock(lock_ptr);
+
+	if (unlikely(lock_ptr != q->lock_ptr)) {
+		spin_unlock(lock_ptr);
+		goto retry;
+	}
+}
+
+static unsigned long futex_private_hash_size(struct mm_struct *mm)
+{
+	unsigned int users = min_t(unsigned int, atomic_read(&mm->mm_users) + 1,
+				   num_online_cpus());
+
+	return min(max(roundup_pow_of_two(4 * users), 16UL),
+		   futex_private_hashsize);
+}
+
+/*
+ * Replace the private hash of @mm by the larger @ph and move all the
+ * waiters over. A concurrent lookup spins in futex_hash() until the new
+ * table is complete; an operation which already holds a bucket of the old
+ * table notices it with futex_hash_stale().
+ */
+static void futex_private_hash_grow(struct mm_struct *mm,
+				    struct futex_private_hash *ph)
+{
+	struct futex_private_hash *old;
+	unsigned long i;
+
+	spin_lock(&mm->futex_phash_lock);
+	old = mm->futex_phash;
+	if (old->mask >= ph->mask) {
+		/* Somebody else grew it already */
+		spin_unlock(&mm->futex_phash_lock);
+		kvfree(ph);
+		return;
+	}
+
+	ph->prev = old;
+	write_seqcount_begin(&mm->futex_phash_seq);
+	WRITE_ONCE(mm->futex_phash, ph);
+	/*
+	 * Order the odd sequence count and the new table before the waiter
+	 * counts of the old buckets drop, so that futex_wake() finding an
+	 * emptied bucket also finds it stale.
+	 */
+	smp_wmb();
+
+	for (i = 0; i <= old->mask; i++) {
+		struct futex_hash_bucket *ohb = &old->queues[i];
+		struct futex_q *this, *next;
+
+		spin_lock(&ohb->lock);
+		plist_for_each_entry_safe(this, next, &ohb->chain, list) {
+			struct futex_hash_bucket *nhb;
+
+			nhb = &ph->queues[futex_hash_val(&this->key) & ph->mask];
+			spin_lock_nested(&nhb->lock, SINGLE_DEPTH_NESTING);
+			plist_del(&this->list, &ohb->chain);
+			futex_hb_waiters_dec(ohb);
+			futex_hb_waiters_inc(nhb);
+			plist_add(&this->list, &nhb->chain);
+			WRITE_ONCE(this->lock_ptr, &nhb->lock);
+			spin_unlock(&nhb->lock);
+		}
+		spin_unlock(&ohb->lock);
+	}
+
+	write_seqcount_end(&mm->futex_phash_seq);
+	spin_unlock(&mm->futex_phash_lock);
+}
+
+/**
+ * futex_private_hash_alloc - Give a process its own private futex hash
+ * @mm:		The mm about to be shared with a new thread
+ *
+ * Called from copy_mm() before a new thread starts to share @mm. The
+ * private hash is sized for the number of threads of the process, bounded
+ * by the number of online CPUs, and grown as further threads are added.
+ *
+ * The first table can only be set up while current is the only user of
+ * @mm: current is in fork and not queued on any futex, so no waiter of a
+ * private key of @mm can be left in the global hash. If that allocation
+ * fails, or @mm is already shared, the private futexes of @mm stay in the
+ * global hash for the lifetime of @mm. A failure to grow an existing table
+ * just keeps the smaller one.
+ */
+void futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_private_hash *ph, *old = READ_ONCE(mm->futex_phash);
+	unsigned long size, i;
+
+	if (!futex_private_hashsize)
+		return;
+	if (!old && atomic_read(&mm->mm_users) != 1)
+		return;
+
+	size = futex_private_hash_size(mm);
+	if (old && old->mask + 1 >= size)
+		return;
+
+	ph = kvmalloc(struct_size(ph, queues, size), GFP_KERNEL_ACCOUNT);
+	if (!ph)
+		return;
+
+	ph->prev = NULL;
+	ph->mask = size - 1;
+	for (i = 0; i < size; i++)
+		futex_hash_bucket_init(&ph->queues[i]);
+
+	if (!old) {
+		smp_store_release(&mm->futex_phash, ph);
+		return;
+	}
+
+	futex_private_hash_grow(mm, ph);
+}
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	mm->futex_phash = NULL;
+	spin_lock_init(&mm->futex_phash_lock);
+	seqcount_spinlock_init(&mm->futex_phash_seq, &mm->futex_phash_lock);
+}
+
+void futex_private_hash_free(struct mm_struct *mm)
+{
+	struct futex_private_hash *ph = mm->futex_phash, *prev;
 
-	return &futex_queues[hash & (futex_hashsize - 1)];
+	for (; ph; ph = prev) {
+		prev = ph->prev;
+		kvfree(ph);
+	}
 }
 
 
@@ -193,7 +457,8 @@ static u64 get_inode_sequence_number(struct inode *inode)
 /**
  * get_futex_key() - Get parameters which are the keys for a futex
  * @uaddr:	virtual address of the futex
- * @fshared:	false for a PROCESS_PRIVATE futex, true for PROCESS_SHARED
+ * @flags:	FLAGS_SHARED for a PROCESS_SHARED futex, the size of the futex
+ *		word, and FLAGS_NUMA if it is followed by a node hint
  * @key:	address where result is stored.
  * @rw:		mapping needs to be read/write (values: FUTEX_READ,
  *              FUTEX_WRITE)
@@ -217,10 +482,12 @@ static u64 get_inode_sequence_number(struct inode *inode)
  *
  * lock_page() might sleep, the caller should not hold a spinlock.
  */
-int get_futex_key(u32 __user *uaddr, bool fshared, union futex_key *key,
+int get_futex_key(void __user *uaddr, unsigned int flags, union futex_key *key,
 		  enum futex_access rw)
 {
 	unsigned long address = (unsigned long)uaddr;
+	unsigned int size = futex_size(flags);
+	bool fshared = flags & FLAGS_SHARED;
 	struct mm_struct *mm = current->mm;
 	struct page *page, *tail;
 	struct address_space *mapping;
@@ -229,17 +496,31 @@ int get_futex_key(u32 __user *uaddr, bool fshared, union futex_key *key,
 	/*
 	 * The futex address must be "naturally" aligned.
 	 */
-	key->both.offset = address % PAGE_SIZE;
-	if (unlikely((address % sizeof(u32)) != 0))
+	key->both.offset = (address % PAGE_SIZE) << FUT_OFF_SHIFT;
+	key->both.node = 0;
+	if (unlikely((address % size) != 0))
 		return -EINVAL;
-	address -= key->both.offset;
+	address -= address % PAGE_SIZE;
 
-	if (unlikely(!access_ok(uaddr, sizeof(u32))))
+	if (unlikely(!access_ok(uaddr, flags & FLAGS_NUMA ? 2 * size : size)))
 		return -EFAULT;
 
 	if (unlikely(should_fail_futex(fshared)))
 		return -EFAULT;
 
+	if (flags & FLAGS_NUMA) {
+		u64 node;
+
+		if (futex_get_value_sized(&node, uaddr + size, flags))
+			return -EFAULT;
+
+		if (node != futex_size_mask(flags)) {
+			if (node >= nr_node_ids || !node_possible(node))
+				return -EINVAL;
+			key->both.node = node + 1;
+		}
+	}
+
 	/*
 	 * PROCESS_PRIVATE futexes are fast.
 	 * As the mm cannot disappear under us and the 'key' only needs
@@ -459,6 +740,62 @@ int futex_get_value_locked(u32 *dest, u32 __user *from)
 	return ret ? -EFAULT : 0;
 }
 
+/*
+ * Read a futex word of the size given by @flags. get_futex_key() checked
+ * the access to it.
+ */
+int futex_get_value_sized(u64 *dest, void __user *from, unsigned int flags)
+{
+	int ret;
+
+	switch (futex_size(flags)) {
+	case sizeof(u8): {
+		u8 val;
+
+		ret = __get_user(val, (u8 __user *)from);
+		*dest = val;
+		break;
+	}
+	case sizeof(u16): {
+		u16 val;
+
+		ret = __get_user(val, (u16 __user *)from);
+		*dest = val;
+		break;
+	}
+#ifdef CONFIG_64BIT
+	case sizeof(u64): {
+		u64 val;
+
+		ret = __get_user(val, (u64 __user *)from);
+		*dest = val;
+		break;
+	}
+#endif
+	default: {
+		u32 val;
+
+		ret = __get_user(val, (u32 __user *)from);
+		*dest = val;
+		break;
+	}
+	}
+
+	return ret ? -EFAULT : 0;
+}
+
+int futex_get_value_sized_locked(u64 *dest, void __user *from,
+				 unsigned int flags)
+{
+	int ret;
+
+	pagefault_disable();
+	ret = futex_get_value_sized(dest, from, flags);
+	pagefault_enable();
+
+	return ret;
+}
+
 /**
  * wait_for_owner_exiting - Block until the owner has exited
  * @ret: owner's current futex lock status
@@ -515,6 +852,7 @@ struct futex_hash_bucket *futex_q_lock(struct futex_q *q)
 {
 	struct futex_hash_bucket *hb;
 
+retry:
 	hb = futex_hash(&q->key);
 
 	/*
@@ -530,6 +868,11 @@ struct futex_hash_bucket *futex_q_lock(struct futex_q *q)
 	q->lock_ptr = &hb->lock;
 
 	spin_lock(&hb->lock);
+	if (unlikely(futex_hash_stale(&q->key, hb))) {
+		spin_unlock(&hb->lock);
+		futex_hb_waiters_dec(hb);
+		goto retry;
+	}
 	return hb;
 }
 
@@ -978,6 +1321,13 @@ static void exit_pi_state_list(struct task_struct *curr)
 		raw_spin_unlock_irq(&curr->pi_lock);
 
 		spin_lock(&hb->lock);
+		if (unlikely(futex_hash_stale(&key, hb))) {
+			/* The private hash grew, look the key up again */
+			spin_unlock(&hb->lock);
+			put_pi_state(pi_state);
+			raw_spin_lock_irq(&curr->pi_lock);
+			continue;
+		}
 		raw_spin_lock_irq(&pi_state->pi_mutex.wait_lock);
 		raw_spin_lock(&curr->pi_lock);
 		/*
@@ -1122,28 +1472,42 @@ void futex_exit_release(struct task_struct *tsk)
 
 static int __init futex_init(void)
 {
-	unsigned int futex_shift;
-	unsigned long i;
+	unsigned long hashsize, i;
+	unsigned int node;
 
 #if CONFIG_BASE_SMALL
-	futex_hashsize = 16;
+	hashsize = 16;
+	futex_private_hashsize = 0;
 #else
-	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+	hashsize = roundup_pow_of_two(DIV_ROUND_UP(256 * num_possible_cpus(),
+						   nr_node_ids));
+	futex_private_hashsize = max(roundup_pow_of_two(4 * num_possible_cpus()),
+				     16UL);
 #endif
+	if (futex_private_hashsize_param >= 0)
+		futex_private_hashsize = futex_private_hashsize_param;
+
+	futex_hashmask = hashsize - 1;
+	futex_hashshift = ilog2(hashsize);
 
-	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
-					       futex_hashsize, 0,
-					       futex_hashsize < 256 ? HASH_SMALL : 0,
-					       &futex_shift, NULL,
-					       futex_hashsize, futex_hashsize);
-	futex_hashsize = 1UL << futex_shift;
-
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
+	for (node = 0; node < nr_node_ids; node++) {
+		struct futex_hash_bucket *queues;
+
+		queues = kvmalloc_node(hashsize * sizeof(*queues), GFP_KERNEL,
+				       node_possible(node) ? node : NUMA_NO_NODE);
+		if (!queues)
+			panic("Failed to allocate the futex hash for node %u\n",
+			      node);
+
+		for (i = 0; i < hashsize; i++)
+			futex_hash_bucket_init(&queues[i]);
+
+		futex_queues[node] = queues;
 	}
 
+	pr_info("futex hash table entries: %lu per node, %lu private\n",
+		hashsize, futex_private_hashsize);
+
 	return 0;
 }
 core_initcall(futex_init);
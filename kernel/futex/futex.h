@@ -27,6 +27,74 @@
 #endif
 #define FLAGS_CLOCKRT		0x02
 #define FLAGS_HAS_TIMEOUT	0x04
+/* The size of the futex word, 32 bits unless one of these is set */
+#define FLAGS_SIZE_8		0x08
+#define FLAGS_SIZE_16		0x10
+#define FLAGS_SIZE_64		0x18
+#define FLAGS_SIZE_MASK		0x18
+#define FLAGS_NUMA		0x20
+
+#define FUTEX2_VALID_MASK	(FUTEX2_SIZE_MASK | FUTEX2_NUMA | FUTEX2_PRIVATE)
+
+/* Translate the FUTEX2_* flags of a futex2 syscall into FLAGS_* */
+static inline unsigned int futex2_to_flags(unsigned int flags2)
+{
+	unsigned int flags = 0;
+
+	switch (flags2 & FUTEX2_SIZE_MASK) {
+	case FUTEX2_SIZE_U8:
+		flags |= FLAGS_SIZE_8;
+		break;
+	case FUTEX2_SIZE_U16:
+		flags |= FLAGS_SIZE_16;
+		break;
+	case FUTEX2_SIZE_U64:
+		flags |= FLAGS_SIZE_64;
+		break;
+	}
+
+	if (flags2 & FUTEX2_NUMA)
+		flags |= FLAGS_NUMA;
+
+	if (!(flags2 & FUTEX2_PRIVATE))
+		flags |= FLAGS_SHARED;
+
+	return flags;
+}
+
+static inline bool futex2_flags_valid(unsigned int flags2)
+{
+	if (flags2 & ~FUTEX2_VALID_MASK)
+		return false;
+
+	if (!IS_ENABLED(CONFIG_64BIT) &&
+	    (flags2 & FUTEX2_SIZE_MASK) == FUTEX2_SIZE_U64)
+		return false;
+
+	return true;
+}
+
+static inline unsigned int futex_size(unsigned int flags)
+{
+	switch (flags & FLAGS_SIZE_MASK) {
+	case FLAGS_SIZE_8:
+		return sizeof(u8);
+	case FLAGS_SIZE_16:
+		return sizeof(u16);
+	case FLAGS_SIZE_64:
+		return sizeof(u64);
+	default:
+		return sizeof(u32);
+	}
+}
+
+/* The values a futex word of this size can hold */
+static inline u64 futex_size_mask(unsigned int flags)
+{
+	unsigned int bits = futex_size(flags) * BITS_PER_BYTE;
+
+	return bits == 64 ? U64_MAX : BIT_ULL(bits) - 1;
+}
 
 #ifdef CONFIG_FAIL_FUTEX
 extern bool should_fail_futex(bool fshared);
@@ -116,14 +184,15 @@ enum futex_access {
 	FUTEX_WRITE
 };
 
-extern int get_futex_key(u32 __user *uaddr, bool fshared, union futex_key *key,
-			 enum futex_access rw);
+extern int get_futex_key(void __user *uaddr, unsigned int flags,
+			 union futex_key *key, enum futex_access rw);
 
 extern struct hrtimer_sleeper *
 futex_setup_timer(ktime_t *time, struct hrtimer_sleeper *timeout,
 		  int flags, u64 range_ns);
 
 extern struct futex_hash_bucket *futex_hash(union futex_key *key);
+extern bool futex_hash_stale(union futex_key *key, struct futex_hash_bucket *hb);
 
 /**
  * futex_match - Check whether two futex keys are equal
@@ -140,7 +209,7 @@ static inline int futex_match(union futex_key *key1, union futex_key *key2)
 		&& key1->both.offset == key2->both.offset);
 }
 
-extern int futex_wait_setup(u32 __user *uaddr, u32 val, unsigned int flags,
+extern int futex_wait_setup(void __user *uaddr, u64 val, unsigned int flags,
 			    struct futex_q *q, struct futex_hash_bucket **hb);
 extern void futex_wait_queue(struct futex_hash_bucket *hb, struct futex_q *q,
 				   struct hrtimer_sleeper *timeout);
@@ -149,6 +218,10 @@ extern void futex_wake_mark(struct wake_q_head *wake_q, struct futex_q *q);
 extern int fault_in_user_writeable(u32 __user *uaddr);
 extern int futex_cmpxchg_value_locked(u32 *curval, u32 __user *uaddr, u32 uval, u32 newval);
 extern int futex_get_value_locked(u32 *dest, u32 __user *from);
+extern int futex_get_value_sized(u64 *dest, void __user *from,
+				 unsigned int flags);
+extern int futex_get_value_sized_locked(u64 *dest, void __user *from,
+					unsigned int flags);
 extern struct futex_q *futex_top_waiter(struct futex_hash_bucket *hb, union futex_key *key);
 
 extern void __futex_unqueue(struct futex_q *q);
@@ -218,6 +291,7 @@ static inline int futex_hb_waiters_pending(struct futex_hash_bucket *hb)
 
 extern struct futex_hash_bucket *futex_q_lock(struct futex_q *q);
 extern void futex_q_unlock(struct futex_hash_bucket *hb);
+extern void futex_q_lockptr_lock(struct futex_q *q);
 
 
 extern int futex_lock_pi_atomic(u32 __user *uaddr, struct futex_hash_bucket *hb,
@@ -260,16 +334,17 @@ extern int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags, u32
 				 val, ktime_t *abs_time, u32 bitset, u32 __user
 				 *uaddr2);
 
-extern int futex_requeue(u32 __user *uaddr1, unsigned int flags,
-			 u32 __user *uaddr2, int nr_wake, int nr_requeue,
-			 u32 *cmpval, int requeue_pi);
+extern int futex_requeue(u32 __user *uaddr1, unsigned int flags1,
+			 u32 __user *uaddr2, unsigned int flags2,
+			 int nr_wake, int nr_requeue,
+			 u64 *cmpval, int requeue_pi);
 
-extern int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
+extern int futex_wait(void __user *uaddr, unsigned int flags, u64 val,
 		      ktime_t *abs_time, u32 bitset);
 
 /**
  * struct futex_vector - Auxiliary struct for futex_waitv()
- * @w: Userspace provided data
+ * @w: Userspace provided data, with the flags translated into FLAGS_*
  * @q: Kernel side data
  *
  * Struct used to build an array with all data need for futex_waitv()
@@ -282,7 +357,7 @@ struct futex_vector {
 extern int futex_wait_multiple(struct futex_vector *vs, unsigned int count,
 			       struct hrtimer_sleeper *to);
 
-extern int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset);
+extern int futex_wake(void __user *uaddr, unsigned int flags, int nr_wake, u32 bitset);
 
 extern int futex_wake_op(u32 __user *uaddr1, unsigned int flags,
 			 u32 __user *uaddr2, int nr_wake, int nr_wake2, int op);
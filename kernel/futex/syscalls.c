@@ -87,6 +87,7 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 {
 	int cmd = op & FUTEX_CMD_MASK;
 	unsigned int flags = 0;
+	u64 cmpval = val3;
 
 	if (!(op & FUTEX_PRIVATE_FLAG))
 		flags |= FLAGS_SHARED;
@@ -110,9 +111,11 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	case FUTEX_WAKE_BITSET:
 		return futex_wake(uaddr, flags, val, val3);
 	case FUTEX_REQUEUE:
-		return futex_requeue(uaddr, flags, uaddr2, val, val2, NULL, 0);
+		return futex_requeue(uaddr, flags, uaddr2, flags, val, val2,
+				     NULL, 0);
 	case FUTEX_CMP_REQUEUE:
-		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 0);
+		return futex_requeue(uaddr, flags, uaddr2, flags, val, val2,
+				     &cmpval, 0);
 	case FUTEX_WAKE_OP:
 		return futex_wake_op(uaddr, flags, uaddr2, val, val2, val3);
 	case FUTEX_LOCK_PI:
@@ -129,7 +132,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		return futex_wait_requeue_pi(uaddr, flags, val, timeout, val3,
 					     uaddr2);
 	case FUTEX_CMP_REQUEUE_PI:
-		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
+		return futex_requeue(uaddr, flags, uaddr2, flags, val, val2,
+				     &cmpval, 1);
 	}
 	return -ENOSYS;
 }
@@ -183,8 +187,39 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, (unsigned long)utime, val3);
 }
 
-/* Mask of available flags for each futex in futex_waitv list */
-#define FUTEXV_WAITER_MASK (FUTEX_32 | FUTEX_PRIVATE_FLAG)
+/**
+ * futex2_get_timeout - Read the absolute timeout of a futex2 syscall
+ * @timeout:	Userspace timeout
+ * @clockid:	Clock of @timeout, realtime or monotonic
+ * @time:	Converted timeout (return parameter)
+ * @flags:	FLAGS_CLOCKRT is added for a realtime timeout
+ *
+ * Return: Error code on failure, 0 on success
+ */
+static int futex2_get_timeout(struct __kernel_timespec __user *timeout,
+			      clockid_t clockid, ktime_t *time,
+			      unsigned int *flags)
+{
+	struct timespec64 ts;
+	int flag_init = 0;
+
+	if (clockid == CLOCK_REALTIME) {
+		*flags |= FLAGS_CLOCKRT;
+		flag_init = FUTEX_CLOCK_REALTIME;
+	}
+
+	if (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC)
+		return -EINVAL;
+
+	if (get_timespec64(&ts, timeout))
+		return -EFAULT;
+
+	/*
+	 * Since there's no opcode for the futex2 syscalls, use
+	 * FUTEX_WAIT_BITSET that uses absolute timeout as well
+	 */
+	return futex_init_timeout(FUTEX_WAIT_BITSET, flag_init, &ts, time);
+}
 
 /**
  * futex_parse_waitv - Parse a waitv array from userspace
@@ -205,13 +240,10 @@ static int futex_parse_waitv(struct futex_vector *futexv,
 		if (copy_from_user(&aux, &uwaitv[i], sizeof(aux)))
 			return -EFAULT;
 
-		if ((aux.flags & ~FUTEXV_WAITER_MASK) || aux.__reserved)
-			return -EINVAL;
-
-		if (!(aux.flags & FUTEX_32))
+		if (!futex2_flags_valid(aux.flags) || aux.__reserved)
 			return -EINVAL;
 
-		futexv[i].w.flags = aux.flags;
+		futexv[i].w.flags = futex2_to_flags(aux.flags);
 		futexv[i].w.val = aux.val;
 		futexv[i].w.uaddr = aux.uaddr;
 		futexv[i].q = futex_q_init;
@@ -249,7 +281,6 @@ SYSCALL_DEFINE5(futex_waitv, struct futex_waitv __user *, waiters,
 {
 	struct hrtimer_sleeper to;
 	struct futex_vector *futexv;
-	struct timespec64 ts;
 	ktime_t time;
 	int ret;
 
@@ -261,24 +292,9 @@ SYSCALL_DEFINE5(futex_waitv, struct futex_waitv __user *, waiters,
 		return -EINVAL;
 
 	if (timeout) {
-		int flag_clkid = 0, flag_init = 0;
+		unsigned int flag_clkid = 0;
 
-		if (clockid == CLOCK_REALTIME) {
-			flag_clkid = FLAGS_CLOCKRT;
-			flag_init = FUTEX_CLOCK_REALTIME;
-		}
-
-		if (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC)
-			return -EINVAL;
-
-		if (get_timespec64(&ts, timeout))
-			return -EFAULT;
-
-		/*
-		 * Since there's no opcode for futex_waitv, use
-		 * FUTEX_WAIT_BITSET that uses absolute timeout as well
-		 */
-		ret = futex_init_timeout(FUTEX_WAIT_BITSET, flag_init, &ts, &time);
+		ret = futex2_get_timeout(timeout, clockid, &time, &flag_clkid);
 		if (ret)
 			return ret;
 
@@ -305,6 +321,114 @@ SYSCALL_DEFINE5(futex_waitv, struct futex_waitv __user *, waiters,
 	return ret;
 }
 
+/**
+ * sys_futex_wake - Wake a number of futex waiters
+ * @uaddr:	Address of the futex word
+ * @mask:	Bitmask, matched against the mask of the waiters
+ * @nr:	Number of waiters to wake
+ * @flags:	FUTEX2_SIZE_*, FUTEX2_NUMA and FUTEX2_PRIVATE
+ *
+ * Identical to the FUTEX_WAKE_BITSET operation, for futex words of any
+ * size. The size only matters for the alignment of @uaddr, the futex word
+ * is not read.
+ *
+ * Returns the number of woken waiters.
+ */
+SYSCALL_DEFINE4(futex_wake, void __user *, uaddr, unsigned long, mask,
+		int, nr, unsigned int, flags)
+{
+	if (!futex2_flags_valid(flags) || upper_32_bits(mask))
+		return -EINVAL;
+
+	return futex_wake(uaddr, futex2_to_flags(flags), nr, mask);
+}
+
+/**
+ * sys_futex_wait - Wait on a futex
+ * @uaddr:	Address of the futex word
+ * @val:	Value expected at @uaddr
+ * @mask:	Bitmask, matched against the mask of the wakers
+ * @flags:	FUTEX2_SIZE_*, FUTEX2_NUMA and FUTEX2_PRIVATE
+ * @timeout:	Optional absolute timeout
+ * @clockid:	Clock of @timeout, realtime or monotonic
+ *
+ * Identical to the FUTEX_WAIT_BITSET operation, for futex words of any
+ * size: returns -EAGAIN right away if the futex word does not hold @val,
+ * compared on the size of the futex word.
+ */
+SYSCALL_DEFINE6(futex_wait, void __user *, uaddr, unsigned long, val,
+		unsigned long, mask, unsigned int, flags,
+		struct __kernel_timespec __user *, timeout, clockid_t, clockid)
+{
+	unsigned int fl;
+	ktime_t time;
+	int ret;
+
+	if (!futex2_flags_valid(flags) || upper_32_bits(mask))
+		return -EINVAL;
+
+	fl = futex2_to_flags(flags);
+	if ((u64)val & ~futex_size_mask(fl))
+		return -EINVAL;
+
+	if (timeout) {
+		ret = futex2_get_timeout(timeout, clockid, &time, &fl);
+		if (ret)
+			return ret;
+	}
+
+	return futex_wait(uaddr, fl, val, timeout ? &time : NULL, mask);
+}
+
+/**
+ * sys_futex_requeue - Wake waiters of a futex and requeue the others
+ * @waiters:	The source futex in waiters[0], the target in waiters[1]
+ * @flags:	Unused, must be 0
+ * @nr_wake:	Number of waiters to wake
+ * @nr_requeue:	Number of waiters to requeue
+ *
+ * Identical to the FUTEX_CMP_REQUEUE operation: if the source futex word
+ * holds waiters[0].val, wake @nr_wake of its waiters and move up to
+ * @nr_requeue of the others to the target futex, without waking them.
+ * A condition variable broadcast wakes one waiter and requeues the rest
+ * on the mutex, instead of waking them all to contend on it. The two
+ * futexes may have different sizes and flags.
+ *
+ * Returns the number of woken and requeued waiters.
+ */
+SYSCALL_DEFINE4(futex_requeue, struct futex_waitv __user *, waiters,
+		unsigned int, flags, int, nr_wake, int, nr_requeue)
+{
+	struct futex_waitv w[2];
+	unsigned int flags1, flags2;
+	u64 cmpval;
+
+	if (flags)
+		return -EINVAL;
+
+	if (!waiters)
+		return -EINVAL;
+
+	if (copy_from_user(w, waiters, sizeof(w)))
+		return -EFAULT;
+
+	if (!futex2_flags_valid(w[0].flags) || w[0].__reserved ||
+	    !futex2_flags_valid(w[1].flags) || w[1].__reserved)
+		return -EINVAL;
+
+	flags1 = futex2_to_flags(w[0].flags);
+	flags2 = futex2_to_flags(w[1].flags);
+
+	if (w[0].val & ~futex_size_mask(flags1))
+		return -EINVAL;
+
+	cmpval = w[0].val;
+
+	return futex_requeue(u64_to_user_ptr(w[0].uaddr), flags1,
+			     u64_to_user_ptr(w[1].uaddr), flags2,
+			     nr_wake, nr_requeue, &cmpval, 0);
+}
+
 #ifdef CONFIG_COMPAT
 COMPAT_SYSCALL_DEFINE2(set_robust_list,
 		struct compat_robust_list_head __user *, head,
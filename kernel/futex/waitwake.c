@@ -140,7 +140,7 @@ void futex_wake_mark(struct wake_q_head *wake_q, struct futex_q *q)
 /*
  * Wake up waiters matching bitset queued on this futex (uaddr).
  */
-int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
+int futex_wake(void __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 {
 	struct futex_hash_bucket *hb;
 	struct futex_q *this, *next;
@@ -151,17 +151,31 @@ int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	if (!bitset)
 		return -EINVAL;
 
-	ret = get_futex_key(uaddr, flags & FLAGS_SHARED, &key, FUTEX_READ);
+	ret = get_futex_key(uaddr, flags, &key, FUTEX_READ);
 	if (unlikely(ret != 0))
 		return ret;
 
+retry:
 	hb = futex_hash(&key);
 
 	/* Make sure we really have tasks to wakeup */
-	if (!futex_hb_waiters_pending(hb))
+	if (!futex_hb_waiters_pending(hb)) {
+		/*
+		 * The waiters may have just been moved to a grown private
+		 * hash, in which case look again in the new table. Pairs
+		 * with the write barrier in futex_private_hash_grow().
+		 */
+		smp_rmb();
+		if (unlikely(futex_hash_stale(&key, hb)))
+			goto retry;
 		return ret;
+	}
 
 	spin_lock(&hb->lock);
+	if (unlikely(futex_hash_stale(&key, hb))) {
+		spin_unlock(&hb->lock);
+		goto retry;
+	}
 
 	plist_for_each_entry_safe(this, next, &hb->chain, list) {
 		if (futex_match (&this->key, &key)) {
@@ -245,18 +259,23 @@ int futex_wake_op(u32 __user *uaddr1, unsigned int flags, u32 __user *uaddr2,
 	DEFINE_WAKE_Q(wake_q);
 
 retry:
-	ret = get_futex_key(uaddr1, flags & FLAGS_SHARED, &key1, FUTEX_READ);
+	ret = get_futex_key(uaddr1, flags, &key1, FUTEX_READ);
 	if (unlikely(ret != 0))
 		return ret;
-	ret = get_futex_key(uaddr2, flags & FLAGS_SHARED, &key2, FUTEX_WRITE);
+	ret = get_futex_key(uaddr2, flags, &key2, FUTEX_WRITE);
 	if (unlikely(ret != 0))
 		return ret;
 
+retry_private:
 	hb1 = futex_hash(&key1);
 	hb2 = futex_hash(&key2);
 
-retry_private:
 	double_lock_hb(hb1, hb2);
+	if (unlikely(futex_hash_stale(&key1, hb1) ||
+		     futex_hash_stale(&key2, hb2))) {
+		double_unlock_hb(hb1, hb2);
+		goto retry_private;
+	}
 	op_ret = futex_atomic_op_inuser(op, uaddr2);
 	if (unlikely(op_ret < 0)) {
 		double_unlock_hb(hb1, hb2);
@@ -401,7 +420,7 @@ static int futex_wait_multiple_setup(struct futex_vector *vs, int count, int *wo
 	struct futex_hash_bucket *hb;
 	bool retry = false;
 	int ret, i;
-	u32 uval;
+	u64 uval;
 
 	/*
 	 * Enqueuing multiple futexes is tricky, because we need to enqueue
@@ -419,12 +438,11 @@ static int futex_wait_multiple_setup(struct futex_vector *vs, int count, int *wo
 	 */
 retry:
 	for (i = 0; i < count; i++) {
-		if ((vs[i].w.flags & FUTEX_PRIVATE_FLAG) && retry)
+		if (!(vs[i].w.flags & FLAGS_SHARED) && retry)
 			continue;
 
 		ret = get_futex_key(u64_to_user_ptr(vs[i].w.uaddr),
-				    !(vs[i].w.flags & FUTEX_PRIVATE_FLAG),
-				    &vs[i].q.key, FUTEX_READ);
+				    vs[i].w.flags, &vs[i].q.key, FUTEX_READ);
 
 		if (unlikely(ret))
 			return ret;
@@ -433,12 +451,13 @@ static int futex_wait_multiple_setup(struct futex_vector *vs, int count, int *wo
 	set_current_state(TASK_INTERRUPTIBLE|TASK_FREEZABLE);
 
 	for (i = 0; i < count; i++) {
-		u32 __user *uaddr = (u32 __user *)(unsigned long)vs[i].w.uaddr;
+		void __user *uaddr = u64_to_user_ptr(vs[i].w.uaddr);
+		unsigned int flags = vs[i].w.flags;
 		struct futex_q *q = &vs[i].q;
-		u32 val = (u32)vs[i].w.val;
+		u64 val = vs[i].w.val & futex_size_mask(flags);
 
 		hb = futex_q_lock(q);
-		ret = futex_get_value_locked(&uval, uaddr);
+		ret = futex_get_value_sized_locked(&uval, uaddr, flags);
 
 		if (!ret && uval == val) {
 			/*
@@ -470,7 +489,7 @@ static int futex_wait_multiple_setup(struct futex_vector *vs, int count, int *wo
 			 * undoing all the work done so far. In success, we
 			 * retry all the work.
 			 */
-			if (get_user(uval, uaddr))
+			if (futex_get_value_sized(&uval, uaddr, flags))
 				return -EFAULT;
 
 			retry = true;
@@ -574,10 +593,10 @@ int futex_wait_multiple(struct futex_vector *vs, unsigned int count,
  *  -  0 - uaddr contains val and hb has been locked;
  *  - <1 - -EFAULT or -EWOULDBLOCK (uaddr does not contain val) and hb is unlocked
  */
-int futex_wait_setup(u32 __user *uaddr, u32 val, unsigned int flags,
+int futex_wait_setup(void __user *uaddr, u64 val, unsigned int flags,
 		     struct futex_q *q, struct futex_hash_bucket **hb)
 {
-	u32 uval;
+	u64 uval;
 	int ret;
 
 	/*
@@ -599,19 +618,19 @@ int futex_wait_setup(u32 __user *uaddr, u32 val, unsigned int flags,
 	 * while the syscall executes.
 	 */
 retry:
-	ret = get_futex_key(uaddr, flags & FLAGS_SHARED, &q->key, FUTEX_READ);
+	ret = get_futex_key(uaddr, flags, &q->key, FUTEX_READ);
 	if (unlikely(ret != 0))
 		return ret;
 
 retry_private:
 	*hb = futex_q_lock(q);
 
-	ret = futex_get_value_locked(&uval, uaddr);
+	ret = futex_get_value_sized_locked(&uval, uaddr, flags);
 
 	if (ret) {
 		futex_q_unlock(*hb);
 
-		ret = get_user(uval, uaddr);
+		ret = futex_get_value_sized(&uval, uaddr, flags);
 		if (ret)
 			return ret;
 
@@ -629,7 +648,7 @@ int futex_wait_setup(u32 __user *uaddr, u32 val, unsigned int flags,
 	return ret;
 }
 
-int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val, ktime_t *abs_time, u32 bitset)
+int futex_wait(void __user *uaddr, unsigned int flags, u64 val, ktime_t *abs_time, u32 bitset)
 {
 	struct hrtimer_sleeper timeout, *to;
 	struct restart_block *restart;
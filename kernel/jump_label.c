@@ -245,6 +245,118 @@ void static_key_disable(struct static_key *key)
 }
 EXPORT_SYMBOL_GPL(static_key_disable);
 
+/*
+ * Batched enable/disable of many keys.
+ *
+ * Between static_key_batch_begin() and static_key_batch_end() the
+ * jump_label_mutex and the CPU hotplug lock are held, and
+ * static_key_batch_enable()/static_key_batch_disable() only queue the
+ * text changes.  On architectures with HAVE_JUMP_LABEL_BATCH all of
+ * them are then applied with one synchronisation round (or one per
+ * full arch queue) instead of one per key.
+ *
+ * Keys being enabled stay at -1 until their text is patched, so that
+ * concurrent static_key_slow_inc() callers wait on the mutex rather than
+ * returning before the branch is live.  A key may be toggled more than
+ * once in a batch; the queue is then applied first, as the arch code
+ * checks the current text of a site before queueing a change to it.
+ * The batch owner must not call any of the regular static_key_*()
+ * helpers while the batch is open.
+ */
+#define JUMP_LABEL_BATCH_MAX	64
+
+static struct static_key *jump_label_batch_keys[JUMP_LABEL_BATCH_MAX];
+static unsigned int jump_label_batch_nr;
+static bool jump_label_batching;
+
+static void jump_label_batch_flush(void)
+{
+	unsigned int i;
+
+#ifdef HAVE_JUMP_LABEL_BATCH
+	arch_jump_label_transform_apply();
+#endif
+	/* See static_key_slow_inc(). */
+	for (i = 0; i < jump_label_batch_nr; i++) {
+		if (atomic_read(&jump_label_batch_keys[i]->enabled) == -1)
+			atomic_set_release(&jump_label_batch_keys[i]->enabled, 1);
+	}
+	jump_label_batch_nr = 0;
+}
+
+static void jump_label_batch_add(struct static_key *key)
+{
+	unsigned int i;
+
+	for (i = 0; i < jump_label_batch_nr; i++) {
+		if (jump_label_batch_keys[i] == key) {
+			jump_label_batch_flush();
+			break;
+		}
+	}
+
+	if (jump_label_batch_nr == JUMP_LABEL_BATCH_MAX)
+		jump_label_batch_flush();
+
+	jump_label_batch_keys[jump_label_batch_nr++] = key;
+}
+
+void static_key_batch_begin(void)
+{
+	cpus_read_lock();
+	jump_label_lock();
+	jump_label_batching = true;
+}
+EXPORT_SYMBOL_GPL(static_key_batch_begin);
+
+void static_key_batch_enable(struct static_key *key)
+{
+	STATIC_KEY_CHECK_USE(key);
+	lockdep_assert_held(&jump_label_mutex);
+
+	if (atomic_read(&key->enabled) != 0) {
+		WARN_ON_ONCE(atomic_read(&key->enabled) != 1 &&
+			     atomic_read(&key->enabled) != -1);
+		return;
+	}
+
+	jump_label_batch_add(key);
+	atomic_set(&key->enabled, -1);
+	jump_label_update(key);
+}
+EXPORT_SYMBOL_GPL(static_key_batch_enable);
+
+void static_key_batch_disable(struct static_key *key)
+{
+	STATIC_KEY_CHECK_USE(key);
+	lockdep_assert_held(&jump_label_mutex);
+
+	/* Enabled earlier in this batch, publish it before turning it off */
+	if (atomic_read(&key->enabled) == -1)
+		jump_label_batch_flush();
+
+	if (atomic_read(&key->enabled) != 1) {
+		WARN_ON_ONCE(atomic_read(&key->enabled) != 0);
+		return;
+	}
+
+	jump_label_batch_add(key);
+	if (atomic_cmpxchg(&key->enabled, 1, 0))
+		jump_label_update(key);
+}
+EXPORT_SYMBOL_GPL(static_key_batch_disable);
+
+void static_key_batch_end(void)
+{
+	lockdep_assert_held(&jump_label_mutex);
+
+	jump_label_batching = false;
+	jump_label_batch_flush();
+	jump_label_unlock();
+	cpus_read_unlock();
+}
+EXPORT_SYMBOL_GPL(static_key_batch_end);
+
 static bool static_key_slow_try_dec(struct static_key *key)
 {
 	int val;
@@ -480,7 +592,9 @@ static void __jump_label_update(struct static_key *key,
 			BUG_ON(!arch_jump_label_transform_queue(entry, jump_label_type(entry)));
 		}
 	}
-	arch_jump_label_transform_apply();
+	/* An open batch applies everything in static_key_batch_end(). */
+	if (!jump_label_batching)
+		arch_jump_label_transform_apply();
 }
 #endif
 
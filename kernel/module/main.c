@@ -54,6 +54,8 @@
 #include <linux/dynamic_debug.h>
 #include <linux/audit.h>
 #include <linux/cfi.h>
+#include <linux/hash.h>
+#include <linux/file.h>
 #include <uapi/linux/module.h>
 #include "internal.h"
 
@@ -2920,26 +2922,113 @@ SYSCALL_DEFINE3(init_module, void __user *, umod,
 	return load_module(&info, uargs, 0);
 }
 
-SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
+/*
+ * Concurrent finit_module() calls on the same file with the same flags and
+ * arguments (udev asking for the same module from many CPUs at once) are
+ * collapsed onto the first one, instead of each reading, decompressing and
+ * vmalloc'ing a private copy of the image. The others wait for it and fail
+ * with its error, or with -EEXIST if it loaded the module, just as they
+ * would have in add_unformed_module().
+ */
+#define IDEM_HASH_BITS 8
+static struct hlist_head idem_hash[1 << IDEM_HASH_BITS];
+static DEFINE_SPINLOCK(idem_lock);
+
+struct idempotent {
+	const void *cookie;
+	const char *args;
+	int flags;
+	struct hlist_node entry;
+	struct completion complete;
+	int ret;
+};
+
+static bool idempotent_match(struct idempotent *a, struct idempotent *b)
+{
+	return a->cookie == b->cookie && a->flags == b->flags &&
+	       !strcmp(a->args, b->args);
+}
+
+/* Returns true if somebody else is already doing the same load. */
+static bool idempotent(struct idempotent *u, const void *cookie,
+		       const char *args, int flags)
+{
+	int hash = hash_ptr(cookie, IDEM_HASH_BITS);
+	struct hlist_head *head = idem_hash + hash;
+	struct idempotent *existing;
+	bool first = true;
+
+	u->ret = 0;
+	u->cookie = cookie;
+	u->args = args;
+	u->flags = flags;
+	init_completion(&u->complete);
+
+	spin_lock(&idem_lock);
+	hlist_for_each_entry(existing, head, entry) {
+		if (idempotent_match(existing, u)) {
+			first = false;
+			break;
+		}
+	}
+	hlist_add_head(&u->entry, head);
+	spin_unlock(&idem_lock);
+
+	return !first;
+}
+
+/*
+ * Hand @ret to every waiter on the same load, including ourselves, and
+ * drop them all from the hash.
+ */
+static int idempotent_complete(struct idempotent *u, int ret)
+{
+	int hash = hash_ptr(u->cookie, IDEM_HASH_BITS);
+	struct hlist_head *head = idem_hash + hash;
+	struct hlist_node *next;
+	struct idempotent *pos;
+
+	spin_lock(&idem_lock);
+	hlist_for_each_entry_safe(pos, next, head, entry) {
+		if (pos != u && !idempotent_match(pos, u))
+			continue;
+		hlist_del_init(&pos->entry);
+		pos->ret = ret;
+		complete(&pos->complete);
+	}
+	spin_unlock(&idem_lock);
+
+	return ret;
+}
+
+/*
+ * Wait for the first caller of the same load. A fatal signal takes our own
+ * entry off the hash, unless the first caller completed it meanwhile:
+ * idempotent_complete() only touches entries under idem_lock.
+ */
+static int idempotent_wait(struct idempotent *u)
+{
+	if (wait_for_completion_killable(&u->complete)) {
+		spin_lock(&idem_lock);
+		if (!hlist_unhashed(&u->entry)) {
+			hlist_del_init(&u->entry);
+			u->ret = -EINTR;
+		}
+		spin_unlock(&idem_lock);
+	}
+
+	return u->ret ? u->ret : -EEXIST;
+}
+
+static int init_module_from_file(struct file *f, const char __user *uargs,
+				 int flags)
 {
 	struct load_info info = { };
 	void *buf = NULL;
 	int len;
 	int err;
 
-	err = may_init_module();
-	if (err)
-		return err;
-
-	pr_debug("finit_module: fd=%d, uargs=%p, flags=%i\n", fd, uargs, flags);
-
-	if (flags & ~(MODULE_INIT_IGNORE_MODVERSIONS
-		      |MODULE_INIT_IGNORE_VERMAGIC
-		      |MODULE_INIT_COMPRESSED_FILE))
-		return -EINVAL;
-
-	len = kernel_read_file_from_fd(fd, 0, &buf, INT_MAX, NULL,
-				       READING_MODULE);
+	len = kernel_read_file(f, 0, &buf, INT_MAX, NULL, READING_MODULE);
 	if (len < 0)
 		return len;
 
@@ -2956,6 +3045,53 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 	return load_module(&info, uargs, flags);
 }
 
+static int idempotent_init_module(struct file *f, const char __user *uargs,
+				  int flags)
+{
+	struct idempotent idem;
+	char *args;
+	int ret;
+
+	if (!f || !(f->f_mode & FMODE_READ))
+		return -EBADF;
+
+	args = strndup_user(uargs, ~0UL >> 1);
+	if (IS_ERR(args))
+		return PTR_ERR(args);
+
+	/* Somebody else is loading this very file: share their result. */
+	if (idempotent(&idem, file_inode(f), args, flags))
+		ret = idempotent_wait(&idem);
+	else
+		ret = idempotent_complete(&idem,
+					  init_module_from_file(f, uargs, flags));
+
+	kfree(args);
+	return ret;
+}
+
+SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
+{
+	struct fd f;
+	int err;
+
+	err = may_init_module();
+	if (err)
+		return err;
+
+	pr_debug("finit_module: fd=%d, uargs=%p, flags=%i\n", fd, uargs, flags);
+
+	if (flags & ~(MODULE_INIT_IGNORE_MODVERSIONS
+		      |MODULE_INIT_IGNORE_VERMAGIC
+		      |MODULE_INIT_COMPRESSED_FILE))
+		return -EINVAL;
+
+	f = fdget(fd);
+	err = idempotent_init_module(f.file, uargs, flags);
+	fdput(f);
+	return err;
+}
+
 static inline int within(unsigned long addr, void *start, unsigned long size)
 {
 	return ((void *)addr >= start && (void *)addr < start + size);
@@ -18,7 +18,9 @@
 #include <linux/cpu.h>
 #include <linux/padata.h>
 #include <linux/mutex.h>
+#include <linux/nodemask.h>
 #include <linux/sched.h>
+#include <linux/sched/signal.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/rcupdate.h>
@@ -39,13 +41,15 @@ struct padata_mt_job_state {
 	spinlock_t		lock;
 	struct completion	completion;
 	struct padata_mt_job	*job;
+	struct task_struct	*caller;
 	int			nworks;
 	int			nworks_fini;
+	bool			cancelled;
 	unsigned long		chunk_size;
 };
 
 static void padata_free_pd(struct parallel_data *pd);
-static void __init padata_mt_helper(struct work_struct *work);
+static void padata_mt_helper(struct work_struct *work);
 
 static int padata_index_to_cpu(struct parallel_data *pd, int cpu_index)
 {
@@ -83,16 +87,8 @@ static struct padata_work *padata_work_alloc(void)
 	return pw;
 }
 
-/*
- * This function is marked __ref because this function may be optimized in such
- * a way that it directly refers to work_fn's address, which causes modpost to
- * complain when work_fn is marked __init. This scenario was observed with clang
- * LTO, where padata_work_init() was optimized to refer directly to
- * padata_mt_helper() because the calls to padata_work_init() with other work_fn
- * values were eliminated or inlined.
- */
-static void __ref padata_work_init(struct padata_work *pw, work_func_t work_fn,
-				   void *data, int flags)
+static void padata_work_init(struct padata_work *pw, work_func_t work_fn,
+			     void *data, int flags)
 {
 	if (flags & PADATA_WORK_ONSTACK)
 		INIT_WORK_ONSTACK(&pw->pw_work, work_fn);
@@ -101,8 +97,8 @@ static void __ref padata_work_init(struct padata_work *pw, work_func_t work_fn,
 	pw->pw_data = data;
 }
 
-static int __init padata_work_alloc_mt(int nworks, void *data,
-				       struct list_head *head)
+static int padata_work_alloc_mt(int nworks, void *data,
+				struct list_head *head)
 {
 	int i;
 
@@ -127,7 +123,7 @@ static void padata_work_free(struct padata_work *pw)
 	list_add(&pw->pw_list, &padata_free_works);
 }
 
-static void __init padata_works_free(struct list_head *works)
+static void padata_works_free(struct list_head *works)
 {
 	struct padata_work *cur, *next;
 
@@ -438,7 +434,7 @@ static int padata_setup_cpumasks(struct padata_instance *pinst)
 	return err;
 }
 
-static void __init padata_mt_helper(struct work_struct *w)
+static void padata_mt_helper(struct work_struct *w)
 {
 	struct padata_work *pw = container_of(w, struct padata_work, pw_work);
 	struct padata_mt_job_state *ps = pw->pw_data;
@@ -447,7 +443,7 @@ static void __init padata_mt_helper(struct work_struct *w)
 
 	spin_lock(&ps->lock);
 
-	while (job->size > 0) {
+	while (job->size > 0 && !ps->cancelled) {
 		unsigned long start, size, end;
 
 		start = job->start;
@@ -462,6 +458,11 @@ static void __init padata_mt_helper(struct work_struct *w)
 		spin_unlock(&ps->lock);
 		job->thread_fn(start, end, job->fn_arg);
 		spin_lock(&ps->lock);
+
+		/* Only the caller can notice its own fatal signal. */
+		if (job->killable && current == ps->caller &&
+		    fatal_signal_pending(current))
+			ps->cancelled = true;
 	}
 
 	++ps->nworks_fini;
@@ -476,35 +477,45 @@ static void __init padata_mt_helper(struct work_struct *w)
  * padata_do_multithreaded - run a multithreaded job
  * @job: Description of the job.
  *
- * See the definition of struct padata_mt_job for more details.
+ * See the definition of struct padata_mt_job for more details.  May be
+ * called at boot or at runtime from any context that can sleep; concurrent
+ * jobs share the pool of helper work items and get fewer helpers when it
+ * runs dry.
+ *
+ * Return: 0 if the whole job was done, -EINTR if a killable job was
+ * cancelled by a fatal signal.
  */
-void __init padata_do_multithreaded(struct padata_mt_job *job)
+int padata_do_multithreaded(struct padata_mt_job *job)
 {
 	/* In case threads finish at different times. */
 	static const unsigned long load_balance_factor = 4;
 	struct padata_work my_work, *pw;
 	struct padata_mt_job_state ps;
 	LIST_HEAD(works);
-	int nworks;
+	int nworks, nid;
+
+	might_sleep();
 
 	if (job->size == 0)
-		return;
+		return 0;
 
 	/* Ensure at least one thread when size < min_chunk. */
 	nworks = max(job->size / job->min_chunk, 1ul);
 	nworks = min(nworks, job->max_threads);
 
-	if (nworks == 1) {
+	if (nworks == 1 && !job->killable) {
 		/* Single thread, no coordination needed, cut to the chase. */
 		job->thread_fn(job->start, job->start + job->size, job->fn_arg);
-		return;
+		return 0;
 	}
 
 	spin_lock_init(&ps.lock);
 	init_completion(&ps.completion);
 	ps.job	       = job;
+	ps.caller      = current;
 	ps.nworks      = padata_work_alloc_mt(nworks, &ps, &works);
 	ps.nworks_fini = 0;
+	ps.cancelled   = false;
 
 	/*
 	 * Chunk size is the amount of work a helper does per call to the
@@ -516,8 +527,15 @@ void __init padata_do_multithreaded(struct padata_mt_job *job)
 	ps.chunk_size = max(ps.chunk_size, job->min_chunk);
 	ps.chunk_size = roundup(ps.chunk_size, job->align);
 
-	list_for_each_entry(pw, &works, pw_list)
-		queue_work(system_unbound_wq, &pw->pw_work);
+	nid = numa_node_id();
+	list_for_each_entry(pw, &works, pw_list) {
+		if (job->numa_aware) {
+			nid = next_node_in(nid, node_states[N_CPU]);
+			queue_work_node(nid, system_unbound_wq, &pw->pw_work);
+		} else {
+			queue_work(system_unbound_wq, &pw->pw_work);
+		}
+	}
 
 	/* Use the current thread, which saves starting a workqueue worker. */
 	padata_work_init(&my_work, padata_mt_helper, &ps, PADATA_WORK_ONSTACK);
@@ -528,6 +546,8 @@ void __init padata_do_multithreaded(struct padata_mt_job *job)
 
 	destroy_work_on_stack(&my_work.pw_work);
 	padata_works_free(&works);
+
+	return ps.cancelled ? -EINTR : 0;
 }
 
 static void __padata_list_init(struct padata_list *pd_list)
@@ -1102,12 +1122,20 @@ EXPORT_SYMBOL(padata_alloc_shell);
  */
 void padata_free_shell(struct padata_shell *ps)
 {
+	struct parallel_data *pd;
+
 	if (!ps)
 		return;
 
+	/*
+	 * The serial worker may still be running for the last objects it
+	 * completed, drop our reference and let whoever is last free the pd.
+	 */
 	mutex_lock(&ps->pinst->lock);
 	list_del(&ps->list);
-	padata_free_pd(rcu_dereference_protected(ps->pd, 1));
+	pd = rcu_dereference_protected(ps->pd, 1);
+	if (refcount_dec_and_test(&pd->refcnt))
+		padata_free_pd(pd);
 	mutex_unlock(&ps->pinst->lock);
 
 	kfree(ps);
@@ -19,6 +19,7 @@
 #include <linux/sched/rseq_api.h>
 #include <linux/sched/task_stack.h>
 
+#include <linux/bsearch.h>
 #include <linux/cpufreq.h>
 #include <linux/cpumask_api.h>
 #include <linux/cpuset.h>
@@ -38,6 +39,7 @@
 #include <linux/ptrace_api.h>
 #include <linux/sched_clock.h>
 #include <linux/security.h>
+#include <linux/sort.h>
 #include <linux/spinlock_api.h>
 #include <linux/swait_api.h>
 #include <linux/timex.h>
@@ -61,6 +61,7 @@
 #include <linux/scs.h>
 #include <linux/slab.h>
 #include <linux/syscalls.h>
+#include <linux/task_work.h>
 #include <linux/vtime.h>
 #include <linux/wait_api.h>
 #include <linux/workqueue_api.h>
@@ -110,6 +111,8 @@ EXPORT_TRACEPOINT_SYMBOL_GPL(sched_overutilized_tp);
 EXPORT_TRACEPOINT_SYMBOL_GPL(sched_util_est_cfs_tp);
 EXPORT_TRACEPOINT_SYMBOL_GPL(sched_util_est_se_tp);
 EXPORT_TRACEPOINT_SYMBOL_GPL(sched_update_nr_running_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(sched_ttwu_queue_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(sched_wakeup_preempt_tp);
 
 DEFINE_PER_CPU_SHARED_ALIGNED(struct rq, runqueues);
 
@@ -3678,6 +3681,7 @@ static void ttwu_do_wakeup(struct rq *rq, struct task_struct *p, int wake_flags,
 			   struct rq_flags *rf)
 {
 	check_preempt_curr(rq, p, wake_flags);
+	trace_sched_wakeup_preempt_tp(p, test_tsk_need_resched(rq->curr));
 	WRITE_ONCE(p->__state, TASK_RUNNING);
 	trace_sched_wakeup(p);
 
@@ -3815,14 +3819,25 @@ void sched_ttwu_pending(void *arg)
 	rq_unlock_irqrestore(rq, &rf);
 }
 
-void send_call_function_single_ipi(int cpu)
+/*
+ * Returns true if @cpu needs an IPI to notice newly queued SMP function
+ * calls, false if it is polling in idle and has been told to flush its
+ * queue on the way out instead.
+ */
+bool call_function_single_prep_ipi(int cpu)
 {
-	struct rq *rq = cpu_rq(cpu);
+	if (set_nr_if_polling(cpu_rq(cpu)->idle)) {
+		trace_sched_wake_idle_without_ipi(cpu);
+		return false;
+	}
+
+	return true;
+}
 
-	if (!set_nr_if_polling(rq->idle))
+void send_call_function_single_ipi(int cpu)
+{
+	if (call_function_single_prep_ipi(cpu))
 		arch_send_call_function_single_ipi(cpu);
-	else
-		trace_sched_wake_idle_without_ipi(cpu);
 }
 
 /*
@@ -3838,6 +3853,7 @@ static void __ttwu_queue_wakelist(struct task_struct *p, int cpu, int wake_flags
 	p->sched_remote_wakeup = !!(wake_flags & WF_MIGRATED);
 
 	WRITE_ONCE(rq->ttwu_pending, 1);
+	trace_sched_ttwu_queue_tp(p, cpu);
 	__smp_call_single_queue(cpu, &p->wake_entry.llist);
 }
 
@@ -4436,6 +4452,7 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	init_dl_task_timer(&p->dl);
 	init_dl_inactive_task_timer(&p->dl);
 	__dl_clear_params(p);
+	p->dl_server = NULL;
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 	p->rt.timeout		= 0;
@@ -4443,6 +4460,16 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->rt.on_rq		= 0;
 	p->rt.on_list		= 0;
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+	p->scx.dsq		= NULL;
+	INIT_LIST_HEAD(&p->scx.dsq_node);
+	p->scx.flags		= 0;
+	p->scx.holding_cpu	= -1;
+	p->scx.slice		= SCX_SLICE_DFL;
+	INIT_LIST_HEAD(&p->scx.runnable_node);
+	p->scx.runnable_at	= 0;
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -4671,6 +4698,9 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		} else if (PRIO_TO_NICE(p->static_prio) < 0)
 			p->static_prio = NICE_TO_PRIO(0);
 
+		if (p->se.latency_nice < DEFAULT_LATENCY_NICE)
+			p->se.latency_nice = DEFAULT_LATENCY_NICE;
+
 		p->prio = p->normal_prio = p->static_prio;
 		set_load_weight(p, false);
 
@@ -4685,6 +4715,8 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		return -EAGAIN;
 	else if (rt_prio(p->prio))
 		p->sched_class = &rt_sched_class;
+	else if (task_should_scx(p))
+		p->sched_class = &ext_sched_class;
 	else
 		p->sched_class = &fair_sched_class;
 
@@ -4770,6 +4802,14 @@ void wake_up_new_task(struct task_struct *p)
 
 	raw_spin_lock_irqsave(&p->pi_lock, rf.flags);
 	WRITE_ONCE(p->__state, TASK_RUNNING);
+#ifdef CONFIG_SCHED_CLASS_EXT
+	/*
+	 * A BPF scheduler may have been attached after sched_fork() but
+	 * before @p showed up on the task list it walks.
+	 */
+	if (p->sched_class == &fair_sched_class && task_should_scx(p))
+		p->sched_class = &ext_sched_class;
+#endif
 #ifdef CONFIG_SMP
 	/*
 	 * Fork balancing, do it here and not earlier because:
@@ -5250,6 +5290,8 @@ context_switch(struct rq *rq, struct task_struct *prev,
 	 */
 	arch_start_context_switch(prev);
 
+	switch_mm_cid(rq, prev, next);
+
 	/*
 	 * kernel -> kernel   lazy + transfer active
 	 *   user -> kernel   lazy + mmgrab() active
@@ -5564,6 +5606,7 @@ void scheduler_tick(void)
 	thermal_pressure = arch_scale_thermal_pressure(cpu_of(rq));
 	update_thermal_load_avg(rq_clock_thermal(rq), rq, thermal_pressure);
 	curr->sched_class->task_tick(rq, curr, 0);
+	task_tick_mm_cid(rq, curr);
 	if (sched_feat(LATENCY_WARN))
 		resched_latency = cpu_resched_latency(rq);
 	calc_global_load_tick(rq);
@@ -5878,6 +5921,8 @@ static void put_prev_task_balance(struct rq *rq, struct task_struct *prev,
 {
 #ifdef CONFIG_SMP
 	const struct sched_class *class;
+	bool ext_balanced = false;
+
 	/*
 	 * We must do the balancing pass before put_prev_task(), such
 	 * that when we release the rq->lock the task is in the same
@@ -5887,9 +5932,25 @@ static void put_prev_task_balance(struct rq *rq, struct task_struct *prev,
 	 * a runnable task of @class priority or higher.
 	 */
 	for_class_range(class, prev->sched_class, &idle_sched_class) {
+#ifdef CONFIG_SCHED_CLASS_EXT
+		if (class == &ext_sched_class)
+			ext_balanced = true;
+#endif
 		if (class->balance(rq, prev, rf))
 			break;
 	}
+#ifdef CONFIG_SCHED_CLASS_EXT
+	/*
+	 * balance_fair() ends the pass as soon as rq->nr_running is set, which
+	 * counts ext tasks that may still sit on a shared dispatch queue, and
+	 * an idle @prev skips the pass entirely. Unless other classes have
+	 * work here, let the ext class run ops.dispatch() and pull from the
+	 * global DSQ so those tasks get onto a local DSQ and can be picked.
+	 */
+	if (scx_enabled() && !ext_balanced &&
+	    rq->nr_running == rq->scx.nr_running)
+		ext_sched_class.balance(rq, prev, rf);
+#endif
 #endif
 
 	put_prev_task(rq, prev);
@@ -5909,9 +5970,13 @@ __pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 	 * call that function directly, but only if the @prev task wasn't of a
 	 * higher scheduling class, because otherwise those lose the
 	 * opportunity to pull in more work from other CPUs.
+	 *
+	 * dl servers do not count in nr_running, but have to be picked by the
+	 * deadline class all the same.
 	 */
 	if (likely(!sched_class_above(prev->sched_class, &fair_sched_class) &&
-		   rq->nr_running == rq->cfs.h_nr_running)) {
+		   rq->nr_running == rq->cfs.h_nr_running &&
+		   !rq->dl.dl_nr_running)) {
 
 		p = pick_next_task_fair(rq, prev, rf);
 		if (unlikely(p == RETRY_TASK))
@@ -5957,6 +6022,42 @@ static inline bool cookie_match(struct task_struct *a, struct task_struct *b)
 	return a->core_cookie == b->core_cookie;
 }
 
+/*
+ * Can @next run without a core-wide selection? That is the case when it
+ * carries the cookie the core already runs with, and no sibling is running,
+ * or about to switch to, a task of another cookie: the core-wide selection
+ * could only settle on that same cookie again. A sibling with something more
+ * important to run gets to re-evaluate from its own schedule().
+ */
+static bool sched_core_pick_local(struct rq *rq, struct task_struct *next)
+{
+	unsigned long cookie = rq->core->core_cookie;
+	int i, cpu = cpu_of(rq), occ = 1;
+
+	if (!cookie || next->core_cookie != cookie)
+		return false;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *rq_i = cpu_rq(i);
+
+		if (i == cpu)
+			continue;
+
+		if (!cookie_equals(rq_i->curr, cookie))
+			return false;
+
+		if (rq_i->core_pick && !cookie_equals(rq_i->core_pick, cookie))
+			return false;
+
+		if (!is_task_rq_idle(rq_i->curr))
+			occ++;
+	}
+
+	next->core_occupation = occ;
+
+	return true;
+}
+
 static inline struct task_struct *pick_task(struct rq *rq)
 {
 	const struct sched_class *class;
@@ -6032,6 +6133,21 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 	smt_mask = cpu_smt_mask(cpu);
 	need_sync = !!rq->core->core_cookie;
 
+	/*
+	 * Optimize for the common case of a core that keeps running a single
+	 * cookie. Leave the sequence counts alone, the siblings' pending picks
+	 * are compatible with @next and remain valid.
+	 */
+	if (sched_feat(CORE_PICK_LOCAL) && need_sync &&
+	    !rq->core->core_forceidle_count) {
+		next = pick_task(rq);
+		if (sched_core_pick_local(rq, next)) {
+			rq->core_pick = NULL;
+			task_vruntime_update(rq, next, false);
+			goto out_set_next;
+		}
+	}
+
 	/* reset state */
 	rq->core->core_cookie = 0UL;
 	if (rq->core->core_forceidle_count) {
@@ -6937,12 +7053,56 @@ static void __setscheduler_prio(struct task_struct *p, int prio)
 		p->sched_class = &dl_sched_class;
 	else if (rt_prio(prio))
 		p->sched_class = &rt_sched_class;
+	else if (task_should_scx(p))
+		p->sched_class = &ext_sched_class;
 	else
 		p->sched_class = &fair_sched_class;
 
 	p->prio = prio;
 }
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+/*
+ * Move @p between the fair and ext classes after a BPF scheduler was
+ * attached or detached; its policy and priority stay as they are.
+ */
+void sched_ext_reclass_task(struct task_struct *p)
+{
+	int queue_flags = DEQUEUE_SAVE | DEQUEUE_MOVE | DEQUEUE_NOCLOCK;
+	const struct sched_class *prev_class;
+	struct balance_callback *head;
+	int queued, running;
+	struct rq_flags rf;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &rf);
+	update_rq_clock(rq);
+
+	prev_class = p->sched_class;
+	queued = task_on_rq_queued(p);
+	running = task_current(rq, p);
+	if (queued)
+		dequeue_task(rq, p, queue_flags);
+	if (running)
+		put_prev_task(rq, p);
+
+	__setscheduler_prio(p, p->prio);
+
+	if (queued)
+		enqueue_task(rq, p, queue_flags);
+	if (running)
+		set_next_task(rq, p);
+
+	check_class_changed(rq, p, prev_class, p->prio);
+
+	preempt_disable();
+	head = splice_balance_callbacks(rq);
+	task_rq_unlock(rq, p, &rf);
+	balance_callbacks(rq, head);
+	preempt_enable();
+}
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 
 static inline int __rt_effective_prio(struct task_struct *pi_task, int prio)
@@ -7467,6 +7627,11 @@ static int user_check_sched_setscheduler(struct task_struct *p,
 			goto req_priv;
 	}
 
+	/* Becoming more latency sensitive is a privilege, like lowering nice: */
+	if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+	    attr->sched_latency_nice < p->se.latency_nice)
+		goto req_priv;
+
 	if (rt_policy(policy)) {
 		unsigned long rlim_rtprio = task_rlimit(p, RLIMIT_RTPRIO);
 
@@ -7556,6 +7721,11 @@ static int __sched_setscheduler(struct task_struct *p,
 	    (rt_policy(policy) != (attr->sched_priority != 0)))
 		return -EINVAL;
 
+	if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+	    (attr->sched_latency_nice > MAX_LATENCY_NICE ||
+	     attr->sched_latency_nice < MIN_LATENCY_NICE))
+		return -EINVAL;
+
 	if (user) {
 		retval = user_check_sched_setscheduler(p, attr, policy, reset_on_fork);
 		if (retval)
@@ -7610,6 +7780,9 @@ static int __sched_setscheduler(struct task_struct *p,
 			goto change;
 		if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP)
 			goto change;
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice != p->se.latency_nice)
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		retval = 0;
@@ -7700,6 +7873,9 @@ static int __sched_setscheduler(struct task_struct *p,
 	}
 	__setscheduler_uclamp(p, attr);
 
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE)
+		p->se.latency_nice = attr->sched_latency_nice;
+
 	if (queued) {
 		/*
 		 * We enqueue to tail when the priority of a task is
@@ -7908,6 +8084,10 @@ static int sched_copy_attr(struct sched_attr __user *uattr, struct sched_attr *a
 	    size < SCHED_ATTR_SIZE_VER1)
 		return -EINVAL;
 
+	if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+	    size < SCHED_ATTR_SIZE_VER2)
+		return -EINVAL;
+
 	/*
 	 * XXX: Do we want to be lenient like existing syscalls; or do we want
 	 * to be strict and return an error on out-of-bounds values?
@@ -8155,6 +8335,8 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	kattr.sched_util_max = p->uclamp_req[UCLAMP_MAX].value;
 #endif
 
+	kattr.sched_latency_nice = p->se.latency_nice;
+
 	rcu_read_unlock();
 
 	return sched_attr_copy_to_user(uattr, &kattr, usize);
@@ -8622,15 +8804,21 @@ int sched_dynamic_mode(const char *str)
 #if defined(CONFIG_HAVE_PREEMPT_DYNAMIC_CALL)
 #define preempt_dynamic_enable(f)	static_call_update(f, f##_dynamic_enabled)
 #define preempt_dynamic_disable(f)	static_call_update(f, f##_dynamic_disabled)
+#define preempt_dynamic_batch_begin()	do { } while (0)
+#define preempt_dynamic_batch_end()	do { } while (0)
 #elif defined(CONFIG_HAVE_PREEMPT_DYNAMIC_KEY)
-#define preempt_dynamic_enable(f)	static_key_enable(&sk_dynamic_##f.key)
-#define preempt_dynamic_disable(f)	static_key_disable(&sk_dynamic_##f.key)
+#define preempt_dynamic_enable(f)	static_key_batch_enable(&sk_dynamic_##f.key)
+#define preempt_dynamic_disable(f)	static_key_batch_disable(&sk_dynamic_##f.key)
+#define preempt_dynamic_batch_begin()	static_key_batch_begin()
+#define preempt_dynamic_batch_end()	static_key_batch_end()
 #else
 #error "Unsupported PREEMPT_DYNAMIC mechanism"
 #endif
 
 void sched_dynamic_update(int mode)
 {
+	preempt_dynamic_batch_begin();
+
 	/*
 	 * Avoid {NONE,VOLUNTARY} -> FULL transitions from ever ending up in
 	 * the ZERO state, which is invalid.
@@ -8641,6 +8829,15 @@ void sched_dynamic_update(int mode)
 	preempt_dynamic_enable(preempt_schedule_notrace);
 	preempt_dynamic_enable(irqentry_exit_cond_resched);
 
+	/*
+	 * Let the preamble hit the text before anything gets disabled again:
+	 * within one batch the FULL case would disable cond_resched in the
+	 * same round that enables it, and which state wins is then up to
+	 * the batch.
+	 */
+	preempt_dynamic_batch_end();
+	preempt_dynamic_batch_begin();
+
 	switch (mode) {
 	case preempt_dynamic_none:
 		preempt_dynamic_enable(cond_resched);
@@ -8670,6 +8867,8 @@ void sched_dynamic_update(int mode)
 		break;
 	}
 
+	preempt_dynamic_batch_end();
+
 	preempt_dynamic_mode = mode;
 }
 
@@ -8885,6 +9084,7 @@ SYSCALL_DEFINE1(sched_get_priority_max, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_EXT:
 		ret = 0;
 		break;
 	}
@@ -8912,6 +9112,7 @@ SYSCALL_DEFINE1(sched_get_priority_min, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_EXT:
 		ret = 0;
 	}
 	return ret;
@@ -9936,6 +10137,7 @@ void __init sched_init(void)
 	balance_push_set(smp_processor_id(), false);
 #endif
 	init_sched_fair_class();
+	init_sched_ext_class();
 
 	psi_init();
 
@@ -10207,6 +10409,9 @@ static inline void alloc_uclamp_sched_group(struct task_group *tg,
 
 static void sched_free_group(struct task_group *tg)
 {
+#ifdef CONFIG_SCHED_INFO
+	free_percpu(tg->hist_cpu);
+#endif
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
@@ -10391,6 +10596,19 @@ cpu_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	if (IS_ERR(tg))
 		return ERR_PTR(-ENOMEM);
 
+#ifdef CONFIG_SCHED_INFO
+	/*
+	 * Only groups backed by a cgroup get histograms, cpu.stat of the
+	 * root reports system wide numbers and autogroups have no cgroup
+	 * to flush them through.
+	 */
+	tg->hist_cpu = alloc_percpu(struct tg_hist_cpu);
+	if (!tg->hist_cpu) {
+		sched_free_group(tg);
+		return ERR_PTR(-ENOMEM);
+	}
+#endif
+
 	return &tg->css;
 }
 
@@ -11011,6 +11229,91 @@ static int cpu_idle_write_s64(struct cgroup_subsys_state *css,
 {
 	return sched_group_set_idle(css_tg(css), idle);
 }
+
+static s64 cpu_latency_nice_read_s64(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	return css_tg(css)->latency_nice;
+}
+
+static int cpu_latency_nice_write_s64(struct cgroup_subsys_state *css,
+				      struct cftype *cft, s64 nice)
+{
+	if (nice < MIN_LATENCY_NICE || nice > MAX_LATENCY_NICE)
+		return -ERANGE;
+
+	return sched_group_set_latency_nice(css_tg(css), nice);
+}
+#endif
+
+#ifdef CONFIG_CFS_DL_SERVER
+static u64 cpu_dl_runtime_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return div_u64(css_tg(css)->dl_runtime, NSEC_PER_USEC);
+}
+
+static int cpu_dl_runtime_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 runtime_us)
+{
+	struct task_group *tg = css_tg(css);
+	u64 period = tg->dl_period;
+
+	if (runtime_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	/* a reservation needs a period, default to the RT period */
+	if (!period)
+		period = global_rt_period();
+
+	return sched_group_set_dl_server(tg, runtime_us * NSEC_PER_USEC, period);
+}
+
+static u64 cpu_dl_period_read_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft)
+{
+	return div_u64(css_tg(css)->dl_period, NSEC_PER_USEC);
+}
+
+static int cpu_dl_period_write_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft, u64 period_us)
+{
+	struct task_group *tg = css_tg(css);
+
+	if (period_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	return sched_group_set_dl_server(tg, tg->dl_runtime,
+					 period_us * NSEC_PER_USEC);
+}
+
+static int cpu_dl_server_show(struct seq_file *sf, void *v)
+{
+	struct task_group *tg = css_tg(seq_css(sf));
+
+	seq_printf(sf, "%llu %llu\n", div_u64(tg->dl_runtime, NSEC_PER_USEC),
+		   div_u64(tg->dl_period, NSEC_PER_USEC));
+	return 0;
+}
+
+static ssize_t cpu_dl_server_write(struct kernfs_open_file *of,
+				   char *buf, size_t nbytes, loff_t off)
+{
+	struct task_group *tg = css_tg(of_css(of));
+	u64 runtime, period = div_u64(tg->dl_period, NSEC_PER_USEC);
+	int ret;
+
+	if (sscanf(buf, "%llu %llu", &runtime, &period) < 1)
+		return -EINVAL;
+
+	if (runtime > U64_MAX / NSEC_PER_USEC ||
+	    period > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	ret = sched_group_set_dl_server(tg, runtime * NSEC_PER_USEC,
+					period * NSEC_PER_USEC);
+	return ret ?: nbytes;
+}
 #endif
 
 static struct cftype cpu_legacy_files[] = {
@@ -11025,6 +11328,11 @@ static struct cftype cpu_legacy_files[] = {
 		.read_s64 = cpu_idle_read_s64,
 		.write_s64 = cpu_idle_write_s64,
 	},
+	{
+		.name = "latency.nice",
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -11047,6 +11355,20 @@ static struct cftype cpu_legacy_files[] = {
 		.seq_show = cpu_cfs_stat_show,
 	},
 #endif
+#ifdef CONFIG_CFS_DL_SERVER
+	{
+		.name = "dl_runtime_us",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_dl_runtime_read_u64,
+		.write_u64 = cpu_dl_runtime_write_u64,
+	},
+	{
+		.name = "dl_period_us",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_dl_period_read_u64,
+		.write_u64 = cpu_dl_period_write_u64,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
@@ -11076,6 +11398,79 @@ static struct cftype cpu_legacy_files[] = {
 	{ }	/* Terminate */
 };
 
+#ifdef CONFIG_SCHED_INFO
+static inline int tg_hist_bucket(u64 delta)
+{
+	return min(fls64(delta >> 10), TG_HIST_BUCKETS - 1);
+}
+
+/*
+ * Called from sched_info_arrive() and sched_info_depart() with the rq lock
+ * held. Only the local per-CPU counter is touched, folding the CPUs and the
+ * hierarchy together is left to cpu_cgroup_css_rstat_flush().
+ */
+void tg_hist_account(struct rq *rq, struct task_struct *p,
+		     enum tg_hist_type type, u64 delta)
+{
+	struct task_group *tg = task_group(p);
+	struct tg_hist_cpu *hc;
+	int cpu = cpu_of(rq);
+
+	if (!tg->hist_cpu)
+		return;
+
+	hc = per_cpu_ptr(tg->hist_cpu, cpu);
+	hc->cur.cnt[type][tg_hist_bucket(delta)]++;
+	cgroup_rstat_updated(tg->css.cgroup, cpu);
+}
+
+static void cpu_cgroup_css_rstat_flush(struct cgroup_subsys_state *css, int cpu)
+{
+	struct task_group *tg = css_tg(css);
+	struct task_group *parent = tg->parent;
+	struct tg_hist_cpu *hc;
+	int type, i;
+
+	if (!tg->hist_cpu)
+		return;
+
+	hc = per_cpu_ptr(tg->hist_cpu, cpu);
+	for (type = 0; type < TG_NR_HISTS; type++) {
+		for (i = 0; i < TG_HIST_BUCKETS; i++) {
+			u64 val = READ_ONCE(hc->cur.cnt[type][i]);
+			u64 delta;
+
+			tg->hist.cnt[type][i] += val - hc->last.cnt[type][i];
+			hc->last.cnt[type][i] = val;
+
+			/* children are flushed before their parent */
+			delta = tg->hist.cnt[type][i] - tg->hist_last.cnt[type][i];
+			tg->hist_last.cnt[type][i] = tg->hist.cnt[type][i];
+			if (parent && parent->hist_cpu)
+				parent->hist.cnt[type][i] += delta;
+		}
+	}
+}
+
+static void cpu_hist_show(struct seq_file *sf, const char *name, u64 *cnt)
+{
+	int i, last;
+
+	for (last = TG_HIST_BUCKETS - 1; last > 0; last--)
+		if (cnt[last])
+			break;
+
+	seq_puts(sf, name);
+	for (i = 0; i <= last; i++) {
+		if (i == TG_HIST_BUCKETS - 1)
+			seq_printf(sf, " max=%llu", cnt[i]);
+		else
+			seq_printf(sf, " %llu=%llu", 1ULL << (i + 10), cnt[i]);
+	}
+	seq_putc(sf, '\n');
+}
+#endif
+
 static int cpu_extra_stat_show(struct seq_file *sf,
 			       struct cgroup_subsys_state *css)
 {
@@ -11098,6 +11493,21 @@ static int cpu_extra_stat_show(struct seq_file *sf,
 			   cfs_b->nr_periods, cfs_b->nr_throttled,
 			   throttled_usec, cfs_b->nr_burst, burst_usec);
 	}
+#endif
+#ifdef CONFIG_SCHED_INFO
+	{
+		struct task_group *tg = css_tg(css);
+		struct tg_hist hist;
+
+		if (tg->hist_cpu) {
+			cgroup_rstat_flush_hold(css->cgroup);
+			hist = tg->hist;
+			cgroup_rstat_flush_release();
+
+			cpu_hist_show(sf, "wait_hist_ns", hist.cnt[TG_HIST_WAIT]);
+			cpu_hist_show(sf, "run_hist_ns", hist.cnt[TG_HIST_RUN]);
+		}
+	}
 #endif
 	return 0;
 }
@@ -11242,6 +11652,12 @@ static struct cftype cpu_files[] = {
 		.read_s64 = cpu_idle_read_s64,
 		.write_s64 = cpu_idle_write_s64,
 	},
+	{
+		.name = "latency.nice",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -11257,6 +11673,14 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_cfs_burst_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_DL_SERVER
+	{
+		.name = "dl.server",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_dl_server_show,
+		.write = cpu_dl_server_write,
+	},
+#endif
 #ifdef CONFIG_UCLAMP_TASK_GROUP
 	{
 		.name = "uclamp.min",
@@ -11280,6 +11704,9 @@ struct cgroup_subsys cpu_cgrp_subsys = {
 	.css_released	= cpu_cgroup_css_released,
 	.css_free	= cpu_cgroup_css_free,
 	.css_extra_stat_show = cpu_extra_stat_show,
+#ifdef CONFIG_SCHED_INFO
+	.css_rstat_flush = cpu_cgroup_css_rstat_flush,
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	.can_attach	= cpu_cgroup_can_attach,
 #endif
@@ -11356,3 +11783,136 @@ void call_trace_sched_update_nr_running(struct rq *rq, int count)
 {
         trace_sched_update_nr_running_tp(rq, count);
 }
+
+#ifdef CONFIG_SCHED_MM_CID
+/*
+ * Give back the concurrency ID @cpu holds for @mm if the CPU has not run
+ * the mm for MM_CID_SCAN_DELAY. Done under the rq lock of @cpu, so that
+ * it cannot hand the ID to a task of @mm at the same time.
+ */
+static void sched_mm_cid_remote_clear(struct mm_struct *mm, int cpu,
+				      unsigned long now)
+{
+	struct mm_cid *pcpu_cid = per_cpu_ptr(mm->pcpu_cid, cpu);
+	struct rq *rq = cpu_rq(cpu);
+	struct rq_flags rf;
+	int cid;
+
+	if (READ_ONCE(pcpu_cid->cid) < 0 ||
+	    time_before(now, READ_ONCE(pcpu_cid->time) + MM_CID_SCAN_DELAY))
+		return;
+
+	rq_lock_irqsave(rq, &rf);
+	cid = pcpu_cid->cid;
+	/* A task of @mm running there is still using the ID */
+	if (cid < 0 || rq->curr->mm == mm ||
+	    time_before(now, pcpu_cid->time + MM_CID_SCAN_DELAY))
+		goto unlock;
+	WRITE_ONCE(pcpu_cid->cid, -1);
+	mm_cid_put(mm, cid);
+unlock:
+	rq_unlock_irqrestore(rq, &rf);
+}
+
+static void task_mm_cid_work(struct callback_head *work)
+{
+	struct task_struct *t = current;
+	struct mm_struct *mm = t->mm;
+	unsigned long now = jiffies, old_scan, next_scan;
+	int cpu;
+
+	SCHED_WARN_ON(t != container_of(work, struct task_struct, cid_work));
+
+	work->next = work;	/* Prevent double-add */
+	if (t->flags & PF_EXITING)
+		return;
+	if (!mm)
+		return;
+
+	old_scan = READ_ONCE(mm->mm_cid_next_scan);
+	if (time_before(now, old_scan))
+		return;
+	next_scan = now + MM_CID_SCAN_DELAY;
+	/* Only one thread of the mm scans per period */
+	if (cmpxchg(&mm->mm_cid_next_scan, old_scan, next_scan) != old_scan)
+		return;
+
+	for_each_possible_cpu(cpu)
+		sched_mm_cid_remote_clear(mm, cpu, now);
+}
+
+/*
+ * Called from scheduler_tick() with the rq lock held: once per
+ * MM_CID_SCAN_DELAY, have a task of the mm reclaim the IDs of the CPUs
+ * which stopped running it.
+ */
+void task_tick_mm_cid(struct rq *rq, struct task_struct *curr)
+{
+	struct callback_head *work = &curr->cid_work;
+
+	if (!curr->mm_cid_active || (curr->flags & PF_EXITING) ||
+	    work->next != work)
+		return;
+	if (time_before(jiffies, READ_ONCE(curr->mm->mm_cid_next_scan)))
+		return;
+	task_work_add(curr, work, TWA_RESUME);
+}
+
+/*
+ * @t, which is current, stops using a concurrency ID. The ID stays with
+ * the CPU for the other tasks of the mm and is reclaimed once unused.
+ */
+static void sched_mm_cid_stop(struct task_struct *t)
+{
+	struct rq_flags rf;
+	struct rq *rq;
+
+	if (!t->mm)
+		return;
+
+	preempt_disable();
+	rq = this_rq();
+	rq_lock_irqsave(rq, &rf);
+	t->mm_cid = -1;
+	t->mm_cid_active = 0;
+	rq_unlock_irqrestore(rq, &rf);
+	preempt_enable();
+}
+
+void sched_mm_cid_exit_signals(struct task_struct *t)
+{
+	sched_mm_cid_stop(t);
+}
+
+void sched_mm_cid_before_execve(struct task_struct *t)
+{
+	sched_mm_cid_stop(t);
+}
+
+void sched_mm_cid_after_execve(struct task_struct *t)
+{
+	struct mm_struct *mm = t->mm;
+	struct rq_flags rf;
+	struct rq *rq;
+
+	if (!mm)
+		return;
+
+	preempt_disable();
+	rq = this_rq();
+	rq_lock_irqsave(rq, &rf);
+	t->mm_cid = mm_cid_get(rq, mm);
+	t->mm_cid_active = 1;
+	rq_unlock_irqrestore(rq, &rf);
+	preempt_enable();
+	rseq_set_notify_resume(t);
+}
+
+void sched_mm_cid_fork(struct task_struct *t)
+{
+	WARN_ON_ONCE(!t->mm || t->mm_cid != -1);
+	t->cid_work.next = &t->cid_work;
+	init_task_work(&t->cid_work, task_mm_cid_work);
+	t->mm_cid_active = 1;
+}
+#endif
@@ -52,8 +52,14 @@ static int __init sched_dl_sysctl_init(void)
 late_initcall(sched_dl_sysctl_init);
 #endif
 
+static inline bool dl_server(struct sched_dl_entity *dl_se)
+{
+	return dl_se->dl_server;
+}
+
 static inline struct task_struct *dl_task_of(struct sched_dl_entity *dl_se)
 {
+	BUG_ON(dl_server(dl_se));
 	return container_of(dl_se, struct task_struct, dl);
 }
 
@@ -62,12 +68,19 @@ static inline struct rq *rq_of_dl_rq(struct dl_rq *dl_rq)
 	return container_of(dl_rq, struct rq, dl);
 }
 
-static inline struct dl_rq *dl_rq_of_se(struct sched_dl_entity *dl_se)
+static inline struct rq *rq_of_dl_se(struct sched_dl_entity *dl_se)
 {
-	struct task_struct *p = dl_task_of(dl_se);
-	struct rq *rq = task_rq(p);
+	struct rq *rq = dl_se->rq;
+
+	if (!dl_server(dl_se))
+		rq = task_rq(dl_task_of(dl_se));
 
-	return &rq->dl;
+	return rq;
+}
+
+static inline struct dl_rq *dl_rq_of_se(struct sched_dl_entity *dl_se)
+{
+	return &rq_of_dl_se(dl_se)->dl;
 }
 
 static inline int on_dl_rq(struct sched_dl_entity *dl_se)
@@ -480,10 +493,8 @@ static void task_contending(struct sched_dl_entity *dl_se, int flags)
 	}
 }
 
-static inline int is_leftmost(struct task_struct *p, struct dl_rq *dl_rq)
+static inline int is_leftmost(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	struct sched_dl_entity *dl_se = &p->dl;
-
 	return rb_first_cached(&dl_rq->root) == &dl_se->rb_node;
 }
 
@@ -768,6 +779,8 @@ static inline void deadline_queue_pull_task(struct rq *rq)
 
 static void enqueue_task_dl(struct rq *rq, struct task_struct *p, int flags);
 static void __dequeue_task_dl(struct rq *rq, struct task_struct *p, int flags);
+static void enqueue_dl_entity(struct sched_dl_entity *dl_se, int flags);
+static void dequeue_dl_entity(struct sched_dl_entity *dl_se);
 static void check_preempt_curr_dl(struct rq *rq, struct task_struct *p, int flags);
 
 static inline void replenish_dl_new_period(struct sched_dl_entity *dl_se,
@@ -1047,11 +1060,10 @@ static inline u64 dl_next_period(struct sched_dl_entity *dl_se)
  * actually started or not (i.e., the replenishment instant is in
  * the future or in the past).
  */
-static int start_dl_timer(struct task_struct *p)
+static int start_dl_timer(struct sched_dl_entity *dl_se)
 {
-	struct sched_dl_entity *dl_se = &p->dl;
 	struct hrtimer *timer = &dl_se->dl_timer;
-	struct rq *rq = task_rq(p);
+	struct rq *rq = rq_of_dl_se(dl_se);
 	ktime_t now, act;
 	s64 delta;
 
@@ -1083,9 +1095,13 @@ static int start_dl_timer(struct task_struct *p)
 	 * harmless because we're holding task_rq()->lock, therefore the timer
 	 * expiring after we've done the check will wait on its task_rq_lock()
 	 * and observe our state.
+	 *
+	 * Servers are not refcounted, their owner cancels the timer before
+	 * freeing them.
 	 */
 	if (!hrtimer_is_queued(timer)) {
-		get_task_struct(p);
+		if (!dl_server(dl_se))
+			get_task_struct(dl_task_of(dl_se));
 		hrtimer_start(timer, act, HRTIMER_MODE_ABS_HARD);
 	}
 
@@ -1105,15 +1121,53 @@ static int start_dl_timer(struct task_struct *p)
  * updating (and the queueing back to dl_rq) will be done by the
  * next call to enqueue_task_dl().
  */
+static enum hrtimer_restart dl_server_timer(struct hrtimer *timer,
+					    struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = rq_of_dl_se(dl_se);
+	struct rq_flags rf;
+
+	rq_lock(rq, &rf);
+
+	/* Spurious timer, the server was stopped in the meantime */
+	if (!dl_se->dl_throttled)
+		goto unlock;
+
+	sched_clock_tick();
+	update_rq_clock(rq);
+
+	/*
+	 * A server that ran out of work while throttled is not put back,
+	 * it gets started again by the next task showing up.
+	 */
+	if (!dl_se->server_has_tasks(dl_se)) {
+		replenish_dl_entity(dl_se);
+		dl_se->dl_server_active = 0;
+		goto unlock;
+	}
+
+	enqueue_dl_entity(dl_se, ENQUEUE_REPLENISH);
+	resched_curr(rq);
+
+unlock:
+	rq_unlock(rq, &rf);
+
+	return HRTIMER_NORESTART;
+}
+
 static enum hrtimer_restart dl_task_timer(struct hrtimer *timer)
 {
 	struct sched_dl_entity *dl_se = container_of(timer,
 						     struct sched_dl_entity,
 						     dl_timer);
-	struct task_struct *p = dl_task_of(dl_se);
+	struct task_struct *p;
 	struct rq_flags rf;
 	struct rq *rq;
 
+	if (dl_server(dl_se))
+		return dl_server_timer(timer, dl_se);
+
+	p = dl_task_of(dl_se);
 	rq = task_rq_lock(p, &rf);
 
 	/*
@@ -1245,7 +1299,7 @@ static inline void dl_check_constrained_dl(struct sched_dl_entity *dl_se)
 
 	if (dl_time_before(dl_se->deadline, rq_clock(rq)) &&
 	    dl_time_before(rq_clock(rq), dl_next_period(dl_se))) {
-		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(p)))
+		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(dl_se)))
 			return;
 		dl_se->dl_throttled = 1;
 		if (dl_se->runtime > 0)
@@ -1300,6 +1354,66 @@ static u64 grub_reclaim(u64 delta, struct rq *rq, struct sched_dl_entity *dl_se)
 	return (delta * u_act) >> BW_SHIFT;
 }
 
+/*
+ * Charge @delta_exec to the budget of @dl_se and throttle it once the
+ * budget is depleted. Shared by -deadline tasks and servers.
+ */
+static void update_curr_dl_se(struct rq *rq, struct sched_dl_entity *dl_se,
+			      s64 delta_exec)
+{
+	s64 scaled_delta_exec;
+
+	/*
+	 * For tasks that participate in GRUB, we implement GRUB-PA: the
+	 * spare reclaimed bandwidth is used to clock down frequency.
+	 *
+	 * For the others, we still need to scale reservation parameters
+	 * according to current frequency and CPU maximum capacity.
+	 */
+	if (delta_exec > 0) {
+		if (unlikely(dl_se->flags & SCHED_FLAG_RECLAIM)) {
+			scaled_delta_exec = grub_reclaim(delta_exec,
+							 rq,
+							 dl_se);
+		} else {
+			int cpu = cpu_of(rq);
+			unsigned long scale_freq = arch_scale_freq_capacity(cpu);
+			unsigned long scale_cpu = arch_scale_cpu_capacity(cpu);
+
+			scaled_delta_exec = cap_scale(delta_exec, scale_freq);
+			scaled_delta_exec = cap_scale(scaled_delta_exec, scale_cpu);
+		}
+
+		dl_se->runtime -= scaled_delta_exec;
+	}
+
+	if (!dl_runtime_exceeded(dl_se) && !dl_se->dl_yielded)
+		return;
+
+	dl_se->dl_throttled = 1;
+
+	/* If requested, inform the user about runtime overruns. */
+	if (dl_runtime_exceeded(dl_se) &&
+	    (dl_se->flags & SCHED_FLAG_DL_OVERRUN))
+		dl_se->dl_overrun = 1;
+
+	if (dl_server(dl_se)) {
+		dequeue_dl_entity(dl_se);
+		if (!start_dl_timer(dl_se))
+			enqueue_dl_entity(dl_se, ENQUEUE_REPLENISH);
+		/* The served task has to give the CPU back either way */
+		resched_curr(rq);
+		return;
+	}
+
+	__dequeue_task_dl(rq, dl_task_of(dl_se), 0);
+	if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(dl_se)))
+		enqueue_task_dl(rq, dl_task_of(dl_se), ENQUEUE_REPLENISH);
+
+	if (!is_leftmost(dl_se, &rq->dl))
+		resched_curr(rq);
+}
+
 /*
  * Update the current task's runtime statistics (provided it is still
  * a -deadline task and has not been removed from the dl_rq).
@@ -1308,8 +1422,7 @@ static void update_curr_dl(struct rq *rq)
 {
 	struct task_struct *curr = rq->curr;
 	struct sched_dl_entity *dl_se = &curr->dl;
-	u64 delta_exec, scaled_delta_exec;
-	int cpu = cpu_of(rq);
+	u64 delta_exec;
 	u64 now;
 
 	if (!dl_task(curr) || !on_dl_rq(dl_se))
@@ -1341,43 +1454,8 @@ static void update_curr_dl(struct rq *rq)
 	if (dl_entity_is_special(dl_se))
 		return;
 
-	/*
-	 * For tasks that participate in GRUB, we implement GRUB-PA: the
-	 * spare reclaimed bandwidth is used to clock down frequency.
-	 *
-	 * For the others, we still need to scale reservation parameters
-	 * according to current frequency and CPU maximum capacity.
-	 */
-	if (unlikely(dl_se->flags & SCHED_FLAG_RECLAIM)) {
-		scaled_delta_exec = grub_reclaim(delta_exec,
-						 rq,
-						 &curr->dl);
-	} else {
-		unsigned long scale_freq = arch_scale_freq_capacity(cpu);
-		unsigned long scale_cpu = arch_scale_cpu_capacity(cpu);
-
-		scaled_delta_exec = cap_scale(delta_exec, scale_freq);
-		scaled_delta_exec = cap_scale(scaled_delta_exec, scale_cpu);
-	}
-
-	dl_se->runtime -= scaled_delta_exec;
-
 throttle:
-	if (dl_runtime_exceeded(dl_se) || dl_se->dl_yielded) {
-		dl_se->dl_throttled = 1;
-
-		/* If requested, inform the user about runtime overruns. */
-		if (dl_runtime_exceeded(dl_se) &&
-		    (dl_se->flags & SCHED_FLAG_DL_OVERRUN))
-			dl_se->dl_overrun = 1;
-
-		__dequeue_task_dl(rq, curr, 0);
-		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(curr)))
-			enqueue_task_dl(rq, curr, ENQUEUE_REPLENISH);
-
-		if (!is_leftmost(curr, &rq->dl))
-			resched_curr(rq);
-	}
+	update_curr_dl_se(rq, dl_se, delta_exec);
 
 	/*
 	 * Because -- for now -- we share the rt bandwidth, we need to
@@ -1405,6 +1483,126 @@ static void update_curr_dl(struct rq *rq)
 	}
 }
 
+/*
+ * Deadline servers
+ *
+ * A server is a sched_dl_entity that does not belong to a task. It is queued
+ * on the dl_rq like any -deadline task and, when picked, hands out a task of
+ * a lower class through its ->server_pick() callback, whose runtime is then
+ * charged to the server through dl_server_update(). That gives the tasks
+ * behind the server a CBS reservation of (dl_runtime, dl_period) without
+ * making any of them SCHED_DEADLINE.
+ *
+ * Servers do not take part in GRUB reclaiming: their bandwidth is accounted
+ * for in admission control, but not in the running/this utilization.
+ */
+void dl_server_update(struct sched_dl_entity *dl_se, s64 delta_exec)
+{
+	if (on_dl_rq(dl_se))
+		update_curr_dl_se(dl_se->rq, dl_se, delta_exec);
+}
+
+void dl_server_start(struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = dl_se->rq;
+
+	if (!dl_se->dl_runtime || dl_se->dl_server_active)
+		return;
+
+	dl_se->dl_server_active = 1;
+	enqueue_dl_entity(dl_se, ENQUEUE_WAKEUP);
+	if (!dl_task(rq->curr) || dl_entity_preempt(dl_se, &rq->curr->dl))
+		resched_curr(rq);
+}
+
+void dl_server_stop(struct sched_dl_entity *dl_se)
+{
+	if (!dl_se->dl_server_active)
+		return;
+
+	dequeue_dl_entity(dl_se);
+	hrtimer_try_to_cancel(&dl_se->dl_timer);
+	dl_se->dl_throttled = 0;
+	dl_se->dl_server_active = 0;
+}
+
+void dl_server_init(struct sched_dl_entity *dl_se, struct rq *rq,
+		    dl_server_has_tasks_f has_tasks,
+		    dl_server_pick_f pick)
+{
+	RB_CLEAR_NODE(&dl_se->rb_node);
+	init_dl_task_timer(dl_se);
+#ifdef CONFIG_RT_MUTEXES
+	dl_se->pi_se = dl_se;
+#endif
+	dl_se->dl_server = 1;
+	dl_se->rq = rq;
+	dl_se->server_has_tasks = has_tasks;
+	dl_se->server_pick = pick;
+}
+
+/*
+ * Change the reservation of a server, @runtime == 0 disables it. The server
+ * must be stopped and its rq locked. Fails if the parameters are out of the
+ * bounds -deadline tasks are held to, or if the new bandwidth does not fit
+ * the root domain of the server's CPU, leaving the old parameters in place.
+ */
+int dl_server_apply_params(struct sched_dl_entity *dl_se, u64 runtime,
+			   u64 period)
+{
+	struct rq *rq = dl_se->rq;
+	int cpu = cpu_of(rq);
+	u64 new_bw = 0;
+
+	lockdep_assert_rq_held(rq);
+	WARN_ON_ONCE(dl_se->dl_server_active);
+
+	if (runtime) {
+		u64 max = (u64)READ_ONCE(sysctl_sched_dl_period_max) * NSEC_PER_USEC;
+		u64 min = (u64)READ_ONCE(sysctl_sched_dl_period_min) * NSEC_PER_USEC;
+
+		if (period < min || period > max ||
+		    runtime < (1ULL << DL_SCALE) || runtime > period)
+			return -EINVAL;
+
+		new_bw = to_ratio(period, runtime);
+	}
+
+	/*
+	 * Inactive CPUs are not part of any root domain bandwidth, theirs
+	 * is added back by dl_clear_root_domain() once they get one.
+	 */
+	if (cpu_active(cpu)) {
+		struct dl_bw *dl_b = dl_bw_of(cpu);
+		int cpus;
+
+		raw_spin_lock(&dl_b->lock);
+		cpus = dl_bw_cpus(cpu);
+		if (__dl_overflow(dl_b, dl_bw_capacity(cpu),
+				  dl_se->dl_bw, new_bw)) {
+			raw_spin_unlock(&dl_b->lock);
+			return -EBUSY;
+		}
+		if (dl_se->dl_bw)
+			__dl_sub(dl_b, dl_se->dl_bw, cpus);
+		if (new_bw)
+			__dl_add(dl_b, new_bw, cpus);
+		raw_spin_unlock(&dl_b->lock);
+	}
+
+	WRITE_ONCE(rq->dl.server_bw, rq->dl.server_bw - dl_se->dl_bw + new_bw);
+
+	dl_se->dl_runtime = runtime;
+	dl_se->dl_deadline = period;
+	dl_se->dl_period = period;
+	dl_se->dl_bw = new_bw;
+	dl_se->dl_density = new_bw;
+	dl_se->runtime = 0;
+	dl_se->deadline = 0;
+
+	return 0;
+}
+
 static enum hrtimer_restart inactive_task_timer(struct hrtimer *timer)
 {
 	struct sched_dl_entity *dl_se = container_of(timer,
@@ -1502,31 +1700,38 @@ static inline void dec_dl_deadline(struct dl_rq *dl_rq, u64 deadline) {}
 
 #endif /* CONFIG_SMP */
 
+/*
+ * Servers count in dl_nr_running, so that the class gets to pick them, but
+ * not in rq->nr_running: the tasks they serve are already accounted there.
+ */
 static inline
 void inc_dl_tasks(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	int prio = dl_task_of(dl_se)->prio;
 	u64 deadline = dl_se->deadline;
 
-	WARN_ON(!dl_prio(prio));
 	dl_rq->dl_nr_running++;
-	add_nr_running(rq_of_dl_rq(dl_rq), 1);
-
 	inc_dl_deadline(dl_rq, deadline);
+
+	if (dl_server(dl_se))
+		return;
+
+	WARN_ON(!dl_prio(dl_task_of(dl_se)->prio));
+	add_nr_running(rq_of_dl_rq(dl_rq), 1);
 	inc_dl_migration(dl_se, dl_rq);
 }
 
 static inline
 void dec_dl_tasks(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	int prio = dl_task_of(dl_se)->prio;
-
-	WARN_ON(!dl_prio(prio));
 	WARN_ON(!dl_rq->dl_nr_running);
 	dl_rq->dl_nr_running--;
-	sub_nr_running(rq_of_dl_rq(dl_rq), 1);
-
 	dec_dl_deadline(dl_rq, dl_se->deadline);
+
+	if (dl_server(dl_se))
+		return;
+
+	WARN_ON(!dl_prio(dl_task_of(dl_se)->prio));
+	sub_nr_running(rq_of_dl_rq(dl_rq), 1);
 	dec_dl_migration(dl_se, dl_rq);
 }
 
@@ -1641,7 +1846,8 @@ enqueue_dl_entity(struct sched_dl_entity *dl_se, int flags)
 {
 	WARN_ON_ONCE(on_dl_rq(dl_se));
 
-	update_stats_enqueue_dl(dl_rq_of_se(dl_se), dl_se, flags);
+	if (!dl_server(dl_se))
+		update_stats_enqueue_dl(dl_rq_of_se(dl_se), dl_se, flags);
 
 	/*
 	 * If this is a wakeup or a new instance, the scheduling
@@ -1649,7 +1855,8 @@ enqueue_dl_entity(struct sched_dl_entity *dl_se, int flags)
 	 * we want a replenishment of its runtime.
 	 */
 	if (flags & ENQUEUE_WAKEUP) {
-		task_contending(dl_se, flags);
+		if (!dl_server(dl_se))
+			task_contending(dl_se, flags);
 		update_dl_entity(dl_se);
 	} else if (flags & ENQUEUE_REPLENISH) {
 		replenish_dl_entity(dl_se);
@@ -2012,29 +2219,55 @@ static struct sched_dl_entity *pick_next_dl_entity(struct dl_rq *dl_rq)
 	return __node_2_dle(left);
 }
 
+/*
+ * Core scheduling picks without committing to the pick, which servers cannot
+ * do, so only the -deadline tasks are considered here.
+ */
 static struct task_struct *pick_task_dl(struct rq *rq)
 {
 	struct sched_dl_entity *dl_se;
-	struct dl_rq *dl_rq = &rq->dl;
-	struct task_struct *p;
+	struct rb_node *node;
 
 	if (!sched_dl_runnable(rq))
 		return NULL;
 
-	dl_se = pick_next_dl_entity(dl_rq);
-	WARN_ON_ONCE(!dl_se);
-	p = dl_task_of(dl_se);
+	for (node = rb_first_cached(&rq->dl.root); node; node = rb_next(node)) {
+		dl_se = __node_2_dle(node);
+		if (!dl_server(dl_se))
+			return dl_task_of(dl_se);
+	}
 
-	return p;
+	return NULL;
 }
 
 static struct task_struct *pick_next_task_dl(struct rq *rq)
 {
+	struct sched_dl_entity *dl_se;
 	struct task_struct *p;
 
-	p = pick_task_dl(rq);
-	if (p)
-		set_next_task_dl(rq, p, true);
+again:
+	if (!sched_dl_runnable(rq))
+		return NULL;
+
+	dl_se = pick_next_dl_entity(&rq->dl);
+	WARN_ON_ONCE(!dl_se);
+
+	if (dl_server(dl_se)) {
+		/*
+		 * The server's pick makes the task current in its own class,
+		 * an empty server is stopped until work shows up again.
+		 */
+		p = dl_se->server_pick(dl_se);
+		if (!p) {
+			dl_server_stop(dl_se);
+			goto again;
+		}
+		p->dl_server = dl_se;
+		return p;
+	}
+
+	p = dl_task_of(dl_se);
+	set_next_task_dl(rq, p, true);
 
 	return p;
 }
@@ -2073,7 +2306,7 @@ static void task_tick_dl(struct rq *rq, struct task_struct *p, int queued)
 	 * be set and schedule() will start a new hrtick for the next task.
 	 */
 	if (hrtick_enabled_dl(rq) && queued && p->dl.runtime > 0 &&
-	    is_leftmost(p, &rq->dl))
+	    is_leftmost(&p->dl, &rq->dl))
 		start_hrtick_dl(rq, p);
 }
 
@@ -2553,6 +2786,13 @@ void dl_add_task_root_domain(struct task_struct *p)
 	struct rq *rq;
 	struct dl_bw *dl_b;
 
+	/*
+	 * Called for every task on root domain rebuilds; don't bother
+	 * locking the vast majority that are not deadline tasks.
+	 */
+	if (!dl_task(p))
+		return;
+
 	raw_spin_lock_irqsave(&p->pi_lock, rf.flags);
 	if (!dl_task(p)) {
 		raw_spin_unlock_irqrestore(&p->pi_lock, rf.flags);
@@ -2574,9 +2814,16 @@ void dl_add_task_root_domain(struct task_struct *p)
 void dl_clear_root_domain(struct root_domain *rd)
 {
 	unsigned long flags;
+	int i;
 
 	raw_spin_lock_irqsave(&rd->dl_bw.lock, flags);
 	rd->dl_bw.total_bw = 0;
+	/*
+	 * dl servers are not tasks, dl_add_task_root_domain() won't account
+	 * for their bandwidth.
+	 */
+	for_each_cpu(i, rd->span)
+		rd->dl_bw.total_bw += READ_ONCE(cpu_rq(i)->dl.server_bw);
 	raw_spin_unlock_irqrestore(&rd->dl_bw.lock, flags);
 }
 
@@ -0,0 +1,948 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF extensible scheduling class
+ *
+ * Tasks of policy SCHED_EXT are scheduled by a BPF program attached through
+ * the sched_ext_ops struct_ops. While no program is attached, they run in
+ * the fair class; attaching moves them over and detaching moves them back,
+ * so schedulers can be swapped at runtime.
+ *
+ * Runnable tasks live on dispatch queues (DSQs). Every CPU picks from its
+ * local DSQ only. The BPF scheduler places tasks on the local DSQ of the CPU
+ * they are enqueued on, on the global DSQ, or on DSQs it created; when a
+ * local DSQ runs dry, ops.dispatch() moves tasks to it with
+ * scx_bpf_consume().
+ *
+ * Consuming a task that is queued on another runqueue requires migrating
+ * it. The consumer takes the task off the shared DSQ and claims it through
+ * p->scx.holding_cpu before it grabs both runqueue locks; a dequeue racing
+ * on the source runqueue clears the claim so the consumer backs off.
+ *
+ * A scheduler that leaves a task runnable but not running for
+ * SCX_WATCHDOG_TIMEOUT is considered stalled and is disabled, which sends
+ * its tasks back to the fair class.
+ */
+#include <linux/sched/ext.h>
+#include <linux/bpf_verifier.h>
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+
+static DEFINE_MUTEX(scx_ops_enable_mutex);
+DEFINE_STATIC_KEY_FALSE(__scx_ops_enabled);
+enum scx_ops_enable_state scx_ops_state = SCX_OPS_DISABLED;
+
+/* BPF callbacks may only be invoked while this is set */
+static bool scx_ops_live;
+static struct sched_ext_ops scx_ops;
+/* the table passed to scx_ops_enable(), scx_ops is a copy of it */
+static struct sched_ext_ops *scx_ops_attached;
+
+static void scx_watchdog_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(scx_watchdog_work, scx_watchdog_workfn);
+static void scx_ops_disable_workfn(struct work_struct *work);
+static DECLARE_WORK(scx_ops_disable_work, scx_ops_disable_workfn);
+
+static struct scx_dispatch_q scx_dsq_global;
+static DEFINE_XARRAY_FLAGS(scx_dsqs, XA_FLAGS_LOCK_IRQ);
+
+/* task whose ops.enqueue() is running, it may be scx_bpf_dispatch()'ed */
+static DEFINE_PER_CPU(struct task_struct *, scx_enq_task);
+
+/* runqueue whose ops.dispatch() is running, see scx_bpf_consume() */
+struct scx_dsp_ctx {
+	struct rq		*rq;
+	struct rq_flags		*rf;
+};
+static DEFINE_PER_CPU(struct scx_dsp_ctx, scx_dsp_ctx);
+
+static DEFINE_PER_CPU(cpumask_var_t, scx_kick_cpus);
+static DEFINE_PER_CPU(struct irq_work, scx_kick_irq_work);
+
+static inline bool scx_ops_is_live(void)
+{
+	return READ_ONCE(scx_ops_live);
+}
+
+static void init_dsq(struct scx_dispatch_q *dsq, u64 dsq_id)
+{
+	raw_spin_lock_init(&dsq->lock);
+	INIT_LIST_HEAD(&dsq->list);
+	dsq->nr = 0;
+	dsq->id = dsq_id;
+}
+
+static struct scx_dispatch_q *find_user_dsq(u64 dsq_id)
+{
+	if (dsq_id > U32_MAX)
+		return NULL;
+
+	return xa_load(&scx_dsqs, dsq_id);
+}
+
+static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
+			     u64 enq_flags)
+{
+	raw_spin_lock(&dsq->lock);
+	if (enq_flags & SCX_ENQ_HEAD)
+		list_add(&p->scx.dsq_node, &dsq->list);
+	else
+		list_add_tail(&p->scx.dsq_node, &dsq->list);
+	dsq->nr++;
+	smp_store_release(&p->scx.dsq, dsq);
+	raw_spin_unlock(&dsq->lock);
+}
+
+/*
+ * Take @p off whatever DSQ it is on. If a consumer on another CPU already
+ * pulled it off a shared DSQ, revoke its claim instead.
+ */
+static void dispatch_dequeue(struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq;
+
+again:
+	dsq = smp_load_acquire(&p->scx.dsq);
+	if (!dsq) {
+		WRITE_ONCE(p->scx.holding_cpu, -1);
+		return;
+	}
+
+	raw_spin_lock(&dsq->lock);
+	if (unlikely(p->scx.dsq != dsq)) {
+		/* consumed or moved by scx_bpf_destroy_dsq() meanwhile */
+		raw_spin_unlock(&dsq->lock);
+		goto again;
+	}
+	list_del_init(&p->scx.dsq_node);
+	dsq->nr--;
+	p->scx.dsq = NULL;
+	raw_spin_unlock(&dsq->lock);
+}
+
+static bool scx_cpu_allowed(struct task_struct *p, int cpu)
+{
+	return cpumask_test_cpu(cpu, p->cpus_ptr) &&
+	       !is_migration_disabled(p) && cpu_active(cpu);
+}
+
+/*
+ * Move @p, claimed off a shared DSQ, from @src_rq to the local DSQ of @rq.
+ * Both locks are needed for the migration, so @rq->lock may be dropped.
+ */
+static bool consume_remote_task(struct rq *rq, struct rq_flags *rf,
+				struct task_struct *p, struct rq *src_rq)
+{
+	int cpu = cpu_of(rq);
+	bool moved = false;
+
+	rq_unpin_lock(rq, rf);
+	double_lock_balance(rq, src_rq);
+
+	if (likely(READ_ONCE(p->scx.holding_cpu) == cpu &&
+		   task_rq(p) == src_rq && task_on_rq_queued(p) &&
+		   !task_on_cpu(src_rq, p))) {
+		p->scx.holding_cpu = -1;
+		if (scx_cpu_allowed(p, cpu)) {
+			deactivate_task(src_rq, p, 0);
+			set_task_cpu(p, cpu);
+			p->scx.flags |= SCX_TASK_ENQ_LOCAL;
+			activate_task(rq, p, 0);
+			moved = true;
+		} else {
+			/* affinity changed under us, run it where it is */
+			dispatch_enqueue(&src_rq->scx.local_dsq, p, 0);
+			resched_curr(src_rq);
+		}
+	}
+
+	double_unlock_balance(rq, src_rq);
+	rq_repin_lock(rq, rf);
+	return moved;
+}
+
+/*
+ * Claim @p off the shared @dsq, whose lock is held and released here, and
+ * move it to the local DSQ of @rq.
+ */
+static bool consume_task(struct rq *rq, struct rq_flags *rf,
+			 struct scx_dispatch_q *dsq, struct task_struct *p)
+{
+	struct rq *src_rq = task_rq(p);
+
+	lockdep_assert(raw_spin_is_locked(&dsq->lock));
+
+	list_del_init(&p->scx.dsq_node);
+	dsq->nr--;
+	WRITE_ONCE(p->scx.holding_cpu, cpu_of(rq));
+	smp_store_release(&p->scx.dsq, NULL);
+	raw_spin_unlock(&dsq->lock);
+
+	if (src_rq == rq) {
+		p->scx.holding_cpu = -1;
+		dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+		return true;
+	}
+
+	return consume_remote_task(rq, rf, p, src_rq);
+}
+
+static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
+			       struct scx_dispatch_q *dsq)
+{
+	int cpu = cpu_of(rq);
+	struct task_struct *p;
+
+	if (list_empty(&dsq->list))
+		return false;
+
+	raw_spin_lock(&dsq->lock);
+	list_for_each_entry(p, &dsq->list, scx.dsq_node) {
+		if (cpumask_test_cpu(cpu, p->cpus_ptr))
+			return consume_task(rq, rf, dsq, p);
+	}
+	raw_spin_unlock(&dsq->lock);
+
+	return false;
+}
+
+static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags)
+{
+	if (p->scx.flags & SCX_TASK_ENQ_LOCAL) {
+		p->scx.flags &= ~SCX_TASK_ENQ_LOCAL;
+		dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+		return;
+	}
+
+	/* no scheduler, or it is going away: plain FIFO on this CPU */
+	if (!scx_ops_is_live()) {
+		if (!p->scx.slice)
+			p->scx.slice = SCX_SLICE_DFL;
+		dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+		return;
+	}
+
+	__this_cpu_write(scx_enq_task, p);
+	scx_ops.enqueue(p, enq_flags);
+
+	/* not dispatched by the BPF scheduler, don't lose it */
+	if (unlikely(__this_cpu_read(scx_enq_task) == p)) {
+		__this_cpu_write(scx_enq_task, NULL);
+		p->scx.slice = SCX_SLICE_DFL;
+		dispatch_enqueue(&scx_dsq_global, p, 0);
+	}
+}
+
+static void set_task_runnable(struct rq *rq, struct task_struct *p)
+{
+	p->scx.runnable_at = jiffies;
+	list_add_tail(&p->scx.runnable_node, &rq->scx.runnable_list);
+}
+
+static void clr_task_runnable(struct task_struct *p)
+{
+	list_del_init(&p->scx.runnable_node);
+}
+
+static void enqueue_task_scx(struct rq *rq, struct task_struct *p, int enq_flags)
+{
+	if (WARN_ON_ONCE(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	set_task_runnable(rq, p);
+	p->scx.flags |= SCX_TASK_QUEUED;
+	rq->scx.nr_running++;
+	add_nr_running(rq, 1);
+
+	do_enqueue_task(rq, p, enq_flags);
+}
+
+static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int deq_flags)
+{
+	if (!(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	if (scx_ops_is_live() && scx_ops.dequeue)
+		scx_ops.dequeue(p, deq_flags);
+
+	dispatch_dequeue(p);
+	clr_task_runnable(p);
+
+	p->scx.flags &= ~SCX_TASK_QUEUED;
+	rq->scx.nr_running--;
+	sub_nr_running(rq, 1);
+}
+
+static void update_curr_scx(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	u64 delta_exec;
+	u64 now;
+
+	if (curr->sched_class != &ext_sched_class)
+		return;
+
+	now = rq_clock_task(rq);
+	delta_exec = now - curr->se.exec_start;
+	if (unlikely((s64)delta_exec <= 0))
+		return;
+
+	update_current_exec_runtime(curr, now, delta_exec);
+	curr->scx.slice -= min(curr->scx.slice, delta_exec);
+}
+
+static void yield_task_scx(struct rq *rq)
+{
+	rq->curr->scx.slice = 0;
+}
+
+static void check_preempt_curr_scx(struct rq *rq, struct task_struct *p, int wake_flags)
+{
+	/* tasks within the class only yield the CPU when their slice ends */
+}
+
+static int balance_scx(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
+{
+	struct scx_dsp_ctx *dspc = this_cpu_ptr(&scx_dsp_ctx);
+	struct task_struct *dsp_prev = NULL;
+
+	if (!list_empty(&rq->scx.local_dsq.list))
+		return 1;
+
+	if (prev->sched_class == &ext_sched_class) {
+		if ((prev->scx.flags & SCX_TASK_QUEUED) && prev->scx.slice)
+			return 1;
+		dsp_prev = prev;
+	}
+
+	if (scx_ops_is_live() && scx_ops.dispatch) {
+		dspc->rq = rq;
+		dspc->rf = rf;
+		scx_ops.dispatch(cpu_of(rq), dsp_prev);
+		dspc->rq = NULL;
+		dspc->rf = NULL;
+	}
+
+	if (list_empty(&rq->scx.local_dsq.list))
+		consume_dispatch_q(rq, rf, &scx_dsq_global);
+
+	return !list_empty(&rq->scx.local_dsq.list) ||
+	       (dsp_prev && (dsp_prev->scx.flags & SCX_TASK_QUEUED) &&
+		dsp_prev->scx.slice);
+}
+
+static void set_next_task_scx(struct rq *rq, struct task_struct *p, bool first)
+{
+	/* the running task is not on any DSQ */
+	if (p->scx.dsq)
+		dispatch_dequeue(p);
+	clr_task_runnable(p);
+
+	p->se.exec_start = rq_clock_task(rq);
+}
+
+static void put_prev_task_scx(struct rq *rq, struct task_struct *p)
+{
+	update_curr_scx(rq);
+
+	if (!(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	set_task_runnable(rq, p);
+
+	/* preempted by a higher class, keep its place */
+	if (p->scx.slice)
+		dispatch_enqueue(&rq->scx.local_dsq, p, SCX_ENQ_HEAD);
+	else
+		do_enqueue_task(rq, p, 0);
+}
+
+static struct task_struct *pick_task_scx(struct rq *rq)
+{
+	return list_first_entry_or_null(&rq->scx.local_dsq.list,
+					struct task_struct, scx.dsq_node);
+}
+
+static struct task_struct *pick_next_task_scx(struct rq *rq)
+{
+	struct task_struct *p = pick_task_scx(rq);
+
+	if (p)
+		set_next_task_scx(rq, p, true);
+
+	return p;
+}
+
+static int select_task_rq_scx(struct task_struct *p, int prev_cpu, int wake_flags)
+{
+	if (scx_ops_is_live() && scx_ops.select_cpu) {
+		s32 cpu = scx_ops.select_cpu(p, prev_cpu, wake_flags);
+
+		if ((u32)cpu < nr_cpu_ids)
+			return cpu;
+	}
+
+	return prev_cpu;
+}
+
+static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
+{
+	update_curr_scx(rq);
+
+	if (!curr->scx.slice)
+		resched_curr(rq);
+}
+
+static void switched_to_scx(struct rq *rq, struct task_struct *p)
+{
+	if (task_on_rq_queued(p) && !task_current(rq, p))
+		check_preempt_curr(rq, p, 0);
+}
+
+static void prio_changed_scx(struct rq *rq, struct task_struct *p, int oldprio)
+{
+}
+
+/*
+ * Not placed with DEFINE_SCHED_CLASS(): the linker script orders only the
+ * built-in classes, and next_sched_class() and sched_class_above() slot
+ * this one in between fair and idle.
+ */
+const struct sched_class ext_sched_class
+	__aligned(__alignof__(struct sched_class)) = {
+	.enqueue_task		= enqueue_task_scx,
+	.dequeue_task		= dequeue_task_scx,
+	.yield_task		= yield_task_scx,
+
+	.check_preempt_curr	= check_preempt_curr_scx,
+
+	.pick_next_task		= pick_next_task_scx,
+	.put_prev_task		= put_prev_task_scx,
+	.set_next_task		= set_next_task_scx,
+
+	.balance		= balance_scx,
+	.pick_task		= pick_task_scx,
+	.select_task_rq		= select_task_rq_scx,
+	.set_cpus_allowed	= set_cpus_allowed_common,
+
+	.task_tick		= task_tick_scx,
+
+	.switched_to		= switched_to_scx,
+	.prio_changed		= prio_changed_scx,
+
+	.update_curr		= update_curr_scx,
+};
+
+static void scx_kick_workfn(struct irq_work *irq_work)
+{
+	struct cpumask *kick = this_cpu_cpumask_var_ptr(scx_kick_cpus);
+	int cpu;
+
+	for_each_cpu(cpu, kick) {
+		if (cpumask_test_and_clear_cpu(cpu, kick))
+			resched_cpu(cpu);
+	}
+}
+
+/* Move every SCHED_EXT task to the class the current state calls for. */
+static void scx_reclass_tasks(void)
+{
+	struct task_struct *g, *p;
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p->policy == SCHED_EXT)
+			sched_ext_reclass_task(p);
+	}
+	read_unlock(&tasklist_lock);
+}
+
+/* The runnable list is in runnable_at order, only the oldest task matters. */
+static bool check_rq_for_timeouts(struct rq *rq)
+{
+	struct task_struct *p;
+	struct rq_flags rf;
+	bool timed_out = false;
+
+	rq_lock_irqsave(rq, &rf);
+	p = list_first_entry_or_null(&rq->scx.runnable_list, struct task_struct,
+				     scx.runnable_node);
+	if (p && unlikely(time_after(jiffies,
+				     p->scx.runnable_at + SCX_WATCHDOG_TIMEOUT))) {
+		pr_err("sched_ext: %s: %s[%d] stalled for %ums on CPU %d, disabling\n",
+		       scx_ops.name, p->comm, p->pid,
+		       jiffies_to_msecs(jiffies - p->scx.runnable_at),
+		       cpu_of(rq));
+		timed_out = true;
+	}
+	rq_unlock_irqrestore(rq, &rf);
+
+	return timed_out;
+}
+
+static void scx_watchdog_workfn(struct work_struct *work)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (check_rq_for_timeouts(cpu_rq(cpu))) {
+			queue_work(system_unbound_wq, &scx_ops_disable_work);
+			return;
+		}
+		cond_resched();
+	}
+
+	queue_delayed_work(system_unbound_wq, to_delayed_work(work),
+			   SCX_WATCHDOG_TIMEOUT / 2);
+}
+
+static void scx_destroy_all_dsqs(void)
+{
+	struct scx_dispatch_q *dsq;
+	unsigned long idx;
+
+	xa_for_each(&scx_dsqs, idx, dsq) {
+		xa_erase_irq(&scx_dsqs, idx);
+		WARN_ON_ONCE(dsq->nr);
+		kfree_rcu(dsq, rcu);
+	}
+}
+
+static int scx_ops_enable(struct sched_ext_ops *ops)
+{
+	int ret = 0;
+
+	if (!ops->enqueue)
+		return -EINVAL;
+
+	mutex_lock(&scx_ops_enable_mutex);
+
+	if (scx_ops_state != SCX_OPS_DISABLED) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	scx_ops = *ops;
+
+	if (scx_ops.init) {
+		ret = scx_ops.init();
+		if (ret) {
+			scx_destroy_all_dsqs();
+			memset(&scx_ops, 0, sizeof(scx_ops));
+			goto out_unlock;
+		}
+	}
+
+	scx_ops_attached = ops;
+	WRITE_ONCE(scx_ops_live, true);
+	WRITE_ONCE(scx_ops_state, SCX_OPS_ENABLED);
+	static_branch_enable(&__scx_ops_enabled);
+
+	scx_reclass_tasks();
+
+	queue_delayed_work(system_unbound_wq, &scx_watchdog_work,
+			   SCX_WATCHDOG_TIMEOUT / 2);
+
+out_unlock:
+	mutex_unlock(&scx_ops_enable_mutex);
+	return ret;
+}
+
+/* Disable @ops, or whatever is attached if NULL. */
+static void scx_ops_disable(struct sched_ext_ops *ops)
+{
+	mutex_lock(&scx_ops_enable_mutex);
+
+	if (scx_ops_state != SCX_OPS_ENABLED)
+		goto out_unlock;
+	/* already disabled by the watchdog and replaced since */
+	if (ops && ops != scx_ops_attached)
+		goto out_unlock;
+
+	/*
+	 * Stop calling into BPF. Callbacks run with IRQs disabled under a
+	 * runqueue or pi lock, so a grace period flushes the ones in flight.
+	 * Tasks still in the class are scheduled FIFO until moved back.
+	 */
+	WRITE_ONCE(scx_ops_live, false);
+	synchronize_rcu();
+	cancel_delayed_work_sync(&scx_watchdog_work);
+
+	/*
+	 * Send the tasks back to fair before the class drops out of
+	 * for_each_class(), pick_next_task() would not see them otherwise.
+	 */
+	WRITE_ONCE(scx_ops_state, SCX_OPS_DISABLING);
+	scx_reclass_tasks();
+	static_branch_disable(&__scx_ops_enabled);
+
+	if (scx_ops.exit)
+		scx_ops.exit();
+
+	scx_destroy_all_dsqs();
+
+	memset(&scx_ops, 0, sizeof(scx_ops));
+	scx_ops_attached = NULL;
+	WRITE_ONCE(scx_ops_state, SCX_OPS_DISABLED);
+
+out_unlock:
+	mutex_unlock(&scx_ops_enable_mutex);
+}
+
+static void scx_ops_disable_workfn(struct work_struct *work)
+{
+	scx_ops_disable(NULL);
+}
+
+__diag_push();
+__diag_ignore_all("-Wmissing-prototypes",
+		  "Global functions as their definitions will be in vmlinux BTF");
+
+/**
+ * scx_bpf_create_dsq - Create a dispatch queue
+ * @dsq_id: ID of the new DSQ, at most U32_MAX
+ * @node: NUMA node to allocate it on, or NUMA_NO_NODE
+ */
+s32 scx_bpf_create_dsq(u64 dsq_id, s32 node)
+{
+	struct scx_dispatch_q *dsq;
+	unsigned long flags;
+	int ret;
+
+	if (dsq_id > U32_MAX)
+		return -EINVAL;
+	if (node != NUMA_NO_NODE && (node < 0 || node >= nr_node_ids))
+		return -EINVAL;
+
+	dsq = kmalloc_node(sizeof(*dsq), GFP_ATOMIC, node);
+	if (!dsq)
+		return -ENOMEM;
+	init_dsq(dsq, dsq_id);
+
+	xa_lock_irqsave(&scx_dsqs, flags);
+	ret = __xa_insert(&scx_dsqs, dsq_id, dsq, GFP_ATOMIC);
+	xa_unlock_irqrestore(&scx_dsqs, flags);
+
+	if (ret) {
+		kfree(dsq);
+		return ret == -EBUSY ? -EEXIST : ret;
+	}
+
+	return 0;
+}
+
+/**
+ * scx_bpf_destroy_dsq - Destroy a dispatch queue
+ * @dsq_id: DSQ to destroy
+ *
+ * Tasks still queued on it are moved to the global DSQ.
+ */
+void scx_bpf_destroy_dsq(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+	struct task_struct *p;
+	unsigned long flags;
+
+	if (dsq_id > U32_MAX)
+		return;
+
+	xa_lock_irqsave(&scx_dsqs, flags);
+	dsq = __xa_erase(&scx_dsqs, dsq_id);
+	xa_unlock_irqrestore(&scx_dsqs, flags);
+	if (!dsq)
+		return;
+
+	raw_spin_lock_irqsave(&dsq->lock, flags);
+	while ((p = list_first_entry_or_null(&dsq->list, struct task_struct,
+					     scx.dsq_node))) {
+		list_del_init(&p->scx.dsq_node);
+		dsq->nr--;
+
+		raw_spin_lock_nested(&scx_dsq_global.lock, SINGLE_DEPTH_NESTING);
+		list_add_tail(&p->scx.dsq_node, &scx_dsq_global.list);
+		scx_dsq_global.nr++;
+		smp_store_release(&p->scx.dsq, &scx_dsq_global);
+		raw_spin_unlock(&scx_dsq_global.lock);
+	}
+	raw_spin_unlock_irqrestore(&dsq->lock, flags);
+
+	kfree_rcu(dsq, rcu);
+}
+
+/* scx_bpf_dispatch() from ops.dispatch() */
+static void dispatch_to_local(struct scx_dsp_ctx *dspc, struct task_struct *p,
+			      u64 dsq_id, u64 slice)
+{
+	struct scx_dispatch_q *dsq;
+
+	if (unlikely(dsq_id != SCX_DSQ_LOCAL)) {
+		pr_warn_ratelimited("sched_ext: %s: ops.dispatch() can only dispatch to SCX_DSQ_LOCAL\n",
+				    scx_ops.name);
+		return;
+	}
+
+	dsq = smp_load_acquire(&p->scx.dsq);
+	if (!dsq || dsq->id == SCX_DSQ_LOCAL)
+		return;
+
+	raw_spin_lock(&dsq->lock);
+	/* consumed or dequeued meanwhile, or not allowed on this CPU */
+	if (unlikely(p->scx.dsq != dsq ||
+		     !cpumask_test_cpu(cpu_of(dspc->rq), p->cpus_ptr))) {
+		raw_spin_unlock(&dsq->lock);
+		return;
+	}
+	p->scx.slice = slice ?: SCX_SLICE_DFL;
+	consume_task(dspc->rq, dspc->rf, dsq, p);
+}
+
+/**
+ * scx_bpf_dispatch - Place a task on a dispatch queue
+ * @p: task being enqueued
+ * @dsq_id: SCX_DSQ_LOCAL, SCX_DSQ_GLOBAL or a DSQ created by the scheduler
+ * @slice: time slice in nsecs, 0 for SCX_SLICE_DFL
+ * @enq_flags: SCX_ENQ_*
+ *
+ * From ops.enqueue() of @p, SCX_DSQ_LOCAL is the local DSQ of the CPU @p is
+ * being enqueued on. From ops.dispatch(), @p must be waiting on a shared DSQ
+ * and can only be dispatched to SCX_DSQ_LOCAL, the local DSQ of the
+ * dispatching CPU; this is how a scheduler picks a specific task rather than
+ * the first one scx_bpf_consume() would find.
+ */
+void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+				  u64 enq_flags)
+{
+	struct scx_dsp_ctx *dspc = this_cpu_ptr(&scx_dsp_ctx);
+	struct scx_dispatch_q *dsq;
+
+	if (dspc->rq && __this_cpu_read(scx_enq_task) != p) {
+		dispatch_to_local(dspc, p, dsq_id, slice);
+		return;
+	}
+
+	if (unlikely(__this_cpu_read(scx_enq_task) != p)) {
+		pr_warn_ratelimited("sched_ext: %s: %s[%d] dispatched outside of its ops.enqueue()\n",
+				    scx_ops.name, p->comm, p->pid);
+		return;
+	}
+	__this_cpu_write(scx_enq_task, NULL);
+
+	p->scx.slice = slice ?: SCX_SLICE_DFL;
+
+	if (dsq_id == SCX_DSQ_LOCAL) {
+		dsq = &task_rq(p)->scx.local_dsq;
+	} else if (dsq_id == SCX_DSQ_GLOBAL) {
+		dsq = &scx_dsq_global;
+	} else {
+		dsq = find_user_dsq(dsq_id);
+		if (unlikely(!dsq)) {
+			pr_warn_ratelimited("sched_ext: %s: unknown DSQ 0x%llx\n",
+					    scx_ops.name, dsq_id);
+			dsq = &scx_dsq_global;
+		}
+	}
+
+	dispatch_enqueue(dsq, p, enq_flags & SCX_ENQ_HEAD);
+}
+
+/**
+ * scx_bpf_consume - Move a task from a dispatch queue to the local one
+ * @dsq_id: SCX_DSQ_GLOBAL or a DSQ created by the scheduler
+ *
+ * Only valid from ops.dispatch(). Moves the first task of @dsq_id that may
+ * run on the dispatching CPU and returns whether one was found.
+ */
+bool scx_bpf_consume(u64 dsq_id)
+{
+	struct scx_dsp_ctx *dspc = this_cpu_ptr(&scx_dsp_ctx);
+	struct scx_dispatch_q *dsq;
+
+	if (unlikely(!dspc->rq)) {
+		pr_warn_ratelimited("sched_ext: %s: consume outside of ops.dispatch()\n",
+				    scx_ops.name);
+		return false;
+	}
+
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		dsq = &scx_dsq_global;
+	else
+		dsq = find_user_dsq(dsq_id);
+	if (unlikely(!dsq))
+		return false;
+
+	return consume_dispatch_q(dspc->rq, dspc->rf, dsq);
+}
+
+/**
+ * scx_bpf_dsq_nr_queued - Number of tasks on a dispatch queue
+ * @dsq_id: DSQ to look at, SCX_DSQ_LOCAL being the current CPU's
+ */
+s32 scx_bpf_dsq_nr_queued(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+
+	if (dsq_id == SCX_DSQ_LOCAL)
+		return READ_ONCE(this_rq()->scx.local_dsq.nr);
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		return READ_ONCE(scx_dsq_global.nr);
+
+	dsq = find_user_dsq(dsq_id);
+	if (!dsq)
+		return -ENOENT;
+
+	return READ_ONCE(dsq->nr);
+}
+
+/**
+ * scx_bpf_kick_cpu - Make a CPU go through the scheduler
+ * @cpu: CPU to kick
+ *
+ * Typically used on an idle CPU after putting work on a shared DSQ.
+ */
+void scx_bpf_kick_cpu(s32 cpu)
+{
+	if ((u32)cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return;
+
+	preempt_disable();
+	cpumask_set_cpu(cpu, this_cpu_cpumask_var_ptr(scx_kick_cpus));
+	irq_work_queue(this_cpu_ptr(&scx_kick_irq_work));
+	preempt_enable();
+}
+
+__diag_pop();
+
+BTF_SET8_START(scx_kfunc_ids)
+BTF_ID_FLAGS(func, scx_bpf_create_dsq)
+BTF_ID_FLAGS(func, scx_bpf_destroy_dsq)
+BTF_ID_FLAGS(func, scx_bpf_dispatch, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_consume)
+BTF_ID_FLAGS(func, scx_bpf_dsq_nr_queued)
+BTF_ID_FLAGS(func, scx_bpf_kick_cpu)
+BTF_SET8_END(scx_kfunc_ids)
+
+/* "extern" is to avoid sparse warning.  It is only used in bpf_struct_ops.c. */
+extern struct bpf_struct_ops bpf_sched_ext_ops;
+
+/* the kfuncs only make sense from the callbacks of a sched_ext_ops */
+static int scx_kfunc_filter(const struct bpf_prog *prog, u32 kfunc_id)
+{
+	if (!btf_id_set8_contains(&scx_kfunc_ids, kfunc_id))
+		return 0;
+
+	return prog->aux->attach_btf_id == bpf_sched_ext_ops.type_id ?
+		0 : -EACCES;
+}
+
+static const struct btf_kfunc_id_set scx_kfunc_set = {
+	.owner  = THIS_MODULE,
+	.set    = &scx_kfunc_ids,
+	.filter = scx_kfunc_filter,
+};
+
+static bool bpf_scx_is_valid_access(int off, int size,
+				    enum bpf_access_type type,
+				    const struct bpf_prog *prog,
+				    struct bpf_insn_access_aux *info)
+{
+	return bpf_tracing_btf_ctx_access(off, size, type, prog, info);
+}
+
+static int bpf_scx_btf_struct_access(struct bpf_verifier_log *log,
+				     const struct bpf_reg_state *reg,
+				     int off, int size, enum bpf_access_type atype,
+				     u32 *next_btf_id, enum bpf_type_flag *flag)
+{
+	if (atype == BPF_READ)
+		return btf_struct_access(log, reg, off, size, atype, next_btf_id, flag);
+
+	bpf_log(log, "only read is supported\n");
+	return -EACCES;
+}
+
+static const struct bpf_func_proto *
+bpf_scx_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	return bpf_base_func_proto(func_id);
+}
+
+static const struct bpf_verifier_ops bpf_scx_verifier_ops = {
+	.get_func_proto		= bpf_scx_get_func_proto,
+	.is_valid_access	= bpf_scx_is_valid_access,
+	.btf_struct_access	= bpf_scx_btf_struct_access,
+};
+
+static int bpf_scx_init_member(const struct btf_type *t,
+			       const struct btf_member *member,
+			       void *kdata, const void *udata)
+{
+	const struct sched_ext_ops *uops = udata;
+	struct sched_ext_ops *ops = kdata;
+	u32 moff = __btf_member_bit_offset(t, member) / 8;
+
+	switch (moff) {
+	case offsetof(struct sched_ext_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bpf_scx_check_member(const struct btf_type *t,
+				const struct btf_member *member)
+{
+	return 0;
+}
+
+static int bpf_scx_init(struct btf *btf)
+{
+	return 0;
+}
+
+static int bpf_scx_reg(void *kdata)
+{
+	return scx_ops_enable(kdata);
+}
+
+static void bpf_scx_unreg(void *kdata)
+{
+	scx_ops_disable(kdata);
+	/* a watchdog disable still in flight must not hit the next scheduler */
+	cancel_work_sync(&scx_ops_disable_work);
+}
+
+struct bpf_struct_ops bpf_sched_ext_ops = {
+	.verifier_ops = &bpf_scx_verifier_ops,
+	.reg = bpf_scx_reg,
+	.unreg = bpf_scx_unreg,
+	.check_member = bpf_scx_check_member,
+	.init_member = bpf_scx_init_member,
+	.init = bpf_scx_init,
+	.name = "sched_ext_ops",
+};
+
+void __init init_sched_ext_class(void)
+{
+	int cpu;
+
+	init_dsq(&scx_dsq_global, SCX_DSQ_GLOBAL);
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		init_dsq(&rq->scx.local_dsq, SCX_DSQ_LOCAL);
+		INIT_LIST_HEAD(&rq->scx.runnable_list);
+		BUG_ON(!zalloc_cpumask_var_node(&per_cpu(scx_kick_cpus, cpu),
+						GFP_KERNEL, cpu_to_node(cpu)));
+		init_irq_work(&per_cpu(scx_kick_irq_work, cpu), scx_kick_workfn);
+	}
+}
+
+static int __init scx_kfunc_init(void)
+{
+	return register_btf_kfunc_id_set(BPF_PROG_TYPE_STRUCT_OPS, &scx_kfunc_set);
+}
+late_initcall(scx_kfunc_init);
@@ -929,6 +929,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cgroup_account_cputime(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+		if (curtask->dl_server)
+			dl_server_update(curtask->dl_server, delta_exec);
 	}
 
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
@@ -1586,7 +1588,8 @@ bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 		if (pgdat_free_space_enough(pgdat)) {
 			/* workload changed, reset hot threshold */
 			pgdat->nbp_threshold = 0;
-			return true;
+			return !node_promotion_rate_limited(src_nid,
+							    thp_nr_pages(page));
 		}
 
 		def_th = sysctl_numa_balancing_hot_threshold;
@@ -1599,6 +1602,10 @@ bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 		if (latency >= th)
 			return false;
 
+		/* the tier promoted from may cap its own bandwidth */
+		if (node_promotion_rate_limited(src_nid, thp_nr_pages(page)))
+			return false;
+
 		return !numa_promotion_rate_limit(pgdat, rate_limit,
 						  thp_nr_pages(page));
 	}
@@ -4886,6 +4893,16 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 		update_idle_cfs_rq_clock_pelt(cfs_rq);
 }
 
+/*
+ * The latency_nice of an entity shifts where it stands against others when
+ * deciding on preemption, by up to half a scheduling period either way. It
+ * does not change the entity's vruntime, hence its share of the CPU.
+ */
+static inline s64 se_latency_offset(struct sched_entity *se)
+{
+	return (s64)se->latency_nice * sysctl_sched_latency / LATENCY_NICE_WIDTH;
+}
+
 /*
  * Preempt the current task with a newly woken task if needed:
  */
@@ -4919,6 +4936,12 @@ check_preempt_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 	se = __pick_first_entity(cfs_rq);
 	delta = curr->vruntime - se->vruntime;
 
+	/*
+	 * A latency sensitive leftmost entity only waits for curr to get
+	 * ahead by less than a full slice before it gets the CPU.
+	 */
+	delta += se_latency_offset(curr) - se_latency_offset(se);
+
 	if (delta < 0)
 		return;
 
@@ -6047,6 +6070,22 @@ static int sched_idle_cpu(int cpu)
 }
 #endif
 
+#ifdef CONFIG_CFS_DL_SERVER
+/*
+ * A group with a reservation gets its server started by the first task to
+ * show up, servers that ran out of tasks are stopped lazily when picked.
+ */
+static inline void cfs_rq_dl_server_start(struct cfs_rq *cfs_rq)
+{
+	struct sched_dl_entity *dl_se = &cfs_rq->dl_server;
+
+	if (dl_se->dl_runtime && !dl_se->dl_server_active)
+		dl_server_start(dl_se);
+}
+#else
+static inline void cfs_rq_dl_server_start(struct cfs_rq *cfs_rq) { }
+#endif
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -6092,6 +6131,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		if (cfs_rq_throttled(cfs_rq))
 			goto enqueue_throttle;
 
+		cfs_rq_dl_server_start(cfs_rq);
+
 		flags = ENQUEUE_WAKEUP;
 	}
 
@@ -6111,6 +6152,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		/* end evaluation on encountering a throttled cfs_rq */
 		if (cfs_rq_throttled(cfs_rq))
 			goto enqueue_throttle;
+
+		cfs_rq_dl_server_start(cfs_rq);
 	}
 
 	/* At this point se is NULL and we are at root level*/
@@ -6828,6 +6871,57 @@ select_idle_capacity(struct task_struct *p, struct sched_domain *sd, int target)
 	return best_cpu;
 }
 
+/*
+ * The LLC of @target has no idle CPU. On packages made of several LLCs an
+ * idle CPU behind a neighbouring cache is still preferable to stacking on a
+ * busy one, so walk the domains above the LLC, nearest first, without
+ * crossing into another NUMA node. Each sibling LLC gets a scan bounded by
+ * its own SIS_UTIL budget and overloaded ones are skipped entirely.
+ */
+static int select_idle_near_llc(struct task_struct *p, struct sched_domain *llc, int target)
+{
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_rq_mask);
+	struct sched_domain *near, *sd;
+	int cpu, i;
+
+	near = rcu_dereference(per_cpu(sd_llc_near, target));
+	if (!near)
+		return -1;
+
+	for (sd = llc->parent; sd; sd = sd->parent) {
+		cpumask_andnot(cpus, sched_domain_span(sd), sched_domain_span(sd->child));
+		cpumask_and(cpus, cpus, p->cpus_ptr);
+
+		while ((cpu = cpumask_first(cpus)) < nr_cpu_ids) {
+			struct sched_domain *sd_cpu = rcu_dereference(per_cpu(sd_llc, cpu));
+			const struct cpumask *span = sd_cpu ? sched_domain_span(sd_cpu) : cpumask_of(cpu);
+			int nr = per_cpu(sd_llc_size, cpu);
+
+			if (sched_feat(SIS_UTIL)) {
+				struct sched_domain_shared *sds;
+
+				sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+				if (sds)
+					nr = READ_ONCE(sds->nr_idle_scan);
+			}
+
+			for_each_cpu_and(i, span, cpus) {
+				if (!nr--)
+					break;
+				if ((unsigned int)__select_idle_cpu(i, p) < nr_cpumask_bits)
+					return i;
+			}
+
+			cpumask_andnot(cpus, cpus, span);
+		}
+
+		if (sd == near)
+			break;
+	}
+
+	return -1;
+}
+
 static inline bool asym_fits_cpu(unsigned long util,
 				 unsigned long util_min,
 				 unsigned long util_max,
@@ -6865,6 +6959,21 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	 */
 	lockdep_assert_irqs_disabled();
 
+	/*
+	 * A latency sensitive task would rather have a whole core than the
+	 * idle sibling of a busy one, so when the LLC reports idle cores
+	 * look for one before settling for the cheap target/prev choices.
+	 */
+	if (p->se.latency_nice < 0 && sched_smt_active() &&
+	    !sched_asym_cpucap_active() && test_idle_cores(target)) {
+		sd = rcu_dereference(per_cpu(sd_llc, target));
+		if (sd) {
+			i = select_idle_cpu(p, sd, true, target);
+			if ((unsigned)i < nr_cpumask_bits)
+				return i;
+		}
+	}
+
 	if ((available_idle_cpu(target) || sched_idle_cpu(target)) &&
 	    asym_fits_cpu(task_util, util_min, util_max, target))
 		return target;
@@ -6943,6 +7052,18 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
+	/*
+	 * Only reach into a sibling LLC for wakees with a stable set of
+	 * partners; see wake_wide(). Their shared data is likely still close
+	 * by, whereas tasks waking many others gain nothing from the extra
+	 * scan and are left to the load balancer.
+	 */
+	if (sched_feat(SIS_NEAR_LLC) && !wake_wide(p)) {
+		i = select_idle_near_llc(p, sd, target);
+		if ((unsigned)i < nr_cpumask_bits)
+			return i;
+	}
+
 	return target;
 }
 
@@ -7528,6 +7649,7 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	vdiff += se_latency_offset(curr) - se_latency_offset(se);
 	if (vdiff <= 0)
 		return -1;
 
@@ -7801,6 +7923,8 @@ pick_next_task_fair(struct rq *rq, struct task_struct *prev, struct rq_flags *rf
 	p = task_of(se);
 
 done: __maybe_unused;
+	/* picked by CFS itself, not on behalf of a dl server */
+	p->dl_server = NULL;
 #ifdef CONFIG_SMP
 	/*
 	 * Move the next running task to the front of
@@ -7848,6 +7972,55 @@ static struct task_struct *__pick_next_task_fair(struct rq *rq)
 	return pick_next_task_fair(rq, NULL, NULL);
 }
 
+#ifdef CONFIG_CFS_DL_SERVER
+static bool cfs_server_has_tasks(struct sched_dl_entity *dl_se)
+{
+	struct cfs_rq *cfs_rq = container_of(dl_se, struct cfs_rq, dl_server);
+
+	return cfs_rq->h_nr_running && !throttled_hierarchy(cfs_rq);
+}
+
+/*
+ * Pick the task of the group that CFS would run next. The previous task has
+ * been put already, so this is the simple path of pick_next_task_fair(),
+ * extended upwards: the group entity and its ancestors become current in
+ * their cfs_rqs too, as if CFS had picked its way down to the group.
+ */
+static struct task_struct *cfs_server_pick(struct sched_dl_entity *dl_se)
+{
+	struct cfs_rq *cfs_rq = container_of(dl_se, struct cfs_rq, dl_server);
+	struct rq *rq = rq_of(cfs_rq);
+	struct sched_entity *se;
+	struct task_struct *p;
+
+	if (!cfs_server_has_tasks(dl_se))
+		return NULL;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+	for_each_sched_entity(se)
+		set_next_entity(cfs_rq_of(se), se);
+
+	do {
+		se = pick_next_entity(cfs_rq, NULL);
+		set_next_entity(cfs_rq, se);
+		cfs_rq = group_cfs_rq(se);
+	} while (cfs_rq);
+
+	p = task_of(se);
+
+#ifdef CONFIG_SMP
+	list_move(&p->se.group_node, &rq->cfs_tasks);
+#endif
+
+	if (hrtick_enabled_fair(rq))
+		hrtick_start_fair(rq, p);
+
+	update_misfit_status(p, rq);
+
+	return p;
+}
+#endif /* CONFIG_CFS_DL_SERVER */
+
 /*
  * Account for a descheduled task:
  */
@@ -7860,6 +8033,8 @@ static void put_prev_task_fair(struct rq *rq, struct task_struct *prev)
 		cfs_rq = cfs_rq_of(se);
 		put_prev_entity(cfs_rq, se);
 	}
+
+	prev->dl_server = NULL;
 }
 
 /*
@@ -9212,6 +9387,96 @@ sched_reduced_capacity(struct rq *rq, struct sched_domain *sd)
 	return check_cpu_capacity(rq, sd);
 }
 
+/*
+ * Groups at the top of the domain tree of a large machine span many CPUs,
+ * and every CPU balancing at that level sums them all up again; with NOHZ
+ * idle balancing a single CPU does so on behalf of each idle CPU in turn.
+ * Sums taken within the current jiffy are shared through the group's
+ * capacity structure instead. Readers never wait for a writer, they just
+ * fall back to summing up themselves. The local group is always summed up,
+ * and load_balance() still checks the chosen runqueue's live state.
+ */
+static inline bool sg_lb_snapshot_usable(struct lb_env *env,
+					 struct sched_group *group,
+					 int local_group)
+{
+	return sched_feat(LB_SNAPSHOT) && !local_group &&
+	       group->group_weight > 1 &&
+	       !(env->sd->flags & SD_ASYM_CPUCAPACITY) &&
+	       cpumask_subset(sched_group_span(group), env->cpus);
+}
+
+/* Reduced capacity misfit accounting depends on whether dst_cpu is idle. */
+static inline int sg_lb_snapshot_key(struct lb_env *env)
+{
+	return (env->idle != CPU_NOT_IDLE) + 1;
+}
+
+static bool sg_lb_snapshot_read(struct lb_env *env, struct sched_group *group,
+				struct sg_lb_stats *sgs, int *sg_status)
+{
+	struct sg_lb_snapshot *snap = &group->sgc->snap;
+	unsigned int seq = raw_read_seqcount(&snap->seq);
+	int status;
+
+	if (seq & 1)
+		return false;
+
+	if (snap->stamp != jiffies || snap->level != env->sd->level ||
+	    snap->key != sg_lb_snapshot_key(env))
+		return false;
+
+	sgs->group_load = snap->group_load;
+	sgs->group_util = snap->group_util;
+	sgs->group_runnable = snap->group_runnable;
+	sgs->group_misfit_task_load = snap->group_misfit_task_load;
+	sgs->sum_nr_running = snap->sum_nr_running;
+	sgs->sum_h_nr_running = snap->sum_h_nr_running;
+	sgs->idle_cpus = snap->idle_cpus;
+#ifdef CONFIG_NUMA_BALANCING
+	sgs->nr_numa_running = snap->nr_numa_running;
+	sgs->nr_preferred_running = snap->nr_preferred_running;
+#endif
+	status = snap->sg_status;
+
+	if (read_seqcount_retry(&snap->seq, seq)) {
+		memset(sgs, 0, sizeof(*sgs));
+		return false;
+	}
+
+	*sg_status |= status;
+	return true;
+}
+
+static void sg_lb_snapshot_write(struct lb_env *env, struct sched_group *group,
+				 struct sg_lb_stats *sgs, int sg_status)
+{
+	struct sg_lb_snapshot *snap = &group->sgc->snap;
+
+	if (test_and_set_bit_lock(0, &snap->busy))
+		return;
+
+	raw_write_seqcount_begin(&snap->seq);
+	snap->stamp = jiffies;
+	snap->level = env->sd->level;
+	snap->key = sg_lb_snapshot_key(env);
+	snap->sg_status = sg_status;
+	snap->group_load = sgs->group_load;
+	snap->group_util = sgs->group_util;
+	snap->group_runnable = sgs->group_runnable;
+	snap->group_misfit_task_load = sgs->group_misfit_task_load;
+	snap->sum_nr_running = sgs->sum_nr_running;
+	snap->sum_h_nr_running = sgs->sum_h_nr_running;
+	snap->idle_cpus = sgs->idle_cpus;
+#ifdef CONFIG_NUMA_BALANCING
+	snap->nr_numa_running = sgs->nr_numa_running;
+	snap->nr_preferred_running = sgs->nr_preferred_running;
+#endif
+	raw_write_seqcount_end(&snap->seq);
+
+	clear_bit_unlock(0, &snap->busy);
+}
+
 /**
  * update_sg_lb_stats - Update sched_group's statistics for load balancing.
  * @env: The load balancing environment.
@@ -9226,12 +9491,17 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 				      struct sg_lb_stats *sgs,
 				      int *sg_status)
 {
-	int i, nr_running, local_group;
+	int i, nr_running, local_group, status = 0;
+	bool snap;
 
 	memset(sgs, 0, sizeof(*sgs));
 
 	local_group = group == sds->local;
 
+	snap = sg_lb_snapshot_usable(env, group, local_group);
+	if (snap && sg_lb_snapshot_read(env, group, sgs, sg_status))
+		goto summed;
+
 	for_each_cpu_and(i, sched_group_span(group), env->cpus) {
 		struct rq *rq = cpu_rq(i);
 		unsigned long load = cpu_load(rq);
@@ -9245,10 +9515,10 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 		sgs->sum_nr_running += nr_running;
 
 		if (nr_running > 1)
-			*sg_status |= SG_OVERLOAD;
+			status |= SG_OVERLOAD;
 
 		if (cpu_overutilized(i))
-			*sg_status |= SG_OVERUTILIZED;
+			status |= SG_OVERUTILIZED;
 
 #ifdef CONFIG_NUMA_BALANCING
 		sgs->nr_numa_running += rq->nr_numa_running;
@@ -9270,7 +9540,7 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 			/* Check for a misfit task on the cpu */
 			if (sgs->group_misfit_task_load < rq->misfit_task_load) {
 				sgs->group_misfit_task_load = rq->misfit_task_load;
-				*sg_status |= SG_OVERLOAD;
+				status |= SG_OVERLOAD;
 			}
 		} else if ((env->idle != CPU_NOT_IDLE) &&
 			   sched_reduced_capacity(rq, env->sd)) {
@@ -9280,6 +9550,11 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 		}
 	}
 
+	*sg_status |= status;
+	if (snap)
+		sg_lb_snapshot_write(env, group, sgs, status);
+
+summed:
 	sgs->group_capacity = group->sgc->capacity;
 
 	sgs->group_weight = group->group_weight;
@@ -12167,6 +12442,34 @@ void online_fair_sched_group(struct task_group *tg)
 	}
 }
 
+#ifdef CONFIG_CFS_DL_SERVER
+/* Stop the servers of a dying group and give their bandwidth back */
+static void unregister_dl_servers(struct task_group *tg)
+{
+	struct sched_dl_entity *dl_se;
+	unsigned long flags;
+	struct rq *rq;
+	int cpu;
+
+	if (!tg->dl_runtime)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		dl_se = &tg->cfs_rq[cpu]->dl_server;
+		rq = cpu_rq(cpu);
+
+		raw_spin_rq_lock_irqsave(rq, flags);
+		dl_server_stop(dl_se);
+		dl_server_apply_params(dl_se, 0, 0);
+		raw_spin_rq_unlock_irqrestore(rq, flags);
+
+		hrtimer_cancel(&dl_se->dl_timer);
+	}
+}
+#else
+static inline void unregister_dl_servers(struct task_group *tg) { }
+#endif
+
 void unregister_fair_sched_group(struct task_group *tg)
 {
 	unsigned long flags;
@@ -12174,6 +12477,7 @@ void unregister_fair_sched_group(struct task_group *tg)
 	int cpu;
 
 	destroy_cfs_bandwidth(tg_cfs_bandwidth(tg));
+	unregister_dl_servers(tg);
 
 	for_each_possible_cpu(cpu) {
 		if (tg->se[cpu])
@@ -12222,7 +12526,13 @@ void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	se->my_q = cfs_rq;
 	/* guarantee group entities always have weight */
 	update_load_set(&se->load, NICE_0_LOAD);
+	se->latency_nice = tg->latency_nice;
 	se->parent = parent;
+
+#ifdef CONFIG_CFS_DL_SERVER
+	dl_server_init(&cfs_rq->dl_server, rq, cfs_server_has_tasks,
+		       cfs_server_pick);
+#endif
 }
 
 static DEFINE_MUTEX(shares_mutex);
@@ -12350,6 +12660,105 @@ int sched_group_set_idle(struct task_group *tg, long idle)
 	return 0;
 }
 
+int sched_group_set_latency_nice(struct task_group *tg, long nice)
+{
+	int i;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+
+	if (tg->latency_nice == nice) {
+		mutex_unlock(&shares_mutex);
+		return 0;
+	}
+
+	tg->latency_nice = nice;
+
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+		struct rq_flags rf;
+
+		rq_lock_irqsave(rq, &rf);
+		tg->se[i]->latency_nice = nice;
+		rq_unlock_irqrestore(rq, &rf);
+	}
+
+	mutex_unlock(&shares_mutex);
+	return 0;
+}
+
+#ifdef CONFIG_CFS_DL_SERVER
+static DEFINE_MUTEX(dl_server_mutex);
+
+static int __sched_group_set_dl_server(struct task_group *tg, int cpu,
+				       u64 runtime, u64 period)
+{
+	struct cfs_rq *cfs_rq = tg->cfs_rq[cpu];
+	struct sched_dl_entity *dl_se = &cfs_rq->dl_server;
+	struct rq *rq = cpu_rq(cpu);
+	struct rq_flags rf;
+	int ret;
+
+	rq_lock_irq(rq, &rf);
+	update_rq_clock(rq);
+
+	if (rq->curr->dl_server == dl_se) {
+		update_curr(cfs_rq_of(&rq->curr->se));
+		resched_curr(rq);
+	}
+
+	dl_server_stop(dl_se);
+	ret = dl_server_apply_params(dl_se, runtime, period);
+	if (cfs_rq->h_nr_running)
+		dl_server_start(dl_se);
+
+	rq_unlock_irq(rq, &rf);
+
+	return ret;
+}
+
+/*
+ * Reserve @runtime every @period on each CPU for the tasks of @tg, through
+ * one dl server per CPU. All CPUs get the new reservation or none does.
+ */
+int sched_group_set_dl_server(struct task_group *tg, u64 runtime, u64 period)
+{
+	int i, j, ret = 0;
+
+	/* the root group gets whatever is left, it takes no reservation */
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	cpus_read_lock();
+	mutex_lock(&dl_server_mutex);
+
+	for_each_possible_cpu(i) {
+		ret = __sched_group_set_dl_server(tg, i, runtime, period);
+		if (ret)
+			break;
+	}
+
+	if (ret) {
+		for_each_possible_cpu(j) {
+			if (j == i)
+				break;
+			__sched_group_set_dl_server(tg, j, tg->dl_runtime,
+						    tg->dl_period);
+		}
+	} else {
+		tg->dl_runtime = runtime;
+		tg->dl_period = period;
+	}
+
+	mutex_unlock(&dl_server_mutex);
+	cpus_read_unlock();
+
+	return ret;
+}
+#endif /* CONFIG_CFS_DL_SERVER */
+
 #else /* CONFIG_FAIR_GROUP_SCHED */
 
 void free_fair_sched_group(struct task_group *tg) { }
@@ -63,6 +63,18 @@ SCHED_FEAT(TTWU_QUEUE, true)
 SCHED_FEAT(SIS_PROP, false)
 SCHED_FEAT(SIS_UTIL, true)
 
+/*
+ * When the target LLC has no idle CPU, look for one behind the nearest
+ * sibling LLCs in the same NUMA node before giving up.
+ */
+SCHED_FEAT(SIS_NEAR_LLC, true)
+
+/*
+ * Let CPUs balancing at the same level within a jiffy share the per-group
+ * statistics instead of each summing up every CPU of every group.
+ */
+SCHED_FEAT(LB_SNAPSHOT, true)
+
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
  * in a single rq->lock section. Default disabled because the
@@ -101,3 +113,9 @@ SCHED_FEAT(LATENCY_WARN, false)
 
 SCHED_FEAT(ALT_PERIOD, true)
 SCHED_FEAT(BASE_SLICE, true)
+
+/*
+ * Core scheduling: skip the core-wide selection when the local pick carries
+ * the cookie the whole core already runs with.
+ */
+SCHED_FEAT(CORE_PICK_LOCAL, true)
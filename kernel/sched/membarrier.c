@@ -153,6 +153,9 @@
 #define MEMBARRIER_PRIVATE_EXPEDITED_RSEQ_BITMASK	0
 #endif
 
+/* upper bound of the pidfds taken by a MEMBARRIER_CMD_FLAG_PIDFDS command */
+#define MEMBARRIER_PIDFDS_MAX	1024
+
 #define MEMBARRIER_CMD_BITMASK						\
 	(MEMBARRIER_CMD_GLOBAL | MEMBARRIER_CMD_GLOBAL_EXPEDITED	\
 	| MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED			\
@@ -306,33 +309,81 @@ static int membarrier_global_expedited(void)
 	return 0;
 }
 
-static int membarrier_private_expedited(int flags, int cpu_id)
+/*
+ * Check that @mm registered for the private expedited command selected by
+ * @flags.
+ */
+static int membarrier_private_check(struct mm_struct *mm, int flags)
 {
-	cpumask_var_t tmpmask;
-	struct mm_struct *mm = current->mm;
-	smp_call_func_t ipi_func = ipi_mb;
+	int ready_state = MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY;
 
 	if (flags == MEMBARRIER_FLAG_SYNC_CORE) {
 		if (!IS_ENABLED(CONFIG_ARCH_HAS_MEMBARRIER_SYNC_CORE))
 			return -EINVAL;
-		if (!(atomic_read(&mm->membarrier_state) &
-		      MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE_READY))
-			return -EPERM;
-		ipi_func = ipi_sync_core;
+		ready_state = MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE_READY;
 	} else if (flags == MEMBARRIER_FLAG_RSEQ) {
 		if (!IS_ENABLED(CONFIG_RSEQ))
 			return -EINVAL;
-		if (!(atomic_read(&mm->membarrier_state) &
-		      MEMBARRIER_STATE_PRIVATE_EXPEDITED_RSEQ_READY))
-			return -EPERM;
-		ipi_func = ipi_rseq;
+		ready_state = MEMBARRIER_STATE_PRIVATE_EXPEDITED_RSEQ_READY;
 	} else {
 		WARN_ON_ONCE(flags);
-		if (!(atomic_read(&mm->membarrier_state) &
-		      MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY))
-			return -EPERM;
 	}
 
+	if (!(atomic_read(&mm->membarrier_state) & ready_state))
+		return -EPERM;
+
+	return 0;
+}
+
+static smp_call_func_t membarrier_private_ipi_func(int flags)
+{
+	if (flags == MEMBARRIER_FLAG_SYNC_CORE)
+		return ipi_sync_core;
+	if (flags == MEMBARRIER_FLAG_RSEQ)
+		return ipi_rseq;
+	return ipi_mb;
+}
+
+static void membarrier_private_ipi_mask(const struct cpumask *mask, int flags)
+{
+	smp_call_func_t ipi_func = membarrier_private_ipi_func(flags);
+
+	/*
+	 * For regular membarrier, we can save a few cycles by
+	 * skipping the current cpu -- we're about to do smp_mb()
+	 * below, and if we migrate to a different cpu, this cpu
+	 * and the new cpu will execute a full barrier in the
+	 * scheduler.
+	 *
+	 * For SYNC_CORE, we do need a barrier on the current cpu --
+	 * otherwise, if we are migrated and replaced by a different
+	 * task in the same mm just before, during, or after
+	 * membarrier, we will end up with some thread in the mm
+	 * running without a core sync.
+	 *
+	 * For RSEQ, don't rseq_preempt() the caller.  User code
+	 * is not supposed to issue syscalls at all from inside an
+	 * rseq critical section.
+	 */
+	if (flags != MEMBARRIER_FLAG_SYNC_CORE) {
+		preempt_disable();
+		smp_call_function_many(mask, ipi_func, NULL, true);
+		preempt_enable();
+	} else {
+		on_each_cpu_mask(mask, ipi_func, NULL, true);
+	}
+}
+
+static int membarrier_private_expedited(int flags, int cpu_id)
+{
+	cpumask_var_t tmpmask;
+	struct mm_struct *mm = current->mm;
+	int ret;
+
+	ret = membarrier_private_check(mm, flags);
+	if (ret)
+		return ret;
+
 	if (flags != MEMBARRIER_FLAG_SYNC_CORE &&
 	    (atomic_read(&mm->mm_users) == 1 || num_online_cpus() == 1))
 		return 0;
@@ -379,32 +430,11 @@ static int membarrier_private_expedited(int flags, int cpu_id)
 		 * smp_call_function_single() will call ipi_func() if cpu_id
 		 * is the calling CPU.
 		 */
-		smp_call_function_single(cpu_id, ipi_func, NULL, 1);
+		smp_call_function_single(cpu_id,
+					 membarrier_private_ipi_func(flags),
+					 NULL, 1);
 	} else {
-		/*
-		 * For regular membarrier, we can save a few cycles by
-		 * skipping the current cpu -- we're about to do smp_mb()
-		 * below, and if we migrate to a different cpu, this cpu
-		 * and the new cpu will execute a full barrier in the
-		 * scheduler.
-		 *
-		 * For SYNC_CORE, we do need a barrier on the current cpu --
-		 * otherwise, if we are migrated and replaced by a different
-		 * task in the same mm just before, during, or after
-		 * membarrier, we will end up with some thread in the mm
-		 * running without a core sync.
-		 *
-		 * For RSEQ, don't rseq_preempt() the caller.  User code
-		 * is not supposed to issue syscalls at all from inside an
-		 * rseq critical section.
-		 */
-		if (flags != MEMBARRIER_FLAG_SYNC_CORE) {
-			preempt_disable();
-			smp_call_function_many(tmpmask, ipi_func, NULL, true);
-			preempt_enable();
-		} else {
-			on_each_cpu_mask(tmpmask, ipi_func, NULL, true);
-		}
+		membarrier_private_ipi_mask(tmpmask, flags);
 	}
 
 out:
@@ -422,6 +452,118 @@ static int membarrier_private_expedited(int flags, int cpu_id)
 	return 0;
 }
 
+static int membarrier_cmp_mm(const void *a, const void *b)
+{
+	unsigned long l = (unsigned long)*(struct mm_struct * const *)a;
+	unsigned long r = (unsigned long)*(struct mm_struct * const *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+/*
+ * Same as membarrier_private_expedited(), but for the processes the @nr
+ * pidfds at @upidfds refer to. The CPUs running any of them are collected
+ * into one mask so that a single round of IPIs covers all of the targets.
+ * Each target must have registered for the command, and the caller needs
+ * the same access to it as for process_madvise().
+ */
+static int membarrier_private_expedited_pidfds(int flags,
+					       const int __user *upidfds,
+					       int nr)
+{
+	struct mm_struct **mms;
+	cpumask_var_t tmpmask;
+	int i, cpu, ret = 0;
+
+	if (nr <= 0 || nr > MEMBARRIER_PIDFDS_MAX)
+		return -EINVAL;
+
+	mms = kcalloc(nr, sizeof(*mms), GFP_KERNEL);
+	if (!mms)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		struct task_struct *task;
+		unsigned int f_flags;
+		struct mm_struct *mm;
+		int pidfd;
+
+		if (get_user(pidfd, &upidfds[i])) {
+			ret = -EFAULT;
+			goto out_put;
+		}
+
+		task = pidfd_get_task(pidfd, &f_flags);
+		if (IS_ERR(task)) {
+			ret = PTR_ERR(task);
+			goto out_put;
+		}
+
+		mm = mm_access(task, PTRACE_MODE_READ_FSCREDS);
+		put_task_struct(task);
+		if (IS_ERR_OR_NULL(mm)) {
+			ret = IS_ERR(mm) ? PTR_ERR(mm) : -ESRCH;
+			goto out_put;
+		}
+		mms[i] = mm;
+
+		ret = membarrier_private_check(mm, flags);
+		if (ret)
+			goto out_put;
+	}
+
+	if (flags != MEMBARRIER_FLAG_SYNC_CORE && num_online_cpus() == 1)
+		goto out_put;
+
+	if (!zalloc_cpumask_var(&tmpmask, GFP_KERNEL)) {
+		ret = -ENOMEM;
+		goto out_put;
+	}
+
+	sort(mms, nr, sizeof(*mms), membarrier_cmp_mm, NULL);
+
+	/*
+	 * Matches memory barriers around rq->curr modification in
+	 * scheduler.
+	 */
+	smp_mb();	/* system call entry is not a mb. */
+
+	cpus_read_lock();
+	rcu_read_lock();
+	for_each_online_cpu(cpu) {
+		struct task_struct *p;
+		struct mm_struct *mm;
+
+		p = rcu_dereference(cpu_rq(cpu)->curr);
+		if (!p)
+			continue;
+
+		mm = p->mm;
+		if (mm && bsearch(&mm, mms, nr, sizeof(*mms), membarrier_cmp_mm))
+			__cpumask_set_cpu(cpu, tmpmask);
+	}
+	rcu_read_unlock();
+
+	membarrier_private_ipi_mask(tmpmask, flags);
+
+	free_cpumask_var(tmpmask);
+	cpus_read_unlock();
+
+	/*
+	 * Memory barrier on the caller thread _after_ we finished
+	 * waiting for the last IPI. Matches memory barriers around
+	 * rq->curr modification in scheduler.
+	 */
+	smp_mb();	/* exit from system call is not a mb */
+
+out_put:
+	for (i = 0; i < nr && mms[i]; i++)
+		mmput(mms[i]);
+	kfree(mms);
+
+	return ret;
+}
+
 static int sync_runqueues_membarrier_state(struct mm_struct *mm)
 {
 	int membarrier_state = atomic_read(&mm->membarrier_state);
@@ -550,7 +692,11 @@ static int membarrier_register_private_expedited(int flags)
  *          the RSEQ critical section.
  * @cpu_id: if @flags == MEMBARRIER_CMD_FLAG_CPU, indicates the cpu on which
  *          RSEQ CS should be interrupted (@cmd must be
- *          MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ).
+ *          MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ). If @flags ==
+ *          MEMBARRIER_CMD_FLAG_PIDFDS, the number of entries in @pidfds.
+ * @pidfds: if @flags == MEMBARRIER_CMD_FLAG_PIDFDS, an array of pidfds of the
+ *          processes to issue the private expedited command @cmd on instead
+ *          of the caller's own process. Ignored otherwise.
  *
  * If this system call is not implemented, -ENOSYS is returned. If the
  * command specified does not exist, not available on the running
@@ -559,7 +705,9 @@ static int membarrier_register_private_expedited(int flags)
  * if this system call returns -ENOSYS or -EINVAL, it is guaranteed to
  * always return the same value until reboot. In addition, it can return
  * -ENOMEM if there is not enough memory available to perform the system
- * call.
+ * call. With MEMBARRIER_CMD_FLAG_PIDFDS, errors looking up the pidfds or
+ * accessing the processes they refer to are returned as well, and no
+ * barrier is issued in that case.
  *
  * All memory accesses performed in program order from each targeted thread
  * is guaranteed to be ordered with respect to sys_membarrier(). If we use
@@ -576,11 +724,18 @@ static int membarrier_register_private_expedited(int flags)
  *        smp_mb()           X           O            O
  *        sys_membarrier()   O           O            O
  */
-SYSCALL_DEFINE3(membarrier, int, cmd, unsigned int, flags, int, cpu_id)
+SYSCALL_DEFINE4(membarrier, int, cmd, unsigned int, flags, int, cpu_id,
+		const int __user *, pidfds)
 {
 	switch (cmd) {
 	case MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ:
-		if (unlikely(flags && flags != MEMBARRIER_CMD_FLAG_CPU))
+		if (unlikely(flags && flags != MEMBARRIER_CMD_FLAG_CPU &&
+			     flags != MEMBARRIER_CMD_FLAG_PIDFDS))
+			return -EINVAL;
+		break;
+	case MEMBARRIER_CMD_PRIVATE_EXPEDITED:
+	case MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE:
+		if (unlikely(flags && flags != MEMBARRIER_CMD_FLAG_PIDFDS))
 			return -EINVAL;
 		break;
 	default:
@@ -588,6 +743,20 @@ SYSCALL_DEFINE3(membarrier, int, cmd, unsigned int, flags, int, cpu_id)
 			return -EINVAL;
 	}
 
+	if (flags & MEMBARRIER_CMD_FLAG_PIDFDS) {
+		switch (cmd) {
+		case MEMBARRIER_CMD_PRIVATE_EXPEDITED:
+			return membarrier_private_expedited_pidfds(0, pidfds,
+								   cpu_id);
+		case MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE:
+			return membarrier_private_expedited_pidfds(MEMBARRIER_FLAG_SYNC_CORE,
+								   pidfds, cpu_id);
+		case MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ:
+			return membarrier_private_expedited_pidfds(MEMBARRIER_FLAG_RSEQ,
+								   pidfds, cpu_id);
+		}
+	}
+
 	if (!(flags & MEMBARRIER_CMD_FLAG_CPU))
 		cpu_id = -1;
 
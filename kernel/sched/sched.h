@@ -184,6 +184,10 @@ static inline int idle_policy(int policy)
 }
 static inline int fair_policy(int policy)
 {
+#ifdef CONFIG_SCHED_CLASS_EXT
+	if (policy == SCHED_EXT)
+		return true;
+#endif
 	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
 }
 
@@ -365,6 +369,32 @@ struct cfs_bandwidth {
 #endif
 };
 
+#ifdef CONFIG_SCHED_INFO
+/*
+ * Log2 histograms of how long the tasks of a group waited on a runqueue
+ * and how long they then ran. Bucket 0 counts everything below 1024ns,
+ * bucket i covers [2^(i+9), 2^(i+10)) ns and the last one is open ended.
+ */
+#define TG_HIST_BUCKETS		24
+
+enum tg_hist_type {
+	TG_HIST_WAIT,
+	TG_HIST_RUN,
+	TG_NR_HISTS,
+};
+
+struct tg_hist {
+	u64			cnt[TG_NR_HISTS][TG_HIST_BUCKETS];
+};
+
+struct tg_hist_cpu {
+	/* updated under the rq lock of the CPU */
+	struct tg_hist		cur;
+	/* @cur as of the last rstat flush */
+	struct tg_hist		last;
+};
+#endif
+
 /* Task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
@@ -379,6 +409,15 @@ struct task_group {
 	/* A positive value indicates that this is a SCHED_IDLE group. */
 	int			idle;
 
+	/* latency_nice of the group entities, see sched_attr::sched_latency_nice */
+	int			latency_nice;
+
+#ifdef CONFIG_CFS_DL_SERVER
+	/* per-CPU reservation of the cfs_rq dl servers, in ns */
+	u64			dl_runtime;
+	u64			dl_period;
+#endif
+
 #ifdef	CONFIG_SMP
 	/*
 	 * load_avg can be heavily contended at clock tick time, so put
@@ -418,6 +457,13 @@ struct task_group {
 	struct uclamp_se	uclamp[UCLAMP_CNT];
 #endif
 
+#ifdef CONFIG_SCHED_INFO
+	/* NULL for the root and autogroups, see cpu_cgroup_css_alloc() */
+	struct tg_hist_cpu __percpu *hist_cpu;
+	/* subtree totals, and how much of them the parent has seen */
+	struct tg_hist		hist;
+	struct tg_hist		hist_last;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -487,6 +533,12 @@ extern void sched_move_task(struct task_struct *tsk);
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 
 extern int sched_group_set_idle(struct task_group *tg, long idle);
+extern int sched_group_set_latency_nice(struct task_group *tg, long nice);
+
+#ifdef CONFIG_CFS_DL_SERVER
+extern int sched_group_set_dl_server(struct task_group *tg, u64 runtime,
+				     u64 period);
+#endif
 
 #ifdef CONFIG_SMP
 extern void set_task_rq_fair(struct sched_entity *se,
@@ -646,6 +698,10 @@ struct cfs_rq {
 	int			throttle_count;
 	struct list_head	throttled_list;
 #endif /* CONFIG_CFS_BANDWIDTH */
+#ifdef CONFIG_CFS_DL_SERVER
+	/* CBS reservation running the tasks of this cfs_rq */
+	struct sched_dl_entity	dl_server;
+#endif
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 };
 
@@ -750,6 +806,9 @@ struct dl_rq {
 	u64			this_bw;
 	u64			extra_bw;
 
+	/* Bandwidth of the dl servers of this CPU, see dl_server_apply_params() */
+	u64			server_bw;
+
 	/*
 	 * Inverse of the fraction of CPU utilization that can be reclaimed
 	 * by the GRUB algorithm.
@@ -944,6 +1003,16 @@ struct balance_callback {
 	void (*func)(struct rq *rq);
 };
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+/* ext class related fields in a runqueue: */
+struct scx_rq {
+	struct scx_dispatch_q	local_dsq;
+	/* queued tasks waiting to run, oldest first, see scx_watchdog_workfn() */
+	struct list_head	runnable_list;
+	unsigned long		nr_running;
+};
+#endif /* CONFIG_SCHED_CLASS_EXT */
+
 /*
  * This is the main, per-CPU runqueue data structure.
  *
@@ -990,6 +1059,9 @@ struct rq {
 	struct cfs_rq		cfs;
 	struct rt_rq		rt;
 	struct dl_rq		dl;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	struct scx_rq		scx;
+#endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this CPU: */
@@ -1805,6 +1877,7 @@ DECLARE_PER_CPU(struct sched_domain __rcu *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_size);
 DECLARE_PER_CPU(int, sd_llc_id);
 DECLARE_PER_CPU(struct sched_domain_shared __rcu *, sd_llc_shared);
+DECLARE_PER_CPU(struct sched_domain __rcu *, sd_llc_near);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_numa);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_packing);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_cpucapacity);
@@ -1815,6 +1888,30 @@ static __always_inline bool sched_asym_cpucap_active(void)
 	return static_branch_unlikely(&sched_asym_cpucapacity);
 }
 
+/*
+ * Load balance sums of a group's CPUs as last taken by update_sg_lb_stats(),
+ * for other CPUs balancing at the same level within the same jiffy.
+ */
+struct sg_lb_snapshot {
+	seqcount_t		seq;
+	unsigned long		busy;			/* a writer is active */
+	unsigned long		stamp;			/* jiffies of the sums */
+	int			level;			/* sched_domain level */
+	int			key;			/* see sg_lb_snapshot_key() */
+	int			sg_status;
+	unsigned int		sum_nr_running;
+	unsigned int		sum_h_nr_running;
+	unsigned int		idle_cpus;
+	unsigned long		group_load;
+	unsigned long		group_util;
+	unsigned long		group_runnable;
+	unsigned long		group_misfit_task_load;
+#ifdef CONFIG_NUMA_BALANCING
+	unsigned int		nr_numa_running;
+	unsigned int		nr_preferred_running;
+#endif
+};
+
 struct sched_group_capacity {
 	atomic_t		ref;
 	/*
@@ -1827,6 +1924,8 @@ struct sched_group_capacity {
 	unsigned long		next_update;
 	int			imbalance;		/* XXX unrelated to capacity but shared group state */
 
+	struct sg_lb_snapshot	snap;
+
 #ifdef CONFIG_SCHED_DEBUG
 	int			id;
 #endif
@@ -2252,19 +2351,84 @@ const struct sched_class name##_sched_class \
 extern struct sched_class __sched_class_highest[];
 extern struct sched_class __sched_class_lowest[];
 
+extern const struct sched_class stop_sched_class;
+extern const struct sched_class dl_sched_class;
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class fair_sched_class;
+extern const struct sched_class idle_sched_class;
+#ifdef CONFIG_SCHED_CLASS_EXT
+extern const struct sched_class ext_sched_class;
+
+enum scx_ops_enable_state {
+	SCX_OPS_DISABLED,
+	SCX_OPS_ENABLED,
+	SCX_OPS_DISABLING,
+};
+
+extern enum scx_ops_enable_state scx_ops_state;
+
+DECLARE_STATIC_KEY_FALSE(__scx_ops_enabled);
+#define scx_enabled()		static_branch_unlikely(&__scx_ops_enabled)
+#else
+#define scx_enabled()		false
+#endif
+
+/*
+ * The ext class lives outside the linker-ordered array and ranks between
+ * fair and idle; it is only walked while a BPF scheduler is attached.
+ */
+static inline const struct sched_class *
+next_sched_class(const struct sched_class *class)
+{
+#ifdef CONFIG_SCHED_CLASS_EXT
+	if (class == &fair_sched_class && scx_enabled())
+		return &ext_sched_class;
+	if (class == &ext_sched_class)
+		return &idle_sched_class;
+#endif
+	return class + 1;
+}
+
 #define for_class_range(class, _from, _to) \
-	for (class = (_from); class < (_to); class++)
+	for (class = (_from); class != (_to); class = next_sched_class(class))
 
 #define for_each_class(class) \
 	for_class_range(class, __sched_class_highest, __sched_class_lowest)
 
-#define sched_class_above(_a, _b)	((_a) < (_b))
+static inline bool sched_class_above(const struct sched_class *a,
+				     const struct sched_class *b)
+{
+#ifdef CONFIG_SCHED_CLASS_EXT
+	if (a == &ext_sched_class)
+		return b == &idle_sched_class;
+	if (b == &ext_sched_class)
+		return a != &ext_sched_class && a != &idle_sched_class;
+#endif
+	return a < b;
+}
 
-extern const struct sched_class stop_sched_class;
-extern const struct sched_class dl_sched_class;
-extern const struct sched_class rt_sched_class;
-extern const struct sched_class fair_sched_class;
-extern const struct sched_class idle_sched_class;
+#ifdef CONFIG_SCHED_CLASS_EXT
+/*
+ * SCHED_EXT tasks only run in the ext class while a BPF scheduler is
+ * attached. While it is being detached, the class stays enabled until
+ * its tasks have been moved back to fair.
+ */
+static inline bool task_should_scx(struct task_struct *p)
+{
+	return scx_enabled() && p->policy == SCHED_EXT &&
+	       READ_ONCE(scx_ops_state) == SCX_OPS_ENABLED;
+}
+
+extern void init_sched_ext_class(void);
+extern void sched_ext_reclass_task(struct task_struct *p);
+#else
+static inline bool task_should_scx(struct task_struct *p)
+{
+	return false;
+}
+
+static inline void init_sched_ext_class(void) { }
+#endif /* CONFIG_SCHED_CLASS_EXT */
 
 static inline bool sched_stop_runnable(struct rq *rq)
 {
@@ -2373,6 +2537,15 @@ extern void init_dl_bandwidth(struct dl_bandwidth *dl_b, u64 period, u64 runtime
 extern void init_dl_task_timer(struct sched_dl_entity *dl_se);
 extern void init_dl_inactive_task_timer(struct sched_dl_entity *dl_se);
 
+extern void dl_server_update(struct sched_dl_entity *dl_se, s64 delta_exec);
+extern void dl_server_start(struct sched_dl_entity *dl_se);
+extern void dl_server_stop(struct sched_dl_entity *dl_se);
+extern void dl_server_init(struct sched_dl_entity *dl_se, struct rq *rq,
+			   dl_server_has_tasks_f has_tasks,
+			   dl_server_pick_f pick);
+extern int dl_server_apply_params(struct sched_dl_entity *dl_se,
+				  u64 runtime, u64 period);
+
 #define BW_SHIFT		20
 #define BW_UNIT			(1 << BW_SHIFT)
 #define RATIO_SHIFT		8
@@ -3261,4 +3434,78 @@ static inline void update_current_exec_runtime(struct task_struct *curr,
 	cgroup_account_cputime(curr, delta_exec);
 }
 
+#ifdef CONFIG_SCHED_MM_CID
+#define MM_CID_SCAN_DELAY	(HZ / 10)	/* 100ms */
+
+extern void task_tick_mm_cid(struct rq *rq, struct task_struct *curr);
+
+/*
+ * Each CPU holds at most one ID per mm, so the lowest clear bit of the
+ * cidmask is always below nr_cpu_ids; the loop only repeats when another
+ * CPU took the same bit first.
+ */
+static inline int __mm_cid_get(struct mm_struct *mm)
+{
+	struct cpumask *cidmask = mm_cidmask(mm);
+	int cid;
+
+	for (;;) {
+		cid = cpumask_first_zero(cidmask);
+		if (WARN_ON_ONCE(cid >= nr_cpu_ids))
+			return -1;
+		if (!cpumask_test_and_set_cpu(cid, cidmask))
+			return cid;
+	}
+}
+
+static inline void mm_cid_put(struct mm_struct *mm, int cid)
+{
+	if (cid >= 0)
+		cpumask_clear_cpu(cid, mm_cidmask(mm));
+}
+
+/*
+ * The concurrency ID a CPU took for @mm stays in the mm's per-cpu slot and
+ * is handed to every task of @mm which runs there, so that switching
+ * between tasks, mms, kernel threads and idle touches no shared state.
+ * task_mm_cid_work() gives back the IDs of the CPUs which have not run @mm
+ * for MM_CID_SCAN_DELAY, so that the IDs of an mm stay below the number of
+ * CPUs its tasks ran on recently.
+ *
+ * Called with the rq lock held, which serializes against the reclaim.
+ */
+static inline int mm_cid_get(struct rq *rq, struct mm_struct *mm)
+{
+	struct mm_cid *pcpu_cid = per_cpu_ptr(mm->pcpu_cid, cpu_of(rq));
+	int cid = pcpu_cid->cid;
+
+	lockdep_assert_rq_held(rq);
+	if (cid < 0) {
+		cid = __mm_cid_get(mm);
+		WRITE_ONCE(pcpu_cid->cid, cid);
+	}
+	WRITE_ONCE(pcpu_cid->time, jiffies);
+	return cid;
+}
+
+static inline void switch_mm_cid(struct rq *rq, struct task_struct *prev,
+				 struct task_struct *next)
+{
+	if (prev->mm_cid_active) {
+		struct mm_cid *pcpu_cid;
+
+		pcpu_cid = per_cpu_ptr(prev->mm->pcpu_cid, cpu_of(rq));
+		WRITE_ONCE(pcpu_cid->time, jiffies);
+		prev->mm_cid = -1;
+	}
+	if (next->mm_cid_active)
+		next->mm_cid = mm_cid_get(rq, next->mm);
+}
+
+#else
+static inline void switch_mm_cid(struct rq *rq, struct task_struct *prev,
+				 struct task_struct *next) { }
+static inline void task_tick_mm_cid(struct rq *rq, struct task_struct *curr) { }
+#endif
+
 #endif /* _KERNEL_SCHED_SCHED_H */
@@ -6,6 +6,7 @@
 
 extern void sched_ttwu_pending(void *arg);
 
+extern bool call_function_single_prep_ipi(int cpu);
 extern void send_call_function_single_ipi(int cpu);
 
 #ifdef CONFIG_SMP
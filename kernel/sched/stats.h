@@ -196,6 +196,13 @@ static inline void psi_account_irqtime(struct task_struct *task, u32 delta) {}
 #endif /* CONFIG_PSI */
 
 #ifdef CONFIG_SCHED_INFO
+#ifdef CONFIG_CGROUP_SCHED
+extern void tg_hist_account(struct rq *rq, struct task_struct *p,
+			    enum tg_hist_type type, u64 delta);
+#else
+# define tg_hist_account(rq, p, type, delta)	do { } while (0)
+#endif
+
 /*
  * We are interested in knowing how long it was from the *first* time a
  * task was queued to the time that it finally hit a CPU, we call this routine
@@ -236,6 +243,7 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(rq, delta);
+	tg_hist_account(rq, t, TG_HIST_WAIT, delta);
 }
 
 /*
@@ -262,6 +270,7 @@ static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
 	unsigned long long delta = rq_clock(rq) - t->sched_info.last_arrival;
 
 	rq_sched_info_depart(rq, delta);
+	tg_hist_account(rq, t, TG_HIST_RUN, delta);
 
 	if (task_is_running(t))
 		sched_info_enqueue(rq, t);
@@ -219,6 +219,11 @@ void rebuild_sched_domains_energy(void)
 	mutex_unlock(&sched_energy_mutex);
 }
 
+static inline bool sched_energy_needs_update(void)
+{
+	return sched_energy_update;
+}
+
 #ifdef CONFIG_PROC_SYSCTL
 static int sched_energy_aware_handler(struct ctl_table *table, int write,
 		void *buffer, size_t *lenp, loff_t *ppos)
@@ -466,6 +471,7 @@ static bool build_perf_domains(const struct cpumask *cpu_map)
 }
 #else
 static void free_pd(struct perf_domain *pd) { }
+static inline bool sched_energy_needs_update(void) { return false; }
 #endif /* CONFIG_ENERGY_MODEL && CONFIG_CPU_FREQ_GOV_SCHEDUTIL*/
 
 static void free_rootdomain(struct rcu_head *rcu)
@@ -665,6 +671,7 @@ DEFINE_PER_CPU(struct sched_domain __rcu *, sd_llc);
 DEFINE_PER_CPU(int, sd_llc_size);
 DEFINE_PER_CPU(int, sd_llc_id);
 DEFINE_PER_CPU(struct sched_domain_shared __rcu *, sd_llc_shared);
+DEFINE_PER_CPU(struct sched_domain __rcu *, sd_llc_near);
 DEFINE_PER_CPU(struct sched_domain __rcu *, sd_numa);
 DEFINE_PER_CPU(struct sched_domain __rcu *, sd_asym_packing);
 DEFINE_PER_CPU(struct sched_domain __rcu *, sd_asym_cpucapacity);
@@ -673,7 +680,7 @@ DEFINE_STATIC_KEY_FALSE(sched_asym_cpucapacity);
 static void update_top_cache_domain(int cpu)
 {
 	struct sched_domain_shared *sds = NULL;
-	struct sched_domain *sd;
+	struct sched_domain *sd, *near = NULL;
 	int id = cpu;
 	int size = 1;
 
@@ -689,6 +696,18 @@ static void update_top_cache_domain(int cpu)
 	per_cpu(sd_llc_id, cpu) = id;
 	rcu_assign_pointer(per_cpu(sd_llc_shared, cpu), sds);
 
+	/*
+	 * The highest domain above the LLC that does not cross a NUMA
+	 * boundary. On packages built from several LLCs (chiplets) it spans
+	 * the sibling caches, and the domain levels between it and the LLC
+	 * order those caches by distance from this CPU.
+	 */
+	if (sd) {
+		for (sd = sd->parent; sd && !(sd->flags & SD_NUMA); sd = sd->parent)
+			near = sd;
+	}
+	rcu_assign_pointer(per_cpu(sd_llc_near, cpu), near);
+
 	sd = lowest_flag_domain(cpu, SD_NUMA);
 	rcu_assign_pointer(per_cpu(sd_numa, cpu), sd);
 
@@ -2506,6 +2525,33 @@ static int dattrs_equal(struct sched_domain_attr *cur, int idx_cur,
 			sizeof(struct sched_domain_attr));
 }
 
+/*
+ * Check whether 'doms_new' matches the current partitioning. The domains
+ * in either set never intersect, so equal counts and a match for every
+ * new domain are sufficient.
+ */
+static bool sched_domains_unchanged(int ndoms_new, cpumask_var_t doms_new[],
+				    struct sched_domain_attr *dattr_new)
+{
+	int i, j;
+
+	if (!doms_new || doms_cur == &fallback_doms || ndoms_new != ndoms_cur)
+		return false;
+
+	for (i = 0; i < ndoms_new; i++) {
+		for (j = 0; j < ndoms_cur; j++) {
+			if (cpumask_equal(doms_new[i], doms_cur[j]) &&
+			    dattrs_equal(dattr_new, i, dattr_cur, j))
+				goto match;
+		}
+		return false;
+match:
+		;
+	}
+
+	return true;
+}
+
 /*
  * Partition sched domains as specified by the 'ndoms_new'
  * cpumasks in the array doms_new[] of cpumasks. This compares
@@ -2530,9 +2576,14 @@ static int dattrs_equal(struct sched_domain_attr *cur, int idx_cur,
  * ndoms_new == 0 is a special case for destroying existing domains,
  * and it will not create the default domain.
  *
+ * Returns false if 'doms_new' describes exactly the current partitioning
+ * and nothing was rebuilt, true otherwise. In the former case the root
+ * domains, including their deadline bandwidth accounting, are untouched
+ * and the caller need not recompute them.
+ *
  * Call with hotplug lock and sched_domains_mutex held
  */
-void partition_sched_domains_locked(int ndoms_new, cpumask_var_t doms_new[],
+bool partition_sched_domains_locked(int ndoms_new, cpumask_var_t doms_new[],
 				    struct sched_domain_attr *dattr_new)
 {
 	bool __maybe_unused has_eas = false;
@@ -2547,6 +2598,13 @@ void partition_sched_domains_locked(int ndoms_new, cpumask_var_t doms_new[],
 	if (new_topology)
 		asym_cpu_capacity_scan();
 
+	if (!new_topology && !sched_energy_needs_update() &&
+	    sched_domains_unchanged(ndoms_new, doms_new, dattr_new)) {
+		free_sched_domains(doms_new, ndoms_new);
+		kfree(dattr_new);
+		return false;
+	}
+
 	if (!doms_new) {
 		WARN_ON_ONCE(dattr_new);
 		n = 0;
@@ -2633,6 +2691,8 @@ void partition_sched_domains_locked(int ndoms_new, cpumask_var_t doms_new[],
 	ndoms_cur = ndoms_new;
 
 	update_sched_domain_debugfs();
+
+	return true;
 }
 
 /*
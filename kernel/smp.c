@@ -945,7 +945,14 @@ static void smp_call_function_many_cond(const struct cpumask *mask,
 			csd->node.dst = cpu;
 #endif
 			cfd_seq_store(pcpu->seq_queue, this_cpu, cpu, CFD_SEQ_QUEUE);
-			if (llist_add(&csd->node.llist, &per_cpu(call_single_queue, cpu))) {
+			/*
+			 * Only the csd that makes the queue non-empty needs to
+			 * kick the target: anything queued behind it is run by
+			 * the same flush. Idle CPUs polling on TIF_NEED_RESCHED
+			 * are told to flush on idle exit and get no IPI at all.
+			 */
+			if (llist_add(&csd->node.llist, &per_cpu(call_single_queue, cpu)) &&
+			    call_function_single_prep_ipi(cpu)) {
 				__cpumask_set_cpu(cpu, cfd->cpumask_ipi);
 				nr_cpus++;
 				last_cpu = cpu;
@@ -964,7 +971,7 @@ static void smp_call_function_many_cond(const struct cpumask *mask,
 		 * provided mask.
 		 */
 		if (nr_cpus == 1)
-			send_call_function_single_ipi(last_cpu);
+			arch_send_call_function_single_ipi(last_cpu);
 		else if (likely(nr_cpus > 1))
 			arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
 
@@ -100,6 +100,7 @@ static const int six_hundred_forty_kb = 640 * 1024;
 
 static const int ngroups_max = NGROUPS_MAX;
 static const int cap_last_cap = CAP_LAST_CAP;
+static const int max_kswapd_threads = MAX_KSWAPD_THREADS;
 
 #ifdef CONFIG_PROC_SYSCTL
 
@@ -2246,6 +2247,15 @@ static struct ctl_table vm_table[] = {
 		.extra1		= SYSCTL_ONE,
 		.extra2		= SYSCTL_THREE_THOUSAND,
 	},
+	{
+		.procname	= "kswapd_threads",
+		.data		= &kswapd_threads,
+		.maxlen		= sizeof(kswapd_threads),
+		.mode		= 0644,
+		.proc_handler	= kswapd_threads_sysctl_handler,
+		.extra1		= SYSCTL_ONE,
+		.extra2		= (void *)&max_kswapd_threads,
+	},
 	{
 		.procname	= "percpu_pagelist_high_fraction",
 		.data		= &percpu_pagelist_high_fraction,
@@ -2254,6 +2264,14 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_high_fraction_sysctl_handler,
 		.extra1		= SYSCTL_ZERO,
 	},
+	{
+		.procname	= "percpu_pagelist_high_orders",
+		.data		= &percpu_pagelist_high_orders,
+		.maxlen		= sizeof(percpu_pagelist_high_orders),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_high_orders_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+	},
 	{
 		.procname	= "page_lock_unfairness",
 		.data		= &sysctl_page_lock_unfairness,
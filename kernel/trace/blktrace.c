@@ -1918,5 +1918,28 @@ void blk_fill_rwbs(char *rwbs, blk_opf_t opf)
 }
 EXPORT_SYMBOL_GPL(blk_fill_rwbs);
 
+/**
+ * blk_rq_trace_cgroup_id - Get the id of the blkcg a request is charged to
+ * @rq:		request to look up
+ *
+ * Description:
+ *     Returns the cgroup id of the blkcg of the first bio of @rq, or 0 if
+ *     @rq has no bio yet, or if it is not associated with a blkcg.
+ *
+ **/
+u64 blk_rq_trace_cgroup_id(struct request *rq)
+{
+	struct cgroup_subsys_state *blkcg_css;
+
+	if (!rq->bio)
+		return 0;
+
+	blkcg_css = bio_blkcg_css(rq->bio);
+	if (!blkcg_css)
+		return 0;
+	return cgroup_id(blkcg_css->cgroup);
+}
+EXPORT_SYMBOL_GPL(blk_rq_trace_cgroup_id);
+
 #endif /* CONFIG_EVENT_TRACING */
 
@@ -5,6 +5,7 @@
 #include <linux/bug.h>
 #include <linux/kallsyms.h>
 #include <linux/kprobes.h>
+#include <linux/percpu.h>
 #include <linux/preempt.h>
 #include <linux/rethook.h>
 #include <linux/slab.h>
@@ -33,12 +34,20 @@ void rethook_flush_task(struct task_struct *tk)
 	}
 }
 
+static void __rethook_free(struct rethook *rh)
+{
+	free_percpu(rh->pcp);
+	kfree(rh);
+}
+
 static void rethook_free_rcu(struct rcu_head *head)
 {
 	struct rethook *rh = container_of(head, struct rethook, rcu);
 	struct rethook_node *rhn;
 	struct freelist_node *node;
+	struct rethook_pcp *pcp;
 	int count = 1;
+	int cpu;
 
 	node = rh->pool.head;
 	while (node) {
@@ -48,9 +57,18 @@ static void rethook_free_rcu(struct rcu_head *head)
 		count++;
 	}
 
+	/* No one can use the per-cpu caches after a grace period */
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(rh->pcp, cpu);
+		while (pcp->nr) {
+			kfree(pcp->nodes[--pcp->nr]);
+			count++;
+		}
+	}
+
 	/* The rh->ref is the number of pooled node + 1 */
 	if (refcount_sub_and_test(count, &rh->ref))
-		kfree(rh);
+		__rethook_free(rh);
 }
 
 /**
@@ -88,6 +106,12 @@ struct rethook *rethook_alloc(void *data, rethook_handler_t handler)
 		return NULL;
 	}
 
+	rh->pcp = alloc_percpu(struct rethook_pcp);
+	if (!rh->pcp) {
+		kfree(rh);
+		return NULL;
+	}
+
 	rh->data = data;
 	rh->handler = handler;
 	rh->pool.head = NULL;
@@ -103,20 +127,61 @@ struct rethook *rethook_alloc(void *data, rethook_handler_t handler)
  *
  * Add @node to @rh. User must allocate @node (as a part of user's
  * data structure.) The @node fields are initialized in this function.
+ * All nodes must be added before @rh is used.
  */
 void rethook_add_node(struct rethook *rh, struct rethook_node *node)
 {
 	node->rethook = rh;
 	freelist_add(&node->freelist, &rh->pool);
 	refcount_inc(&rh->ref);
+
+	/* Let the per-cpu caches hold at most half of the nodes */
+	rh->nr_nodes++;
+	rh->pcp_max = min_t(unsigned int, RETHOOK_PCP_NODES,
+			    rh->nr_nodes / (2 * num_possible_cpus()));
 }
 
+/*
+ * Nodes are mostly taken on function entry and given back on its return
+ * on the same CPU, so keep a few of them per-cpu and don't bounce the
+ * shared freelist head between CPUs. An NMI hitting while the cache is
+ * modified falls back to the freelist.
+ */
+static struct rethook_node *rethook_pcp_get(struct rethook *rh)
+{
+	struct rethook_pcp *pcp = this_cpu_ptr(rh->pcp);
+	struct rethook_node *node = NULL;
+
+	if (this_cpu_inc_return(rh->pcp->busy) == 1 && pcp->nr)
+		node = pcp->nodes[--pcp->nr];
+	this_cpu_dec(rh->pcp->busy);
+
+	return node;
+}
+NOKPROBE_SYMBOL(rethook_pcp_get);
+
+static bool rethook_pcp_put(struct rethook *rh, struct rethook_node *node)
+{
+	struct rethook_pcp *pcp = this_cpu_ptr(rh->pcp);
+	bool ret = false;
+
+	if (this_cpu_inc_return(rh->pcp->busy) == 1 &&
+	    pcp->nr < READ_ONCE(rh->pcp_max)) {
+		pcp->nodes[pcp->nr++] = node;
+		ret = true;
+	}
+	this_cpu_dec(rh->pcp->busy);
+
+	return ret;
+}
+NOKPROBE_SYMBOL(rethook_pcp_put);
+
 static void free_rethook_node_rcu(struct rcu_head *head)
 {
 	struct rethook_node *node = container_of(head, struct rethook_node, rcu);
 
 	if (refcount_dec_and_test(&node->rethook->ref))
-		kfree(node->rethook);
+		__rethook_free(node->rethook);
 	kfree(node);
 }
 
@@ -131,10 +196,12 @@ void rethook_recycle(struct rethook_node *node)
 {
 	lockdep_assert_preemption_disabled();
 
-	if (likely(READ_ONCE(node->rethook->handler)))
-		freelist_add(&node->freelist, &node->rethook->pool);
-	else
+	if (likely(READ_ONCE(node->rethook->handler))) {
+		if (!rethook_pcp_put(node->rethook, node))
+			freelist_add(&node->freelist, &node->rethook->pool);
+	} else {
 		call_rcu(&node->rcu, free_rethook_node_rcu);
+	}
 }
 NOKPROBE_SYMBOL(rethook_recycle);
 
@@ -148,6 +215,7 @@ NOKPROBE_SYMBOL(rethook_recycle);
 struct rethook_node *rethook_try_get(struct rethook *rh)
 {
 	rethook_handler_t handler = READ_ONCE(rh->handler);
+	struct rethook_node *node;
 	struct freelist_node *fn;
 
 	lockdep_assert_preemption_disabled();
@@ -165,6 +233,10 @@ struct rethook_node *rethook_try_get(struct rethook *rh)
 	if (unlikely(!rcu_is_watching()))
 		return NULL;
 
+	node = rethook_pcp_get(rh);
+	if (node)
+		return node;
+
 	fn = freelist_try_get(&rh->pool);
 	if (!fn)
 		return NULL;
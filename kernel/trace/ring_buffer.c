@@ -5,6 +5,7 @@
  * Copyright (C) 2008 Steven Rostedt <srostedt@redhat.com>
  */
 #include <linux/trace_recursion.h>
+#include <linux/trace_mmap.h>
 #include <linux/trace_events.h>
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
@@ -27,6 +28,7 @@
 #include <linux/cpu.h>
 #include <linux/oom.h>
 
+#include <asm/cacheflush.h>
 #include <asm/local.h>
 
 /*
@@ -332,6 +334,7 @@ struct buffer_page {
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
 	struct buffer_data_page *page;	/* Actual data page */
+	u32		 id;		/* ID for external mapping */
 };
 
 /*
@@ -536,6 +539,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned int			mapped;
+	unsigned long			*subbuf_ids;	/* ID to page address */
+	struct trace_buffer_meta	*meta_page;
 };
 
 struct trace_buffer {
@@ -1757,6 +1766,7 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -1800,6 +1810,8 @@ static void rb_free_cpu_buffer(struct ring_buffer_per_cpu *cpu_buffer)
 	struct list_head *head = cpu_buffer->pages;
 	struct buffer_page *bpage, *tmp;
 
+	WARN_ON_ONCE(cpu_buffer->mapped);
+
 	free_buffer_page(cpu_buffer->reader_page);
 
 	if (head) {
@@ -4556,6 +4568,24 @@ rb_update_iter_read_stamp(struct ring_buffer_iter *iter,
 	return;
 }
 
+/* Must be called with the reader_lock held */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	if (!meta)
+		return;
+
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+
+	/* Some archs do not have data cache coherency between kernel and user-space */
+	flush_dcache_page(virt_to_page(meta));
+}
+
 static struct buffer_page *
 rb_get_reader_page(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -4678,6 +4708,8 @@ rb_get_reader_page(struct ring_buffer_per_cpu *cpu_buffer)
 		cpu_buffer->last_overrun = overwrite;
 	}
 
+	rb_update_meta_page(cpu_buffer);
+
 	goto again;
 
  out:
@@ -5308,6 +5340,8 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->last_overrun = 0;
 
 	rb_head_page_activate(cpu_buffer);
+
+	rb_update_meta_page(cpu_buffer);
 }
 
 /* Must have disabled the cpu buffer then done a synchronize_rcu */
@@ -5515,6 +5549,11 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* User space keeps the pages of a mapped buffer */
+	ret = -EBUSY;
+	if (READ_ONCE(cpu_buffer_a->mapped) || READ_ONCE(cpu_buffer_b->mapped))
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (atomic_read(&buffer_a->record_disabled))
@@ -5734,12 +5773,14 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the buffer is mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -5752,7 +5793,7 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 		 * the reader page.
 		 */
 		if (full &&
-		    (!read || (len < (commit - read)) ||
+		    ((!read && !cpu_buffer->mapped) || (len < (commit - read)) ||
 		     cpu_buffer->reader_page == cpu_buffer->commit_page))
 			goto out_unlock;
 
@@ -5856,6 +5897,305 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * Give an ID to every sub-buffer, the reader one first and then the
+ * ring ones starting at the head, and describe the buffer in the
+ * meta-page. The IDs follow the buffer_page, so they stay valid across
+ * reader swaps as long as no page is added, removed or exchanged, which
+ * is what a mapping prevents.
+ */
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	unsigned int nr_subbufs = cpu_buffer->nr_pages + 1;
+	struct buffer_page *first_subbuf, *subbuf;
+	int id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first_subbuf = subbuf = rb_set_head_page(cpu_buffer);
+	do {
+		if (RB_WARN_ON(cpu_buffer, id >= nr_subbufs))
+			break;
+
+		subbuf_ids[id] = (unsigned long)subbuf->page;
+		subbuf->id = id;
+
+		rb_inc_page(&subbuf);
+		id++;
+	} while (subbuf != first_subbuf);
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->nr_subbufs = nr_subbufs;
+	meta->subbuf_size = PAGE_SIZE;
+
+	rb_update_meta_page(cpu_buffer);
+}
+
+static int __rb_map_vma(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_pages, nr_vma_pages, pgoff = vma->vm_pgoff;
+	struct page **pages;
+	unsigned long p;
+	int err;
+
+	lockdep_assert_held(&cpu_buffer->mapping_lock);
+
+	if (vma->vm_flags & (VM_WRITE | VM_EXEC) ||
+	    !(vma->vm_flags & VM_MAYSHARE))
+		return -EPERM;
+
+	/* meta-page + reader + ring sub-buffers */
+	nr_pages = cpu_buffer->nr_pages + 2;
+	nr_vma_pages = vma_pages(vma);
+	if (!nr_vma_pages || pgoff >= nr_pages ||
+	    nr_vma_pages > nr_pages - pgoff)
+		return -EINVAL;
+
+	pages = kcalloc(nr_vma_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	for (p = 0; p < nr_vma_pages; p++, pgoff++) {
+		if (!pgoff)
+			pages[p] = virt_to_page(cpu_buffer->meta_page);
+		else
+			pages[p] = virt_to_page((void *)cpu_buffer->subbuf_ids[pgoff - 1]);
+	}
+
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	err = vm_insert_pages(vma, vma->vm_start, pages, &nr_vma_pages);
+
+	kfree(pages);
+
+	return err;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer to user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the CPU buffer to map
+ * @vma: the read-only, shared vma to map it into
+ *
+ * The first page of the mapping is a struct trace_buffer_meta, followed
+ * by the sub-buffers ordered by ID. As long as the buffer is mapped, it
+ * can't be resized or swapped and ring_buffer_read_page() copies
+ * instead of exchanging pages. Every successful call must be balanced by
+ * ring_buffer_unmap(); the pages themselves are kept alive by the
+ * mapping until it goes away.
+ *
+ * Returns 0 on success, or a negative error code.
+ */
+int ring_buffer_map(struct trace_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags, *subbuf_ids;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		err = __rb_map_vma(cpu_buffer, vma);
+		if (!err) {
+			raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+			cpu_buffer->mapped++;
+			raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		}
+		goto unlock;
+	}
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	cpu_buffer->meta_page = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!cpu_buffer->meta_page) {
+		err = -ENOMEM;
+		goto unlock_buffer;
+	}
+
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!subbuf_ids) {
+		err = -ENOMEM;
+		goto free_meta;
+	}
+
+	atomic_inc(&cpu_buffer->resize_disabled);
+
+	/* Block reader swaps until every sub-buffer has its ID */
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	err = __rb_map_vma(cpu_buffer, vma);
+	if (err) {
+		atomic_dec(&cpu_buffer->resize_disabled);
+		goto free_ids;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	goto unlock_buffer;
+
+free_ids:
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	kfree(subbuf_ids);
+free_meta:
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+unlock_buffer:
+	mutex_unlock(&buffer->mutex);
+unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - release a mapping taken with ring_buffer_map()
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * Returns 0 on success, or -ENODEV if the CPU buffer is not mapped.
+ */
+int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	unsigned long flags, *subbuf_ids;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto unlock;
+	}
+
+	mutex_lock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (--cpu_buffer->mapped) {
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		goto unlock_buffer;
+	}
+	meta = cpu_buffer->meta_page;
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&cpu_buffer->resize_disabled);
+
+	/* A remaining mapping holds its own reference on the page */
+	free_page((unsigned long)meta);
+	kfree(subbuf_ids);
+
+unlock_buffer:
+	mutex_unlock(&buffer->mutex);
+unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_get_reader - swap in the next sub-buffer for user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * User space is done with the current reader sub-buffer: consume what
+ * is left of it and, if there is more data, swap the next sub-buffer in
+ * as the new reader. The new reader is consumed on the kernel side as
+ * user space is expected to read it all, and the meta-page is updated
+ * to point at it.
+ *
+ * Returns 0 on success, or a negative error code.
+ */
+int ring_buffer_map_get_reader(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long missed_events = 0;
+	unsigned long reader_size;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	}
+
+consume:
+	if (rb_per_cpu_empty(cpu_buffer))
+		goto update;
+
+	reader_size = rb_page_commit(cpu_buffer->reader_page);
+
+	/*
+	 * There is data left on the current reader. Return it, and consider
+	 * it read as user space reads all of it.
+	 */
+	if (cpu_buffer->reader_page->read < reader_size) {
+		while (cpu_buffer->reader_page->read < reader_size)
+			rb_advance_reader(cpu_buffer);
+		goto update;
+	}
+
+	if (RB_WARN_ON(cpu_buffer, !rb_get_reader_page(cpu_buffer)))
+		goto update;
+
+	missed_events += cpu_buffer->lost_events;
+	cpu_buffer->lost_events = 0;
+
+	goto consume;
+
+update:
+	/* Some archs do not have data cache coherency between kernel and user-space */
+	flush_dcache_page(virt_to_page(cpu_buffer->reader_page->page));
+
+	rb_update_meta_page(cpu_buffer);
+	cpu_buffer->meta_page->reader.lost_events = missed_events;
+out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
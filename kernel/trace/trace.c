@@ -48,6 +48,7 @@
 #include <linux/fsnotify.h>
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
+#include <linux/trace_mmap.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -1215,6 +1216,10 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 
 	if (!tr->allocated_snapshot) {
 
+		/* A snapshot swap would pull the pages from under the mapping */
+		if (tr->mapped)
+			return -EBUSY;
+
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
 				   &tr->array_buffer, RING_BUFFER_ALL_CPUS);
@@ -7418,6 +7423,7 @@ struct ftrace_buffer_info {
 	void			*spare;
 	unsigned int		spare_cpu;
 	unsigned int		read;
+	unsigned int		mapped;	/* successful mmap() calls */
 };
 
 #ifdef CONFIG_TRACER_SNAPSHOT
@@ -8197,6 +8203,14 @@ static int tracing_buffers_release(struct inode *inode, struct file *file)
 
 	ring_buffer_wake_waiters(iter->array_buffer->buffer, iter->cpu_file);
 
+	/* The mappings hold a reference on the file, they are all gone */
+	if (info->mapped) {
+		iter->tr->mapped--;
+		while (info->mapped--)
+			WARN_ON(ring_buffer_unmap(iter->array_buffer->buffer,
+						  iter->cpu_file));
+	}
+
 	if (info->spare)
 		ring_buffer_free_read_page(iter->array_buffer->buffer,
 					   info->spare_cpu, info->spare);
@@ -8384,14 +8398,28 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
-/* An ioctl call with cmd 0 to the ring buffer file will wake up all waiters */
+/*
+ * An ioctl call with cmd 0 to the ring buffer file will wake up all waiters.
+ * TRACE_MMAP_IOCTL_GET_READER hands the next sub-buffer to a mapping.
+ */
 static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct ftrace_buffer_info *info = file->private_data;
 	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (cmd == TRACE_MMAP_IOCTL_GET_READER) {
+		if (!(file->f_flags & O_NONBLOCK) && trace_empty(iter)) {
+			ret = wait_on_pipe(iter, 0);
+			if (ret)
+				return ret;
+		}
 
-	if (cmd)
+		return ring_buffer_map_get_reader(iter->array_buffer->buffer,
+						  iter->cpu_file);
+	} else if (cmd) {
 		return -ENOIOCTLCMD;
+	}
 
 	mutex_lock(&trace_types_lock);
 
@@ -8405,6 +8433,41 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	return 0;
 }
 
+/*
+ * Map the per CPU buffer read-only: a struct trace_buffer_meta page
+ * followed by the sub-buffers. The mapping is released with the file.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct trace_array *tr = iter->tr;
+	int ret;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	mutex_lock(&trace_types_lock);
+
+#ifdef CONFIG_TRACER_MAX_TRACE
+	if (tr->allocated_snapshot) {
+		ret = -EBUSY;
+		goto out;
+	}
+#endif
+
+	ret = ring_buffer_map(iter->array_buffer->buffer, iter->cpu_file, vma);
+	if (ret)
+		goto out;
+
+	if (!info->mapped++)
+		tr->mapped++;
+out:
+	mutex_unlock(&trace_types_lock);
+
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
@@ -8412,6 +8475,7 @@ static const struct file_operations tracing_buffers_fops = {
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
 	.unlocked_ioctl = tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -362,6 +362,8 @@ struct trace_array {
 	cpumask_var_t		tracing_cpumask; /* only trace on set CPUs */
 	int			ref;
 	int			trace_ref;
+	/* trace_pipe_raw files with a user space mapping, excludes snapshots */
+	unsigned int		mapped;
 #ifdef CONFIG_FUNCTION_TRACER
 	struct ftrace_ops	*ops;
 	struct trace_pid_list	__rcu *function_pids;
@@ -1285,9 +1287,11 @@ struct ftrace_event_field {
 };
 
 struct prog_entry;
+struct bpf_prog;
 
 struct event_filter {
 	struct prog_entry __rcu	*prog;
+	struct bpf_prog		*bpf_prog;	/* JITed prog, if any */
 	char			*filter_string;
 };
 
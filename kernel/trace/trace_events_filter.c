@@ -10,6 +10,7 @@
 #include <linux/ctype.h>
 #include <linux/mutex.h>
 #include <linux/perf_event.h>
+#include <linux/filter.h>
 #include <linux/slab.h>
 
 #include "trace.h"
@@ -1049,6 +1050,13 @@ int filter_match_preds(struct event_filter *filter, void *rec)
 	if (!prog)
 		return 1;
 
+#ifdef CONFIG_BPF_JIT
+	/* Set up along with prog, before the filter is published */
+	if (filter->bpf_prog)
+		return __bpf_prog_run(filter->bpf_prog, rec,
+				      bpf_dispatcher_nop_func);
+#endif
+
 	for (i = 0; prog[i].pred; i++) {
 		struct filter_pred *pred = prog[i].pred;
 		int match = filter_pred_fn_call(pred, rec);
@@ -1145,11 +1153,23 @@ void print_subsystem_event_filter(struct event_subsystem *system,
 	mutex_unlock(&event_mutex);
 }
 
+static void filter_free_bpf_prog(struct event_filter *filter)
+{
+#ifdef CONFIG_BPF_JIT
+	if (filter->bpf_prog) {
+		bpf_prog_free(filter->bpf_prog);
+		filter->bpf_prog = NULL;
+	}
+#endif
+}
+
 static void free_prog(struct event_filter *filter)
 {
 	struct prog_entry *prog;
 	int i;
 
+	filter_free_bpf_prog(filter);
+
 	prog = rcu_access_pointer(filter->prog);
 	if (!prog)
 		return;
@@ -1342,6 +1362,236 @@ static int filter_pred_fn_call(struct filter_pred *pred, void *event)
 	}
 }
 
+#ifdef CONFIG_BPF_JIT
+/*
+ * Translate the program array into an eBPF program and JIT it, so that
+ * filter_match_preds() runs native code instead of walking the array.
+ * Integer predicates are open coded; the others (strings, comm, cpu, ...)
+ * call back into filter_pred_fn_call(). The control flow is the same as
+ * the array's: each entry computes its match in R0, branches to
+ * target + 1 if it equals when_to_branch, else falls through to the next
+ * entry; the two entries without a predicate return their target.
+ */
+BPF_CALL_2(filter_pred_bpf_call, struct filter_pred *, pred, void *, event)
+{
+	return filter_pred_fn_call(pred, event);
+}
+
+struct filter_jit {
+	struct bpf_insn		*insns;	/* NULL when only sizing */
+	int			*addrs;	/* insn index of each prog entry */
+	int			len;
+};
+
+static void filter_jit_emit(struct filter_jit *ctx, struct bpf_insn insn)
+{
+	if (ctx->insns)
+		ctx->insns[ctx->len] = insn;
+	ctx->len++;
+}
+
+static void filter_jit_emit_ld_imm64(struct filter_jit *ctx, int reg, u64 imm)
+{
+	struct bpf_insn insn[] = { BPF_LD_IMM64(reg, imm) };
+
+	filter_jit_emit(ctx, insn[0]);
+	filter_jit_emit(ctx, insn[1]);
+}
+
+/* Integer predicates: size of the field and whether it is signed */
+static bool filter_jit_int_pred(struct filter_pred *pred, int *size,
+				bool *is_signed, bool *equality)
+{
+	*is_signed = false;
+	*equality = false;
+
+	switch (pred->fn_num) {
+	case FILTER_PRED_FN_64:
+		*equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U64:
+		*size = 8;
+		break;
+	case FILTER_PRED_FN_S64:
+		*size = 8;
+		*is_signed = true;
+		break;
+	case FILTER_PRED_FN_32:
+		*equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U32:
+		*size = 4;
+		break;
+	case FILTER_PRED_FN_S32:
+		*size = 4;
+		*is_signed = true;
+		break;
+	case FILTER_PRED_FN_16:
+		*equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U16:
+		*size = 2;
+		break;
+	case FILTER_PRED_FN_S16:
+		*size = 2;
+		*is_signed = true;
+		break;
+	case FILTER_PRED_FN_8:
+		*equality = true;
+		fallthrough;
+	case FILTER_PRED_FN_U8:
+		*size = 1;
+		break;
+	case FILTER_PRED_FN_S8:
+		*size = 1;
+		*is_signed = true;
+		break;
+	default:
+		return false;
+	}
+
+	return pred->offset >= 0 && pred->offset <= S16_MAX;
+}
+
+static int filter_jit_cmp_op(struct filter_pred *pred, bool is_signed,
+			     bool equality)
+{
+	if (equality)
+		return pred->not ? BPF_JNE : BPF_JEQ;
+
+	switch (pred->op) {
+	case OP_LT:
+		return is_signed ? BPF_JSLT : BPF_JLT;
+	case OP_LE:
+		return is_signed ? BPF_JSLE : BPF_JLE;
+	case OP_GT:
+		return is_signed ? BPF_JSGT : BPF_JGT;
+	case OP_GE:
+		return is_signed ? BPF_JSGE : BPF_JGE;
+	case OP_BAND:
+		return BPF_JSET;
+	default:
+		return -1;
+	}
+}
+
+/* Compute the match of @pred on the event in R6 into R0 */
+static void filter_jit_pred(struct filter_jit *ctx, struct filter_pred *pred)
+{
+	int size, shift, op = -1;
+	bool is_signed, equality;
+	u64 val;
+
+	if (filter_jit_int_pred(pred, &size, &is_signed, &equality))
+		op = filter_jit_cmp_op(pred, is_signed, equality);
+
+	if (op < 0) {
+		filter_jit_emit_ld_imm64(ctx, BPF_REG_1, (unsigned long)pred);
+		filter_jit_emit(ctx, BPF_MOV64_REG(BPF_REG_2, BPF_REG_6));
+		filter_jit_emit(ctx, BPF_EMIT_CALL(filter_pred_bpf_call));
+		return;
+	}
+
+	/* Same truncation and extension as the (type) casts of the C preds */
+	shift = 64 - size * 8;
+	val = pred->val;
+	if (shift && is_signed)
+		val = (u64)((s64)(val << shift) >> shift);
+	else if (shift)
+		val &= (1ULL << (size * 8)) - 1;
+
+	filter_jit_emit(ctx, BPF_LDX_MEM(bytes_to_bpf_size(size), BPF_REG_2,
+					 BPF_REG_6, pred->offset));
+	if (shift && is_signed) {
+		filter_jit_emit(ctx, BPF_ALU64_IMM(BPF_LSH, BPF_REG_2, shift));
+		filter_jit_emit(ctx, BPF_ALU64_IMM(BPF_ARSH, BPF_REG_2, shift));
+	}
+	filter_jit_emit_ld_imm64(ctx, BPF_REG_3, val);
+	filter_jit_emit(ctx, BPF_MOV64_IMM(BPF_REG_0, 1));
+	filter_jit_emit(ctx, BPF_JMP_REG(op, BPF_REG_2, BPF_REG_3, 1));
+	filter_jit_emit(ctx, BPF_MOV64_IMM(BPF_REG_0, 0));
+}
+
+static void filter_jit_prog(struct filter_jit *ctx, struct prog_entry *prog,
+			    int nr_entries)
+{
+	int i, off;
+
+	ctx->len = 0;
+	filter_jit_emit(ctx, BPF_MOV64_REG(BPF_REG_6, BPF_REG_1));
+
+	for (i = 0; i < nr_entries; i++) {
+		ctx->addrs[i] = ctx->len;
+
+		if (!prog[i].pred) {
+			filter_jit_emit(ctx, BPF_MOV64_IMM(BPF_REG_0,
+							   prog[i].target));
+			filter_jit_emit(ctx, BPF_EXIT_INSN());
+			continue;
+		}
+
+		filter_jit_pred(ctx, prog[i].pred);
+
+		/*
+		 * Branches only go forward: the addrs of later entries come
+		 * from the sizing pass.
+		 */
+		off = ctx->insns ? ctx->addrs[prog[i].target + 1] - ctx->len - 1 : 0;
+		filter_jit_emit(ctx, BPF_JMP_IMM(BPF_JEQ, BPF_REG_0,
+						 prog[i].when_to_branch, off));
+	}
+}
+
+/*
+ * Best effort: if the JIT is off or anything fails, the filter keeps
+ * being interpreted by filter_match_preds().
+ */
+static void filter_jit_compile(struct event_filter *filter)
+{
+	struct prog_entry *prog = rcu_dereference_protected(filter->prog, 1);
+	struct filter_jit ctx = {};
+	struct bpf_prog *fp;
+	int nr_entries;
+	int err;
+
+	if (!ebpf_jit_enabled())
+		return;
+
+	/* The predicates are followed by the TRUE and FALSE entries */
+	for (nr_entries = 0; prog[nr_entries].pred; nr_entries++)
+		;
+	nr_entries += 2;
+
+	ctx.addrs = kcalloc(nr_entries, sizeof(*ctx.addrs), GFP_KERNEL);
+	if (!ctx.addrs)
+		return;
+
+	filter_jit_prog(&ctx, prog, nr_entries);
+	if (ctx.len > S16_MAX)
+		goto out;
+
+	fp = bpf_prog_alloc(bpf_prog_size(ctx.len), 0);
+	if (!fp)
+		goto out;
+
+	ctx.insns = fp->insnsi;
+	filter_jit_prog(&ctx, prog, nr_entries);
+	fp->len = ctx.len;
+
+	fp = bpf_prog_select_runtime(fp, &err);
+	if (err || !fp->jited) {
+		bpf_prog_free(fp);
+		goto out;
+	}
+
+	filter->bpf_prog = fp;
+out:
+	kfree(ctx.addrs);
+}
+#else
+static inline void filter_jit_compile(struct event_filter *filter) { }
+#endif
+
 /* Called when a predicate is encountered by predicate_parse() */
 static int parse_pred(const char *str, void *data,
 		      int pos, struct filter_parse_error *pe,
@@ -1755,6 +2005,7 @@ static int process_preds(struct trace_event_call *call,
 		return PTR_ERR(prog);
 
 	rcu_assign_pointer(filter->prog, prog);
+	filter_jit_compile(filter);
 	return 0;
 }
 
@@ -2389,6 +2640,9 @@ static void update_pred_fn(struct event_filter *filter, char *fields)
 						lockdep_is_held(&event_mutex));
 	int i;
 
+	/* The JITed prog would not see the pred changes */
+	filter_free_bpf_prog(filter);
+
 	for (i = 0; prog[i].pred; i++) {
 		struct filter_pred *pred = prog[i].pred;
 		struct ftrace_event_field *field = pred->field;
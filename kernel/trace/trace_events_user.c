@@ -1384,19 +1384,16 @@ static int delete_user_event(struct user_event_group *group, char *name)
 }
 
 /*
- * Validates the user payload and writes via iterator.
+ * Validates the user payload of the event at idx and writes via iterator.
+ * The caller may have faulted in the payload already, for instance for a
+ * whole batch. Returns 0 on success.
  */
-static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
+static int user_events_write_event(struct user_event_file_info *info,
+				   u32 idx, struct iov_iter *i, bool fault_in)
 {
-	struct user_event_file_info *info = file->private_data;
 	struct user_event_refs *refs;
 	struct user_event *user = NULL;
 	struct tracepoint *tp;
-	ssize_t ret = i->count;
-	int idx;
-
-	if (unlikely(copy_from_iter(&idx, sizeof(idx), i) != sizeof(idx)))
-		return -EFAULT;
 
 	rcu_read_lock_sched();
 
@@ -1431,7 +1428,8 @@ static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
 		void *tpdata;
 		bool faulted;
 
-		if (unlikely(fault_in_iov_iter_readable(i, i->count)))
+		if (unlikely(fault_in &&
+			     fault_in_iov_iter_readable(i, i->count)))
 			return -EFAULT;
 
 		faulted = false;
@@ -1455,7 +1453,25 @@ static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
 			return -EFAULT;
 	}
 
-	return ret;
+	return 0;
+}
+
+/*
+ * Validates the user payload and writes via iterator.
+ */
+static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
+{
+	struct user_event_file_info *info = file->private_data;
+	/* write() reports the whole buffer, index included, as written */
+	ssize_t count = i->count;
+	int idx, ret;
+
+	if (unlikely(copy_from_iter(&idx, sizeof(idx), i) != sizeof(idx)))
+		return -EFAULT;
+
+	ret = user_events_write_event(info, idx, i, true);
+
+	return ret ? ret : count;
 }
 
 static int user_events_open(struct inode *node, struct file *file)
@@ -1641,6 +1657,106 @@ static long user_events_ioctl_del(struct user_event_file_info *info,
 	return ret;
 }
 
+static long user_batch_get(struct user_batch __user *ubatch,
+			   struct user_batch *kbatch)
+{
+	u32 size;
+	long ret;
+
+	ret = get_user(size, &ubatch->size);
+
+	if (ret)
+		return ret;
+
+	if (size > PAGE_SIZE)
+		return -E2BIG;
+
+	if (size < offsetofend(struct user_batch, committed))
+		return -EINVAL;
+
+	ret = copy_struct_from_user(kbatch, sizeof(*kbatch), ubatch, size);
+
+	if (ret)
+		return ret;
+
+	if (kbatch->flags)
+		return -EINVAL;
+
+	kbatch->size = size;
+
+	return 0;
+}
+
+/*
+ * Commits a batch of events on behalf of a user process.
+ *
+ * The whole buffer is faulted in once, then each entry goes through the
+ * same path as a write(). Committing stops at the first invalid entry,
+ * the number of entries committed so far is reported back either way.
+ */
+static long user_events_ioctl_batch(struct user_event_file_info *info,
+				    unsigned long uarg)
+{
+	struct user_batch __user *ubatch = (struct user_batch __user *)uarg;
+	struct user_batch_entry entry;
+	struct user_batch batch;
+	char __user *data;
+	struct iov_iter i;
+	struct iovec iov;
+	u32 committed = 0;
+	u64 pos = 0;
+	long ret;
+
+	ret = user_batch_get(ubatch, &batch);
+
+	if (ret)
+		return ret;
+
+	if (batch.data_len > MAX_RW_COUNT)
+		return -E2BIG;
+
+	data = u64_to_user_ptr(batch.data);
+
+	if (fault_in_readable(data, batch.data_len))
+		return -EFAULT;
+
+	while (pos + sizeof(entry) <= batch.data_len) {
+		if (copy_from_user(&entry, data + pos, sizeof(entry))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		pos += sizeof(entry);
+
+		if (entry.size > batch.data_len - pos) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = import_single_range(ITER_SOURCE, data + pos, entry.size,
+					  &iov, &i);
+
+		if (ret)
+			break;
+
+		ret = user_events_write_event(info, entry.write_index, &i,
+					      false);
+
+		if (ret)
+			break;
+
+		committed++;
+		pos = round_up(pos + entry.size, USER_BATCH_ALIGN);
+
+		cond_resched();
+	}
+
+	if (put_user(committed, &ubatch->committed))
+		return -EFAULT;
+
+	return ret;
+}
+
 /*
  * Handles the ioctl from user mode to register or alter operations.
  */
@@ -1663,6 +1779,10 @@ static long user_events_ioctl(struct file *file, unsigned int cmd,
 		ret = user_events_ioctl_del(info, uarg);
 		mutex_unlock(&group->reg_mutex);
 		break;
+
+	case DIAG_IOCSBATCH:
+		ret = user_events_ioctl_batch(info, uarg);
+		break;
 	}
 
 	return ret;
@@ -0,0 +1,471 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lock contention profiler
+ *
+ * Hooks the lock:contention_begin and lock:contention_end tracepoints,
+ * which are only hit in the slow paths of the spinlocks, rwlocks, mutexes
+ * and rwsems, and accumulates the wait time per call site and lock type in
+ * per-cpu tables. Unlike lock_stat, it costs nothing while the locks are
+ * not contended, so it can be left enabled in production.
+ *
+ * Enable it with:
+ *
+ *   echo 1 > /sys/kernel/tracing/lock_profile_enabled
+ *
+ * or with "lock_profile" on the kernel command line, and read the results
+ * from trace_stat/lock_contention, sorted by total wait time.
+ */
+#include <linux/kallsyms.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/debug.h>
+#include <linux/spinlock.h>
+#include <linux/stacktrace.h>
+#include <linux/tracefs.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <trace/events/lock.h>
+
+#include "trace.h"
+#include "trace_stat.h"
+
+#define LC_HASH_BITS		7	/* keep the table below PCPU_MIN_UNIT_SIZE */
+#define LC_HASH_SIZE		(1 << LC_HASH_BITS)
+#define LC_HIST_SHIFT		8	/* first bucket: < 512ns */
+#define LC_HIST_BUCKETS		24	/* last bucket: >= 2s */
+#define LC_STACK_DEPTH		16
+
+/*
+ * Accumulated wait time of a call site, waiting for one type of lock.
+ */
+struct lc_entry {
+	unsigned long		ip;
+	unsigned int		flags;
+	u64			count;
+	u64			total;
+	u64			max;
+	u32			hist[LC_HIST_BUCKETS];
+};
+
+struct lc_table {
+	struct lc_entry		entries[LC_HASH_SIZE];
+	unsigned long		dropped;
+};
+
+static struct lc_table __percpu	*lc_tables;
+static DEFINE_MUTEX(lc_mutex);
+static bool lc_enabled;
+static bool lc_enable_at_boot __initdata;
+
+/*
+ * Bumped on every enable, so that the stale contention windows a task
+ * may have left from a previous session are discarded.
+ */
+static unsigned int lc_gen;
+
+/*
+ * lc_callsite - the first caller outside of the locking code
+ *
+ * The tracepoints are called from the slow paths, the caller of interest
+ * is the first one after the lock functions (spinlocks and rwlocks) and
+ * the __sched functions (mutexes and rwsems).
+ */
+static unsigned long lc_callsite(void)
+{
+	unsigned long entries[LC_STACK_DEPTH];
+	unsigned int nr, i;
+	bool in_lock = false;
+
+	nr = stack_trace_save(entries, LC_STACK_DEPTH, 0);
+
+	for (i = 0; i < nr; i++) {
+		if (in_lock_functions(entries[i]) ||
+		    in_sched_functions(entries[i])) {
+			in_lock = true;
+			continue;
+		}
+		if (in_lock)
+			return entries[i];
+	}
+
+	return 0;
+}
+
+static void
+probe_contention_begin(void *ignore, void *lock, unsigned int flags)
+{
+	struct lock_contention_task *lct = &current->lock_contention;
+	unsigned int gen = READ_ONCE(lc_gen);
+	unsigned long irqflags;
+	unsigned int depth;
+
+	if (in_nmi())
+		return;
+
+	local_irq_save(irqflags);
+
+	if (lct->gen != gen) {
+		lct->gen = gen;
+		lct->depth = 0;
+	}
+
+	depth = lct->depth;
+
+	/*
+	 * A mutex starts waiting again when the optimistic spinning fails,
+	 * keep accounting from the first attempt.
+	 */
+	if (depth && lct->stack[depth - 1].lock == lock) {
+		lct->stack[depth - 1].flags = flags;
+		goto out;
+	}
+
+	if (depth == LOCK_CONTENTION_DEPTH)
+		goto out;
+
+	lct->stack[depth].lock = lock;
+	lct->stack[depth].flags = flags;
+	lct->stack[depth].ip = lc_callsite();
+	lct->stack[depth].start = local_clock();
+	lct->depth = depth + 1;
+out:
+	local_irq_restore(irqflags);
+}
+
+static struct lc_entry *lc_lookup(struct lc_table *table, unsigned long ip,
+				  unsigned int flags)
+{
+	unsigned int key = hash_long(ip ^ flags, LC_HASH_BITS);
+	struct lc_entry *entry;
+	unsigned int i;
+
+	for (i = 0; i < LC_HASH_SIZE; i++) {
+		entry = &table->entries[(key + i) & (LC_HASH_SIZE - 1)];
+
+		if (entry->ip == ip && entry->flags == flags && entry->count)
+			return entry;
+
+		if (!entry->count) {
+			entry->ip = ip;
+			entry->flags = flags;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void probe_contention_end(void *ignore, void *lock, int ret)
+{
+	struct lock_contention_task *lct = &current->lock_contention;
+	struct lc_table *table;
+	struct lc_entry *entry;
+	unsigned long irqflags;
+	unsigned long ip;
+	unsigned int flags;
+	int depth;
+	u64 delta;
+
+	if (in_nmi())
+		return;
+
+	local_irq_save(irqflags);
+
+	if (lct->gen != READ_ONCE(lc_gen))
+		goto out;
+
+	for (depth = lct->depth - 1; depth >= 0; depth--) {
+		if (lct->stack[depth].lock == lock)
+			break;
+	}
+
+	if (depth < 0)
+		goto out;
+
+	delta = local_clock() - lct->stack[depth].start;
+	ip = lct->stack[depth].ip;
+	flags = lct->stack[depth].flags;
+	lct->depth = depth;
+
+	table = this_cpu_ptr(lc_tables);
+	entry = lc_lookup(table, ip, flags);
+	if (!entry) {
+		table->dropped++;
+		goto out;
+	}
+
+	entry->hist[stat_log2_hist_bucket(delta, LC_HIST_SHIFT,
+					  LC_HIST_BUCKETS)]++;
+	entry->total += delta;
+	if (delta > entry->max)
+		entry->max = delta;
+	/* Published last, a zero count marks a free entry */
+	WRITE_ONCE(entry->count, entry->count + 1);
+out:
+	local_irq_restore(irqflags);
+}
+
+static void lc_reset(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(lc_tables, cpu), 0, sizeof(struct lc_table));
+}
+
+static int lc_start(void)
+{
+	int ret;
+
+	lockdep_assert_held(&lc_mutex);
+
+	if (!lc_tables) {
+		lc_tables = alloc_percpu(struct lc_table);
+		if (!lc_tables)
+			return -ENOMEM;
+	}
+
+	lc_reset();
+	WRITE_ONCE(lc_gen, lc_gen + 1);
+
+	ret = register_trace_contention_begin(probe_contention_begin, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_contention_end(probe_contention_end, NULL);
+	if (ret) {
+		unregister_trace_contention_begin(probe_contention_begin, NULL);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void lc_stop(void)
+{
+	lockdep_assert_held(&lc_mutex);
+
+	unregister_trace_contention_begin(probe_contention_begin, NULL);
+	unregister_trace_contention_end(probe_contention_end, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+/*
+ * trace_stat/lock_contention
+ *
+ * The per-cpu tables are merged into a list of entries when the file is
+ * opened, the stat framework then sorts them.
+ */
+struct lc_stat {
+	struct lc_entry		entry;
+	struct lc_stat		*next;
+};
+
+static struct lc_stat *lc_stat_find(struct lc_stat *head, unsigned long ip,
+				    unsigned int flags)
+{
+	for (; head; head = head->next) {
+		if (head->entry.ip == ip && head->entry.flags == flags)
+			return head;
+	}
+
+	return NULL;
+}
+
+static void *lc_stat_start(struct tracer_stat *trace)
+{
+	struct lc_stat *head = NULL, *stat;
+	struct lc_entry *entry;
+	int cpu, i, b;
+
+	mutex_lock(&lc_mutex);
+	if (!lc_tables)
+		goto out_unlock;
+
+	for_each_possible_cpu(cpu) {
+		struct lc_table *table = per_cpu_ptr(lc_tables, cpu);
+
+		for (i = 0; i < LC_HASH_SIZE; i++) {
+			entry = &table->entries[i];
+
+			if (!READ_ONCE(entry->count))
+				continue;
+
+			stat = lc_stat_find(head, entry->ip, entry->flags);
+			if (!stat) {
+				stat = kzalloc(sizeof(*stat), GFP_KERNEL);
+				if (!stat)
+					goto out_unlock;
+				stat->entry.ip = entry->ip;
+				stat->entry.flags = entry->flags;
+				stat->next = head;
+				head = stat;
+			}
+
+			stat->entry.count += entry->count;
+			stat->entry.total += entry->total;
+			stat->entry.max = max(stat->entry.max, entry->max);
+			for (b = 0; b < LC_HIST_BUCKETS; b++)
+				stat->entry.hist[b] += entry->hist[b];
+		}
+	}
+out_unlock:
+	mutex_unlock(&lc_mutex);
+
+	return head;
+}
+
+static void *lc_stat_next(void *v, int idx)
+{
+	struct lc_stat *stat = v;
+
+	return stat->next;
+}
+
+static int lc_stat_cmp(const void *p1, const void *p2)
+{
+	const struct lc_stat *a = p1;
+	const struct lc_stat *b = p2;
+
+	if (a->entry.total < b->entry.total)
+		return -1;
+	if (a->entry.total > b->entry.total)
+		return 1;
+	return 0;
+}
+
+static void lc_stat_release(void *v)
+{
+	kfree(v);
+}
+
+static const char *lc_type(unsigned int flags)
+{
+	if (flags & LCB_F_PERCPU)
+		return flags & LCB_F_WRITE ? "percpu-rwsem:W" : "percpu-rwsem:R";
+	if (flags & LCB_F_MUTEX)
+		return flags & LCB_F_SPIN ? "mutex:spin" : "mutex";
+	if (flags & LCB_F_RT)
+		return "rtmutex";
+	if (flags & LCB_F_SPIN) {
+		if (flags & LCB_F_READ)
+			return "rwlock:R";
+		if (flags & LCB_F_WRITE)
+			return "rwlock:W";
+		return "spinlock";
+	}
+	if (flags & LCB_F_READ)
+		return "rwsem:R";
+	if (flags & LCB_F_WRITE)
+		return "rwsem:W";
+	return "unknown";
+}
+
+static int lc_stat_headers(struct seq_file *m)
+{
+	unsigned long dropped = 0;
+	int cpu;
+
+	mutex_lock(&lc_mutex);
+	if (lc_tables) {
+		for_each_possible_cpu(cpu)
+			dropped += per_cpu_ptr(lc_tables, cpu)->dropped;
+	}
+	mutex_unlock(&lc_mutex);
+
+	seq_printf(m, "# dropped: %lu\n", dropped);
+	seq_puts(m, "# histogram buckets are log2 of the wait time, from <512ns to >=2s\n");
+	seq_printf(m, "# %-14s %12s %16s %14s %14s  %s\n",
+		   "type", "count", "total_ns", "avg_ns", "max_ns", "call site");
+	return 0;
+}
+
+static int lc_stat_show(struct seq_file *m, void *v)
+{
+	struct lc_stat *stat = v;
+	struct lc_entry *entry = &stat->entry;
+
+	seq_printf(m, "  %-14s %12llu %16llu %14llu %14llu  %pS\n",
+		   lc_type(entry->flags), entry->count, entry->total,
+		   div64_u64(entry->total, entry->count), entry->max,
+		   (void *)entry->ip);
+
+	seq_puts(m, "   ");
+	stat_log2_hist_show(m, entry->hist, LC_HIST_BUCKETS);
+
+	return 0;
+}
+
+static struct tracer_stat lock_contention_stats = {
+	.name		= "lock_contention",
+	.stat_start	= lc_stat_start,
+	.stat_next	= lc_stat_next,
+	.stat_cmp	= lc_stat_cmp,
+	.stat_headers	= lc_stat_headers,
+	.stat_show	= lc_stat_show,
+	.stat_release	= lc_stat_release,
+};
+
+static ssize_t
+lock_profile_write(struct file *filp, const char __user *ubuf,
+		   size_t cnt, loff_t *ppos)
+{
+	return stat_switch_write(ubuf, cnt, ppos, &lc_mutex, &lc_enabled,
+				 lc_start, lc_stop);
+}
+
+static ssize_t
+lock_profile_read(struct file *filp, char __user *ubuf,
+		  size_t cnt, loff_t *ppos)
+{
+	char buf[64];
+	int r;
+
+	r = sprintf(buf, "%u\n", lc_enabled);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static const struct file_operations lock_profile_fops = {
+	.open		= tracing_open_generic,
+	.read		= lock_profile_read,
+	.write		= lock_profile_write,
+	.llseek		= default_llseek,
+};
+
+static int __init lock_profile_setup(char *str)
+{
+	lc_enable_at_boot = true;
+	return 1;
+}
+__setup("lock_profile", lock_profile_setup);
+
+static __init int init_lock_contention_profile(void)
+{
+	int ret;
+
+	ret = tracing_init_dentry();
+	if (ret)
+		return 0;
+
+	ret = register_stat_tracer(&lock_contention_stats);
+	if (ret) {
+		pr_warn("Warning: could not register lock contention stats\n");
+		return 0;
+	}
+
+	trace_create_file("lock_profile_enabled", TRACE_MODE_WRITE, NULL,
+			  NULL, &lock_profile_fops);
+
+	if (lc_enable_at_boot) {
+		mutex_lock(&lc_mutex);
+		if (!lc_start())
+			lc_enabled = true;
+		mutex_unlock(&lc_mutex);
+	}
+
+	return 0;
+}
+fs_initcall(init_lock_contention_profile);
@@ -80,6 +80,16 @@ struct osnoise_instance {
 
 static struct list_head osnoise_instances;
 
+/*
+ * osnoise_accounting: account the noise without tracing nor workload.
+ *
+ * Set via osnoise/accounting, it hooks the noise events and keeps the
+ * per-cpu counters and total noise running, so that osnoise/summary can
+ * be sampled periodically. It is mutually exclusive with the osnoise and
+ * timerlat tracers, and it is protected by the trace_types_lock.
+ */
+static bool osnoise_accounting;
+
 static bool osnoise_has_registered_instances(void)
 {
 	return !!list_first_or_null_rcu(&osnoise_instances,
@@ -169,6 +179,7 @@ static void osnoise_unregister_instance(struct trace_array *tr)
 struct osn_nmi {
 	u64	count;
 	u64	delta_start;
+	u64	total;
 };
 
 /*
@@ -178,6 +189,7 @@ struct osn_irq {
 	u64	count;
 	u64	arrival_time;
 	u64	delta_start;
+	u64	total;
 };
 
 #define IRQ_CONTEXT	0
@@ -189,6 +201,7 @@ struct osn_softirq {
 	u64	count;
 	u64	arrival_time;
 	u64	delta_start;
+	u64	total;
 };
 
 /*
@@ -198,6 +211,7 @@ struct osn_thread {
 	u64	count;
 	u64	arrival_time;
 	u64	delta_start;
+	u64	total;
 };
 
 /*
@@ -889,8 +903,9 @@ void trace_osnoise_callback(bool enter)
 		if (enter) {
 			osn_var->nmi.delta_start = time_get();
 			local_inc(&osn_var->int_counter);
-		} else {
+		} else if (osn_var->nmi.delta_start) {
 			duration = time_get() - osn_var->nmi.delta_start;
+			osn_var->nmi.total += duration;
 
 			trace_nmi_noise(osn_var->nmi.delta_start, duration);
 
@@ -944,7 +959,14 @@ void osnoise_trace_irq_exit(int id, const char *desc)
 	if (!osn_var->sampling)
 		return;
 
+	/*
+	 * The IRQ started before the sampling.
+	 */
+	if (!osn_var->irq.delta_start)
+		return;
+
 	duration = get_int_safe_duration(osn_var, &osn_var->irq.delta_start);
+	osn_var->irq.total += duration;
 	trace_irq_noise(id, desc, osn_var->irq.arrival_time, duration);
 	osn_var->irq.arrival_time = 0;
 	cond_move_softirq_delta_start(osn_var, duration);
@@ -1079,7 +1101,14 @@ static void trace_softirq_exit_callback(void *data, unsigned int vec_nr)
 		if (!timerlat_softirq_exit(osn_var))
 			return;
 
+	/*
+	 * The softirq started before the sampling.
+	 */
+	if (!osn_var->softirq.delta_start)
+		return;
+
 	duration = get_int_safe_duration(osn_var, &osn_var->softirq.delta_start);
+	osn_var->softirq.total += duration;
 	trace_softirq_noise(vec_nr, osn_var->softirq.arrival_time, duration);
 	cond_move_thread_delta_start(osn_var, duration);
 	osn_var->softirq.arrival_time = 0;
@@ -1176,6 +1205,7 @@ thread_exit(struct osnoise_variables *osn_var, struct task_struct *t)
 			return;
 
 	duration = get_int_safe_duration(osn_var, &osn_var->thread.delta_start);
+	osn_var->thread.total += duration;
 
 	trace_thread_noise(t, osn_var->thread.arrival_time, duration);
 
@@ -1197,6 +1227,22 @@ trace_sched_switch_callback(void *data, bool preempt,
 	struct osnoise_variables *osn_var = this_cpu_osn_var();
 	int workload = test_bit(OSN_WORKLOAD, &osnoise_options);
 
+	/*
+	 * Without a workload, the user-space tasks are the workload, and
+	 * only the kernel threads are noise. A zero thread.delta_start
+	 * means that no kernel thread window is open.
+	 */
+	if (unlikely(osnoise_accounting)) {
+		if (osn_var->thread.delta_start) {
+			thread_exit(osn_var, p);
+			osn_var->thread.delta_start = 0;
+		}
+
+		if ((n->flags & PF_KTHREAD) && !is_idle_task(n))
+			thread_entry(osn_var, n);
+		return;
+	}
+
 	if ((p->pid != osn_var->pid) || !workload)
 		thread_exit(osn_var, p);
 
@@ -1868,6 +1914,24 @@ static int start_per_cpu_kthreads(void)
 	return retval;
 }
 
+/*
+ * osnoise_accounting_sampling - Enable the accounting on a CPU
+ *
+ * Start sampling on @cpu if it is part of osnoise/cpus, stop otherwise.
+ * The thread window is closed, as the running thread was not seen
+ * arriving.
+ */
+static void osnoise_accounting_sampling(unsigned int cpu)
+{
+	struct osnoise_variables *osn_var = per_cpu_ptr(&per_cpu_osnoise_var, cpu);
+
+	osn_var->sampling = false;
+	barrier();
+	osn_var->thread.delta_start = 0;
+	barrier();
+	osn_var->sampling = cpumask_test_cpu(cpu, &osnoise_cpumask);
+}
+
 #ifdef CONFIG_HOTPLUG_CPU
 static void osnoise_hotplug_workfn(struct work_struct *dummy)
 {
@@ -1875,6 +1939,11 @@ static void osnoise_hotplug_workfn(struct work_struct *dummy)
 
 	mutex_lock(&trace_types_lock);
 
+	if (osnoise_accounting) {
+		osnoise_accounting_sampling(cpu);
+		goto out_unlock_trace;
+	}
+
 	if (!osnoise_has_registered_instances())
 		goto out_unlock_trace;
 
@@ -2169,6 +2238,13 @@ osnoise_cpus_write(struct file *filp, const char __user *ubuf, size_t count,
 
 	cpumask_copy(&osnoise_cpumask, osnoise_cpumask_new);
 
+	if (osnoise_accounting) {
+		int cpu;
+
+		for_each_online_cpu(cpu)
+			osnoise_accounting_sampling(cpu);
+	}
+
 	cpus_read_unlock();
 	mutex_unlock(&interface_lock);
 
@@ -2257,6 +2333,124 @@ static const struct file_operations cpus_fops = {
 	.llseek		= generic_file_llseek,
 };
 
+static int osnoise_accounting_start(void);
+static void osnoise_accounting_stop(void);
+
+/*
+ * osnoise_accounting_read - Read function for "accounting" entry
+ */
+static ssize_t
+osnoise_accounting_read(struct file *filp, char __user *ubuf, size_t count,
+			loff_t *ppos)
+{
+	char buf[4];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%d\n", READ_ONCE(osnoise_accounting));
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+/*
+ * osnoise_accounting_write - Write function for "accounting" entry
+ * @filp: The active open file structure
+ * @ubuf: The user buffer that contains the value to write
+ * @cnt: The maximum number of bytes to write to "file"
+ * @ppos: The current position in @file
+ *
+ * Writing 1 hooks the noise events and starts accounting the noise on
+ * the CPUs in osnoise/cpus, without dispatching the workload nor tracing.
+ * The results are read from osnoise/summary. Writing 0 stops it. The
+ * accounting cannot run along with the osnoise or timerlat tracers, as
+ * they reset and own the same per-cpu variables.
+ */
+static ssize_t
+osnoise_accounting_write(struct file *filp, const char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	bool enable;
+	int retval;
+
+	retval = kstrtobool_from_user(ubuf, cnt, &enable);
+	if (retval)
+		return retval;
+
+	mutex_lock(&trace_types_lock);
+	if (enable == osnoise_accounting)
+		goto out_unlock;
+
+	if (enable) {
+		if (osnoise_has_registered_instances()) {
+			retval = -EBUSY;
+			goto out_unlock;
+		}
+		retval = osnoise_accounting_start();
+	} else {
+		osnoise_accounting_stop();
+	}
+
+out_unlock:
+	mutex_unlock(&trace_types_lock);
+
+	return retval ? retval : cnt;
+}
+
+/*
+ * osnoise_summary_show - Print the per-cpu noise accounting
+ *
+ * For each online CPU, prints the number of occurrences and the total
+ * noise, in nanoseconds, of each noise class. The values are cumulative
+ * since the accounting, or the last osnoise/timerlat tracer, started.
+ * They are read without synchronization with the CPU updating them, so
+ * a line might be off by the noise being accounted at the time.
+ */
+static int osnoise_summary_show(struct seq_file *s, void *v)
+{
+	struct osnoise_variables *osn_var;
+	int cpu;
+
+	seq_printf(s, "# %-5s %12s %16s %12s %16s %12s %16s %12s %16s\n",
+		   "CPU", "NMI", "NMI_NS", "IRQ", "IRQ_NS",
+		   "SOFTIRQ", "SOFTIRQ_NS", "THREAD", "THREAD_NS");
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		osn_var = per_cpu_ptr(&per_cpu_osnoise_var, cpu);
+		seq_printf(s, "  %-5d %12llu %16llu %12llu %16llu %12llu %16llu %12llu %16llu\n",
+			   cpu,
+			   READ_ONCE(osn_var->nmi.count),
+			   READ_ONCE(osn_var->nmi.total),
+			   READ_ONCE(osn_var->irq.count),
+			   READ_ONCE(osn_var->irq.total),
+			   READ_ONCE(osn_var->softirq.count),
+			   READ_ONCE(osn_var->softirq.total),
+			   READ_ONCE(osn_var->thread.count),
+			   READ_ONCE(osn_var->thread.total));
+	}
+	cpus_read_unlock();
+
+	return 0;
+}
+
+static int osnoise_summary_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, osnoise_summary_show, NULL);
+}
+
+static const struct file_operations osnoise_accounting_fops = {
+	.open		= tracing_open_generic,
+	.read		= osnoise_accounting_read,
+	.write		= osnoise_accounting_write,
+	.llseek		= generic_file_llseek,
+};
+
+static const struct file_operations osnoise_summary_fops = {
+	.open		= osnoise_summary_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static const struct file_operations osnoise_options_fops = {
 	.open		= osnoise_options_open,
 	.read		= seq_read,
@@ -2356,6 +2550,16 @@ static int init_tracefs(void)
 	if (!tmp)
 		goto err;
 
+	tmp = trace_create_file("accounting", TRACE_MODE_WRITE, top_dir, NULL,
+				&osnoise_accounting_fops);
+	if (!tmp)
+		goto err;
+
+	tmp = trace_create_file("summary", TRACE_MODE_READ, top_dir, NULL,
+				&osnoise_summary_fops);
+	if (!tmp)
+		goto err;
+
 	ret = init_timerlat_tracefs(top_dir);
 	if (ret)
 		goto err;
@@ -2490,6 +2694,70 @@ static void osnoise_workload_stop(void)
 	osnoise_unhook_events();
 }
 
+/*
+ * osnoise_accounting_start - hook to events and account the noise
+ *
+ * Like osnoise_workload_start(), but without dispatching the workload:
+ * the CPUs in osnoise/cpus are set to sample, and the noise is accounted
+ * while the user-space tasks run. Called with the trace_types_lock held.
+ */
+static int osnoise_accounting_start(void)
+{
+	int retval;
+	int cpu;
+
+	lockdep_assert_held(&trace_types_lock);
+
+	osn_var_reset_all();
+
+	retval = osnoise_hook_events();
+	if (retval)
+		return retval;
+
+	/*
+	 * Make sure that ftrace_nmi_enter/exit() see reset values
+	 * before enabling trace_osnoise_callback_enabled.
+	 */
+	barrier();
+	trace_osnoise_callback_enabled = true;
+	osnoise_accounting = true;
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu)
+		osnoise_accounting_sampling(cpu);
+	cpus_read_unlock();
+
+	return 0;
+}
+
+/*
+ * osnoise_accounting_stop - stop the accounting and unhook the events
+ *
+ * The counters are kept, so the last values can still be read from
+ * osnoise/summary.
+ */
+static void osnoise_accounting_stop(void)
+{
+	int cpu;
+
+	lockdep_assert_held(&trace_types_lock);
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu)
+		per_cpu(per_cpu_osnoise_var, cpu).sampling = false;
+	cpus_read_unlock();
+
+	trace_osnoise_callback_enabled = false;
+	/*
+	 * Make sure that ftrace_nmi_enter/exit() see
+	 * trace_osnoise_callback_enabled as false before continuing.
+	 */
+	barrier();
+
+	osnoise_unhook_events();
+	osnoise_accounting = false;
+}
+
 static void osnoise_tracer_start(struct trace_array *tr)
 {
 	int retval;
@@ -2520,7 +2788,7 @@ static int osnoise_tracer_init(struct trace_array *tr)
 	 * Only allow osnoise tracer if timerlat tracer is not running
 	 * already.
 	 */
-	if (timerlat_enabled())
+	if (timerlat_enabled() || osnoise_accounting)
 		return -EBUSY;
 
 	tr->max_latency = 0;
@@ -2590,6 +2858,12 @@ static int timerlat_tracer_init(struct trace_array *tr)
 	if (osnoise_has_registered_instances() && !osnoise_data.timerlat_tracer)
 		return -EBUSY;
 
+	/*
+	 * Nor if the osnoise accounting is running.
+	 */
+	if (osnoise_accounting)
+		return -EBUSY;
+
 	/*
 	 * If this is the first instance, set timerlat_tracer to block
 	 * osnoise tracer start.
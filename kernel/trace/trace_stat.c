@@ -362,3 +362,39 @@ void unregister_stat_tracer(struct tracer_stat *trace)
 	}
 	mutex_unlock(&all_stat_sessions_mutex);
 }
+
+ssize_t stat_switch_write(const char __user *ubuf, size_t cnt,
+			  loff_t *ppos, struct mutex *lock,
+			  bool *enabled, int (*start)(void),
+			  void (*stop)(void))
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	val = !!val;
+
+	mutex_lock(lock);
+	if (*enabled ^ val) {
+		if (val) {
+			ret = start();
+			if (ret < 0) {
+				cnt = ret;
+				goto out;
+			}
+			*enabled = true;
+		} else {
+			*enabled = false;
+			stop();
+		}
+	}
+ out:
+	mutex_unlock(lock);
+
+	*ppos += cnt;
+
+	return cnt;
+}
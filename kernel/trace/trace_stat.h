@@ -3,6 +3,7 @@
 #define __TRACE_STAT_H
 
 #include <linux/seq_file.h>
+#include <linux/log2.h>
 
 /*
  * If you want to provide a stat file (one-shot statistics), fill
@@ -31,4 +32,41 @@ struct tracer_stat {
 extern int register_stat_tracer(struct tracer_stat *trace);
 extern void unregister_stat_tracer(struct tracer_stat *trace);
 
+/*
+ * Write handler of a file switching a profiler on or off: parses a
+ * boolean and, under @lock, calls @start or @stop when *@enabled changes.
+ */
+extern ssize_t stat_switch_write(const char __user *ubuf, size_t cnt,
+				 loff_t *ppos, struct mutex *lock,
+				 bool *enabled, int (*start)(void),
+				 void (*stop)(void));
+
+/*
+ * Log2 histograms of durations in nanoseconds: bucket 0 counts everything
+ * below 2^(@shift + 1) ns, bucket b the durations in [2^(@shift + b),
+ * 2^(@shift + b + 1)) ns, and the last one everything longer.
+ */
+static inline int stat_log2_hist_bucket(u64 delta, int shift, int nr_buckets)
+{
+	int bucket = delta ? ilog2(delta) - shift : 0;
+
+	return clamp(bucket, 0, nr_buckets - 1);
+}
+
+/* Print the buckets up to the last non-empty one */
+static inline void stat_log2_hist_show(struct seq_file *m, const u32 *hist,
+				       int nr_buckets)
+{
+	int b, last = 0;
+
+	for (b = 0; b < nr_buckets; b++) {
+		if (hist[b])
+			last = b;
+	}
+
+	for (b = 0; b <= last; b++)
+		seq_printf(m, " %u", hist[b]);
+	seq_putc(m, '\n');
+}
+
 #endif /* __TRACE_STAT_H */
@@ -0,0 +1,583 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Wakeup latency profiler
+ *
+ * Breaks down the wakeup-to-run latency of every wakeup in four phases,
+ * accumulated per scheduling class and per cgroup with log2 histograms:
+ *
+ *   queue:    from sched_waking until the task is enqueued on its runqueue,
+ *             or queued on the wake list of a remote CPU
+ *   ipi:      from the remote wake list until the target CPU enqueued it
+ *   runnable: from the enqueue until the task runs, waiting behind others
+ *   preempt:  from the enqueue until the task runs, when the wakeup marked
+ *             the running task for preemption
+ *
+ * Unlike the wakeup tracers, which keep the worst case of the highest
+ * priority task, it looks at all the wakeups. It only hooks tracepoints,
+ * and keeps the timestamps in the task_struct, so it is cheap enough to be
+ * left enabled in production. Enable it with:
+ *
+ *   echo 1 > /sys/kernel/tracing/wakeup_latency_enabled
+ *
+ * or with "wakeup_latency" on the kernel command line, and read the results
+ * from trace_stat/wakeup_latency.
+ */
+#include <linux/cgroup.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/deadline.h>
+#include <linux/sched/rt.h>
+#include <linux/slab.h>
+#include <linux/tracefs.h>
+#include <trace/events/sched.h>
+
+#include "trace.h"
+#include "trace_stat.h"
+
+#define WL_HASH_BITS		7
+#define WL_HASH_SIZE		(1 << WL_HASH_BITS)
+#define WL_HIST_SHIFT		8	/* first bucket: < 512ns */
+#define WL_HIST_BUCKETS		24	/* last bucket: >= 2s */
+
+enum {
+	WL_CLASS_DL,
+	WL_CLASS_RT,
+	WL_CLASS_FAIR,
+	WL_CLASS_IDLE,
+};
+
+static const char * const wl_class_names[] = {
+	[WL_CLASS_DL]	= "dl",
+	[WL_CLASS_RT]	= "rt",
+	[WL_CLASS_FAIR]	= "fair",
+	[WL_CLASS_IDLE]	= "idle",
+};
+
+enum {
+	WL_QUEUE,
+	WL_IPI,
+	WL_RUNNABLE,
+	WL_PREEMPT,
+	WL_NR_PHASES,
+};
+
+static const char * const wl_phase_names[] = {
+	[WL_QUEUE]	= "queue",
+	[WL_IPI]	= "ipi",
+	[WL_RUNNABLE]	= "runnable",
+	[WL_PREEMPT]	= "preempt",
+};
+
+struct wl_phase {
+	u64			count;
+	u64			total;
+	u64			max;
+	u32			hist[WL_HIST_BUCKETS];
+};
+
+/*
+ * Accumulated wakeup latencies of the tasks of one scheduling class in
+ * one cgroup.
+ */
+struct wl_entry {
+	u64			cgroup;
+	unsigned int		class;
+	u64			count;
+	struct wl_phase		phase[WL_NR_PHASES];
+};
+
+struct wl_table {
+	struct wl_entry		entries[WL_HASH_SIZE];
+	unsigned long		dropped;
+};
+
+/* Too large for alloc_percpu(), allocated per cpu on first enable */
+static DEFINE_PER_CPU(struct wl_table *, wl_tables);
+static bool wl_allocated;
+static DEFINE_MUTEX(wl_mutex);
+static bool wl_enabled;
+static bool wl_enable_at_boot __initdata;
+
+/*
+ * Bumped on every enable, so that the stale timestamps a task may have
+ * left from a previous session are discarded.
+ */
+static unsigned int wl_gen;
+
+static unsigned int wl_class(struct task_struct *p)
+{
+	if (dl_prio(p->prio))
+		return WL_CLASS_DL;
+	if (rt_prio(p->prio))
+		return WL_CLASS_RT;
+	if (p->policy == SCHED_IDLE)
+		return WL_CLASS_IDLE;
+	return WL_CLASS_FAIR;
+}
+
+static u64 wl_cgroup(struct task_struct *p)
+{
+#ifdef CONFIG_CGROUPS
+	u64 id;
+
+	rcu_read_lock();
+	id = cgroup_id(task_dfl_cgroup(p));
+	rcu_read_unlock();
+
+	return id;
+#else
+	return 0;
+#endif
+}
+
+/* The timestamps may come from different CPUs, never go negative */
+static inline u64 wl_delta(u64 start, u64 end)
+{
+	return end > start ? end - start : 0;
+}
+
+static void probe_sched_waking(void *ignore, struct task_struct *p)
+{
+	struct wakeup_latency_task *wlt = &p->wakeup_latency;
+
+	/* Called with p->pi_lock held, which serializes the wakeups */
+	wlt->gen = READ_ONCE(wl_gen);
+	wlt->queued = 0;
+	wlt->wakeup = 0;
+	wlt->preempt = 0;
+	wlt->waking = local_clock();
+}
+
+static void probe_ttwu_queue(void *ignore, struct task_struct *p, int cpu)
+{
+	struct wakeup_latency_task *wlt = &p->wakeup_latency;
+
+	if (wlt->gen == READ_ONCE(wl_gen) && wlt->waking)
+		wlt->queued = local_clock();
+}
+
+static void probe_wakeup_preempt(void *ignore, struct task_struct *p,
+				 bool preempt)
+{
+	struct wakeup_latency_task *wlt = &p->wakeup_latency;
+
+	if (wlt->gen != READ_ONCE(wl_gen) || !wlt->waking || wlt->wakeup)
+		return;
+
+	wlt->preempt = preempt;
+	wlt->wakeup = local_clock();
+}
+
+static struct wl_entry *wl_lookup(struct wl_table *table, u64 cgroup,
+				  unsigned int class)
+{
+	unsigned int key = hash_64(cgroup * ARRAY_SIZE(wl_class_names) + class,
+				   WL_HASH_BITS);
+	struct wl_entry *entry;
+	unsigned int i;
+
+	for (i = 0; i < WL_HASH_SIZE; i++) {
+		entry = &table->entries[(key + i) & (WL_HASH_SIZE - 1)];
+
+		if (entry->cgroup == cgroup && entry->class == class &&
+		    entry->count)
+			return entry;
+
+		if (!entry->count) {
+			entry->cgroup = cgroup;
+			entry->class = class;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void wl_account(struct wl_entry *entry, int phase, u64 delta)
+{
+	struct wl_phase *wp = &entry->phase[phase];
+
+	wp->hist[stat_log2_hist_bucket(delta, WL_HIST_SHIFT, WL_HIST_BUCKETS)]++;
+	wp->total += delta;
+	if (delta > wp->max)
+		wp->max = delta;
+	wp->count++;
+}
+
+static void
+probe_sched_switch(void *ignore, bool preempt, struct task_struct *prev,
+		   struct task_struct *next, unsigned int prev_state)
+{
+	struct wakeup_latency_task *wlt = &next->wakeup_latency;
+	struct wl_table *table;
+	struct wl_entry *entry;
+	u64 now;
+
+	/*
+	 * A task that stays runnable was woken while it was still running,
+	 * there is nothing to measure the next time it is switched in. A
+	 * task going to sleep keeps its timestamps: it may already be
+	 * woken by another CPU which waits for it to be switched out.
+	 */
+	if (preempt || prev_state == TASK_RUNNING)
+		prev->wakeup_latency.waking = 0;
+
+	if (!wlt->waking)
+		return;
+
+	if (wlt->gen != READ_ONCE(wl_gen) || !wlt->wakeup)
+		goto out;
+
+	now = local_clock();
+
+	/* Called with the rq lock held and interrupts disabled */
+	table = *this_cpu_ptr(&wl_tables);
+	entry = wl_lookup(table, wl_cgroup(next), wl_class(next));
+	if (!entry) {
+		table->dropped++;
+		goto out;
+	}
+
+	if (wlt->queued) {
+		wl_account(entry, WL_QUEUE, wl_delta(wlt->waking, wlt->queued));
+		wl_account(entry, WL_IPI, wl_delta(wlt->queued, wlt->wakeup));
+	} else {
+		wl_account(entry, WL_QUEUE, wl_delta(wlt->waking, wlt->wakeup));
+	}
+
+	wl_account(entry, wlt->preempt ? WL_PREEMPT : WL_RUNNABLE,
+		   wl_delta(wlt->wakeup, now));
+
+	/* Published last, a zero count marks a free entry */
+	WRITE_ONCE(entry->count, entry->count + 1);
+out:
+	wlt->waking = 0;
+}
+
+static int wl_alloc(void)
+{
+	struct wl_table *table;
+	int cpu;
+
+	if (wl_allocated)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		if (per_cpu(wl_tables, cpu))
+			continue;
+		table = kvzalloc_node(sizeof(*table), GFP_KERNEL,
+				      cpu_to_node(cpu));
+		if (!table)
+			return -ENOMEM;
+		per_cpu(wl_tables, cpu) = table;
+	}
+
+	wl_allocated = true;
+	return 0;
+}
+
+static void wl_reset(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(wl_tables, cpu), 0, sizeof(struct wl_table));
+}
+
+static int wl_start(void)
+{
+	int ret;
+
+	lockdep_assert_held(&wl_mutex);
+
+	ret = wl_alloc();
+	if (ret)
+		return ret;
+
+	wl_reset();
+	WRITE_ONCE(wl_gen, wl_gen + 1);
+
+	ret = register_trace_sched_waking(probe_sched_waking, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_sched_ttwu_queue_tp(probe_ttwu_queue, NULL);
+	if (ret)
+		goto fail_waking;
+
+	ret = register_trace_sched_wakeup_preempt_tp(probe_wakeup_preempt, NULL);
+	if (ret)
+		goto fail_queue;
+
+	ret = register_trace_sched_switch(probe_sched_switch, NULL);
+	if (ret)
+		goto fail_preempt;
+
+	return 0;
+
+fail_preempt:
+	unregister_trace_sched_wakeup_preempt_tp(probe_wakeup_preempt, NULL);
+fail_queue:
+	unregister_trace_sched_ttwu_queue_tp(probe_ttwu_queue, NULL);
+fail_waking:
+	unregister_trace_sched_waking(probe_sched_waking, NULL);
+	return ret;
+}
+
+static void wl_stop(void)
+{
+	lockdep_assert_held(&wl_mutex);
+
+	unregister_trace_sched_switch(probe_sched_switch, NULL);
+	unregister_trace_sched_wakeup_preempt_tp(probe_wakeup_preempt, NULL);
+	unregister_trace_sched_ttwu_queue_tp(probe_ttwu_queue, NULL);
+	unregister_trace_sched_waking(probe_sched_waking, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+/*
+ * trace_stat/wakeup_latency
+ *
+ * The per-cpu tables are merged into a list of entries when the file is
+ * opened, the stat framework then sorts them.
+ */
+struct wl_stat {
+	struct wl_entry		entry;
+	u64			total;
+	struct wl_stat		*next;
+};
+
+static struct wl_stat *wl_stat_find(struct wl_stat *head, u64 cgroup,
+				    unsigned int class)
+{
+	for (; head; head = head->next) {
+		if (head->entry.cgroup == cgroup && head->entry.class == class)
+			return head;
+	}
+
+	return NULL;
+}
+
+static void wl_stat_merge(struct wl_stat *stat, struct wl_entry *entry)
+{
+	int p, b;
+
+	stat->entry.count += entry->count;
+
+	for (p = 0; p < WL_NR_PHASES; p++) {
+		struct wl_phase *dst = &stat->entry.phase[p];
+		struct wl_phase *src = &entry->phase[p];
+
+		dst->count += src->count;
+		dst->total += src->total;
+		dst->max = max(dst->max, src->max);
+		for (b = 0; b < WL_HIST_BUCKETS; b++)
+			dst->hist[b] += src->hist[b];
+
+		stat->total += src->total;
+	}
+}
+
+static void *wl_stat_start(struct tracer_stat *trace)
+{
+	struct wl_stat *head = NULL, *stat;
+	struct wl_entry *entry;
+	int cpu, i;
+
+	mutex_lock(&wl_mutex);
+	if (!wl_allocated)
+		goto out_unlock;
+
+	for_each_possible_cpu(cpu) {
+		struct wl_table *table = per_cpu(wl_tables, cpu);
+
+		for (i = 0; i < WL_HASH_SIZE; i++) {
+			entry = &table->entries[i];
+
+			if (!READ_ONCE(entry->count))
+				continue;
+
+			stat = wl_stat_find(head, entry->cgroup, entry->class);
+			if (!stat) {
+				stat = kzalloc(sizeof(*stat), GFP_KERNEL);
+				if (!stat)
+					goto out_unlock;
+				stat->entry.cgroup = entry->cgroup;
+				stat->entry.class = entry->class;
+				stat->next = head;
+				head = stat;
+			}
+
+			wl_stat_merge(stat, entry);
+		}
+	}
+out_unlock:
+	mutex_unlock(&wl_mutex);
+
+	return head;
+}
+
+static void *wl_stat_next(void *v, int idx)
+{
+	struct wl_stat *stat = v;
+
+	return stat->next;
+}
+
+static int wl_stat_cmp(const void *p1, const void *p2)
+{
+	const struct wl_stat *a = p1;
+	const struct wl_stat *b = p2;
+
+	if (a->total < b->total)
+		return -1;
+	if (a->total > b->total)
+		return 1;
+	return 0;
+}
+
+static void wl_stat_release(void *v)
+{
+	kfree(v);
+}
+
+static int wl_stat_headers(struct seq_file *m)
+{
+	unsigned long dropped = 0;
+	int cpu;
+
+	mutex_lock(&wl_mutex);
+	if (wl_allocated) {
+		for_each_possible_cpu(cpu)
+			dropped += per_cpu(wl_tables, cpu)->dropped;
+	}
+	mutex_unlock(&wl_mutex);
+
+	seq_printf(m, "# dropped: %lu\n", dropped);
+	seq_puts(m, "# queue:    sched_waking until enqueued, or queued on a remote wake list\n");
+	seq_puts(m, "# ipi:      remote wake list until enqueued by the target CPU\n");
+	seq_puts(m, "# runnable: enqueued until switched in, behind other tasks\n");
+	seq_puts(m, "# preempt:  enqueued until switched in, after preempting the current task\n");
+	seq_puts(m, "# histogram buckets are log2 of the latency, from <512ns to >=2s\n");
+	seq_printf(m, "# %-10s %12s %16s %14s %14s  %s\n",
+		   "phase", "count", "total_ns", "avg_ns", "max_ns", "histogram");
+	return 0;
+}
+
+static void wl_stat_show_cgroup(struct seq_file *m, u64 id)
+{
+#ifdef CONFIG_CGROUPS
+	struct cgroup *cgrp;
+	char path[128];
+
+	cgrp = cgroup_get_from_id(id);
+	if (IS_ERR(cgrp))
+		return;
+
+	if (cgroup_path(cgrp, path, sizeof(path)) >= 0)
+		seq_printf(m, " %s", path);
+	cgroup_put(cgrp);
+#endif
+}
+
+static int wl_stat_show(struct seq_file *m, void *v)
+{
+	struct wl_stat *stat = v;
+	struct wl_entry *entry = &stat->entry;
+	int p;
+
+	seq_printf(m, "%s cgroup %llu", wl_class_names[entry->class],
+		   entry->cgroup);
+	wl_stat_show_cgroup(m, entry->cgroup);
+	seq_printf(m, " wakeups %llu\n", entry->count);
+
+	for (p = 0; p < WL_NR_PHASES; p++) {
+		struct wl_phase *wp = &entry->phase[p];
+
+		if (!wp->count)
+			continue;
+
+		seq_printf(m, "  %-10s %12llu %16llu %14llu %14llu ",
+			   wl_phase_names[p], wp->count, wp->total,
+			   div64_u64(wp->total, wp->count), wp->max);
+
+		stat_log2_hist_show(m, wp->hist, WL_HIST_BUCKETS);
+	}
+
+	return 0;
+}
+
+static struct tracer_stat wakeup_latency_stats = {
+	.name		= "wakeup_latency",
+	.stat_start	= wl_stat_start,
+	.stat_next	= wl_stat_next,
+	.stat_cmp	= wl_stat_cmp,
+	.stat_headers	= wl_stat_headers,
+	.stat_show	= wl_stat_show,
+	.stat_release	= wl_stat_release,
+};
+
+static ssize_t
+wakeup_latency_write(struct file *filp, const char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	return stat_switch_write(ubuf, cnt, ppos, &wl_mutex, &wl_enabled,
+				 wl_start, wl_stop);
+}
+
+static ssize_t
+wakeup_latency_read(struct file *filp, char __user *ubuf,
+		    size_t cnt, loff_t *ppos)
+{
+	char buf[64];
+	int r;
+
+	r = sprintf(buf, "%u\n", wl_enabled);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static const struct file_operations wakeup_latency_fops = {
+	.open		= tracing_open_generic,
+	.read		= wakeup_latency_read,
+	.write		= wakeup_latency_write,
+	.llseek		= default_llseek,
+};
+
+static int __init wakeup_latency_setup(char *str)
+{
+	wl_enable_at_boot = true;
+	return 1;
+}
+__setup("wakeup_latency", wakeup_latency_setup);
+
+static __init int init_wakeup_latency_profile(void)
+{
+	int ret;
+
+	ret = tracing_init_dentry();
+	if (ret)
+		return 0;
+
+	ret = register_stat_tracer(&wakeup_latency_stats);
+	if (ret) {
+		pr_warn("Warning: could not register wakeup latency stats\n");
+		return 0;
+	}
+
+	trace_create_file("wakeup_latency_enabled", TRACE_MODE_WRITE, NULL,
+			  NULL, &wakeup_latency_fops);
+
+	if (wl_enable_at_boot) {
+		mutex_lock(&wl_mutex);
+		if (!wl_start())
+			wl_enabled = true;
+		mutex_unlock(&wl_mutex);
+	}
+
+	return 0;
+}
+fs_initcall(init_wakeup_latency_profile);
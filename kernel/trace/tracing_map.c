@@ -535,7 +535,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 			if (val &&
 			    keys_match(key, val->key, map->key_size)) {
 				if (!lookup_only)
-					atomic64_inc(&map->hits);
+					this_cpu_inc(map->stats->hits);
 				return val;
 			} else if (unlikely(!val)) {
 				/*
@@ -552,7 +552,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 
 				dup_try++;
 				if (dup_try > map->map_size) {
-					atomic64_inc(&map->drops);
+					this_cpu_inc(map->stats->drops);
 					break;
 				}
 				continue;
@@ -568,14 +568,14 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 
 				elt = get_free_elt(map);
 				if (!elt) {
-					atomic64_inc(&map->drops);
+					this_cpu_inc(map->stats->drops);
 					entry->key = 0;
 					break;
 				}
 
 				memcpy(elt->key, key, map->key_size);
 				entry->val = elt;
-				atomic64_inc(&map->hits);
+				this_cpu_inc(map->stats->hits);
 
 				return entry->val;
 			} else {
@@ -676,6 +676,7 @@ void tracing_map_destroy(struct tracing_map *map)
 	tracing_map_free_elts(map);
 
 	tracing_map_array_free(map->map);
+	free_percpu(map->stats);
 	kfree(map);
 }
 
@@ -693,10 +694,12 @@ void tracing_map_destroy(struct tracing_map *map)
 void tracing_map_clear(struct tracing_map *map)
 {
 	unsigned int i;
+	int cpu;
 
 	atomic_set(&map->next_elt, -1);
-	atomic64_set(&map->hits, 0);
-	atomic64_set(&map->drops, 0);
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(map->stats, cpu), 0,
+		       sizeof(struct tracing_map_stats));
 
 	tracing_map_array_clear(map->map);
 
@@ -704,6 +707,45 @@ void tracing_map_clear(struct tracing_map *map)
 		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
 }
 
+/**
+ * tracing_map_read_hits - Return the number of hits of a tracing_map
+ * @map: The tracing_map to read
+ *
+ * Sums up the per-cpu hit counts, see tracing_map_insert() for what
+ * counts as a hit.
+ *
+ * Return: The number of hits.
+ */
+u64 tracing_map_read_hits(struct tracing_map *map)
+{
+	u64 hits = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hits += per_cpu_ptr(map->stats, cpu)->hits;
+
+	return hits;
+}
+
+/**
+ * tracing_map_read_drops - Return the number of drops of a tracing_map
+ * @map: The tracing_map to read
+ *
+ * Sums up the per-cpu counts of failed insertions.
+ *
+ * Return: The number of drops.
+ */
+u64 tracing_map_read_drops(struct tracing_map *map)
+{
+	u64 drops = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		drops += per_cpu_ptr(map->stats, cpu)->drops;
+
+	return drops;
+}
+
 static void set_sort_key(struct tracing_map *map,
 			 struct tracing_map_sort_key *sort_key)
 {
@@ -785,6 +827,10 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
 
 	map->private_data = private_data;
 
+	map->stats = alloc_percpu(struct tracing_map_stats);
+	if (!map->stats)
+		goto free;
+
 	map->map = tracing_map_array_alloc(map->map_size,
 					   sizeof(struct tracing_map_entry));
 	if (!map->map)
@@ -49,8 +49,12 @@
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 #include <linux/sched/isolation.h>
+#include <linux/sched/topology.h>
 #include <linux/nmi.h>
 #include <linux/kvm_para.h>
+#include <linux/sched/clock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_internal.h"
 
@@ -250,6 +254,30 @@ struct wq_flusher {
 
 struct wq_device;
 
+#ifdef CONFIG_WQ_STATS
+/*
+ * Per-cpu execution statistics of a workqueue or a work function.  Only
+ * updated by workers with preemption disabled, see wq_stats_account().
+ */
+struct wq_stats {
+	u64			executed;	/* work items executed */
+	u64			run_time;	/* ns from start to end of func */
+	u64			cpu_time;	/* ns of CPU time consumed by func */
+	u64			latency;	/* ns from queueing to start */
+	u64			latency_max;	/* longest latency seen */
+};
+
+#define WQ_FUNC_STATS_BITS	7
+#define WQ_FUNC_STATS_SIZE	(1 << WQ_FUNC_STATS_BITS)
+#define WQ_FUNC_STATS_PROBE	8
+
+struct wq_func_stats {
+	struct wq_stats		entries[WQ_FUNC_STATS_SIZE];
+	work_func_t		funcs[WQ_FUNC_STATS_SIZE];
+	u64			dropped;	/* not accounted, table full */
+};
+#endif
+
 /*
  * The externally visible workqueue.  It relays the issued work items to
  * the appropriate worker_pool through its pool_workqueues.
@@ -292,10 +320,14 @@ struct workqueue_struct {
 	 */
 	struct rcu_head		rcu;
 
+#ifdef CONFIG_WQ_STATS
+	struct wq_stats __percpu *stats; /* I: execution statistics */
+#endif
+
 	/* hot fields used during command issue, aligned to cacheline */
 	unsigned int		flags ____cacheline_aligned; /* WQ: WQ_* flags */
 	struct pool_workqueue __percpu *cpu_pwqs; /* I: per-cpu pwqs */
-	struct pool_workqueue __rcu *numa_pwq_tbl[]; /* PWR: unbound pwqs indexed by node */
+	struct pool_workqueue __rcu *pod_pwq_tbl[]; /* PWR: unbound pwqs indexed by pod */
 };
 
 static struct kmem_cache *pwq_cache;
@@ -303,6 +335,27 @@ static struct kmem_cache *pwq_cache;
 static cpumask_var_t *wq_numa_possible_cpumask;
 					/* possible CPUs of each node */
 
+/*
+ * Unbound workqueues group CPUs into pods and map a separate pwq to each
+ * pod so that work items stay close to where they were issued.  The
+ * affinity scope decides what a pod is.
+ */
+enum wq_affn_scope {
+	WQ_AFFN_CACHE,			/* CPUs sharing the last level cache */
+	WQ_AFFN_NUMA,			/* CPUs on the same NUMA node */
+	WQ_AFFN_SYSTEM,			/* all CPUs, no pod affinity */
+
+	WQ_AFFN_NR_TYPES,
+};
+
+static const char *wq_affn_names[WQ_AFFN_NR_TYPES] = {
+	[WQ_AFFN_CACHE]		= "cache",
+	[WQ_AFFN_NUMA]		= "numa",
+	[WQ_AFFN_SYSTEM]	= "system",
+};
+
+static int wq_affn_dfl = WQ_AFFN_CACHE;
+
 static bool wq_disable_numa;
 module_param_named(disable_numa, wq_disable_numa, bool, 0444);
 
@@ -312,10 +365,16 @@ module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
 static bool wq_online;			/* can kworkers be created yet? */
 
-static bool wq_numa_enabled;		/* unbound NUMA affinity enabled */
+static bool wq_numa_enabled;		/* wq_numa_possible_cpumask is valid */
 
-/* buf for wq_update_unbound_numa_attrs(), protected by CPU hotplug exclusion */
-static struct workqueue_attrs *wq_update_unbound_numa_attrs_buf;
+static bool wq_topo_initialized;	/* CPU topology is known, pods can be built */
+static bool wq_pod_enabled;		/* unbound pod affinity enabled */
+static int wq_nr_pods;			/* number of pods in wq_pod_cpus[] */
+static cpumask_var_t *wq_pod_cpus;	/* PL: possible CPUs of each pod */
+static DEFINE_PER_CPU_READ_MOSTLY(int, wq_cpu_pod); /* pod of each CPU */
+
+/* buf for wq_update_pod(), protected by CPU hotplug exclusion */
+static struct workqueue_attrs *wq_update_pod_attrs_buf;
 
 static DEFINE_MUTEX(wq_pool_mutex);	/* protects pools and workqueues list */
 static DEFINE_MUTEX(wq_pool_attach_mutex); /* protects worker attach/detach */
@@ -565,32 +624,28 @@ static int worker_pool_assign_id(struct worker_pool *pool)
 }
 
 /**
- * unbound_pwq_by_node - return the unbound pool_workqueue for the given node
+ * unbound_pwq_by_cpu - return the unbound pool_workqueue for the given CPU
  * @wq: the target workqueue
- * @node: the node ID
+ * @cpu: the CPU the work item is issued on
  *
  * This must be called with any of wq_pool_mutex, wq->mutex or RCU
  * read locked.
  * If the pwq needs to be used beyond the locking in effect, the caller is
  * responsible for guaranteeing that the pwq stays online.
  *
- * Return: The unbound pool_workqueue for @node.
+ * Return: The unbound pool_workqueue of the pod @cpu belongs to.
  */
-static struct pool_workqueue *unbound_pwq_by_node(struct workqueue_struct *wq,
-						  int node)
+static struct pool_workqueue *unbound_pwq_by_cpu(struct workqueue_struct *wq,
+						 int cpu)
 {
 	assert_rcu_or_wq_mutex_or_pool_mutex(wq);
 
 	/*
-	 * XXX: @node can be NUMA_NO_NODE if CPU goes offline while a
-	 * delayed item is pending.  The plan is to keep CPU -> NODE
-	 * mapping valid and stable across CPU on/offlines.  Once that
-	 * happens, this workaround can be removed.
+	 * The CPU -> pod mapping covers all possible CPUs and stays valid
+	 * across CPU on/offlines, so this also works for delayed items
+	 * whose CPU went offline.
 	 */
-	if (unlikely(node == NUMA_NO_NODE))
-		return wq->dfl_pwq;
-
-	return rcu_dereference_raw(wq->numa_pwq_tbl[node]);
+	return rcu_dereference_raw(wq->pod_pwq_tbl[per_cpu(wq_cpu_pod, cpu)]);
 }
 
 static unsigned int work_color_to_flags(int color)
@@ -852,8 +907,29 @@ static void wake_up_worker(struct worker_pool *pool)
 {
 	struct worker *worker = first_idle_worker(pool);
 
-	if (likely(worker))
+	if (likely(worker)) {
+#ifdef CONFIG_SMP
+		struct workqueue_attrs *attrs = pool->attrs;
+		struct task_struct *p = worker->task;
+
+		/*
+		 * A non-strict unbound pool may run its workers anywhere in
+		 * @attrs->cpumask but prefers its pod.  Point the wakeup at the
+		 * pod so that the worker starts close to the issuer's cache;
+		 * the scheduler is still free to move it elsewhere if the pod
+		 * is busy.
+		 */
+		if (!attrs->affn_strict &&
+		    !cpumask_test_cpu(p->wake_cpu, attrs->__pod_cpumask)) {
+			int cpu = cpumask_any_and_distribute(attrs->__pod_cpumask,
+							     cpu_online_mask);
+
+			if (cpu < nr_cpu_ids)
+				p->wake_cpu = cpu;
+		}
+#endif
 		wake_up_process(worker->task);
+	}
 }
 
 /**
@@ -1359,6 +1435,9 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 
 	/* we own @work, set data and link */
 	set_work_pwq(work, pwq, extra_flags);
+#ifdef CONFIG_WQ_STATS
+	work->queued_at = local_clock();
+#endif
 	list_add_tail(&work->entry, head);
 	get_pwq(pwq);
 
@@ -1443,7 +1522,7 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	if (wq->flags & WQ_UNBOUND) {
 		if (req_cpu == WORK_CPU_UNBOUND)
 			cpu = wq_select_unbound_cpu(raw_smp_processor_id());
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq_by_cpu(wq, cpu);
 	} else {
 		if (req_cpu == WORK_CPU_UNBOUND)
 			cpu = raw_smp_processor_id();
@@ -1478,7 +1557,7 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	 * pwq is determined and locked.  For unbound pools, we could have
 	 * raced with pwq release and it could already be dead.  If its
 	 * refcnt is zero, repeat pwq selection.  Note that pwqs never die
-	 * without another pwq replacing it in the numa_pwq_tbl or while
+	 * without another pwq replacing it in the pod_pwq_tbl or while
 	 * work items are executing on it, so the retrying is guaranteed to
 	 * make forward-progress.
 	 */
@@ -2164,6 +2243,73 @@ static bool manage_workers(struct worker *worker)
 	return true;
 }
 
+#ifdef CONFIG_WQ_STATS
+static bool wq_func_stats_enabled;
+module_param_named(func_stats, wq_func_stats_enabled, bool, 0644);
+
+static struct wq_func_stats __percpu *wq_func_stats;
+
+static void wq_stats_add(struct wq_stats *stats, u64 run_time, u64 cpu_time,
+			 u64 latency)
+{
+	stats->executed++;
+	stats->run_time += run_time;
+	stats->cpu_time += cpu_time;
+	stats->latency += latency;
+	if (latency > stats->latency_max)
+		stats->latency_max = latency;
+}
+
+static struct wq_stats *wq_func_stats_lookup(struct wq_func_stats *fs,
+					     work_func_t func)
+{
+	unsigned int i, idx = hash_ptr(func, WQ_FUNC_STATS_BITS);
+
+	for (i = 0; i < WQ_FUNC_STATS_PROBE; i++) {
+		unsigned int slot = (idx + i) & (WQ_FUNC_STATS_SIZE - 1);
+
+		if (fs->funcs[slot] == func)
+			return &fs->entries[slot];
+		if (!fs->funcs[slot]) {
+			fs->funcs[slot] = func;
+			return &fs->entries[slot];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Account a work item of @wq executing @func which was queued at
+ * @queued_at and started at @start with the worker's sum_exec_runtime at
+ * @runtime.  The CPU time is only as precise as the scheduler's runtime
+ * accounting, which is updated on ticks and context switches.
+ */
+static void wq_stats_account(struct workqueue_struct *wq, work_func_t func,
+			     u64 queued_at, u64 start, u64 runtime)
+{
+	u64 run_time = local_clock() - start;
+	u64 cpu_time = current->se.sum_exec_runtime - runtime;
+	u64 latency = queued_at && start > queued_at ? start - queued_at : 0;
+	struct wq_func_stats *fs;
+	struct wq_stats *stats;
+
+	preempt_disable();
+
+	wq_stats_add(this_cpu_ptr(wq->stats), run_time, cpu_time, latency);
+
+	if (READ_ONCE(wq_func_stats_enabled) && wq_func_stats) {
+		fs = this_cpu_ptr(wq_func_stats);
+		stats = wq_func_stats_lookup(fs, func);
+		if (stats)
+			wq_stats_add(stats, run_time, cpu_time, latency);
+		else
+			fs->dropped++;
+	}
+
+	preempt_enable();
+}
+#endif	/* CONFIG_WQ_STATS */
+
 /**
  * process_one_work - process single work
  * @worker: self
@@ -2187,6 +2333,11 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	unsigned long work_data;
 	struct worker *collision;
+#ifdef CONFIG_WQ_STATS
+	/* @work may be freed by its function, sample its timestamp now */
+	u64 queued_at = work->queued_at;
+	u64 start, runtime;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2286,7 +2437,15 @@ __acquires(&pool->lock)
 	 */
 	lockdep_invariant_state(true);
 	trace_workqueue_execute_start(work);
+#ifdef CONFIG_WQ_STATS
+	start = local_clock();
+	runtime = current->se.sum_exec_runtime;
+#endif
 	worker->current_func(work);
+#ifdef CONFIG_WQ_STATS
+	wq_stats_account(pwq->wq, worker->current_func, queued_at, start,
+			 runtime);
+#endif
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -3375,6 +3534,7 @@ void free_workqueue_attrs(struct workqueue_attrs *attrs)
 {
 	if (attrs) {
 		free_cpumask_var(attrs->cpumask);
+		free_cpumask_var(attrs->__pod_cpumask);
 		kfree(attrs);
 	}
 }
@@ -3396,8 +3556,11 @@ struct workqueue_attrs *alloc_workqueue_attrs(void)
 		goto fail;
 	if (!alloc_cpumask_var(&attrs->cpumask, GFP_KERNEL))
 		goto fail;
+	if (!alloc_cpumask_var(&attrs->__pod_cpumask, GFP_KERNEL))
+		goto fail;
 
 	cpumask_copy(attrs->cpumask, cpu_possible_mask);
+	cpumask_copy(attrs->__pod_cpumask, cpu_possible_mask);
 	return attrs;
 fail:
 	free_workqueue_attrs(attrs);
@@ -3409,6 +3572,8 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 {
 	to->nice = from->nice;
 	cpumask_copy(to->cpumask, from->cpumask);
+	cpumask_copy(to->__pod_cpumask, from->__pod_cpumask);
+	to->affn_strict = from->affn_strict;
 	/*
 	 * Unlike hash and equality test, this function doesn't ignore
 	 * ->no_numa as it is used for both pool and wq attrs.  Instead,
@@ -3425,6 +3590,9 @@ static u32 wqattrs_hash(const struct workqueue_attrs *attrs)
 	hash = jhash_1word(attrs->nice, hash);
 	hash = jhash(cpumask_bits(attrs->cpumask),
 		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
+	hash = jhash(cpumask_bits(attrs->__pod_cpumask),
+		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
+	hash = jhash_1word(attrs->affn_strict, hash);
 	return hash;
 }
 
@@ -3436,6 +3604,10 @@ static bool wqattrs_equal(const struct workqueue_attrs *a,
 		return false;
 	if (!cpumask_equal(a->cpumask, b->cpumask))
 		return false;
+	if (!cpumask_equal(a->__pod_cpumask, b->__pod_cpumask))
+		return false;
+	if (a->affn_strict != b->affn_strict)
+		return false;
 	return true;
 }
 
@@ -3522,6 +3694,9 @@ static void rcu_free_wq(struct rcu_head *rcu)
 		container_of(rcu, struct workqueue_struct, rcu);
 
 	wq_free_lockdep(wq);
+#ifdef CONFIG_WQ_STATS
+	free_percpu(wq->stats);
+#endif
 
 	if (!(wq->flags & WQ_UNBOUND))
 		free_percpu(wq->cpu_pwqs);
@@ -3646,10 +3821,10 @@ static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 		}
 	}
 
-	/* if cpumask is contained inside a NUMA node, we belong to that node */
+	/* if the pod is contained inside a NUMA node, we belong to that node */
 	if (wq_numa_enabled) {
 		for_each_node(node) {
-			if (cpumask_subset(attrs->cpumask,
+			if (cpumask_subset(attrs->__pod_cpumask,
 					   wq_numa_possible_cpumask[node])) {
 				target_node = node;
 				break;
@@ -3855,49 +4030,44 @@ static struct pool_workqueue *alloc_unbound_pwq(struct workqueue_struct *wq,
 }
 
 /**
- * wq_calc_node_cpumask - calculate a wq_attrs' cpumask for the specified node
+ * wq_calc_pod_cpumask - calculate a wq_attrs' cpumask for the specified pod
  * @attrs: the wq_attrs of the default pwq of the target workqueue
- * @node: the target NUMA node
+ * @pod: the target pod
  * @cpu_going_down: if >= 0, the CPU to consider as offline
  * @cpumask: outarg, the resulting cpumask
  *
- * Calculate the cpumask a workqueue with @attrs should use on @node.  If
+ * Calculate the cpumask a workqueue with @attrs should prefer on @pod.  If
  * @cpu_going_down is >= 0, that cpu is considered offline during
  * calculation.  The result is stored in @cpumask.
  *
- * If NUMA affinity is not enabled, @attrs->cpumask is always used.  If
- * enabled and @node has online CPUs requested by @attrs, the returned
- * cpumask is the intersection of the possible CPUs of @node and
+ * If pod affinity is not enabled, @attrs->cpumask is always used.  If
+ * enabled and @pod has online CPUs requested by @attrs, the returned
+ * cpumask is the intersection of the possible CPUs of @pod and
  * @attrs->cpumask.
  *
- * The caller is responsible for ensuring that the cpumask of @node stays
+ * The caller is responsible for ensuring that the cpumask of @pod stays
  * stable.
  *
  * Return: %true if the resulting @cpumask is different from @attrs->cpumask,
  * %false if equal.
  */
-static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
-				 int cpu_going_down, cpumask_t *cpumask)
+static bool wq_calc_pod_cpumask(const struct workqueue_attrs *attrs, int pod,
+				int cpu_going_down, cpumask_t *cpumask)
 {
-	if (!wq_numa_enabled || attrs->no_numa)
+	if (!wq_pod_enabled || attrs->no_numa || pod >= wq_nr_pods)
 		goto use_dfl;
 
-	/* does @node have any online CPUs @attrs wants? */
-	cpumask_and(cpumask, cpumask_of_node(node), attrs->cpumask);
+	/* does @pod have any online CPUs @attrs wants? */
+	cpumask_and(cpumask, wq_pod_cpus[pod], attrs->cpumask);
+	cpumask_and(cpumask, cpumask, cpu_online_mask);
 	if (cpu_going_down >= 0)
 		cpumask_clear_cpu(cpu_going_down, cpumask);
 
 	if (cpumask_empty(cpumask))
 		goto use_dfl;
 
-	/* yeap, return possible CPUs in @node that @attrs wants */
-	cpumask_and(cpumask, attrs->cpumask, wq_numa_possible_cpumask[node]);
-
-	if (cpumask_empty(cpumask)) {
-		pr_warn_once("WARNING: workqueue cpumask: online intersect > "
-				"possible intersect\n");
-		return false;
-	}
+	/* yeap, return possible CPUs in @pod that @attrs wants */
+	cpumask_and(cpumask, attrs->cpumask, wq_pod_cpus[pod]);
 
 	return !cpumask_equal(cpumask, attrs->cpumask);
 
@@ -3906,10 +4076,24 @@ static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
 	return false;
 }
 
-/* install @pwq into @wq's numa_pwq_tbl[] for @node and return the old pwq */
-static struct pool_workqueue *numa_pwq_tbl_install(struct workqueue_struct *wq,
-						   int node,
-						   struct pool_workqueue *pwq)
+/*
+ * @attrs->__pod_cpumask has been set to the preferred CPUs of a pod pwq.
+ * Strict pools confine their workers to the pod.  Non-strict ones allow
+ * @dfl_cpumask and only steer wakeups into the pod, see wake_up_worker().
+ */
+static void wqattrs_set_pod_cpumask(struct workqueue_attrs *attrs,
+				    const struct cpumask *dfl_cpumask)
+{
+	if (attrs->affn_strict)
+		cpumask_copy(attrs->cpumask, attrs->__pod_cpumask);
+	else
+		cpumask_copy(attrs->cpumask, dfl_cpumask);
+}
+
+/* install @pwq into @wq's pod_pwq_tbl[] for @pod and return the old pwq */
+static struct pool_workqueue *pod_pwq_tbl_install(struct workqueue_struct *wq,
+						  int pod,
+						  struct pool_workqueue *pwq)
 {
 	struct pool_workqueue *old_pwq;
 
@@ -3919,8 +4103,8 @@ static struct pool_workqueue *numa_pwq_tbl_install(struct workqueue_struct *wq,
 	/* link_pwq() can handle duplicate calls */
 	link_pwq(pwq);
 
-	old_pwq = rcu_access_pointer(wq->numa_pwq_tbl[node]);
-	rcu_assign_pointer(wq->numa_pwq_tbl[node], pwq);
+	old_pwq = rcu_access_pointer(wq->pod_pwq_tbl[pod]);
+	rcu_assign_pointer(wq->pod_pwq_tbl[pod], pwq);
 	return old_pwq;
 }
 
@@ -3930,17 +4114,17 @@ struct apply_wqattrs_ctx {
 	struct workqueue_attrs	*attrs;		/* attrs to apply */
 	struct list_head	list;		/* queued for batching commit */
 	struct pool_workqueue	*dfl_pwq;
-	struct pool_workqueue	*pwq_tbl[];
+	struct pool_workqueue	*pwq_tbl[];	/* indexed by pod */
 };
 
 /* free the resources after success or abort */
 static void apply_wqattrs_cleanup(struct apply_wqattrs_ctx *ctx)
 {
 	if (ctx) {
-		int node;
+		int pod;
 
-		for_each_node(node)
-			put_pwq_unlocked(ctx->pwq_tbl[node]);
+		for (pod = 0; pod < nr_cpu_ids; pod++)
+			put_pwq_unlocked(ctx->pwq_tbl[pod]);
 		put_pwq_unlocked(ctx->dfl_pwq);
 
 		free_workqueue_attrs(ctx->attrs);
@@ -3956,11 +4140,11 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 {
 	struct apply_wqattrs_ctx *ctx;
 	struct workqueue_attrs *new_attrs, *tmp_attrs;
-	int node;
+	int pod;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	ctx = kzalloc(struct_size(ctx, pwq_tbl, nr_node_ids), GFP_KERNEL);
+	ctx = kzalloc(struct_size(ctx, pwq_tbl, nr_cpu_ids), GFP_KERNEL);
 
 	new_attrs = alloc_workqueue_attrs();
 	tmp_attrs = alloc_workqueue_attrs();
@@ -3976,6 +4160,7 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 	cpumask_and(new_attrs->cpumask, new_attrs->cpumask, wq_unbound_cpumask);
 	if (unlikely(cpumask_empty(new_attrs->cpumask)))
 		cpumask_copy(new_attrs->cpumask, wq_unbound_cpumask);
+	cpumask_copy(new_attrs->__pod_cpumask, new_attrs->cpumask);
 
 	/*
 	 * We may create multiple pwqs with differing cpumasks.  Make a
@@ -3993,14 +4178,17 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 	if (!ctx->dfl_pwq)
 		goto out_free;
 
-	for_each_node(node) {
-		if (wq_calc_node_cpumask(new_attrs, node, -1, tmp_attrs->cpumask)) {
-			ctx->pwq_tbl[node] = alloc_unbound_pwq(wq, tmp_attrs);
-			if (!ctx->pwq_tbl[node])
+	/* slots beyond wq_nr_pods are never looked up and get dfl_pwq */
+	for (pod = 0; pod < nr_cpu_ids; pod++) {
+		if (wq_calc_pod_cpumask(new_attrs, pod, -1,
+					tmp_attrs->__pod_cpumask)) {
+			wqattrs_set_pod_cpumask(tmp_attrs, new_attrs->cpumask);
+			ctx->pwq_tbl[pod] = alloc_unbound_pwq(wq, tmp_attrs);
+			if (!ctx->pwq_tbl[pod])
 				goto out_free;
 		} else {
 			ctx->dfl_pwq->refcnt++;
-			ctx->pwq_tbl[node] = ctx->dfl_pwq;
+			ctx->pwq_tbl[pod] = ctx->dfl_pwq;
 		}
 	}
 
@@ -4023,7 +4211,7 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 /* set attrs and install prepared pwqs, @ctx points to old pwqs on return */
 static void apply_wqattrs_commit(struct apply_wqattrs_ctx *ctx)
 {
-	int node;
+	int pod;
 
 	/* all pwqs have been created successfully, let's install'em */
 	mutex_lock(&ctx->wq->mutex);
@@ -4031,9 +4219,9 @@ static void apply_wqattrs_commit(struct apply_wqattrs_ctx *ctx)
 	copy_workqueue_attrs(ctx->wq->unbound_attrs, ctx->attrs);
 
 	/* save the previous pwq and install the new one */
-	for_each_node(node)
-		ctx->pwq_tbl[node] = numa_pwq_tbl_install(ctx->wq, node,
-							  ctx->pwq_tbl[node]);
+	for (pod = 0; pod < nr_cpu_ids; pod++)
+		ctx->pwq_tbl[pod] = pod_pwq_tbl_install(ctx->wq, pod,
+							ctx->pwq_tbl[pod]);
 
 	/* @dfl_pwq might not have been used, ensure it's linked */
 	link_pwq(ctx->dfl_pwq);
@@ -4088,10 +4276,11 @@ static int apply_workqueue_attrs_locked(struct workqueue_struct *wq,
  * @wq: the target workqueue
  * @attrs: the workqueue_attrs to apply, allocated with alloc_workqueue_attrs()
  *
- * Apply @attrs to an unbound workqueue @wq.  Unless disabled, on NUMA
- * machines, this function maps a separate pwq to each NUMA node with
- * possibles CPUs in @attrs->cpumask so that work items are affine to the
- * NUMA node it was issued on.  Older pwqs are released as in-flight work
+ * Apply @attrs to an unbound workqueue @wq.  Unless disabled, this
+ * function maps a separate pwq to each pod of the affinity scope (last
+ * level cache by default, see workqueue.default_affinity_scope) with
+ * possible CPUs in @attrs->cpumask so that work items are affine to the
+ * pod they were issued on.  Older pwqs are released as in-flight work
  * items finish.  Note that a work item which repeatedly requeues itself
  * back-to-back will stay on its current pwq.
  *
@@ -4116,39 +4305,36 @@ int apply_workqueue_attrs(struct workqueue_struct *wq,
 }
 
 /**
- * wq_update_unbound_numa - update NUMA affinity of a wq for CPU hot[un]plug
+ * wq_update_pod - update pod affinity of a wq for CPU hot[un]plug
  * @wq: the target workqueue
- * @cpu: the CPU coming up or going down
- * @online: whether @cpu is coming up or going down
+ * @pod: the pod to update
+ * @cpu_off: if >= 0, the CPU of @pod going down
  *
  * This function is to be called from %CPU_DOWN_PREPARE, %CPU_ONLINE and
- * %CPU_DOWN_FAILED.  @cpu is being hot[un]plugged, update NUMA affinity of
- * @wq accordingly.
+ * %CPU_DOWN_FAILED with the pod of the CPU being hot[un]plugged, and when
+ * the pods are rebuilt.  Update the pod affinity of @wq accordingly.
  *
- * If NUMA affinity can't be adjusted due to memory allocation failure, it
+ * If pod affinity can't be adjusted due to memory allocation failure, it
  * falls back to @wq->dfl_pwq which may not be optimal but is always
  * correct.
  *
- * Note that when the last allowed CPU of a NUMA node goes offline for a
- * workqueue with a cpumask spanning multiple nodes, the workers which were
+ * Note that when the last allowed CPU of a pod goes offline for a
+ * workqueue with a cpumask spanning multiple pods, the workers which were
  * already executing the work items for the workqueue will lose their CPU
  * affinity and may execute on any CPU.  This is similar to how per-cpu
  * workqueues behave on CPU_DOWN.  If a workqueue user wants strict
  * affinity, it's the user's responsibility to flush the work item from
  * CPU_DOWN_PREPARE.
  */
-static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
-				   bool online)
+static void wq_update_pod(struct workqueue_struct *wq, int pod, int cpu_off)
 {
-	int node = cpu_to_node(cpu);
-	int cpu_off = online ? -1 : cpu;
 	struct pool_workqueue *old_pwq = NULL, *pwq;
 	struct workqueue_attrs *target_attrs;
 	cpumask_t *cpumask;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	if (!wq_numa_enabled || !(wq->flags & WQ_UNBOUND) ||
+	if (!wq_update_pod_attrs_buf || !(wq->flags & WQ_UNBOUND) ||
 	    wq->unbound_attrs->no_numa)
 		return;
 
@@ -4157,11 +4343,11 @@ static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
 	 * Let's use a preallocated one.  The following buf is protected by
 	 * CPU hotplug exclusion.
 	 */
-	target_attrs = wq_update_unbound_numa_attrs_buf;
-	cpumask = target_attrs->cpumask;
+	target_attrs = wq_update_pod_attrs_buf;
+	cpumask = target_attrs->__pod_cpumask;
 
 	copy_workqueue_attrs(target_attrs, wq->unbound_attrs);
-	pwq = unbound_pwq_by_node(wq, node);
+	pwq = rcu_access_pointer(wq->pod_pwq_tbl[pod]);
 
 	/*
 	 * Let's determine what needs to be done.  If the target cpumask is
@@ -4169,32 +4355,36 @@ static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
 	 * and create a new one if they don't match.  If the target cpumask
 	 * equals the default pwq's, the default pwq should be used.
 	 */
-	if (wq_calc_node_cpumask(wq->dfl_pwq->pool->attrs, node, cpu_off, cpumask)) {
-		if (cpumask_equal(cpumask, pwq->pool->attrs->cpumask))
+	if (wq_calc_pod_cpumask(wq->dfl_pwq->pool->attrs, pod, cpu_off, cpumask)) {
+		if (cpumask_equal(cpumask, pwq->pool->attrs->__pod_cpumask))
 			return;
 	} else {
 		goto use_dfl_pwq;
 	}
 
 	/* create a new pwq */
+	wqattrs_set_pod_cpumask(target_attrs, wq->dfl_pwq->pool->attrs->cpumask);
 	pwq = alloc_unbound_pwq(wq, target_attrs);
 	if (!pwq) {
-		pr_warn("workqueue: allocation failed while updating NUMA affinity of \"%s\"\n",
+		pr_warn("workqueue: allocation failed while updating pod affinity of \"%s\"\n",
 			wq->name);
 		goto use_dfl_pwq;
 	}
 
 	/* Install the new pwq. */
 	mutex_lock(&wq->mutex);
-	old_pwq = numa_pwq_tbl_install(wq, node, pwq);
+	old_pwq = pod_pwq_tbl_install(wq, pod, pwq);
 	goto out_unlock;
 
 use_dfl_pwq:
+	if (pwq == wq->dfl_pwq)
+		return;
+
 	mutex_lock(&wq->mutex);
 	raw_spin_lock_irq(&wq->dfl_pwq->pool->lock);
 	get_pwq(wq->dfl_pwq);
 	raw_spin_unlock_irq(&wq->dfl_pwq->pool->lock);
-	old_pwq = numa_pwq_tbl_install(wq, node, wq->dfl_pwq);
+	old_pwq = pod_pwq_tbl_install(wq, pod, wq->dfl_pwq);
 out_unlock:
 	mutex_unlock(&wq->mutex);
 	put_pwq_unlocked(old_pwq);
@@ -4309,7 +4499,7 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 
 	/* allocate wq and format name */
 	if (flags & WQ_UNBOUND)
-		tbl_size = nr_node_ids * sizeof(wq->numa_pwq_tbl[0]);
+		tbl_size = nr_cpu_ids * sizeof(wq->pod_pwq_tbl[0]);
 
 	wq = kzalloc(sizeof(*wq) + tbl_size, GFP_KERNEL);
 	if (!wq)
@@ -4321,6 +4511,12 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 			goto err_free_wq;
 	}
 
+#ifdef CONFIG_WQ_STATS
+	wq->stats = alloc_percpu(struct wq_stats);
+	if (!wq->stats)
+		goto err_free_wq;
+#endif
+
 	va_start(args, max_active);
 	vsnprintf(wq->name, sizeof(wq->name), fmt, args);
 	va_end(args);
@@ -4372,6 +4568,9 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 	wq_unregister_lockdep(wq);
 	wq_free_lockdep(wq);
 err_free_wq:
+#ifdef CONFIG_WQ_STATS
+	free_percpu(wq->stats);
+#endif
 	free_workqueue_attrs(wq->unbound_attrs);
 	kfree(wq);
 	return NULL;
@@ -4406,7 +4605,7 @@ static bool pwq_busy(struct pool_workqueue *pwq)
 void destroy_workqueue(struct workqueue_struct *wq)
 {
 	struct pool_workqueue *pwq;
-	int node;
+	int pod;
 
 	/*
 	 * Remove it from sysfs first so that sanity check failure doesn't
@@ -4470,12 +4669,12 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	} else {
 		/*
 		 * We're the sole accessor of @wq at this point.  Directly
-		 * access numa_pwq_tbl[] and dfl_pwq to put the base refs.
+		 * access pod_pwq_tbl[] and dfl_pwq to put the base refs.
 		 * @wq will be freed when the last pwq is released.
 		 */
-		for_each_node(node) {
-			pwq = rcu_access_pointer(wq->numa_pwq_tbl[node]);
-			RCU_INIT_POINTER(wq->numa_pwq_tbl[node], NULL);
+		for (pod = 0; pod < nr_cpu_ids; pod++) {
+			pwq = rcu_access_pointer(wq->pod_pwq_tbl[pod]);
+			RCU_INIT_POINTER(wq->pod_pwq_tbl[pod], NULL);
 			put_pwq_unlocked(pwq);
 		}
 
@@ -4585,7 +4784,7 @@ bool workqueue_congested(int cpu, struct workqueue_struct *wq)
 	if (!(wq->flags & WQ_UNBOUND))
 		pwq = per_cpu_ptr(wq->cpu_pwqs, cpu);
 	else
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq_by_cpu(wq, cpu);
 
 	ret = !list_empty(&pwq->inactive_works);
 	preempt_enable();
@@ -5134,9 +5333,9 @@ int workqueue_online_cpu(unsigned int cpu)
 		mutex_unlock(&wq_pool_attach_mutex);
 	}
 
-	/* update NUMA affinity of unbound workqueues */
+	/* update pod affinity of unbound workqueues */
 	list_for_each_entry(wq, &workqueues, list)
-		wq_update_unbound_numa(wq, cpu, true);
+		wq_update_pod(wq, per_cpu(wq_cpu_pod, cpu), -1);
 
 	mutex_unlock(&wq_pool_mutex);
 	return 0;
@@ -5152,10 +5351,10 @@ int workqueue_offline_cpu(unsigned int cpu)
 
 	unbind_workers(cpu);
 
-	/* update NUMA affinity of unbound workqueues */
+	/* update pod affinity of unbound workqueues */
 	mutex_lock(&wq_pool_mutex);
 	list_for_each_entry(wq, &workqueues, list)
-		wq_update_unbound_numa(wq, cpu, false);
+		wq_update_pod(wq, per_cpu(wq_cpu_pod, cpu), cpu);
 	mutex_unlock(&wq_pool_mutex);
 
 	return 0;
@@ -5493,14 +5692,17 @@ static ssize_t wq_pool_ids_show(struct device *dev,
 {
 	struct workqueue_struct *wq = dev_to_wq(dev);
 	const char *delim = "";
-	int node, written = 0;
+	int pod, nr_pods, written = 0;
 
 	cpus_read_lock();
 	rcu_read_lock();
-	for_each_node(node) {
+	nr_pods = max(READ_ONCE(wq_nr_pods), 1);
+	for (pod = 0; pod < nr_pods; pod++) {
+		struct pool_workqueue *pwq;
+
+		pwq = rcu_dereference(wq->pod_pwq_tbl[pod]);
 		written += scnprintf(buf + written, PAGE_SIZE - written,
-				     "%s%d:%d", delim, node,
-				     unbound_pwq_by_node(wq, node)->pool->id);
+				     "%s%d:%d", delim, pod, pwq->pool->id);
 		delim = " ";
 	}
 	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
@@ -5639,11 +5841,52 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	return ret ?: count;
 }
 
+static ssize_t wq_affn_strict_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq->mutex);
+	written = scnprintf(buf, PAGE_SIZE, "%d\n",
+			    wq->unbound_attrs->affn_strict);
+	mutex_unlock(&wq->mutex);
+
+	return written;
+}
+
+static ssize_t wq_affn_strict_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int v, ret = -ENOMEM;
+
+	apply_wqattrs_lock();
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		goto out_unlock;
+
+	ret = -EINVAL;
+	if (sscanf(buf, "%d", &v) == 1) {
+		attrs->affn_strict = !!v;
+		ret = apply_workqueue_attrs_locked(wq, attrs);
+	}
+
+out_unlock:
+	apply_wqattrs_unlock();
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
+	__ATTR(affinity_strict, 0644, wq_affn_strict_show, wq_affn_strict_store),
 	__ATTR_NULL,
 };
 
@@ -5950,7 +6193,7 @@ static void __init wq_numa_init(void)
 		return;
 
 	if (wq_disable_numa) {
-		pr_info("workqueue: NUMA affinity support disabled\n");
+		pr_info("workqueue: NUMA and pod affinity support disabled\n");
 		return;
 	}
 
@@ -5961,9 +6204,6 @@ static void __init wq_numa_init(void)
 		}
 	}
 
-	wq_update_unbound_numa_attrs_buf = alloc_workqueue_attrs();
-	BUG_ON(!wq_update_unbound_numa_attrs_buf);
-
 	/*
 	 * We want masks of possible CPUs of each node which isn't readily
 	 * available.  Build one from cpu_to_node() which should have been
@@ -5985,6 +6225,154 @@ static void __init wq_numa_init(void)
 	wq_numa_enabled = true;
 }
 
+/* do @a and @b belong to the same pod in affinity @scope? */
+static bool wq_cpus_share_pod(int scope, int a, int b)
+{
+	switch (scope) {
+	case WQ_AFFN_CACHE:
+		/*
+		 * LLC sharing is only known for CPUs which have been up.
+		 * Group the others by node, they join the first LLC pod of
+		 * their node.
+		 */
+		if (cpu_online(a) && cpu_online(b))
+			return cpus_share_cache(a, b);
+		fallthrough;
+	case WQ_AFFN_NUMA:
+		return cpu_to_node(a) == cpu_to_node(b);
+	default:
+		return true;
+	}
+}
+
+/**
+ * wq_pod_init - (re)build the pods of the given affinity scope
+ * @scope: WQ_AFFN_* to build the pods for
+ *
+ * Group all possible CPUs into pods according to @scope and update
+ * wq_pod_cpus[], wq_nr_pods and the CPU -> pod mapping.  Existing
+ * workqueues are not touched, see wq_pod_reinit().
+ *
+ * Must be called with wq_pool_mutex and CPU hotplug read exclusion held.
+ *
+ * Return: 0 on success, -ENOMEM on failure in which case the current pods
+ * are left alone.
+ */
+static int wq_pod_init(int scope)
+{
+	cpumask_var_t *tbl = NULL;
+	int *cpu_pod, *pod_first;
+	int nr_pods = 0, cpu, pod, ret = -ENOMEM;
+
+	lockdep_assert_held(&wq_pool_mutex);
+
+	cpu_pod = kcalloc(nr_cpu_ids, sizeof(cpu_pod[0]), GFP_KERNEL);
+	pod_first = kcalloc(nr_cpu_ids, sizeof(pod_first[0]), GFP_KERNEL);
+	if (!cpu_pod || !pod_first)
+		goto out_free;
+
+	for_each_possible_cpu(cpu) {
+		for (pod = 0; pod < nr_pods; pod++)
+			if (wq_cpus_share_pod(scope, cpu, pod_first[pod]))
+				break;
+		if (pod == nr_pods)
+			pod_first[nr_pods++] = cpu;
+		cpu_pod[cpu] = pod;
+	}
+
+	tbl = kcalloc(nr_pods, sizeof(tbl[0]), GFP_KERNEL);
+	if (!tbl)
+		goto out_free;
+
+	for (pod = 0; pod < nr_pods; pod++) {
+		if (!zalloc_cpumask_var_node(&tbl[pod], GFP_KERNEL,
+					     cpu_to_node(pod_first[pod]))) {
+			while (--pod >= 0)
+				free_cpumask_var(tbl[pod]);
+			kfree(tbl);
+			goto out_free;
+		}
+	}
+
+	for_each_possible_cpu(cpu) {
+		cpumask_set_cpu(cpu, tbl[cpu_pod[cpu]]);
+		per_cpu(wq_cpu_pod, cpu) = cpu_pod[cpu];
+	}
+
+	/* only wq_pool_mutex holders look at the pod cpumasks */
+	swap(wq_pod_cpus, tbl);
+	swap(wq_nr_pods, nr_pods);
+	wq_pod_enabled = wq_nr_pods > 1;
+
+	for (pod = 0; pod < nr_pods; pod++)
+		free_cpumask_var(tbl[pod]);
+	kfree(tbl);
+	ret = 0;
+out_free:
+	kfree(pod_first);
+	kfree(cpu_pod);
+	return ret;
+}
+
+/* rebuild the pods for the current scope and remap all unbound workqueues */
+static int wq_pod_reinit(void)
+{
+	struct workqueue_struct *wq;
+	int pod, ret;
+
+	lockdep_assert_held(&wq_pool_mutex);
+
+	ret = wq_pod_init(wq_disable_numa ? WQ_AFFN_SYSTEM : wq_affn_dfl);
+	if (ret)
+		return ret;
+
+	list_for_each_entry(wq, &workqueues, list)
+		for (pod = 0; pod < nr_cpu_ids; pod++)
+			wq_update_pod(wq, pod, -1);
+
+	return 0;
+}
+
+static int wq_affn_dfl_set(const char *val, const struct kernel_param *kp)
+{
+	int affn, ret = 0;
+
+	affn = sysfs_match_string(wq_affn_names, val);
+	if (affn < 0)
+		return affn;
+
+	/* boot param, pods are built once the topology is known */
+	if (!READ_ONCE(wq_topo_initialized)) {
+		wq_affn_dfl = affn;
+		return 0;
+	}
+
+	apply_wqattrs_lock();
+	if (affn != wq_affn_dfl) {
+		int old = wq_affn_dfl;
+
+		wq_affn_dfl = affn;
+		ret = wq_pod_reinit();
+		if (ret)
+			wq_affn_dfl = old;
+	}
+	apply_wqattrs_unlock();
+
+	return ret;
+}
+
+static int wq_affn_dfl_get(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%s\n", wq_affn_names[wq_affn_dfl]);
+}
+
+static const struct kernel_param_ops wq_affn_dfl_ops = {
+	.set	= wq_affn_dfl_set,
+	.get	= wq_affn_dfl_get,
+};
+
+module_param_cb(default_affinity_scope, &wq_affn_dfl_ops, NULL, 0644);
+
 /**
  * workqueue_init_early - early init for workqueue subsystem
  *
@@ -6017,6 +6405,8 @@ void __init workqueue_init_early(void)
 			BUG_ON(init_worker_pool(pool));
 			pool->cpu = cpu;
 			cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
+			cpumask_copy(pool->attrs->__pod_cpumask, cpumask_of(cpu));
+			pool->attrs->affn_strict = true;
 			pool->attrs->nice = std_nice[i++];
 			pool->node = cpu_to_node(cpu);
 
@@ -6038,7 +6428,7 @@ void __init workqueue_init_early(void)
 		/*
 		 * An ordered wq should have only one pwq as ordering is
 		 * guaranteed by max_active which is enforced by pwqs.
-		 * Turn off NUMA so that dfl_pwq is used for all nodes.
+		 * Turn off pod affinity so that dfl_pwq is used for all pods.
 		 */
 		BUG_ON(!(attrs = alloc_workqueue_attrs()));
 		attrs->nice = std_nice[i];
@@ -6083,13 +6473,22 @@ void __init workqueue_init(void)
 	 * It'd be simpler to initialize NUMA in workqueue_init_early() but
 	 * CPU to node mapping may not be available that early on some
 	 * archs such as power and arm64.  As per-cpu pools created
-	 * previously could be missing node hint and unbound pools NUMA
-	 * affinity, fix them up.
+	 * previously could be missing node hint, fix them up.  Unbound pod
+	 * affinity needs the full CPU topology and is set up later by
+	 * workqueue_init_topology().
 	 *
 	 * Also, while iterating workqueues, create rescuers if requested.
 	 */
 	wq_numa_init();
 
+	wq_update_pod_attrs_buf = alloc_workqueue_attrs();
+	BUG_ON(!wq_update_pod_attrs_buf);
+
+#ifdef CONFIG_WQ_STATS
+	wq_func_stats = alloc_percpu(struct wq_func_stats);
+	WARN_ON_ONCE(!wq_func_stats);
+#endif
+
 	mutex_lock(&wq_pool_mutex);
 
 	for_each_possible_cpu(cpu) {
@@ -6099,7 +6498,6 @@ void __init workqueue_init(void)
 	}
 
 	list_for_each_entry(wq, &workqueues, list) {
-		wq_update_unbound_numa(wq, smp_processor_id(), true);
 		WARN(init_rescuer(wq),
 		     "workqueue: failed to create early rescuer for %s",
 		     wq->name);
@@ -6122,6 +6520,132 @@ void __init workqueue_init(void)
 	wq_watchdog_init();
 }
 
+/**
+ * workqueue_init_topology - enable pod affinity of unbound workqueues
+ *
+ * Called after all boot CPUs are up and the scheduler domains, which tell
+ * which CPUs share the last level cache, have been built.  Group CPUs into
+ * pods according to workqueue.default_affinity_scope and remap all unbound
+ * workqueues created so far.  Until then they use their default pwq.
+ */
+void __init workqueue_init_topology(void)
+{
+	apply_wqattrs_lock();
+	if (wq_pod_reinit())
+		pr_warn("workqueue: failed to build affinity pods\n");
+	else
+		pr_info("workqueue: %d %s affinity pods\n", wq_nr_pods,
+			wq_affn_names[wq_disable_numa ? WQ_AFFN_SYSTEM : wq_affn_dfl]);
+	WRITE_ONCE(wq_topo_initialized, true);
+	apply_wqattrs_unlock();
+}
+
+#ifdef CONFIG_WQ_STATS
+
+static void wq_stats_sum(struct wq_stats *sum, const struct wq_stats *stats)
+{
+	sum->executed += stats->executed;
+	sum->run_time += stats->run_time;
+	sum->cpu_time += stats->cpu_time;
+	sum->latency += stats->latency;
+	sum->latency_max = max(sum->latency_max, stats->latency_max);
+}
+
+static void wq_stats_show_one(struct seq_file *m, const struct wq_stats *s)
+{
+	seq_printf(m, " %llu %llu %llu %llu %llu\n", s->executed, s->run_time,
+		   s->cpu_time, s->latency, s->latency_max);
+}
+
+static int wq_stats_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+	int cpu;
+
+	seq_puts(m, "# workqueue executed run_ns cpu_ns latency_ns latency_max_ns\n");
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(wq, &workqueues, list) {
+		struct wq_stats sum = {};
+
+		for_each_possible_cpu(cpu)
+			wq_stats_sum(&sum, per_cpu_ptr(wq->stats, cpu));
+		seq_printf(m, "%s", wq->name);
+		wq_stats_show_one(m, &sum);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wq_stats);
+
+/*
+ * The same function may sit in different slots on different CPUs.  Merge
+ * them into a table large enough for every slot of every CPU.
+ */
+static int wq_funcs_show(struct seq_file *m, void *v)
+{
+	struct wq_stats *sums;
+	work_func_t *funcs;
+	u64 dropped = 0;
+	int cpu, i, nr = 0;
+	size_t size = (size_t)WQ_FUNC_STATS_SIZE * num_possible_cpus();
+
+	if (!wq_func_stats)
+		return -ENOMEM;
+
+	sums = kvcalloc(size, sizeof(sums[0]), GFP_KERNEL);
+	funcs = kvcalloc(size, sizeof(funcs[0]), GFP_KERNEL);
+	if (!sums || !funcs) {
+		kvfree(sums);
+		kvfree(funcs);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct wq_func_stats *fs = per_cpu_ptr(wq_func_stats, cpu);
+
+		for (i = 0; i < WQ_FUNC_STATS_SIZE; i++) {
+			work_func_t func = READ_ONCE(fs->funcs[i]);
+			int j;
+
+			if (!func)
+				continue;
+			for (j = 0; j < nr; j++)
+				if (funcs[j] == func)
+					break;
+			if (j == nr)
+				funcs[nr++] = func;
+			wq_stats_sum(&sums[j], &fs->entries[i]);
+		}
+		dropped += fs->dropped;
+	}
+
+	seq_printf(m, "# func executed run_ns cpu_ns latency_ns latency_max_ns (%s, %llu dropped)\n",
+		   wq_func_stats_enabled ? "enabled" : "disabled", dropped);
+	for (i = 0; i < nr; i++) {
+		seq_printf(m, "%ps", funcs[i]);
+		wq_stats_show_one(m, &sums[i]);
+	}
+
+	kvfree(funcs);
+	kvfree(sums);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wq_funcs);
+
+static int __init wq_stats_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("workqueue", NULL);
+
+	debugfs_create_file("stats", 0400, dir, NULL, &wq_stats_fops);
+	debugfs_create_file("funcs", 0400, dir, NULL, &wq_funcs_fops);
+	return 0;
+}
+late_initcall(wq_stats_debugfs_init);
+
+#endif	/* CONFIG_WQ_STATS */
+
 /*
  * Despite the naming, this is a no-op function which is here only for avoiding
  * link error. Since compile-time warning may fail to catch, we will need to
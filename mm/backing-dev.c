@@ -293,6 +293,25 @@ static ssize_t max_bytes_store(struct device *dev,
 }
 DEVICE_ATTR_RW(max_bytes);
 
+static ssize_t max_flushers_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	unsigned int nr;
+	ssize_t ret;
+
+	ret = kstrtouint(buf, 10, &nr);
+	if (ret < 0)
+		return ret;
+	if (!nr || nr > WB_MAX_FLUSHERS)
+		return -EINVAL;
+
+	WRITE_ONCE(bdi->max_flushers, nr);
+
+	return count;
+}
+BDI_SHOW(max_flushers, bdi->max_flushers)
+
 static ssize_t stable_pages_required_show(struct device *dev,
 					  struct device_attribute *attr,
 					  char *buf)
@@ -339,6 +358,7 @@ static struct attribute *bdi_dev_attrs[] = {
 	&dev_attr_max_ratio_fine.attr,
 	&dev_attr_min_bytes.attr,
 	&dev_attr_max_bytes.attr,
+	&dev_attr_max_flushers.attr,
 	&dev_attr_stable_pages_required.attr,
 	&dev_attr_strict_limit.attr,
 	NULL,
@@ -432,6 +452,10 @@ static int wb_init(struct bdi_writeback *wb, struct backing_dev_info *bdi,
 	INIT_LIST_HEAD(&wb->work_list);
 	INIT_DELAYED_WORK(&wb->dwork, wb_workfn);
 	INIT_DELAYED_WORK(&wb->bw_dwork, wb_update_bandwidth_workfn);
+	for (i = 0; i < ARRAY_SIZE(wb->flushers); i++) {
+		INIT_WORK(&wb->flushers[i].work, wb_flusher_workfn);
+		wb->flushers[i].wb = wb;
+	}
 	wb->dirty_sleep = jiffies;
 
 	err = fprop_local_init_percpu(&wb->completions, gfp);
@@ -460,6 +484,8 @@ static void cgwb_remove_from_bdi_list(struct bdi_writeback *wb);
  */
 static void wb_shutdown(struct bdi_writeback *wb)
 {
+	int i;
+
 	/* Make sure nobody queues further work */
 	spin_lock_irq(&wb->work_lock);
 	if (!test_and_clear_bit(WB_registered, &wb->state)) {
@@ -477,6 +503,9 @@ static void wb_shutdown(struct bdi_writeback *wb)
 	mod_delayed_work(bdi_wq, &wb->dwork, 0);
 	flush_delayed_work(&wb->dwork);
 	WARN_ON(!list_empty(&wb->work_list));
+	/* only wb_workfn() kicks the extra flushers */
+	for (i = 0; i < ARRAY_SIZE(wb->flushers); i++)
+		flush_work(&wb->flushers[i].work);
 	flush_delayed_work(&wb->bw_dwork);
 }
 
@@ -909,6 +938,8 @@ int bdi_init(struct backing_dev_info *bdi)
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100 * BDI_RATIO_SCALE;
 	bdi->max_prop_frac = FPROP_FRAC_BASE;
+	bdi->max_flushers = 1;
+	atomic_set(&bdi->nr_flushers, 0);
 	INIT_LIST_HEAD(&bdi->bdi_list);
 	INIT_LIST_HEAD(&bdi->wb_list);
 	init_waitqueue_head(&bdi->wb_waitq);
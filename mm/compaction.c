@@ -1969,7 +1969,7 @@ static inline bool is_via_compact_memory(int order)
 /*
  * Determine whether kswapd is (or recently was!) running on this node.
  *
- * pgdat_kswapd_lock() pins pgdat->kswapd, so a concurrent kswapd_stop() can't
+ * pgdat_kswapd_lock() pins pgdat->kswapd[], so a concurrent kswapd_stop() can't
  * zero it.
  */
 static bool kswapd_is_running(pg_data_t *pgdat)
@@ -1977,7 +1977,7 @@ static bool kswapd_is_running(pg_data_t *pgdat)
 	bool running;
 
 	pgdat_kswapd_lock(pgdat);
-	running = pgdat->kswapd && task_is_running(pgdat->kswapd);
+	running = pgdat->kswapd[0] && task_is_running(pgdat->kswapd[0]);
 	pgdat_kswapd_unlock(pgdat);
 
 	return running;
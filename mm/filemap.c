@@ -1900,6 +1900,9 @@ static void *mapping_get_entry(struct address_space *mapping, pgoff_t index)
  * * %FGP_NOWAIT - Don't get blocked by page lock.
  * * %FGP_STABLE - Wait for the folio to be stable (finished writeback)
  *
+ * With %FGP_CREAT, fgf_set_order() can ask for a large folio. It is only
+ * honoured if the mapping supports large folios.
+ *
  * If %FGP_LOCK or %FGP_CREAT are specified then the function may sleep even
  * if the %GFP flags specified for %FGP_CREAT are atomic.
  *
@@ -1953,7 +1956,9 @@ struct folio *__filemap_get_folio(struct address_space *mapping, pgoff_t index,
 		folio_wait_stable(folio);
 no_page:
 	if (!folio && (fgp_flags & FGP_CREAT)) {
+		unsigned int order = FGP_ORDER(fgp_flags);
 		int err;
+
 		if ((fgp_flags & FGP_WRITE) && mapping_can_writeback(mapping))
 			gfp |= __GFP_WRITE;
 		if (fgp_flags & FGP_NOFS)
@@ -1963,24 +1968,47 @@ struct folio *__filemap_get_folio(struct address_space *mapping, pgoff_t index,
 			gfp |= GFP_NOWAIT | __GFP_NOWARN;
 		}
 
-		folio = filemap_alloc_folio(gfp, 0);
-		if (!folio)
-			return NULL;
-
 		if (WARN_ON_ONCE(!(fgp_flags & (FGP_LOCK | FGP_FOR_MMAP))))
 			fgp_flags |= FGP_LOCK;
 
-		/* Init accessed so avoid atomic mark_page_accessed later */
-		if (fgp_flags & FGP_ACCESSED)
-			__folio_set_referenced(folio);
+		if (!mapping_large_folio_support(mapping))
+			order = 0;
+		if (order > MAX_PAGECACHE_ORDER)
+			order = MAX_PAGECACHE_ORDER;
+		/* If we're not aligned, allocate a smaller folio */
+		if (index & ((1UL << order) - 1))
+			order = __ffs(index);
 
-		err = filemap_add_folio(mapping, folio, index, gfp);
-		if (unlikely(err)) {
+		/* Fall back to smaller folios, down to a single page */
+		do {
+			gfp_t alloc_gfp = gfp;
+
+			/* No order-1 folios, as in page_cache_ra_order() */
+			if (order == 1)
+				order = 0;
+			if (order > 0)
+				alloc_gfp |= __GFP_NORETRY | __GFP_NOWARN;
+
+			err = -ENOMEM;
+			folio = filemap_alloc_folio(alloc_gfp, order);
+			if (!folio)
+				continue;
+
+			/* Init accessed so avoid atomic mark_page_accessed later */
+			if (fgp_flags & FGP_ACCESSED)
+				__folio_set_referenced(folio);
+
+			err = filemap_add_folio(mapping, folio, index, gfp);
+			if (!err)
+				break;
 			folio_put(folio);
 			folio = NULL;
-			if (err == -EEXIST)
-				goto repeat;
-		}
+		} while (order-- > 0);
+
+		if (err == -EEXIST)
+			goto repeat;
+		if (err)
+			return NULL;
 
 		/*
 		 * filemap_add_folio locks the page, and for mmap
@@ -2465,6 +2493,33 @@ static bool filemap_range_uptodate(struct address_space *mapping,
 	return mapping->a_ops->is_partially_uptodate(folio, pos, count);
 }
 
+/*
+ * Start reading a locked @folio for an IOCB_WAITQ read, without waiting for
+ * the read to finish. The read unlocks the folio, which wakes ->ki_waitq.
+ * Returns -EIOCBQUEUED if the wakeup is pending, or the result of the read
+ * if it was done by the time we looked.
+ */
+static int filemap_read_folio_async(struct kiocb *iocb, struct folio *folio)
+{
+	struct file *file = iocb->ki_filp;
+	int error;
+
+	folio_clear_error(folio);
+	error = folio->mapping->a_ops->read_folio(file, folio);
+	if (error)
+		return error;
+
+	error = __folio_lock_async(folio, iocb->ki_waitq);
+	if (error)
+		return error;
+
+	folio_unlock(folio);
+	if (folio_test_uptodate(folio))
+		return 0;
+	shrink_readahead_size_eio(&file->f_ra);
+	return -EIO;
+}
+
 static int filemap_update_page(struct kiocb *iocb,
 		struct address_space *mapping, struct iov_iter *iter,
 		struct folio *folio)
@@ -2505,11 +2560,14 @@ static int filemap_update_page(struct kiocb *iocb,
 		goto unlock;
 
 	error = -EAGAIN;
-	if (iocb->ki_flags & (IOCB_NOIO | IOCB_NOWAIT | IOCB_WAITQ))
+	if (iocb->ki_flags & (IOCB_NOIO | IOCB_NOWAIT))
 		goto unlock;
 
-	error = filemap_read_folio(iocb->ki_filp, mapping->a_ops->read_folio,
-			folio);
+	if (iocb->ki_flags & IOCB_WAITQ)
+		error = filemap_read_folio_async(iocb, folio);
+	else
+		error = filemap_read_folio(iocb->ki_filp,
+				mapping->a_ops->read_folio, folio);
 	goto unlock_mapping;
 unlock:
 	folio_unlock(folio);
@@ -2520,10 +2578,11 @@ static int filemap_update_page(struct kiocb *iocb,
 	return error;
 }
 
-static int filemap_create_folio(struct file *file,
+static int filemap_create_folio(struct kiocb *iocb,
 		struct address_space *mapping, pgoff_t index,
 		struct folio_batch *fbatch)
 {
+	struct file *file = iocb->ki_filp;
 	struct folio *folio;
 	int error;
 
@@ -2552,7 +2611,16 @@ static int filemap_create_folio(struct file *file,
 	if (error)
 		goto error;
 
-	error = filemap_read_folio(file, mapping->a_ops->read_folio, folio);
+	/*
+	 * For IOCB_WAITQ, don't wait for the read here. If it's still in
+	 * flight this returns -EIOCBQUEUED and the caller gets woken when
+	 * it's done, with the folio left in the page cache for the retry.
+	 */
+	if (iocb->ki_flags & IOCB_WAITQ)
+		error = filemap_read_folio_async(iocb, folio);
+	else
+		error = filemap_read_folio(file, mapping->a_ops->read_folio,
+					   folio);
 	if (error)
 		goto error;
 
@@ -2602,9 +2670,9 @@ static int filemap_get_pages(struct kiocb *iocb, struct iov_iter *iter,
 		filemap_get_read_batch(mapping, index, last_index, fbatch);
 	}
 	if (!folio_batch_count(fbatch)) {
-		if (iocb->ki_flags & (IOCB_NOWAIT | IOCB_WAITQ))
+		if (iocb->ki_flags & IOCB_NOWAIT)
 			return -EAGAIN;
-		err = filemap_create_folio(filp, mapping,
+		err = filemap_create_folio(iocb, mapping,
 				iocb->ki_pos >> PAGE_SHIFT, fbatch);
 		if (err == AOP_TRUNCATED_PAGE)
 			goto retry;
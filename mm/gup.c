@@ -177,6 +177,27 @@ struct folio *try_grab_folio(struct page *page, int refs, unsigned int flags)
 	return NULL;
 }
 
+/*
+ * Take @refs more references of the kind @flags asks for on @folio, which
+ * the caller already holds a reference of that kind on.  Unlike
+ * try_grab_folio() this can't fail and may be used in sleepable context,
+ * as the gup slow path does.
+ */
+static void grab_folio_refs(struct folio *folio, int refs, unsigned int flags)
+{
+	if (flags & FOLL_PIN) {
+		if (folio_test_large(folio)) {
+			folio_ref_add(folio, refs);
+			atomic_add(refs, folio_pincount_ptr(folio));
+		} else {
+			folio_ref_add(folio, refs * GUP_PIN_COUNTING_BIAS);
+		}
+		node_stat_mod_folio(folio, NR_FOLL_PIN_ACQUIRED, refs);
+	} else if (flags & FOLL_GET) {
+		folio_ref_add(folio, refs);
+	}
+}
+
 static void gup_put_folio(struct folio *folio, int refs, unsigned int flags)
 {
 	if (flags & FOLL_PIN) {
@@ -1106,7 +1127,7 @@ static long __get_user_pages(struct mm_struct *mm,
 			if (!vma && in_gate_area(mm, start)) {
 				ret = get_gate_page(mm, start & PAGE_MASK,
 						gup_flags, &vma,
-						pages ? &pages[i] : NULL);
+						pages ? &page : NULL);
 				if (ret)
 					goto out;
 				ctx.page_mask = 0;
@@ -1182,12 +1203,6 @@ static long __get_user_pages(struct mm_struct *mm,
 			ret = PTR_ERR(page);
 			goto out;
 		}
-		if (pages) {
-			pages[i] = page;
-			flush_anon_page(vma, page, start);
-			flush_dcache_page(page);
-			ctx.page_mask = 0;
-		}
 next_page:
 		if (vmas) {
 			vmas[i] = vma;
@@ -1196,6 +1211,29 @@ static long __get_user_pages(struct mm_struct *mm,
 		page_increm = 1 + (~(start >> PAGE_SHIFT) & ctx.page_mask);
 		if (page_increm > nr_pages)
 			page_increm = nr_pages;
+
+		if (pages) {
+			struct page *subpage;
+			unsigned int j;
+
+			/*
+			 * page is part of a large folio mapped by one PMD:
+			 * take the references for the rest of the range in
+			 * one go rather than walking it page by page.  The
+			 * first reference is already held, so this cannot
+			 * fail.
+			 */
+			if (page_increm > 1)
+				grab_folio_refs(page_folio(page),
+						page_increm - 1, foll_flags);
+
+			for (j = 0; j < page_increm; j++) {
+				subpage = nth_page(page, j);
+				pages[i + j] = subpage;
+				flush_anon_page(vma, subpage, start + j * PAGE_SIZE);
+				flush_dcache_page(subpage);
+			}
+		}
 		i += page_increm;
 		start += page_increm * PAGE_SIZE;
 		nr_pages -= page_increm;
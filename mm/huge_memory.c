@@ -37,6 +37,7 @@
 #include <linux/page_owner.h>
 #include <linux/sched/sysctl.h>
 #include <linux/memory-tiers.h>
+#include <linux/slab.h>
 
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
@@ -71,6 +72,18 @@ static atomic_t huge_zero_refcount;
 struct page *huge_zero_page __read_mostly;
 unsigned long huge_zero_pfn __read_mostly = ~0UL;
 
+/*
+ * Anonymous page faults can also be served from folios smaller than a PMD,
+ * each order is enabled separately and "inherit" follows the top level
+ * enabled setting. None of them is used by default.
+ */
+static DEFINE_SPINLOCK(huge_anon_orders_lock);
+unsigned long huge_anon_orders_always __read_mostly;
+unsigned long huge_anon_orders_madvise __read_mostly;
+unsigned long huge_anon_orders_inherit __read_mostly;
+
+DEFINE_PER_CPU(struct mthp_stat, mthp_stats);
+
 bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 			bool smaps, bool in_pf, bool enforce_sysfs)
 {
@@ -150,6 +163,40 @@ bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 	return true;
 }
 
+/*
+ * Return the sub-PMD orders an anonymous fault in @vma may allocate. The
+ * caller still has to check that the aligned range of an order fits in the
+ * vma and is not populated yet.
+ */
+unsigned long thp_vma_anon_orders(struct vm_area_struct *vma)
+{
+	unsigned long vm_flags = vma->vm_flags;
+	unsigned long orders;
+
+	orders = READ_ONCE(huge_anon_orders_always) |
+		 READ_ONCE(huge_anon_orders_madvise) |
+		 READ_ONCE(huge_anon_orders_inherit);
+	if (!orders)
+		return 0;
+
+	if (!vma_is_anonymous(vma) || vma_is_temporary_stack(vma))
+		return 0;
+	if ((vm_flags & (VM_NOHUGEPAGE | VM_NO_KHUGEPAGED)) ||
+	    test_bit(MMF_DISABLE_THP, &vma->vm_mm->flags))
+		return 0;
+	if (transparent_hugepage_flags & (1 << TRANSPARENT_HUGEPAGE_NEVER_DAX))
+		return 0;
+
+	orders = READ_ONCE(huge_anon_orders_always);
+	if (vm_flags & VM_HUGEPAGE)
+		orders |= READ_ONCE(huge_anon_orders_madvise);
+	if (hugepage_flags_always() ||
+	    (hugepage_flags_enabled() && (vm_flags & VM_HUGEPAGE)))
+		orders |= READ_ONCE(huge_anon_orders_inherit);
+
+	return orders & THP_ORDERS_ANON_PTE;
+}
+
 static bool get_huge_zero_page(void)
 {
 	struct page *zero_page;
@@ -405,9 +452,167 @@ static const struct attribute_group hugepage_attr_group = {
 	.attrs = hugepage_attr,
 };
 
+static LIST_HEAD(thpsize_list);
+
+static ssize_t thpsize_enabled_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	int order = to_thpsize(kobj)->order;
+	const char *output;
+
+	if (test_bit(order, &huge_anon_orders_always))
+		output = "[always] inherit madvise never";
+	else if (test_bit(order, &huge_anon_orders_inherit))
+		output = "always [inherit] madvise never";
+	else if (test_bit(order, &huge_anon_orders_madvise))
+		output = "always inherit [madvise] never";
+	else
+		output = "always inherit madvise [never]";
+
+	return sysfs_emit(buf, "%s\n", output);
+}
+
+static ssize_t thpsize_enabled_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	int order = to_thpsize(kobj)->order;
+	unsigned long *set;
+
+	if (sysfs_streq(buf, "always"))
+		set = &huge_anon_orders_always;
+	else if (sysfs_streq(buf, "inherit"))
+		set = &huge_anon_orders_inherit;
+	else if (sysfs_streq(buf, "madvise"))
+		set = &huge_anon_orders_madvise;
+	else if (sysfs_streq(buf, "never"))
+		set = NULL;
+	else
+		return -EINVAL;
+
+	spin_lock(&huge_anon_orders_lock);
+	clear_bit(order, &huge_anon_orders_always);
+	clear_bit(order, &huge_anon_orders_inherit);
+	clear_bit(order, &huge_anon_orders_madvise);
+	if (set)
+		set_bit(order, set);
+	spin_unlock(&huge_anon_orders_lock);
+
+	return count;
+}
+
+static struct kobj_attribute thpsize_enabled_attr =
+	__ATTR(enabled, 0644, thpsize_enabled_show, thpsize_enabled_store);
+
+static struct attribute *thpsize_attrs[] = {
+	&thpsize_enabled_attr.attr,
+#ifdef CONFIG_SHMEM
+	&thpsize_shmem_enabled_attr.attr,
+#endif
+	NULL,
+};
+
+static const struct attribute_group thpsize_attr_group = {
+	.attrs = thpsize_attrs,
+};
+
+static unsigned long sum_mthp_stat(int order, enum mthp_stat_item item)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += per_cpu(mthp_stats, cpu).stats[order][item];
+
+	return sum;
+}
+
+#define DEFINE_MTHP_STAT_ATTR(_name, _index)				\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	int order = to_thpsize(kobj)->order;				\
+									\
+	return sysfs_emit(buf, "%lu\n", sum_mthp_stat(order, _index));	\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+DEFINE_MTHP_STAT_ATTR(anon_fault_alloc, MTHP_STAT_ANON_FAULT_ALLOC);
+DEFINE_MTHP_STAT_ATTR(anon_fault_fallback, MTHP_STAT_ANON_FAULT_FALLBACK);
+DEFINE_MTHP_STAT_ATTR(anon_fault_fallback_charge,
+		      MTHP_STAT_ANON_FAULT_FALLBACK_CHARGE);
+DEFINE_MTHP_STAT_ATTR(shmem_alloc, MTHP_STAT_SHMEM_ALLOC);
+DEFINE_MTHP_STAT_ATTR(shmem_fallback, MTHP_STAT_SHMEM_FALLBACK);
+
+static struct attribute *thpsize_stats_attrs[] = {
+	&anon_fault_alloc_attr.attr,
+	&anon_fault_fallback_attr.attr,
+	&anon_fault_fallback_charge_attr.attr,
+	&shmem_alloc_attr.attr,
+	&shmem_fallback_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group thpsize_stats_attr_group = {
+	.name = "stats",
+	.attrs = thpsize_stats_attrs,
+};
+
+static void thpsize_release(struct kobject *kobj)
+{
+	kfree(to_thpsize(kobj));
+}
+
+static struct kobj_type thpsize_ktype = {
+	.release = &thpsize_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+};
+
+static struct thpsize *thpsize_create(int order, struct kobject *parent)
+{
+	unsigned long size = (PAGE_SIZE << order) / SZ_1K;
+	struct thpsize *thpsize;
+	int ret;
+
+	thpsize = kzalloc(sizeof(*thpsize), GFP_KERNEL);
+	if (!thpsize)
+		return ERR_PTR(-ENOMEM);
+
+	thpsize->order = order;
+
+	ret = kobject_init_and_add(&thpsize->kobj, &thpsize_ktype, parent,
+				   "hugepages-%lukB", size);
+	if (ret)
+		goto err;
+
+	ret = sysfs_create_group(&thpsize->kobj, &thpsize_attr_group);
+	if (ret)
+		goto err;
+
+	ret = sysfs_create_group(&thpsize->kobj, &thpsize_stats_attr_group);
+	if (ret)
+		goto err;
+
+	return thpsize;
+err:
+	kobject_put(&thpsize->kobj);
+	return ERR_PTR(ret);
+}
+
+static void thpsize_remove_all(void)
+{
+	struct thpsize *thpsize, *tmp;
+
+	list_for_each_entry_safe(thpsize, tmp, &thpsize_list, node) {
+		list_del(&thpsize->node);
+		kobject_put(&thpsize->kobj);
+	}
+}
+
 static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 {
-	int err;
+	unsigned long orders;
+	int err, order;
 
 	*hugepage_kobj = kobject_create_and_add("transparent_hugepage", mm_kobj);
 	if (unlikely(!*hugepage_kobj)) {
@@ -427,8 +632,25 @@ static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 		goto remove_hp_group;
 	}
 
+	orders = THP_ORDERS_ANON_PTE;
+	order = highest_order(orders);
+	while (orders) {
+		struct thpsize *thpsize = thpsize_create(order, *hugepage_kobj);
+
+		if (IS_ERR(thpsize)) {
+			pr_err("failed to create thpsize for order %d\n", order);
+			err = PTR_ERR(thpsize);
+			goto remove_all;
+		}
+		list_add(&thpsize->node, &thpsize_list);
+		order = next_order(&orders, order);
+	}
+
 	return 0;
 
+remove_all:
+	thpsize_remove_all();
+	sysfs_remove_group(*hugepage_kobj, &khugepaged_attr_group);
 remove_hp_group:
 	sysfs_remove_group(*hugepage_kobj, &hugepage_attr_group);
 delete_obj:
@@ -438,6 +660,7 @@ static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 
 static void __init hugepage_exit_sysfs(struct kobject *hugepage_kobj)
 {
+	thpsize_remove_all();
 	sysfs_remove_group(hugepage_kobj, &khugepaged_attr_group);
 	sysfs_remove_group(hugepage_kobj, &hugepage_attr_group);
 	kobject_put(hugepage_kobj);
@@ -2765,10 +2988,11 @@ int split_huge_page_to_list(struct page *page, struct list_head *list)
 			int nr = folio_nr_pages(folio);
 
 			xas_split(&xas, folio, folio_order(folio));
-			if (folio_test_swapbacked(folio)) {
+			if (folio_test_pmd_mappable(folio) &&
+			    folio_test_swapbacked(folio)) {
 				__lruvec_stat_mod_folio(folio, NR_SHMEM_THPS,
 							-nr);
-			} else {
+			} else if (folio_test_pmd_mappable(folio)) {
 				__lruvec_stat_mod_folio(folio, NR_FILE_THPS,
 							-nr);
 				filemap_nr_thps_dec(mapping);
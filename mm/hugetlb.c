@@ -44,6 +44,7 @@
 #include <linux/hugetlb_cgroup.h>
 #include <linux/node.h>
 #include <linux/page_owner.h>
+#include <linux/padata.h>
 #include "internal.h"
 #include "hugetlb_vmemmap.h"
 
@@ -2224,6 +2225,104 @@ static int alloc_pool_huge_page(struct hstate *h, nodemask_t *nodes_allowed,
 	return 0;
 }
 
+/*
+ * Growing the pool by many pages at runtime is dominated by per-page work
+ * that does not need hugetlb_lock: finding and compacting a free range,
+ * and HVO freeing the tail vmemmap pages.  Large requests are spread
+ * over padata helpers, one helper per node by preference, with page i
+ * of the request interleaved onto the i-th allowed node just like the
+ * serial path would place it.
+ */
+struct hugetlb_pool_grow {
+	struct hstate		*h;
+	nodemask_t		*nodes_allowed;
+	nodemask_t		*node_alloc_noretry;
+	int			*nids;
+	int			nr_nids;
+	atomic_long_t		failed;
+};
+
+static void hugetlb_pool_grow_chunk(unsigned long start, unsigned long end,
+				    void *arg)
+{
+	struct hugetlb_pool_grow *grow = arg;
+	struct hstate *h = grow->h;
+	gfp_t gfp_mask = htlb_alloc_mask(h) | __GFP_THISNODE;
+	struct folio *folio;
+	unsigned long i;
+	int n, nid;
+
+	for (i = start; i < end; i++) {
+		/* Once the allowed nodes are exhausted, stop trying hard. */
+		if (atomic_long_read(&grow->failed))
+			return;
+
+		for (n = 0; n < grow->nr_nids; n++) {
+			nid = grow->nids[(i + n) % grow->nr_nids];
+			folio = alloc_fresh_hugetlb_folio(h, gfp_mask, nid,
+					grow->nodes_allowed,
+					grow->node_alloc_noretry);
+			if (folio)
+				break;
+		}
+		if (!folio) {
+			atomic_long_inc(&grow->failed);
+			return;
+		}
+		free_huge_page(&folio->page);
+		cond_resched();
+	}
+}
+
+/*
+ * Try to add @count fresh pages to the pool in parallel.  Whatever is
+ * left over, because the request was too small to be worth it or because
+ * some allocations failed, is up to the caller's serial loop.
+ */
+static void hugetlb_pool_grow_parallel(struct hstate *h, unsigned long count,
+				       nodemask_t *nodes_allowed,
+				       nodemask_t *node_alloc_noretry)
+{
+	struct hugetlb_pool_grow grow = {
+		.h			= h,
+		.nodes_allowed		= nodes_allowed,
+		.node_alloc_noretry	= node_alloc_noretry,
+		.failed			= ATOMIC_LONG_INIT(0),
+	};
+	struct padata_mt_job job = {
+		.thread_fn	= hugetlb_pool_grow_chunk,
+		.fn_arg		= &grow,
+		.start		= 0,
+		.size		= count,
+		.align		= 1,
+		.numa_aware	= true,
+		.killable	= true,
+	};
+	int nid;
+
+	if (!IS_ENABLED(CONFIG_PADATA) || num_online_cpus() == 1)
+		return;
+
+	grow.nr_nids = nodes_weight(*nodes_allowed);
+	/* Gigantic pages are worth a helper each; small ones are cheap. */
+	job.min_chunk = hstate_is_gigantic(h) ? 1 : 32;
+	if (!grow.nr_nids || count < 2 * job.min_chunk)
+		return;
+
+	grow.nids = kmalloc_array(grow.nr_nids, sizeof(int), GFP_KERNEL);
+	if (!grow.nids)
+		return;
+
+	grow.nr_nids = 0;
+	for_each_node_mask(nid, *nodes_allowed)
+		grow.nids[grow.nr_nids++] = nid;
+
+	job.max_threads = min_t(int, num_online_cpus(), 2 * grow.nr_nids);
+	padata_do_multithreaded(&job);
+
+	kfree(grow.nids);
+}
+
 /*
  * Remove huge page from pool from next node to free.  Attempt to keep
  * persistent huge pages more or less balanced over allowed nodes.
@@ -3505,6 +3604,15 @@ static int set_max_huge_pages(struct hstate *h, unsigned long count, int nid,
 			break;
 	}
 
+	if (count > persistent_huge_pages(h)) {
+		unsigned long nr = count - persistent_huge_pages(h);
+
+		spin_unlock_irq(&hugetlb_lock);
+		hugetlb_pool_grow_parallel(h, nr, nodes_allowed,
+					   node_alloc_noretry);
+		spin_lock_irq(&hugetlb_lock);
+	}
+
 	while (count > persistent_huge_pages(h)) {
 		/*
 		 * If this allocation races such that we no longer need the
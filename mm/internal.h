@@ -848,4 +848,62 @@ static inline bool vma_soft_dirty_enabled(struct vm_area_struct *vma)
 	return !(vma->vm_flags & VM_SOFTDIRTY);
 }
 
+/*
+ * mm/huge_memory.c
+ */
+enum mthp_stat_item {
+	MTHP_STAT_ANON_FAULT_ALLOC,
+	MTHP_STAT_ANON_FAULT_FALLBACK,
+	MTHP_STAT_ANON_FAULT_FALLBACK_CHARGE,
+	MTHP_STAT_SHMEM_ALLOC,
+	MTHP_STAT_SHMEM_FALLBACK,
+	__MTHP_STAT_COUNT
+};
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+struct mthp_stat {
+	unsigned long stats[MAX_ORDER][__MTHP_STAT_COUNT];
+};
+
+DECLARE_PER_CPU(struct mthp_stat, mthp_stats);
+
+static inline void count_mthp_stat(int order, enum mthp_stat_item item)
+{
+	if (order <= 0 || order >= MAX_ORDER)
+		return;
+
+	this_cpu_inc(mthp_stats.stats[order][item]);
+}
+#else
+static inline void count_mthp_stat(int order, enum mthp_stat_item item)
+{
+}
+#endif
+
+#ifdef CONFIG_PT_RECLAIM
+/* Whether no entry of the PTE table @table is in use */
+static inline bool pte_table_none(pte_t *table)
+{
+	int i;
+
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		if (!pte_none(ptep_get(table + i)))
+			return false;
+	return true;
+}
+
+void pt_reclaim_queue(struct mm_struct *mm, unsigned long start,
+		      unsigned long end);
+#else
+static inline bool pte_table_none(pte_t *table)
+{
+	return false;
+}
+
+static inline void pt_reclaim_queue(struct mm_struct *mm, unsigned long start,
+				    unsigned long end)
+{
+}
+#endif
+
 #endif	/* __MM_INTERNAL_H */
@@ -133,6 +133,32 @@ static struct khugepaged_scan khugepaged_scan = {
 	.mm_head = LIST_HEAD_INIT(khugepaged_scan.mm_head),
 };
 
+/*
+ * PMD ranges reported hot by NUMA hinting faults and the MGLRU page table
+ * walk get collapsed before the periodic scan resumes, hottest first.
+ *
+ * The queue is a small direct-mapped table: reporting a queued range heats
+ * it up, reporting another range that maps to the same entry cools it down
+ * and takes the entry over once it is cold. Entries only point to mms that
+ * have a khugepaged_mm_slot and are cleared before that slot goes away.
+ */
+#define KHUGEPAGED_HOT_BITS	8
+/* heat a range needs before it is worth a collapse attempt */
+#define KHUGEPAGED_HOT_MIN	2
+/* heat at which khugepaged is woken up instead of waiting for its scan */
+#define KHUGEPAGED_HOT_WAKEUP	8
+
+struct khugepaged_hot_range {
+	struct mm_struct *mm;
+	unsigned long haddr;
+	unsigned int heat;
+};
+
+static struct khugepaged_hot_range khugepaged_hot_ranges[1 << KHUGEPAGED_HOT_BITS];
+static DEFINE_SPINLOCK(khugepaged_hot_lock);
+static bool khugepaged_hot_pending;
+static unsigned int khugepaged_hot_collapsed;
+
 #ifdef CONFIG_SYSFS
 static ssize_t scan_sleep_millisecs_show(struct kobject *kobj,
 					 struct kobj_attribute *attr,
@@ -153,7 +179,7 @@ static ssize_t scan_sleep_millisecs_store(struct kobject *kobj,
 		return -EINVAL;
 
 	khugepaged_scan_sleep_millisecs = msecs;
-	khugepaged_sleep_expire = 0;
+	khugepaged_sleep_expire = jiffies;
 	wake_up_interruptible(&khugepaged_wait);
 
 	return count;
@@ -230,6 +256,15 @@ static ssize_t full_scans_show(struct kobject *kobj,
 static struct kobj_attribute full_scans_attr =
 	__ATTR_RO(full_scans);
 
+static ssize_t hot_collapsed_show(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  char *buf)
+{
+	return sysfs_emit(buf, "%u\n", khugepaged_hot_collapsed);
+}
+static struct kobj_attribute hot_collapsed_attr =
+	__ATTR_RO(hot_collapsed);
+
 static ssize_t defrag_show(struct kobject *kobj,
 			   struct kobj_attribute *attr, char *buf)
 {
@@ -338,6 +373,7 @@ static struct attribute *khugepaged_attr[] = {
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
 	&full_scans_attr.attr,
+	&hot_collapsed_attr.attr,
 	&scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	NULL,
@@ -447,6 +483,59 @@ void __khugepaged_enter(struct mm_struct *mm)
 		wake_up_interruptible(&khugepaged_wait);
 }
 
+static void khugepaged_hot_forget(struct mm_struct *mm)
+{
+	int i;
+
+	spin_lock(&khugepaged_hot_lock);
+	for (i = 0; i < ARRAY_SIZE(khugepaged_hot_ranges); i++) {
+		struct khugepaged_hot_range *hot = &khugepaged_hot_ranges[i];
+
+		if (hot->mm == mm) {
+			hot->mm = NULL;
+			hot->heat = 0;
+		}
+	}
+	spin_unlock(&khugepaged_hot_lock);
+}
+
+void __khugepaged_hot(struct vm_area_struct *vma, unsigned long addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long haddr = addr & HPAGE_PMD_MASK;
+	struct khugepaged_hot_range *hot;
+	bool wakeup = false;
+
+	if (!vma_is_anonymous(vma) || !transhuge_vma_suitable(vma, haddr))
+		return;
+	if (!hugepage_vma_check(vma, vma->vm_flags, false, false, true))
+		return;
+
+	/* Best effort, the fault and reclaim paths must not wait here */
+	if (!spin_trylock(&khugepaged_hot_lock))
+		return;
+
+	hot = &khugepaged_hot_ranges[hash_long((unsigned long)mm ^ haddr,
+					       KHUGEPAGED_HOT_BITS)];
+	if (hot->mm == mm && hot->haddr == haddr) {
+		if (hot->heat < UINT_MAX)
+			hot->heat++;
+		wakeup = hot->heat == KHUGEPAGED_HOT_WAKEUP;
+	} else if (!hot->heat) {
+		hot->mm = mm;
+		hot->haddr = haddr;
+		hot->heat = 1;
+	} else {
+		hot->heat--;
+	}
+	spin_unlock(&khugepaged_hot_lock);
+
+	if (wakeup) {
+		WRITE_ONCE(khugepaged_hot_pending, true);
+		wake_up_interruptible(&khugepaged_wait);
+	}
+}
+
 void khugepaged_enter_vma(struct vm_area_struct *vma,
 			  unsigned long vm_flags)
 {
@@ -475,6 +564,7 @@ void __khugepaged_exit(struct mm_struct *mm)
 
 	if (free) {
 		clear_bit(MMF_VM_HUGEPAGE, &mm->flags);
+		khugepaged_hot_forget(mm);
 		mm_slot_free(mm_slot_cache, mm_slot);
 		mmdrop(mm);
 	} else if (mm_slot) {
@@ -1030,6 +1120,7 @@ static int collapse_huge_page(struct mm_struct *mm, unsigned long address,
 	if (result != SCAN_SUCCEED)
 		goto out_up_write;
 
+	vma_start_write(vma);
 	anon_vma_lock_write(vma->anon_vma);
 
 	mmu_notifier_range_init(&range, MMU_NOTIFY_CLEAR, 0, NULL, mm,
@@ -1301,6 +1392,8 @@ static void collect_mm_slot(struct khugepaged_mm_slot *mm_slot)
 		 * clear_bit(MMF_VM_HUGEPAGE, &mm->flags);
 		 */
 
+		khugepaged_hot_forget(mm);
+
 		/* khugepaged_mm_lock actually not necessary for the below */
 		mm_slot_free(mm_slot_cache, mm_slot);
 		mmdrop(mm);
@@ -1395,6 +1488,7 @@ static void collapse_and_free_pmd(struct mm_struct *mm, struct vm_area_struct *v
 	struct mmu_notifier_range range;
 
 	mmap_assert_write_locked(mm);
+	vma_start_write(vma);
 	if (vma->vm_file)
 		lockdep_assert_held_write(&vma->vm_file->f_mapping->i_mmap_rwsem);
 	/*
@@ -2387,6 +2481,89 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 	return progress;
 }
 
+/*
+ * Try to collapse the hot range @haddr of @mm. @mm may have exited since
+ * the range was queued, only use it while it still has a mm_slot.
+ */
+static int khugepaged_collapse_hot(struct mm_struct *mm, unsigned long haddr,
+				   struct collapse_control *cc)
+{
+	struct vm_area_struct *vma;
+	bool mmap_locked = true;
+	bool alive;
+	int result;
+
+	spin_lock(&khugepaged_mm_lock);
+	alive = mm_slot_lookup(mm_slots_hash, mm) && mmget_not_zero(mm);
+	spin_unlock(&khugepaged_mm_lock);
+	if (!alive)
+		return SCAN_ANY_PROCESS;
+
+	if (!mmap_read_trylock(mm)) {
+		result = SCAN_FAIL;
+		goto out;
+	}
+
+	result = hugepage_vma_revalidate(mm, haddr, true, &vma, cc);
+	if (result == SCAN_SUCCEED)
+		result = hpage_collapse_scan_pmd(mm, vma, haddr, &mmap_locked,
+						 cc);
+	if (mmap_locked)
+		mmap_read_unlock(mm);
+
+	if (result == SCAN_SUCCEED) {
+		++khugepaged_pages_collapsed;
+		++khugepaged_hot_collapsed;
+	}
+out:
+	mmput(mm);
+	return result;
+}
+
+/*
+ * Collapse the queued hot ranges, hottest first, within the @pages budget
+ * of one khugepaged pass. Returns the part of the budget used.
+ */
+static unsigned int khugepaged_scan_hot(unsigned int pages, int *result,
+					struct collapse_control *cc)
+{
+	unsigned int progress = 0;
+
+	WRITE_ONCE(khugepaged_hot_pending, false);
+
+	while (progress < pages) {
+		struct khugepaged_hot_range hottest = { .heat = 0 };
+		int i, idx = 0;
+
+		cond_resched();
+		if (unlikely(kthread_should_stop()))
+			break;
+
+		spin_lock(&khugepaged_hot_lock);
+		for (i = 0; i < ARRAY_SIZE(khugepaged_hot_ranges); i++) {
+			if (khugepaged_hot_ranges[i].heat > hottest.heat) {
+				hottest = khugepaged_hot_ranges[i];
+				idx = i;
+			}
+		}
+		if (hottest.heat >= KHUGEPAGED_HOT_MIN) {
+			khugepaged_hot_ranges[idx].mm = NULL;
+			khugepaged_hot_ranges[idx].heat = 0;
+		}
+		spin_unlock(&khugepaged_hot_lock);
+
+		if (hottest.heat < KHUGEPAGED_HOT_MIN)
+			break;
+
+		*result = khugepaged_collapse_hot(hottest.mm, hottest.haddr, cc);
+		progress += HPAGE_PMD_NR;
+		if (*result == SCAN_ALLOC_HUGE_PAGE_FAIL)
+			break;
+	}
+
+	return progress;
+}
+
 static int khugepaged_has_work(void)
 {
 	return !list_empty(&khugepaged_scan.mm_head) &&
@@ -2399,15 +2576,26 @@ static int khugepaged_wait_event(void)
 		kthread_should_stop();
 }
 
-static void khugepaged_do_scan(struct collapse_control *cc)
+/*
+ * One khugepaged pass, the hot ranges first and then the periodic scan with
+ * what is left of the budget. When woken up early just for hot ranges, the
+ * periodic scan is left to its own schedule and false is returned.
+ */
+static bool khugepaged_do_scan(struct collapse_control *cc)
 {
 	unsigned int progress = 0, pass_through_head = 0;
 	unsigned int pages = READ_ONCE(khugepaged_pages_to_scan);
+	bool hot_only = READ_ONCE(khugepaged_hot_pending) &&
+			time_before(jiffies, khugepaged_sleep_expire);
 	bool wait = true;
 	int result = SCAN_SUCCEED;
 
 	lru_add_drain_all();
 
+	progress = khugepaged_scan_hot(pages, &result, cc);
+	if (hot_only)
+		return false;
+
 	while (true) {
 		cond_resched();
 
@@ -2439,15 +2627,18 @@ static void khugepaged_do_scan(struct collapse_control *cc)
 			khugepaged_alloc_sleep();
 		}
 	}
+
+	return true;
 }
 
 static bool khugepaged_should_wakeup(void)
 {
 	return kthread_should_stop() ||
+	       READ_ONCE(khugepaged_hot_pending) ||
 	       time_after_eq(jiffies, khugepaged_sleep_expire);
 }
 
-static void khugepaged_wait_work(void)
+static void khugepaged_wait_work(bool scanned)
 {
 	if (khugepaged_has_work()) {
 		const unsigned long scan_sleep_jiffies =
@@ -2456,10 +2647,14 @@ static void khugepaged_wait_work(void)
 		if (!scan_sleep_jiffies)
 			return;
 
-		khugepaged_sleep_expire = jiffies + scan_sleep_jiffies;
+		/* keep the periodic scan on schedule after a hot only pass */
+		if (scanned)
+			khugepaged_sleep_expire = jiffies + scan_sleep_jiffies;
+		else if (time_after_eq(jiffies, khugepaged_sleep_expire))
+			return;
 		wait_event_freezable_timeout(khugepaged_wait,
 					     khugepaged_should_wakeup(),
-					     scan_sleep_jiffies);
+					     khugepaged_sleep_expire - jiffies);
 		return;
 	}
 
@@ -2475,8 +2670,9 @@ static int khugepaged(void *none)
 	set_user_nice(current, MAX_NICE);
 
 	while (!kthread_should_stop()) {
-		khugepaged_do_scan(&khugepaged_collapse_control);
-		khugepaged_wait_work();
+		bool scanned = khugepaged_do_scan(&khugepaged_collapse_control);
+
+		khugepaged_wait_work(scanned);
 	}
 
 	spin_lock(&khugepaged_mm_lock);
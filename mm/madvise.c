@@ -179,6 +179,7 @@ static int madvise_update_vma(struct vm_area_struct *vma,
 	/*
 	 * vm_flags is protected by the mmap_lock held in write mode.
 	 */
+	vma_start_write(vma);
 	vma->vm_flags = new_flags;
 	if (!vma->vm_file || vma_is_anon_shmem(vma)) {
 		error = replace_anon_vma_name(vma, anon_name);
@@ -805,7 +806,13 @@ static int madvise_free_single_vma(struct vm_area_struct *vma,
 static long madvise_dontneed_single_vma(struct vm_area_struct *vma,
 					unsigned long start, unsigned long end)
 {
-	zap_page_range_single(vma, start, end - start, NULL);
+	struct zap_details details = {
+		.even_cows = true,
+		.zap_flags = IS_ENABLED(CONFIG_PT_RECLAIM) ?
+			     ZAP_FLAG_RECLAIM_PT : 0,
+	};
+
+	zap_page_range_single(vma, start, end - start, &details);
 	return 0;
 }
 
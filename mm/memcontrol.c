@@ -64,11 +64,13 @@
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
 #include <linux/parser.h>
+#include <linux/random.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
 #include "slab.h"
 #include "swap.h"
+#include <linux/zswap.h>
 
 #include <linux/uaccess.h>
 
@@ -559,6 +561,36 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
 	return mz;
 }
 
+struct memcg_vmstats_percpu {
+	/* Local (CPU and cgroup) page state & events */
+	long			state[MEMCG_NR_STAT];
+	unsigned long		events[NR_MEMCG_EVENTS];
+
+	/* Delta calculation for lockless upward propagation */
+	long			state_prev[MEMCG_NR_STAT];
+	unsigned long		events_prev[NR_MEMCG_EVENTS];
+
+	/* Cgroup1: threshold notifications & softlimit tree updates */
+	unsigned long		nr_page_events;
+	unsigned long		targets[MEM_CGROUP_NTARGETS];
+
+	/* Stats updates of this CPU in the subtree since the last flush */
+	unsigned int		stats_updates;
+};
+
+struct memcg_vmstats {
+	/* Aggregated (CPU and subtree) page state & events */
+	long			state[MEMCG_NR_STAT];
+	unsigned long		events[NR_MEMCG_EVENTS];
+
+	/* Pending child counts during tree propagation */
+	long			state_pending[MEMCG_NR_STAT];
+	unsigned long		events_pending[NR_MEMCG_EVENTS];
+
+	/* Stats updates in the subtree since the last flush */
+	atomic64_t		stats_updates;
+};
+
 /*
  * memcg and lruvec stats flushing
  *
@@ -569,16 +601,19 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
  * 1) Periodically and asynchronously flush the stats every 2 seconds to not let
  *    rstat update tree grow unbounded.
  *
- * 2) Flush the stats synchronously on reader side only when there are more than
- *    (MEMCG_CHARGE_BATCH * nr_cpus) update events. Though this optimization
- *    will let stats be out of sync by atmost (MEMCG_CHARGE_BATCH * nr_cpus) but
- *    only for 2 seconds due to (1).
+ * 2) Flush the stats synchronously on reader side only when the subtree being
+ *    read saw more than (MEMCG_CHARGE_BATCH * nr_cpus) update events. Though
+ *    this optimization will let stats be out of sync by atmost
+ *    (MEMCG_CHARGE_BATCH * nr_cpus) but only for 2 seconds due to (1).
+ *
+ * Readers only flush the subtree they read from, so a busy cgroup elsewhere
+ * in the hierarchy doesn't make every reader pay for a full flush. Only one
+ * flush of the whole hierarchy runs at a time, concurrent ones don't wait for
+ * it on the rstat lock but skip it.
  */
 static void flush_memcg_stats_dwork(struct work_struct *w);
 static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
-static DEFINE_SPINLOCK(stats_flush_lock);
-static DEFINE_PER_CPU(unsigned int, stats_updates);
-static atomic_t stats_flush_threshold = ATOMIC_INIT(0);
+static atomic_t stats_flush_ongoing = ATOMIC_INIT(0);
 static u64 flush_next_time;
 
 #define FLUSH_TIME (2UL*HZ)
@@ -605,54 +640,84 @@ static void memcg_stats_unlock(void)
 	preempt_enable_nested();
 }
 
+static bool memcg_vmstats_needs_flush(struct memcg_vmstats *vmstats)
+{
+	return atomic64_read(&vmstats->stats_updates) >
+		MEMCG_CHARGE_BATCH * num_online_cpus();
+}
+
 static inline void memcg_rstat_updated(struct mem_cgroup *memcg, int val)
 {
 	unsigned int x;
 
 	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
 
-	x = __this_cpu_add_return(stats_updates, abs(val));
-	if (x > MEMCG_CHARGE_BATCH) {
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		x = __this_cpu_add_return(memcg->vmstats_percpu->stats_updates,
+					  abs(val));
+		if (x < MEMCG_CHARGE_BATCH)
+			continue;
+
 		/*
-		 * If stats_flush_threshold exceeds the threshold
-		 * (>num_online_cpus()), cgroup stats update will be triggered
-		 * in __mem_cgroup_flush_stats(). Increasing this var further
-		 * is redundant and simply adds overhead in atomic update.
+		 * If the subtree already needs a flush, increasing
+		 * stats_updates further is redundant and simply adds
+		 * overhead in atomic update.
 		 */
-		if (atomic_read(&stats_flush_threshold) <= num_online_cpus())
-			atomic_add(x / MEMCG_CHARGE_BATCH, &stats_flush_threshold);
-		__this_cpu_write(stats_updates, 0);
+		if (!memcg_vmstats_needs_flush(memcg->vmstats))
+			atomic64_add(x, &memcg->vmstats->stats_updates);
+		__this_cpu_write(memcg->vmstats_percpu->stats_updates, 0);
 	}
 }
 
-static void __mem_cgroup_flush_stats(void)
+static void do_flush_stats(struct mem_cgroup *memcg)
 {
-	unsigned long flag;
+	bool full = mem_cgroup_is_root(memcg);
 
-	if (!spin_trylock_irqsave(&stats_flush_lock, flag))
-		return;
+	if (full) {
+		if (atomic_read(&stats_flush_ongoing) ||
+		    atomic_xchg(&stats_flush_ongoing, 1))
+			return;
+		WRITE_ONCE(flush_next_time, jiffies_64 + 2*FLUSH_TIME);
+	}
+
+	cgroup_rstat_flush_irqsafe(memcg->css.cgroup);
 
-	flush_next_time = jiffies_64 + 2*FLUSH_TIME;
-	cgroup_rstat_flush_irqsafe(root_mem_cgroup->css.cgroup);
-	atomic_set(&stats_flush_threshold, 0);
-	spin_unlock_irqrestore(&stats_flush_lock, flag);
+	if (full)
+		atomic_set(&stats_flush_ongoing, 0);
 }
 
-void mem_cgroup_flush_stats(void)
+/**
+ * mem_cgroup_flush_stats - flush the stats of a memory cgroup subtree
+ * @memcg: root of the subtree to flush, %NULL for the whole hierarchy
+ *
+ * The subtree is only flushed if it saw enough updates since its last flush
+ * for the stats to be noticeably out of date.
+ */
+void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
 {
-	if (atomic_read(&stats_flush_threshold) > num_online_cpus())
-		__mem_cgroup_flush_stats();
+	if (mem_cgroup_disabled())
+		return;
+
+	if (!memcg)
+		memcg = root_mem_cgroup;
+
+	if (memcg_vmstats_needs_flush(memcg->vmstats))
+		do_flush_stats(memcg);
 }
 
 void mem_cgroup_flush_stats_delayed(void)
 {
-	if (time_after64(jiffies_64, flush_next_time))
-		mem_cgroup_flush_stats();
+	if (time_after64(jiffies_64, READ_ONCE(flush_next_time)))
+		mem_cgroup_flush_stats(NULL);
 }
 
 static void flush_memcg_stats_dwork(struct work_struct *w)
 {
-	__mem_cgroup_flush_stats();
+	/*
+	 * Flush regardless of the update count, this is what bounds the
+	 * time the stats can stay out of date.
+	 */
+	do_flush_stats(root_mem_cgroup);
 	queue_delayed_work(system_unbound_wq, &stats_flush_dwork, FLUSH_TIME);
 }
 
@@ -681,6 +746,9 @@ static const unsigned int memcg_vm_event_stat[] = {
 	THP_FAULT_ALLOC,
 	THP_COLLAPSE_ALLOC,
 #endif
+#ifdef CONFIG_PT_RECLAIM
+	PT_RECLAIM,
+#endif
 };
 
 #define NR_MEMCG_EVENTS ARRAY_SIZE(memcg_vm_event_stat)
@@ -699,30 +767,6 @@ static inline int memcg_events_index(enum vm_event_item idx)
 	return mem_cgroup_events_index[idx] - 1;
 }
 
-struct memcg_vmstats_percpu {
-	/* Local (CPU and cgroup) page state & events */
-	long			state[MEMCG_NR_STAT];
-	unsigned long		events[NR_MEMCG_EVENTS];
-
-	/* Delta calculation for lockless upward propagation */
-	long			state_prev[MEMCG_NR_STAT];
-	unsigned long		events_prev[NR_MEMCG_EVENTS];
-
-	/* Cgroup1: threshold notifications & softlimit tree updates */
-	unsigned long		nr_page_events;
-	unsigned long		targets[MEM_CGROUP_NTARGETS];
-};
-
-struct memcg_vmstats {
-	/* Aggregated (CPU and subtree) page state & events */
-	long			state[MEMCG_NR_STAT];
-	unsigned long		events[NR_MEMCG_EVENTS];
-
-	/* Pending child counts during tree propagation */
-	long			state_pending[MEMCG_NR_STAT];
-	unsigned long		events_pending[NR_MEMCG_EVENTS];
-};
-
 unsigned long memcg_page_state(struct mem_cgroup *memcg, int idx)
 {
 	long x = READ_ONCE(memcg->vmstats->state[idx]);
@@ -1559,7 +1603,7 @@ static void memory_stat_format(struct mem_cgroup *memcg, char *buf, int bufsize)
 	 *
 	 * Current memory state:
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		u64 size;
@@ -2171,10 +2215,16 @@ void unlock_page_memcg(struct page *page)
 	folio_memcg_unlock(page_folio(page));
 }
 
+/*
+ * Number of memcgs a cpu caches charges for, so that tasks of different
+ * memcgs sharing a cpu don't keep draining each other's stock.
+ */
+#define NR_MEMCG_STOCK 7
+
 struct memcg_stock_pcp {
 	local_lock_t stock_lock;
-	struct mem_cgroup *cached; /* this never be root cgroup */
-	unsigned int nr_pages;
+	struct mem_cgroup *cached[NR_MEMCG_STOCK]; /* never the root cgroup */
+	unsigned int nr_pages[NR_MEMCG_STOCK];
 
 #ifdef CONFIG_MEMCG_KMEM
 	struct obj_cgroup *cached_objcg;
@@ -2219,9 +2269,9 @@ static void memcg_account_kmem(struct mem_cgroup *memcg, int nr_pages)
  * @memcg: memcg to consume from.
  * @nr_pages: how many pages to charge.
  *
- * The charges will only happen if @memcg matches the current cpu's memcg
- * stock, and at least @nr_pages are available in that stock.  Failure to
- * service an allocation will refill the stock.
+ * The charges will only happen if @memcg is one of the memcgs cached in the
+ * current cpu's stock, and at least @nr_pages are available in its slot.
+ * Failure to service an allocation will refill the stock.
  *
  * returns true if successful, false otherwise.
  */
@@ -2230,6 +2280,7 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	struct memcg_stock_pcp *stock;
 	unsigned long flags;
 	bool ret = false;
+	int i;
 
 	if (nr_pages > MEMCG_CHARGE_BATCH)
 		return ret;
@@ -2237,9 +2288,14 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	local_lock_irqsave(&memcg_stock.stock_lock, flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (memcg == stock->cached && stock->nr_pages >= nr_pages) {
-		stock->nr_pages -= nr_pages;
-		ret = true;
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		if (memcg != stock->cached[i])
+			continue;
+		if (stock->nr_pages[i] >= nr_pages) {
+			stock->nr_pages[i] -= nr_pages;
+			ret = true;
+		}
+		break;
 	}
 
 	local_unlock_irqrestore(&memcg_stock.stock_lock, flags);
@@ -2248,24 +2304,35 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 }
 
 /*
- * Returns stocks cached in percpu and reset cached information.
+ * Returns the charges cached in slot @i of the stock and resets it.
  */
-static void drain_stock(struct memcg_stock_pcp *stock)
+static void drain_stock_slot(struct memcg_stock_pcp *stock, int i)
 {
-	struct mem_cgroup *old = stock->cached;
+	struct mem_cgroup *old = stock->cached[i];
 
 	if (!old)
 		return;
 
-	if (stock->nr_pages) {
-		page_counter_uncharge(&old->memory, stock->nr_pages);
+	if (stock->nr_pages[i]) {
+		page_counter_uncharge(&old->memory, stock->nr_pages[i]);
 		if (do_memsw_account())
-			page_counter_uncharge(&old->memsw, stock->nr_pages);
-		stock->nr_pages = 0;
+			page_counter_uncharge(&old->memsw, stock->nr_pages[i]);
+		stock->nr_pages[i] = 0;
 	}
 
 	css_put(&old->css);
-	stock->cached = NULL;
+	stock->cached[i] = NULL;
+}
+
+/*
+ * Returns stocks cached in percpu and reset cached information.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		drain_stock_slot(stock, i);
 }
 
 static void drain_local_stock(struct work_struct *dummy)
@@ -2298,17 +2365,30 @@ static void drain_local_stock(struct work_struct *dummy)
 static void __refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock;
+	int i, empty = -1;
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (stock->cached != memcg) { /* reset if necessary */
-		drain_stock(stock);
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		if (stock->cached[i] == memcg)
+			break;
+		if (empty < 0 && !stock->cached[i])
+			empty = i;
+	}
+
+	if (i == NR_MEMCG_STOCK) {
+		/* no slot for @memcg yet, evict a random one if all are used */
+		if (empty < 0) {
+			empty = get_random_u32_below(NR_MEMCG_STOCK);
+			drain_stock_slot(stock, empty);
+		}
+		i = empty;
 		css_get(&memcg->css);
-		stock->cached = memcg;
+		stock->cached[i] = memcg;
 	}
-	stock->nr_pages += nr_pages;
+	stock->nr_pages[i] += nr_pages;
 
-	if (stock->nr_pages > MEMCG_CHARGE_BATCH)
-		drain_stock(stock);
+	if (stock->nr_pages[i] > MEMCG_CHARGE_BATCH)
+		drain_stock_slot(stock, i);
 }
 
 static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
@@ -2343,13 +2423,18 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
 		struct mem_cgroup *memcg;
 		bool flush = false;
+		int i;
 
 		rcu_read_lock();
-		memcg = stock->cached;
-		if (memcg && stock->nr_pages &&
-		    mem_cgroup_is_descendant(memcg, root_memcg))
-			flush = true;
-		else if (obj_stock_flush_required(stock, root_memcg))
+		for (i = 0; i < NR_MEMCG_STOCK; i++) {
+			memcg = READ_ONCE(stock->cached[i]);
+			if (memcg && READ_ONCE(stock->nr_pages[i]) &&
+			    mem_cgroup_is_descendant(memcg, root_memcg)) {
+				flush = true;
+				break;
+			}
+		}
+		if (!flush && obj_stock_flush_required(stock, root_memcg))
 			flush = true;
 		rcu_read_unlock();
 
@@ -2402,6 +2487,62 @@ static unsigned long reclaim_high(struct mem_cgroup *memcg,
 	return nr_reclaimed;
 }
 
+#define PROACTIVE_RECLAIM_PERIOD	HZ
+#define PROACTIVE_RECLAIM_MIN_STEP	SWAP_CLUSTER_MAX
+
+/*
+ * Reclaim from the memcg once per period for as long as the pages refaulting
+ * since the last period stay within refault_target per mille of the pages
+ * reclaimed by the last period that did reclaim. The step doubles while the
+ * ratio stays below half of the target and is halved, without reclaiming for
+ * the period, when the ratio goes above the target. Reclaim itself takes the
+ * oldest pages first, i.e. the oldest generations with the multi-gen LRU.
+ */
+static void proactive_reclaim_work_func(struct work_struct *work)
+{
+	struct mem_cgroup *memcg = container_of(to_delayed_work(work),
+						struct mem_cgroup, proactive_work);
+	unsigned int target = READ_ONCE(memcg->refault_target);
+	unsigned long refaults, ratio = 0, step, max_step;
+	unsigned long reclaimed;
+
+	if (!target)
+		return;
+
+	mem_cgroup_flush_stats(memcg);
+	refaults = memcg_page_state(memcg, WORKINGSET_REFAULT_ANON) +
+		   memcg_page_state(memcg, WORKINGSET_REFAULT_FILE);
+	if (memcg->proactive_last_reclaimed)
+		ratio = (refaults - memcg->proactive_refaults) * 1000 /
+			memcg->proactive_last_reclaimed;
+
+	step = memcg->proactive_step;
+	max_step = max(page_counter_read(&memcg->memory) / 16,
+		       (unsigned long)PROACTIVE_RECLAIM_MIN_STEP);
+
+	if (ratio > target) {
+		step = max(step / 2, (unsigned long)PROACTIVE_RECLAIM_MIN_STEP);
+	} else {
+		if (ratio < target / 2)
+			step *= 2;
+		step = min(step, max_step);
+
+		reclaimed = try_to_free_mem_cgroup_pages(memcg, step, GFP_KERNEL,
+						MEMCG_RECLAIM_MAY_SWAP |
+						MEMCG_RECLAIM_PROACTIVE, NULL);
+		if (reclaimed)
+			memcg->proactive_last_reclaimed = reclaimed;
+		atomic_long_add(reclaimed, &memcg->proactive_reclaimed);
+	}
+
+	memcg->proactive_refaults = refaults;
+	memcg->proactive_step = step;
+	WRITE_ONCE(memcg->refault_ratio, ratio);
+
+	queue_delayed_work(system_unbound_wq, &memcg->proactive_work,
+			   PROACTIVE_RECLAIM_PERIOD);
+}
+
 static void high_work_func(struct work_struct *work)
 {
 	struct mem_cgroup *memcg;
@@ -3661,7 +3802,7 @@ static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	unsigned long val;
 
 	if (mem_cgroup_is_root(memcg)) {
-		mem_cgroup_flush_stats();
+		mem_cgroup_flush_stats(memcg);
 		val = memcg_page_state(memcg, NR_FILE_PAGES) +
 			memcg_page_state(memcg, NR_ANON_MAPPED);
 		if (swap)
@@ -4000,7 +4141,7 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
@@ -4076,7 +4217,7 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
@@ -4580,7 +4721,7 @@ void mem_cgroup_wb_stats(struct bdi_writeback *wb, unsigned long *pfilepages,
 	struct mem_cgroup *memcg = mem_cgroup_from_css(wb->memcg_css);
 	struct mem_cgroup *parent;
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	*pdirty = memcg_page_state(memcg, NR_FILE_DIRTY);
 	*pwriteback = memcg_page_state(memcg, NR_WRITEBACK);
@@ -5291,6 +5432,7 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 		goto fail;
 
 	INIT_WORK(&memcg->high_work, high_work_func);
+	INIT_DELAYED_WORK(&memcg->proactive_work, proactive_reclaim_work_func);
 	INIT_LIST_HEAD(&memcg->oom_notify);
 	mutex_init(&memcg->thresholds_lock);
 	spin_lock_init(&memcg->move_lock);
@@ -5415,6 +5557,9 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 	page_counter_set_min(&memcg->memory, 0);
 	page_counter_set_low(&memcg->memory, 0);
 
+	WRITE_ONCE(memcg->refault_target, 0);
+	cancel_delayed_work_sync(&memcg->proactive_work);
+
 	memcg_offline_kmem(memcg);
 	reparent_shrinker_deferred(memcg);
 	wb_memcg_offline(memcg);
@@ -5450,6 +5595,9 @@ static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
 	cancel_work_sync(&memcg->high_work);
 	mem_cgroup_remove_from_trees(memcg);
 	free_shrinker_info(memcg);
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+	zswap_pool_release(rcu_dereference_protected(memcg->zswap_pool, true));
+#endif
 	mem_cgroup_free(memcg);
 }
 
@@ -5566,6 +5714,10 @@ static void mem_cgroup_css_rstat_flush(struct cgroup_subsys_state *css, int cpu)
 				ppn->lruvec_stats.state_pending[i] += delta;
 		}
 	}
+	statc->stats_updates = 0;
+	/* We are in a per-cpu loop here, only do the atomic write once */
+	if (atomic64_read(&memcg->vmstats->stats_updates))
+		atomic64_set(&memcg->vmstats->stats_updates, 0);
 }
 
 #ifdef CONFIG_MMU
@@ -6547,7 +6699,7 @@ static int memory_numa_stat_show(struct seq_file *m, void *v)
 	int i;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		int nid;
@@ -6572,6 +6724,147 @@ static int memory_numa_stat_show(struct seq_file *m, void *v)
 }
 #endif
 
+#ifdef CONFIG_LRU_GEN
+/* protects mem_cgroup->page_age_intervals */
+static DEFINE_SPINLOCK(memcg_page_age_lock);
+
+static int memcg_page_age_intervals(struct mem_cgroup *memcg,
+				    unsigned int *intervals)
+{
+	int nr;
+
+	spin_lock(&memcg_page_age_lock);
+	nr = memcg->nr_page_age_intervals;
+	memcpy(intervals, memcg->page_age_intervals, nr * sizeof(*intervals));
+	spin_unlock(&memcg_page_age_lock);
+
+	return nr;
+}
+
+static int memory_page_age_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	unsigned long pages[MAX_NR_AGE_INTERVALS + 1][ANON_AND_FILE] = {};
+	unsigned int intervals[MAX_NR_AGE_INTERVALS];
+	int i, nr;
+
+	nr = memcg_page_age_intervals(memcg, intervals);
+	lru_gen_page_age(memcg, intervals, nr, pages);
+
+	for (i = 0; i <= nr; i++) {
+		if (i < nr)
+			seq_printf(m, "%u", intervals[i]);
+		else
+			seq_puts(m, "max");
+		seq_printf(m, " anon=%llu file=%llu\n",
+			   (u64)pages[i][LRU_GEN_ANON] * PAGE_SIZE,
+			   (u64)pages[i][LRU_GEN_FILE] * PAGE_SIZE);
+	}
+
+	return 0;
+}
+
+static int memory_page_age_intervals_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	unsigned int intervals[MAX_NR_AGE_INTERVALS];
+	int i, nr;
+
+	nr = memcg_page_age_intervals(memcg, intervals);
+	for (i = 0; i < nr; i++)
+		seq_printf(m, "%s%u", i ? " " : "", intervals[i]);
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static ssize_t memory_page_age_intervals_write(struct kernfs_open_file *of,
+					       char *buf, size_t nbytes,
+					       loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int intervals[MAX_NR_AGE_INTERVALS];
+	char *start;
+	int nr = 0;
+
+	buf = strstrip(buf);
+
+	while ((start = strsep(&buf, " ")) != NULL) {
+		if (!strlen(start))
+			continue;
+		if (nr == MAX_NR_AGE_INTERVALS)
+			return -EINVAL;
+		if (kstrtouint(start, 10, &intervals[nr]) || !intervals[nr])
+			return -EINVAL;
+		if (nr && intervals[nr] <= intervals[nr - 1])
+			return -EINVAL;
+		nr++;
+	}
+
+	if (!nr)
+		return -EINVAL;
+
+	spin_lock(&memcg_page_age_lock);
+	memcpy(memcg->page_age_intervals, intervals, nr * sizeof(*intervals));
+	memcg->nr_page_age_intervals = nr;
+	spin_unlock(&memcg_page_age_lock);
+
+	return nbytes;
+}
+#endif
+
+static int memory_reclaim_refault_target_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "%u\n", READ_ONCE(mem_cgroup_from_seq(m)->refault_target));
+
+	return 0;
+}
+
+static ssize_t memory_reclaim_refault_target_write(struct kernfs_open_file *of,
+						   char *buf, size_t nbytes,
+						   loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int target;
+	int ret;
+
+	buf = strstrip(buf);
+	ret = kstrtouint(buf, 0, &target);
+	if (ret)
+		return ret;
+
+	if (target > 1000)
+		return -EINVAL;
+
+	if (!xchg(&memcg->refault_target, target) && target) {
+		cancel_delayed_work_sync(&memcg->proactive_work);
+
+		mem_cgroup_flush_stats(memcg);
+		memcg->proactive_refaults =
+			memcg_page_state(memcg, WORKINGSET_REFAULT_ANON) +
+			memcg_page_state(memcg, WORKINGSET_REFAULT_FILE);
+		memcg->proactive_last_reclaimed = 0;
+		memcg->proactive_step = PROACTIVE_RECLAIM_MIN_STEP;
+
+		queue_delayed_work(system_unbound_wq, &memcg->proactive_work, 0);
+	}
+
+	return nbytes;
+}
+
+static int memory_reclaim_stat_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+
+	seq_printf(m, "refault_ratio %lu\n", READ_ONCE(memcg->refault_ratio));
+	seq_printf(m, "step %llu\n",
+		   (u64)READ_ONCE(memcg->proactive_step) * PAGE_SIZE);
+	seq_printf(m, "reclaimed %llu\n",
+		   (u64)atomic_long_read(&memcg->proactive_reclaimed) * PAGE_SIZE);
+
+	return 0;
+}
+
 static int memory_oom_group_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
@@ -6735,6 +7028,18 @@ static struct cftype memory_files[] = {
 		.name = "numa_stat",
 		.seq_show = memory_numa_stat_show,
 	},
+#endif
+#ifdef CONFIG_LRU_GEN
+	{
+		.name = "page_age",
+		.file_offset = offsetof(struct mem_cgroup, page_age_file),
+		.seq_show = memory_page_age_show,
+	},
+	{
+		.name = "page_age.intervals",
+		.seq_show = memory_page_age_intervals_show,
+		.write = memory_page_age_intervals_write,
+	},
 #endif
 	{
 		.name = "oom.group",
@@ -6747,6 +7052,17 @@ static struct cftype memory_files[] = {
 		.flags = CFTYPE_NS_DELEGATABLE,
 		.write = memory_reclaim,
 	},
+	{
+		.name = "reclaim.refault_target",
+		.flags = CFTYPE_NOT_ON_ROOT | CFTYPE_NS_DELEGATABLE,
+		.seq_show = memory_reclaim_refault_target_show,
+		.write = memory_reclaim_refault_target_write,
+	},
+	{
+		.name = "reclaim.stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_reclaim_stat_show,
+	},
 	{ }	/* terminate */
 };
 
@@ -7057,9 +7373,21 @@ static void uncharge_batch(const struct uncharge_gather *ug)
 	unsigned long flags;
 
 	if (ug->nr_memory) {
-		page_counter_uncharge(&ug->memcg->memory, ug->nr_memory);
-		if (do_memsw_account())
-			page_counter_uncharge(&ug->memcg->memsw, ug->nr_memory);
+		/*
+		 * Small uncharges go to the percpu stock, where they are
+		 * either reused by the next charges of the memcg on this cpu
+		 * or returned to the page counters in one batch, instead of
+		 * walking the hierarchy of counters for every freed folio.
+		 */
+		if (ug->nr_memory <= MEMCG_CHARGE_BATCH &&
+		    !mem_cgroup_is_root(ug->memcg)) {
+			refill_stock(ug->memcg, ug->nr_memory);
+		} else {
+			page_counter_uncharge(&ug->memcg->memory, ug->nr_memory);
+			if (do_memsw_account())
+				page_counter_uncharge(&ug->memcg->memsw,
+						      ug->nr_memory);
+		}
 		if (ug->nr_kmem)
 			memcg_account_kmem(ug->memcg, -ug->nr_kmem);
 		memcg_oom_recover(ug->memcg);
@@ -7790,6 +8118,30 @@ void obj_cgroup_uncharge_zswap(struct obj_cgroup *objcg, size_t size)
 	rcu_read_unlock();
 }
 
+/**
+ * mem_cgroup_zswap_pool - zswap pool selected for a cgroup
+ * @memcg: the memory cgroup
+ *
+ * Returns the pool of the compressor set in memory.zswap.compressor of
+ * @memcg or its nearest ancestor that has one, NULL if none of them do.
+ * The caller must hold the RCU read lock and take a pool reference.
+ */
+struct zswap_pool *mem_cgroup_zswap_pool(struct mem_cgroup *memcg)
+{
+	struct zswap_pool *pool;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return NULL;
+
+	for (; memcg && !mem_cgroup_is_root(memcg);
+	     memcg = parent_mem_cgroup(memcg)) {
+		pool = rcu_dereference(memcg->zswap_pool);
+		if (pool)
+			return pool;
+	}
+	return NULL;
+}
+
 static u64 zswap_current_read(struct cgroup_subsys_state *css,
 			      struct cftype *cft)
 {
@@ -7820,6 +8172,39 @@ static ssize_t zswap_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static int zswap_compressor_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	struct zswap_pool *pool;
+
+	rcu_read_lock();
+	pool = rcu_dereference(memcg->zswap_pool);
+	seq_printf(m, "%s\n", pool ? zswap_pool_compressor(pool) : "default");
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static ssize_t zswap_compressor_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	struct zswap_pool *pool = NULL, *old;
+
+	buf = strstrip(buf);
+	if (strcmp(buf, "default")) {
+		pool = zswap_pool_get_compressor(buf);
+		if (IS_ERR(pool))
+			return PTR_ERR(pool);
+	}
+
+	/* entries already stored keep their own pool references */
+	old = unrcu_pointer(xchg(&memcg->zswap_pool, RCU_INITIALIZER(pool)));
+	zswap_pool_release(old);
+
+	return nbytes;
+}
+
 static struct cftype zswap_files[] = {
 	{
 		.name = "zswap.current",
@@ -7832,6 +8217,12 @@ static struct cftype zswap_files[] = {
 		.seq_show = zswap_max_show,
 		.write = zswap_max_write,
 	},
+	{
+		.name = "zswap.compressor",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = zswap_compressor_show,
+		.write = zswap_compressor_write,
+	},
 	{ }	/* terminate */
 };
 #endif /* CONFIG_MEMCG_KMEM && CONFIG_ZSWAP */
@@ -22,6 +22,11 @@ struct memory_tier {
 	struct device dev;
 	/* All the nodes that are part of all the lower memory tiers. */
 	nodemask_t lower_tier_mask;
+	/* MB/s that may be promoted out of this tier, 0 for no limit */
+	unsigned int promote_rate_limit;
+	/* start (msecs) and promotion candidates of current rate window */
+	unsigned int promote_rl_start;
+	atomic_long_t promote_rl_nr_cand;
 };
 
 struct demotion_nodes {
@@ -145,8 +150,33 @@ static ssize_t nodelist_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(nodelist);
 
+static ssize_t promote_rate_limit_MBps_show(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buf)
+{
+	return sysfs_emit(buf, "%u\n",
+			  READ_ONCE(to_memory_tier(dev)->promote_rate_limit));
+}
+
+static ssize_t promote_rate_limit_MBps_store(struct device *dev,
+					     struct device_attribute *attr,
+					     const char *buf, size_t count)
+{
+	unsigned int limit;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &limit);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(to_memory_tier(dev)->promote_rate_limit, limit);
+	return count;
+}
+static DEVICE_ATTR_RW(promote_rate_limit_MBps);
+
 static struct attribute *memtier_dev_attrs[] = {
 	&dev_attr_nodelist.attr,
+	&dev_attr_promote_rate_limit_MBps.attr,
 	NULL
 };
 
@@ -264,6 +294,49 @@ bool node_is_toptier(int node)
 	return toptier;
 }
 
+/**
+ * node_promotion_rate_limited() - Check the promotion rate limit of a tier
+ * @node: node the pages would be promoted from
+ * @nr: number of pages about to be promoted
+ *
+ * Counts @nr against the promote_rate_limit_MBps of the memory tier of
+ * @node, shared by all nodes of the tier and reset every second.
+ *
+ * Return: true if the pages exceed the limit and must not be promoted.
+ */
+bool node_promotion_rate_limited(int node, int nr)
+{
+	struct memory_tier *memtier;
+	unsigned long limit;
+	unsigned int now, start;
+	bool limited = false;
+	pg_data_t *pgdat;
+
+	pgdat = NODE_DATA(node);
+	if (!pgdat)
+		return false;
+
+	rcu_read_lock();
+	memtier = rcu_dereference(pgdat->memtier);
+	if (!memtier)
+		goto out;
+	limit = READ_ONCE(memtier->promote_rate_limit);
+	if (!limit)
+		goto out;
+	limit <<= 20 - PAGE_SHIFT;
+
+	now = jiffies_to_msecs(jiffies);
+	start = READ_ONCE(memtier->promote_rl_start);
+	if (now - start > MSEC_PER_SEC &&
+	    cmpxchg(&memtier->promote_rl_start, start, now) == start)
+		atomic_long_set(&memtier->promote_rl_nr_cand, 0);
+	limited = atomic_long_add_return(nr, &memtier->promote_rl_nr_cand) >
+		  limit;
+out:
+	rcu_read_unlock();
+	return limited;
+}
+
 void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets)
 {
 	struct memory_tier *memtier;
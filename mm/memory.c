@@ -70,6 +70,7 @@
 #include <linux/memory-tiers.h>
 #include <linux/debugfs.h>
 #include <linux/userfaultfd_k.h>
+#include <linux/khugepaged.h>
 #include <linux/dax.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
@@ -948,6 +949,95 @@ copy_present_pte(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	return 0;
 }
 
+/*
+ * Count the present ptes from @src_pte on, at most @max_nr, that map
+ * consecutive pages of @folio starting at @page.
+ */
+static inline int folio_pte_batch(struct folio *folio, struct page *page,
+				  pte_t *src_pte, int max_nr)
+{
+	unsigned long pfn = page_to_pfn(page);
+	int nr;
+
+	max_nr = min_t(long, max_nr, folio_nr_pages(folio) -
+				     folio_page_idx(folio, page));
+	for (nr = 1; nr < max_nr; nr++) {
+		pte_t pte = src_pte[nr];
+
+		if (!pte_present(pte) || pte_pfn(pte) != pfn + nr)
+			break;
+	}
+	return nr;
+}
+
+/*
+ * Copy a run of ptes mapping the same large folio at once, so that the
+ * page lookup and reference counting are done once per run instead of
+ * once per pte. Returns the number of ptes copied, or 0 if the pte at
+ * @addr has to go through copy_present_pte().
+ */
+static inline int
+copy_present_ptes(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
+		  pte_t *dst_pte, pte_t *src_pte, unsigned long addr,
+		  int max_nr, int *rss)
+{
+	struct mm_struct *src_mm = src_vma->vm_mm;
+	unsigned long vm_flags = src_vma->vm_flags;
+	struct folio *folio;
+	struct page *page;
+	int i, nr;
+
+	if (max_nr < 2)
+		return 0;
+	page = vm_normal_page(src_vma, addr, *src_pte);
+	if (!page)
+		return 0;
+	folio = page_folio(page);
+	if (!folio_test_large(folio))
+		return 0;
+	/*
+	 * page_try_dup_anon_rmap() can only fail for possibly pinned
+	 * pages, leave those to copy_present_pte() which copies them.
+	 */
+	if (folio_test_anon(folio) && is_cow_mapping(vm_flags) &&
+	    test_bit(MMF_HAS_PINNED, &src_mm->flags) &&
+	    folio_maybe_dma_pinned(folio))
+		return 0;
+
+	nr = folio_pte_batch(folio, page, src_pte, max_nr);
+	if (nr < 2)
+		return 0;
+
+	folio_ref_add(folio, nr);
+	rss[mm_counter(page)] += nr;
+
+	for (i = 0; i < nr; i++, addr += PAGE_SIZE) {
+		pte_t pte = src_pte[i];
+
+		if (folio_test_anon(folio))
+			WARN_ON_ONCE(page_try_dup_anon_rmap(page + i, false,
+							    src_vma));
+		else
+			page_dup_file_rmap(page + i, false);
+
+		if (is_cow_mapping(vm_flags) && pte_write(pte)) {
+			ptep_set_wrprotect(src_mm, addr, src_pte + i);
+			pte = pte_wrprotect(pte);
+		}
+		VM_BUG_ON(folio_test_anon(folio) && PageAnonExclusive(page + i));
+
+		if (vm_flags & VM_SHARED)
+			pte = pte_mkclean(pte);
+		pte = pte_mkold(pte);
+
+		if (!userfaultfd_wp(dst_vma))
+			pte = pte_clear_uffd_wp(pte);
+
+		set_pte_at(dst_vma->vm_mm, addr, dst_pte + i, pte);
+	}
+	return nr;
+}
+
 static inline struct page *
 page_copy_prealloc(struct mm_struct *src_mm, struct vm_area_struct *vma,
 		   unsigned long addr)
@@ -967,6 +1057,15 @@ page_copy_prealloc(struct mm_struct *src_mm, struct vm_area_struct *vma,
 	return new_page;
 }
 
+/*
+ * The child gets a copy of every pte table, with the parent's private ptes
+ * write protected on the way. Sharing the tables copy-on-write instead
+ * would make fork() independent of the mapped size, but then every pte
+ * walker would have to unshare a table before changing it, and rmap and
+ * mapcounts would have to cope with a single pte mapping a page into
+ * several processes. Runs of ptes mapping one large folio are at least
+ * copied in one go, see copy_present_ptes().
+ */
 static int
 copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	       pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
@@ -977,7 +1076,7 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	pte_t *orig_src_pte, *orig_dst_pte;
 	pte_t *src_pte, *dst_pte;
 	spinlock_t *src_ptl, *dst_ptl;
-	int progress, ret = 0;
+	int progress, ret = 0, nr;
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
 	struct page *prealloc = NULL;
@@ -999,6 +1098,7 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	arch_enter_lazy_mmu_mode();
 
 	do {
+		nr = 1;
 		/*
 		 * We are holding two locks at this point - either of them
 		 * could generate latencies in another task on another CPU.
@@ -1034,6 +1134,13 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 			 */
 			WARN_ON_ONCE(ret != -ENOENT);
 		}
+		nr = copy_present_ptes(dst_vma, src_vma, dst_pte, src_pte,
+				       addr, (end - addr) >> PAGE_SHIFT, rss);
+		if (nr) {
+			progress += 8 * nr;
+			continue;
+		}
+		nr = 1;
 		/* copy_present_pte() will clear `*prealloc' if consumed */
 		ret = copy_present_pte(dst_vma, src_vma, dst_pte, src_pte,
 				       addr, rss, &prealloc);
@@ -1054,7 +1161,8 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 			prealloc = NULL;
 		}
 		progress += 8;
-	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != end);
+	} while (dst_pte += nr, src_pte += nr, addr += PAGE_SIZE * nr,
+		 addr != end);
 
 	arch_leave_lazy_mmu_mode();
 	spin_unlock(src_ptl);
@@ -1355,12 +1463,15 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	pte_t *start_pte;
 	pte_t *pte;
 	swp_entry_t entry;
+	pte_t *table;
+	bool reclaim_pt = false;
 
 	tlb_change_page_size(tlb, PAGE_SIZE);
 again:
 	init_rss_vec(rss);
 	start_pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
 	pte = start_pte;
+	table = start_pte - pte_index(addr);
 	flush_tlb_batched_pending(mm);
 	arch_enter_lazy_mmu_mode();
 	do {
@@ -1467,6 +1578,10 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 		tlb_flush_mmu_tlbonly(tlb);
 		tlb_flush_rmaps(tlb, vma);
 	}
+	/* pt_reclaim_work_fn() checks again, this is only a hint */
+	if (addr == end && details &&
+	    (details->zap_flags & ZAP_FLAG_RECLAIM_PT))
+		reclaim_pt = pte_table_none(table);
 	pte_unmap_unlock(start_pte, ptl);
 
 	/*
@@ -1485,6 +1600,9 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 		goto again;
 	}
 
+	if (reclaim_pt)
+		pt_reclaim_queue(mm, (end - 1) & PMD_MASK,
+				 ((end - 1) & PMD_MASK) + PMD_SIZE);
 	return addr;
 }
 
@@ -3703,6 +3821,12 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	if (!pte_unmap_same(vmf))
 		goto out;
 
+	/* swapin may sleep on I/O and drop the lock, retry under mmap_lock */
+	if (vmf->flags & FAULT_FLAG_VMA_LOCK) {
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
+
 	entry = pte_to_swp_entry(vmf->orig_pte);
 	if (unlikely(non_swap_entry(entry))) {
 		if (is_migration_entry(entry)) {
@@ -4013,6 +4137,91 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	return ret;
 }
 
+static bool pte_range_none(pte_t *pte, int nr_pages)
+{
+	int i;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (!pte_none(ptep_get_lockless(pte + i)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Allocate and charge the folio backing an anonymous fault: the highest
+ * enabled order whose aligned range fits in the vma and has no pte
+ * populated yet, falling back to lower orders and finally to a single
+ * page. Returns NULL when even that could not be allocated or charged.
+ */
+static struct folio *alloc_anon_folio(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	struct page *page;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	unsigned long orders, addr;
+	struct folio *folio;
+	pte_t *pte;
+	gfp_t gfp;
+	int order;
+
+	/* userfaultfd wants to resolve missing pages one at a time */
+	if (unlikely(userfaultfd_armed(vma)))
+		goto fallback;
+
+	orders = thp_vma_anon_orders(vma);
+	if (!orders)
+		goto fallback;
+
+	pte = pte_offset_map(vmf->pmd, vmf->address & PMD_MASK);
+	order = highest_order(orders);
+	while (orders) {
+		addr = ALIGN_DOWN(vmf->address, PAGE_SIZE << order);
+		if (addr >= vma->vm_start &&
+		    addr + (PAGE_SIZE << order) <= vma->vm_end &&
+		    pte_range_none(pte + pte_index(addr), 1 << order))
+			break;
+		order = next_order(&orders, order);
+	}
+	pte_unmap(pte);
+
+	gfp = vma_thp_gfp_mask(vma);
+	while (orders) {
+		addr = ALIGN_DOWN(vmf->address, PAGE_SIZE << order);
+		folio = vma_alloc_folio(gfp, order, vma, addr, false);
+		if (folio) {
+			if (mem_cgroup_charge(folio, vma->vm_mm, gfp)) {
+				count_mthp_stat(order,
+						MTHP_STAT_ANON_FAULT_FALLBACK_CHARGE);
+				folio_put(folio);
+				goto next;
+			}
+			cgroup_throttle_swaprate(&folio->page, gfp);
+			clear_huge_page(&folio->page, vmf->address, 1 << order);
+			count_mthp_stat(order, MTHP_STAT_ANON_FAULT_ALLOC);
+			return folio;
+		}
+next:
+		count_mthp_stat(order, MTHP_STAT_ANON_FAULT_FALLBACK);
+		order = next_order(&orders, order);
+	}
+
+fallback:
+#endif
+	page = alloc_zeroed_user_highpage_movable(vma, vmf->address);
+	if (!page)
+		return NULL;
+
+	if (mem_cgroup_charge(page_folio(page), vma->vm_mm, GFP_KERNEL)) {
+		put_page(page);
+		return NULL;
+	}
+	cgroup_throttle_swaprate(page, GFP_KERNEL);
+
+	return page_folio(page);
+}
+
 /*
  * We enter with non-exclusive mmap_lock (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -4021,9 +4230,12 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
-	struct page *page;
+	unsigned long addr = vmf->address;
+	struct folio *folio;
 	vm_fault_t ret = 0;
+	int nr_pages = 1;
 	pte_t entry;
+	int i;
 
 	/* File mapping without ->vm_ops ? */
 	if (vma->vm_flags & VM_SHARED)
@@ -4071,30 +4283,32 @@ static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 	/* Allocate our own private page. */
 	if (unlikely(anon_vma_prepare(vma)))
 		goto oom;
-	page = alloc_zeroed_user_highpage_movable(vma, vmf->address);
-	if (!page)
+	folio = alloc_anon_folio(vmf);
+	if (!folio)
 		goto oom;
 
-	if (mem_cgroup_charge(page_folio(page), vma->vm_mm, GFP_KERNEL))
-		goto oom_free_page;
-	cgroup_throttle_swaprate(page, GFP_KERNEL);
+	nr_pages = folio_nr_pages(folio);
+	addr = ALIGN_DOWN(vmf->address, nr_pages * PAGE_SIZE);
 
 	/*
-	 * The memory barrier inside __SetPageUptodate makes sure that
+	 * The memory barrier inside __folio_mark_uptodate makes sure that
 	 * preceding stores to the page contents become visible before
 	 * the set_pte_at() write.
 	 */
-	__SetPageUptodate(page);
+	__folio_mark_uptodate(folio);
 
-	entry = mk_pte(page, vma->vm_page_prot);
+	entry = mk_pte(&folio->page, vma->vm_page_prot);
 	entry = pte_sw_mkyoung(entry);
 	if (vma->vm_flags & VM_WRITE)
 		entry = pte_mkwrite(pte_mkdirty(entry));
 
-	vmf->pte = pte_offset_map_lock(vma->vm_mm, vmf->pmd, vmf->address,
-			&vmf->ptl);
-	if (!pte_none(*vmf->pte)) {
-		update_mmu_tlb(vma, vmf->address, vmf->pte);
+	vmf->pte = pte_offset_map_lock(vma->vm_mm, vmf->pmd, addr, &vmf->ptl);
+	if (nr_pages == 1 && !pte_none(*vmf->pte)) {
+		update_mmu_tlb(vma, addr, vmf->pte);
+		goto release;
+	} else if (nr_pages > 1 && !pte_range_none(vmf->pte, nr_pages)) {
+		for (i = 0; i < nr_pages; i++)
+			update_mmu_tlb(vma, addr + PAGE_SIZE * i, vmf->pte + i);
 		goto release;
 	}
 
@@ -4105,26 +4319,39 @@ static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 	/* Deliver the page fault to userland, check inside PT lock */
 	if (userfaultfd_missing(vma)) {
 		pte_unmap_unlock(vmf->pte, vmf->ptl);
-		put_page(page);
+		folio_put(folio);
 		return handle_userfault(vmf, VM_UFFD_MISSING);
 	}
 
-	inc_mm_counter(vma->vm_mm, MM_ANONPAGES);
-	page_add_new_anon_rmap(page, vma, vmf->address);
-	lru_cache_add_inactive_or_unevictable(page, vma);
+	add_mm_counter(vma->vm_mm, MM_ANONPAGES, nr_pages);
+	if (nr_pages == 1) {
+		page_add_new_anon_rmap(&folio->page, vma, addr);
+	} else {
+		/* every pte takes its own reference, like a split THP */
+		folio_ref_add(folio, nr_pages - 1);
+		folio_add_new_anon_rmap_ptes(folio, vma, addr);
+	}
+	folio_add_lru_vma(folio, vma);
 setpte:
-	set_pte_at(vma->vm_mm, vmf->address, vmf->pte, entry);
+	for (i = 0; i < nr_pages; i++) {
+		if (i) {
+			entry = mk_pte(folio_page(folio, i), vma->vm_page_prot);
+			entry = pte_sw_mkyoung(entry);
+			if (vma->vm_flags & VM_WRITE)
+				entry = pte_mkwrite(pte_mkdirty(entry));
+		}
+		set_pte_at(vma->vm_mm, addr + PAGE_SIZE * i, vmf->pte + i,
+			   entry);
 
-	/* No need to invalidate - it was non-present before */
-	update_mmu_cache(vma, vmf->address, vmf->pte);
+		/* No need to invalidate - it was non-present before */
+		update_mmu_cache(vma, addr + PAGE_SIZE * i, vmf->pte + i);
+	}
 unlock:
 	pte_unmap_unlock(vmf->pte, vmf->ptl);
 	return ret;
 release:
-	put_page(page);
+	folio_put(folio);
 	goto unlock;
-oom_free_page:
-	put_page(page);
 oom:
 	return VM_FAULT_OOM;
 }
@@ -4765,8 +4992,10 @@ static vm_fault_t do_numa_page(struct vm_fault *vmf)
 	}
 
 out:
-	if (page_nid != NUMA_NO_NODE)
+	if (page_nid != NUMA_NO_NODE) {
 		task_numa_fault(last_cpupid, page_nid, 1, flags);
+		khugepaged_hot(vma, vmf->address);
+	}
 	return 0;
 out_map:
 	/*
@@ -5238,6 +5467,75 @@ vm_fault_t handle_mm_fault(struct vm_area_struct *vma, unsigned long address,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * Lookup and lock a VMA under RCU protection. Returned VMA is guaranteed to be
+ * stable and not isolated. If the VMA is not found or is being modified the
+ * function returns NULL.
+ */
+struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
+					  unsigned long address)
+{
+	MA_STATE(mas, &mm->mm_mt, address, address);
+	struct vm_area_struct *vma;
+
+	rcu_read_lock();
+	vma = mas_walk(&mas);
+	if (!vma)
+		goto inval;
+
+	/* Only anonymous vmas are supported for now */
+	if (!vma_is_anonymous(vma))
+		goto inval;
+
+	if (!vma_start_read(vma))
+		goto inval;
+
+	/*
+	 * find_mergeable_anon_vma uses adjacent vmas which are not locked.
+	 * Check only once the vma is locked: until then a concurrent mremap
+	 * with MREMAP_DONTUNMAP may still clear vma->anon_vma.
+	 */
+	if (!vma->anon_vma) {
+		vma_end_read(vma);
+		goto inval;
+	}
+
+	/*
+	 * Due to the possibility of userfault handler dropping mmap_lock, avoid
+	 * it for now and fall back to page fault handling under mmap_lock.
+	 */
+	if (userfaultfd_armed(vma)) {
+		vma_end_read(vma);
+		goto inval;
+	}
+
+	/* Check since vm_start/vm_end might change before we lock the VMA */
+	if (unlikely(address < vma->vm_start || address >= vma->vm_end)) {
+		vma_end_read(vma);
+		goto inval;
+	}
+
+	/*
+	 * Check if the VMA got isolated after we found it. The area was
+	 * unmapped or replaced with another one, leave it to mmap_lock.
+	 */
+	if (vma->detached) {
+		vma_end_read(vma);
+		rcu_read_unlock();
+		count_vm_vma_lock_event(VMA_LOCK_MISS);
+		return NULL;
+	}
+
+	rcu_read_unlock();
+	return vma;
+inval:
+	rcu_read_unlock();
+	count_vm_vma_lock_event(VMA_LOCK_ABORT);
+	return NULL;
+}
+#endif /* CONFIG_PER_VMA_LOCK */
+
 #ifndef __PAGETABLE_P4D_FOLDED
 /*
  * Allocate p4d page table.
@@ -1009,8 +1009,40 @@ static int move_to_new_folio(struct folio *dst, struct folio *src,
 	return rc;
 }
 
-static int __unmap_and_move(struct folio *src, struct folio *dst,
-				int force, enum migrate_mode mode)
+/*
+ * Between the unmap and the move phase of a migration, dst->private holds
+ * the anon_vma reference taken for src and whether src was mapped.
+ */
+#define PAGE_WAS_MAPPED		BIT(0)
+
+static void __migrate_folio_record(struct folio *dst,
+				   unsigned long page_was_mapped,
+				   struct anon_vma *anon_vma)
+{
+	dst->private = (void *)anon_vma + page_was_mapped;
+}
+
+static void __migrate_folio_extract(struct folio *dst,
+				    int *page_was_mappedp,
+				    struct anon_vma **anon_vmap)
+{
+	unsigned long private = (unsigned long)dst->private;
+
+	*anon_vmap = (struct anon_vma *)(private & ~PAGE_WAS_MAPPED);
+	*page_was_mappedp = private & PAGE_WAS_MAPPED;
+	dst->private = NULL;
+}
+
+/*
+ * Lock src and dst and replace the mappings of src with migration entries.
+ * With @batch the TLB flush is deferred, the caller has to do
+ * try_to_unmap_flush() before the contents are moved.
+ *
+ * Returns MIGRATEPAGE_UNMAP with both folios still locked when src is ready
+ * for __migrate_folio_move(), the result of the migration otherwise.
+ */
+static int __migrate_folio_unmap(struct folio *src, struct folio *dst,
+				 int force, enum migrate_mode mode, bool batch)
 {
 	int rc = -EAGAIN;
 	bool page_was_mapped = false;
@@ -1114,10 +1146,46 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 		/* Establish migration ptes */
 		VM_BUG_ON_FOLIO(folio_test_anon(src) &&
 			       !folio_test_ksm(src) && !anon_vma, src);
-		try_to_migrate(src, 0);
+		try_to_migrate(src, batch ? TTU_BATCH_FLUSH : 0);
 		page_was_mapped = true;
 	}
 
+	__migrate_folio_record(dst, page_was_mapped, anon_vma);
+	return MIGRATEPAGE_UNMAP;
+
+out_unlock_both:
+	folio_unlock(dst);
+out_unlock:
+	/* Drop an anon_vma reference if we took one */
+	if (anon_vma)
+		put_anon_vma(anon_vma);
+	folio_unlock(src);
+out:
+	/*
+	 * If migration is successful, decrease refcount of dst,
+	 * which will not free the page because new page owner increased
+	 * refcounter.
+	 */
+	if (rc == MIGRATEPAGE_SUCCESS)
+		folio_put(dst);
+
+	return rc;
+}
+
+/*
+ * Move the contents of src, unmapped by __migrate_folio_unmap(), to dst and
+ * restore the mappings. Any TLB flush deferred while unmapping src must have
+ * been done by now.
+ */
+static int __migrate_folio_move(struct folio *src, struct folio *dst,
+				enum migrate_mode mode)
+{
+	int rc = -EAGAIN;
+	int page_was_mapped;
+	struct anon_vma *anon_vma;
+
+	__migrate_folio_extract(dst, &page_was_mapped, &anon_vma);
+
 	if (!folio_mapped(src))
 		rc = move_to_new_folio(dst, src, mode);
 
@@ -1140,19 +1208,12 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 		remove_migration_ptes(src,
 			rc == MIGRATEPAGE_SUCCESS ? dst : src, false);
 
-out_unlock_both:
 	folio_unlock(dst);
-out_unlock:
 	/* Drop an anon_vma reference if we took one */
 	if (anon_vma)
 		put_anon_vma(anon_vma);
 	folio_unlock(src);
-out:
-	/*
-	 * If migration is successful, decrease refcount of dst,
-	 * which will not free the page because new page owner increased
-	 * refcounter.
-	 */
+
 	if (rc == MIGRATEPAGE_SUCCESS)
 		folio_put(dst);
 
@@ -1160,42 +1221,15 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 }
 
 /*
- * Obtain the lock on folio, remove all ptes and migrate the folio
- * to the newly allocated folio in dst.
+ * Finish with src once its migration is over: a folio that has been
+ * migrated drops the isolation reference, one that has not goes to @ret
+ * unless it is to be retried and dst is released.
  */
-static int unmap_and_move(new_page_t get_new_page,
-				   free_page_t put_new_page,
-				   unsigned long private, struct folio *src,
-				   int force, enum migrate_mode mode,
-				   enum migrate_reason reason,
-				   struct list_head *ret)
+static void migrate_folio_done(struct folio *src, struct folio *dst, int rc,
+			       enum migrate_reason reason,
+			       free_page_t put_new_page, unsigned long private,
+			       struct list_head *ret)
 {
-	struct folio *dst;
-	int rc = MIGRATEPAGE_SUCCESS;
-	struct page *newpage = NULL;
-
-	if (!thp_migration_supported() && folio_test_transhuge(src))
-		return -ENOSYS;
-
-	if (folio_ref_count(src) == 1) {
-		/* Folio was freed from under us. So we are done. */
-		folio_clear_active(src);
-		folio_clear_unevictable(src);
-		/* free_pages_prepare() will clear PG_isolated. */
-		goto out;
-	}
-
-	newpage = get_new_page(&src->page, private);
-	if (!newpage)
-		return -ENOMEM;
-	dst = page_folio(newpage);
-
-	dst->private = NULL;
-	rc = __unmap_and_move(src, dst, force, mode);
-	if (rc == MIGRATEPAGE_SUCCESS)
-		set_page_owner_migrate_reason(&dst->page, reason);
-
-out:
 	if (rc != -EAGAIN) {
 		/*
 		 * A folio that has been migrated has all references
@@ -1234,6 +1268,60 @@ static int unmap_and_move(new_page_t get_new_page,
 		else
 			folio_put(dst);
 	}
+}
+
+/*
+ * Obtain the lock on folio, remove all ptes and migrate the folio
+ * to the newly allocated folio in dst.
+ *
+ * With @unmap_folios, the folio is only unmapped with the TLB flush
+ * deferred: it is queued on @unmap_folios and dst on @dst_folios and
+ * MIGRATEPAGE_UNMAP is returned, migrate_folios_move() does the rest.
+ */
+static int unmap_and_move(new_page_t get_new_page,
+				   free_page_t put_new_page,
+				   unsigned long private, struct folio *src,
+				   int force, enum migrate_mode mode,
+				   enum migrate_reason reason,
+				   struct list_head *ret,
+				   struct list_head *unmap_folios,
+				   struct list_head *dst_folios)
+{
+	struct folio *dst = NULL;
+	int rc = MIGRATEPAGE_SUCCESS;
+	struct page *newpage = NULL;
+
+	if (!thp_migration_supported() && folio_test_transhuge(src))
+		return -ENOSYS;
+
+	if (folio_ref_count(src) == 1) {
+		/* Folio was freed from under us. So we are done. */
+		folio_clear_active(src);
+		folio_clear_unevictable(src);
+		/* free_pages_prepare() will clear PG_isolated. */
+		goto out;
+	}
+
+	newpage = get_new_page(&src->page, private);
+	if (!newpage)
+		return -ENOMEM;
+	dst = page_folio(newpage);
+
+	dst->private = NULL;
+	rc = __migrate_folio_unmap(src, dst, force, mode, unmap_folios != NULL);
+	if (rc == MIGRATEPAGE_UNMAP) {
+		if (unmap_folios) {
+			list_move_tail(&src->lru, unmap_folios);
+			list_add_tail(&dst->lru, dst_folios);
+			return rc;
+		}
+		rc = __migrate_folio_move(src, dst, mode);
+	}
+	if (rc == MIGRATEPAGE_SUCCESS)
+		set_page_owner_migrate_reason(&dst->page, reason);
+
+out:
+	migrate_folio_done(src, dst, rc, reason, put_new_page, private, ret);
 
 	return rc;
 }
@@ -1396,6 +1484,92 @@ static inline int try_split_folio(struct folio *folio, struct list_head *split_f
 	return rc;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define NR_MAX_BATCHED_MIGRATION	HPAGE_PMD_NR
+#else
+#define NR_MAX_BATCHED_MIGRATION	512
+#endif
+
+struct migrate_pages_stats {
+	int nr_succeeded;	/* Normal and large folios migrated successfully, in
+				   units of base pages */
+	int nr_failed_pages;	/* Normal and large folios failed to be migrated, in
+				   units of base pages. Untried folios aren't counted */
+	int nr_thp_succeeded;	/* THP migrated successfully */
+	int nr_thp_failed;	/* THP failed to be migrated */
+	int nr_thp_split;	/* THP split before migrating */
+	int nr_failed;		/* Normal and hugetlb folios failed to be migrated */
+	int nr_large_failed;	/* Large folios failed to be migrated */
+	/* Folios and pages to be retried in the next pass */
+	int retry;
+	int large_retry;
+	int thp_retry;
+	int nr_retry_pages;
+};
+
+/*
+ * Finish the migration of the folios unmapped by unmap_and_move() on
+ * @unmap_folios with a single TLB flush for all of them. Their new folios
+ * are on @dst_folios, in the same order. Folios to be retried go to @retry.
+ */
+static void migrate_folios_move(struct list_head *unmap_folios,
+		struct list_head *dst_folios, free_page_t put_new_page,
+		unsigned long private, enum migrate_mode mode, int reason,
+		struct list_head *ret_folios, struct list_head *retry,
+		bool no_split_folio_counting, struct migrate_pages_stats *stats)
+{
+	struct folio *folio, *folio2, *dst;
+	bool is_large, is_thp;
+	int rc, nr_pages;
+
+	if (list_empty(unmap_folios))
+		return;
+
+	try_to_unmap_flush();
+
+	list_for_each_entry_safe(folio, folio2, unmap_folios, lru) {
+		is_large = folio_test_large(folio);
+		is_thp = is_large && folio_test_pmd_mappable(folio);
+		nr_pages = folio_nr_pages(folio);
+		cond_resched();
+
+		dst = list_first_entry(dst_folios, struct folio, lru);
+		list_del(&dst->lru);
+
+		rc = __migrate_folio_move(folio, dst, mode);
+		if (rc == MIGRATEPAGE_SUCCESS)
+			set_page_owner_migrate_reason(&dst->page, reason);
+		migrate_folio_done(folio, dst, rc, reason, put_new_page,
+				   private, ret_folios);
+
+		switch (rc) {
+		case MIGRATEPAGE_SUCCESS:
+			stats->nr_succeeded += nr_pages;
+			stats->nr_thp_succeeded += is_thp;
+			break;
+		case -EAGAIN:
+			if (is_large) {
+				stats->large_retry++;
+				stats->thp_retry += is_thp;
+			} else if (!no_split_folio_counting) {
+				stats->retry++;
+			}
+			stats->nr_retry_pages += nr_pages;
+			list_move_tail(&folio->lru, retry);
+			break;
+		default:
+			if (is_large) {
+				stats->nr_large_failed++;
+				stats->nr_thp_failed += is_thp;
+			} else if (!no_split_folio_counting) {
+				stats->nr_failed++;
+			}
+			stats->nr_failed_pages += nr_pages;
+			break;
+		}
+	}
+}
+
 /*
  * migrate_pages - migrate the folios specified in a list, to the free folios
  *		   supplied as the target for the page migration
@@ -1426,17 +1600,6 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 		free_page_t put_new_page, unsigned long private,
 		enum migrate_mode mode, int reason, unsigned int *ret_succeeded)
 {
-	int retry = 1;
-	int large_retry = 1;
-	int thp_retry = 1;
-	int nr_failed = 0;
-	int nr_failed_pages = 0;
-	int nr_retry_pages = 0;
-	int nr_succeeded = 0;
-	int nr_thp_succeeded = 0;
-	int nr_large_failed = 0;
-	int nr_thp_failed = 0;
-	int nr_thp_split = 0;
 	int pass = 0;
 	bool is_large = false;
 	bool is_thp = false;
@@ -1444,17 +1607,32 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 	int rc, nr_pages;
 	LIST_HEAD(ret_folios);
 	LIST_HEAD(split_folios);
+	LIST_HEAD(unmap_folios);
+	LIST_HEAD(dst_folios);
+	LIST_HEAD(retry_folios);
+	int nr_unmap_pages = 0;
 	bool nosplit = (reason == MR_NUMA_MISPLACED);
 	bool no_split_folio_counting = false;
+	/*
+	 * Only asynchronous migration is batched: it never sleeps on a folio
+	 * lock or in ->migrate_folio(), which it must not do while holding
+	 * the locks of the other folios waiting in the batch.
+	 */
+	bool batch = (mode == MIGRATE_ASYNC);
+	struct migrate_pages_stats stats = {
+		.retry = 1,
+		.large_retry = 1,
+		.thp_retry = 1,
+	};
 
 	trace_mm_migrate_pages_start(mode, reason);
 
 split_folio_migration:
-	for (pass = 0; pass < 10 && (retry || large_retry); pass++) {
-		retry = 0;
-		large_retry = 0;
-		thp_retry = 0;
-		nr_retry_pages = 0;
+	for (pass = 0; pass < 10 && (stats.retry || stats.large_retry); pass++) {
+		stats.retry = 0;
+		stats.large_retry = 0;
+		stats.thp_retry = 0;
+		stats.nr_retry_pages = 0;
 
 		list_for_each_entry_safe(folio, folio2, from, lru) {
 			/*
@@ -1476,11 +1654,27 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 			else
 				rc = unmap_and_move(get_new_page, put_new_page,
 						private, folio, pass > 2, mode,
-						reason, &ret_folios);
+						reason, &ret_folios,
+						batch ? &unmap_folios : NULL,
+						&dst_folios);
+			if (rc == MIGRATEPAGE_UNMAP) {
+				nr_unmap_pages += nr_pages;
+				if (nr_unmap_pages >= NR_MAX_BATCHED_MIGRATION) {
+					migrate_folios_move(&unmap_folios,
+						&dst_folios, put_new_page,
+						private, mode, reason,
+						&ret_folios, &retry_folios,
+						no_split_folio_counting, &stats);
+					nr_unmap_pages = 0;
+				}
+				continue;
+			}
 			/*
 			 * The rules are:
 			 *	Success: non hugetlb folio will be freed, hugetlb
 			 *		 folio will be put back
+			 *	MIGRATEPAGE_UNMAP: on the unmap_folios list until
+			 *		 the batch is moved
 			 *	-EAGAIN: stay on the from list
 			 *	-ENOMEM: stay on the from list
 			 *	-ENOSYS: stay on the from list
@@ -1501,18 +1695,18 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 			case -ENOSYS:
 				/* Large folio migration is unsupported */
 				if (is_large) {
-					nr_large_failed++;
-					nr_thp_failed += is_thp;
+					stats.nr_large_failed++;
+					stats.nr_thp_failed += is_thp;
 					if (!try_split_folio(folio, &split_folios)) {
-						nr_thp_split += is_thp;
+						stats.nr_thp_split += is_thp;
 						break;
 					}
 				/* Hugetlb migration is unsupported */
 				} else if (!no_split_folio_counting) {
-					nr_failed++;
+					stats.nr_failed++;
 				}
 
-				nr_failed_pages += nr_pages;
+				stats.nr_failed_pages += nr_pages;
 				list_move_tail(&folio->lru, &ret_folios);
 				break;
 			case -ENOMEM:
@@ -1520,15 +1714,20 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 				 * When memory is low, don't bother to try to migrate
 				 * other folios, just exit.
 				 */
+				migrate_folios_move(&unmap_folios, &dst_folios,
+						put_new_page, private, mode,
+						reason, &ret_folios, &retry_folios,
+						no_split_folio_counting, &stats);
+				nr_unmap_pages = 0;
 				if (is_large) {
-					nr_large_failed++;
-					nr_thp_failed += is_thp;
+					stats.nr_large_failed++;
+					stats.nr_thp_failed += is_thp;
 					/* Large folio NUMA faulting doesn't split to retry. */
 					if (!nosplit) {
 						int ret = try_split_folio(folio, &split_folios);
 
 						if (!ret) {
-							nr_thp_split += is_thp;
+							stats.nr_thp_split += is_thp;
 							break;
 						} else if (reason == MR_LONGTERM_PIN &&
 							   ret == -EAGAIN) {
@@ -1536,17 +1735,17 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 							 * Try again to split large folio to
 							 * mitigate the failure of longterm pinning.
 							 */
-							large_retry++;
-							thp_retry += is_thp;
-							nr_retry_pages += nr_pages;
+							stats.large_retry++;
+							stats.thp_retry += is_thp;
+							stats.nr_retry_pages += nr_pages;
 							break;
 						}
 					}
 				} else if (!no_split_folio_counting) {
-					nr_failed++;
+					stats.nr_failed++;
 				}
 
-				nr_failed_pages += nr_pages + nr_retry_pages;
+				stats.nr_failed_pages += nr_pages + stats.nr_retry_pages;
 				/*
 				 * There might be some split folios of fail-to-migrate large
 				 * folios left in split_folios list. Move them back to migration
@@ -1554,22 +1753,23 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 				 * the caller otherwise the folio refcnt will be leaked.
 				 */
 				list_splice_init(&split_folios, from);
+				list_splice_tail_init(&retry_folios, from);
 				/* nr_failed isn't updated for not used */
-				nr_large_failed += large_retry;
-				nr_thp_failed += thp_retry;
+				stats.nr_large_failed += stats.large_retry;
+				stats.nr_thp_failed += stats.thp_retry;
 				goto out;
 			case -EAGAIN:
 				if (is_large) {
-					large_retry++;
-					thp_retry += is_thp;
+					stats.large_retry++;
+					stats.thp_retry += is_thp;
 				} else if (!no_split_folio_counting) {
-					retry++;
+					stats.retry++;
 				}
-				nr_retry_pages += nr_pages;
+				stats.nr_retry_pages += nr_pages;
 				break;
 			case MIGRATEPAGE_SUCCESS:
-				nr_succeeded += nr_pages;
-				nr_thp_succeeded += is_thp;
+				stats.nr_succeeded += nr_pages;
+				stats.nr_thp_succeeded += is_thp;
 				break;
 			default:
 				/*
@@ -1579,21 +1779,27 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 				 * retried in the next outer loop.
 				 */
 				if (is_large) {
-					nr_large_failed++;
-					nr_thp_failed += is_thp;
+					stats.nr_large_failed++;
+					stats.nr_thp_failed += is_thp;
 				} else if (!no_split_folio_counting) {
-					nr_failed++;
+					stats.nr_failed++;
 				}
 
-				nr_failed_pages += nr_pages;
+				stats.nr_failed_pages += nr_pages;
 				break;
 			}
 		}
+
+		migrate_folios_move(&unmap_folios, &dst_folios, put_new_page,
+				private, mode, reason, &ret_folios, from,
+				no_split_folio_counting, &stats);
+		nr_unmap_pages = 0;
+		list_splice_tail_init(&retry_folios, from);
 	}
-	nr_failed += retry;
-	nr_large_failed += large_retry;
-	nr_thp_failed += thp_retry;
-	nr_failed_pages += nr_retry_pages;
+	stats.nr_failed += stats.retry;
+	stats.nr_large_failed += stats.large_retry;
+	stats.nr_thp_failed += stats.thp_retry;
+	stats.nr_failed_pages += stats.nr_retry_pages;
 	/*
 	 * Try to migrate split folios of fail-to-migrate large folios, no
 	 * nr_failed counting in this round, since all split folios of a
@@ -1607,11 +1813,11 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 		list_splice_init(from, &ret_folios);
 		list_splice_init(&split_folios, from);
 		no_split_folio_counting = true;
-		retry = 1;
+		stats.retry = 1;
 		goto split_folio_migration;
 	}
 
-	rc = nr_failed + nr_large_failed;
+	rc = stats.nr_failed + stats.nr_large_failed;
 out:
 	/*
 	 * Put the permanent failure folio back to migration list, they
@@ -1626,16 +1832,17 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 	if (list_empty(from))
 		rc = 0;
 
-	count_vm_events(PGMIGRATE_SUCCESS, nr_succeeded);
-	count_vm_events(PGMIGRATE_FAIL, nr_failed_pages);
-	count_vm_events(THP_MIGRATION_SUCCESS, nr_thp_succeeded);
-	count_vm_events(THP_MIGRATION_FAIL, nr_thp_failed);
-	count_vm_events(THP_MIGRATION_SPLIT, nr_thp_split);
-	trace_mm_migrate_pages(nr_succeeded, nr_failed_pages, nr_thp_succeeded,
-			       nr_thp_failed, nr_thp_split, mode, reason);
+	count_vm_events(PGMIGRATE_SUCCESS, stats.nr_succeeded);
+	count_vm_events(PGMIGRATE_FAIL, stats.nr_failed_pages);
+	count_vm_events(THP_MIGRATION_SUCCESS, stats.nr_thp_succeeded);
+	count_vm_events(THP_MIGRATION_FAIL, stats.nr_thp_failed);
+	count_vm_events(THP_MIGRATION_SPLIT, stats.nr_thp_split);
+	trace_mm_migrate_pages(stats.nr_succeeded, stats.nr_failed_pages,
+			       stats.nr_thp_succeeded, stats.nr_thp_failed,
+			       stats.nr_thp_split, mode, reason);
 
 	if (ret_succeeded)
-		*ret_succeeded = nr_succeeded;
+		*ret_succeeded = stats.nr_succeeded;
 
 	return rc;
 }
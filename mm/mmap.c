@@ -520,8 +520,10 @@ inline int vma_expand(struct ma_state *mas, struct vm_area_struct *vma,
 	struct file *file = vma->vm_file;
 	bool remove_next = false;
 
+	vma_start_write(vma);
 	if (next && (vma != next) && (end == next->vm_end)) {
 		remove_next = true;
+		vma_start_write(next);
 		if (next->anon_vma && !vma->anon_vma) {
 			int error;
 
@@ -595,6 +597,7 @@ inline int vma_expand(struct ma_state *mas, struct vm_area_struct *vma,
 			anon_vma_merge(vma, next);
 		mm->map_count--;
 		mpol_put(vma_policy(next));
+		vma_mark_detached(next, true);
 		vm_area_free(next);
 	}
 
@@ -630,6 +633,10 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 	MA_STATE(mas, &mm->mm_mt, 0, 0);
 	struct vm_area_struct *exporter = NULL, *importer = NULL;
 
+	vma_start_write(vma);
+	if (next)
+		vma_start_write(next);
+
 	if (next && !insert) {
 		if (end >= next->vm_end) {
 			/*
@@ -659,8 +666,10 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 				 * remove_next == 1 is case 1 or 7.
 				 */
 				remove_next = 1 + (end > next->vm_end);
-				if (remove_next == 2)
+				if (remove_next == 2) {
 					next_next = find_vma(mm, next->vm_end);
+					vma_start_write(next_next);
+				}
 
 				VM_WARN_ON(remove_next == 2 &&
 					   end != next_next->vm_end);
@@ -838,6 +847,7 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 		mpol_put(vma_policy(next));
 		if (remove_next != 2)
 			BUG_ON(vma->vm_end < next->vm_end);
+		vma_mark_detached(next, true);
 		vm_area_free(next);
 
 		/*
@@ -1943,6 +1953,9 @@ int expand_upwards(struct vm_area_struct *vma, unsigned long address)
 		return -ENOMEM;
 	}
 
+	/* Keep page faults under the vma lock out while the range changes */
+	vma_start_expand(vma);
+
 	/*
 	 * vma->vm_start/vm_end cannot change under us because the caller
 	 * is required to hold the mmap_lock in read mode.  We need the
@@ -1986,6 +1999,7 @@ int expand_upwards(struct vm_area_struct *vma, unsigned long address)
 		}
 	}
 	anon_vma_unlock_write(vma->anon_vma);
+	vma_end_expand(vma);
 	khugepaged_enter_vma(vma, vma->vm_flags);
 	mas_destroy(&mas);
 	return error;
@@ -2024,6 +2038,9 @@ int expand_downwards(struct vm_area_struct *vma, unsigned long address)
 		return -ENOMEM;
 	}
 
+	/* Keep page faults under the vma lock out while the range changes */
+	vma_start_expand(vma);
+
 	/*
 	 * vma->vm_start/vm_end cannot change under us because the caller
 	 * is required to hold the mmap_lock in read mode.  We need the
@@ -2068,6 +2085,7 @@ int expand_downwards(struct vm_area_struct *vma, unsigned long address)
 		}
 	}
 	anon_vma_unlock_write(vma->anon_vma);
+	vma_end_expand(vma);
 	khugepaged_enter_vma(vma, vma->vm_flags);
 	mas_destroy(&mas);
 	return error;
@@ -2272,6 +2290,7 @@ int split_vma(struct mm_struct *mm, struct vm_area_struct *vma,
 static inline int munmap_sidetree(struct vm_area_struct *vma,
 				   struct ma_state *mas_detach)
 {
+	vma_start_write(vma);
 	mas_set_range(mas_detach, vma->vm_start, vma->vm_end - 1);
 	if (mas_store_gfp(mas_detach, vma, GFP_KERNEL))
 		return -ENOMEM;
@@ -2282,6 +2301,17 @@ static inline int munmap_sidetree(struct vm_area_struct *vma,
 	return 0;
 }
 
+/* The vmas in @mas_detach left the mm tree, lock_vma_under_rcu() skips them */
+static inline void munmap_mark_detached(struct ma_state *mas_detach,
+					unsigned long start)
+{
+	struct vm_area_struct *vma;
+
+	mas_set(mas_detach, start);
+	mas_for_each(mas_detach, vma, ULONG_MAX)
+		vma_mark_detached(vma, true);
+}
+
 /*
  * do_mas_align_munmap() - munmap the aligned region from @start to @end.
  * @mas: The maple_state, ideally set up to alter the correct tree location.
@@ -2423,6 +2453,7 @@ do_mas_align_munmap(struct ma_state *mas, struct vm_area_struct *vma,
 #endif
 	mas_store_prealloc(mas, NULL);
 	mm->map_count -= count;
+	munmap_mark_detached(&mas_detach, start);
 	/*
 	 * Do not downgrade mmap_lock if we are next to VM_GROWSDOWN or
 	 * VM_GROWSUP VMA. Such VMAs can change their size under
@@ -2952,6 +2983,7 @@ static int do_brk_flags(struct ma_state *mas, struct vm_area_struct *vma,
 		if (mas_preallocate(mas, vma, GFP_KERNEL))
 			goto unacct_fail;
 
+		vma_start_write(vma);
 		vma_adjust_trans_huge(vma, vma->vm_start, addr + len, 0);
 		if (vma->anon_vma) {
 			anon_vma_lock_write(vma->anon_vma);
@@ -3225,6 +3257,8 @@ struct vm_area_struct *copy_vma(struct vm_area_struct **vmap,
 			get_file(new_vma->vm_file);
 		if (new_vma->vm_ops && new_vma->vm_ops->open)
 			new_vma->vm_ops->open(new_vma);
+		/* page tables get moved in before mmap_lock is dropped */
+		vma_start_write(new_vma);
 		if (vma_link(mm, new_vma))
 			goto out_vma_link;
 		*need_rmap_locks = false;
@@ -3541,6 +3575,13 @@ int mm_take_all_locks(struct mm_struct *mm)
 
 	mutex_lock(&mm_all_locks_mutex);
 
+	mas_for_each(&mas, vma, ULONG_MAX) {
+		if (signal_pending(current))
+			goto out_unlock;
+		vma_start_write(vma);
+	}
+
+	mas_set(&mas, 0);
 	mas_for_each(&mas, vma, ULONG_MAX) {
 		if (signal_pending(current))
 			goto out_unlock;
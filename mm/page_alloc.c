@@ -246,6 +246,11 @@ unsigned long totalreserve_pages __read_mostly;
 unsigned long totalcma_pages __read_mostly;
 
 int percpu_pagelist_high_fraction;
+/*
+ * Bitmask of the orders above 0 that are cached on the pcp lists, set to
+ * all that have a list once the real pagesets are allocated.
+ */
+int percpu_pagelist_high_orders __read_mostly;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 DEFINE_STATIC_KEY_MAYBE(CONFIG_INIT_ON_ALLOC_DEFAULT_ON, init_on_alloc);
 EXPORT_SYMBOL(init_on_alloc);
@@ -733,13 +738,26 @@ static inline int pindex_to_order(unsigned int pindex)
 	return order;
 }
 
+/* The orders above 0 that have a pcp list */
+static inline int pcp_high_orders_possible(void)
+{
+	int orders = GENMASK(PAGE_ALLOC_COSTLY_ORDER, 1);
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	orders |= BIT(pageblock_order);
+#endif
+	return orders;
+}
+
 static inline bool pcp_allowed_order(unsigned int order)
 {
-	if (order <= PAGE_ALLOC_COSTLY_ORDER)
+	if (!order)
 		return true;
+	if (order <= PAGE_ALLOC_COSTLY_ORDER)
+		return READ_ONCE(percpu_pagelist_high_orders) & BIT(order);
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	if (order == pageblock_order)
-		return true;
+		return READ_ONCE(percpu_pagelist_high_orders) & BIT(order);
 #endif
 	return false;
 }
@@ -3379,9 +3397,9 @@ static int nr_pcp_free(struct per_cpu_pages *pcp, int high, int batch,
 {
 	int min_nr_free, max_nr_free;
 
-	/* Free everything if batch freeing high-order pages. */
+	/* Free as much as possible if batch freeing high-order pages. */
 	if (unlikely(free_high))
-		return pcp->count;
+		return min(pcp->count, batch << CONFIG_PCP_BATCH_SCALE_MAX);
 
 	/* Check for PCP disabled or boot pageset */
 	if (unlikely(high < batch))
@@ -3396,7 +3414,7 @@ static int nr_pcp_free(struct per_cpu_pages *pcp, int high, int batch,
 	 * freeing of pages without any allocation.
 	 */
 	batch <<= pcp->free_factor;
-	if (batch < max_nr_free)
+	if (batch < max_nr_free && pcp->free_factor < CONFIG_PCP_BATCH_SCALE_MAX)
 		pcp->free_factor++;
 	batch = clamp(batch, min_nr_free, max_nr_free);
 
@@ -3439,8 +3457,25 @@ static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
 	 * to fragmentation, limit the number stored when PCP is heavily
 	 * freeing without allocation. The remainder after bulk freeing
 	 * stops will be drained from vmstat refresh context.
+	 *
+	 * Only do so on consecutive high-order frees and, if the batch can
+	 * hold a few high-order pages, once the lists have grown beyond it.
+	 * That keeps a cache for CPUs that recycle high-order pages at a
+	 * high rate, such as network receive buffers.
 	 */
-	free_high = (pcp->free_factor && order && order <= PAGE_ALLOC_COSTLY_ORDER);
+	free_high = false;
+	if (order && order <= PAGE_ALLOC_COSTLY_ORDER) {
+		free_high = (pcp->free_factor &&
+			     (pcp->flags & PCPF_PREV_FREE_HIGH_ORDER) &&
+			     (!(pcp->flags & PCPF_FREE_HIGH_BATCH) ||
+			      pcp->count >= READ_ONCE(pcp->batch)));
+		pcp->flags |= PCPF_PREV_FREE_HIGH_ORDER;
+	} else if (pcp->flags & PCPF_PREV_FREE_HIGH_ORDER) {
+		pcp->flags &= ~PCPF_PREV_FREE_HIGH_ORDER;
+	}
+
+	/* Freeing means the lists hold enough, refill less the next time */
+	pcp->alloc_factor >>= 1;
 
 	high = nr_pcp_high(pcp, zone, free_high);
 	if (pcp->count >= high) {
@@ -3726,6 +3761,41 @@ struct page *rmqueue_buddy(struct zone *preferred_zone, struct zone *zone,
 	return page;
 }
 
+/*
+ * Number of pages of @order to refill an empty pcp list with. Consecutive
+ * refills without frees in between double it, up to what still fits below
+ * pcp->high.
+ */
+static int nr_pcp_alloc(struct per_cpu_pages *pcp, int order)
+{
+	int high, batch, max_nr_alloc;
+
+	high = READ_ONCE(pcp->high);
+	batch = READ_ONCE(pcp->batch);
+
+	/* Check for PCP disabled or boot pageset */
+	if (unlikely(high < batch))
+		return 1;
+
+	max_nr_alloc = max(high - pcp->count - batch, batch);
+	batch <<= pcp->alloc_factor;
+	if (batch <= max_nr_alloc &&
+	    pcp->alloc_factor < CONFIG_PCP_BATCH_SCALE_MAX)
+		pcp->alloc_factor++;
+	batch = min(batch, max_nr_alloc);
+
+	/*
+	 * Scale batch relative to order if batch implies free pages can be
+	 * stored on the PCP. Batch can be 1 for small zones or for boot
+	 * pagesets which should never store free pages as the pages may
+	 * belong to arbitrary zones.
+	 */
+	if (batch > 1)
+		batch = max(batch >> order, 2);
+
+	return batch;
+}
+
 /* Remove page from the per-cpu list, caller must protect the list */
 static inline
 struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
@@ -3738,18 +3808,9 @@ struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
 
 	do {
 		if (list_empty(list)) {
-			int batch = READ_ONCE(pcp->batch);
+			int batch = nr_pcp_alloc(pcp, order);
 			int alloced;
 
-			/*
-			 * Scale batch relative to order if batch implies
-			 * free pages can be stored on the PCP. Batch can
-			 * be 1 for small zones or for boot pagesets which
-			 * should never store free pages as the pages may
-			 * belong to arbitrary zones.
-			 */
-			if (batch > 1)
-				batch = max(batch >> order, 2);
 			alloced = rmqueue_bulk(zone, order,
 					batch, list,
 					migratetype, alloc_flags);
@@ -7201,6 +7262,17 @@ static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long h
 	for_each_possible_cpu(cpu) {
 		pcp = per_cpu_ptr(zone->per_cpu_pageset, cpu);
 		pageset_update(pcp, high, batch);
+
+		/*
+		 * A batch that holds a couple of the costliest pcp pages can
+		 * keep high-order pages around, see free_unref_page_commit().
+		 */
+		spin_lock(&pcp->lock);
+		if (batch >= 2 << PAGE_ALLOC_COSTLY_ORDER)
+			pcp->flags |= PCPF_FREE_HIGH_BATCH;
+		else
+			pcp->flags &= ~PCPF_FREE_HIGH_BATCH;
+		spin_unlock(&pcp->lock);
 	}
 }
 
@@ -7270,6 +7342,8 @@ void __init setup_per_cpu_pageset(void)
 	for_each_populated_zone(zone)
 		setup_zone_pageset(zone);
 
+	percpu_pagelist_high_orders = pcp_high_orders_possible();
+
 #ifdef CONFIG_NUMA
 	/*
 	 * Unpopulated zones continue using the boot pagesets.
@@ -9007,6 +9081,37 @@ int percpu_pagelist_high_fraction_sysctl_handler(struct ctl_table *table,
 	return ret;
 }
 
+/*
+ * percpu_pagelist_high_orders - bitmask of the orders above 0 that are cached
+ * on the pcp lists. Orders without a pcp list are rejected, the pages of any
+ * order that got disabled are returned to the buddy allocator.
+ */
+int percpu_pagelist_high_orders_sysctl_handler(struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	int old_percpu_pagelist_high_orders;
+	int ret;
+
+	mutex_lock(&pcp_batch_high_lock);
+	old_percpu_pagelist_high_orders = percpu_pagelist_high_orders;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0)
+		goto out;
+
+	if (percpu_pagelist_high_orders & ~pcp_high_orders_possible()) {
+		percpu_pagelist_high_orders = old_percpu_pagelist_high_orders;
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (old_percpu_pagelist_high_orders & ~percpu_pagelist_high_orders)
+		drain_all_pages(NULL);
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+	return ret;
+}
+
 #ifndef __HAVE_ARCH_RESERVED_KERNEL_PAGES
 /*
  * Returns the number of pages that arch has reserved but
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Reclaim of the user PTE tables left empty by MADV_DONTNEED.
+ *
+ * zap_pte_range() can't free a table it just emptied: page faults, GUP
+ * and the rmap walkers may all be looking at it without holding more
+ * than mmap_lock for read, or no mmap_lock at all. Instead the range of
+ * the table is recorded on the mm, and a delayed work frees the empty
+ * tables of that range later under the locks khugepaged takes to retract
+ * page tables: mmap_lock and the vma lock for writing against faults and
+ * page walks, the rmap locks against rmap walks and an IPI or RCU sync
+ * against GUP-fast.
+ */
+#include <linux/mm.h>
+#include <linux/mm_inline.h>
+#include <linux/mmu_notifier.h>
+#include <linux/pagewalk.h>
+#include <linux/page_table_check.h>
+#include <linux/rmap.h>
+#include <linux/sched/coredump.h>
+#include <linux/sched/mm.h>
+
+#include <asm/pgalloc.h>
+#include <asm/tlb.h>
+
+#include "internal.h"
+
+/* Gives a series of madvise() calls the chance to finish first */
+#define PT_RECLAIM_DELAY	HZ
+
+static bool reclaim_pte_table(struct vm_area_struct *vma, unsigned long addr,
+			      pmd_t *pmdp)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct mmu_notifier_range range;
+	spinlock_t *pml, *ptl;
+	bool freed = false;
+	bool empty;
+	pte_t *pte;
+	pmd_t pmd;
+
+	/*
+	 * Nothing can fill the table under our locks, so check it before
+	 * bothering the mmu notifiers: refaulted tables are common.
+	 */
+	pmd = *pmdp;
+	if (!pmd_present(pmd) || pmd_trans_huge(pmd) || pmd_devmap(pmd))
+		return false;
+	pte = pte_offset_map_lock(mm, pmdp, addr, &ptl);
+	empty = pte_table_none(pte);
+	pte_unmap_unlock(pte, ptl);
+	if (!empty)
+		return false;
+
+	mmu_notifier_range_init(&range, MMU_NOTIFY_CLEAR, 0, NULL, mm, addr,
+				addr + PMD_SIZE);
+	mmu_notifier_invalidate_range_start(&range);
+
+	pml = pmd_lock(mm, pmdp);
+	pmd = *pmdp;
+	if (!pmd_present(pmd) || pmd_trans_huge(pmd) || pmd_devmap(pmd))
+		goto unlock;
+
+	ptl = pte_lockptr(mm, pmdp);
+	if (ptl != pml)
+		spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+	pte = pte_offset_map(pmdp, addr);
+	if (pte_table_none(pte)) {
+		pmd = pmdp_collapse_flush(vma, addr, pmdp);
+		freed = true;
+	}
+	pte_unmap(pte);
+	if (ptl != pml)
+		spin_unlock(ptl);
+unlock:
+	spin_unlock(pml);
+
+	if (freed)
+		tlb_remove_table_sync_one();
+	mmu_notifier_invalidate_range_end(&range);
+
+	if (freed) {
+		mm_dec_nr_ptes(mm);
+		page_table_check_pte_clear_range(mm, addr, pmd);
+		pte_free(mm, pmd_pgtable(pmd));
+	}
+	return freed;
+}
+
+static int pt_reclaim_pmd_entry(pmd_t *pmd, unsigned long addr,
+				unsigned long next, struct mm_walk *walk)
+{
+	unsigned long *nr_freed = walk->private;
+
+	/*
+	 * A table shared with another vma could be reached by rmap walks
+	 * of that vma, whose rmap locks aren't held.
+	 */
+	if ((addr & ~PMD_MASK) || next - addr != PMD_SIZE)
+		return 0;
+
+	if (reclaim_pte_table(walk->vma, addr, pmd))
+		(*nr_freed)++;
+	return 0;
+}
+
+static const struct mm_walk_ops pt_reclaim_walk_ops = {
+	.pmd_entry	= pt_reclaim_pmd_entry,
+};
+
+static unsigned long pt_reclaim_vma(struct vm_area_struct *vma,
+				    unsigned long start, unsigned long end)
+{
+	struct address_space *mapping = NULL;
+	unsigned long nr_freed = 0;
+
+	if (is_vm_hugetlb_page(vma) ||
+	    (vma->vm_flags & (VM_PFNMAP | VM_MIXEDMAP)))
+		return 0;
+	if (vma->vm_end - vma->vm_start < PMD_SIZE)
+		return 0;
+
+	vma_start_write(vma);
+	if (vma->vm_file)
+		mapping = vma->vm_file->f_mapping;
+	if (mapping)
+		i_mmap_lock_write(mapping);
+	if (vma->anon_vma)
+		anon_vma_lock_write(vma->anon_vma);
+
+	walk_page_range(vma->vm_mm, start, end, &pt_reclaim_walk_ops,
+			&nr_freed);
+
+	if (vma->anon_vma)
+		anon_vma_unlock_write(vma->anon_vma);
+	if (mapping)
+		i_mmap_unlock_write(mapping);
+	return nr_freed;
+}
+
+void pt_reclaim_work_fn(struct work_struct *work)
+{
+	struct mm_struct *mm = container_of(to_delayed_work(work),
+					    struct mm_struct, pt_reclaim_work);
+	unsigned long start, end, nr_freed = 0;
+	struct vm_area_struct *vma;
+
+	if (!mmget_not_zero(mm))
+		goto out;
+
+	/* Don't stall the faults of a busy mm, come back later instead */
+	if (!mmap_write_trylock(mm)) {
+		mmput(mm);
+		schedule_delayed_work(&mm->pt_reclaim_work, PT_RECLAIM_DELAY);
+		return;
+	}
+
+	/* zaps from now on record a new range and queue the mm again */
+	spin_lock(&mm->pt_reclaim_lock);
+	start = mm->pt_reclaim_start;
+	end = mm->pt_reclaim_end;
+	mm->pt_reclaim_start = ULONG_MAX;
+	mm->pt_reclaim_end = 0;
+	clear_bit(MMF_PT_RECLAIM, &mm->flags);
+	spin_unlock(&mm->pt_reclaim_lock);
+
+	if (start < end) {
+		VMA_ITERATOR(vmi, mm, start);
+
+		for_each_vma_range(vmi, vma, end) {
+			unsigned long vend = min(end, vma->vm_end);
+
+			nr_freed += pt_reclaim_vma(vma,
+					max(start, vma->vm_start), vend);
+			/* let the waiters in and finish the rest another time */
+			if (mmap_lock_is_contended(mm)) {
+				if (vend < end)
+					pt_reclaim_queue(mm, vend, end);
+				break;
+			}
+			cond_resched();
+		}
+	}
+	mmap_write_unlock(mm);
+
+	count_memcg_events_mm(mm, PT_RECLAIM, nr_freed);
+	count_vm_events(PT_RECLAIM, nr_freed);
+	mmput(mm);
+out:
+	mmdrop(mm);
+}
+
+/*
+ * Called by zap_pte_range() when it left an empty PTE table behind, with
+ * the PMD-aligned range the table maps. The work only looks at the range
+ * covering all the tables queued since it last ran, and holds a reference
+ * on the mm until it ran.
+ */
+void pt_reclaim_queue(struct mm_struct *mm, unsigned long start,
+		      unsigned long end)
+{
+	spin_lock(&mm->pt_reclaim_lock);
+	mm->pt_reclaim_start = min(mm->pt_reclaim_start, start);
+	mm->pt_reclaim_end = max(mm->pt_reclaim_end, end);
+	spin_unlock(&mm->pt_reclaim_lock);
+
+	if (test_bit(MMF_PT_RECLAIM, &mm->flags) ||
+	    test_and_set_bit(MMF_PT_RECLAIM, &mm->flags))
+		return;
+
+	mmgrab(mm);
+	schedule_delayed_work(&mm->pt_reclaim_work, PT_RECLAIM_DELAY);
+}
@@ -462,19 +462,6 @@ static int try_context_readahead(struct address_space *mapping,
 	return 1;
 }
 
-/*
- * There are some parts of the kernel which assume that PMD entries
- * are exactly HPAGE_PMD_ORDER.  Those should be fixed, but until then,
- * limit the maximum allocation order to PMD size.  I'm not aware of any
- * assumptions about maximum order if THP are disabled, but 8 seems like
- * a good order (that's 1MB if you're using 4kB pages)
- */
-#ifdef CONFIG_TRANSPARENT_HUGEPAGE
-#define MAX_PAGECACHE_ORDER	HPAGE_PMD_ORDER
-#else
-#define MAX_PAGECACHE_ORDER	8
-#endif
-
 static inline int ra_alloc_folio(struct readahead_control *ractl, pgoff_t index,
 		pgoff_t mark, unsigned int order, gfp_t gfp)
 {
@@ -560,6 +547,65 @@ void page_cache_ra_order(struct readahead_control *ractl,
 	do_page_cache_ra(ractl, ra->size, ra->async_size);
 }
 
+static void ra_stride_record(struct file_ra_state *ra, pgoff_t index)
+{
+	ra->stride_hist[ra->stride_next] = index;
+	ra->stride_next = (ra->stride_next + 1) % RA_STRIDE_HISTORY;
+}
+
+/*
+ * Strided reads, e.g. scanning a few columns of a columnar file through the
+ * same fd, leave no history pages in front of a miss for context readahead
+ * to find. Look for a miss that is the third in a row at the same distance
+ * in the recent misses instead, and if there is one, read the next chunks
+ * at that stride ahead of time.
+ *
+ * Only the two last chunks read ahead are recorded, so the stream keeps
+ * being recognised at its next miss, while other streams interleaved with
+ * it keep their own entries.
+ */
+static bool try_stride_readahead(struct readahead_control *ractl,
+				 struct file_ra_state *ra, pgoff_t index,
+				 unsigned long req_size, unsigned long max_pages)
+{
+	pgoff_t *hist = ra->stride_hist;
+	unsigned long stride = 0;
+	unsigned long nr, i;
+	int j;
+
+	for (i = 0; i < RA_STRIDE_HISTORY && !stride; i++) {
+		unsigned long d;
+
+		/* empty slots are 0, index 0 never gets here */
+		if (!hist[i] || hist[i] >= index)
+			continue;
+		d = index - hist[i];
+		if (d <= req_size || hist[i] <= d)
+			continue;
+		for (j = 0; j < RA_STRIDE_HISTORY; j++) {
+			if (hist[j] == hist[i] - d) {
+				stride = d;
+				break;
+			}
+		}
+	}
+
+	nr = max_pages / req_size;
+	if (!stride || nr < 2) {
+		ra_stride_record(ra, index);
+		return false;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ractl->_index = index + i * stride;
+		do_page_cache_ra(ractl, req_size, 0);
+	}
+	index += (nr - 1) * stride;
+	ra_stride_record(ra, index - stride);
+	ra_stride_record(ra, index);
+	return true;
+}
+
 /*
  * A minimal readahead algorithm for trivial sequential/random reads.
  */
@@ -648,6 +694,12 @@ static void ondemand_readahead(struct readahead_control *ractl,
 			max_pages))
 		goto readit;
 
+	/*
+	 * Reads at a fixed stride, the chunks in between are not needed.
+	 */
+	if (try_stride_readahead(ractl, ra, index, req_size, max_pages))
+		return;
+
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
@@ -687,6 +739,8 @@ void page_cache_sync_ra(struct readahead_control *ractl,
 {
 	bool do_forced_ra = ractl->file && (ractl->file->f_mode & FMODE_RANDOM);
 
+	ractl->ra->nr_misses++;
+
 	/*
 	 * Even if readahead is disabled, issue this request as readahead
 	 * as we'll need it to satisfy the requested range. The forced
@@ -713,6 +767,8 @@ EXPORT_SYMBOL_GPL(page_cache_sync_ra);
 void page_cache_async_ra(struct readahead_control *ractl,
 		struct folio *folio, unsigned long req_count)
 {
+	ractl->ra->nr_hits++;
+
 	/* no readahead */
 	if (!ractl->ra->ra_pages)
 		return;
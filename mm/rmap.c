@@ -1313,6 +1313,40 @@ void page_add_new_anon_rmap(struct page *page,
 	__page_set_anon_rmap(page, vma, address, 1);
 }
 
+/**
+ * folio_add_new_anon_rmap_ptes - add pte mappings to a new anonymous folio
+ * @folio:	the folio to add the mappings to
+ * @vma:	the vm area in which the folio is mapped
+ * @address:	the user virtual address of the first page of the folio
+ *
+ * Like page_add_new_anon_rmap(), but for a large folio that is mapped by
+ * one pte per page instead of by a pmd: every page is accounted as mapped
+ * once, none of it as a THP. The whole folio must fit in @vma.
+ */
+void folio_add_new_anon_rmap_ptes(struct folio *folio,
+	struct vm_area_struct *vma, unsigned long address)
+{
+	int i, nr = folio_nr_pages(folio);
+
+	VM_BUG_ON_VMA(address < vma->vm_start ||
+		      address + nr * PAGE_SIZE > vma->vm_end, vma);
+	VM_BUG_ON_FOLIO(!folio_test_large(folio), folio);
+	__folio_set_swapbacked(folio);
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = folio_page(folio, i);
+
+		/* increment count (starts at -1) */
+		atomic_set(&page->_mapcount, 0);
+		if (i)
+			SetPageAnonExclusive(page);
+	}
+	atomic_set(folio_subpages_mapcount_ptr(folio), nr);
+
+	__mod_lruvec_page_state(&folio->page, NR_ANON_MAPPED, nr);
+	__page_set_anon_rmap(&folio->page, vma, address, 1);
+}
+
 /**
  * page_add_file_rmap - add pte mapping to a file page
  * @page:	the page to add the mapping to
@@ -1976,7 +2010,21 @@ static bool try_to_migrate_one(struct folio *folio, struct vm_area_struct *vma,
 		} else {
 			flush_cache_page(vma, address, pte_pfn(*pvmw.pte));
 			/* Nuke the page table entry. */
-			pteval = ptep_clear_flush(vma, address, pvmw.pte);
+			if (should_defer_flush(mm, flags)) {
+				/*
+				 * We clear the PTE but do not flush so potentially
+				 * a remote CPU could still be writing to the folio.
+				 * If the entry was previously clean then the
+				 * architecture must guarantee that a clear->dirty
+				 * transition on a cached TLB entry is written through
+				 * and traps if the PTE is unmapped.
+				 */
+				pteval = ptep_get_and_clear(mm, address, pvmw.pte);
+
+				set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+			} else {
+				pteval = ptep_clear_flush(vma, address, pvmw.pte);
+			}
 		}
 
 		/* Set the dirty flag on the folio now the pte is gone. */
@@ -2147,11 +2195,11 @@ void try_to_migrate(struct folio *folio, enum ttu_flags flags)
 	};
 
 	/*
-	 * Migration always ignores mlock and only supports TTU_RMAP_LOCKED and
-	 * TTU_SPLIT_HUGE_PMD and TTU_SYNC flags.
+	 * Migration always ignores mlock and only supports TTU_RMAP_LOCKED,
+	 * TTU_SPLIT_HUGE_PMD, TTU_SYNC and TTU_BATCH_FLUSH flags.
 	 */
 	if (WARN_ON_ONCE(flags & ~(TTU_RMAP_LOCKED | TTU_SPLIT_HUGE_PMD |
-					TTU_SYNC)))
+					TTU_SYNC | TTU_BATCH_FLUSH)))
 		return;
 
 	if (folio_is_zone_device(folio) &&
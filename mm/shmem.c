@@ -468,6 +468,17 @@ static bool shmem_confirm_swap(struct address_space *mapping,
 
 static int shmem_huge __read_mostly = SHMEM_HUGE_NEVER;
 
+/*
+ * Orders below the PMD one, each enabled separately through the
+ * hugepages-<size>kB/shmem_enabled files. "inherit" follows the huge=
+ * policy of the mount, the others mean the same as for that policy.
+ */
+static DEFINE_SPINLOCK(huge_shmem_orders_lock);
+static unsigned long huge_shmem_orders_always __read_mostly;
+static unsigned long huge_shmem_orders_within_size __read_mostly;
+static unsigned long huge_shmem_orders_madvise __read_mostly;
+static unsigned long huge_shmem_orders_inherit __read_mostly;
+
 bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 		   pgoff_t index, bool shmem_huge_force)
 {
@@ -503,6 +514,44 @@ bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 	}
 }
 
+/*
+ * Return the sub-PMD orders a folio at @index of @inode may be allocated
+ * with. @huge tells whether shmem_is_huge() allowed a PMD sized one, which
+ * is what the "inherit" orders follow.
+ */
+static unsigned long shmem_huge_orders(struct vm_area_struct *vma,
+		struct inode *inode, pgoff_t index, bool huge)
+{
+	unsigned long orders, within_size;
+	pgoff_t i_size;
+	int order;
+
+	if (!S_ISREG(inode->i_mode) || shmem_huge == SHMEM_HUGE_DENY)
+		return 0;
+	if (vma && ((vma->vm_flags & VM_NOHUGEPAGE) ||
+	    test_bit(MMF_DISABLE_THP, &vma->vm_mm->flags)))
+		return 0;
+
+	orders = READ_ONCE(huge_shmem_orders_always);
+	if (huge)
+		orders |= READ_ONCE(huge_shmem_orders_inherit);
+	if (vma && (vma->vm_flags & VM_HUGEPAGE))
+		orders |= READ_ONCE(huge_shmem_orders_madvise);
+
+	within_size = READ_ONCE(huge_shmem_orders_within_size) & ~orders;
+	if (within_size) {
+		i_size = round_up(i_size_read(inode), PAGE_SIZE) >> PAGE_SHIFT;
+		order = highest_order(within_size);
+		while (within_size) {
+			if (round_up(index + 1, 1UL << order) <= i_size)
+				orders |= BIT(order);
+			order = next_order(&within_size, order);
+		}
+	}
+
+	return orders & THP_ORDERS_ANON_PTE;
+}
+
 #if defined(CONFIG_SYSFS)
 static int shmem_parse_huge(const char *str)
 {
@@ -684,6 +733,12 @@ bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 	return false;
 }
 
+static unsigned long shmem_huge_orders(struct vm_area_struct *vma,
+		struct inode *inode, pgoff_t index, bool huge)
+{
+	return 0;
+}
+
 static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 		struct shrink_control *sc, unsigned long nr_to_split)
 {
@@ -1541,23 +1596,30 @@ static gfp_t limit_gfp_mask(gfp_t huge_gfp, gfp_t limit_gfp)
 }
 
 static struct folio *shmem_alloc_hugefolio(gfp_t gfp,
-		struct shmem_inode_info *info, pgoff_t index)
+		struct shmem_inode_info *info, pgoff_t index, int order)
 {
 	struct vm_area_struct pvma;
 	struct address_space *mapping = info->vfs_inode.i_mapping;
+	unsigned long nr = 1UL << order;
 	pgoff_t hindex;
 	struct folio *folio;
 
-	hindex = round_down(index, HPAGE_PMD_NR);
-	if (xa_find(&mapping->i_pages, &hindex, hindex + HPAGE_PMD_NR - 1,
-								XA_PRESENT))
+	hindex = round_down(index, nr);
+	if (xa_find(&mapping->i_pages, &hindex, hindex + nr - 1, XA_PRESENT))
 		return NULL;
 
+	hindex = round_down(index, nr);
 	shmem_pseudo_vma_init(&pvma, info, hindex);
-	folio = vma_alloc_folio(gfp, HPAGE_PMD_ORDER, &pvma, 0, true);
+	folio = vma_alloc_folio(gfp, order, &pvma, 0,
+				order == HPAGE_PMD_ORDER);
 	shmem_pseudo_vma_destroy(&pvma);
-	if (!folio)
-		count_vm_event(THP_FILE_FALLBACK);
+	if (!folio) {
+		if (order == HPAGE_PMD_ORDER)
+			count_vm_event(THP_FILE_FALLBACK);
+		count_mthp_stat(order, MTHP_STAT_SHMEM_FALLBACK);
+	} else {
+		count_mthp_stat(order, MTHP_STAT_SHMEM_ALLOC);
+	}
 	return folio;
 }
 
@@ -1574,35 +1636,51 @@ static struct folio *shmem_alloc_folio(gfp_t gfp,
 	return folio;
 }
 
+/*
+ * Allocate a folio of the highest order in @orders that can be accounted
+ * and allocated, or an order-0 one if @orders is empty.
+ */
 static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
-		pgoff_t index, bool huge)
+		pgoff_t index, unsigned long orders)
 {
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	struct folio *folio;
-	int nr;
+	int order, nr;
 	int err = -ENOSPC;
 
 	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
-		huge = false;
-	nr = huge ? HPAGE_PMD_NR : 1;
-
-	if (!shmem_inode_acct_block(inode, nr))
-		goto failed;
+		orders = 0;
 
-	if (huge)
-		folio = shmem_alloc_hugefolio(gfp, info, index);
-	else
+	if (!orders) {
+		if (!shmem_inode_acct_block(inode, 1))
+			goto failed;
 		folio = shmem_alloc_folio(gfp, info, index);
-	if (folio) {
-		__folio_set_locked(folio);
-		__folio_set_swapbacked(folio);
-		return folio;
+		if (folio)
+			goto alloced;
+		err = -ENOMEM;
+		shmem_inode_unacct_blocks(inode, 1);
+		goto failed;
 	}
 
-	err = -ENOMEM;
-	shmem_inode_unacct_blocks(inode, nr);
+	order = highest_order(orders);
+	while (orders) {
+		nr = 1 << order;
+		if (shmem_inode_acct_block(inode, nr)) {
+			folio = shmem_alloc_hugefolio(gfp, info, index, order);
+			if (folio)
+				goto alloced;
+			err = -ENOMEM;
+			shmem_inode_unacct_blocks(inode, nr);
+		}
+		order = next_order(&orders, order);
+	}
 failed:
 	return ERR_PTR(err);
+
+alloced:
+	__folio_set_locked(folio);
+	__folio_set_swapbacked(folio);
+	return folio;
 }
 
 /*
@@ -1843,8 +1921,10 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 	struct shmem_sb_info *sbinfo;
 	struct mm_struct *charge_mm;
 	struct folio *folio;
+	unsigned long orders;
 	pgoff_t hindex;
 	gfp_t huge_gfp;
+	bool huge;
 	int error;
 	int once = 0;
 	int alloced = 0;
@@ -1911,15 +1991,19 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 		return 0;
 	}
 
-	if (!shmem_is_huge(vma, inode, index, false))
+	huge = shmem_is_huge(vma, inode, index, false);
+	orders = shmem_huge_orders(vma, inode, index, huge);
+	if (IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) && huge)
+		orders |= BIT(HPAGE_PMD_ORDER);
+	if (!orders)
 		goto alloc_nohuge;
 
 	huge_gfp = vma_thp_gfp_mask(vma);
 	huge_gfp = limit_gfp_mask(huge_gfp, gfp);
-	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, true);
+	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, orders);
 	if (IS_ERR(folio)) {
 alloc_nohuge:
-		folio = shmem_alloc_and_acct_folio(gfp, inode, index, false);
+		folio = shmem_alloc_and_acct_folio(gfp, inode, index, 0);
 	}
 	if (IS_ERR(folio)) {
 		int retry = 5;
@@ -2573,7 +2657,7 @@ shmem_write_end(struct file *file, struct address_space *mapping,
 		if (PageTransCompound(page)) {
 			int i;
 
-			for (i = 0; i < HPAGE_PMD_NR; i++) {
+			for (i = 0; i < compound_nr(head); i++) {
 				if (head + i == page)
 					continue;
 				clear_highpage(head + i);
@@ -4135,6 +4219,62 @@ static ssize_t shmem_enabled_store(struct kobject *kobj,
 }
 
 struct kobj_attribute shmem_enabled_attr = __ATTR_RW(shmem_enabled);
+
+static ssize_t thpsize_shmem_enabled_show(struct kobject *kobj,
+					  struct kobj_attribute *attr, char *buf)
+{
+	int order = to_thpsize(kobj)->order;
+	const char *output;
+
+	if (test_bit(order, &huge_shmem_orders_always))
+		output = "[always] inherit within_size advise never";
+	else if (test_bit(order, &huge_shmem_orders_inherit))
+		output = "always [inherit] within_size advise never";
+	else if (test_bit(order, &huge_shmem_orders_within_size))
+		output = "always inherit [within_size] advise never";
+	else if (test_bit(order, &huge_shmem_orders_madvise))
+		output = "always inherit within_size [advise] never";
+	else
+		output = "always inherit within_size advise [never]";
+
+	return sysfs_emit(buf, "%s\n", output);
+}
+
+static ssize_t thpsize_shmem_enabled_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	int order = to_thpsize(kobj)->order;
+	unsigned long *set;
+
+	if (sysfs_streq(buf, "always"))
+		set = &huge_shmem_orders_always;
+	else if (sysfs_streq(buf, "inherit"))
+		set = &huge_shmem_orders_inherit;
+	else if (sysfs_streq(buf, "within_size"))
+		set = &huge_shmem_orders_within_size;
+	else if (sysfs_streq(buf, "advise"))
+		set = &huge_shmem_orders_madvise;
+	else if (sysfs_streq(buf, "never"))
+		set = NULL;
+	else
+		return -EINVAL;
+
+	spin_lock(&huge_shmem_orders_lock);
+	clear_bit(order, &huge_shmem_orders_always);
+	clear_bit(order, &huge_shmem_orders_inherit);
+	clear_bit(order, &huge_shmem_orders_within_size);
+	clear_bit(order, &huge_shmem_orders_madvise);
+	if (set)
+		set_bit(order, set);
+	spin_unlock(&huge_shmem_orders_lock);
+
+	return count;
+}
+
+struct kobj_attribute thpsize_shmem_enabled_attr =
+	__ATTR(shmem_enabled, 0644, thpsize_shmem_enabled_show,
+	       thpsize_shmem_enabled_store);
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE && CONFIG_SYSFS */
 
 #else /* !CONFIG_SHMEM */
@@ -2723,6 +2723,10 @@ static inline void unfreeze_partials_cpu(struct kmem_cache *s,
 
 #endif	/* CONFIG_SLUB_CPU_PARTIAL */
 
+static void magazine_flush_local(struct kmem_cache *s);
+static void magazine_flush_cpu(struct kmem_cache *s, int cpu);
+static bool magazine_has_objects(struct kmem_cache *s, int cpu);
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	unsigned long flags;
@@ -2786,6 +2790,9 @@ static void flush_cpu_slab(struct work_struct *w)
 	s = sfw->s;
 	c = this_cpu_ptr(s->cpu_slab);
 
+	/* Objects flushed from the magazine may land in the cpu slab */
+	magazine_flush_local(s);
+
 	if (c->slab)
 		flush_slab(s, c);
 
@@ -2796,7 +2803,8 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->slab || slub_percpu_partial(c);
+	return c->slab || slub_percpu_partial(c) ||
+	       magazine_has_objects(s, cpu);
 }
 
 static DEFINE_MUTEX(flush_lock);
@@ -2848,8 +2856,10 @@ static int slub_cpu_dead(unsigned int cpu)
 	struct kmem_cache *s;
 
 	mutex_lock(&slab_mutex);
-	list_for_each_entry(s, &slab_caches, list)
+	list_for_each_entry(s, &slab_caches, list) {
+		magazine_flush_cpu(s, cpu);
 		__flush_cpu_slab(s, cpu);
+	}
 	mutex_unlock(&slab_mutex);
 	return 0;
 }
@@ -3414,6 +3424,108 @@ static __always_inline void maybe_wipe_obj_freeptr(struct kmem_cache *s,
 			0, sizeof(void *));
 }
 
+#ifndef CONFIG_SLUB_TINY
+/*
+ * Per cpu magazines are an array of free objects in front of the cpu slab.
+ * They are off unless enabled per cache through sysfs. Allocations and
+ * frees on the local node are served from the array under a local lock.
+ * An empty magazine is refilled and a full one is flushed in batches
+ * through the bulk paths, so the node list_lock is taken once per batch
+ * instead of for every cpu slab that runs out.
+ */
+#define MAGAZINE_MAX_SIZE	512
+/* Objects moved at once by a refill or a flush */
+#define MAGAZINE_BATCH		32
+
+static void *magazine_refill(struct kmem_cache *s, gfp_t gfpflags);
+static bool magazine_flush(struct kmem_cache *s, void *object);
+
+static __always_inline void *magazine_alloc(struct kmem_cache *s,
+					    gfp_t gfpflags, int node)
+{
+	struct slub_magazine __percpu *pcm;
+	struct slub_magazine *m;
+	unsigned long flags;
+	void *object = NULL;
+
+	if (likely(!READ_ONCE(s->magazine)))
+		return NULL;
+
+	if (node != NUMA_NO_NODE && node != numa_mem_id())
+		return NULL;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (likely(pcm)) {
+		local_lock_irqsave(&pcm->lock, flags);
+		m = this_cpu_ptr(pcm);
+		if (likely(m->size))
+			object = m->objects[--m->size];
+		local_unlock_irqrestore(&pcm->lock, flags);
+	}
+	rcu_read_unlock();
+
+	if (likely(object)) {
+		stat(s, ALLOC_MAGAZINE);
+		return object;
+	}
+
+	return pcm ? magazine_refill(s, gfpflags) : NULL;
+}
+
+/*
+ * Objects from remote nodes and pfmemalloc slabs bypass the magazine, so
+ * that it only ever hands out local objects any allocation may use.
+ */
+static __always_inline bool magazine_free(struct kmem_cache *s,
+					  struct slab *slab, void *object)
+{
+	struct slub_magazine __percpu *pcm;
+	struct slub_magazine *m;
+	unsigned long flags;
+	bool stored = false;
+
+	if (likely(!READ_ONCE(s->magazine)))
+		return false;
+
+	if (unlikely(slab_nid(slab) != numa_mem_id() ||
+		     slab_test_pfmemalloc(slab) || is_kfence_address(object)))
+		return false;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (likely(pcm)) {
+		local_lock_irqsave(&pcm->lock, flags);
+		m = this_cpu_ptr(pcm);
+		if (likely(m->size < m->capacity)) {
+			m->objects[m->size++] = object;
+			stored = true;
+		}
+		local_unlock_irqrestore(&pcm->lock, flags);
+	}
+	rcu_read_unlock();
+
+	if (likely(stored)) {
+		stat(s, FREE_MAGAZINE);
+		return true;
+	}
+
+	return pcm ? magazine_flush(s, object) : false;
+}
+#else /* CONFIG_SLUB_TINY */
+static inline void *magazine_alloc(struct kmem_cache *s, gfp_t gfpflags,
+				   int node)
+{
+	return NULL;
+}
+
+static inline bool magazine_free(struct kmem_cache *s, struct slab *slab,
+				 void *object)
+{
+	return false;
+}
+#endif /* CONFIG_SLUB_TINY */
+
 /*
  * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
  * have the fastpath folded into their functions. So no function call
@@ -3439,7 +3551,9 @@ static __fastpath_inline void *slab_alloc_node(struct kmem_cache *s, struct list
 	if (unlikely(object))
 		goto out;
 
-	object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
+	object = magazine_alloc(s, gfpflags, node);
+	if (!object)
+		object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
 
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
@@ -3784,8 +3898,11 @@ static __fastpath_inline void slab_free(struct kmem_cache *s, struct slab *slab,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail, &cnt))
+	if (slab_free_freelist_hook(s, &head, &tail, &cnt)) {
+		if (cnt == 1 && magazine_free(s, slab, head))
+			return;
 		do_slab_free(s, slab, head, tail, cnt, addr);
+	}
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -4036,6 +4153,238 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+#ifndef CONFIG_SLUB_TINY
+/*
+ * Return objects taken out of a magazine to their slabs. They went through
+ * the free hooks when they were put into the magazine.
+ */
+static void magazine_free_objects(struct kmem_cache *s, size_t size, void **p)
+{
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (!df.slab)
+			continue;
+
+		do_slab_free(df.s, df.slab, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (likely(size));
+}
+
+static inline unsigned int magazine_batch(struct slub_magazine *m)
+{
+	return clamp(m->capacity / 2, 1U, (unsigned int)MAGAZINE_BATCH);
+}
+
+/*
+ * Allocate an object for a caller that found the magazine empty, and stash
+ * a batch of objects allocated along with it in the magazine.
+ */
+static noinline void *magazine_refill(struct kmem_cache *s, gfp_t gfpflags)
+{
+	struct slub_magazine __percpu *pcm;
+	void *objects[MAGAZINE_BATCH];
+	struct slub_magazine *m;
+	unsigned long flags;
+	unsigned int i = 0, nr = 0;
+	void *object;
+
+	/*
+	 * The bulk allocation needs interrupts enabled, and must not fill the
+	 * magazine with objects of pfmemalloc slabs.
+	 */
+	if (irqs_disabled() || gfp_pfmemalloc_allowed(gfpflags))
+		return NULL;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (pcm)
+		nr = magazine_batch(raw_cpu_ptr(pcm));
+	rcu_read_unlock();
+	if (!nr)
+		return NULL;
+
+	nr = __kmem_cache_alloc_bulk(s, gfpflags, nr, objects, NULL);
+	if (!nr)
+		return NULL;
+	object = objects[--nr];
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (pcm) {
+		local_lock_irqsave(&pcm->lock, flags);
+		m = this_cpu_ptr(pcm);
+		for (; i < nr && m->size < m->capacity; i++)
+			m->objects[m->size++] = objects[i];
+		local_unlock_irqrestore(&pcm->lock, flags);
+	}
+	rcu_read_unlock();
+
+	if (i < nr)
+		magazine_free_objects(s, nr - i, objects + i);
+	stat(s, MAGAZINE_REFILL);
+
+	return object;
+}
+
+/*
+ * The magazine is full: flush a batch of its oldest objects to make room
+ * for @object. Returns false if @object has to be freed to its slab.
+ */
+static noinline bool magazine_flush(struct kmem_cache *s, void *object)
+{
+	struct slub_magazine __percpu *pcm;
+	void *objects[MAGAZINE_BATCH];
+	struct slub_magazine *m;
+	unsigned long flags;
+	unsigned int nr = 0;
+	bool stored = false;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (pcm) {
+		local_lock_irqsave(&pcm->lock, flags);
+		m = this_cpu_ptr(pcm);
+		nr = min(magazine_batch(m), m->size);
+		memcpy(objects, m->objects, nr * sizeof(void *));
+		m->size -= nr;
+		memmove(m->objects, m->objects + nr, m->size * sizeof(void *));
+		if (m->size < m->capacity) {
+			m->objects[m->size++] = object;
+			stored = true;
+		}
+		local_unlock_irqrestore(&pcm->lock, flags);
+	}
+	rcu_read_unlock();
+
+	if (nr) {
+		magazine_free_objects(s, nr, objects);
+		stat(s, MAGAZINE_FLUSH);
+	}
+
+	return stored;
+}
+
+/* Empty the magazine of the current cpu */
+static void magazine_flush_local(struct kmem_cache *s)
+{
+	struct slub_magazine __percpu *pcm;
+	void *objects[MAGAZINE_BATCH];
+	struct slub_magazine *m;
+	unsigned long flags;
+	unsigned int nr;
+
+	do {
+		nr = 0;
+		rcu_read_lock();
+		pcm = READ_ONCE(s->magazine);
+		if (pcm) {
+			local_lock_irqsave(&pcm->lock, flags);
+			m = this_cpu_ptr(pcm);
+			nr = min(m->size, (unsigned int)MAGAZINE_BATCH);
+			m->size -= nr;
+			memcpy(objects, m->objects + m->size,
+			       nr * sizeof(void *));
+			local_unlock_irqrestore(&pcm->lock, flags);
+		}
+		rcu_read_unlock();
+
+		if (nr) {
+			magazine_free_objects(s, nr, objects);
+			stat(s, MAGAZINE_FLUSH);
+		}
+	} while (nr == MAGAZINE_BATCH);
+}
+
+static void __magazine_flush_cpu(struct kmem_cache *s, struct slub_magazine *m)
+{
+	if (m->size) {
+		magazine_free_objects(s, m->size, m->objects);
+		m->size = 0;
+	}
+}
+
+/*
+ * Empty the magazine of a cpu that is gone. The caller holds the cpu
+ * hotplug lock for write, which excludes set_magazine_size().
+ */
+static void magazine_flush_cpu(struct kmem_cache *s, int cpu)
+{
+	struct slub_magazine __percpu *pcm = READ_ONCE(s->magazine);
+
+	if (pcm)
+		__magazine_flush_cpu(s, per_cpu_ptr(pcm, cpu));
+}
+
+static bool magazine_has_objects(struct kmem_cache *s, int cpu)
+{
+	struct slub_magazine __percpu *pcm;
+	bool ret = false;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (pcm)
+		ret = READ_ONCE(per_cpu_ptr(pcm, cpu)->size);
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static unsigned int magazine_capacity(struct kmem_cache *s)
+{
+	struct slub_magazine __percpu *pcm;
+	unsigned int capacity = 0;
+
+	rcu_read_lock();
+	pcm = READ_ONCE(s->magazine);
+	if (pcm)
+		capacity = raw_cpu_ptr(pcm)->capacity;
+	rcu_read_unlock();
+
+	return capacity;
+}
+
+/*
+ * Replace the magazines of a cache with ones holding up to @capacity
+ * objects, or remove them if @capacity is 0.
+ */
+static int set_magazine_size(struct kmem_cache *s, unsigned int capacity)
+{
+	struct slub_magazine __percpu *old, *new = NULL;
+	int cpu;
+
+	if (capacity) {
+		new = __alloc_percpu(sizeof(struct slub_magazine) +
+				     capacity * sizeof(void *),
+				     sizeof(void *));
+		if (!new)
+			return -ENOMEM;
+
+		for_each_possible_cpu(cpu) {
+			struct slub_magazine *m = per_cpu_ptr(new, cpu);
+
+			local_lock_init(&m->lock);
+			m->capacity = capacity;
+		}
+	}
+
+	/* Keep slub_cpu_dead() away from the magazines flushed below */
+	cpus_read_lock();
+	old = xchg(&s->magazine, new);
+	if (old) {
+		/* Wait for users of the old magazines, then empty them */
+		synchronize_rcu();
+		for_each_possible_cpu(cpu)
+			__magazine_flush_cpu(s, per_cpu_ptr(old, cpu));
+	}
+	cpus_read_unlock();
+
+	free_percpu(old);
+	return 0;
+}
+#endif /* CONFIG_SLUB_TINY */
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -4279,6 +4628,7 @@ void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
 #ifndef CONFIG_SLUB_TINY
+	free_percpu(s->magazine);
 	free_percpu(s->cpu_slab);
 #endif
 	free_kmem_cache_nodes(s);
@@ -5586,6 +5936,33 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+#ifndef CONFIG_SLUB_TINY
+static ssize_t magazine_size_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", magazine_capacity(s));
+}
+
+static ssize_t magazine_size_store(struct kmem_cache *s, const char *buf,
+				   size_t length)
+{
+	unsigned int objects;
+	int err;
+
+	err = kstrtouint(buf, 10, &objects);
+	if (err)
+		return err;
+	/* Debugging needs every object to go through the slow paths */
+	if (objects > MAGAZINE_MAX_SIZE || (objects && kmem_cache_debug(s)))
+		return -EINVAL;
+
+	err = set_magazine_size(s, objects);
+	if (err)
+		return err;
+	return length;
+}
+SLAB_ATTR(magazine_size);
+#endif
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5911,6 +6288,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_MAGAZINE, alloc_magazine);
+STAT_ATTR(FREE_MAGAZINE, free_magazine);
+STAT_ATTR(MAGAZINE_REFILL, magazine_refill);
+STAT_ATTR(MAGAZINE_FLUSH, magazine_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 #ifdef CONFIG_KFENCE
@@ -5943,6 +6324,9 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+#ifndef CONFIG_SLUB_TINY
+	&magazine_size_attr.attr,
+#endif
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5998,6 +6382,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_magazine_attr.attr,
+	&free_magazine_attr.attr,
+	&magazine_refill_attr.attr,
+	&magazine_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
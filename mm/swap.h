@@ -57,6 +57,7 @@ struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t flag,
 				    struct vm_fault *vmf);
 struct page *swapin_readahead(swp_entry_t entry, gfp_t flag,
 			      struct vm_fault *vmf);
+unsigned int swap_cluster_huge_nr(swp_entry_t entry);
 
 static inline unsigned int folio_swap_flags(struct folio *folio)
 {
@@ -94,6 +95,11 @@ static inline struct page *swapin_readahead(swp_entry_t swp, gfp_t gfp_mask,
 	return NULL;
 }
 
+static inline unsigned int swap_cluster_huge_nr(swp_entry_t entry)
+{
+	return 0;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
@@ -618,8 +618,17 @@ struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	bool do_poll = true, page_allocated;
 	struct vm_area_struct *vma = vmf->vma;
 	unsigned long addr = vmf->address;
+	unsigned int huge_nr = swap_cluster_huge_nr(entry);
 
-	mask = swapin_nr_pages(offset) - 1;
+	/*
+	 * A cluster that still backs a whole swapped-out THP is read back
+	 * in full: the neighbouring slots are the rest of that THP, and
+	 * under one plug they form a single large request.
+	 */
+	if (huge_nr)
+		mask = huge_nr - 1;
+	else
+		mask = swapin_nr_pages(offset) - 1;
 	if (!mask)
 		goto skip;
 
@@ -847,7 +856,8 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 				struct vm_fault *vmf)
 {
-	return swap_use_vma_readahead() ?
+	/* Slot order of a THP cluster is its virtual order, too. */
+	return swap_use_vma_readahead() && !swap_cluster_huge_nr(entry) ?
 			swap_vma_readahead(entry, gfp_mask, vmf) :
 			swap_cluster_readahead(entry, gfp_mask, vmf);
 }
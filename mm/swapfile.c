@@ -352,6 +352,15 @@ static inline void cluster_clear_huge(struct swap_cluster_info *info)
 	info->flags &= ~CLUSTER_FLAG_HUGE;
 }
 
+/*
+ * The THP backed by this cluster has left the swap cache in one piece, its
+ * slots stay in virtual order until they are freed along with the cluster.
+ */
+static inline void cluster_set_huge_out(struct swap_cluster_info *info)
+{
+	info->flags |= CLUSTER_FLAG_HUGE_OUT;
+}
+
 static inline struct swap_cluster_info *lock_cluster(struct swap_info_struct *si,
 						     unsigned long offset)
 {
@@ -1365,6 +1374,7 @@ void put_swap_folio(struct folio *folio, swp_entry_t entry)
 			spin_unlock(&si->lock);
 			return;
 		}
+		cluster_set_huge_out(ci);
 	}
 	for (i = 0; i < size; i++, entry.val++) {
 		if (!__swap_entry_free_locked(si, offset + i, SWAP_HAS_CACHE)) {
@@ -1479,6 +1489,30 @@ int __swp_swapcount(swp_entry_t entry)
 	return count;
 }
 
+/*
+ * If @entry belongs to a cluster that a THP was swapped out to as a whole,
+ * return the number of slots in that cluster; otherwise return 0.  Swap-in
+ * uses this to read the whole cluster back with one batch of contiguous IO.
+ *
+ * This is only a hint, read without the cluster lock: reading back slots
+ * which have been freed or reused since costs a little IO but is harmless.
+ */
+unsigned int swap_cluster_huge_nr(swp_entry_t entry)
+{
+	struct swap_info_struct *si;
+	struct swap_cluster_info *ci;
+
+	if (!IS_ENABLED(CONFIG_THP_SWAP))
+		return 0;
+
+	si = swp_swap_info(entry);
+	if (!si->cluster_info)
+		return 0;
+	ci = si->cluster_info + swp_offset(entry) / SWAPFILE_CLUSTER;
+
+	return ci->flags & CLUSTER_FLAG_HUGE_OUT ? SWAPFILE_CLUSTER : 0;
+}
+
 /*
  * How many references to @entry are currently swapped out?
  * This considers COUNT_CONTINUED so it returns exact answer.
@@ -530,13 +530,17 @@ static __always_inline ssize_t mfill_atomic_pte(struct mm_struct *dst_mm,
 	return err;
 }
 
+/*
+ * mmap_lock is taken on demand and left held on return for the caller to
+ * release, or to reuse for the next range, as long as *mmap_locked is set.
+ */
 static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 					      unsigned long dst_start,
 					      unsigned long src_start,
 					      unsigned long len,
 					      enum mcopy_atomic_mode mcopy_mode,
 					      atomic_t *mmap_changing,
-					      __u64 mode)
+					      __u64 mode, bool *mmap_locked)
 {
 	struct vm_area_struct *dst_vma;
 	ssize_t err;
@@ -561,7 +565,10 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	copied = 0;
 	page = NULL;
 retry:
-	mmap_read_lock(dst_mm);
+	if (!*mmap_locked) {
+		mmap_read_lock(dst_mm);
+		*mmap_locked = true;
+	}
 
 	/*
 	 * If memory mappings are changing because of non-cooperative
@@ -570,7 +577,7 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	 */
 	err = -EAGAIN;
 	if (mmap_changing && atomic_read(mmap_changing))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Make sure the vma is not shared, that the dst range is
@@ -579,7 +586,7 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	err = -ENOENT;
 	dst_vma = find_dst_vma(dst_mm, dst_start, len);
 	if (!dst_vma)
-		goto out_unlock;
+		goto out;
 
 	err = -EINVAL;
 	/*
@@ -588,7 +595,7 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	 */
 	if (WARN_ON_ONCE(vma_is_anonymous(dst_vma) &&
 	    dst_vma->vm_flags & VM_SHARED))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * validate 'mode' now that we know the dst_vma: don't allow
@@ -596,20 +603,23 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	 */
 	wp_copy = mode & UFFDIO_COPY_MODE_WP;
 	if (wp_copy && !(dst_vma->vm_flags & VM_UFFD_WP))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * If this is a HUGETLB vma, pass off to appropriate routine
 	 */
-	if (is_vm_hugetlb_page(dst_vma))
+	if (is_vm_hugetlb_page(dst_vma)) {
+		/* __mcopy_atomic_hugetlb() releases mmap_lock */
+		*mmap_locked = false;
 		return  __mcopy_atomic_hugetlb(dst_mm, dst_vma, dst_start,
 					       src_start, len, mcopy_mode,
 					       wp_copy);
+	}
 
 	if (!vma_is_anonymous(dst_vma) && !vma_is_shmem(dst_vma))
-		goto out_unlock;
+		goto out;
 	if (!vma_is_shmem(dst_vma) && mcopy_mode == MCOPY_ATOMIC_CONTINUE)
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Ensure the dst_vma has a anon_vma or this page
@@ -619,7 +629,7 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	err = -ENOMEM;
 	if (!(dst_vma->vm_flags & VM_SHARED) &&
 	    unlikely(anon_vma_prepare(dst_vma)))
-		goto out_unlock;
+		goto out;
 
 	while (src_addr < src_start + len) {
 		pmd_t dst_pmdval;
@@ -663,6 +673,7 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 			void *page_kaddr;
 
 			mmap_read_unlock(dst_mm);
+			*mmap_locked = false;
 			BUG_ON(!page);
 
 			page_kaddr = kmap_local_page(page);
@@ -691,8 +702,6 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 			break;
 	}
 
-out_unlock:
-	mmap_read_unlock(dst_mm);
 out:
 	if (page)
 		put_page(page);
@@ -702,26 +711,90 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 	return copied ? copied : err;
 }
 
+static ssize_t mfill_atomic(struct mm_struct *dst_mm, unsigned long dst_start,
+			    unsigned long src_start, unsigned long len,
+			    enum mcopy_atomic_mode mcopy_mode,
+			    atomic_t *mmap_changing, __u64 mode)
+{
+	bool mmap_locked = false;
+	ssize_t ret;
+
+	ret = __mcopy_atomic(dst_mm, dst_start, src_start, len, mcopy_mode,
+			     mmap_changing, mode, &mmap_locked);
+	if (mmap_locked)
+		mmap_read_unlock(dst_mm);
+	return ret;
+}
+
+/*
+ * Resolve the ranges of @vec in order, keeping mmap_lock across them
+ * unless a range had to drop it. Stops at the first range that fails
+ * or is only partially resolved and returns the bytes resolved so far.
+ */
+static ssize_t mfill_atomic_vec(struct mm_struct *dst_mm,
+				const struct uffdio_vec *vec, unsigned long nr,
+				enum mcopy_atomic_mode mcopy_mode,
+				atomic_t *mmap_changing, __u64 mode)
+{
+	bool mmap_locked = false;
+	ssize_t ret = -EINVAL, copied = 0;
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		unsigned long src = 0;
+
+		if (mcopy_mode == MCOPY_ATOMIC_NORMAL)
+			src = vec[i].src;
+		ret = __mcopy_atomic(dst_mm, vec[i].dst, src, vec[i].len,
+				     mcopy_mode, mmap_changing, mode,
+				     &mmap_locked);
+		if (ret < 0)
+			break;
+		copied += ret;
+		if (ret != vec[i].len)
+			break;
+	}
+	if (mmap_locked)
+		mmap_read_unlock(dst_mm);
+	return copied ? copied : ret;
+}
+
 ssize_t mcopy_atomic(struct mm_struct *dst_mm, unsigned long dst_start,
 		     unsigned long src_start, unsigned long len,
 		     atomic_t *mmap_changing, __u64 mode)
 {
-	return __mcopy_atomic(dst_mm, dst_start, src_start, len,
-			      MCOPY_ATOMIC_NORMAL, mmap_changing, mode);
+	return mfill_atomic(dst_mm, dst_start, src_start, len,
+			    MCOPY_ATOMIC_NORMAL, mmap_changing, mode);
 }
 
 ssize_t mfill_zeropage(struct mm_struct *dst_mm, unsigned long start,
 		       unsigned long len, atomic_t *mmap_changing)
 {
-	return __mcopy_atomic(dst_mm, start, 0, len, MCOPY_ATOMIC_ZEROPAGE,
-			      mmap_changing, 0);
+	return mfill_atomic(dst_mm, start, 0, len, MCOPY_ATOMIC_ZEROPAGE,
+			    mmap_changing, 0);
 }
 
 ssize_t mcopy_continue(struct mm_struct *dst_mm, unsigned long start,
 		       unsigned long len, atomic_t *mmap_changing)
 {
-	return __mcopy_atomic(dst_mm, start, 0, len, MCOPY_ATOMIC_CONTINUE,
-			      mmap_changing, 0);
+	return mfill_atomic(dst_mm, start, 0, len, MCOPY_ATOMIC_CONTINUE,
+			    mmap_changing, 0);
+}
+
+ssize_t mcopy_atomic_vec(struct mm_struct *dst_mm,
+			 const struct uffdio_vec *vec, unsigned long nr,
+			 atomic_t *mmap_changing, __u64 mode)
+{
+	return mfill_atomic_vec(dst_mm, vec, nr, MCOPY_ATOMIC_NORMAL,
+				mmap_changing, mode);
+}
+
+ssize_t mcopy_continue_vec(struct mm_struct *dst_mm,
+			   const struct uffdio_vec *vec, unsigned long nr,
+			   atomic_t *mmap_changing)
+{
+	return mfill_atomic_vec(dst_mm, vec, nr, MCOPY_ATOMIC_CONTINUE,
+				mmap_changing, 0);
 }
 
 void uffd_wp_range(struct mm_struct *dst_mm, struct vm_area_struct *dst_vma,
@@ -742,9 +742,17 @@ LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 static bool vmap_initialized __read_mostly;
 
-static struct rb_root purge_vmap_area_root = RB_ROOT;
-static LIST_HEAD(purge_vmap_area_list);
-static DEFINE_SPINLOCK(purge_vmap_area_lock);
+/*
+ * Lazily freed areas are queued on the CPU that freed them, merged with
+ * their neighbours, until __purge_vmap_area_lazy() collects the queues of
+ * all CPUs. This keeps vfree() off a global lock.
+ */
+struct vmap_purge_queue {
+	spinlock_t lock;
+	struct rb_root root;
+	struct list_head list;
+};
+static DEFINE_PER_CPU(struct vmap_purge_queue, vmap_purge_queue);
 
 /*
  * This kmem_cache is used for vmap_area objects. Instead of
@@ -1582,6 +1590,120 @@ preload_this_cpu_lock(spinlock_t *lock, gfp_t gfp_mask, int node)
 		kmem_cache_free(vmap_area_cachep, va);
 }
 
+/*
+ * Per-CPU vmap zones. Small page aligned allocations from the vmalloc range
+ * are carved out of a VMAP_ZONE_SIZE range owned by the CPU, so they don't
+ * take free_vmap_area_lock. Only refilling a zone does, once per
+ * VMAP_ZONE_SIZE of address space. Freed areas go back to the free tree as
+ * usual. The unused parts of the zones are given back when the vmalloc
+ * space runs out.
+ *
+ * This is only done on 64-bit, where the vmalloc space is large enough to
+ * spare a zone per CPU.
+ */
+#define VMAP_ZONE_SIZE		(2048UL * PAGE_SIZE)	/* 8MB with 4K pages */
+#define VMAP_ZONE_MAX_ALLOC	(VMAP_ZONE_SIZE / 16)
+
+struct vmap_zone {
+	spinlock_t lock;
+	/* The unused part of the zone, NULL if there is none */
+	struct vmap_area *va;
+};
+static DEFINE_PER_CPU(struct vmap_zone, vmap_zone);
+
+static __always_inline bool
+vmap_zone_fits(unsigned long size, unsigned long align,
+	unsigned long vstart, unsigned long vend)
+{
+	return IS_ENABLED(CONFIG_64BIT) && size <= VMAP_ZONE_MAX_ALLOC &&
+		align <= PAGE_SIZE &&
+		vstart == VMALLOC_START && vend == VMALLOC_END;
+}
+
+static void vmap_zone_release(struct vmap_area *va)
+{
+	if (!va_size(va)) {
+		kmem_cache_free(vmap_area_cachep, va);
+		return;
+	}
+
+	spin_lock(&free_vmap_area_lock);
+	merge_or_add_vmap_area_augment(va, &free_vmap_area_root, &free_vmap_area_list);
+	spin_unlock(&free_vmap_area_lock);
+}
+
+/*
+ * Returns the start of a range of @size bytes from the zone of this CPU,
+ * or VMALLOC_END if no new zone could be set up.
+ */
+static unsigned long
+vmap_zone_alloc(unsigned long size, gfp_t gfp_mask, int node)
+{
+	struct vmap_zone *zone = raw_cpu_ptr(&vmap_zone);
+	struct vmap_area *va, *old;
+	unsigned long addr;
+
+	spin_lock(&zone->lock);
+	va = zone->va;
+	if (va && va_size(va) >= size) {
+		addr = va->va_start;
+		va->va_start += size;
+		spin_unlock(&zone->lock);
+		return addr;
+	}
+	spin_unlock(&zone->lock);
+
+	va = kmem_cache_alloc_node(vmap_area_cachep, gfp_mask, node);
+	if (unlikely(!va))
+		return VMALLOC_END;
+
+	preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
+	addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
+		VMAP_ZONE_SIZE, PAGE_SIZE, VMALLOC_START, VMALLOC_END);
+	spin_unlock(&free_vmap_area_lock);
+
+	if (unlikely(addr == VMALLOC_END)) {
+		kmem_cache_free(vmap_area_cachep, va);
+		return addr;
+	}
+
+	va->va_start = addr + size;
+	va->va_end = addr + VMAP_ZONE_SIZE;
+
+	/* We may have been preempted by a refill of this or another zone. */
+	zone = raw_cpu_ptr(&vmap_zone);
+	spin_lock(&zone->lock);
+	old = zone->va;
+	zone->va = va;
+	spin_unlock(&zone->lock);
+
+	if (old)
+		vmap_zone_release(old);
+
+	return addr;
+}
+
+/*
+ * Give the unused parts of all zones back to the free tree.
+ */
+static void drain_vmap_zones(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_zone *zone = &per_cpu(vmap_zone, cpu);
+		struct vmap_area *va;
+
+		spin_lock(&zone->lock);
+		va = zone->va;
+		zone->va = NULL;
+		spin_unlock(&zone->lock);
+
+		if (va)
+			vmap_zone_release(va);
+	}
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -1618,10 +1740,16 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	kmemleak_scan_area(&va->rb_node, SIZE_MAX, gfp_mask);
 
 retry:
-	preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
-	addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
-		size, align, vstart, vend);
-	spin_unlock(&free_vmap_area_lock);
+	addr = vend;
+	if (vmap_zone_fits(size, align, vstart, vend))
+		addr = vmap_zone_alloc(size, gfp_mask, node);
+
+	if (addr == vend) {
+		preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
+		addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
+			size, align, vstart, vend);
+		spin_unlock(&free_vmap_area_lock);
+	}
 
 	trace_alloc_vmap_area(addr, size, align, vstart, vend, addr == vend);
 
@@ -1654,6 +1782,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 overflow:
 	if (!purged) {
+		drain_vmap_zones();
 		purge_vmap_area_lazy();
 		purged = 1;
 		goto retry;
@@ -1733,24 +1862,31 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	unsigned int num_purged_areas = 0;
 	struct list_head local_purge_list;
 	struct vmap_area *va, *n_va;
+	int cpu;
 
 	lockdep_assert_held(&vmap_purge_lock);
 
-	spin_lock(&purge_vmap_area_lock);
-	purge_vmap_area_root = RB_ROOT;
-	list_replace_init(&purge_vmap_area_list, &local_purge_list);
-	spin_unlock(&purge_vmap_area_lock);
+	INIT_LIST_HEAD(&local_purge_list);
+	for_each_possible_cpu(cpu) {
+		struct vmap_purge_queue *pq = &per_cpu(vmap_purge_queue, cpu);
 
-	if (unlikely(list_empty(&local_purge_list)))
-		goto out;
+		if (list_empty(&pq->list))
+			continue;
 
-	start = min(start,
-		list_first_entry(&local_purge_list,
-			struct vmap_area, list)->va_start);
+		spin_lock(&pq->lock);
+		if (!list_empty(&pq->list)) {
+			start = min(start, list_first_entry(&pq->list,
+					struct vmap_area, list)->va_start);
+			end = max(end, list_last_entry(&pq->list,
+					struct vmap_area, list)->va_end);
+		}
+		pq->root = RB_ROOT;
+		list_splice_tail_init(&pq->list, &local_purge_list);
+		spin_unlock(&pq->lock);
+	}
 
-	end = max(end,
-		list_last_entry(&local_purge_list,
-			struct vmap_area, list)->va_end);
+	if (unlikely(list_empty(&local_purge_list)))
+		goto out;
 
 	flush_tlb_kernel_range(start, end);
 	resched_threshold = lazy_max_pages() << 1;
@@ -1823,6 +1959,7 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 {
 	unsigned long nr_lazy_max = lazy_max_pages();
 	unsigned long va_start = va->va_start;
+	struct vmap_purge_queue *pq;
 	unsigned long nr_lazy;
 
 	spin_lock(&vmap_area_lock);
@@ -1833,12 +1970,12 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 				PAGE_SHIFT, &vmap_lazy_nr);
 
 	/*
-	 * Merge or place it to the purge tree/list.
+	 * Merge or place it to the purge tree/list of this CPU.
 	 */
-	spin_lock(&purge_vmap_area_lock);
-	merge_or_add_vmap_area(va,
-		&purge_vmap_area_root, &purge_vmap_area_list);
-	spin_unlock(&purge_vmap_area_lock);
+	pq = raw_cpu_ptr(&vmap_purge_queue);
+	spin_lock(&pq->lock);
+	merge_or_add_vmap_area(va, &pq->root, &pq->list);
+	spin_unlock(&pq->lock);
 
 	trace_free_vmap_area_noflush(va_start, nr_lazy, nr_lazy_max);
 
@@ -2429,11 +2566,17 @@ void __init vmalloc_init(void)
 
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
+		struct vmap_purge_queue *pq;
 		struct vfree_deferred *p;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+		pq = &per_cpu(vmap_purge_queue, i);
+		spin_lock_init(&pq->lock);
+		pq->root = RB_ROOT;
+		INIT_LIST_HEAD(&pq->list);
+		spin_lock_init(&per_cpu(vmap_zone, i).lock);
 		p = &per_cpu(vfree_deferred, i);
 		init_llist_head(&p->list);
 		INIT_WORK(&p->wq, free_work);
@@ -4108,14 +4251,19 @@ static void show_numa_info(struct seq_file *m, struct vm_struct *v)
 static void show_purge_info(struct seq_file *m)
 {
 	struct vmap_area *va;
+	int cpu;
 
-	spin_lock(&purge_vmap_area_lock);
-	list_for_each_entry(va, &purge_vmap_area_list, list) {
-		seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
-			(void *)va->va_start, (void *)va->va_end,
-			va->va_end - va->va_start);
+	for_each_possible_cpu(cpu) {
+		struct vmap_purge_queue *pq = &per_cpu(vmap_purge_queue, cpu);
+
+		spin_lock(&pq->lock);
+		list_for_each_entry(va, &pq->list, list) {
+			seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
+				(void *)va->va_start, (void *)va->va_end,
+				va->va_end - va->va_start);
+		}
+		spin_unlock(&pq->lock);
 	}
-	spin_unlock(&purge_vmap_area_lock);
 }
 
 static int s_show(struct seq_file *m, void *p)
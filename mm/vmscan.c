@@ -1620,7 +1620,8 @@ static unsigned int demote_folio_list(struct list_head *demote_folios,
 		      (unsigned long)&mtc, MIGRATE_ASYNC, MR_DEMOTION,
 		      &nr_succeeded);
 
-	__count_vm_events(PGDEMOTE_KSWAPD + reclaimer_offset(), nr_succeeded);
+	mod_node_page_state(pgdat, PGDEMOTE_KSWAPD + reclaimer_offset(),
+			    nr_succeeded);
 
 	return nr_succeeded;
 }
@@ -2835,7 +2836,7 @@ static void prepare_scan_count(pg_data_t *pgdat, struct scan_control *sc)
 	 * Flush the memory cgroup stats, so that we read accurate per-memcg
 	 * lruvec stats for heuristics.
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(sc->target_mem_cgroup);
 
 	/*
 	 * Determine the scan balance between anon and file LRUs.
@@ -3973,6 +3974,10 @@ static bool walk_pte_range(pmd_t *pmd, unsigned long start, unsigned long end,
 	arch_leave_lazy_mmu_mode();
 	spin_unlock(ptl);
 
+	/* mostly young page tables are worth collapsing into a THP */
+	if (young >= PTRS_PER_PTE / 2)
+		khugepaged_hot(args->vma, start);
+
 	return suitable_to_scan(total, young);
 }
 
@@ -4392,6 +4397,16 @@ static void inc_max_seq(struct lruvec *lruvec, bool can_swap, bool force_scan)
 	smp_store_release(&lrugen->max_seq, lrugen->max_seq + 1);
 
 	spin_unlock_irq(&lruvec->lru_lock);
+
+#ifdef CONFIG_MEMCG
+	{
+		struct mem_cgroup *memcg;
+
+		/* memory.page_age of this memcg and its ancestors has changed */
+		for (memcg = lruvec_memcg(lruvec); memcg; memcg = parent_mem_cgroup(memcg))
+			cgroup_file_notify(&memcg->page_age_file);
+	}
+#endif
 }
 
 static bool try_to_inc_max_seq(struct lruvec *lruvec, unsigned long max_seq,
@@ -5852,8 +5867,60 @@ void lru_gen_init_lruvec(struct lruvec *lruvec)
 #ifdef CONFIG_MEMCG
 void lru_gen_init_memcg(struct mem_cgroup *memcg)
 {
+	static const unsigned int intervals[] = { 1000, 5000, 30000, 120000, 600000 };
+
 	INIT_LIST_HEAD(&memcg->mm_list.fifo);
 	spin_lock_init(&memcg->mm_list.lock);
+
+	memcpy(memcg->page_age_intervals, intervals, sizeof(intervals));
+	memcg->nr_page_age_intervals = ARRAY_SIZE(intervals);
+}
+
+/*
+ * Sum up the pages in the subtree of @memcg by the age of their generations.
+ * A generation born N ms ago only holds pages accessed within the last N ms,
+ * so its pages go into the first of the @nr ascending @intervals (in ms) that
+ * is not shorter than N, or into the extra bin at @pages[@nr] if none is.
+ */
+void lru_gen_page_age(struct mem_cgroup *memcg, const unsigned int *intervals,
+		      int nr, unsigned long (*pages)[ANON_AND_FILE])
+{
+	struct mem_cgroup *iter;
+
+	iter = mem_cgroup_iter(memcg, NULL, NULL);
+	do {
+		int nid;
+
+		for_each_node_state(nid, N_MEMORY) {
+			int type;
+			struct lruvec *lruvec = get_lruvec(iter, nid);
+			struct lru_gen_struct *lrugen = &lruvec->lrugen;
+			DEFINE_MAX_SEQ(lruvec);
+			DEFINE_MIN_SEQ(lruvec);
+
+			for (type = 0; type < ANON_AND_FILE; type++) {
+				unsigned long seq;
+
+				for (seq = min_seq[type]; seq <= max_seq; seq++) {
+					int i, zone;
+					long size = 0;
+					int gen = lru_gen_from_seq(seq);
+					unsigned long birth = READ_ONCE(lrugen->timestamps[gen]);
+					unsigned int age = jiffies_to_msecs(jiffies - birth);
+
+					for (zone = 0; zone < MAX_NR_ZONES; zone++)
+						size += max(READ_ONCE(lrugen->nr_pages[gen][type][zone]), 0L);
+
+					for (i = 0; i < nr && intervals[i] < age; i++)
+						;
+
+					pages[i][type] += size;
+				}
+			}
+		}
+
+		cond_resched();
+	} while ((iter = mem_cgroup_iter(memcg, iter, NULL)));
 }
 
 void lru_gen_exit_memcg(struct mem_cgroup *memcg)
@@ -6094,9 +6161,19 @@ static inline bool should_continue_reclaim(struct pglist_data *pgdat,
 static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 {
 	struct mem_cgroup *target_memcg = sc->target_mem_cgroup;
+	struct mem_cgroup_reclaim_cookie reclaim = { .pgdat = pgdat };
+	struct mem_cgroup_reclaim_cookie *cookie = NULL;
 	struct mem_cgroup *memcg;
 
-	memcg = mem_cgroup_iter(target_memcg, NULL, NULL);
+	/*
+	 * With several kswapd threads per node, share the hierarchy walk so
+	 * that they each reclaim from different memcgs instead of all of
+	 * them scanning the same lruvecs.
+	 */
+	if (current_is_kswapd() && READ_ONCE(kswapd_threads) > 1)
+		cookie = &reclaim;
+
+	memcg = mem_cgroup_iter(target_memcg, NULL, cookie);
 	do {
 		struct lruvec *lruvec = mem_cgroup_lruvec(memcg, pgdat);
 		unsigned long reclaimed;
@@ -6146,7 +6223,7 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 				   sc->nr_scanned - scanned,
 				   sc->nr_reclaimed - reclaimed);
 
-	} while ((memcg = mem_cgroup_iter(target_memcg, memcg, NULL)));
+	} while ((memcg = mem_cgroup_iter(target_memcg, memcg, cookie)));
 }
 
 static void shrink_node(pg_data_t *pgdat, struct scan_control *sc)
@@ -7004,6 +7081,16 @@ clear_reclaim_active(pg_data_t *pgdat, int highest_zoneidx)
 	update_reclaim_active(pgdat, highest_zoneidx, false);
 }
 
+/*
+ * With vm.kswapd_threads > 1, kswapd[0] of a node consumes the wakeup requests
+ * and owns the per-cpu vmstat thresholds, the other threads only help it
+ * reclaim while the node is unbalanced.
+ */
+static bool kswapd_is_primary(pg_data_t *pgdat)
+{
+	return current == READ_ONCE(pgdat->kswapd[0]);
+}
+
 /*
  * For kswapd, balance_pgdat() will reclaim pages across a node from zones
  * that are eligible for use by the caller until at least one zone is
@@ -7185,7 +7272,8 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int highest_zoneidx)
 			sc.priority--;
 	} while (sc.priority >= 1);
 
-	if (!sc.nr_reclaimed)
+	/* Only the primary thread decides that the node is hopeless */
+	if (!sc.nr_reclaimed && kswapd_is_primary(pgdat))
 		pgdat->kswapd_failures++;
 
 out:
@@ -7245,6 +7333,7 @@ static enum zone_type kswapd_highest_zoneidx(pg_data_t *pgdat,
 static void kswapd_try_to_sleep(pg_data_t *pgdat, int alloc_order, int reclaim_order,
 				unsigned int highest_zoneidx)
 {
+	bool primary = kswapd_is_primary(pgdat);
 	long remaining = 0;
 	DEFINE_WAIT(wait);
 
@@ -7311,12 +7400,14 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int alloc_order, int reclaim_o
 		 * per-cpu vmstat threshold while kswapd is awake and restore
 		 * them before going back to sleep.
 		 */
-		set_pgdat_percpu_threshold(pgdat, calculate_normal_threshold);
+		if (primary)
+			set_pgdat_percpu_threshold(pgdat, calculate_normal_threshold);
 
 		if (!kthread_should_stop())
 			schedule();
 
-		set_pgdat_percpu_threshold(pgdat, calculate_pressure_threshold);
+		if (primary)
+			set_pgdat_percpu_threshold(pgdat, calculate_pressure_threshold);
 	} else {
 		if (remaining)
 			count_vm_event(KSWAPD_LOW_WMARK_HIT_QUICKLY);
@@ -7365,9 +7456,11 @@ static int kswapd(void *p)
 	tsk->flags |= PF_MEMALLOC | PF_KSWAPD;
 	set_freezable();
 
-	WRITE_ONCE(pgdat->kswapd_order, 0);
-	WRITE_ONCE(pgdat->kswapd_highest_zoneidx, MAX_NR_ZONES);
-	atomic_set(&pgdat->nr_writeback_throttled, 0);
+	if (kswapd_is_primary(pgdat)) {
+		WRITE_ONCE(pgdat->kswapd_order, 0);
+		WRITE_ONCE(pgdat->kswapd_highest_zoneidx, MAX_NR_ZONES);
+		atomic_set(&pgdat->nr_writeback_throttled, 0);
+	}
 	for ( ; ; ) {
 		bool ret;
 
@@ -7383,8 +7476,10 @@ static int kswapd(void *p)
 		alloc_order = READ_ONCE(pgdat->kswapd_order);
 		highest_zoneidx = kswapd_highest_zoneidx(pgdat,
 							highest_zoneidx);
-		WRITE_ONCE(pgdat->kswapd_order, 0);
-		WRITE_ONCE(pgdat->kswapd_highest_zoneidx, MAX_NR_ZONES);
+		if (kswapd_is_primary(pgdat)) {
+			WRITE_ONCE(pgdat->kswapd_order, 0);
+			WRITE_ONCE(pgdat->kswapd_highest_zoneidx, MAX_NR_ZONES);
+		}
 
 		ret = try_to_freeze();
 		if (kthread_should_stop())
@@ -7509,21 +7604,45 @@ unsigned long shrink_all_memory(unsigned long nr_to_reclaim)
 }
 #endif /* CONFIG_HIBERNATION */
 
+/* Number of kswapd threads per node, vm.kswapd_threads */
+int kswapd_threads = 1;
+
 /*
- * This kswapd start function will be called by init and node-hot-add.
+ * This kswapd start function will be called by init and node-hot-add, and
+ * when vm.kswapd_threads changes. It starts the missing threads and stops
+ * those beyond the configured count.
  */
 void kswapd_run(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
+	int nr = READ_ONCE(kswapd_threads);
+	struct task_struct *tsk;
+	int i;
 
 	pgdat_kswapd_lock(pgdat);
-	if (!pgdat->kswapd) {
-		pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-		if (IS_ERR(pgdat->kswapd)) {
+	for (i = 0; i < nr; i++) {
+		if (pgdat->kswapd[i])
+			continue;
+		if (!i)
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d", nid);
+		else
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d:%d",
+					     nid, i);
+		if (IS_ERR(tsk)) {
 			/* failure at boot is fatal */
-			BUG_ON(system_state < SYSTEM_RUNNING);
-			pr_err("Failed to start kswapd on node %d\n", nid);
-			pgdat->kswapd = NULL;
+			BUG_ON(!i && system_state < SYSTEM_RUNNING);
+			pr_err("Failed to start kswapd%s on node %d\n",
+			       i ? " helper" : "", nid);
+			break;
+		}
+		/* set before the thread runs, see kswapd_is_primary() */
+		pgdat->kswapd[i] = tsk;
+		wake_up_process(tsk);
+	}
+	for (i = max(nr, 1); i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
 		}
 	}
 	pgdat_kswapd_unlock(pgdat);
@@ -7536,17 +7655,40 @@ void kswapd_run(int nid)
 void kswapd_stop(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	struct task_struct *kswapd;
+	int i;
 
 	pgdat_kswapd_lock(pgdat);
-	kswapd = pgdat->kswapd;
-	if (kswapd) {
-		kthread_stop(kswapd);
-		pgdat->kswapd = NULL;
+	/* stop the helpers first, they don't outlive the primary thread */
+	for (i = MAX_KSWAPD_THREADS - 1; i >= 0; i--) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
 	}
 	pgdat_kswapd_unlock(pgdat);
 }
 
+int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+		void *buffer, size_t *length, loff_t *ppos)
+{
+	static DEFINE_MUTEX(kswapd_threads_mutex);
+	int ret, nid;
+
+	mutex_lock(&kswapd_threads_mutex);
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		goto out;
+
+	/* Nodes can't gain or lose all of their memory meanwhile */
+	get_online_mems();
+	for_each_node_state(nid, N_MEMORY)
+		kswapd_run(nid);
+	put_online_mems();
+out:
+	mutex_unlock(&kswapd_threads_mutex);
+	return ret;
+}
+
 static int __init kswapd_init(void)
 {
 	int nid;
@@ -64,7 +64,7 @@ void bpf_sk_storage_free(struct sock *sk)
 	rcu_read_unlock();
 
 	if (free_sk_storage)
-		kfree_rcu(sk_storage, rcu);
+		bpf_local_storage_free(sk_storage, false);
 }
 
 static void bpf_sk_storage_map_free(struct bpf_map *map)
@@ -198,6 +198,16 @@ int bpf_sk_storage_clone(const struct sock *sk, struct sock *newsk)
 		}
 
 		if (new_sk_storage) {
+			ret = bpf_local_storage_slot_prepare(newsk,
+							     new_sk_storage,
+							     smap, GFP_ATOMIC);
+			if (ret) {
+				kfree(copy_selem);
+				atomic_sub(smap->elem_size,
+					   &newsk->sk_omem_alloc);
+				bpf_map_put(map);
+				goto out;
+			}
 			bpf_selem_link_map(smap, copy_selem);
 			bpf_selem_link_storage_nolock(new_sk_storage, copy_selem);
 		} else {
@@ -868,6 +878,10 @@ static int bpf_iter_attach_map(struct bpf_prog *prog,
 	if (!linfo->map.map_fd)
 		return -EBADF;
 
+	/* Sharded iteration is not supported */
+	if (linfo->map.shard || linfo->map.nr_shards)
+		return -EOPNOTSUPP;
+
 	map = bpf_map_get_with_uref(linfo->map.map_fd);
 	if (IS_ERR(map))
 		return PTR_ERR(map);
@@ -4331,6 +4331,7 @@ int weight_p __read_mostly = 64;           /* old backlog weight */
 int dev_weight_rx_bias __read_mostly = 1;  /* bias for backlog weight */
 int dev_weight_tx_bias __read_mostly = 1;  /* bias for output_queue quota */
 int dev_rx_weight __read_mostly = 64;
+int sk_wake_batch __read_mostly;
 int dev_tx_weight __read_mostly = 64;
 
 /* Called with irq disabled */
@@ -4424,6 +4425,18 @@ set_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 	return rflow;
 }
 
+/* Whether RFS should hold off moving flows to @cpu: once its backlog is half
+ * full it is unlikely to keep up with more, and packets steered there would
+ * only add to its latency or be dropped.
+ */
+static bool rps_cpu_busy(unsigned int cpu)
+{
+	struct softnet_data *sd = &per_cpu(softnet_data, cpu);
+
+	return skb_queue_len_lockless(&sd->input_pkt_queue) >
+	       (READ_ONCE(netdev_max_backlog) >> 1);
+}
+
 /*
  * get_rps_cpu is called from netif_receive_skb and returns the target
  * CPU from the RPS map of the receiving queue for a given skb.
@@ -4494,13 +4507,17 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 		 *     last packet that was enqueued using this table entry.
 		 *     This guarantees that all previous packets for the flow
 		 *     have been dequeued, thus preserving in order delivery.
+		 * and the desired CPU is not already swamped, in which case
+		 * the flow stays where it is for now.
 		 */
 		if (unlikely(tcpu != next_cpu) &&
 		    (tcpu >= nr_cpu_ids || !cpu_online(tcpu) ||
 		     ((int)(per_cpu(softnet_data, tcpu).input_queue_head -
 		      rflow->last_qtail)) >= 0)) {
-			tcpu = next_cpu;
-			rflow = set_rps_cpu(dev, skb, rflow, next_cpu);
+			if (next_cpu < nr_cpu_ids && !rps_cpu_busy(next_cpu)) {
+				tcpu = next_cpu;
+				rflow = set_rps_cpu(dev, skb, rflow, next_cpu);
+			}
 		}
 
 		if (tcpu < nr_cpu_ids && cpu_online(tcpu)) {
@@ -6644,6 +6661,8 @@ static __latent_entropy void net_rx_action(struct softirq_action *h)
 	LIST_HEAD(list);
 	LIST_HEAD(repoll);
 
+	sd->wake_batch = READ_ONCE(sk_wake_batch);
+
 	local_irq_disable();
 	list_splice_init(&sd->poll_list, &list);
 	local_irq_enable();
@@ -6682,7 +6701,9 @@ static __latent_entropy void net_rx_action(struct softirq_action *h)
 		__raise_softirq_irqoff(NET_RX_SOFTIRQ);
 
 	net_rps_action_and_irq_enable(sd);
-end:;
+end:
+	sd->wake_batch = 0;
+	sock_wake_flush(sd);
 }
 
 struct netdev_adjacent {
@@ -10613,6 +10634,7 @@ struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
 	dev->gro_max_size = GRO_LEGACY_MAX_SIZE;
 	dev->tso_max_size = TSO_LEGACY_MAX_SIZE;
 	dev->tso_max_segs = TSO_MAX_SEGS;
+	dev->xdp_zc_max_segs = 1;
 	dev->upper_level = 1;
 	dev->lower_level = 1;
 #ifdef CONFIG_LOCKDEP
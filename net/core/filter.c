@@ -60,6 +60,7 @@
 #include <net/udp.h>
 #include <linux/bpf_trace.h>
 #include <net/xdp_sock.h>
+#include <net/xdp_sock_drv.h>
 #include <linux/inetdevice.h>
 #include <net/inet_hashtables.h>
 #include <net/inet6_hashtables.h>
@@ -4025,11 +4026,20 @@ static int bpf_xdp_frags_shrink_tail(struct xdp_buff *xdp, int offset)
 		if (skb_frag_size(frag) == shrink) {
 			struct page *page = skb_frag_page(frag);
 
-			__xdp_return(page_address(page), &xdp->rxq->mem,
-				     false, NULL);
+			if (xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL) {
+				struct xdp_buff *tail = xsk_buff_get_tail(xdp);
+
+				xsk_buff_del_tail(tail);
+				xsk_buff_free(tail);
+			} else {
+				__xdp_return(page_address(page),
+					     &xdp->rxq->mem, false, NULL);
+			}
 			n_frags_free++;
 		} else {
 			skb_frag_size_sub(frag, shrink);
+			if (xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL)
+				xsk_buff_get_tail(xdp)->data_end -= shrink;
 			break;
 		}
 	}
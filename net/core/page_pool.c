@@ -30,6 +30,7 @@
 #ifdef CONFIG_PAGE_POOL_STATS
 /* alloc_stat_inc is intended to be used in softirq context */
 #define alloc_stat_inc(pool, __stat)	(pool->alloc_stats.__stat++)
+#define alloc_stat_add(pool, __stat, val)	(pool->alloc_stats.__stat += (val))
 /* recycle_stat_inc is safe to use when preemption is possible. */
 #define recycle_stat_inc(pool, __stat)							\
 	do {										\
@@ -50,11 +51,13 @@ static const char pp_stats[][ETH_GSTRING_LEN] = {
 	"rx_pp_alloc_empty",
 	"rx_pp_alloc_refill",
 	"rx_pp_alloc_waive",
+	"rx_pp_alloc_node",
 	"rx_pp_recycle_cached",
 	"rx_pp_recycle_cache_full",
 	"rx_pp_recycle_ring",
 	"rx_pp_recycle_ring_full",
 	"rx_pp_recycle_released_ref",
+	"rx_pp_recycle_node",
 };
 
 bool page_pool_get_stats(struct page_pool *pool,
@@ -72,6 +75,7 @@ bool page_pool_get_stats(struct page_pool *pool,
 	stats->alloc_stats.empty += pool->alloc_stats.empty;
 	stats->alloc_stats.refill += pool->alloc_stats.refill;
 	stats->alloc_stats.waive += pool->alloc_stats.waive;
+	stats->alloc_stats.node += pool->alloc_stats.node;
 
 	for_each_possible_cpu(cpu) {
 		const struct page_pool_recycle_stats *pcpu =
@@ -82,6 +86,7 @@ bool page_pool_get_stats(struct page_pool *pool,
 		stats->recycle_stats.ring += pcpu->ring;
 		stats->recycle_stats.ring_full += pcpu->ring_full;
 		stats->recycle_stats.released_refcnt += pcpu->released_refcnt;
+		stats->recycle_stats.node += pcpu->node;
 	}
 
 	return true;
@@ -117,11 +122,13 @@ u64 *page_pool_ethtool_stats_get(u64 *data, void *stats)
 	*data++ = pool_stats->alloc_stats.empty;
 	*data++ = pool_stats->alloc_stats.refill;
 	*data++ = pool_stats->alloc_stats.waive;
+	*data++ = pool_stats->alloc_stats.node;
 	*data++ = pool_stats->recycle_stats.cached;
 	*data++ = pool_stats->recycle_stats.cache_full;
 	*data++ = pool_stats->recycle_stats.ring;
 	*data++ = pool_stats->recycle_stats.ring_full;
 	*data++ = pool_stats->recycle_stats.released_refcnt;
+	*data++ = pool_stats->recycle_stats.node;
 
 	return data;
 }
@@ -129,10 +136,95 @@ EXPORT_SYMBOL(page_pool_ethtool_stats_get);
 
 #else
 #define alloc_stat_inc(pool, __stat)
+#define alloc_stat_add(pool, __stat, val)
 #define recycle_stat_inc(pool, __stat)
 #define recycle_stat_add(pool, __stat, val)
 #endif
 
+/* Order-0 pages a pool has to give up, because its ring is full or because
+ * they are from the wrong node, are parked in a small per-node cache that
+ * the slow path of every pool on that node takes from before going to the
+ * page allocator.  DMA mappings are per device, so pages are unmapped on
+ * the way in and mapped again by the pool that takes them.
+ */
+#define PP_NODE_CACHE_SIZE	256
+
+static struct ptr_ring *page_pool_node_cache __read_mostly;
+
+static int __init page_pool_node_cache_init(void)
+{
+	struct ptr_ring *cache;
+	int nid;
+
+	cache = kcalloc(nr_node_ids, sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return -ENOMEM;
+
+	for_each_node(nid) {
+		if (ptr_ring_init(&cache[nid], PP_NODE_CACHE_SIZE, GFP_KERNEL))
+			goto err;
+	}
+
+	page_pool_node_cache = cache;
+	return 0;
+
+err:
+	for_each_node(nid)
+		ptr_ring_cleanup(&cache[nid], NULL);
+	kfree(cache);
+	return -ENOMEM;
+}
+subsys_initcall(page_pool_node_cache_init);
+
+/* Releases @page from @pool into the cache of its node, if there is room */
+static bool page_pool_give_to_node(struct page_pool *pool, struct page *page)
+{
+	bool in_softirq = in_serving_softirq();
+	struct ptr_ring *r;
+	bool ret = false;
+
+	if (!page_pool_node_cache || pool->p.order)
+		return false;
+
+	r = &page_pool_node_cache[page_to_nid(page)];
+
+	if (in_softirq)
+		spin_lock(&r->producer_lock);
+	else
+		spin_lock_bh(&r->producer_lock);
+
+	/* Only the consumer frees slots, so the produce can't fail */
+	if (!__ptr_ring_full(r)) {
+		/* pool may be gone once the page is released */
+		recycle_stat_inc(pool, node);
+		page_pool_release_page(pool, page);
+		__ptr_ring_produce(r, page);
+		ret = true;
+	}
+
+	if (in_softirq)
+		spin_unlock(&r->producer_lock);
+	else
+		spin_unlock_bh(&r->producer_lock);
+
+	return ret;
+}
+
+/* Takes up to @nr pages from the node cache into the empty alloc cache */
+static int page_pool_take_from_node(struct page_pool *pool, int nr)
+{
+	int nid = pool->p.nid;
+
+	if (!page_pool_node_cache)
+		return 0;
+
+	if (nid == NUMA_NO_NODE)
+		nid = numa_mem_id();
+
+	return ptr_ring_consume_batched_bh(&page_pool_node_cache[nid],
+					   (void **)pool->alloc.cache, nr);
+}
+
 static int page_pool_init(struct page_pool *pool,
 			  const struct page_pool_params *params)
 {
@@ -259,8 +351,9 @@ static struct page *page_pool_refill_alloc_cache(struct page_pool *pool)
 			 * (2) break out to fallthrough to alloc_pages_node.
 			 * This limit stress on page buddy alloactor.
 			 */
-			page_pool_return_page(pool, page);
 			alloc_stat_inc(pool, waive);
+			if (!page_pool_give_to_node(pool, page))
+				page_pool_return_page(pool, page);
 			page = NULL;
 			break;
 		}
@@ -389,8 +482,13 @@ static struct page *__page_pool_alloc_pages_slow(struct page_pool *pool,
 	/* Mark empty alloc.cache slots "empty" for alloc_pages_bulk_array */
 	memset(&pool->alloc.cache, 0, sizeof(void *) * bulk);
 
-	nr_pages = alloc_pages_bulk_array_node(gfp, pool->p.nid, bulk,
-					       pool->alloc.cache);
+	nr_pages = page_pool_take_from_node(pool, bulk);
+	alloc_stat_add(pool, node, nr_pages);
+
+	/* Fills the remaining empty slots, and counts all of them */
+	if (nr_pages < bulk)
+		nr_pages = alloc_pages_bulk_array_node(gfp, pool->p.nid, bulk,
+						       pool->alloc.cache);
 	if (unlikely(!nr_pages))
 		return NULL;
 
@@ -603,9 +701,10 @@ void page_pool_put_defragged_page(struct page_pool *pool, struct page *page,
 {
 	page = __page_pool_put_page(pool, page, dma_sync_size, allow_direct);
 	if (page && !page_pool_recycle_in_ring(pool, page)) {
-		/* Cache full, fallback to free pages */
+		/* Cache full, fallback to the node cache or free pages */
 		recycle_stat_inc(pool, ring_full);
-		page_pool_return_page(pool, page);
+		if (!page_pool_give_to_node(pool, page))
+			page_pool_return_page(pool, page);
 	}
 }
 EXPORT_SYMBOL(page_pool_put_defragged_page);
@@ -651,8 +750,10 @@ void page_pool_put_page_bulk(struct page_pool *pool, void **data,
 	/* ptr_ring cache full, free remaining pages outside producer lock
 	 * since put_page() with refcnt == 1 can be an expensive operation
 	 */
-	for (; i < bulk_len; i++)
-		page_pool_return_page(pool, data[i]);
+	for (; i < bulk_len; i++) {
+		if (!page_pool_give_to_node(pool, data[i]))
+			page_pool_return_page(pool, data[i]);
+	}
 }
 EXPORT_SYMBOL(page_pool_put_page_bulk);
 
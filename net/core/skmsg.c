@@ -512,7 +512,8 @@ static struct sk_msg *alloc_sk_msg(gfp_t gfp)
 }
 
 static struct sk_msg *sk_psock_create_ingress_msg(struct sock *sk,
-						  struct sk_buff *skb)
+						  struct sk_buff *skb,
+						  gfp_t gfp)
 {
 	if (atomic_read(&sk->sk_rmem_alloc) > sk->sk_rcvbuf)
 		return NULL;
@@ -520,7 +521,7 @@ static struct sk_msg *sk_psock_create_ingress_msg(struct sock *sk,
 	if (!sk_rmem_schedule(sk, skb, skb->truesize))
 		return NULL;
 
-	return alloc_sk_msg(GFP_KERNEL);
+	return alloc_sk_msg(gfp);
 }
 
 static int sk_psock_skb_ingress_enqueue(struct sk_buff *skb,
@@ -552,8 +553,10 @@ static int sk_psock_skb_ingress_enqueue(struct sk_buff *skb,
 	msg->sg.end = num_sge;
 	msg->skb = skb;
 
+	/* The caller wakes up the reader, so that it can do it once for
+	 * a batch of skbs.
+	 */
 	sk_psock_queue_msg(psock, msg);
-	sk_psock_data_ready(sk, psock);
 	return copied;
 }
 
@@ -561,7 +564,7 @@ static int sk_psock_skb_ingress_self(struct sk_psock *psock, struct sk_buff *skb
 				     u32 off, u32 len);
 
 static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb,
-				u32 off, u32 len)
+				u32 off, u32 len, gfp_t gfp)
 {
 	struct sock *sk = psock->sk;
 	struct sk_msg *msg;
@@ -573,7 +576,7 @@ static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb,
 	 */
 	if (unlikely(skb->sk == sk))
 		return sk_psock_skb_ingress_self(psock, skb, off, len);
-	msg = sk_psock_create_ingress_msg(sk, skb);
+	msg = sk_psock_create_ingress_msg(sk, skb, gfp);
 	if (!msg)
 		return -EAGAIN;
 
@@ -618,7 +621,7 @@ static int sk_psock_handle_skb(struct sk_psock *psock, struct sk_buff *skb,
 			return -EAGAIN;
 		return skb_send_sock(psock->sk, skb, off, len);
 	}
-	return sk_psock_skb_ingress(psock, skb, off, len);
+	return sk_psock_skb_ingress(psock, skb, off, len, GFP_KERNEL);
 }
 
 static void sk_psock_skb_state(struct sk_psock *psock,
@@ -642,7 +645,7 @@ static void sk_psock_backlog(struct work_struct *work)
 	struct sk_psock *psock = container_of(work, struct sk_psock, work);
 	struct sk_psock_work_state *state = &psock->work_state;
 	struct sk_buff *skb = NULL;
-	bool ingress;
+	bool ingress, wake = false;
 	u32 len, off;
 	int ret;
 
@@ -693,8 +696,13 @@ static void sk_psock_backlog(struct work_struct *work)
 
 		if (!ingress)
 			kfree_skb(skb);
+		else
+			wake = true;
 	}
 end:
+	/* Wake up the reader once for everything moved to ingress_msg */
+	if (wake)
+		sk_psock_data_ready(psock->sk, psock);
 	mutex_unlock(&psock->work_mutex);
 }
 
@@ -904,6 +912,57 @@ int sk_psock_msg_verdict(struct sock *sk, struct sk_psock *psock,
 }
 EXPORT_SYMBOL_GPL(sk_psock_msg_verdict);
 
+/* Nothing must be queued or in flight in the backlog of @psock, or an
+ * skb delivered directly could overtake it.
+ */
+static bool sk_psock_backlog_idle(struct sk_psock *psock)
+{
+	bool idle;
+
+	spin_lock_bh(&psock->ingress_lock);
+	idle = sk_psock_test_state(psock, SK_PSOCK_TX_ENABLED) &&
+	       skb_queue_empty(&psock->ingress_skb) &&
+	       !psock->work_state.skb && !work_busy(&psock->work);
+	spin_unlock_bh(&psock->ingress_lock);
+	return idle;
+}
+
+/* Deliver an ingress redirect to @psock from the context of the verdict
+ * program instead of going through its backlog workqueue, saving a
+ * context switch and the latency of the worker on every redirect.  An
+ * egress redirect needs process context for sendmsg and is always left
+ * to the backlog.  Returns false if the skb has to be queued after all.
+ */
+static bool sk_psock_skb_redirect_direct(struct sk_psock *psock,
+					 struct sk_buff *skb)
+{
+	unsigned long sk_redir = skb->_sk_redir;
+	struct sock *sk_other = psock->sk;
+	u32 off = 0, len = skb->len;
+	int ret;
+
+	if (!skb_bpf_ingress(skb) || !sk_psock_backlog_idle(psock))
+		return false;
+
+	if (skb_bpf_strparser(skb)) {
+		struct strp_msg *stm = strp_msg(skb);
+
+		off = stm->offset;
+		len = stm->full_len;
+	}
+
+	/* The reader may consume the skb as soon as it is queued */
+	skb_bpf_redirect_clear(skb);
+	ret = sk_psock_skb_ingress(psock, skb, off, len, GFP_ATOMIC);
+	if (ret < 0) {
+		skb->_sk_redir = sk_redir;
+		return false;
+	}
+
+	sk_psock_data_ready(sk_other, psock);
+	return true;
+}
+
 static int sk_psock_skb_redirect(struct sk_psock *from, struct sk_buff *skb)
 {
 	struct sk_psock *psock_other;
@@ -928,6 +987,9 @@ static int sk_psock_skb_redirect(struct sk_psock *from, struct sk_buff *skb)
 		sock_drop(from->sk, skb);
 		return -EIO;
 	}
+	if (sk_psock_skb_redirect_direct(psock_other, skb))
+		return 0;
+
 	spin_lock_bh(&psock_other->ingress_lock);
 	if (!sk_psock_test_state(psock_other, SK_PSOCK_TX_ENABLED)) {
 		spin_unlock_bh(&psock_other->ingress_lock);
@@ -1012,6 +1074,8 @@ static int sk_psock_verdict_apply(struct sk_psock *psock, struct sk_buff *skb,
 				len = stm->full_len;
 			}
 			err = sk_psock_skb_ingress_self(psock, skb, off, len);
+			if (err >= 0)
+				sk_psock_data_ready(psock->sk, psock);
 		}
 		if (err < 0) {
 			spin_lock_bh(&psock->ingress_lock);
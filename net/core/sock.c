@@ -1457,6 +1457,9 @@ int sk_setsockopt(struct sock *sk, int level, int optname,
 			      (sk->sk_type == SOCK_DGRAM &&
 			       sk->sk_protocol == IPPROTO_UDP)))
 				ret = -EOPNOTSUPP;
+		} else if (sk->sk_family == PF_UNIX) {
+			if (sk->sk_type != SOCK_STREAM)
+				ret = -EOPNOTSUPP;
 		} else if (sk->sk_family != PF_RDS) {
 			ret = -EOPNOTSUPP;
 		}
@@ -3287,13 +3290,59 @@ static void sock_def_error_report(struct sock *sk)
 	rcu_read_unlock();
 }
 
+/* With net.core.sk_wake_batch set, the data-ready wakeups done from
+ * net_rx_action() are deferred to its end and then done back to back.
+ * When one round delivers to many sockets, the tasks woken on a given CPU
+ * then end up on its wake list together, behind a single IPI.
+ */
+static bool sock_defer_readable(struct sock *sk)
+{
+	struct softnet_data *sd;
+	unsigned int n;
+
+	if (!in_serving_softirq() || in_hardirq())
+		return false;
+
+	sd = this_cpu_ptr(&softnet_data);
+	n = sd->wake_count;
+	if (n && sd->wake_list[n - 1] == sk)
+		return true;
+	if (n >= sd->wake_batch)
+		return false;
+
+	sock_hold(sk);
+	sd->wake_list[n] = sk;
+	sd->wake_count = n + 1;
+	return true;
+}
+
+void sock_wake_flush(struct softnet_data *sd)
+{
+	unsigned int i;
+
+	for (i = 0; i < sd->wake_count; i++) {
+		struct sock *sk = sd->wake_list[i];
+		struct socket_wq *wq;
+
+		rcu_read_lock();
+		wq = rcu_dereference(sk->sk_wq);
+		if (skwq_has_sleeper(wq))
+			wake_up_interruptible_sync_poll(&wq->wait, EPOLLIN |
+							EPOLLPRI | EPOLLRDNORM |
+							EPOLLRDBAND);
+		rcu_read_unlock();
+		sock_put(sk);
+	}
+	sd->wake_count = 0;
+}
+
 void sock_def_readable(struct sock *sk)
 {
 	struct socket_wq *wq;
 
 	rcu_read_lock();
 	wq = rcu_dereference(sk->sk_wq);
-	if (skwq_has_sleeper(wq))
+	if (skwq_has_sleeper(wq) && !sock_defer_readable(sk))
 		wake_up_interruptible_sync_poll(&wq->wait, EPOLLIN | EPOLLPRI |
 						EPOLLRDNORM | EPOLLRDBAND);
 	sk_wake_async(sk, SOCK_WAKE_WAITD, POLL_IN);
@@ -1639,6 +1639,10 @@ static int sock_map_iter_attach_target(struct bpf_prog *prog,
 	if (!linfo->map.map_fd)
 		return -EBADF;
 
+	/* Sharded iteration is not supported */
+	if (linfo->map.shard || linfo->map.nr_shards)
+		return -EOPNOTSUPP;
+
 	map = bpf_map_get_with_uref(linfo->map.map_fd);
 	if (IS_ERR(map))
 		return PTR_ERR(map);
@@ -29,6 +29,7 @@ static int int_3600 = 3600;
 static int min_sndbuf = SOCK_MIN_SNDBUF;
 static int min_rcvbuf = SOCK_MIN_RCVBUF;
 static int max_skb_frags = MAX_SKB_FRAGS;
+static int max_sk_wake_batch = NET_WAKE_BATCH_MAX;
 
 static int net_msg_warn;	/* Unused, but still a sysctl */
 
@@ -577,6 +578,15 @@ static struct ctl_table net_core_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= SYSCTL_ONE,
 	},
+	{
+		.procname	= "sk_wake_batch",
+		.data		= &sk_wake_batch,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &max_sk_wake_batch,
+	},
 	{
 		.procname	= "netdev_unregister_timeout_secs",
 		.data		= &netdev_unregister_timeout_secs,
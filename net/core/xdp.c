@@ -4,6 +4,7 @@
  * Copyright (c) 2017 Jesper Dangaard Brouer, Red Hat Inc.
  */
 #include <linux/bpf.h>
+#include <linux/btf_ids.h>
 #include <linux/filter.h>
 #include <linux/types.h>
 #include <linux/mm.h>
@@ -515,7 +516,9 @@ void xdp_return_buff(struct xdp_buff *xdp)
 	struct skb_shared_info *sinfo;
 	int i;
 
-	if (likely(!xdp_buff_has_frags(xdp)))
+	/* xsk_buff_free() takes care of AF_XDP fragments itself */
+	if (likely(!xdp_buff_has_frags(xdp)) ||
+	    xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL)
 		goto out;
 
 	sinfo = xdp_get_shared_info_from_buff(xdp);
@@ -561,6 +564,10 @@ struct xdp_frame *xdp_convert_zc_to_xdp_frame(struct xdp_buff *xdp)
 	struct xdp_frame *xdpf;
 	struct page *page;
 
+	/* Multi-buffer AF_XDP packets can't be cloned into a single page */
+	if (unlikely(xdp_buff_has_frags(xdp)))
+		return NULL;
+
 	/* Clone into a MEM_TYPE_PAGE_ORDER0 xdp_frame. */
 	metasize = xdp_data_meta_unsupported(xdp) ? 0 :
 		   xdp->data - xdp->data_meta;
@@ -709,3 +716,91 @@ struct xdp_frame *xdpf_clone(struct xdp_frame *xdpf)
 
 	return nxdpf;
 }
+
+static const struct xdp_metadata_ops *xdp_md_ops(const struct xdp_md *ctx)
+{
+	struct xdp_buff *xdp = (struct xdp_buff *)ctx;
+
+	if (!xdp_buff_has_rx_metadata(xdp))
+		return NULL;
+	return xdp->rxq->dev->xdp_metadata_ops;
+}
+
+__diag_push();
+__diag_ignore_all("-Wmissing-prototypes",
+		  "Global functions as their definitions will be in vmlinux BTF");
+
+/* bpf_xdp_metadata_rx_timestamp - Read the hardware Rx timestamp
+ *
+ * Parameters:
+ * @ctx		- Pointer to ctx (xdp_md) in XDP program
+ * @timestamp	- Where to store the timestamp, in ns
+ *
+ * Returns 0 on success, -EOPNOTSUPP if the driver can't tell, -ENODATA if
+ * the packet was not timestamped.
+ */
+int bpf_xdp_metadata_rx_timestamp(const struct xdp_md *ctx, u64 *timestamp)
+{
+	const struct xdp_metadata_ops *ops = xdp_md_ops(ctx);
+
+	if (!ops || !ops->xmo_rx_timestamp)
+		return -EOPNOTSUPP;
+	return ops->xmo_rx_timestamp(ctx, timestamp);
+}
+
+/* bpf_xdp_metadata_rx_hash - Read the Rx hash computed by the device
+ *
+ * Parameters:
+ * @ctx		- Pointer to ctx (xdp_md) in XDP program
+ * @hash	- Where to store the hash
+ *
+ * Returns 0 on success, -EOPNOTSUPP if the driver can't tell, -ENODATA if
+ * the device did not hash the packet.
+ */
+int bpf_xdp_metadata_rx_hash(const struct xdp_md *ctx, u32 *hash)
+{
+	const struct xdp_metadata_ops *ops = xdp_md_ops(ctx);
+
+	if (!ops || !ops->xmo_rx_hash)
+		return -EOPNOTSUPP;
+	return ops->xmo_rx_hash(ctx, hash);
+}
+
+/* bpf_xdp_metadata_rx_vlan_tag - Read the VLAN tag stripped by the device
+ *
+ * Parameters:
+ * @ctx		- Pointer to ctx (xdp_md) in XDP program
+ * @vlan_proto	- Where to store the tag protocol, in network byte order
+ * @vlan_tci	- Where to store the tag control information
+ *
+ * Returns 0 on success, -EOPNOTSUPP if the driver can't tell, -ENODATA if
+ * no tag was stripped.
+ */
+int bpf_xdp_metadata_rx_vlan_tag(const struct xdp_md *ctx, __be16 *vlan_proto,
+				 u16 *vlan_tci)
+{
+	const struct xdp_metadata_ops *ops = xdp_md_ops(ctx);
+
+	if (!ops || !ops->xmo_rx_vlan_tag)
+		return -EOPNOTSUPP;
+	return ops->xmo_rx_vlan_tag(ctx, vlan_proto, vlan_tci);
+}
+
+__diag_pop();
+
+BTF_SET8_START(xdp_metadata_kfunc_ids)
+BTF_ID_FLAGS(func, bpf_xdp_metadata_rx_timestamp)
+BTF_ID_FLAGS(func, bpf_xdp_metadata_rx_hash)
+BTF_ID_FLAGS(func, bpf_xdp_metadata_rx_vlan_tag)
+BTF_SET8_END(xdp_metadata_kfunc_ids)
+
+static const struct btf_kfunc_id_set xdp_metadata_kfunc_set = {
+	.owner = THIS_MODULE,
+	.set   = &xdp_metadata_kfunc_ids,
+};
+
+static int __init xdp_metadata_init(void)
+{
+	return register_btf_kfunc_id_set(BPF_PROG_TYPE_XDP, &xdp_metadata_kfunc_set);
+}
+late_initcall(xdp_metadata_init);
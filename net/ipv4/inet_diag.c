@@ -1081,15 +1081,20 @@ void inet_diag_dump_icsk(struct inet_hashinfo *hashinfo, struct sk_buff *skb,
 		goto out;
 
 #define SKARR_SZ 16
-	for (i = s_i; i <= hashinfo->ehash_mask; i++) {
-		struct inet_ehash_bucket *head = &hashinfo->ehash[i];
+	for (i = s_i; i <= READ_ONCE(hashinfo->ehash_mask); i++) {
 		spinlock_t *lock = inet_ehash_lockp(hashinfo, i);
+		struct hlist_nulls_head *chain;
 		struct hlist_nulls_node *node;
 		struct sock *sk_arr[SKARR_SZ];
 		int num_arr[SKARR_SZ];
 		int idx, accum, res;
+		bool empty;
 
-		if (hlist_nulls_empty(&head->chain))
+		rcu_read_lock();
+		chain = inet_ehash_chain(hashinfo, i);
+		empty = !chain || hlist_nulls_empty(chain);
+		rcu_read_unlock();
+		if (empty)
 			continue;
 
 		if (i > s_i)
@@ -1099,7 +1104,12 @@ void inet_diag_dump_icsk(struct inet_hashinfo *hashinfo, struct sk_buff *skb,
 		num = 0;
 		accum = 0;
 		spin_lock_bh(lock);
-		sk_nulls_for_each(sk, node, &head->chain) {
+		chain = inet_ehash_chain(hashinfo, i);
+		if (!chain) {
+			spin_unlock_bh(lock);
+			break;
+		}
+		sk_nulls_for_each(sk, node, chain) {
 			int state;
 
 			if (!net_eq(sock_net(sk), net))
@@ -482,9 +482,12 @@ struct sock *__inet_lookup_established(struct net *net,
 	 * have wildcards anyways.
 	 */
 	unsigned int hash = inet_ehashfn(net, daddr, hnum, saddr, sport);
-	unsigned int slot = hash & hashinfo->ehash_mask;
-	struct inet_ehash_bucket *head = &hashinfo->ehash[slot];
+	struct inet_ehash_bucket *head;
+	unsigned int slot, seq;
 
+again:
+	seq = read_seqcount_begin(&hashinfo->ehash_seq);
+	head = __inet_ehash_bucket(hashinfo, hash, &slot);
 begin:
 	sk_nulls_for_each_rcu(sk, node, &head->chain) {
 		if (sk->sk_hash != hash)
@@ -507,6 +510,9 @@ struct sock *__inet_lookup_established(struct net *net,
 	 */
 	if (get_nulls_value(node) != slot)
 		goto begin;
+	/* A resize may have moved the socket to the other table. */
+	if (read_seqcount_retry(&hashinfo->ehash_seq, seq))
+		goto again;
 out:
 	sk = NULL;
 found:
@@ -530,13 +536,14 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 	const __portpair ports = INET_COMBINED_PORTS(inet->inet_dport, lport);
 	unsigned int hash = inet_ehashfn(net, daddr, lport,
 					 saddr, inet->inet_dport);
-	struct inet_ehash_bucket *head = inet_ehash_bucket(hinfo, hash);
 	spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
+	struct inet_ehash_bucket *head;
 	struct sock *sk2;
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 
 	spin_lock(lock);
+	head = inet_ehash_bucket(hinfo, hash);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
 		if (sk2->sk_hash != hash)
@@ -643,11 +650,11 @@ bool inet_ehash_insert(struct sock *sk, struct sock *osk, bool *found_dup_sk)
 	WARN_ON_ONCE(!sk_unhashed(sk));
 
 	sk->sk_hash = sk_ehashfn(sk);
-	head = inet_ehash_bucket(hashinfo, sk->sk_hash);
-	list = &head->chain;
 	lock = inet_ehash_lockp(hashinfo, sk->sk_hash);
 
 	spin_lock(lock);
+	head = inet_ehash_bucket(hashinfo, sk->sk_hash);
+	list = &head->chain;
 	if (osk) {
 		WARN_ON_ONCE(sk->sk_hash != osk->sk_hash);
 		ret = sk_nulls_del_node_init_rcu(osk);
@@ -1214,6 +1221,7 @@ int inet_ehash_locks_alloc(struct inet_hashinfo *hashinfo)
 			spin_lock_init(&hashinfo->ehash_locks[i]);
 	}
 	hashinfo->ehash_locks_mask = nblocks - 1;
+	seqcount_init(&hashinfo->ehash_seq);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(inet_ehash_locks_alloc);
@@ -1264,3 +1272,113 @@ void inet_pernet_hashinfo_free(struct inet_hashinfo *hashinfo)
 	kfree(hashinfo);
 }
 EXPORT_SYMBOL_GPL(inet_pernet_hashinfo_free);
+
+static DEFINE_MUTEX(inet_ehash_resize_mutex);
+
+static void inet_ehash_move_chain(struct hlist_nulls_head *chain,
+				  struct inet_ehash_bucket *ehash,
+				  unsigned int mask)
+{
+	struct hlist_nulls_node *node;
+	struct sock *sk;
+
+	while (!hlist_nulls_empty(chain)) {
+		node = chain->first;
+		sk = hlist_nulls_entry(node, struct sock, sk_nulls_node);
+		hlist_nulls_del_rcu(node);
+		hlist_nulls_add_head_rcu(node, &ehash[sk->sk_hash & mask].chain);
+	}
+}
+
+/* The boot time table of the global ehash comes from
+ * alloc_large_system_hash(), which falls back to alloc_pages_exact() when it
+ * does not use vmalloc.
+ */
+static void inet_ehash_free_table(struct inet_ehash_bucket *ehash,
+				  unsigned int entries)
+{
+	if (is_vmalloc_addr(ehash))
+		vfree(ehash);
+	else
+		free_pages_exact(ehash, entries * sizeof(*ehash));
+}
+
+/* Resize an ehash to @ehash_entries buckets, a power of two.
+ *
+ * The lock of a hash covers the same buckets in both tables as long as
+ * neither has fewer buckets than there are locks, so the sockets can be
+ * moved one lock at a time while connections come and go under the other
+ * locks.  A lockless lookup racing with the move of its lock may walk off
+ * to the new table or find the old bucket empty, it then sees ehash_seq
+ * change and looks again.
+ */
+int inet_ehash_resize(struct inet_hashinfo *hashinfo,
+		      unsigned int ehash_entries)
+{
+	unsigned int nlocks = hashinfo->ehash_locks_mask + 1;
+	struct inet_ehash_bucket *old, *new;
+	unsigned int i, j, old_entries;
+	int err = 0;
+
+	ehash_entries = max(ehash_entries, nlocks);
+	if (WARN_ON_ONCE(!is_power_of_2(ehash_entries)))
+		return -EINVAL;
+
+	mutex_lock(&inet_ehash_resize_mutex);
+
+	if (ehash_entries == hashinfo->ehash_mask + 1)
+		goto out;
+
+	/* The global table is not charged to whoever resizes it. */
+	new = vmalloc_huge(ehash_entries * sizeof(struct inet_ehash_bucket),
+			   hashinfo->pernet ? GFP_KERNEL_ACCOUNT : GFP_KERNEL);
+	if (!new) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < ehash_entries; i++)
+		INIT_HLIST_NULLS_HEAD(&new[i].chain, i);
+
+	hashinfo->ehash_next_mask = ehash_entries - 1;
+	hashinfo->ehash_next_locks = 0;
+	smp_store_release(&hashinfo->ehash_next, new);
+
+	for (i = 0; i < nlocks; i++) {
+		spin_lock_bh(&hashinfo->ehash_locks[i]);
+		write_seqcount_begin(&hashinfo->ehash_seq);
+
+		for (j = i; j <= hashinfo->ehash_mask; j += nlocks)
+			inet_ehash_move_chain(&hashinfo->ehash[j].chain, new,
+					      ehash_entries - 1);
+		WRITE_ONCE(hashinfo->ehash_next_locks, i + 1);
+
+		write_seqcount_end(&hashinfo->ehash_seq);
+		spin_unlock_bh(&hashinfo->ehash_locks[i]);
+		cond_resched();
+	}
+
+	/* Everybody must go through ehash_next before ehash changes, even
+	 * those who looked at it before it was set.
+	 */
+	synchronize_rcu();
+
+	old = hashinfo->ehash;
+	old_entries = hashinfo->ehash_mask + 1;
+
+	local_bh_disable();
+	write_seqcount_begin(&hashinfo->ehash_seq);
+	WRITE_ONCE(hashinfo->ehash, new);
+	WRITE_ONCE(hashinfo->ehash_mask, ehash_entries - 1);
+	write_seqcount_end(&hashinfo->ehash_seq);
+	local_bh_enable();
+
+	smp_store_release(&hashinfo->ehash_next, NULL);
+
+	synchronize_rcu();
+	inet_ehash_free_table(old, old_entries);
+out:
+	mutex_unlock(&inet_ehash_resize_mutex);
+	return err;
+}
+EXPORT_SYMBOL_GPL(inet_ehash_resize);
@@ -394,8 +394,9 @@ static int proc_tcp_ehash_entries(struct ctl_table *table, int write,
 	struct inet_hashinfo *hinfo = net->ipv4.tcp_death_row.hashinfo;
 	int tcp_ehash_entries;
 	struct ctl_table tbl;
+	int ret;
 
-	tcp_ehash_entries = hinfo->ehash_mask + 1;
+	tcp_ehash_entries = READ_ONCE(hinfo->ehash_mask) + 1;
 
 	/* A negative number indicates that the child netns
 	 * shares the global ehash.
@@ -407,7 +408,19 @@ static int proc_tcp_ehash_entries(struct ctl_table *table, int write,
 	tbl.data = &tcp_ehash_entries;
 	tbl.maxlen = sizeof(int);
 
-	return proc_dointvec(&tbl, write, buffer, lenp, ppos);
+	ret = proc_dointvec(&tbl, write, buffer, lenp, ppos);
+	if (!write || ret)
+		return ret;
+
+	/* A child netns sharing the global ehash cannot resize it. */
+	if (!hinfo->pernet && !net_eq(net, &init_net))
+		return -EPERM;
+
+	if (tcp_ehash_entries <= 0 ||
+	    tcp_ehash_entries > tcp_child_ehash_entries_max)
+		return -EINVAL;
+
+	return inet_ehash_resize(hinfo, roundup_pow_of_two(tcp_ehash_entries));
 }
 
 static int proc_udp_hash_entries(struct ctl_table *table, int write,
@@ -1374,7 +1387,7 @@ static struct ctl_table ipv4_net_table[] = {
 	{
 		.procname	= "tcp_ehash_entries",
 		.data		= &init_net.ipv4.sysctl_tcp_child_ehash_entries,
-		.mode		= 0444,
+		.mode		= 0644,
 		.proc_handler	= proc_tcp_ehash_entries,
 	},
 	{
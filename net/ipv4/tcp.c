@@ -2074,6 +2074,49 @@ static int tcp_zc_handle_leftover(struct tcp_zerocopy_receive *zc,
 	return zc->copybuf_len < 0 ? 0 : copylen;
 }
 
+/* With TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD, copy the bytes preceding the
+ * next mappable page, typically an RPC header left in the linear part or a
+ * partial page by header split, so that one call returns both the header,
+ * in copybuf, and the payload pages that follow it.
+ */
+static u32 tcp_zc_copy_head(struct tcp_zerocopy_receive *zc, struct sock *sk,
+			    u32 *seq, s32 copybuf_len,
+			    struct scm_timestamping_internal *tss)
+{
+	struct sk_buff *skb;
+	u32 offset, copylen;
+
+	skb = tcp_recv_skb(sk, *seq, &offset);
+	if (!skb)
+		return 0;
+
+	tcp_zerocopy_set_hint_for_skb(sk, zc, skb, offset);
+	copylen = zc->recv_skip_hint;
+	if (!copylen || copylen > copybuf_len)
+		return 0;
+
+	if (TCP_SKB_CB(skb)->has_rxtstamp) {
+		tcp_update_recv_tstamps(skb, tss);
+		zc->msg_flags |= TCP_CMSG_TS;
+	}
+
+	zc->copybuf_len = tcp_copy_straggler_data(zc, skb, copylen, &offset,
+						  seq);
+	return zc->copybuf_len < 0 ? 0 : copylen;
+}
+
+static void tcp_zc_finish(struct sock *sk, u32 seq, int copied)
+{
+	u32 offset;
+
+	WRITE_ONCE(tcp_sk(sk)->copied_seq, seq);
+	tcp_rcv_space_adjust(sk);
+
+	/* Clean up data we have read: This will do ACK frames. */
+	tcp_recv_skb(sk, seq, &offset);
+	tcp_cleanup_rbuf(sk, copied);
+}
+
 static int tcp_zerocopy_vm_insert_batch_error(struct vm_area_struct *vma,
 					      struct page **pending_pages,
 					      unsigned long pages_remaining,
@@ -2186,7 +2229,7 @@ static int tcp_zerocopy_receive(struct sock *sk,
 				struct tcp_zerocopy_receive *zc,
 				struct scm_timestamping_internal *tss)
 {
-	u32 length = 0, offset, vma_len, avail_len, copylen = 0;
+	u32 length = 0, offset, vma_len, avail_len, copylen = 0, headlen = 0;
 	unsigned long address = (unsigned long)zc->address;
 	struct page *pages[TCP_ZEROCOPY_PAGE_BATCH_SIZE];
 	s32 copybuf_len = zc->copybuf_len;
@@ -2214,9 +2257,19 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	if (inq && inq <= copybuf_len)
 		return receive_fallback_to_copy(sk, zc, inq, tss);
 
+	if (inq && copybuf_len > 0 &&
+	    (zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD)) {
+		headlen = tcp_zc_copy_head(zc, sk, &seq, copybuf_len, tss);
+		inq -= headlen;
+	}
+
 	if (inq < PAGE_SIZE) {
 		zc->length = 0;
 		zc->recv_skip_hint = inq;
+		if (headlen) {
+			tcp_zc_finish(sk, seq, headlen);
+			return 0;
+		}
 		if (!inq && sock_flag(sk, SOCK_DONE))
 			return -EIO;
 		return 0;
@@ -2302,17 +2355,13 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	}
 out:
 	mmap_read_unlock(current->mm);
-	/* Try to copy straggler data. */
-	if (!ret)
+	/* Try to copy straggler data, unless copybuf holds the head already */
+	if (!ret && !headlen)
 		copylen = tcp_zc_handle_leftover(zc, sk, skb, &seq, copybuf_len, tss);
+	copylen += headlen;
 
 	if (length + copylen) {
-		WRITE_ONCE(tp->copied_seq, seq);
-		tcp_rcv_space_adjust(sk);
-
-		/* Clean up data we have read: This will do ACK frames. */
-		tcp_recv_skb(sk, seq, &offset);
-		tcp_cleanup_rbuf(sk, length + copylen);
+		tcp_zc_finish(sk, seq, length + copylen);
 		ret = 0;
 		if (length == zc->length)
 			zc->recv_skip_hint = 0;
@@ -2323,6 +2372,45 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	zc->length = length;
 	return ret;
 }
+
+/**
+ * tcp_zerocopy_recv - map receive queue pages into a tcp_mmap() area
+ * @sk: TCP socket
+ * @zc: zerocopy request, ->address and ->length describe the target range
+ * @nonblock: don't wait for data if the receive queue is empty
+ *
+ * In-kernel counterpart of getsockopt(TCP_ZEROCOPY_RECEIVE) for callers
+ * that already run in the context of the mm owning the mapping, such as
+ * io_uring. Straggler data that can't be mapped is not copied, it is
+ * reported through ->recv_skip_hint instead.
+ */
+int tcp_zerocopy_recv(struct sock *sk, struct tcp_zerocopy_receive *zc,
+		      bool nonblock)
+{
+	struct scm_timestamping_internal tss;
+	int err;
+
+	zc->copybuf_address = 0;
+	zc->copybuf_len = 0;
+
+	lock_sock(sk);
+	if (!nonblock && !tcp_inq(sk) && !sock_flag(sk, SOCK_DONE) &&
+	    !sk->sk_err) {
+		long timeo = sock_rcvtimeo(sk, false);
+
+		sk_wait_data(sk, &timeo, NULL);
+		if (signal_pending(current)) {
+			release_sock(sk);
+			return sock_intr_errno(timeo);
+		}
+	}
+	err = tcp_zerocopy_receive(sk, zc, &tss);
+	if (!err)
+		zc->err = sock_error(sk);
+	release_sock(sk);
+	return err;
+}
+EXPORT_SYMBOL_GPL(tcp_zerocopy_recv);
 #endif
 
 /* Similar to __sock_recv_timestamp, but does not require an skb */
@@ -2422,7 +2422,15 @@ static void *listening_get_idx(struct seq_file *seq, loff_t *pos)
 static inline bool empty_bucket(struct inet_hashinfo *hinfo,
 				const struct tcp_iter_state *st)
 {
-	return hlist_nulls_empty(&hinfo->ehash[st->bucket].chain);
+	struct hlist_nulls_head *chain;
+	bool empty;
+
+	rcu_read_lock();
+	chain = inet_ehash_chain(hinfo, st->bucket);
+	empty = !chain || hlist_nulls_empty(chain);
+	rcu_read_unlock();
+
+	return empty;
 }
 
 /*
@@ -2435,9 +2443,10 @@ static void *established_get_first(struct seq_file *seq)
 	struct tcp_iter_state *st = seq->private;
 
 	st->offset = 0;
-	for (; st->bucket <= hinfo->ehash_mask; ++st->bucket) {
+	for (; st->bucket <= READ_ONCE(hinfo->ehash_mask); ++st->bucket) {
 		struct sock *sk;
 		struct hlist_nulls_node *node;
+		struct hlist_nulls_head *chain;
 		spinlock_t *lock = inet_ehash_lockp(hinfo, st->bucket);
 
 		/* Lockless fast path for the common case of empty buckets */
@@ -2445,9 +2454,12 @@ static void *established_get_first(struct seq_file *seq)
 			continue;
 
 		spin_lock_bh(lock);
-		sk_nulls_for_each(sk, node, &hinfo->ehash[st->bucket].chain) {
-			if (seq_sk_match(seq, sk))
-				return sk;
+		chain = inet_ehash_chain(hinfo, st->bucket);
+		if (chain) {
+			sk_nulls_for_each(sk, node, chain) {
+				if (seq_sk_match(seq, sk))
+					return sk;
+			}
 		}
 		spin_unlock_bh(lock);
 	}
@@ -2530,7 +2542,7 @@ static void *tcp_seek_last_pos(struct seq_file *seq)
 		st->state = TCP_SEQ_STATE_ESTABLISHED;
 		fallthrough;
 	case TCP_SEQ_STATE_ESTABLISHED:
-		if (st->bucket > hinfo->ehash_mask)
+		if (st->bucket > READ_ONCE(hinfo->ehash_mask))
 			break;
 		rc = established_get_first(seq);
 		while (offset-- && rc && bucket == st->bucket)
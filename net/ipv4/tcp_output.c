@@ -1117,15 +1117,110 @@ void tcp_release_cb(struct sock *sk)
 }
 EXPORT_SYMBOL(tcp_release_cb);
 
+/* Internal pacing of many flows would arm one hrtimer per socket. Instead,
+ * sockets due within the wheel horizon are hashed by due time into slots of
+ * a per-CPU wheel, and a single hrtimer per CPU kicks all the sockets of the
+ * slots that expired. Sockets due later, i.e. slow flows, keep their own
+ * hrtimer. Send times are rounded up to the slot granularity, so gaps
+ * shorter than TCP_PACING_WHEEL_MIN_GAP slots also keep their own hrtimer:
+ * for those the rounding would be a sizeable fraction of the gap and
+ * throttle fast flows. Above it, tcp_update_skb_after_send() absorbs the
+ * lateness as credit.
+ */
+#define TCP_PACING_WHEEL_SHIFT	12	/* ~4 usec per slot */
+#define TCP_PACING_WHEEL_SLOTS	1024	/* ~4 msec horizon */
+#define TCP_PACING_WHEEL_MIN_GAP	8	/* ~32 usec */
+#define TCP_PACING_WHEEL_MASK	(TCP_PACING_WHEEL_SLOTS - 1)
+
+struct tcp_pacing_wheel {
+	spinlock_t		lock;
+	struct hrtimer		timer;
+	u64			clk;	/* next slot to expire, in slot units */
+	u64			next;	/* slot the timer is armed for */
+	DECLARE_BITMAP(busy, TCP_PACING_WHEEL_SLOTS);
+	struct list_head	slots[TCP_PACING_WHEEL_SLOTS];
+};
+static DEFINE_PER_CPU(struct tcp_pacing_wheel, tcp_pacing_wheel);
+
+/* Called with wheel->lock held */
+static void tcp_pacing_wheel_arm(struct tcp_pacing_wheel *wheel)
+{
+	unsigned int first = wheel->clk & TCP_PACING_WHEEL_MASK;
+	unsigned int slot;
+
+	wheel->next = U64_MAX;
+	if (bitmap_empty(wheel->busy, TCP_PACING_WHEEL_SLOTS))
+		return;
+
+	slot = find_next_bit(wheel->busy, TCP_PACING_WHEEL_SLOTS, first);
+	if (slot >= TCP_PACING_WHEEL_SLOTS)
+		slot = find_first_bit(wheel->busy, TCP_PACING_WHEEL_SLOTS);
+
+	wheel->next = wheel->clk + ((slot - first) & TCP_PACING_WHEEL_MASK);
+	hrtimer_start(&wheel->timer,
+		      ns_to_ktime(wheel->next << TCP_PACING_WHEEL_SHIFT),
+		      HRTIMER_MODE_ABS_PINNED_SOFT);
+}
+
+static enum hrtimer_restart tcp_pacing_wheel_fire(struct hrtimer *timer)
+{
+	struct tcp_pacing_wheel *wheel = container_of(timer,
+						      struct tcp_pacing_wheel,
+						      timer);
+	u64 now = tcp_clock_ns() >> TCP_PACING_WHEEL_SHIFT;
+	struct tcp_sock *tp, *tmp;
+	LIST_HEAD(list);
+
+	spin_lock(&wheel->lock);
+	while (wheel->clk <= now) {
+		unsigned int slot = wheel->clk & TCP_PACING_WHEEL_MASK;
+
+		if (__test_and_clear_bit(slot, wheel->busy)) {
+			list_for_each_entry(tp, &wheel->slots[slot], pacing_node)
+				tp->pacing_cpu = -1;
+			list_splice_tail_init(&wheel->slots[slot], &list);
+		}
+		wheel->clk++;
+		if (bitmap_empty(wheel->busy, TCP_PACING_WHEEL_SLOTS)) {
+			wheel->clk = now + 1;
+			break;
+		}
+	}
+	tcp_pacing_wheel_arm(wheel);
+	spin_unlock(&wheel->lock);
+
+	list_for_each_entry_safe(tp, tmp, &list, pacing_node) {
+		struct sock *sk = (struct sock *)tp;
+
+		list_del_init(&tp->pacing_node);
+		smp_mb__before_atomic();
+		clear_bit(TCP_PACING_QUEUED, &sk->sk_tsq_flags);
+
+		tcp_tsq_handler(sk);
+		sock_put(sk);
+	}
+	return HRTIMER_NORESTART;
+}
+
 void __init tcp_tasklet_init(void)
 {
 	int i;
 
 	for_each_possible_cpu(i) {
 		struct tsq_tasklet *tsq = &per_cpu(tsq_tasklet, i);
+		struct tcp_pacing_wheel *wheel = &per_cpu(tcp_pacing_wheel, i);
+		int j;
 
 		INIT_LIST_HEAD(&tsq->head);
 		tasklet_setup(&tsq->tasklet, tcp_tasklet_func);
+
+		spin_lock_init(&wheel->lock);
+		hrtimer_init(&wheel->timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_ABS_PINNED_SOFT);
+		wheel->timer.function = tcp_pacing_wheel_fire;
+		wheel->next = U64_MAX;
+		for (j = 0; j < TCP_PACING_WHEEL_SLOTS; j++)
+			INIT_LIST_HEAD(&wheel->slots[j]);
 	}
 }
 
@@ -1192,6 +1287,71 @@ enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+/* Returns false if @sk is due too soon or beyond the horizon of the wheel */
+static bool tcp_pacing_wheel_add(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct tcp_pacing_wheel *wheel;
+	unsigned int slot;
+	bool ret = false;
+	u64 due;
+
+	if (tp->tcp_wstamp_ns - tp->tcp_clock_cache <
+	    (TCP_PACING_WHEEL_MIN_GAP << TCP_PACING_WHEEL_SHIFT))
+		return false;
+
+	due = DIV_ROUND_UP_ULL(tp->tcp_wstamp_ns, 1 << TCP_PACING_WHEEL_SHIFT);
+
+	local_bh_disable();
+	wheel = this_cpu_ptr(&tcp_pacing_wheel);
+	spin_lock(&wheel->lock);
+	if (bitmap_empty(wheel->busy, TCP_PACING_WHEEL_SLOTS))
+		wheel->clk = max(wheel->clk,
+				 tp->tcp_clock_cache >> TCP_PACING_WHEEL_SHIFT);
+	due = max(due, wheel->clk);
+	if (due - wheel->clk >= TCP_PACING_WHEEL_SLOTS)
+		goto unlock;
+
+	slot = due & TCP_PACING_WHEEL_MASK;
+	sock_hold(sk);
+	set_bit(TCP_PACING_QUEUED, &sk->sk_tsq_flags);
+	list_add_tail(&tp->pacing_node, &wheel->slots[slot]);
+	WRITE_ONCE(tp->pacing_cpu, smp_processor_id());
+	__set_bit(slot, wheel->busy);
+	if (due < wheel->next) {
+		wheel->next = due;
+		hrtimer_start(&wheel->timer,
+			      ns_to_ktime(due << TCP_PACING_WHEEL_SHIFT),
+			      HRTIMER_MODE_ABS_PINNED_SOFT);
+	}
+	ret = true;
+unlock:
+	spin_unlock(&wheel->lock);
+	local_bh_enable();
+	return ret;
+}
+
+void tcp_pacing_wheel_cancel(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct tcp_pacing_wheel *wheel;
+	int cpu = READ_ONCE(tp->pacing_cpu);
+
+	/* Not queued, or being kicked right now */
+	if (cpu < 0)
+		return;
+
+	wheel = per_cpu_ptr(&tcp_pacing_wheel, cpu);
+	spin_lock_bh(&wheel->lock);
+	if (tp->pacing_cpu == cpu) {
+		list_del_init(&tp->pacing_node);
+		tp->pacing_cpu = -1;
+		clear_bit(TCP_PACING_QUEUED, &sk->sk_tsq_flags);
+		__sock_put(sk);
+	}
+	spin_unlock_bh(&wheel->lock);
+}
+
 static void tcp_update_skb_after_send(struct sock *sk, struct sk_buff *skb,
 				      u64 prior_wstamp)
 {
@@ -2476,7 +2636,11 @@ static bool tcp_pacing_check(struct sock *sk)
 	if (tp->tcp_wstamp_ns <= tp->tcp_clock_cache)
 		return false;
 
-	if (!hrtimer_is_queued(&tp->pacing_timer)) {
+	if (test_bit(TCP_PACING_QUEUED, &sk->sk_tsq_flags) ||
+	    hrtimer_is_queued(&tp->pacing_timer))
+		return true;
+
+	if (!tcp_pacing_wheel_add(sk)) {
 		hrtimer_start(&tp->pacing_timer,
 			      ns_to_ktime(tp->tcp_wstamp_ns),
 			      HRTIMER_MODE_ABS_PINNED_SOFT);
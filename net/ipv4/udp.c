@@ -1506,36 +1506,14 @@ static void udp_skb_dtor_locked(struct sock *sk, struct sk_buff *skb)
 	udp_rmem_release(sk, udp_skb_truesize(skb), 1, true);
 }
 
-/* Idea of busylocks is to let producers grab an extra spinlock
- * to relieve pressure on the receive_queue spinlock shared by consumer.
- * Under flood, this means that only one producer can be in line
- * trying to acquire the receive_queue spinlock.
- * These busylock can be allocated on a per cpu manner, instead of a
- * per socket one (that would consume a cache line per socket)
- */
-static int udp_busylocks_log __read_mostly;
-static spinlock_t *udp_busylocks __read_mostly;
-
-static spinlock_t *busylock_acquire(void *ptr)
-{
-	spinlock_t *busy;
-
-	busy = udp_busylocks + hash_ptr(ptr, udp_busylocks_log);
-	spin_lock(busy);
-	return busy;
-}
-
-static void busylock_release(spinlock_t *busy)
-{
-	if (busy)
-		spin_unlock(busy);
-}
-
 int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct sk_buff_head *list = &sk->sk_receive_queue;
+	struct udp_sock *up = udp_sk(sk);
+	struct sk_buff *next, *to_drop = NULL;
+	struct llist_node *ll_list;
 	int rmem, delta, amt, err = -ENOMEM;
-	spinlock_t *busy = NULL;
+	bool queued = false;
 	int size;
 
 	/* try to avoid the costly atomic add/sub pair when the receive
@@ -1551,11 +1529,8 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	 * - Less cache line misses at copyout() time
 	 * - Less work at consume_skb() (less alien page frag freeing)
 	 */
-	if (rmem > (sk->sk_rcvbuf >> 1)) {
+	if (rmem > (sk->sk_rcvbuf >> 1))
 		skb_condense(skb);
-
-		busy = busylock_acquire(sk);
-	}
 	size = skb->truesize;
 	udp_set_dev_scratch(skb);
 
@@ -1566,33 +1541,58 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	if (rmem > (size + (unsigned int)sk->sk_rcvbuf))
 		goto uncharge_drop;
 
-	spin_lock(&list->lock);
-	if (size >= sk->sk_forward_alloc) {
-		amt = sk_mem_pages(size);
-		delta = amt << PAGE_SHIFT;
-		if (!__sk_mem_raise_allocated(sk, delta, amt, SK_MEM_RECV)) {
-			err = -ENOBUFS;
-			spin_unlock(&list->lock);
-			goto uncharge_drop;
-		}
-
-		sk->sk_forward_alloc += delta;
-	}
-
-	sk->sk_forward_alloc -= size;
-
 	/* no need to setup a destructor, we will explicitly release the
 	 * forward allocated memory on dequeue
 	 */
 	sock_skb_set_dropcount(sk, skb);
 
-	__skb_queue_tail(list, skb);
+	/* Producers from many RX queues only meet on the lockless prod_queue.
+	 * The one finding it empty takes the receive queue lock and moves
+	 * everything queued meanwhile, so under flood the lock is taken once
+	 * per batch rather than once per packet, and other producers never
+	 * wait for it.
+	 */
+	if (!llist_add(&skb->ll_node, &up->prod_queue))
+		return 0;
+
+	spin_lock(&list->lock);
+	ll_list = llist_reverse_order(llist_del_all(&up->prod_queue));
+	llist_for_each_entry_safe(skb, next, ll_list, ll_node) {
+		size = skb->truesize;
+		if (size >= sk->sk_forward_alloc) {
+			amt = sk_mem_pages(size);
+			delta = amt << PAGE_SHIFT;
+			if (!__sk_mem_raise_allocated(sk, delta, amt,
+						      SK_MEM_RECV)) {
+				skb->next = to_drop;
+				to_drop = skb;
+				continue;
+			}
+
+			sk->sk_forward_alloc += delta;
+		}
+
+		sk->sk_forward_alloc -= size;
+		__skb_queue_tail(list, skb);
+		queued = true;
+	}
 	spin_unlock(&list->lock);
 
-	if (!sock_flag(sk, SOCK_DEAD))
+	if (queued && !sock_flag(sk, SOCK_DEAD))
 		sk->sk_data_ready(sk);
 
-	busylock_release(busy);
+	/* the packets may come from other producers, account them here */
+	while (to_drop) {
+		skb = to_drop;
+		to_drop = skb->next;
+		skb_mark_not_on_list(skb);
+
+		atomic_sub(skb->truesize, &sk->sk_rmem_alloc);
+		atomic_inc(&sk->sk_drops);
+		__UDPX_INC_STATS(sk, UDP_MIB_MEMERRORS);
+		__UDPX_INC_STATS(sk, UDP_MIB_INERRORS);
+		kfree_skb_reason(skb, SKB_DROP_REASON_PROTO_MEM);
+	}
 	return 0;
 
 uncharge_drop:
@@ -1600,7 +1600,6 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 
 drop:
 	atomic_inc(&sk->sk_drops);
-	busylock_release(busy);
 	return err;
 }
 EXPORT_SYMBOL_GPL(__udp_enqueue_schedule_skb);
@@ -3468,7 +3467,6 @@ static void __init bpf_iter_register(void)
 void __init udp_init(void)
 {
 	unsigned long limit;
-	unsigned int i;
 
 	udp_table_init(&udp_table, "UDP");
 	limit = nr_free_buffer_pages() / 8;
@@ -3477,15 +3475,6 @@ void __init udp_init(void)
 	sysctl_udp_mem[1] = limit;
 	sysctl_udp_mem[2] = sysctl_udp_mem[0] * 2;
 
-	/* 16 spinlocks per cpu */
-	udp_busylocks_log = ilog2(nr_cpu_ids) + 4;
-	udp_busylocks = kmalloc(sizeof(spinlock_t) << udp_busylocks_log,
-				GFP_KERNEL);
-	if (!udp_busylocks)
-		panic("UDP: failed to alloc udp_busylocks\n");
-	for (i = 0; i < (1U << udp_busylocks_log); i++)
-		spin_lock_init(udp_busylocks + i);
-
 	if (register_pernet_subsys(&udp_sysctl_ops))
 		panic("UDP: failed to init sysctl parameters.\n");
 
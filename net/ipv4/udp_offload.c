@@ -454,8 +454,8 @@ static int skb_gro_receive_list(struct sk_buff *p, struct sk_buff *skb)
 
 
 #define UDP_GRO_CNT_MAX 64
-static struct sk_buff *udp_gro_receive_segment(struct list_head *head,
-					       struct sk_buff *skb)
+struct sk_buff *udp_gro_receive_segment(struct list_head *head,
+					struct sk_buff *skb)
 {
 	struct udphdr *uh = udp_gro_udphdr(skb);
 	struct sk_buff *pp = NULL;
@@ -534,6 +534,36 @@ static struct sk_buff *udp_gro_receive_segment(struct list_head *head,
 	/* mismatch, but we never need to flush */
 	return NULL;
 }
+EXPORT_SYMBOL(udp_gro_receive_segment);
+
+/* Does @skb belong to a flow already being aggregated by
+ * udp_gro_receive_segment() ? The addresses were matched by the network
+ * layer, so the socket lookup would only find the same socket again and
+ * the caller can skip it. Under a flood of small datagrams, e.g. QUIC,
+ * that saves one lookup per packet but the first of each GRO batch.
+ */
+bool udp_gro_flow_held(struct list_head *head, struct sk_buff *skb,
+		       struct udphdr *uh)
+{
+	struct sk_buff *p;
+
+	/* the outer header of a tunnel, or an inner one, needs the socket */
+	if (NAPI_GRO_CB(skb)->encap_mark)
+		return false;
+
+	list_for_each_entry(p, head, list) {
+		if (!NAPI_GRO_CB(p)->same_flow || NAPI_GRO_CB(p)->encap_mark)
+			continue;
+
+		if (*(u32 *)&uh->source != *(u32 *)&udp_hdr(p)->source)
+			continue;
+
+		NAPI_GRO_CB(skb)->is_flist = NAPI_GRO_CB(p)->is_flist;
+		return true;
+	}
+	return false;
+}
+EXPORT_SYMBOL(udp_gro_flow_held);
 
 struct sk_buff *udp_gro_receive(struct list_head *head, struct sk_buff *skb,
 				struct udphdr *uh, struct sock *sk)
@@ -631,8 +661,13 @@ struct sk_buff *udp4_gro_receive(struct list_head *head, struct sk_buff *skb)
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
 
-	if (static_branch_unlikely(&udp_encap_needed_key))
+	if (static_branch_unlikely(&udp_encap_needed_key)) {
+		if (udp_gro_flow_held(head, skb, uh))
+			return call_gro_receive(udp_gro_receive_segment,
+						head, skb);
+
 		sk = udp4_gro_lookup_skb(skb, uh->source, uh->dest);
+	}
 
 	pp = udp_gro_receive(head, skb, uh, sk);
 	return pp;
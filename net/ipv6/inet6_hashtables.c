@@ -61,10 +61,12 @@ struct sock *__inet6_lookup_established(struct net *net,
 	 * have wildcards anyways.
 	 */
 	unsigned int hash = inet6_ehashfn(net, daddr, hnum, saddr, sport);
-	unsigned int slot = hash & hashinfo->ehash_mask;
-	struct inet_ehash_bucket *head = &hashinfo->ehash[slot];
-
+	struct inet_ehash_bucket *head;
+	unsigned int slot, seq;
 
+again:
+	seq = read_seqcount_begin(&hashinfo->ehash_seq);
+	head = __inet_ehash_bucket(hashinfo, hash, &slot);
 begin:
 	sk_nulls_for_each_rcu(sk, node, &head->chain) {
 		if (sk->sk_hash != hash)
@@ -82,6 +84,8 @@ struct sock *__inet6_lookup_established(struct net *net,
 	}
 	if (get_nulls_value(node) != slot)
 		goto begin;
+	if (read_seqcount_retry(&hashinfo->ehash_seq, seq))
+		goto again;
 out:
 	sk = NULL;
 found:
@@ -254,13 +258,14 @@ static int __inet6_check_established(struct inet_timewait_death_row *death_row,
 	const __portpair ports = INET_COMBINED_PORTS(inet->inet_dport, lport);
 	const unsigned int hash = inet6_ehashfn(net, daddr, lport, saddr,
 						inet->inet_dport);
-	struct inet_ehash_bucket *head = inet_ehash_bucket(hinfo, hash);
 	spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
+	struct inet_ehash_bucket *head;
 	struct sock *sk2;
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 
 	spin_lock(lock);
+	head = inet_ehash_bucket(hinfo, hash);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
 		if (sk2->sk_hash != hash)
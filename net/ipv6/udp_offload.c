@@ -148,8 +148,13 @@ struct sk_buff *udp6_gro_receive(struct list_head *head, struct sk_buff *skb)
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 1;
 
-	if (static_branch_unlikely(&udpv6_encap_needed_key))
+	if (static_branch_unlikely(&udpv6_encap_needed_key)) {
+		if (udp_gro_flow_held(head, skb, uh))
+			return call_gro_receive(udp_gro_receive_segment,
+						head, skb);
+
 		sk = udp6_gro_lookup_skb(skb, uh->source, uh->dest);
+	}
 
 	pp = udp_gro_receive(head, skb, uh, sk);
 	return pp;
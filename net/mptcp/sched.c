@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Packet scheduler registration and dispatch.
+ */
+
+#define pr_fmt(fmt) "MPTCP: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/bpf.h>
+#include "protocol.h"
+
+static DEFINE_SPINLOCK(mptcp_sched_list_lock);
+static LIST_HEAD(mptcp_sched_list);
+
+/* The built-in scheduler has no get_subflow(): the core falls back to
+ * mptcp_subflow_get_send() and mptcp_subflow_get_retrans(), which keep
+ * their own burst and timeout state.
+ */
+static struct mptcp_sched_ops mptcp_sched_default = {
+	.name	= "default",
+	.owner	= THIS_MODULE,
+};
+
+/* Must be called with rcu read lock held */
+struct mptcp_sched_ops *mptcp_sched_find(const char *name)
+{
+	struct mptcp_sched_ops *sched;
+
+	list_for_each_entry_rcu(sched, &mptcp_sched_list, list) {
+		if (!strcmp(sched->name, name))
+			return sched;
+	}
+
+	return NULL;
+}
+
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched)
+{
+	int ret = 0;
+
+	if (!sched->get_subflow) {
+		pr_err("%s does not implement required ops\n", sched->name);
+		return -EINVAL;
+	}
+
+	spin_lock(&mptcp_sched_list_lock);
+	if (mptcp_sched_find(sched->name)) {
+		pr_notice("%s already registered\n", sched->name);
+		ret = -EEXIST;
+	} else {
+		list_add_tail_rcu(&sched->list, &mptcp_sched_list);
+		pr_debug("%s registered", sched->name);
+	}
+	spin_unlock(&mptcp_sched_list_lock);
+
+	return ret;
+}
+
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
+{
+	if (sched == &mptcp_sched_default)
+		return;
+
+	spin_lock(&mptcp_sched_list_lock);
+	list_del_rcu(&sched->list);
+	spin_unlock(&mptcp_sched_list_lock);
+
+	/* Wait for outstanding readers to complete before the
+	 * scheduler gets removed entirely.
+	 */
+	synchronize_rcu();
+}
+
+void __init mptcp_sched_init(void)
+{
+	list_add_rcu(&mptcp_sched_default.list, &mptcp_sched_list);
+}
+
+int mptcp_init_sched(struct mptcp_sock *msk, struct mptcp_sched_ops *sched)
+{
+	if (!sched)
+		sched = &mptcp_sched_default;
+
+	if (!bpf_try_module_get(sched, sched->owner))
+		return -EBUSY;
+
+	msk->sched = sched;
+	if (sched->init)
+		sched->init(msk);
+
+	pr_debug("msk=%p sched=%s", msk, sched->name);
+	return 0;
+}
+
+void mptcp_release_sched(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	if (!sched)
+		return;
+
+	msk->sched = NULL;
+	if (sched->release)
+		sched->release(msk);
+
+	bpf_module_put(sched, sched->owner);
+}
+
+/* called with msk socket lock held */
+int mptcp_sched_set(struct mptcp_sock *msk, const char *name)
+{
+	struct mptcp_sched_ops *sched;
+	int ret = 0;
+
+	sock_owned_by_me((struct sock *)msk);
+
+	rcu_read_lock();
+	sched = mptcp_sched_find(name);
+	if (!sched) {
+		ret = -ENOENT;
+	} else if (sched != msk->sched) {
+		mptcp_release_sched(msk);
+		if (mptcp_init_sched(msk, sched)) {
+			mptcp_init_sched(msk, NULL);
+			ret = -EBUSY;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static void mptcp_sched_data_init(struct mptcp_sock *msk, bool reinject,
+				  struct mptcp_sched_data *data)
+{
+	struct mptcp_subflow_context *subflow;
+	int i = 0;
+
+	data->reinject = reinject;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		if (i == MPTCP_SUBFLOWS_MAX) {
+			pr_warn_once("too many subflows");
+			break;
+		}
+		data->contexts[i++] = subflow;
+	}
+	data->subflows = i;
+
+	for (; i < MPTCP_SUBFLOWS_MAX; i++)
+		data->contexts[i] = NULL;
+}
+
+static struct mptcp_subflow_context *
+mptcp_sched_get_subflow(struct mptcp_sock *msk, bool reinject)
+{
+	struct mptcp_sched_data data;
+	int idx;
+
+	mptcp_sched_data_init(msk, reinject, &data);
+	idx = msk->sched->get_subflow(msk, &data);
+	if (idx < 0 || idx >= data.subflows)
+		return NULL;
+
+	return data.contexts[idx];
+}
+
+struct sock *mptcp_sched_get_send(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *ssk;
+
+	sock_owned_by_me((struct sock *)msk);
+
+	if (!msk->sched || !msk->sched->get_subflow ||
+	    __mptcp_check_fallback(msk))
+		return mptcp_subflow_get_send(msk);
+
+	subflow = mptcp_sched_get_subflow(msk, false);
+	if (!subflow || !mptcp_subflow_active(subflow))
+		return NULL;
+
+	ssk = mptcp_subflow_tcp_sock(subflow);
+	if (!sk_stream_memory_free(ssk))
+		return NULL;
+
+	mptcp_set_timeout((struct sock *)msk);
+	return ssk;
+}
+
+struct sock *mptcp_sched_get_retrans(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+
+	sock_owned_by_me((struct sock *)msk);
+
+	if (!msk->sched || !msk->sched->get_subflow ||
+	    __mptcp_check_fallback(msk))
+		return mptcp_subflow_get_retrans(msk);
+
+	subflow = mptcp_sched_get_subflow(msk, true);
+	if (!subflow || !__mptcp_subflow_active(subflow))
+		return NULL;
+
+	return mptcp_subflow_tcp_sock(subflow);
+}
@@ -1539,7 +1539,8 @@ static void gc_worker(struct work_struct *work)
 
 			net = nf_ct_net(tmp);
 			cnet = nf_ct_pernet(net);
-			if (atomic_read(&cnet->count) < nf_conntrack_max95)
+			if (percpu_counter_read_positive(&cnet->count) <
+			    nf_conntrack_max95)
 				continue;
 
 			/* need to take reference to avoid possible races */
@@ -1606,6 +1607,13 @@ static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work)
 	gc_work->exiting = false;
 }
 
+/* Batch of the per-netns conntrack count.  New conntracks are checked
+ * against nf_conntrack_max with the approximate count, without summing
+ * the per-CPU parts under the counter's lock, so the table can overshoot
+ * the limit by up to this many entries per CPU.  Keep it small.
+ */
+#define NF_CT_COUNT_BATCH	32
+
 static struct nf_conn *
 __nf_conntrack_alloc(struct net *net,
 		     const struct nf_conntrack_zone *zone,
@@ -1614,17 +1622,19 @@ __nf_conntrack_alloc(struct net *net,
 		     gfp_t gfp, u32 hash)
 {
 	struct nf_conntrack_net *cnet = nf_ct_pernet(net);
-	unsigned int ct_count;
 	struct nf_conn *ct;
 
 	/* We don't want any race condition at early drop stage */
-	ct_count = atomic_inc_return(&cnet->count);
+	percpu_counter_add_batch(&cnet->count, 1, NF_CT_COUNT_BATCH);
 
-	if (nf_conntrack_max && unlikely(ct_count > nf_conntrack_max)) {
+	if (nf_conntrack_max &&
+	    unlikely(percpu_counter_read_positive(&cnet->count) >
+		     nf_conntrack_max)) {
 		if (!early_drop(net, hash)) {
 			if (!conntrack_gc_work.early_drop)
 				conntrack_gc_work.early_drop = true;
-			atomic_dec(&cnet->count);
+			percpu_counter_add_batch(&cnet->count, -1,
+						 NF_CT_COUNT_BATCH);
 			net_warn_ratelimited("nf_conntrack: table full, dropping packet\n");
 			return ERR_PTR(-ENOMEM);
 		}
@@ -1657,7 +1667,7 @@ __nf_conntrack_alloc(struct net *net,
 	refcount_set(&ct->ct_general.use, 0);
 	return ct;
 out:
-	atomic_dec(&cnet->count);
+	percpu_counter_add_batch(&cnet->count, -1, NF_CT_COUNT_BATCH);
 	return ERR_PTR(-ENOMEM);
 }
 
@@ -1695,8 +1705,8 @@ void nf_conntrack_free(struct nf_conn *ct)
 	kmem_cache_free(nf_conntrack_cachep, ct);
 	cnet = nf_ct_pernet(net);
 
-	smp_mb__before_atomic();
-	atomic_dec(&cnet->count);
+	smp_wmb();
+	percpu_counter_add_batch(&cnet->count, -1, NF_CT_COUNT_BATCH);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_free);
 
@@ -2443,7 +2453,7 @@ void nf_ct_iterate_cleanup_net(int (*iter)(struct nf_conn *i, void *data),
 
 	might_sleep();
 
-	if (atomic_read(&cnet->count) == 0)
+	if (percpu_counter_sum(&cnet->count) == 0)
 		return;
 
 	nf_ct_iterate_cleanup(iter, iter_data);
@@ -2471,7 +2481,7 @@ nf_ct_iterate_destroy(int (*iter)(struct nf_conn *i, void *data), void *data)
 	for_each_net(net) {
 		struct nf_conntrack_net *cnet = nf_ct_pernet(net);
 
-		if (atomic_read(&cnet->count) == 0)
+		if (percpu_counter_sum(&cnet->count) == 0)
 			continue;
 		nf_queue_nf_hook_drop(net);
 	}
@@ -2560,7 +2570,7 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 
 		iter_data.net = net;
 		nf_ct_iterate_cleanup_net(kill_all, &iter_data);
-		if (atomic_read(&cnet->count) != 0)
+		if (percpu_counter_sum(&cnet->count) != 0)
 			busy = 1;
 	}
 	if (busy) {
@@ -2572,6 +2582,7 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 		nf_conntrack_ecache_pernet_fini(net);
 		nf_conntrack_expect_pernet_fini(net);
 		free_percpu(net->ct.stat);
+		percpu_counter_destroy(&nf_ct_pernet(net)->count);
 	}
 }
 
@@ -2785,11 +2796,14 @@ int nf_conntrack_init_net(struct net *net)
 
 	BUILD_BUG_ON(IP_CT_UNTRACKED == IP_CT_NUMBER);
 	BUILD_BUG_ON_NOT_POWER_OF_2(CONNTRACK_LOCKS);
-	atomic_set(&cnet->count, 0);
+	ret = percpu_counter_init(&cnet->count, 0, GFP_KERNEL);
+	if (ret < 0)
+		return ret;
 
+	ret = -ENOMEM;
 	net->ct.stat = alloc_percpu(struct ip_conntrack_stat);
 	if (!net->ct.stat)
-		return ret;
+		goto err_stat;
 
 	ret = nf_conntrack_expect_pernet_init(net);
 	if (ret < 0)
@@ -2804,6 +2818,8 @@ int nf_conntrack_init_net(struct net *net)
 
 err_expect:
 	free_percpu(net->ct.stat);
+err_stat:
+	percpu_counter_destroy(&cnet->count);
 	return ret;
 }
 
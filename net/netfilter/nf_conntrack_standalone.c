@@ -391,11 +391,20 @@ static const struct seq_operations ct_seq_ops = {
 	.show  = ct_seq_show
 };
 
+struct ct_cpu_iter_state {
+	struct seq_net_private p;
+	unsigned int count;
+};
+
 static void *ct_cpu_seq_start(struct seq_file *seq, loff_t *pos)
 {
+	struct ct_cpu_iter_state *st = seq->private;
 	struct net *net = seq_file_net(seq);
 	int cpu;
 
+	/* Summing the count is not cheap, do it once and not per CPU */
+	st->count = nf_conntrack_count(net);
+
 	if (*pos == 0)
 		return SEQ_START_TOKEN;
 
@@ -430,20 +439,17 @@ static void ct_cpu_seq_stop(struct seq_file *seq, void *v)
 
 static int ct_cpu_seq_show(struct seq_file *seq, void *v)
 {
-	struct net *net = seq_file_net(seq);
+	struct ct_cpu_iter_state *iter = seq->private;
 	const struct ip_conntrack_stat *st = v;
-	unsigned int nr_conntracks;
 
 	if (v == SEQ_START_TOKEN) {
 		seq_puts(seq, "entries  clashres found new invalid ignore delete chainlength insert insert_failed drop early_drop icmp_error  expect_new expect_create expect_delete search_restart\n");
 		return 0;
 	}
 
-	nr_conntracks = nf_conntrack_count(net);
-
 	seq_printf(seq, "%08x  %08x %08x %08x %08x %08x %08x %08x "
 			"%08x %08x %08x %08x %08x  %08x %08x %08x %08x\n",
-		   nr_conntracks,
+		   iter->count,
 		   st->clash_resolve,
 		   st->found,
 		   0,
@@ -489,7 +495,7 @@ static int nf_conntrack_standalone_init_proc(struct net *net)
 		proc_set_user(pde, root_uid, root_gid);
 
 	pde = proc_create_net("nf_conntrack", 0444, net->proc_net_stat,
-			&ct_cpu_seq_ops, sizeof(struct seq_net_private));
+			&ct_cpu_seq_ops, sizeof(struct ct_cpu_iter_state));
 	if (!pde)
 		goto out_stat_nf_conntrack;
 	return 0;
@@ -518,9 +524,9 @@ static void nf_conntrack_standalone_fini_proc(struct net *net)
 
 u32 nf_conntrack_count(const struct net *net)
 {
-	const struct nf_conntrack_net *cnet = nf_ct_pernet(net);
+	struct nf_conntrack_net *cnet = nf_ct_pernet(net);
 
-	return atomic_read(&cnet->count);
+	return percpu_counter_sum_positive(&cnet->count);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_count);
 
@@ -551,6 +557,19 @@ nf_conntrack_hash_sysctl(struct ctl_table *table, int write,
 	return ret;
 }
 
+static int
+nf_conntrack_count_sysctl(struct ctl_table *table, int write,
+			  void *buffer, size_t *lenp, loff_t *ppos)
+{
+	struct ctl_table tmp = *table;
+	int count;
+
+	count = nf_conntrack_count(table->data);
+	tmp.data = &count;
+
+	return proc_dointvec(&tmp, write, buffer, lenp, ppos);
+}
+
 static struct ctl_table_header *nf_ct_netfilter_header;
 
 enum nf_ct_sysctl_index {
@@ -639,7 +658,7 @@ static struct ctl_table nf_ct_sysctl_table[] = {
 		.procname	= "nf_conntrack_count",
 		.maxlen		= sizeof(int),
 		.mode		= 0444,
-		.proc_handler	= proc_dointvec,
+		.proc_handler	= nf_conntrack_count_sysctl,
 	},
 	[NF_SYSCTL_CT_BUCKETS] = {
 		.procname       = "nf_conntrack_buckets",
@@ -1095,7 +1114,7 @@ static int nf_conntrack_standalone_init_sysctl(struct net *net)
 	if (!table)
 		return -ENOMEM;
 
-	table[NF_SYSCTL_CT_COUNT].data = &cnet->count;
+	table[NF_SYSCTL_CT_COUNT].data = net;
 	table[NF_SYSCTL_CT_CHECKSUM].data = &net->ct.sysctl_checksum;
 	table[NF_SYSCTL_CT_LOG_INVALID].data = &net->ct.sysctl_log_invalid;
 	table[NF_SYSCTL_CT_ACCT].data = &net->ct.sysctl_acct;
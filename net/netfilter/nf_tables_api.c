@@ -8661,7 +8661,7 @@ static bool nft_expr_reduce(struct nft_regs_track *track,
 
 static int nf_tables_commit_chain_prepare(struct net *net, struct nft_chain *chain)
 {
-	const struct nft_expr *expr, *last;
+	const struct nft_expr *expr, *last, *next;
 	struct nft_regs_track track = {};
 	unsigned int size, data_size;
 	void *data, *data_boundary;
@@ -8712,6 +8712,13 @@ static int nf_tables_commit_chain_prepare(struct net *net, struct nft_chain *cha
 			if (WARN_ON_ONCE(data + expr->ops->size > data_boundary))
 				return -ENOMEM;
 
+			next = nft_expr_next(expr);
+			if (next != last && nft_expr_fuse(data + size, expr, next)) {
+				size += nft_payload_cmp_fast_ops.size;
+				expr = next;
+				continue;
+			}
+
 			memcpy(data + size, expr, expr->ops->size);
 			size += expr->ops->size;
 		}
@@ -1435,6 +1435,30 @@ static unsigned int fanout_demux_qm(struct packet_fanout *f,
 	return skb_get_queue_mapping(skb) % num;
 }
 
+/* PACKET_FANOUT_QM groups keep a second table after arr[], indexed by the
+ * RX queue the members bound themselves to with PACKET_RX_QUEUE.
+ */
+static struct sock __rcu **fanout_queue_arr(struct packet_fanout *f)
+{
+	return f->arr + f->max_num_members;
+}
+
+/* Member bound to the RX queue of skb, or NULL to fall back to the modulo */
+static struct sock *fanout_demux_rx_queue(struct packet_fanout *f,
+					  struct sk_buff *skb)
+{
+	u16 queue;
+
+	if (skb->pkt_type == PACKET_OUTGOING || !skb_rx_queue_recorded(skb))
+		return NULL;
+
+	queue = skb_get_rx_queue(skb);
+	if (queue >= f->max_num_members)
+		return NULL;
+
+	return rcu_dereference(fanout_queue_arr(f)[queue]);
+}
+
 static unsigned int fanout_demux_bpf(struct packet_fanout *f,
 				     struct sk_buff *skb,
 				     unsigned int num)
@@ -1463,6 +1487,7 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 	unsigned int num = READ_ONCE(f->num_members);
 	struct net *net = read_pnet(&f->net);
 	struct packet_sock *po;
+	struct sock *sk;
 	unsigned int idx;
 
 	if (!net_eq(dev_net(dev), net) || !num) {
@@ -1490,6 +1515,11 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 		idx = fanout_demux_rnd(f, skb, num);
 		break;
 	case PACKET_FANOUT_QM:
+		sk = fanout_demux_rx_queue(f, skb);
+		if (sk) {
+			po = pkt_sk(sk);
+			goto deliver;
+		}
 		idx = fanout_demux_qm(f, skb, num);
 		break;
 	case PACKET_FANOUT_ROLLOVER:
@@ -1505,6 +1535,7 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 		idx = fanout_demux_rollover(f, skb, idx, true, num);
 
 	po = pkt_sk(rcu_dereference(f->arr[idx]));
+deliver:
 	return po->prot_hook.func(skb, dev, &po->prot_hook, orig_dev);
 }
 
@@ -1519,6 +1550,8 @@ static void __fanout_link(struct sock *sk, struct packet_sock *po)
 
 	spin_lock(&f->lock);
 	rcu_assign_pointer(f->arr[f->num_members], sk);
+	if (po->rx_queue >= 0)
+		rcu_assign_pointer(fanout_queue_arr(f)[po->rx_queue], sk);
 	smp_wmb();
 	f->num_members++;
 	if (f->num_members == 1)
@@ -1538,6 +1571,8 @@ static void __fanout_unlink(struct sock *sk, struct packet_sock *po)
 			break;
 	}
 	BUG_ON(i >= f->num_members);
+	if (po->rx_queue >= 0)
+		RCU_INIT_POINTER(fanout_queue_arr(f)[po->rx_queue], NULL);
 	rcu_assign_pointer(f->arr[i],
 			   rcu_dereference_protected(f->arr[f->num_members - 1],
 						     lockdep_is_held(&f->lock)));
@@ -1547,6 +1582,19 @@ static void __fanout_unlink(struct sock *sk, struct packet_sock *po)
 	spin_unlock(&f->lock);
 }
 
+/* RX queue binding only means something to QM groups, one socket a queue */
+static int fanout_check_rx_queue(struct packet_fanout *f,
+				 struct packet_sock *po)
+{
+	if (po->rx_queue < 0)
+		return 0;
+	if (f->type != PACKET_FANOUT_QM || po->rx_queue >= f->max_num_members)
+		return -EINVAL;
+	if (rcu_access_pointer(fanout_queue_arr(f)[po->rx_queue]))
+		return -EBUSY;
+	return 0;
+}
+
 static bool match_fanout_group(struct packet_type *ptype, struct sock *sk)
 {
 	if (sk->sk_family != PF_PACKET)
@@ -1758,7 +1806,10 @@ static int fanout_add(struct sock *sk, struct fanout_args *args)
 			/* legacy PACKET_FANOUT_MAX */
 			args->max_num_members = 256;
 		err = -ENOMEM;
-		match = kvzalloc(struct_size(match, arr, args->max_num_members),
+		match = kvzalloc(struct_size(match, arr,
+					     type == PACKET_FANOUT_QM ?
+					     2 * args->max_num_members :
+					     args->max_num_members),
 				 GFP_KERNEL);
 		if (!match)
 			goto out;
@@ -1787,8 +1838,11 @@ static int fanout_add(struct sock *sk, struct fanout_args *args)
 	    match->type == type &&
 	    match->prot_hook.type == po->prot_hook.type &&
 	    match->prot_hook.dev == po->prot_hook.dev) {
-		err = -ENOSPC;
-		if (refcount_read(&match->sk_ref) < match->max_num_members) {
+		err = fanout_check_rx_queue(match, po);
+		if (!err &&
+		    refcount_read(&match->sk_ref) >= match->max_num_members)
+			err = -ENOSPC;
+		if (!err) {
 			__dev_remove_pack(&po->prot_hook);
 
 			/* Paired with packet_setsockopt(PACKET_FANOUT_DATA) */
@@ -1798,7 +1852,6 @@ static int fanout_add(struct sock *sk, struct fanout_args *args)
 			rollover = NULL;
 			refcount_set(&match->sk_ref, refcount_read(&match->sk_ref) + 1);
 			__fanout_link(sk, po);
-			err = 0;
 		}
 	}
 	spin_unlock(&po->bind_lock);
@@ -3353,6 +3406,7 @@ static int packet_create(struct net *net, struct socket *sock, int protocol,
 	init_completion(&po->skb_completion);
 	sk->sk_family = PF_PACKET;
 	po->num = proto;
+	po->rx_queue = -1;
 	po->xmit = dev_queue_xmit;
 
 	err = packet_alloc_pending(po);
@@ -4010,6 +4064,28 @@ packet_setsockopt(struct socket *sock, int level, int optname, sockptr_t optval,
 		po->xmit = val ? packet_direct_xmit : dev_queue_xmit;
 		return 0;
 	}
+	case PACKET_RX_QUEUE:
+	{
+		int val;
+
+		if (optlen != sizeof(val))
+			return -EINVAL;
+		if (copy_from_sockptr(&val, optval, sizeof(val)))
+			return -EFAULT;
+		if (val < -1 || val >= U16_MAX)
+			return -EINVAL;
+
+		/* Takes effect when joining a PACKET_FANOUT_QM group */
+		mutex_lock(&fanout_mutex);
+		if (po->fanout) {
+			ret = -EBUSY;
+		} else {
+			WRITE_ONCE(po->rx_queue, val);
+			ret = 0;
+		}
+		mutex_unlock(&fanout_mutex);
+		return ret;
+	}
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -4124,6 +4200,9 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	case PACKET_QDISC_BYPASS:
 		val = packet_use_direct_xmit(po);
 		break;
+	case PACKET_RX_QUEUE:
+		val = READ_ONCE(po->rx_queue);
+		break;
 	default:
 		return -ENOPROTOOPT;
 	}
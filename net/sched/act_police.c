@@ -34,6 +34,7 @@ static const struct nla_policy police_policy[TCA_POLICE_MAX + 1] = {
 	[TCA_POLICE_PEAKRATE64] = { .type = NLA_U64 },
 	[TCA_POLICE_PKTRATE64]  = { .type = NLA_U64, .min = 1 },
 	[TCA_POLICE_PKTBURST64] = { .type = NLA_U64, .min = 1 },
+	[TCA_POLICE_BATCH]	= { .type = NLA_U32 },
 };
 
 static int tcf_police_init(struct net *net, struct nlattr *nla,
@@ -96,6 +97,14 @@ static int tcf_police_init(struct net *net, struct nlattr *nla,
 		goto release_idr;
 
 	police = to_police(*a);
+	if (ret == ACT_P_CREATED) {
+		police->tcfp_pcpu_toks = alloc_percpu(s64);
+		if (!police->tcfp_pcpu_toks) {
+			err = -ENOMEM;
+			goto failure;
+		}
+	}
+
 	if (parm->rate.rate) {
 		err = -ENOMEM;
 		R_tab = qdisc_get_rtab(&parm->rate, tb[TCA_POLICE_RATE], NULL);
@@ -199,6 +208,14 @@ static int tcf_police_init(struct net *net, struct nlattr *nla,
 		psched_ppscfg_precompute(&new->ppsrate, pps);
 	}
 
+	/* Per CPU batching only applies to a plain byte rate bucket */
+	if (tb[TCA_POLICE_BATCH] && new->rate_present && !new->peak_present) {
+		new->tcfp_batch = nla_get_u32(tb[TCA_POLICE_BATCH]);
+		new->tcfp_batch_toks = min_t(s64, new->tcfp_burst,
+					     psched_l2t_ns(&new->rate,
+							   new->tcfp_batch));
+	}
+
 	spin_lock_bh(&police->tcf_lock);
 	spin_lock_bh(&police->tcfp_lock);
 	police->tcfp_t_c = ktime_get_ns();
@@ -243,6 +260,52 @@ static bool tcf_police_mtu_check(struct sk_buff *skb, u32 limit)
 	return len <= limit;
 }
 
+/*
+ * Charge @len bytes against the tokens this CPU took from the bucket, and
+ * only take the policer lock to grab another batch once they run out.
+ * The bucket can overshoot the configured rate by at most one batch per
+ * CPU, in exchange for the lock being taken once per batch instead of
+ * once per packet.
+ *
+ * This polices, it does not shape: nonconforming packets get the exceed
+ * action rather than being delayed. A per-tenant hierarchy is built by
+ * chaining policers in one clsact egress filter ("conform pipe" to the
+ * parent), each level taking its lock once per batch, below an mq root
+ * whose children keep their own locks.
+ */
+static bool tcf_police_batch_conform(struct tcf_police *police,
+				     const struct tcf_police_params *p,
+				     unsigned int len)
+{
+	s64 *cache = this_cpu_ptr(police->tcfp_pcpu_toks);
+	s64 cost = (s64)psched_l2t_ns(&p->rate, len);
+	s64 now, toks, grab;
+
+	if (*cache >= cost) {
+		*cache -= cost;
+		return true;
+	}
+
+	now = ktime_get_ns();
+	spin_lock_bh(&police->tcfp_lock);
+	toks = min_t(s64, now - police->tcfp_t_c, p->tcfp_burst);
+	toks += police->tcfp_toks;
+	if (toks > p->tcfp_burst)
+		toks = p->tcfp_burst;
+
+	grab = min_t(s64, toks, cost - *cache + p->tcfp_batch_toks);
+	if (*cache + grab < cost) {
+		spin_unlock_bh(&police->tcfp_lock);
+		return false;
+	}
+	police->tcfp_t_c = now;
+	police->tcfp_toks = toks - grab;
+	spin_unlock_bh(&police->tcfp_lock);
+
+	*cache += grab - cost;
+	return true;
+}
+
 TC_INDIRECT_SCOPE int tcf_police_act(struct sk_buff *skb,
 				     const struct tc_action *a,
 				     struct tcf_result *res)
@@ -272,6 +335,14 @@ TC_INDIRECT_SCOPE int tcf_police_act(struct sk_buff *skb,
 			goto end;
 		}
 
+		if (p->tcfp_batch_toks) {
+			if (!tcf_police_batch_conform(police, p,
+						      qdisc_pkt_len(skb)))
+				goto inc_overlimits;
+			ret = p->tcfp_result;
+			goto inc_drops;
+		}
+
 		now = ktime_get_ns();
 		spin_lock_bh(&police->tcfp_lock);
 		toks = min_t(s64, now - police->tcfp_t_c, p->tcfp_burst);
@@ -323,6 +394,7 @@ static void tcf_police_cleanup(struct tc_action *a)
 	p = rcu_dereference_protected(police->params, 1);
 	if (p)
 		kfree_rcu(p, rcu);
+	free_percpu(police->tcfp_pcpu_toks);
 }
 
 static void tcf_police_stats_update(struct tc_action *a,
@@ -389,6 +461,9 @@ static int tcf_police_dump(struct sk_buff *skb, struct tc_action *a,
 	if (p->tcfp_ewma_rate &&
 	    nla_put_u32(skb, TCA_POLICE_AVRATE, p->tcfp_ewma_rate))
 		goto nla_put_failure;
+	if (p->tcfp_batch_toks &&
+	    nla_put_u32(skb, TCA_POLICE_BATCH, p->tcfp_batch))
+		goto nla_put_failure;
 
 	tcf_tm_dump(&t, &police->tcf_tm);
 	if (nla_put_64bit(skb, TCA_POLICE_TM, sizeof(t), &t, TCA_POLICE_PAD))
@@ -523,6 +523,37 @@ static void fq_check_throttled(struct fq_sched_data *q, u64 now)
 	}
 }
 
+/* The pacing state of a socket flow is kept in the socket as well as in the
+ * flow, so that flows of one socket in several fq instances, such as the per
+ * queue children of mq, are paced and held to maxrate as a whole.
+ */
+static u64 fq_sk_pacing_next(const struct sk_buff *skb)
+{
+	const struct sock *sk = skb->sk;
+
+	if (!sk || !sk_fullsock(sk))
+		return 0;
+	return READ_ONCE(sk->sk_pacing_next);
+}
+
+static void fq_sk_set_pacing_next(struct sk_buff *skb, u64 next)
+{
+	struct sock *sk = skb->sk;
+	u64 old;
+
+	if (!sk || !sk_fullsock(sk))
+		return;
+
+	old = READ_ONCE(sk->sk_pacing_next);
+	while (old < next) {
+		u64 prev = cmpxchg64(&sk->sk_pacing_next, old, next);
+
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
 static struct sk_buff *fq_dequeue(struct Qdisc *sch)
 {
 	struct fq_sched_data *q = qdisc_priv(sch);
@@ -570,6 +601,10 @@ static struct sk_buff *fq_dequeue(struct Qdisc *sch)
 		u64 time_next_packet = max_t(u64, fq_skb_cb(skb)->time_to_send,
 					     f->time_next_packet);
 
+		if (q->rate_enable)
+			time_next_packet = max(time_next_packet,
+					       fq_sk_pacing_next(skb));
+
 		if (now < time_next_packet) {
 			head->first = f->next;
 			f->time_next_packet = time_next_packet;
@@ -637,6 +672,7 @@ static struct sk_buff *fq_dequeue(struct Qdisc *sch)
 		if (f->time_next_packet)
 			len -= min(len/2, now - f->time_next_packet);
 		f->time_next_packet = now + len;
+		fq_sk_set_pacing_next(skb, f->time_next_packet);
 	}
 out:
 	qdisc_bstats_update(sch, skb);
@@ -33,6 +33,8 @@
 #include <linux/rbtree.h>
 #include <linux/workqueue.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/xarray.h>
 #include <net/netlink.h>
 #include <net/sch_generic.h>
 #include <net/pkt_sched.h>
@@ -66,6 +68,10 @@ static int htb_rate_est = 0; /* htb classes have a default rate estimator */
 module_param(htb_rate_est, int, 0640);
 MODULE_PARM_DESC(htb_rate_est, "setup a default rate estimator (4sec 16sec) for htb classes");
 
+static unsigned int htb_edt_batch_us __read_mostly = 100;
+module_param(htb_edt_batch_us, uint, 0640);
+MODULE_PARM_DESC(htb_edt_batch_us, "EDT mode: class time reserved by a cpu at once (usec)");
+
 /* used internaly to keep status of single class */
 enum htb_cmode {
 	HTB_CANT_SEND,		/* class can't send and can't borrow */
@@ -110,6 +116,10 @@ struct htb_class {
 
 	struct net_rate_estimator __rcu *rate_est;
 
+	/* EDT mode only */
+	struct htb_edt_cache __percpu *edt_cache;
+	struct gnet_stats_basic_sync __percpu *edt_bstats;
+
 	/*
 	 * Written often fields
 	 */
@@ -121,6 +131,9 @@ struct htb_class {
 	s64			tokens, ctokens;/* current number of tokens */
 	s64			t_c;		/* checkpoint time */
 
+	/* EDT mode: when the rate and ceil buckets run dry (q->edt_lock) */
+	s64			edt_rate, edt_ceil;
+
 	union {
 		struct htb_class_leaf {
 			int		deficit[TC_HTB_MAXDEPTH];
@@ -181,6 +194,10 @@ struct htb_sched {
 	unsigned int            num_direct_qdiscs;
 
 	bool			offload;
+
+	bool			edt;
+	spinlock_t		edt_lock;	/* class clocks and rates */
+	struct xarray		edt_classes;	/* lockless class lookup */
 };
 
 /* find class in global hash table using given handle */
@@ -189,6 +206,10 @@ static inline struct htb_class *htb_find(u32 handle, struct Qdisc *sch)
 	struct htb_sched *q = qdisc_priv(sch);
 	struct Qdisc_class_common *clc;
 
+	/* EDT mode classifies without the qdisc lock held */
+	if (q->edt)
+		return xa_load(&q->edt_classes, handle);
+
 	clc = qdisc_class_find(&q->clhash, handle);
 	if (clc == NULL)
 		return NULL;
@@ -1016,6 +1037,223 @@ static void htb_reset(struct Qdisc *sch)
 	memset(q->row_mask, 0, sizeof(q->row_mask));
 }
 
+/* EDT mode.
+ *
+ * With TCA_HTB_EDT the qdisc lock is kept off the data path. HTB is
+ * grafted like an mq root and every TX queue gets an htb_edt qdisc of
+ * its own, which classifies the packet, stamps it with an earliest
+ * departure time and holds it in a time ordered queue until then.
+ *
+ * The departure time is solved from two virtual clocks per class, the
+ * times at which its rate and ceil buckets run dry, instead of polling
+ * the class modes: a packet may leave once every class from the leaf up
+ * to some ancestor is within its ceil and that ancestor is within its
+ * rate. All classes on the way are charged ceil, the lender and the
+ * classes above it rate too, as htb_charge_class() does.
+ *
+ * The clocks are shared by all cpus, so a cpu reserves htb_edt_batch_us
+ * worth of the leaf's ceil at once under q->edt_lock and then stamps
+ * packets from that reservation without any locking.
+ */
+struct htb_edt_cache {
+	s64		edt;	/* departure time of the reserved bytes */
+	unsigned int	bytes;	/* bytes left in the reservation */
+};
+
+struct htb_edt_txq {
+	struct Qdisc		*htb;	/* the HTB root */
+	struct rb_root_cached	queue;	/* packets by departure time */
+	struct qdisc_watchdog	watchdog;
+};
+
+static s64 htb_edt_reserve(struct htb_sched *q, struct htb_class *cl,
+			   unsigned int bytes, s64 now)
+{
+	s64 ceil_edt = now, edt = S64_MAX;
+	struct htb_class *p, *lender = cl;
+	bool charge_rate = false;
+
+	lockdep_assert_held(&q->edt_lock);
+
+	for (p = cl; p; p = p->parent) {
+		s64 t;
+
+		ceil_edt = max(ceil_edt, p->edt_ceil);
+		t = max(ceil_edt, p->edt_rate);
+		if (t < edt) {
+			edt = t;
+			lender = p;
+		}
+		/* nobody further up can do better than now */
+		if (edt == now)
+			break;
+	}
+
+	for (p = cl; p; p = p->parent) {
+		p->edt_ceil = max(p->edt_ceil, edt - p->cbuffer) +
+			      psched_l2t_ns(&p->ceil, bytes);
+		if (p == lender)
+			charge_rate = true;
+		if (charge_rate)
+			p->edt_rate = max(p->edt_rate, edt - p->buffer) +
+				      psched_l2t_ns(&p->rate, bytes);
+	}
+
+	if (edt > now) {
+		cl->overlimits++;
+		q->overlimits++;
+	}
+	return edt;
+}
+
+/* departure time set by the socket, if any */
+static s64 htb_edt_time(const struct sk_buff *skb)
+{
+	return skb->mono_delivery_time ? skb->tstamp : 0;
+}
+
+static void htb_edt_stamp(struct htb_sched *q, struct htb_class *cl,
+			  struct sk_buff *skb)
+{
+	struct htb_edt_cache *cache = this_cpu_ptr(cl->edt_cache);
+	unsigned int len = qdisc_pkt_len(skb);
+
+	if (unlikely(cache->bytes < len)) {
+		s64 now = ktime_get_ns();
+		u64 batch;
+
+		spin_lock(&q->edt_lock);
+		batch = min_t(u64, (u64)READ_ONCE(htb_edt_batch_us) * NSEC_PER_USEC,
+			      cl->cbuffer);
+		batch = mul_u64_u64_div_u64(cl->ceil.rate_bytes_ps, batch,
+					    NSEC_PER_SEC);
+		batch = clamp_t(u64, batch, len, INT_MAX);
+		cache->edt = htb_edt_reserve(q, cl, batch, now);
+		cache->bytes += batch;
+		spin_unlock(&q->edt_lock);
+	}
+	cache->bytes -= len;
+
+	skb_set_delivery_time(skb, max(cache->edt, htb_edt_time(skb)), true);
+	bstats_update(this_cpu_ptr(cl->edt_bstats), skb);
+}
+
+static int htb_edt_txq_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			       struct sk_buff **to_free)
+{
+	struct htb_edt_txq *txq = qdisc_priv(sch);
+	struct rb_node **p = &txq->queue.rb_root.rb_node, *parent = NULL;
+	bool leftmost = true;
+	struct htb_class *cl;
+	s64 edt;
+	int ret;
+
+	if (unlikely(sch->q.qlen >= sch->limit))
+		return qdisc_drop(skb, sch, to_free);
+
+	cl = htb_classify(skb, txq->htb, &ret);
+	if (!cl) {
+		if (ret & __NET_XMIT_BYPASS)
+			qdisc_qstats_drop(sch);
+		__qdisc_drop(skb, to_free);
+		return ret;
+	}
+	if (cl != HTB_DIRECT)
+		htb_edt_stamp(qdisc_priv(txq->htb), cl, skb);
+
+	edt = htb_edt_time(skb);
+	while (*p) {
+		parent = *p;
+		if (edt < htb_edt_time(rb_to_skb(parent))) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+	rb_link_node(&skb->rbnode, parent, p);
+	rb_insert_color_cached(&skb->rbnode, &txq->queue, leftmost);
+
+	qdisc_qstats_backlog_inc(sch, skb);
+	sch->q.qlen++;
+	return NET_XMIT_SUCCESS;
+}
+
+static struct sk_buff *htb_edt_txq_dequeue(struct Qdisc *sch)
+{
+	struct htb_edt_txq *txq = qdisc_priv(sch);
+	struct sk_buff *skb;
+	s64 edt;
+
+	skb = rb_to_skb(rb_first_cached(&txq->queue));
+	if (!skb)
+		return NULL;
+
+	edt = htb_edt_time(skb);
+	if (edt > ktime_get_ns()) {
+		qdisc_watchdog_schedule_ns(&txq->watchdog, edt);
+		return NULL;
+	}
+
+	rb_erase_cached(&skb->rbnode, &txq->queue);
+	/* rbnode shares its storage with these */
+	skb->next = NULL;
+	skb->prev = NULL;
+	skb->dev = qdisc_dev(sch);
+
+	qdisc_qstats_backlog_dec(sch, skb);
+	sch->q.qlen--;
+	qdisc_bstats_update(sch, skb);
+	return skb;
+}
+
+static void htb_edt_txq_reset(struct Qdisc *sch)
+{
+	struct htb_edt_txq *txq = qdisc_priv(sch);
+	struct rb_node *p = rb_first_cached(&txq->queue);
+
+	while (p) {
+		struct sk_buff *skb = rb_to_skb(p);
+
+		p = rb_next(p);
+		rb_erase_cached(&skb->rbnode, &txq->queue);
+		rtnl_kfree_skbs(skb, skb);
+	}
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+	qdisc_watchdog_cancel(&txq->watchdog);
+}
+
+static int htb_edt_txq_init(struct Qdisc *sch, struct nlattr *opt,
+			    struct netlink_ext_ack *extack)
+{
+	struct htb_edt_txq *txq = qdisc_priv(sch);
+
+	txq->queue = RB_ROOT_CACHED;
+	qdisc_watchdog_init(&txq->watchdog, sch);
+	sch->limit = qdisc_dev(sch)->tx_queue_len ? : 1;
+	return 0;
+}
+
+static void htb_edt_txq_destroy(struct Qdisc *sch)
+{
+	struct htb_edt_txq *txq = qdisc_priv(sch);
+
+	qdisc_watchdog_cancel(&txq->watchdog);
+}
+
+static struct Qdisc_ops htb_edt_txq_ops __read_mostly = {
+	.id		=	"htb_edt",
+	.priv_size	=	sizeof(struct htb_edt_txq),
+	.enqueue	=	htb_edt_txq_enqueue,
+	.dequeue	=	htb_edt_txq_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	htb_edt_txq_init,
+	.reset		=	htb_edt_txq_reset,
+	.destroy	=	htb_edt_txq_destroy,
+	.owner		=	THIS_MODULE,
+};
+
 static const struct nla_policy htb_policy[TCA_HTB_MAX + 1] = {
 	[TCA_HTB_PARMS]	= { .len = sizeof(struct tc_htb_opt) },
 	[TCA_HTB_INIT]	= { .len = sizeof(struct tc_htb_glob) },
@@ -1025,6 +1263,7 @@ static const struct nla_policy htb_policy[TCA_HTB_MAX + 1] = {
 	[TCA_HTB_RATE64] = { .type = NLA_U64 },
 	[TCA_HTB_CEIL64] = { .type = NLA_U64 },
 	[TCA_HTB_OFFLOAD] = { .type = NLA_FLAG },
+	[TCA_HTB_EDT] = { .type = NLA_FLAG },
 };
 
 static void htb_work_func(struct work_struct *work)
@@ -1058,11 +1297,13 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 	struct nlattr *tb[TCA_HTB_MAX + 1];
 	struct tc_htb_glob *gopt;
 	unsigned int ntx;
-	bool offload;
+	bool offload, edt;
 	int err;
 
 	qdisc_watchdog_init(&q->watchdog, sch);
 	INIT_WORK(&q->work, htb_work_func);
+	spin_lock_init(&q->edt_lock);
+	xa_init(&q->edt_classes);
 
 	if (!opt)
 		return -EINVAL;
@@ -1084,6 +1325,17 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		return -EINVAL;
 
 	offload = nla_get_flag(tb[TCA_HTB_OFFLOAD]);
+	edt = nla_get_flag(tb[TCA_HTB_EDT]);
+
+	if (offload && edt) {
+		NL_SET_ERR_MSG(extack, "HTB offload and EDT mode are mutually exclusive");
+		return -EINVAL;
+	}
+
+	if (edt && sch->parent != TC_H_ROOT) {
+		NL_SET_ERR_MSG(extack, "HTB must be the root qdisc to use EDT mode");
+		return -EOPNOTSUPP;
+	}
 
 	if (offload) {
 		if (sch->parent != TC_H_ROOT) {
@@ -1095,7 +1347,9 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 			NL_SET_ERR_MSG(extack, "hw-tc-offload ethtool feature flag must be on");
 			return -EOPNOTSUPP;
 		}
+	}
 
+	if (offload || edt) {
 		q->num_direct_qdiscs = dev->real_num_tx_queues;
 		q->direct_qdiscs = kcalloc(q->num_direct_qdiscs,
 					   sizeof(*q->direct_qdiscs),
@@ -1117,14 +1371,15 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		q->rate2quantum = 1;
 	q->defcls = gopt->defcls;
 
-	if (!offload)
+	if (!offload && !edt)
 		return 0;
 
 	for (ntx = 0; ntx < q->num_direct_qdiscs; ntx++) {
 		struct netdev_queue *dev_queue = netdev_get_tx_queue(dev, ntx);
 		struct Qdisc *qdisc;
 
-		qdisc = qdisc_create_dflt(dev_queue, &pfifo_qdisc_ops,
+		qdisc = qdisc_create_dflt(dev_queue, edt ? &htb_edt_txq_ops :
+					  &pfifo_qdisc_ops,
 					  TC_H_MAKE(sch->handle, 0), extack);
 		if (!qdisc) {
 			return -ENOMEM;
@@ -1133,10 +1388,17 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		htb_set_lockdep_class_child(qdisc);
 		q->direct_qdiscs[ntx] = qdisc;
 		qdisc->flags |= TCQ_F_ONETXQUEUE | TCQ_F_NOPARENT;
+		if (edt)
+			((struct htb_edt_txq *)qdisc_priv(qdisc))->htb = sch;
 	}
 
 	sch->flags |= TCQ_F_MQROOT;
 
+	if (edt) {
+		q->edt = true;
+		return 0;
+	}
+
 	offload_opt = (struct tc_htb_qopt_offload) {
 		.command = TC_HTB_CREATE,
 		.parent_classid = TC_H_MAJ(sch->handle) >> 16,
@@ -1155,7 +1417,7 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 	return 0;
 }
 
-static void htb_attach_offload(struct Qdisc *sch)
+static void htb_attach_txqs(struct Qdisc *sch)
 {
 	struct net_device *dev = qdisc_dev(sch);
 	struct htb_sched *q = qdisc_priv(sch);
@@ -1199,8 +1461,8 @@ static void htb_attach(struct Qdisc *sch)
 {
 	struct htb_sched *q = qdisc_priv(sch);
 
-	if (q->offload)
-		htb_attach_offload(sch);
+	if (q->offload || q->edt)
+		htb_attach_txqs(sch);
 	else
 		htb_attach_software(sch);
 }
@@ -1235,6 +1497,8 @@ static int htb_dump(struct Qdisc *sch, struct sk_buff *skb)
 		goto nla_put_failure;
 	if (q->offload && nla_put_flag(skb, TCA_HTB_OFFLOAD))
 		goto nla_put_failure;
+	if (q->edt && nla_put_flag(skb, TCA_HTB_EDT))
+		goto nla_put_failure;
 
 	return nla_nest_end(skb, nest);
 
@@ -1322,6 +1586,27 @@ static void htb_offload_aggregate_stats(struct htb_sched *q,
 	_bstats_update(&cl->bstats, bytes, packets);
 }
 
+static void htb_edt_aggregate_stats(struct htb_sched *q, struct htb_class *cl)
+{
+	struct htb_class *c;
+	unsigned int i;
+
+	gnet_stats_basic_sync_init(&cl->bstats);
+
+	for (i = 0; i < q->clhash.hashsize; i++) {
+		hlist_for_each_entry(c, &q->clhash.hash[i], common.hnode) {
+			struct htb_class *p = c;
+
+			while (p && p != cl)
+				p = p->parent;
+
+			if (p)
+				gnet_stats_add_basic(&cl->bstats, c->edt_bstats,
+						     NULL, true);
+		}
+	}
+}
+
 static int
 htb_dump_class_stats(struct Qdisc *sch, unsigned long arg, struct gnet_dump *d)
 {
@@ -1336,6 +1621,17 @@ htb_dump_class_stats(struct Qdisc *sch, unsigned long arg, struct gnet_dump *d)
 	if (!cl->level && cl->leaf.q)
 		qdisc_qstats_qlen_backlog(cl->leaf.q, &qlen, &qs.backlog);
 
+	if (q->edt) {
+		s64 now = ktime_get_ns();
+
+		spin_lock_bh(&q->edt_lock);
+		cl->tokens = min(now - cl->edt_rate, cl->buffer);
+		cl->ctokens = min(now - cl->edt_ceil, cl->cbuffer);
+		spin_unlock_bh(&q->edt_lock);
+
+		htb_edt_aggregate_stats(q, cl);
+	}
+
 	cl->xstats.tokens = clamp_t(s64, PSCHED_NS2TICKS(cl->tokens),
 				    INT_MIN, INT_MAX);
 	cl->xstats.ctokens = clamp_t(s64, PSCHED_NS2TICKS(cl->ctokens),
@@ -1455,6 +1751,11 @@ static int htb_graft(struct Qdisc *sch, unsigned long arg, struct Qdisc *new,
 	if (cl->level)
 		return -EINVAL;
 
+	if (q->edt) {
+		NL_SET_ERR_MSG(extack, "HTB classes in EDT mode have no leaf qdisc");
+		return -EOPNOTSUPP;
+	}
+
 	if (q->offload)
 		dev_queue = htb_offload_get_queue(cl);
 
@@ -1608,6 +1909,8 @@ static void htb_destroy_class(struct Qdisc *sch, struct htb_class *cl)
 	}
 	gen_kill_estimator(&cl->rate_est);
 	tcf_block_put(cl->block);
+	free_percpu(cl->edt_cache);
+	free_percpu(cl->edt_bstats);
 	kfree(cl);
 }
 
@@ -1673,6 +1976,7 @@ static void htb_destroy(struct Qdisc *sch)
 	WARN_ON(nonempty);
 
 	qdisc_class_hash_destroy(&q->clhash);
+	xa_destroy(&q->edt_classes);
 	__qdisc_reset_queue(&q->direct_queue);
 
 	if (q->offload) {
@@ -1715,7 +2019,7 @@ static int htb_delete(struct Qdisc *sch, unsigned long arg,
 			return err;
 	}
 
-	if (last_child) {
+	if (last_child && !q->edt) {
 		struct netdev_queue *dev_queue = sch->dev_queue;
 
 		if (q->offload)
@@ -1753,6 +2057,12 @@ static int htb_delete(struct Qdisc *sch, unsigned long arg,
 
 	sch_tree_unlock(sch);
 
+	if (q->edt) {
+		/* the TX queues may still be classifying into it */
+		xa_erase(&q->edt_classes, cl->common.classid);
+		synchronize_net();
+	}
+
 	htb_destroy_class(sch, cl);
 	return 0;
 }
@@ -1812,6 +2122,20 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 		}
 	}
 
+	if (q->edt) {
+		/* Batches are charged as a whole, not per packet. */
+		if (hopt->rate.overhead || hopt->ceil.overhead ||
+		    hopt->rate.mpu || hopt->ceil.mpu) {
+			NL_SET_ERR_MSG(extack, "HTB EDT mode doesn't support the overhead and mpu parameters");
+			goto failure;
+		}
+		/* There is no round robin between the leaves to tune. */
+		if (hopt->quantum || hopt->prio) {
+			NL_SET_ERR_MSG(extack, "HTB EDT mode doesn't support the quantum and prio parameters");
+			goto failure;
+		}
+	}
+
 	/* Keeping backward compatible with rate_table based iproute2 tc */
 	if (hopt->rate.linklayer == TC_LINKLAYER_UNAWARE)
 		qdisc_put_rtab(qdisc_get_rtab(&hopt->rate, tb[TCA_HTB_RTAB],
@@ -1861,13 +2185,21 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 		gnet_stats_basic_sync_init(&cl->bstats);
 		gnet_stats_basic_sync_init(&cl->bstats_bias);
 
-		err = tcf_block_get(&cl->block, &cl->filter_list, sch, extack);
-		if (err) {
-			kfree(cl);
-			goto failure;
+		if (q->edt) {
+			cl->edt_cache = alloc_percpu(struct htb_edt_cache);
+			cl->edt_bstats = netdev_alloc_pcpu_stats(struct gnet_stats_basic_sync);
+			if (!cl->edt_cache || !cl->edt_bstats)
+				goto err_free_class;
+			err = xa_reserve(&q->edt_classes, classid, GFP_KERNEL);
+			if (err)
+				goto err_free_class;
 		}
+
+		err = tcf_block_get(&cl->block, &cl->filter_list, sch, extack);
+		if (err)
+			goto err_release_class;
 		if (htb_rate_est || tca[TCA_RATE]) {
-			err = gen_new_estimator(&cl->bstats, NULL,
+			err = gen_new_estimator(&cl->bstats, cl->edt_bstats,
 						&cl->rate_est,
 						NULL,
 						true,
@@ -1939,8 +2271,10 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 				       u64_stats_read(&old_q->bstats.packets));
 			qdisc_put(old_q);
 		}
-		new_q = qdisc_create_dflt(dev_queue, &pfifo_qdisc_ops,
-					  classid, NULL);
+		/* EDT mode queues on the TX queues, not in the classes */
+		new_q = q->edt ? NULL : qdisc_create_dflt(dev_queue,
+							  &pfifo_qdisc_ops,
+							  classid, NULL);
 		if (q->offload) {
 			if (new_q) {
 				htb_set_lockdep_class_child(new_q);
@@ -1993,7 +2327,7 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 			qdisc_hash_add(cl->leaf.q, true);
 	} else {
 		if (tca[TCA_RATE]) {
-			err = gen_replace_estimator(&cl->bstats, NULL,
+			err = gen_replace_estimator(&cl->bstats, cl->edt_bstats,
 						    &cl->rate_est,
 						    NULL,
 						    true,
@@ -2026,6 +2360,8 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 		sch_tree_lock(sch);
 	}
 
+	/* EDT mode reads the rates without the qdisc lock */
+	spin_lock(&q->edt_lock);
 	psched_ratecfg_precompute(&cl->rate, &hopt->rate, rate64);
 	psched_ratecfg_precompute(&cl->ceil, &hopt->ceil, ceil64);
 
@@ -2054,11 +2390,17 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 
 	cl->buffer = PSCHED_TICKS2NS(hopt->buffer);
 	cl->cbuffer = PSCHED_TICKS2NS(hopt->cbuffer);
+	spin_unlock(&q->edt_lock);
 
 	sch_tree_unlock(sch);
 	qdisc_put(parent_qdisc);
 
-	if (warn)
+	/* publish the new class to the TX queues */
+	if (q->edt && !*arg)
+		xa_store(&q->edt_classes, classid, cl, GFP_KERNEL);
+
+	/* EDT mode has no use for the quantum */
+	if (warn && !q->edt)
 		pr_warn("HTB: quantum of class %X is %s. Consider r2q change.\n",
 			    cl->common.classid, (warn == -1 ? "small" : "big"));
 
@@ -2071,6 +2413,12 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 	gen_kill_estimator(&cl->rate_est);
 err_block_put:
 	tcf_block_put(cl->block);
+err_release_class:
+	if (q->edt)
+		xa_release(&q->edt_classes, classid);
+err_free_class:
+	free_percpu(cl->edt_cache);
+	free_percpu(cl->edt_bstats);
 	kfree(cl);
 failure:
 	return err;
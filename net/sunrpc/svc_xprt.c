@@ -466,6 +466,7 @@ void svc_xprt_enqueue(struct svc_xprt *xprt)
 
 	spin_lock_bh(&pool->sp_lock);
 	list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
+	pool->sp_nrpending++;
 	pool->sp_stats.sockets_queued++;
 	spin_unlock_bh(&pool->sp_lock);
 
@@ -480,6 +481,7 @@ void svc_xprt_enqueue(struct svc_xprt *xprt)
 		goto out_unlock;
 	}
 	set_bit(SP_CONGESTED, &pool->sp_flags);
+	atomic_long_inc(&pool->sp_stats.threads_starved);
 	rqstp = NULL;
 out_unlock:
 	rcu_read_unlock();
@@ -502,6 +504,7 @@ static struct svc_xprt *svc_xprt_dequeue(struct svc_pool *pool)
 		xprt = list_first_entry(&pool->sp_sockets,
 					struct svc_xprt, xpt_ready);
 		list_del_init(&xprt->xpt_ready);
+		pool->sp_nrpending--;
 		svc_xprt_get(xprt);
 	}
 	spin_unlock_bh(&pool->sp_lock);
@@ -1119,6 +1122,7 @@ static struct svc_xprt *svc_dequeue_net(struct svc_serv *serv, struct net *net)
 			if (xprt->xpt_net != net)
 				continue;
 			list_del_init(&xprt->xpt_ready);
+			pool->sp_nrpending--;
 			spin_unlock_bh(&pool->sp_lock);
 			return xprt;
 		}
@@ -1437,16 +1441,19 @@ static int svc_pool_stats_show(struct seq_file *m, void *p)
 	struct svc_pool *pool = p;
 
 	if (p == SEQ_START_TOKEN) {
-		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout\n");
+		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout threads-starved sockets-pending threads\n");
 		return 0;
 	}
 
-	seq_printf(m, "%u %lu %lu %lu %lu\n",
+	seq_printf(m, "%u %lu %lu %lu %lu %lu %u %u\n",
 		pool->sp_id,
 		(unsigned long)atomic_long_read(&pool->sp_stats.packets),
 		pool->sp_stats.sockets_queued,
 		(unsigned long)atomic_long_read(&pool->sp_stats.threads_woken),
-		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout));
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout),
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_starved),
+		READ_ONCE(pool->sp_nrpending),
+		READ_ONCE(pool->sp_nrthreads));
 
 	return 0;
 }
@@ -46,6 +46,9 @@
 
 #include "tls.h"
 
+/* Full records sendmsg() encrypts back to back before pushing them */
+#define TLS_TX_BATCH	4
+
 struct tls_decrypt_arg {
 	struct_group(inargs,
 	bool zc;
@@ -318,9 +321,15 @@ static struct tls_rec *tls_get_rec(struct sock *sk)
 
 	mem_size = sizeof(struct tls_rec) + crypto_aead_reqsize(ctx->aead_send);
 
-	rec = kzalloc(mem_size, sk->sk_allocation);
-	if (!rec)
-		return NULL;
+	rec = ctx->free_rec;
+	if (rec) {
+		ctx->free_rec = NULL;
+		memset(rec, 0, mem_size);
+	} else {
+		rec = kzalloc(mem_size, sk->sk_allocation);
+		if (!rec)
+			return NULL;
+	}
 
 	msg_pl = &rec->msg_plaintext;
 	msg_en = &rec->msg_encrypted;
@@ -346,6 +355,20 @@ static void tls_free_rec(struct sock *sk, struct tls_rec *rec)
 	kfree(rec);
 }
 
+/* Called once the encrypted record has been handed to TCP.  A stream of
+ * full sized records would otherwise allocate and free one per 16kB.
+ */
+static void tls_put_sent_rec(struct sock *sk, struct tls_sw_context_tx *ctx,
+			     struct tls_rec *rec)
+{
+	list_del(&rec->list);
+	sk_msg_free(sk, &rec->msg_plaintext);
+	if (!ctx->free_rec)
+		ctx->free_rec = rec;
+	else
+		kfree(rec);
+}
+
 static void tls_free_open_rec(struct sock *sk)
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
@@ -382,9 +405,7 @@ int tls_tx_records(struct sock *sk, int flags)
 		/* Full record has been transmitted.
 		 * Remove the head of tx_list
 		 */
-		list_del(&rec->list);
-		sk_msg_free(sk, &rec->msg_plaintext);
-		kfree(rec);
+		tls_put_sent_rec(sk, ctx, rec);
 	}
 
 	/* Tx all ready records */
@@ -402,9 +423,7 @@ int tls_tx_records(struct sock *sk, int flags)
 			if (rc)
 				goto tx_err;
 
-			list_del(&rec->list);
-			sk_msg_free(sk, &rec->msg_plaintext);
-			kfree(rec);
+			tls_put_sent_rec(sk, ctx, rec);
 		} else {
 			break;
 		}
@@ -779,9 +798,28 @@ static int tls_push_record(struct sock *sk, int flags,
 		ctx->open_rec = tmp;
 	}
 
+	/* Keep the cipher busy on the following records and hand them to
+	 * TCP together, rather than alternating between the two per record.
+	 */
+	if (ctx->tx_batch && ++ctx->tx_batched < TLS_TX_BATCH)
+		return 0;
+	ctx->tx_batched = 0;
+
 	return tls_tx_records(sk, flags);
 }
 
+/* Push the records tls_push_record() held back for a batch */
+static void tls_tx_batch_flush(struct sock *sk, int flags)
+{
+	struct tls_sw_context_tx *ctx = tls_sw_ctx_tx(tls_get_ctx(sk));
+
+	if (!ctx->tx_batched)
+		return;
+
+	ctx->tx_batched = 0;
+	tls_tx_records(sk, flags);
+}
+
 static int bpf_exec_tx_verdict(struct sk_msg *msg, struct sock *sk,
 			       bool full_record, u8 record_type,
 			       ssize_t *copied, int flags)
@@ -1013,9 +1051,11 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 			copied += try_to_copy;
 
 			sk_msg_sg_copy_set(msg_pl, first);
+			ctx->tx_batch = full_record && msg_data_left(msg);
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
 						  msg->msg_flags);
+			ctx->tx_batch = 0;
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -1066,9 +1106,11 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 		tls_ctx->pending_open_record_frags = true;
 		copied += try_to_copy;
 		if (full_record || eor) {
+			ctx->tx_batch = full_record && msg_data_left(msg);
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
 						  msg->msg_flags);
+			ctx->tx_batch = 0;
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -1087,6 +1129,8 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 wait_for_sndbuf:
 		set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
 wait_for_memory:
+		/* the held back records are what keeps the memory busy */
+		tls_tx_batch_flush(sk, msg->msg_flags);
 		ret = sk_stream_wait_memory(sk, &timeo);
 		if (ret) {
 trim_sgl:
@@ -1131,6 +1175,7 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	}
 
 send_end:
+	tls_tx_batch_flush(sk, msg->msg_flags);
 	ret = sk_stream_error(sk, msg->msg_flags, ret);
 
 	release_sock(sk);
@@ -2342,6 +2387,8 @@ void tls_sw_release_resources_tx(struct sock *sk)
 
 	crypto_free_aead(ctx->aead_send);
 	tls_free_open_rec(sk);
+	kfree(ctx->free_rec);
+	ctx->free_rec = NULL;
 }
 
 void tls_sw_free_ctx_tx(struct tls_context *tls_ctx)
@@ -568,6 +568,7 @@ static void unix_sock_destructor(struct sock *sk)
 	struct unix_sock *u = unix_sk(sk);
 
 	skb_queue_purge(&sk->sk_receive_queue);
+	skb_queue_purge(&sk->sk_error_queue);
 
 	DEBUG_NET_WARN_ON_ONCE(refcount_read(&sk->sk_wmem_alloc));
 	DEBUG_NET_WARN_ON_ONCE(!sk_unhashed(sk));
@@ -2103,6 +2104,37 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
  */
 #define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
 
+/* MSG_ZEROCOPY skbs carry no linear data: every byte sits in a frag
+ * pointing at the sender's pages.  Keep one frag spare for a buffer
+ * that does not start on a page boundary.
+ */
+#define UNIX_ZC_SKB_SZ ((MAX_SKB_FRAGS - 1) << PAGE_SHIFT)
+
+static struct sk_buff *unix_zerocopy_skb(struct sock *sk, struct msghdr *msg,
+					 struct ubuf_info *uarg, int size,
+					 int *err)
+{
+	struct sk_buff *skb;
+
+	skb = sock_alloc_send_pskb(sk, 0, 0, msg->msg_flags & MSG_DONTWAIT,
+				   err, 0);
+	if (!skb)
+		return NULL;
+
+	/* Pass no socket so that the pinned pages are charged to
+	 * sk_wmem_alloc, like the rest of the unix send path, rather
+	 * than to the TCP-style sk_wmem_queued.
+	 */
+	*err = __zerocopy_sg_from_iter(msg, NULL, skb, &msg->msg_iter, size);
+	if (*err) {
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	skb_zcopy_set(skb, uarg, NULL);
+	return skb;
+}
+
 #if IS_ENABLED(CONFIG_AF_UNIX_OOB)
 static int queue_oob(struct socket *sock, struct msghdr *msg, struct sock *other)
 {
@@ -2155,6 +2187,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 {
 	struct sock *sk = sock->sk;
 	struct sock *other = NULL;
+	struct ubuf_info *uarg = NULL;
 	int err, size;
 	struct sk_buff *skb;
 	int sent = 0;
@@ -2190,12 +2223,37 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	if ((msg->msg_flags & MSG_ZEROCOPY) && len &&
+	    sock_flag(sk, SOCK_ZEROCOPY)) {
+		uarg = msg_zerocopy_realloc(sk, len, NULL);
+		if (!uarg) {
+			err = -ENOBUFS;
+			goto out_err;
+		}
+	}
+
 	while (sent < len) {
 		size = len - sent;
 
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
+		if (uarg) {
+			size = min_t(int, size, UNIX_ZC_SKB_SZ);
+
+			skb = unix_zerocopy_skb(sk, msg, uarg, size, &err);
+			if (!skb)
+				goto out_err;
+
+			err = unix_scm_to_skb(&scm, skb, !fds_sent);
+			if (err < 0) {
+				kfree_skb(skb);
+				goto out_err;
+			}
+			fds_sent = true;
+			goto queue;
+		}
+
 		/* allow fallback to order-0 allocations */
 		size = min_t(int, size, SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ);
 
@@ -2226,6 +2284,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			goto out_err;
 		}
 
+queue:
 		unix_state_lock(other);
 
 		if (sock_flag(other, SOCK_DEAD) ||
@@ -2249,6 +2308,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	}
 #endif
 
+	net_zcopy_put(uarg);
 	scm_destroy(&scm);
 
 	return sent;
@@ -2261,6 +2321,10 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		send_sig(SIGPIPE, current, 0);
 	err = -EPIPE;
 out_err:
+	if (sent)
+		net_zcopy_put(uarg);
+	else
+		net_zcopy_put_abort(uarg, true);
 	scm_destroy(&scm);
 	return sent ? : err;
 }
@@ -2554,6 +2618,12 @@ static int unix_read_skb(struct sock *sk, skb_read_actor_t recv_actor)
 	if (!skb)
 		return err;
 
+	/* the actor may keep page refs; never hand it the sender's pages */
+	if (skb_orphan_frags_rx(skb, GFP_KERNEL)) {
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
 	copied = recv_actor(sk, skb);
 	kfree_skb(skb);
 
@@ -2833,6 +2903,17 @@ static int unix_stream_read_generic(struct unix_stream_read_state *state,
 		}
 
 		chunk = min_t(unsigned int, unix_skb_len(skb) - skip, size);
+
+		/* A pipe keeps references to the pages it is spliced; replace
+		 * MSG_ZEROCOPY frags with private copies first so the sender's
+		 * user pages never outlive its completion notification.
+		 */
+		if (state->pipe && skb_orphan_frags_rx(skb, GFP_KERNEL)) {
+			if (copied == 0)
+				copied = -ENOMEM;
+			break;
+		}
+
 		skb_get(skb);
 		chunk = state->recv_actor(skb, skip, chunk, state);
 		drop_skb = !unix_skb_len(skb);
@@ -2944,11 +3025,17 @@ static int unix_stream_recvmsg(struct socket *sock, struct msghdr *msg,
 		.size = size,
 		.flags = flags
 	};
-
-#ifdef CONFIG_BPF_SYSCALL
 	struct sock *sk = sock->sk;
+#ifdef CONFIG_BPF_SYSCALL
 	const struct proto *prot = READ_ONCE(sk->sk_prot);
+#endif
+
+	/* MSG_ZEROCOPY completions */
+	if (unlikely(flags & MSG_ERRQUEUE))
+		return sock_recv_errqueue(sk, msg, size, SOL_SOCKET,
+					  SO_ZEROCOPY);
 
+#ifdef CONFIG_BPF_SYSCALL
 	if (prot != &unix_stream_proto)
 		return prot->recvmsg(sk, msg, size, flags, NULL);
 #endif
@@ -3158,7 +3245,7 @@ static __poll_t unix_poll(struct file *file, struct socket *sock, poll_table *wa
 	mask = 0;
 
 	/* exceptional events? */
-	if (sk->sk_err)
+	if (sk->sk_err || !skb_queue_empty_lockless(&sk->sk_error_queue))
 		mask |= EPOLLERR;
 	if (sk->sk_shutdown == SHUTDOWN_MASK)
 		mask |= EPOLLHUP;
@@ -61,6 +61,7 @@ static void xdp_umem_release(struct xdp_umem *umem)
 	xdp_umem_unpin_pages(umem);
 
 	xdp_umem_unaccount_pages(umem);
+	kvfree(umem->spare);
 	kfree(umem);
 }
 
@@ -166,7 +167,8 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 		return -EINVAL;
 	}
 
-	if (mr->flags & ~XDP_UMEM_UNALIGNED_CHUNK_FLAG)
+	if (mr->flags & ~(XDP_UMEM_UNALIGNED_CHUNK_FLAG |
+			  XDP_UMEM_BALANCE_FILL_FLAG))
 		return -EINVAL;
 
 	if (!unaligned_chunks && !is_power_of_2(chunk_size))
@@ -210,9 +212,17 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	INIT_LIST_HEAD(&umem->xsk_dma_list);
 	refcount_set(&umem->users, 1);
 
+	spin_lock_init(&umem->spare_lock);
+	if (mr->flags & XDP_UMEM_BALANCE_FILL_FLAG) {
+		umem->spare = kvcalloc(chunks, sizeof(*umem->spare),
+				       GFP_KERNEL);
+		if (!umem->spare)
+			return -ENOMEM;
+	}
+
 	err = xdp_umem_account_pages(umem);
 	if (err)
-		return err;
+		goto out_spare;
 
 	err = xdp_umem_pin_pages(umem, (unsigned long)addr);
 	if (err)
@@ -228,6 +238,9 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	xdp_umem_unpin_pages(umem);
 out_account:
 	xdp_umem_unaccount_pages(umem);
+out_spare:
+	kvfree(umem->spare);
+	umem->spare = NULL;
 	return err;
 }
 
@@ -137,62 +137,135 @@ int xsk_reg_pool_at_qid(struct net_device *dev, struct xsk_buff_pool *pool,
 static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 {
 	struct xdp_buff_xsk *xskb = container_of(xdp, struct xdp_buff_xsk, xdp);
+	struct list_head *xskb_list = &xskb->pool->xskb_list;
+	struct xdp_buff_xsk *pos, *tmp;
+	u32 num_desc;
 	u64 addr;
 	int err;
 
-	addr = xp_get_handle(xskb);
-	err = xskq_prod_reserve_desc(xs->rx, addr, len);
-	if (err) {
+	if (likely(!xdp_buff_has_frags(xdp))) {
+		addr = xp_get_handle(xskb);
+		err = xskq_prod_reserve_desc(xs->rx, addr, len, 0);
+		if (err) {
+			xs->rx_queue_full++;
+			return err;
+		}
+
+		xp_release(xskb);
+		return 0;
+	}
+
+	/* All of the packet makes it to the ring, or none of it */
+	num_desc = xdp_get_shared_info_from_buff(xdp)->nr_frags + 1;
+	if (xskq_prod_nb_free(xs->rx, num_desc) < num_desc) {
 		xs->rx_queue_full++;
-		return err;
+		return -ENOBUFS;
 	}
 
+	xskq_prod_write_desc(xs->rx, xp_get_handle(xskb), len, XDP_PKT_CONTD);
 	xp_release(xskb);
+
+	list_for_each_entry_safe(pos, tmp, xskb_list, xskb_list_node) {
+		list_del(&pos->xskb_list_node);
+		len = pos->xdp.data_end - pos->xdp.data;
+		xskq_prod_write_desc(xs->rx, xp_get_handle(pos), len,
+				     list_empty(xskb_list) ? 0 : XDP_PKT_CONTD);
+		xp_release(pos);
+	}
+
 	return 0;
 }
 
-static void xsk_copy_xdp(struct xdp_buff *to, struct xdp_buff *from, u32 len)
+static void xsk_copy_xdp_meta(struct xdp_buff *to, struct xdp_buff *from)
 {
-	void *from_buf, *to_buf;
 	u32 metalen;
 
-	if (unlikely(xdp_data_meta_unsupported(from))) {
-		from_buf = from->data;
-		to_buf = to->data;
-		metalen = 0;
+	if (unlikely(xdp_data_meta_unsupported(from)))
+		return;
+
+	metalen = from->data - from->data_meta;
+	memcpy(to->data - metalen, from->data_meta, metalen);
+}
+
+/* Copy @len bytes from offset @off of the packet in @from to @to */
+static void xsk_copy_xdp(void *to, struct xdp_buff *from, u32 off, u32 len)
+{
+	u32 head_len = from->data_end - from->data;
+	struct skb_shared_info *sinfo;
+	u32 copy;
+	int i;
+
+	if (off < head_len) {
+		copy = min(len, head_len - off);
+		memcpy(to, from->data + off, copy);
+		to += copy;
+		len -= copy;
+		off = 0;
 	} else {
-		from_buf = from->data_meta;
-		metalen = from->data - from->data_meta;
-		to_buf = to->data - metalen;
+		off -= head_len;
 	}
 
-	memcpy(to_buf, from_buf, len + metalen);
+	if (!len)
+		return;
+
+	sinfo = xdp_get_shared_info_from_buff(from);
+	for (i = 0; i < sinfo->nr_frags && len; i++) {
+		skb_frag_t *frag = &sinfo->frags[i];
+		u32 size = skb_frag_size(frag);
+
+		if (off >= size) {
+			off -= size;
+			continue;
+		}
+
+		copy = min(len, size - off);
+		memcpy(to, skb_frag_address(frag) + off, copy);
+		to += copy;
+		len -= copy;
+		off = 0;
+	}
 }
 
 static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
-	struct xdp_buff *xsk_xdp;
-	int err;
-	u32 len;
-
-	len = xdp->data_end - xdp->data;
-	if (len > xsk_pool_get_rx_frame_size(xs->pool)) {
+	u32 frame_size = xsk_pool_get_rx_frame_size(xs->pool);
+	struct xdp_buff *bufs[MAX_SKB_FRAGS + 1];
+	u32 len, copied, copy, num_desc, i;
+	struct xdp_buff_xsk *xskb;
+
+	len = xdp_get_buff_len(xdp);
+	num_desc = len ? DIV_ROUND_UP(len, frame_size) : 1;
+	if (num_desc > xs->pool->max_segs) {
 		xs->rx_dropped++;
 		return -ENOSPC;
 	}
 
-	xsk_xdp = xsk_buff_alloc(xs->pool);
-	if (!xsk_xdp) {
-		xs->rx_dropped++;
-		return -ENOMEM;
+	if (xskq_prod_nb_free(xs->rx, num_desc) < num_desc) {
+		xs->rx_queue_full++;
+		return -ENOBUFS;
 	}
 
-	xsk_copy_xdp(xsk_xdp, xdp, len);
-	err = __xsk_rcv_zc(xs, xsk_xdp, len);
-	if (err) {
-		xsk_buff_free(xsk_xdp);
-		return err;
+	for (i = 0; i < num_desc; i++) {
+		bufs[i] = xsk_buff_alloc(xs->pool);
+		if (!bufs[i]) {
+			while (i--)
+				xsk_buff_free(bufs[i]);
+			xs->rx_dropped++;
+			return -ENOMEM;
+		}
+	}
+
+	xsk_copy_xdp_meta(bufs[0], xdp);
+	for (i = 0, copied = 0; i < num_desc; i++, copied += copy) {
+		xskb = container_of(bufs[i], struct xdp_buff_xsk, xdp);
+		copy = min(len - copied, frame_size);
+
+		xsk_copy_xdp(bufs[i]->data, xdp, copied, copy);
+		xskq_prod_write_desc(xs->rx, xp_get_handle(xskb), copy,
+				     i + 1 < num_desc ? XDP_PKT_CONTD : 0);
+		xp_release(xskb);
 	}
+
 	return 0;
 }
 
@@ -355,6 +428,10 @@ static u32 xsk_tx_peek_release_fallback(struct xsk_buff_pool *pool, u32 max_entr
 	return nb_pkts;
 }
 
+/* Only whole packets are handed out. With XDP_USE_SG a packet may take up to
+ * xsk_pool_get_max_segs() descriptors, the ones but the last marked with
+ * XDP_PKT_CONTD, so @nb_pkts has to be at least that.
+ */
 u32 xsk_tx_peek_release_desc_batch(struct xsk_buff_pool *pool, u32 nb_pkts)
 {
 	struct xdp_sock *xs;
@@ -420,6 +497,38 @@ static void xsk_destruct_skb(struct sk_buff *skb)
 	sock_wfree(skb);
 }
 
+/* Umem addresses of the descriptors an skb was built from */
+struct xsk_tx_addrs {
+	u32 num;
+	u64 addrs[];
+};
+
+static void xsk_destruct_skb_mb(struct sk_buff *skb)
+{
+	struct xsk_tx_addrs *tx = skb_shinfo(skb)->destructor_arg;
+	struct xdp_sock *xs = xdp_sk(skb->sk);
+	unsigned long flags;
+	u32 i;
+
+	spin_lock_irqsave(&xs->pool->cq_lock, flags);
+	for (i = 0; i < tx->num; i++)
+		xskq_prod_submit_addr(xs->pool->cq, tx->addrs[i]);
+	spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+
+	kfree(tx);
+	sock_wfree(skb);
+}
+
+/* Free an skb whose descriptors are not to be completed */
+static void xsk_consume_skb(struct sk_buff *skb)
+{
+	if (skb->destructor == xsk_destruct_skb_mb)
+		kfree(skb_shinfo(skb)->destructor_arg);
+	skb->destructor = sock_wfree;
+	/* Free skb without triggering the perf drop trace */
+	consume_skb(skb);
+}
+
 static struct sk_buff *xsk_build_skb_zerocopy(struct xdp_sock *xs,
 					      struct xdp_desc *desc)
 {
@@ -511,6 +620,71 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 	return skb;
 }
 
+/* Copy the chain of descriptors at the head of the Tx ring into one skb.
+ * Returns -EAGAIN if the chain is not completely in the ring yet, and
+ * -EINVAL with the number of descriptors to skip in @nb_descs if it is
+ * broken.
+ */
+static struct sk_buff *xsk_build_skb_mb(struct xdp_sock *xs, u32 *nb_descs)
+{
+	struct xsk_buff_pool *pool = xs->pool;
+	struct net_device *dev = xs->dev;
+	u32 hr, tr, len = 0, off = 0, n = 0, i;
+	struct xsk_tx_addrs *tx;
+	struct xdp_desc desc;
+	struct sk_buff *skb;
+	void *buffer;
+	int err;
+
+	do {
+		if (!xskq_cons_peek_desc_n(xs->tx, n, &desc))
+			return ERR_PTR(-EAGAIN);
+
+		n++;
+		if (!xskq_cons_is_valid_desc(xs->tx, &desc, pool) ||
+		    n > pool->max_segs) {
+			*nb_descs = n;
+			return ERR_PTR(-EINVAL);
+		}
+
+		len += desc.len;
+	} while (xp_mb_desc(&desc));
+
+	tx = kmalloc(struct_size(tx, addrs, n), GFP_KERNEL);
+	if (!tx)
+		return ERR_PTR(-ENOMEM);
+
+	hr = max(NET_SKB_PAD, L1_CACHE_ALIGN(dev->needed_headroom));
+	tr = dev->needed_tailroom;
+
+	skb = sock_alloc_send_skb(&xs->sk, hr + len + tr, 1, &err);
+	if (unlikely(!skb)) {
+		kfree(tx);
+		return ERR_PTR(err);
+	}
+
+	skb_reserve(skb, hr);
+	skb_put(skb, len);
+
+	for (i = 0; i < n; i++) {
+		xskq_cons_peek_desc_n(xs->tx, i, &desc);
+		buffer = xsk_buff_raw_get_data(pool, desc.addr);
+		skb_copy_to_linear_data_offset(skb, off, buffer, desc.len);
+		tx->addrs[i] = desc.addr;
+		off += desc.len;
+	}
+	tx->num = n;
+	*nb_descs = n;
+
+	skb->dev = dev;
+	skb->priority = xs->sk.sk_priority;
+	skb->mark = xs->sk.sk_mark;
+	skb_shinfo(skb)->destructor_arg = tx;
+	skb->destructor = xsk_destruct_skb_mb;
+
+	return skb;
+}
+
 static int xsk_generic_xmit(struct sock *sk)
 {
 	struct xdp_sock *xs = xdp_sk(sk);
@@ -533,46 +707,65 @@ static int xsk_generic_xmit(struct sock *sk)
 		goto out;
 
 	while (xskq_cons_peek_desc(xs->tx, &desc, xs->pool)) {
+		u32 nb_descs = 1;
+
 		if (max_batch-- == 0) {
 			err = -EAGAIN;
 			goto out;
 		}
 
+		skb = NULL;
+		if (xp_mb_desc(&desc)) {
+			skb = xsk_build_skb_mb(xs, &nb_descs);
+			if (IS_ERR(skb)) {
+				err = PTR_ERR(skb);
+				/* -EAGAIN: rest of the packet still to come */
+				if (err != -EINVAL)
+					goto out;
+
+				xskq_cons_release_n(xs->tx, nb_descs);
+				err = 0;
+				continue;
+			}
+		}
+
 		/* This is the backpressure mechanism for the Tx path.
 		 * Reserve space in the completion queue and only proceed
 		 * if there is space in it. This avoids having to implement
 		 * any buffering in the Tx path.
 		 */
 		spin_lock_irqsave(&xs->pool->cq_lock, flags);
-		if (xskq_prod_reserve(xs->pool->cq)) {
+		if (xskq_prod_reserve_n(xs->pool->cq, nb_descs)) {
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+			if (skb)
+				xsk_consume_skb(skb);
 			goto out;
 		}
 		spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 
-		skb = xsk_build_skb(xs, &desc);
-		if (IS_ERR(skb)) {
-			err = PTR_ERR(skb);
-			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
-			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			goto out;
+		if (!skb) {
+			skb = xsk_build_skb(xs, &desc);
+			if (IS_ERR(skb)) {
+				err = PTR_ERR(skb);
+				spin_lock_irqsave(&xs->pool->cq_lock, flags);
+				xskq_prod_cancel(xs->pool->cq);
+				spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+				goto out;
+			}
 		}
 
 		err = __dev_direct_xmit(skb, xs->queue_id);
 		if  (err == NETDEV_TX_BUSY) {
 			/* Tell user-space to retry the send */
-			skb->destructor = sock_wfree;
 			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
+			xskq_prod_cancel_n(xs->pool->cq, nb_descs);
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			/* Free skb without triggering the perf drop trace */
-			consume_skb(skb);
+			xsk_consume_skb(skb);
 			err = -EAGAIN;
 			goto out;
 		}
 
-		xskq_cons_release(xs->tx);
+		xskq_cons_release_n(xs->tx, nb_descs);
 		/* Ignore NET_XMIT_CN as packet might have been sent */
 		if (err == NET_XMIT_DROP) {
 			/* SKB completed but not sent */
@@ -889,7 +1082,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	flags = sxdp->sxdp_flags;
 	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
-		      XDP_USE_NEED_WAKEUP))
+		      XDP_USE_NEED_WAKEUP | XDP_USE_SG))
 		return -EINVAL;
 
 	rtnl_lock();
@@ -917,7 +1110,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		struct socket *sock;
 
 		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
-		    (flags & XDP_USE_NEED_WAKEUP)) {
+		    (flags & XDP_USE_NEED_WAKEUP) || (flags & XDP_USE_SG)) {
 			/* Cannot specify flags for shared sockets. */
 			err = -EINVAL;
 			goto out_unlock;
@@ -971,6 +1164,15 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 				goto out_unlock;
 			}
 
+			/* Packets must not be split across the Tx rings
+			 * of several sockets.
+			 */
+			if (umem_xs->pool->sg) {
+				err = -EOPNOTSUPP;
+				sockfd_put(sock);
+				goto out_unlock;
+			}
+
 			xp_get_pool(umem_xs->pool);
 			xs->pool = umem_xs->pool;
 
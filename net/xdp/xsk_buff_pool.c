@@ -83,9 +83,11 @@ struct xsk_buff_pool *xp_create_and_assign_umem(struct xdp_sock *xs,
 	pool->unaligned = unaligned;
 	pool->frame_len = umem->chunk_size - umem->headroom -
 		XDP_PACKET_HEADROOM;
+	pool->max_segs = 1;
 	pool->umem = umem;
 	pool->addrs = umem->addrs;
 	INIT_LIST_HEAD(&pool->free_list);
+	INIT_LIST_HEAD(&pool->xskb_list);
 	INIT_LIST_HEAD(&pool->xsk_tx_list);
 	spin_lock_init(&pool->xsk_tx_list_lock);
 	spin_lock_init(&pool->cq_lock);
@@ -99,6 +101,7 @@ struct xsk_buff_pool *xp_create_and_assign_umem(struct xdp_sock *xs,
 		xskb->pool = pool;
 		xskb->xdp.frame_sz = umem->chunk_size - umem->headroom;
 		INIT_LIST_HEAD(&xskb->free_list_node);
+		INIT_LIST_HEAD(&xskb->xskb_list_node);
 		if (pool->unaligned)
 			pool->free_heads[i] = xskb;
 		else
@@ -166,6 +169,10 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 
 	if (flags & XDP_USE_NEED_WAKEUP)
 		pool->uses_need_wakeup = true;
+	if (flags & XDP_USE_SG) {
+		pool->sg = true;
+		pool->max_segs = MAX_SKB_FRAGS + 1;
+	}
 	/* Tx needs to be explicitly woken up the first time.  Also
 	 * for supporting drivers that do not implement this
 	 * feature. They will always have to call sendto() or poll().
@@ -184,6 +191,15 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 		goto err_unreg_pool;
 	}
 
+	/* The driver has to chain buffers itself in zero-copy mode, and
+	 * chunks are handed to XDP programs as page fragments, so they
+	 * must not straddle pages.
+	 */
+	if (pool->sg && (netdev->xdp_zc_max_segs == 1 || pool->unaligned)) {
+		err = -EOPNOTSUPP;
+		goto err_unreg_pool;
+	}
+
 	bpf.command = XDP_SETUP_XSK_POOL;
 	bpf.xsk.pool = pool;
 	bpf.xsk.queue_id = queue_id;
@@ -198,6 +214,9 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 		goto err_unreg_xsk;
 	}
 	pool->umem->zc = true;
+	if (pool->sg)
+		pool->max_segs = min_t(u32, netdev->xdp_zc_max_segs,
+				       MAX_SKB_FRAGS + 1);
 	return 0;
 
 err_unreg_xsk:
@@ -225,6 +244,8 @@ int xp_assign_dev_shared(struct xsk_buff_pool *pool, struct xdp_sock *umem_xs,
 	flags = umem->zc ? XDP_ZEROCOPY : XDP_COPY;
 	if (umem_xs->pool->uses_need_wakeup)
 		flags |= XDP_USE_NEED_WAKEUP;
+	if (umem_xs->pool->sg)
+		flags |= XDP_USE_SG;
 
 	return xp_assign_dev(pool, dev, queue_id, flags);
 }
@@ -472,9 +493,84 @@ static bool xp_check_aligned(struct xsk_buff_pool *pool, u64 *addr)
 	return *addr < pool->addrs_cnt;
 }
 
+static struct xdp_buff_xsk *xp_get_xskb(struct xsk_buff_pool *pool, u64 addr)
+{
+	struct xdp_buff_xsk *xskb;
+
+	if (pool->unaligned) {
+		xskb = pool->free_heads[--pool->free_heads_cnt];
+		xp_init_xskb_addr(xskb, pool, addr);
+		if (pool->dma_pages_cnt)
+			xp_init_xskb_dma(xskb, pool, pool->dma_pages, addr);
+	} else {
+		xskb = &pool->heads[xp_aligned_extract_idx(pool, addr)];
+	}
+
+	return xskb;
+}
+
+#define XP_SPARE_BATCH 64
+
+/* With XDP_UMEM_BALANCE_FILL_FLAG, a queue that has more than half of its fill
+ * ring waiting passes the excess on to the umem, a batch at a time, and a
+ * queue whose fill ring runs dry takes buffers from there.
+ */
+static void xp_give_spare(struct xsk_buff_pool *pool)
+{
+	struct xdp_umem *umem = pool->umem;
+	struct xsk_queue *fq = pool->fq;
+	u32 keep = fq->nentries / 2;
+	u32 nb, i;
+	u64 addr;
+
+	nb = xskq_cons_nb_entries(fq, keep + XP_SPARE_BATCH);
+	if (nb <= keep)
+		return;
+	nb -= keep;
+
+	spin_lock_bh(&umem->spare_lock);
+	nb = min(nb, umem->chunks - umem->spare_cnt);
+	for (i = 0; i < nb; i++) {
+		__xskq_cons_read_addr_unchecked(fq, fq->cached_cons + i, &addr);
+		umem->spare[umem->spare_cnt++] = addr;
+	}
+	spin_unlock_bh(&umem->spare_lock);
+
+	xskq_cons_release_n(fq, nb);
+}
+
+static u32 xp_take_spare(struct xsk_buff_pool *pool, struct xdp_buff **xdp,
+			 u32 max)
+{
+	struct xdp_umem *umem = pool->umem;
+	u32 nb_entries = 0;
+	u64 addr;
+	bool ok;
+
+	if (!READ_ONCE(umem->spare_cnt))
+		return 0;
+
+	spin_lock_bh(&umem->spare_lock);
+	while (nb_entries < max && umem->spare_cnt && pool->free_heads_cnt) {
+		addr = umem->spare[--umem->spare_cnt];
+
+		ok = pool->unaligned ? xp_check_unaligned(pool, &addr) :
+			xp_check_aligned(pool, &addr);
+		if (unlikely(!ok))
+			continue;
+
+		*xdp++ = &xp_get_xskb(pool, addr)->xdp;
+		nb_entries++;
+	}
+	spin_unlock_bh(&umem->spare_lock);
+
+	return nb_entries;
+}
+
 static struct xdp_buff_xsk *__xp_alloc(struct xsk_buff_pool *pool)
 {
 	struct xdp_buff_xsk *xskb;
+	struct xdp_buff *xdp;
 	u64 addr;
 	bool ok;
 
@@ -484,6 +580,8 @@ static struct xdp_buff_xsk *__xp_alloc(struct xsk_buff_pool *pool)
 	for (;;) {
 		if (!xskq_cons_peek_addr_unchecked(pool->fq, &addr)) {
 			pool->fq->queue_empty_descs++;
+			if (pool->umem->spare && xp_take_spare(pool, &xdp, 1))
+				return container_of(xdp, struct xdp_buff_xsk, xdp);
 			return NULL;
 		}
 
@@ -497,16 +595,11 @@ static struct xdp_buff_xsk *__xp_alloc(struct xsk_buff_pool *pool)
 		break;
 	}
 
-	if (pool->unaligned) {
-		xskb = pool->free_heads[--pool->free_heads_cnt];
-		xp_init_xskb_addr(xskb, pool, addr);
-		if (pool->dma_pages_cnt)
-			xp_init_xskb_dma(xskb, pool, pool->dma_pages, addr);
-	} else {
-		xskb = &pool->heads[xp_aligned_extract_idx(pool, addr)];
-	}
-
+	xskb = xp_get_xskb(pool, addr);
 	xskq_cons_release(pool->fq);
+
+	if (pool->umem->spare)
+		xp_give_spare(pool);
 	return xskb;
 }
 
@@ -527,6 +620,7 @@ struct xdp_buff *xp_alloc(struct xsk_buff_pool *pool)
 
 	xskb->xdp.data = xskb->xdp.data_hard_start + XDP_PACKET_HEADROOM;
 	xskb->xdp.data_meta = xskb->xdp.data;
+	xskb->xdp.flags = 0;
 
 	if (pool->dma_need_sync) {
 		dma_sync_single_range_for_device(pool->dev, xskb->dma, 0,
@@ -563,15 +657,7 @@ static u32 xp_alloc_new_from_fq(struct xsk_buff_pool *pool, struct xdp_buff **xd
 			continue;
 		}
 
-		if (pool->unaligned) {
-			xskb = pool->free_heads[--pool->free_heads_cnt];
-			xp_init_xskb_addr(xskb, pool, addr);
-			if (pool->dma_pages_cnt)
-				xp_init_xskb_dma(xskb, pool, pool->dma_pages, addr);
-		} else {
-			xskb = &pool->heads[xp_aligned_extract_idx(pool, addr)];
-		}
-
+		xskb = xp_get_xskb(pool, addr);
 		*xdp = &xskb->xdp;
 		xdp++;
 	}
@@ -627,6 +713,14 @@ u32 xp_alloc_batch(struct xsk_buff_pool *pool, struct xdp_buff **xdp, u32 max)
 	if (!nb_entries2)
 		pool->fq->queue_empty_descs++;
 
+	if (unlikely(pool->umem->spare)) {
+		if (nb_entries2 < max)
+			nb_entries2 += xp_take_spare(pool, xdp + nb_entries2,
+						     max - nb_entries2);
+		else
+			xp_give_spare(pool);
+	}
+
 	return nb_entries1 + nb_entries2;
 }
 EXPORT_SYMBOL(xp_alloc_batch);
@@ -635,7 +729,10 @@ bool xp_can_alloc(struct xsk_buff_pool *pool, u32 count)
 {
 	if (pool->free_list_cnt >= count)
 		return true;
-	return xskq_cons_has_entries(pool->fq, count - pool->free_list_cnt);
+	count -= pool->free_list_cnt;
+	if (pool->umem->spare)
+		count -= min(count, READ_ONCE(pool->umem->spare_cnt));
+	return !count || xskq_cons_has_entries(pool->fq, count);
 }
 EXPORT_SYMBOL(xp_can_alloc);
 
@@ -144,8 +144,6 @@ static inline bool xp_aligned_validate_desc(struct xsk_buff_pool *pool,
 	if (chunk >= pool->addrs_cnt)
 		return false;
 
-	if (desc->options)
-		return false;
 	return true;
 }
 
@@ -164,14 +162,15 @@ static inline bool xp_unaligned_validate_desc(struct xsk_buff_pool *pool,
 	    xp_desc_crosses_non_contig_pg(pool, addr, desc->len))
 		return false;
 
-	if (desc->options)
-		return false;
 	return true;
 }
 
 static inline bool xp_validate_desc(struct xsk_buff_pool *pool,
 				    struct xdp_desc *desc)
 {
+	if (desc->options & ~(pool->sg ? XDP_PKT_CONTD : 0))
+		return false;
+
 	return pool->unaligned ? xp_unaligned_validate_desc(pool, desc) :
 		xp_aligned_validate_desc(pool, desc);
 }
@@ -210,29 +209,51 @@ static inline void xskq_cons_release_n(struct xsk_queue *q, u32 cnt)
 	q->cached_cons += cnt;
 }
 
+/* Only whole packets are read. A packet with an invalid descriptor, or made
+ * of more than pool->max_segs of them, is skipped as a whole, and one not
+ * completely produced yet is left in the ring for the next call.
+ */
 static inline u32 xskq_cons_read_desc_batch(struct xsk_queue *q, struct xsk_buff_pool *pool,
 					    u32 max)
 {
-	u32 cached_cons = q->cached_cons, nb_entries = 0;
+	u32 cached_cons = q->cached_cons, cons_end = cached_cons;
 	struct xdp_desc *descs = pool->tx_descs;
+	u32 nb_entries = 0, nr_frags = 0;
+	bool skip = false;
 
 	while (cached_cons != q->cached_prod && nb_entries < max) {
 		struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
 		u32 idx = cached_cons & q->ring_mask;
+		bool contd;
 
 		descs[nb_entries] = ring->desc[idx];
-		if (unlikely(!xskq_cons_is_valid_desc(q, &descs[nb_entries], pool))) {
-			/* Skip the entry */
-			cached_cons++;
+		contd = pool->sg && xp_mb_desc(&descs[nb_entries]);
+		cached_cons++;
+
+		if (unlikely(skip ||
+			     !xskq_cons_is_valid_desc(q, &descs[nb_entries], pool) ||
+			     nr_frags == pool->max_segs)) {
+			/* Skip the entry and the rest of its packet */
+			nb_entries -= nr_frags;
+			nr_frags = 0;
+			skip = contd;
+			if (!contd)
+				cons_end = cached_cons;
 			continue;
 		}
 
 		nb_entries++;
-		cached_cons++;
+		if (contd) {
+			nr_frags++;
+		} else {
+			nr_frags = 0;
+			cons_end = cached_cons;
+		}
 	}
 
-	/* Release valid plus any invalid entries */
-	xskq_cons_release_n(q, cached_cons - q->cached_cons);
+	/* Release whole packets plus any invalid entries */
+	nb_entries -= nr_frags;
+	xskq_cons_release_n(q, cons_end - q->cached_cons);
 	return nb_entries;
 }
 
@@ -280,6 +301,22 @@ static inline bool xskq_cons_peek_addr_unchecked(struct xsk_queue *q, u64 *addr)
 	return xskq_cons_read_addr_unchecked(q, addr);
 }
 
+/* Look at the n:th entry not consumed yet, without validating or consuming it */
+static inline bool xskq_cons_peek_desc_n(struct xsk_queue *q, u32 n,
+					 struct xdp_desc *desc)
+{
+	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
+
+	if (q->cached_prod - q->cached_cons <= n) {
+		__xskq_cons_peek(q);
+		if (q->cached_prod - q->cached_cons <= n)
+			return false;
+	}
+
+	*desc = ring->desc[(q->cached_cons + n) & q->ring_mask];
+	return true;
+}
+
 static inline bool xskq_cons_peek_desc(struct xsk_queue *q,
 				       struct xdp_desc *desc,
 				       struct xsk_buff_pool *pool)
@@ -330,6 +367,11 @@ static inline void xskq_prod_cancel(struct xsk_queue *q)
 	q->cached_prod--;
 }
 
+static inline void xskq_prod_cancel_n(struct xsk_queue *q, u32 cnt)
+{
+	q->cached_prod -= cnt;
+}
+
 static inline int xskq_prod_reserve(struct xsk_queue *q)
 {
 	if (xskq_prod_is_full(q))
@@ -340,6 +382,16 @@ static inline int xskq_prod_reserve(struct xsk_queue *q)
 	return 0;
 }
 
+static inline int xskq_prod_reserve_n(struct xsk_queue *q, u32 cnt)
+{
+	if (xskq_prod_nb_free(q, cnt) < cnt)
+		return -ENOSPC;
+
+	/* A, matches D */
+	q->cached_prod += cnt;
+	return 0;
+}
+
 static inline int xskq_prod_reserve_addr(struct xsk_queue *q, u64 addr)
 {
 	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
@@ -365,20 +417,26 @@ static inline void xskq_prod_write_addr_batch(struct xsk_queue *q, struct xdp_de
 	q->cached_prod = cached_prod;
 }
 
-static inline int xskq_prod_reserve_desc(struct xsk_queue *q,
-					 u64 addr, u32 len)
+static inline void xskq_prod_write_desc(struct xsk_queue *q,
+					u64 addr, u32 len, u32 flags)
 {
 	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
 	u32 idx;
 
-	if (xskq_prod_is_full(q))
-		return -ENOBUFS;
-
 	/* A, matches D */
 	idx = q->cached_prod++ & q->ring_mask;
 	ring->desc[idx].addr = addr;
 	ring->desc[idx].len = len;
+	ring->desc[idx].options = flags;
+}
+
+static inline int xskq_prod_reserve_desc(struct xsk_queue *q,
+					 u64 addr, u32 len, u32 flags)
+{
+	if (xskq_prod_is_full(q))
+		return -ENOBUFS;
 
+	xskq_prod_write_desc(q, addr, len, flags);
 	return 0;
 }
 
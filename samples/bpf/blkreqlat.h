@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _SAMPLES_BPF_BLKREQLAT_H
+#define _SAMPLES_BPF_BLKREQLAT_H
+
+#define MAX_INFLIGHT	65536
+#define MAX_SLOTS	24	/* log2 buckets of microseconds */
+
+enum {
+	STAGE_QUEUE,
+	STAGE_QUEUE_RQ,
+	STAGE_DEVICE,
+	STAGE_TOTAL,
+	STAGE_MAX,
+};
+
+#endif /* _SAMPLES_BPF_BLKREQLAT_H */
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Break the latency of block requests down by request state, from the
+ * block_rq_* raw tracepoints:
+ *
+ *   queue:    block_rq_alloc    -> block_rq_dispatch
+ *   queue_rq: block_rq_dispatch -> block_rq_issue
+ *   device:   block_rq_issue    -> block_rq_complete
+ *
+ * queue_rq only covers ->queue_rq() up to blk_mq_start_request(); the
+ * driver's own submission work after that counts towards device.
+ *
+ * Raw tracepoints are used so that no event is formatted into the trace
+ * buffer, and the histograms are per-cpu so that completions on different
+ * CPUs do not bounce a cache line.
+ */
+#include <linux/version.h>
+#include <linux/ptrace.h>
+#include <uapi/linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+#include "blkreqlat.h"
+
+struct rq_ts {
+	u64 alloc;
+	u64 dispatch;
+	u64 issue;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, u64);
+	__type(value, struct rq_ts);
+	__uint(max_entries, MAX_INFLIGHT);
+} inflight SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__type(key, u32);
+	__type(value, u64);
+	__uint(max_entries, STAGE_MAX * MAX_SLOTS);
+} hist SEC(".maps");
+
+static unsigned int log2(unsigned int v)
+{
+	unsigned int r;
+	unsigned int shift;
+
+	r = (v > 0xFFFF) << 4; v >>= r;
+	shift = (v > 0xFF) << 3; v >>= shift; r |= shift;
+	shift = (v > 0xF) << 2; v >>= shift; r |= shift;
+	shift = (v > 0x3) << 1; v >>= shift; r |= shift;
+	r |= (v >> 1);
+
+	return r;
+}
+
+static unsigned int log2l(u64 v)
+{
+	unsigned int hi = v >> 32;
+
+	if (hi)
+		return log2(hi) + 32;
+	else
+		return log2(v);
+}
+
+static void account(u32 stage, u64 start, u64 end)
+{
+	u32 key, slot;
+	u64 *val;
+
+	if (!start || end < start)
+		return;
+
+	slot = log2l((end - start) / 1000);
+	if (slot >= MAX_SLOTS)
+		slot = MAX_SLOTS - 1;
+
+	key = stage * MAX_SLOTS + slot;
+	val = bpf_map_lookup_elem(&hist, &key);
+	if (val)
+		*val += 1;
+}
+
+SEC("raw_tracepoint/block_rq_alloc")
+int on_alloc(struct bpf_raw_tracepoint_args *ctx)
+{
+	struct rq_ts ts = { .alloc = bpf_ktime_get_ns() };
+	u64 rq = ctx->args[0];
+
+	bpf_map_update_elem(&inflight, &rq, &ts, BPF_ANY);
+	return 0;
+}
+
+SEC("raw_tracepoint/block_rq_dispatch")
+int on_dispatch(struct bpf_raw_tracepoint_args *ctx)
+{
+	u64 rq = ctx->args[0];
+	struct rq_ts *ts;
+
+	ts = bpf_map_lookup_elem(&inflight, &rq);
+	if (ts)
+		ts->dispatch = bpf_ktime_get_ns();
+	return 0;
+}
+
+SEC("raw_tracepoint/block_rq_issue")
+int on_issue(struct bpf_raw_tracepoint_args *ctx)
+{
+	u64 rq = ctx->args[0];
+	struct rq_ts *ts;
+
+	ts = bpf_map_lookup_elem(&inflight, &rq);
+	if (ts)
+		ts->issue = bpf_ktime_get_ns();
+	return 0;
+}
+
+/* A requeued request goes through dispatch and issue again */
+SEC("raw_tracepoint/block_rq_requeue")
+int on_requeue(struct bpf_raw_tracepoint_args *ctx)
+{
+	u64 rq = ctx->args[0];
+	struct rq_ts *ts;
+
+	ts = bpf_map_lookup_elem(&inflight, &rq);
+	if (ts) {
+		ts->dispatch = 0;
+		ts->issue = 0;
+	}
+	return 0;
+}
+
+SEC("raw_tracepoint/block_rq_complete")
+int on_complete(struct bpf_raw_tracepoint_args *ctx)
+{
+	u64 now = bpf_ktime_get_ns();
+	u64 rq = ctx->args[0];
+	struct rq_ts *ts;
+
+	ts = bpf_map_lookup_elem(&inflight, &rq);
+	if (!ts)
+		return 0;
+
+	account(STAGE_QUEUE, ts->alloc, ts->dispatch);
+	account(STAGE_QUEUE_RQ, ts->dispatch, ts->issue);
+	account(STAGE_DEVICE, ts->issue, now);
+	account(STAGE_TOTAL, ts->alloc, now);
+
+	bpf_map_delete_elem(&inflight, &rq);
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
+u32 _version SEC("version") = LINUX_VERSION_CODE;
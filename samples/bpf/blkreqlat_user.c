@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Print the latency histograms collected by blkreqlat_kern.c, per request
+ * state, every few seconds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+#include "blkreqlat.h"
+
+#define MAX_STARS	40
+#define MAX_PROGS	5
+
+static const char * const stage_names[STAGE_MAX] = {
+	[STAGE_QUEUE]		= "queue (alloc -> dispatch)",
+	[STAGE_QUEUE_RQ]	= "queue_rq (dispatch -> issue)",
+	[STAGE_DEVICE]		= "device (issue -> complete)",
+	[STAGE_TOTAL]		= "total (alloc -> complete)",
+};
+
+static unsigned long long hist[STAGE_MAX][MAX_SLOTS];
+
+static void stars(char *str, long long val, long long max, int width)
+{
+	int i;
+
+	for (i = 0; i < (width * val / max) - 1 && i < width - 1; i++)
+		str[i] = '*';
+	if (val > max)
+		str[i - 1] = '+';
+	str[i] = '\0';
+}
+
+static void print_hist(void)
+{
+	char starstr[MAX_STARS];
+	unsigned long long max;
+	int s, i;
+
+	/* clear screen */
+	printf("\033[2J");
+
+	for (s = 0; s < STAGE_MAX; s++) {
+		max = 0;
+		for (i = 0; i < MAX_SLOTS; i++)
+			if (hist[s][i] > max)
+				max = hist[s][i];
+		if (!max)
+			continue;
+
+		printf("%s\n", stage_names[s]);
+		printf("      usecs          : count     distribution\n");
+		for (i = 0; i < MAX_SLOTS; i++) {
+			stars(starstr, hist[s][i], max, MAX_STARS);
+			printf("%8ld -> %-8ld : %-8llu |%-*s|\n",
+			       (1l << i) >> 1, (1l << i) - 1,
+			       hist[s][i], MAX_STARS, starstr);
+		}
+	}
+}
+
+static int get_data(int fd, int nr_cpus)
+{
+	unsigned long long values[nr_cpus];
+	__u32 key;
+	int s, i, c;
+
+	for (s = 0; s < STAGE_MAX; s++) {
+		for (i = 0; i < MAX_SLOTS; i++) {
+			key = s * MAX_SLOTS + i;
+			if (bpf_map_lookup_elem(fd, &key, values))
+				return -1;
+
+			hist[s][i] = 0;
+			for (c = 0; c < nr_cpus; c++)
+				hist[s][i] += values[c];
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct bpf_link *links[MAX_PROGS];
+	struct bpf_program *prog;
+	struct bpf_object *obj;
+	char filename[256];
+	int map_fd, nr_cpus, i = 0;
+
+	nr_cpus = libbpf_num_possible_cpus();
+	if (nr_cpus < 0) {
+		fprintf(stderr, "ERROR: getting the number of CPUs failed\n");
+		return 1;
+	}
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+	obj = bpf_object__open_file(filename, NULL);
+	if (libbpf_get_error(obj)) {
+		fprintf(stderr, "ERROR: opening BPF object file failed\n");
+		return 1;
+	}
+
+	/* load BPF program */
+	if (bpf_object__load(obj)) {
+		fprintf(stderr, "ERROR: loading BPF object file failed\n");
+		goto cleanup;
+	}
+
+	map_fd = bpf_object__find_map_fd_by_name(obj, "hist");
+	if (map_fd < 0) {
+		fprintf(stderr, "ERROR: finding a map in obj file failed\n");
+		goto cleanup;
+	}
+
+	bpf_object__for_each_program(prog, obj) {
+		links[i] = bpf_program__attach(prog);
+		if (libbpf_get_error(links[i])) {
+			fprintf(stderr, "ERROR: bpf_program__attach failed\n");
+			links[i] = NULL;
+			goto cleanup;
+		}
+		i++;
+	}
+
+	while (1) {
+		sleep(5);
+		if (get_data(map_fd, nr_cpus))
+			break;
+		print_hist();
+	}
+
+cleanup:
+	for (i--; i >= 0; i--)
+		bpf_link__destroy(links[i]);
+
+	bpf_object__close(obj);
+	return 0;
+}
@@ -0,0 +1,9 @@
+cmd_scripts/unifdef := gcc -Wp,-MMD,scripts/.unifdef.d -Wall -Wmissing-prototypes -Wstrict-prototypes -O2 -fomit-frame-pointer -std=gnu11 -Wdeclaration-after-statement         -o scripts/unifdef scripts/unifdef.c   
+
+source_scripts/unifdef := scripts/unifdef.c
+
+deps_scripts/unifdef := \
+
+scripts/unifdef: $(deps_scripts/unifdef)
+
+$(deps_scripts/unifdef):
@@ -106,6 +106,7 @@ FEATURE_TESTS_EXTRA :=                  \
          libbpf-bpf_program__set_insns  \
          libbpf-bpf_create_map		\
          libpfm4                        \
+         liburing                       \
          libdebuginfod			\
          clang-bpf-co-re
 
@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <liburing.h>
+
+int main(void)
+{
+	struct io_uring ring;
+
+	if (io_uring_queue_init(8, &ring, 0))
+		return 1;
+	io_uring_queue_exit(&ring);
+
+	return 0;
+}
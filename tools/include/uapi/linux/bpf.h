@@ -96,8 +96,17 @@ enum bpf_cgroup_iter_order {
 };
 
 union bpf_iter_link_info {
+	/* An iterator over map elements or over all tasks can be split
+	 * into nr_shards iterators that each visit a disjoint part of the
+	 * elements or tasks, so that they can be read in parallel.  This
+	 * one visits shard @shard.  Map elements are split into ranges of
+	 * buckets or indexes, tasks by their tid modulo nr_shards.  A zero
+	 * nr_shards means the iterator visits everything.
+	 */
 	struct {
 		__u32	map_fd;
+		__u32	shard;
+		__u32	nr_shards;
 	} map;
 	struct {
 		enum bpf_cgroup_iter_order order;
@@ -115,6 +124,8 @@ union bpf_iter_link_info {
 		__u32	tid;
 		__u32	pid;
 		__u32	pid_fd;
+		__u32	shard;
+		__u32	nr_shards;
 	} task;
 };
 
@@ -943,6 +954,7 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_BLOOM_FILTER,
 	BPF_MAP_TYPE_USER_RINGBUF,
 	BPF_MAP_TYPE_CGRP_STORAGE,
+	BPF_MAP_TYPE_RHASH,
 };
 
 /* Note that tracing related programs such as
@@ -1332,6 +1344,12 @@ union bpf_attr {
 		 * BPF_MAP_TYPE_BLOOM_FILTER - the lowest 4 bits indicate the
 		 * number of hash functions (if 0, the bloom filter will default
 		 * to using 5 hash functions).
+		 *
+		 * BPF_MAP_TYPE_RINGBUF - wakeup watermark in bytes. Consumers
+		 * are only notified once that much data is waiting to be
+		 * consumed (0, the default, notifies them as soon as there is
+		 * data), or at the latest about 10ms after a record was
+		 * submitted. Must be smaller than max_entries.
 		 */
 		__u64	map_extra;
 	};
@@ -46,6 +46,19 @@
 /* Specify an eventfd file descriptor to signal on log write. */
 #define VHOST_SET_LOG_FD _IOW(VHOST_VIRTIO, 0x07, int)
 
+/* By default a device has a single worker thread that all of its
+ * virtqueues share.  VHOST_NEW_WORKER creates an additional worker that
+ * can then be bound to one or more virtqueues with
+ * VHOST_ATTACH_VRING_WORKER.  It must be called by the owner, after
+ * VHOST_SET_OWNER; the new thread joins the owner's cgroups and uses its
+ * address space.  The worker id is returned in vhost_worker_state.
+ */
+#define VHOST_NEW_WORKER _IOR(VHOST_VIRTIO, 0x8, struct vhost_worker_state)
+/* Free a worker created with VHOST_NEW_WORKER.  It must not be attached
+ * to any virtqueue.
+ */
+#define VHOST_FREE_WORKER _IOW(VHOST_VIRTIO, 0x9, struct vhost_worker_state)
+
 /* Ring setup. */
 /* Set number of descriptors in ring. This parameter can not
  * be modified while ring is running (bound to a device). */
@@ -71,6 +84,15 @@
 #define VHOST_SET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x13, struct vhost_vring_state)
 #define VHOST_GET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x14, struct vhost_vring_state)
 
+/* Run the virtqueue's work on the given worker.  Work already queued on
+ * the previous worker is completed first.
+ */
+#define VHOST_ATTACH_VRING_WORKER _IOW(VHOST_VIRTIO, 0x15,		\
+				       struct vhost_vring_worker)
+/* Return the id of the worker the virtqueue runs on. */
+#define VHOST_GET_VRING_WORKER _IOWR(VHOST_VIRTIO, 0x16,		\
+				     struct vhost_vring_worker)
+
 /* The following ioctls use eventfd file descriptors to signal and poll
  * for events. */
 
@@ -70,6 +70,9 @@
 #ifdef HAVE_EVENTFD_SUPPORT
 #include <sys/eventfd.h>
 #endif
+#ifdef HAVE_LIBURING_SUPPORT
+#include <liburing.h>
+#endif
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -117,6 +120,11 @@ struct record_thread {
 	u64			bytes_written;
 	u64			bytes_transferred;
 	u64			bytes_compressed;
+#ifdef HAVE_LIBURING_SUPPORT
+	struct io_uring		uring;
+	bool			uring_ready;
+	int			uring_inflight;
+#endif
 };
 
 static __thread struct record_thread *thread;
@@ -242,19 +250,8 @@ static bool record__output_max_size_exceeded(struct record *rec)
 	       (record__bytes_written(rec) >= rec->output_max_size);
 }
 
-static int record__write(struct record *rec, struct mmap *map __maybe_unused,
-			 void *bf, size_t size)
+static void record__written(struct record *rec, struct mmap *map, size_t size)
 {
-	struct perf_data_file *file = &rec->session->data->file;
-
-	if (map && map->file)
-		file = map->file;
-
-	if (perf_data_file__write(file, bf, size) < 0) {
-		pr_err("failed to write perf data, error: %m\n");
-		return -1;
-	}
-
 	if (map && map->file)
 		thread->bytes_written += size;
 	else
@@ -269,7 +266,22 @@ static int record__write(struct record *rec, struct mmap *map __maybe_unused,
 
 	if (switch_output_size(rec))
 		trigger_hit(&switch_output_trigger);
+}
+
+static int record__write(struct record *rec, struct mmap *map __maybe_unused,
+			 void *bf, size_t size)
+{
+	struct perf_data_file *file = &rec->session->data->file;
+
+	if (map && map->file)
+		file = map->file;
 
+	if (perf_data_file__write(file, bf, size) < 0) {
+		pr_err("failed to write perf data, error: %m\n");
+		return -1;
+	}
+
+	record__written(rec, map, size);
 	return 0;
 }
 
@@ -548,6 +560,230 @@ static int record__aio_enabled(struct record *rec)
 	return rec->opts.nr_cblocks > 0;
 }
 
+#ifdef HAVE_LIBURING_SUPPORT
+#define URING_ENTRIES 256
+
+/*
+ * With --uring the data is written straight from the ring buffer, without
+ * copying it aside like the aio mode does. The ring buffer space is hence
+ * given back to the kernel, map->core.prev moved to map->uring.head, only
+ * once all the writes queued for the map completed. Until then, the map is
+ * skipped, the kernel keeps filling the rest of the ring buffer, and
+ * the thread goes on with the other maps.
+ *
+ * Each record thread has its own io_uring, used for all its maps.
+ */
+static int record__uring_init(void)
+{
+	int ret;
+
+	if (thread->uring_ready)
+		return 0;
+
+	ret = io_uring_queue_init(URING_ENTRIES, &thread->uring, 0);
+	if (ret < 0) {
+		pr_err("failed to set up io_uring, error: %s\n", strerror(-ret));
+		return -1;
+	}
+
+	thread->uring_ready = true;
+	return 0;
+}
+
+static int record__uring_complete(struct io_uring_cqe *cqe)
+{
+	struct mmap *map = io_uring_cqe_get_data(cqe);
+	int res = cqe->res;
+
+	io_uring_cqe_seen(&thread->uring, cqe);
+	thread->uring_inflight--;
+
+	if (res > 0)
+		map->uring.pending -= res;
+
+	if (--map->uring.inflight == 0) {
+		map->core.prev = map->uring.head;
+		perf_mmap__consume(&map->core);
+	}
+	perf_mmap__put(&map->core);
+
+	if (res < 0) {
+		pr_err("failed to write perf data, error: %s\n", strerror(-res));
+		return -1;
+	}
+
+	if (!map->uring.inflight && map->uring.pending) {
+		pr_err("failed to write perf data, short write\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Reap the completed writes of this thread. If @wait, wait for at least one
+ * to complete, if any is queued. Returns the number of writes reaped.
+ */
+static int record__uring_reap(bool wait)
+{
+	struct io_uring_cqe *cqe;
+	int ret, nr = 0;
+
+	while (thread->uring_inflight) {
+		if (wait && !nr)
+			ret = io_uring_wait_cqe(&thread->uring, &cqe);
+		else
+			ret = io_uring_peek_cqe(&thread->uring, &cqe);
+
+		if (ret == -EAGAIN)
+			break;
+		if (ret == -EINTR)
+			continue;
+		if (ret < 0) {
+			pr_err("failed to reap perf data writes, error: %s\n", strerror(-ret));
+			return -1;
+		}
+
+		if (record__uring_complete(cqe) < 0)
+			return -1;
+		nr++;
+	}
+
+	return nr;
+}
+
+static int record__uring_push(struct record *rec, struct mmap *map, bool synch)
+{
+	struct perf_data_file *file = &rec->session->data->file;
+	unsigned char *data = map->core.base + page_size;
+	struct io_uring_sqe *sqe;
+	size_t sizes[2], size = 0;
+	void *bufs[2];
+	int i, nr = 0, rc;
+	off_t off;
+
+	if (map->file)
+		file = map->file;
+
+	if (record__uring_init())
+		return -1;
+
+	if (map->uring.inflight && record__uring_reap(false) < 0)
+		return -1;
+
+	while (synch && map->uring.inflight) {
+		if (record__uring_reap(true) < 0)
+			return -1;
+	}
+
+	if (map->uring.inflight)
+		return 0;
+
+	rc = perf_mmap__read_init(&map->core);
+	if (rc < 0)
+		return (rc == -EAGAIN) ? 1 : -1;
+
+	if ((map->core.start & map->core.mask) + map->core.end - map->core.start !=
+	    (map->core.end & map->core.mask)) {
+		bufs[nr] = &data[map->core.start & map->core.mask];
+		sizes[nr] = map->core.mask + 1 - (map->core.start & map->core.mask);
+		map->core.start += sizes[nr++];
+	}
+
+	if (map->core.end != map->core.start) {
+		bufs[nr] = &data[map->core.start & map->core.mask];
+		sizes[nr] = map->core.end - map->core.start;
+		map->core.start += sizes[nr++];
+	}
+
+	off = lseek(file->fd, 0, SEEK_CUR);
+
+	for (i = 0; i < nr; i++) {
+		sqe = io_uring_get_sqe(&thread->uring);
+		if (!sqe) {
+			pr_err("failed to queue perf data, io_uring is full\n");
+			return -1;
+		}
+
+		io_uring_prep_write(sqe, file->fd, bufs[i], sizes[i], off);
+		io_uring_sqe_set_data(sqe, map);
+		perf_mmap__get(&map->core);
+		map->uring.inflight++;
+		thread->uring_inflight++;
+		off += sizes[i];
+		size += sizes[i];
+	}
+
+	map->uring.head = map->core.end;
+	map->uring.pending = size;
+
+	rc = io_uring_submit(&thread->uring);
+	if (rc < 0) {
+		pr_err("failed to queue perf data, error: %s\n", strerror(-rc));
+		return -1;
+	}
+
+	lseek(file->fd, off, SEEK_SET);
+
+	thread->samples++;
+	record__written(rec, map, size);
+
+	while (synch && map->uring.inflight) {
+		if (record__uring_reap(true) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void record__uring_sync(void)
+{
+	/* Events are synthesized before the record threads are set up */
+	if (!thread)
+		return;
+
+	while (thread->uring_inflight) {
+		if (record__uring_reap(true) < 0)
+			break;
+	}
+}
+
+static void record__uring_exit(void)
+{
+	if (!thread->uring_ready)
+		return;
+
+	record__uring_sync();
+	io_uring_queue_exit(&thread->uring);
+	thread->uring_ready = false;
+}
+#else /* HAVE_LIBURING_SUPPORT */
+static int record__uring_reap(bool wait __maybe_unused)
+{
+	return 0;
+}
+
+static int record__uring_push(struct record *rec __maybe_unused,
+			      struct mmap *map __maybe_unused,
+			      bool synch __maybe_unused)
+{
+	return -1;
+}
+
+static void record__uring_sync(void)
+{
+}
+
+static void record__uring_exit(void)
+{
+}
+#endif
+
+static bool record__uring_enabled(struct record *rec)
+{
+	return rec->opts.uring;
+}
+
 #define MMAP_FLUSH_DEFAULT 1
 static int record__mmap_flush_parse(const struct option *opt,
 				    const char *str,
@@ -1560,7 +1796,14 @@ static int record__mmap_read_evlist(struct record *rec, struct evlist *evlist,
 				flush = map->core.flush;
 				map->core.flush = 1;
 			}
-			if (!record__aio_enabled(rec)) {
+			if (record__uring_enabled(rec) && !overwrite) {
+				if (record__uring_push(rec, map, synch) < 0) {
+					if (synch)
+						map->core.flush = flush;
+					rc = -1;
+					goto out;
+				}
+			} else if (!record__aio_enabled(rec)) {
 				if (perf_mmap__push(map, rec, record__pushfn) < 0) {
 					if (synch)
 						map->core.flush = flush;
@@ -1655,6 +1898,12 @@ static void *record__thread(void *arg)
 			break;
 
 		if (hits == thread->samples) {
+			/*
+			 * Queued writes hold ring buffer space, wait for them
+			 * rather than for the kernel to fill the rest.
+			 */
+			if (record__uring_reap(true) > 0)
+				continue;
 
 			err = fdarray__poll(pollfd, -1);
 			/*
@@ -1681,6 +1930,7 @@ static void *record__thread(void *arg)
 		pollfd->entries[ctlfd_pos].revents = 0;
 	}
 	record__mmap_read_all(thread->rec, true);
+	record__uring_exit();
 
 	err = write(thread->pipes.ack[1], &msg, sizeof(msg));
 	if (err == -1)
@@ -1737,6 +1987,12 @@ record__finish_output(struct record *rec)
 	if (data->is_pipe)
 		return;
 
+	/*
+	 * Writes queued with --uring must land before the data is read back
+	 * for build-ids and the header is rewritten in front of it.
+	 */
+	record__uring_sync();
+
 	rec->session->header.data_size += rec->bytes_written;
 	data->file.size = lseek(perf_data__fd(data), 0, SEEK_CUR);
 	if (record__threads_enabled(rec)) {
@@ -1798,6 +2054,7 @@ record__switch_output(struct record *rec, bool at_exit)
 	char timestamp[] = "InvalidTimestamp";
 
 	record__aio_mmap_read_sync(rec);
+	record__uring_sync();
 
 	write_finished_init(rec, true);
 
@@ -2373,6 +2630,11 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 		return PTR_ERR(session);
 	}
 
+	if (record__uring_enabled(rec) && perf_data__is_pipe(&rec->data)) {
+		pr_err("--uring is not available in pipe mode.\n");
+		return -1;
+	}
+
 	if (record__threads_enabled(rec)) {
 		if (perf_data__is_pipe(&rec->data)) {
 			pr_err("Parallel trace streaming is not available in pipe mode.\n");
@@ -2680,6 +2942,8 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 		if (hits == thread->samples) {
 			if (done || draining)
 				break;
+			if (record__uring_reap(true) > 0)
+				continue;
 			err = fdarray__poll(&thread->pollfd, -1);
 			/*
 			 * Propagate error, only if there's any. Ignore positive
@@ -2768,6 +3032,7 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 out_child:
 	record__stop_threads(rec);
 	record__mmap_read_all(rec, true);
+	record__uring_exit();
 out_free_threads:
 	record__free_thread_data(rec);
 	evlist__finalize_ctlfd(rec->evlist);
@@ -3501,6 +3766,10 @@ static struct option __record_options[] = {
 	OPT_CALLBACK_OPTARG(0, "aio", &record.opts,
 		     &nr_cblocks_default, "n", "Use <n> control blocks in asynchronous trace writing mode (default: 1, max: 4)",
 		     record__aio_parse),
+#endif
+#ifdef HAVE_LIBURING_SUPPORT
+	OPT_BOOLEAN(0, "uring", &record.opts.uring,
+		    "Write trace data with io_uring, straight from the mmaped buffers"),
 #endif
 	OPT_CALLBACK(0, "affinity", &record.opts, "node|cpu",
 		     "Set affinity mask of trace reading thread to NUMA node cpu mask or cpu of processed mmap buffer",
@@ -4048,6 +4317,17 @@ int cmd_record(int argc, const char **argv)
 		}
 	}
 
+	if (record__uring_enabled(rec)) {
+		if (record__aio_enabled(rec)) {
+			pr_err("--uring is mutually exclusive to asynchronous streaming mode (--aio).\n");
+			goto out_opts;
+		}
+		if (rec->opts.comp_level != 0) {
+			pr_err("--uring is mutually exclusive to trace compression (-z).\n");
+			goto out_opts;
+		}
+	}
+
 	if (rec->opts.comp_level != 0) {
 		pr_debug("Compression enabled, disabling build id collection at the end of the session.\n");
 		rec->no_buildid = true;
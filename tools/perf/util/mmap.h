@@ -36,6 +36,13 @@ struct mmap {
 		struct aiocb	 **aiocb;
 		int		 nr_cblocks;
 	} aio;
+#endif
+#ifdef HAVE_LIBURING_SUPPORT
+	struct {
+		u64		 head;
+		u64		 pending;
+		int		 inflight;
+	} uring;
 #endif
 	struct mmap_cpu_mask	affinity_mask;
 	void		*data;
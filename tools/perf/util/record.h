@@ -70,6 +70,7 @@ struct record_opts {
 	clockid_t     clockid;
 	u64	      clockid_res_ns;
 	int	      nr_cblocks;
+	bool	      uring;
 	int	      affinity;
 	int	      mmap_flush;
 	unsigned int  comp_level;
@@ -0,0 +1,240 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Per-IO cost of the block layer, measured against null_blk.
+#
+# Every profile reloads null_blk with its own module parameters and runs
+# the same fio job against it. The CPU time fio spent divided by the IOs
+# null_blk completed gives the cost of an IO in ns, fio's submission and
+# completion latencies are reported next to it. With perf available, the
+# cache misses per IO are shown as well, a cheap hint of cacheline bouncing
+# between the submitting and completing CPUs.
+#
+# Usage: null_blk_bench.sh [-t seconds] [-j jobs] [-d iodepth] [-b bs]
+#                          [-c cgroups] [profile...]
+#
+# Profiles: none irq polled shared-tags mq-deadline kyber cgroups
+# (default: all of them)
+
+ksft_skip=4
+
+RUNTIME=10
+JOBS=$(nproc)
+IODEPTH=32
+BS=4k
+NR_CGROUPS=64
+PROFILES=()
+
+skip() {
+	echo "SKIP: $1"
+	exit $ksft_skip
+}
+
+usage() {
+	sed -n '/^# Usage/,/^# (default/p' "$0" | sed 's/^# \?//'
+	exit 1
+}
+
+while getopts "t:j:d:b:c:h" opt; do
+	case $opt in
+	t) RUNTIME=$OPTARG ;;
+	j) JOBS=$OPTARG ;;
+	d) IODEPTH=$OPTARG ;;
+	b) BS=$OPTARG ;;
+	c) NR_CGROUPS=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+PROFILES=("$@")
+[[ ${#PROFILES[@]} -eq 0 ]] &&
+	PROFILES=(none irq polled shared-tags mq-deadline kyber cgroups)
+
+[[ $(id -u) -eq 0 ]] || skip "must be run as root"
+command -v fio > /dev/null || skip "fio not found"
+modprobe -n null_blk 2> /dev/null || skip "null_blk module not available"
+grep -qw null_blk /proc/modules && skip "null_blk is already loaded"
+
+PERF=$(command -v perf)
+CGROUP2=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+BENCH_CG=
+
+cleanup() {
+	local cg
+
+	if [[ -n $BENCH_CG && -d $BENCH_CG ]]; then
+		for cg in "$BENCH_CG"/cg*; do
+			[[ -d $cg ]] && rmdir "$cg"
+		done
+		rmdir "$BENCH_CG"
+	fi
+	modprobe -r null_blk 2> /dev/null
+}
+trap cleanup EXIT
+
+# load null_blk with the given parameters, the devices are left in $DEVS
+load_null_blk() {
+	local i
+
+	modprobe -r null_blk 2> /dev/null
+	modprobe null_blk queue_mode=2 gb=16 bs=512 hw_queue_depth=128 \
+		submit_queues="$JOBS" "$@" || return 1
+	udevadm settle 2> /dev/null
+
+	DEVS=()
+	for i in /sys/block/nullb*; do
+		DEVS+=("${i##*/}")
+	done
+	[[ ${#DEVS[@]} -gt 0 ]]
+}
+
+set_scheduler() {
+	local dev
+
+	for dev in "${DEVS[@]}"; do
+		echo "$1" > "/sys/block/$dev/queue/scheduler" || return 1
+	done
+}
+
+completed_ios() {
+	local dev sum=0 stat
+
+	for dev in "${DEVS[@]}"; do
+		read -ra stat < "/sys/block/$dev/stat"
+		sum=$((sum + stat[0] + stat[4]))
+	done
+	echo $sum
+}
+
+# mean of the fio json latency block named $1, in ns
+fio_lat_mean() {
+	awk -v key="\"$1\"" '
+		$1 == key { found = 1 }
+		found && $1 == "\"mean\"" { gsub(",", "", $3); print int($3); exit }
+	' "$2"
+}
+
+# run_fio <cgroup or empty> <output> <fio args...>
+run_fio() {
+	local cg=$1 out=$2
+
+	shift 2
+	(
+		[[ -n $cg ]] && echo $BASHPID > "$cg/cgroup.procs"
+		exec fio --name=bench --rw=randread --bs="$BS" \
+			--ioengine=io_uring --direct=1 --iodepth="$IODEPTH" \
+			--time_based --runtime="$RUNTIME" --group_reporting \
+			--output-format=json --output="$out" "$@"
+	)
+}
+
+# run_profile <name> <fio args...>, jobs are spread over the devices and
+# the cgroups in $CGS, if any
+run_profile() {
+	local name=$1 tmp ios usr sys cpu_ns misses=n/a slat clat i n perf_pid
+	local -a pids=() cgs=("${CGS[@]}")
+
+	shift
+	tmp=$(mktemp -d)
+	[[ ${#cgs[@]} -eq 0 ]] && cgs=("")
+
+	# cache misses are counted system wide while fio runs
+	if [[ -n $PERF ]]; then
+		"$PERF" stat -a -x, -e cache-misses -o "$tmp/perf" \
+			sleep "$RUNTIME" 2> /dev/null &
+		perf_pid=$!
+	fi
+
+	ios=$(completed_ios)
+	TIMEFORMAT="%3U %3S"
+	{ time {
+		for ((i = 0; i < JOBS; i++)); do
+			n=$((i % ${#DEVS[@]}))
+			run_fio "${cgs[i % ${#cgs[@]}]}" "$tmp/fio.$i" \
+				--filename="/dev/${DEVS[n]}" "$@" &
+			pids+=($!)
+		done
+		wait "${pids[@]}"
+	} ; } 2> "$tmp/time"
+	ios=$(($(completed_ios) - ios))
+	[[ -n $perf_pid ]] && wait "$perf_pid"
+
+	if [[ $ios -le 0 ]]; then
+		echo "$name: no IO completed"
+		rm -rf "$tmp"
+		return 1
+	fi
+
+	read -r usr sys < "$tmp/time"
+	cpu_ns=$(awk -v u="$usr" -v s="$sys" -v n="$ios" \
+		'BEGIN { printf "%d", (u + s) * 1e9 / n }')
+	slat=$(fio_lat_mean slat_ns "$tmp/fio.0")
+	clat=$(fio_lat_mean clat_ns "$tmp/fio.0")
+	[[ -f $tmp/perf ]] && misses=$(awk -F, -v n="$ios" \
+		'$3 == "cache-misses" { printf "%.2f", $1 / n }' "$tmp/perf")
+
+	printf "%-12s %10d %8.0fk %10s %10s %12s\n" "$name" "$cpu_ns" \
+		"$(awk -v n="$ios" -v t="$RUNTIME" 'BEGIN { print n / t / 1000 }')" \
+		"${slat:-n/a}" "${clat:-n/a}" "${misses:-n/a}"
+	rm -rf "$tmp"
+}
+
+# one cgroup per job at most, a cgroup without a job adds no cost
+setup_cgroups() {
+	local i nr=$((JOBS < NR_CGROUPS ? JOBS : NR_CGROUPS))
+
+	CGS=()
+	[[ -n $CGROUP2 ]] || return 1
+	echo +io > "$CGROUP2/cgroup.subtree_control" 2> /dev/null
+	BENCH_CG=$CGROUP2/null_blk_bench
+	mkdir -p "$BENCH_CG" || return 1
+	# the io controller must be enabled in the parent of the job cgroups
+	echo +io > "$BENCH_CG/cgroup.subtree_control" || return 1
+	for ((i = 0; i < nr; i++)); do
+		mkdir -p "$BENCH_CG/cg$i" || return 1
+		CGS+=("$BENCH_CG/cg$i")
+	done
+}
+
+printf "%-12s %10s %9s %10s %10s %12s\n" profile "cpu-ns/io" iops \
+	"slat-ns" "clat-ns" "misses/io"
+
+for profile in "${PROFILES[@]}"; do
+	CGS=()
+	case $profile in
+	none)
+		load_null_blk irqmode=0 && set_scheduler none &&
+			run_profile "$profile"
+		;;
+	irq)
+		load_null_blk irqmode=1 && set_scheduler none &&
+			run_profile "$profile"
+		;;
+	polled)
+		load_null_blk irqmode=0 poll_queues="$JOBS" &&
+			set_scheduler none &&
+			run_profile "$profile" --hipri
+		;;
+	shared-tags)
+		load_null_blk irqmode=0 shared_tags=1 nr_devices=2 &&
+			set_scheduler none &&
+			run_profile "$profile"
+		;;
+	mq-deadline|kyber)
+		load_null_blk irqmode=0 && set_scheduler "$profile" &&
+			run_profile "$profile"
+		;;
+	cgroups)
+		if ! setup_cgroups; then
+			echo "$profile: cgroup2 not available, skipped"
+			continue
+		fi
+		load_null_blk irqmode=0 && set_scheduler none &&
+			run_profile "$profile"
+		;;
+	*)
+		echo "unknown profile $profile"
+		usage
+		;;
+	esac || echo "$profile: setup failed"
+done
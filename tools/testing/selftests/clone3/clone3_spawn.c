@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Spawns this program again through clone3(CLONE_SPAWN) and checks what
+ * the child finds after the exec.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "../kselftest.h"
+#include "clone3_selftests.h"
+
+#ifndef CLONE_SPAWN
+#define CLONE_SPAWN 0x400000000ULL
+#endif
+
+#ifndef CLONE_SPAWN_SETSID
+#define CLONE_SPAWN_SETSID	0x01
+#define CLONE_SPAWN_SETSIGMASK	0x02
+#endif
+
+struct __clone_args_spawn {
+	struct __clone_args base;
+	__aligned_u64 spawn;
+};
+
+struct __clone_spawn_fd {
+	__s32 fd;
+	__s32 newfd;
+};
+
+struct __clone_spawn_args {
+	__aligned_u64 filename;
+	__aligned_u64 argv;
+	__aligned_u64 envp;
+	__aligned_u64 fds;
+	__aligned_u64 sigmask;
+	__u32 nr_fds;
+	__s32 dirfd;
+	__u32 exec_flags;
+	__u32 flags;
+};
+
+#define CHILD_FD	42
+
+extern char **environ;
+static char *self;
+
+/* What the spawned child does, selected by argv[1] */
+static int spawned_main(int argc, char **argv)
+{
+	sigset_t set;
+
+	if (!strcmp(argv[1], "exit"))
+		return atoi(argv[2]);
+
+	if (!strcmp(argv[1], "write"))
+		return write(CHILD_FD, "ok", 2) == 2 ? 0 : 1;
+
+	if (!strcmp(argv[1], "closed"))
+		return fcntl(CHILD_FD, F_GETFD) < 0 && errno == EBADF ? 0 : 1;
+
+	if (!strcmp(argv[1], "blocked")) {
+		if (sigprocmask(SIG_BLOCK, NULL, &set))
+			return 1;
+		return sigismember(&set, SIGUSR1) ? 0 : 1;
+	}
+
+	if (!strcmp(argv[1], "setsid"))
+		return getsid(0) == getpid() ? 0 : 1;
+
+	return 1;
+}
+
+static pid_t spawn(__u64 flags, int *pidfd, struct __clone_spawn_args *sargs)
+{
+	struct __clone_args_spawn args = {
+		.base = {
+			.flags = CLONE_SPAWN | flags,
+			.pidfd = ptr_to_u64(pidfd),
+			.exit_signal = SIGCHLD,
+		},
+		.spawn = ptr_to_u64(sargs),
+	};
+
+	return sys_clone3(&args.base, sizeof(args));
+}
+
+static pid_t spawn_self(__u64 flags, int *pidfd, const char *what,
+			const char *arg, struct __clone_spawn_args *sargs)
+{
+	char *argv[] = { self, (char *)what, (char *)arg, NULL };
+
+	sargs->filename = ptr_to_u64(self);
+	sargs->argv = ptr_to_u64(argv);
+	sargs->envp = ptr_to_u64(environ);
+	sargs->dirfd = AT_FDCWD;
+	return spawn(flags, pidfd, sargs);
+}
+
+static int wait_for_pid(pid_t pid)
+{
+	int status, ret;
+
+again:
+	ret = waitpid(pid, &status, 0);
+	if (ret == -1) {
+		if (errno == EINTR)
+			goto again;
+
+		return -1;
+	}
+
+	if (!WIFEXITED(status))
+		return -1;
+
+	return WEXITSTATUS(status);
+}
+
+static void test_spawn_supported(void)
+{
+	struct __clone_spawn_args sargs = {};
+	pid_t pid;
+
+	pid = spawn_self(0, NULL, "exit", "0", &sargs);
+	if (pid < 0 && (errno == EINVAL || errno == E2BIG || errno == ENOSYS))
+		ksft_exit_skip("clone3(CLONE_SPAWN) is not supported\n");
+	if (pid < 0 && errno == EPERM)
+		ksft_exit_skip("clone3(CLONE_SPAWN) not allowed under seccomp\n");
+	if (pid < 0)
+		ksft_exit_fail_msg("%s - clone3(CLONE_SPAWN) failed\n",
+				   strerror(errno));
+	wait_for_pid(pid);
+}
+
+static void test_spawn_exit_code(void)
+{
+	struct __clone_spawn_args sargs = {};
+	pid_t pid;
+
+	pid = spawn_self(0, NULL, "exit", "7", &sargs);
+	if (pid < 0) {
+		ksft_test_result_fail("%s - spawn failed\n", strerror(errno));
+		return;
+	}
+	ksft_test_result(wait_for_pid(pid) == 7,
+			 "spawned program runs and exits\n");
+}
+
+static void test_spawn_invalid(void)
+{
+	struct __clone_spawn_args sargs = {};
+	pid_t pid;
+
+	pid = spawn_self(CLONE_VM, NULL, "exit", "0", &sargs);
+	if (pid > 0)
+		wait_for_pid(pid);
+	ksft_test_result(pid < 0 && errno == EINVAL,
+			 "CLONE_SPAWN | CLONE_VM is rejected\n");
+
+	sargs.flags = 1U << 31;
+	pid = spawn_self(0, NULL, "exit", "0", &sargs);
+	if (pid > 0)
+		wait_for_pid(pid);
+	ksft_test_result(pid < 0 && errno == EINVAL,
+			 "unknown spawn flags are rejected\n");
+}
+
+static void test_spawn_enoent(void)
+{
+	struct __clone_spawn_args sargs = {};
+	char *argv[] = { "does-not-exist", NULL };
+	pid_t pid;
+
+	sargs.filename = ptr_to_u64("/does/not/exist");
+	sargs.argv = ptr_to_u64(argv);
+	sargs.envp = ptr_to_u64(environ);
+	sargs.dirfd = AT_FDCWD;
+	pid = spawn(0, NULL, &sargs);
+	if (pid > 0) {
+		wait_for_pid(pid);
+		ksft_test_result_fail("spawning a missing program succeeded\n");
+		return;
+	}
+	if (errno != ENOENT) {
+		ksft_test_result_fail("%s - expected ENOENT\n", strerror(errno));
+		return;
+	}
+	/* The failed child must have been reaped already */
+	ksft_test_result(waitpid(-1, NULL, WNOHANG) < 0 && errno == ECHILD,
+			 "failed exec returns its error and leaves no child\n");
+}
+
+static void test_spawn_fds(void)
+{
+	struct __clone_spawn_args sargs = {};
+	struct __clone_spawn_fd sfd;
+	char buf[3] = {};
+	int pipefd[2];
+	pid_t pid;
+
+	if (pipe2(pipefd, O_CLOEXEC))
+		ksft_exit_fail_msg("%s - pipe2() failed\n", strerror(errno));
+
+	sfd.fd = pipefd[1];
+	sfd.newfd = CHILD_FD;
+	sargs.fds = ptr_to_u64(&sfd);
+	sargs.nr_fds = 1;
+	pid = spawn_self(0, NULL, "write", NULL, &sargs);
+	close(pipefd[1]);
+	if (pid < 0) {
+		ksft_test_result_fail("%s - spawn failed\n", strerror(errno));
+		close(pipefd[0]);
+		return;
+	}
+	ksft_test_result(wait_for_pid(pid) == 0 &&
+			 read(pipefd[0], buf, 2) == 2 && !strcmp(buf, "ok"),
+			 "fd actions duplicate descriptors into the child\n");
+	close(pipefd[0]);
+
+	/* A descriptor without CLOEXEC, closed by a close action */
+	if (dup2(STDERR_FILENO, CHILD_FD) < 0)
+		ksft_exit_fail_msg("%s - dup2() failed\n", strerror(errno));
+	sfd.fd = -1;
+	sfd.newfd = CHILD_FD;
+	pid = spawn_self(0, NULL, "closed", NULL, &sargs);
+	close(CHILD_FD);
+	if (pid < 0) {
+		ksft_test_result_fail("%s - spawn failed\n", strerror(errno));
+		return;
+	}
+	ksft_test_result(wait_for_pid(pid) == 0,
+			 "fd actions close descriptors in the child\n");
+}
+
+static void test_spawn_attrs(void)
+{
+	struct __clone_spawn_args sargs = {};
+	pid_t pid;
+
+	sargs.flags = CLONE_SPAWN_SETSIGMASK;
+	sargs.sigmask = 1ULL << (SIGUSR1 - 1);
+	pid = spawn_self(0, NULL, "blocked", NULL, &sargs);
+	ksft_test_result(pid > 0 && wait_for_pid(pid) == 0,
+			 "CLONE_SPAWN_SETSIGMASK sets the signal mask\n");
+
+	memset(&sargs, 0, sizeof(sargs));
+	sargs.flags = CLONE_SPAWN_SETSID;
+	pid = spawn_self(0, NULL, "setsid", NULL, &sargs);
+	ksft_test_result(pid > 0 && wait_for_pid(pid) == 0,
+			 "CLONE_SPAWN_SETSID starts a new session\n");
+}
+
+static void test_spawn_pidfd(void)
+{
+	struct __clone_spawn_args sargs = {};
+	struct pollfd pfd;
+	int pidfd = -1;
+	pid_t pid;
+
+	pid = spawn_self(CLONE_PIDFD, &pidfd, "exit", "0", &sargs);
+	if (pid < 0) {
+		ksft_test_result_fail("%s - spawn failed\n", strerror(errno));
+		return;
+	}
+	if (pidfd < 0 || !(fcntl(pidfd, F_GETFD) & FD_CLOEXEC)) {
+		wait_for_pid(pid);
+		ksft_test_result_fail("no close-on-exec pidfd returned\n");
+		return;
+	}
+
+	/* A pidfd becomes readable once its process has exited */
+	pfd.fd = pidfd;
+	pfd.events = POLLIN;
+	ksft_test_result(poll(&pfd, 1, 5000) == 1 && wait_for_pid(pid) == 0,
+			 "CLONE_PIDFD returns a pidfd for the child\n");
+	close(pidfd);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+		return spawned_main(argc, argv);
+
+	self = realpath("/proc/self/exe", NULL);
+	if (!self)
+		ksft_exit_fail_msg("%s - realpath() failed\n", strerror(errno));
+
+	ksft_print_header();
+	test_clone3_supported();
+	test_spawn_supported();
+	ksft_set_plan(9);
+
+	test_spawn_exit_code();
+	test_spawn_invalid();
+	test_spawn_enoent();
+	test_spawn_fds();
+	test_spawn_attrs();
+	test_spawn_pidfd();
+
+	ksft_finished();
+}
@@ -9,6 +9,8 @@
 #include <signal.h>
 #include <pthread.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/eventfd.h>
 #include "../../kselftest_harness.h"
@@ -36,6 +38,21 @@ static inline int sys_epoll_pwait2(int fd, struct epoll_event *events,
 		       sigset, sigsetsize);
 }
 
+#ifndef EPIOCSRING
+struct epoll_ring {
+	__u32 head;
+	__u32 resv1[15];
+	__u32 tail;
+	__u32 ring_entries;
+	__u32 flags;
+	__u32 resv2[13];
+	struct epoll_event events[];
+};
+
+#define EPOLL_RING_OVERFLOW	(1U << 0)
+#define EPIOCSRING		_IO(0x8A, 0x01)
+#endif
+
 static void signal_handler(int signum)
 {
 }
@@ -3493,4 +3510,65 @@ TEST(epoll64)
 	close(ctx.sfd[1]);
 }
 
+/*
+ *           e0 (ring)
+ *       (et) /  \ (lt)
+ *          s0    s2
+ */
+TEST(epoll65)
+{
+	int efd;
+	int sfd[4];
+	size_t size;
+	struct epoll_event e;
+	struct epoll_ring *ring;
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, &sfd[0]), 0);
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, &sfd[2]), 0);
+
+	efd = epoll_create(1);
+	ASSERT_GE(efd, 0);
+
+	EXPECT_EQ(mmap(NULL, 4096, PROT_READ, MAP_SHARED, efd, 0), MAP_FAILED);
+	ASSERT_EQ(ioctl(efd, EPIOCSRING, 3), 0);
+	EXPECT_NE(ioctl(efd, EPIOCSRING, 3), 0);
+
+	size = sizeof(*ring) + 4 * sizeof(struct epoll_event);
+	ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, efd, 0);
+	ASSERT_NE(ring, MAP_FAILED);
+	EXPECT_EQ(ring->ring_entries, 4);
+
+	e.events = EPOLLIN | EPOLLET;
+	e.data.u64 = 1;
+	ASSERT_EQ(epoll_ctl(efd, EPOLL_CTL_ADD, sfd[0], &e), 0);
+	e.events = EPOLLIN;
+	e.data.u64 = 2;
+	ASSERT_EQ(epoll_ctl(efd, EPOLL_CTL_ADD, sfd[2], &e), 0);
+
+	/* edge-triggered events show up in the ring without epoll_wait() */
+	ASSERT_EQ(write(sfd[1], "w", 1), 1);
+	ASSERT_EQ(__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE), 1);
+	EXPECT_EQ(ring->events[0].events, EPOLLIN);
+	EXPECT_EQ(ring->events[0].data.u64, 1);
+	__atomic_store_n(&ring->head, 1, __ATOMIC_RELEASE);
+
+	/* level-triggered ones are published by epoll_wait() */
+	ASSERT_EQ(write(sfd[3], "w", 1), 1);
+	EXPECT_EQ(__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE), 1);
+	EXPECT_EQ(epoll_wait(efd, NULL, 4, 0), 1);
+	ASSERT_EQ(__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE), 2);
+	EXPECT_EQ(ring->events[1].events, EPOLLIN);
+	EXPECT_EQ(ring->events[1].data.u64, 2);
+
+	/* unconsumed entries make epoll_wait() return right away */
+	EXPECT_EQ(epoll_wait(efd, NULL, 4, -1), 2);
+
+	munmap(ring, size);
+	close(efd);
+	close(sfd[0]);
+	close(sfd[1]);
+	close(sfd[2]);
+	close(sfd[3]);
+}
+
 TEST_HARNESS_MAIN
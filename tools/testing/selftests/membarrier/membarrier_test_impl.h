@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include "../kselftest.h"
 
@@ -133,6 +134,31 @@ static int test_membarrier_private_expedited_success(void)
 	return 0;
 }
 
+static int test_membarrier_private_expedited_pidfds_success(void)
+{
+	int cmd = MEMBARRIER_CMD_PRIVATE_EXPEDITED,
+	    flags = MEMBARRIER_CMD_FLAG_PIDFDS;
+	const char *test_name = "sys membarrier MEMBARRIER_CMD_PRIVATE_EXPEDITED with pidfds";
+	int pidfds[2];
+
+	pidfds[0] = syscall(__NR_pidfd_open, getpid(), 0);
+	if (pidfds[0] < 0)
+		ksft_exit_fail_msg("pidfd_open() failed, errno = %d\n", errno);
+	pidfds[1] = pidfds[0];
+
+	if (syscall(__NR_membarrier, cmd, flags, 2, pidfds) != 0) {
+		ksft_exit_fail_msg(
+			"%s test: flags = %d, errno = %d\n",
+			test_name, flags, errno);
+	}
+	close(pidfds[0]);
+
+	ksft_test_result_pass(
+		"%s test: flags = %d\n",
+		test_name, flags);
+	return 0;
+}
+
 static int test_membarrier_private_expedited_sync_core_fail(void)
 {
 	int cmd = MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE, flags = 0;
@@ -261,6 +287,9 @@ static int test_membarrier_success(void)
 	if (status)
 		return status;
 	status = test_membarrier_private_expedited_success();
+	if (status)
+		return status;
+	status = test_membarrier_private_expedited_pidfds_success();
 	if (status)
 		return status;
 	status = sys_membarrier(MEMBARRIER_CMD_QUERY, 0);
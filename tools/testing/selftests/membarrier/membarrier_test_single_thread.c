@@ -12,7 +12,7 @@
 int main(int argc, char **argv)
 {
 	ksft_print_header();
-	ksft_set_plan(13);
+	ksft_set_plan(14);
 
 	test_membarrier_query();
 
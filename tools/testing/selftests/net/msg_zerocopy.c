@@ -17,9 +17,16 @@
  * PF_RDS
  * - SOCK_SEQPACKET
  *
+ * PF_UNIX
+ * - SOCK_STREAM
+ *
  * Start this program on two connected hosts, one in send mode and
  * the other with option '-r' to put it in receiver mode.
  *
+ * PF_UNIX runs both ends in one process over a socketpair and receives
+ * with splice(). It verifies that the data parked in the pipe does not
+ * change when the sender reuses its buffer after the completion.
+ *
  * If zerocopy mode ('-z') is enabled, the sender will verify that
  * the kernel queues completions on the error queue for all zerocopy
  * transfers.
@@ -30,6 +37,7 @@
 #include <arpa/inet.h>
 #include <error.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <linux/errqueue.h>
 #include <linux/if_packet.h>
@@ -92,6 +100,7 @@ static struct sockaddr_storage cfg_dst_addr;
 static struct sockaddr_storage cfg_src_addr;
 
 static char payload[IP_MAXPACKET];
+static char rxbuf[IP_MAXPACKET];
 static long packets, bytes, completions, expected_completions;
 static int  zerocopied = -1;
 static uint32_t next_completion;
@@ -417,6 +426,7 @@ static bool do_recv_completion(int fd, int domain)
 		error(1, 0, "cmsg: no cmsg");
 	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
 	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR) ||
+	      (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_ZEROCOPY) ||
 	      (cm->cmsg_level == SOL_PACKET && cm->cmsg_type == PACKET_TX_TIMESTAMP)))
 		error(1, 0, "serr: wrong type: %d.%d",
 		      cm->cmsg_level, cm->cmsg_type);
@@ -673,6 +683,90 @@ static void do_rx(int domain, int type, int protocol)
 	fprintf(stderr, "rx=%lu (%lu MB)\n", packets, bytes >> 20);
 }
 
+static void do_unix_splice(int fd, int pipefd, int len)
+{
+	int ret;
+
+	while (len) {
+		ret = splice(fd, NULL, pipefd, NULL, len, 0);
+		if (ret == -1)
+			error(1, errno, "splice");
+		if (!ret)
+			error(1, 0, "splice: unexpected eof");
+		len -= ret;
+	}
+}
+
+static void do_unix_verify(int pipefd, int len, char expected)
+{
+	int ret, i;
+
+	while (len) {
+		ret = read(pipefd, rxbuf, len);
+		if (ret == -1)
+			error(1, errno, "read pipe");
+		if (!ret)
+			error(1, 0, "read pipe: unexpected eof");
+		for (i = 0; i < ret; i++)
+			if (rxbuf[i] != expected)
+				error(1, 0, "pipe: data changed after completion");
+		len -= ret;
+	}
+}
+
+static void do_unix(void)
+{
+	int fds[2], pipefds[2];
+	uint64_t tstop;
+	long sent;
+	char c;
+
+	if (socketpair(PF_UNIX, SOCK_STREAM, 0, fds))
+		error(1, errno, "socketpair");
+	if (pipe(pipefds))
+		error(1, errno, "pipe");
+	if (fcntl(pipefds[1], F_SETPIPE_SZ, 1 << 20) == -1)
+		error(1, errno, "F_SETPIPE_SZ");
+
+	do_setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, 1 << 21);
+	if (cfg_zerocopy)
+		do_setsockopt(fds[0], SOL_SOCKET, SO_ZEROCOPY, 1);
+
+	tstop = gettimeofday_ms() + cfg_runtime_ms;
+	do {
+		struct iovec iov = { payload, cfg_payload_len };
+		struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+		c = 'a' + (packets % 26);
+		memset(payload, c, cfg_payload_len);
+
+		sent = bytes;
+		if (!do_sendmsg(fds[0], &msg, cfg_zerocopy, PF_UNIX))
+			error(1, 0, "send: socket buffer full");
+		sent = bytes - sent;
+
+		do_unix_splice(fds[1], pipefds[1], sent);
+
+		/* the pipe must hold a copy, so the send is complete now */
+		while (completions < expected_completions) {
+			if (!do_poll(fds[0], POLLERR))
+				error(1, 0, "no completion after splice");
+			do_recv_completions(fds[0], PF_UNIX);
+		}
+
+		memset(payload, '_', cfg_payload_len);
+		do_unix_verify(pipefds[0], sent, c);
+	} while (gettimeofday_ms() < tstop);
+
+	if (close(pipefds[0]) || close(pipefds[1]) ||
+	    close(fds[0]) || close(fds[1]))
+		error(1, errno, "close");
+
+	fprintf(stderr, "tx=%lu (%lu MB) txc=%lu zc=%c\n",
+		packets, bytes >> 20, completions,
+		zerocopied == 1 ? 'y' : 'n');
+}
+
 static void do_test(int domain, int type, int protocol)
 {
 	int i;
@@ -685,7 +779,9 @@ static void do_test(int domain, int type, int protocol)
 	for (i = 0; i < IP_MAXPACKET; i++)
 		payload[i] = 'a' + (i % 26);
 
-	if (cfg_rx)
+	if (domain == PF_UNIX)
+		do_unix();
+	else if (cfg_rx)
 		do_rx(domain, type, protocol);
 	else
 		do_tx(domain, type, protocol);
@@ -770,8 +866,10 @@ static void parse_opts(int argc, char **argv)
 		if (!cfg_rx && !saddr)
 			error(1, 0, "-S <client addr> required for PF_RDS\n");
 	}
-	setup_sockaddr(cfg_family, daddr, &cfg_dst_addr);
-	setup_sockaddr(cfg_family, saddr, &cfg_src_addr);
+	if (strcmp(cfg_test, "unix")) {
+		setup_sockaddr(cfg_family, daddr, &cfg_dst_addr);
+		setup_sockaddr(cfg_family, saddr, &cfg_src_addr);
+	}
 
 	if (cfg_payload_len > max_payload_len)
 		error(1, 0, "-s: payload exceeds max (%d)", max_payload_len);
@@ -804,6 +902,8 @@ int main(int argc, char **argv)
 		do_test(cfg_family, SOCK_DGRAM, 0);
 	else if (!strcmp(cfg_test, "rds"))
 		do_test(PF_RDS, SOCK_SEQPACKET, 0);
+	else if (!strcmp(cfg_test, "unix"))
+		do_test(PF_UNIX, SOCK_STREAM, 0);
 	else
 		error(1, 0, "unknown cfg_test %s", cfg_test);
 
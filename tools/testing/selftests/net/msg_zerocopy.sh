@@ -27,6 +27,8 @@ if [[ "$#" -eq "0" ]]; then
 	$0 6 tcp -t 1
 	$0 4 udp -t 1
 	$0 6 udp -t 1
+	"${BIN}" -t 1 unix
+	"${BIN}" -t 1 -z unix
 	echo "OK. All tests passed"
 	exit 0
 fi
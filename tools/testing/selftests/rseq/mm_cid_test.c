@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: LGPL-2.1
+/*
+ * Concurrency ID (rseq mm_cid) test.
+ *
+ * Threads of one process running at the same time on different CPUs get
+ * distinct IDs below the number of running threads, and the IDs of CPUs
+ * which stopped running the process are reclaimed, so a thread starting
+ * on yet another CPU gets a low ID again.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/auxv.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+#include "rseq.h"
+
+#ifndef AT_RSEQ_FEATURE_SIZE
+#define AT_RSEQ_FEATURE_SIZE	27
+#endif
+
+#define MAX_THREADS		4
+/* Several times the kernel's reclaim delay of 100ms */
+#define RECLAIM_WAIT_MS		500
+
+struct thread_arg {
+	int cpu;
+	int cid;
+	int err;
+};
+
+static int cpus[CPU_SETSIZE];
+static int nr_started, nr_threads, stop;
+
+static int pin_self(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void *cid_thread(void *p)
+{
+	struct thread_arg *arg = p;
+
+	if (pin_self(arg->cpu) || rseq_register_current_thread()) {
+		arg->err = errno;
+		__atomic_add_fetch(&nr_started, 1, __ATOMIC_SEQ_CST);
+		return NULL;
+	}
+
+	/* Sample once every thread is up and running on its own CPU */
+	__atomic_add_fetch(&nr_started, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&nr_started, __ATOMIC_SEQ_CST) < nr_threads)
+		;
+	arg->cid = rseq_current_mm_cid();
+	while (!__atomic_load_n(&stop, __ATOMIC_SEQ_CST))
+		;
+
+	rseq_unregister_current_thread();
+	return NULL;
+}
+
+static int run_threads(struct thread_arg *args, int nr)
+{
+	pthread_t threads[MAX_THREADS];
+	int i, ret;
+
+	nr_started = 0;
+	nr_threads = nr;
+	stop = 0;
+	for (i = 0; i < nr; i++) {
+		ret = pthread_create(&threads[i], NULL, cid_thread, &args[i]);
+		if (ret) {
+			errno = ret;
+			ksft_exit_fail_msg("pthread_create: %s\n",
+					   strerror(errno));
+		}
+	}
+	while (__atomic_load_n(&nr_started, __ATOMIC_SEQ_CST) < nr)
+		;
+	/* Let the last one to start take its sample */
+	usleep(10000);
+	__atomic_store_n(&stop, 1, __ATOMIC_SEQ_CST);
+	for (i = 0; i < nr; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < nr; i++)
+		if (args[i].err)
+			return -args[i].err;
+	return 0;
+}
+
+static void spin_ms(long ms)
+{
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ((now.tv_sec - start.tv_sec) * 1000 +
+		 (now.tv_nsec - start.tv_nsec) / 1000000 < ms);
+}
+
+static void test_mm_cid_compact(int nr)
+{
+	struct thread_arg args[MAX_THREADS];
+	int i, j, main_cid;
+
+	memset(args, 0, sizeof(args));
+	for (i = 0; i < nr; i++)
+		args[i].cpu = cpus[i + 1];
+	if (run_threads(args, nr))
+		ksft_exit_fail_msg("thread setup failed\n");
+
+	main_cid = rseq_current_mm_cid();
+	for (i = 0; i < nr; i++) {
+		if (args[i].cid < 0 || args[i].cid > nr ||
+		    args[i].cid == main_cid)
+			goto fail;
+		for (j = 0; j < i; j++)
+			if (args[i].cid == args[j].cid)
+				goto fail;
+	}
+	ksft_test_result_pass("%d running threads get distinct IDs up to %d\n",
+			      nr + 1, nr);
+	return;
+fail:
+	ksft_test_result_fail("thread on cpu %d got ID %d (main %d, %d threads)\n",
+			      args[i].cpu, args[i].cid, main_cid, nr + 1);
+}
+
+static void test_mm_cid_reclaim(int nr)
+{
+	struct thread_arg arg = { .cpu = cpus[nr + 1] };
+
+	/*
+	 * The CPUs used by the previous test don't run the process anymore.
+	 * Keep running so that the scheduler tick finds the process and
+	 * gives their IDs back.
+	 */
+	spin_ms(RECLAIM_WAIT_MS);
+
+	if (run_threads(&arg, 1))
+		ksft_exit_fail_msg("thread setup failed\n");
+	if (arg.cid < 0 || arg.cid > 1)
+		ksft_test_result_fail("thread on an unused cpu got ID %d\n",
+				      arg.cid);
+	else
+		ksft_test_result_pass("IDs of idle cpus are reclaimed\n");
+}
+
+int main(int argc, char **argv)
+{
+	cpu_set_t affinity;
+	int i, nr_cpus = 0, nr;
+
+	ksft_print_header();
+	ksft_set_plan(2);
+
+	if (rseq_register_current_thread())
+		ksft_exit_fail_msg("rseq_register_current_thread: %s\n",
+				   strerror(errno));
+	if (getauxval(AT_RSEQ_FEATURE_SIZE) < offsetof(struct rseq_abi, end))
+		ksft_exit_skip("rseq mm_cid is not supported\n");
+
+	sched_getaffinity(0, sizeof(affinity), &affinity);
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &affinity))
+			cpus[nr_cpus++] = i;
+	/* main, the threads, and one more cpu for the reclaim test */
+	if (nr_cpus < 3)
+		ksft_exit_skip("needs at least 3 cpus\n");
+	nr = nr_cpus - 2 < MAX_THREADS ? nr_cpus - 2 : MAX_THREADS;
+
+	if (pin_self(cpus[0]))
+		ksft_exit_fail_msg("sched_setaffinity: %s\n", strerror(errno));
+
+	test_mm_cid_compact(nr);
+	test_mm_cid_reclaim(nr);
+
+	rseq_unregister_current_thread();
+	ksft_finished();
+}
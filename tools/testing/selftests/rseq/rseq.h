@@ -153,6 +153,15 @@ static inline uint32_t rseq_current_cpu(void)
 	return cpu;
 }
 
+/*
+ * Concurrency ID of the current thread within its memory map, only valid
+ * when the kernel reports a feature size covering the mm_cid field.
+ */
+static inline uint32_t rseq_current_mm_cid(void)
+{
+	return RSEQ_ACCESS_ONCE(rseq_get_abi()->mm_cid);
+}
+
 static inline void rseq_clear_rseq_cs(void)
 {
 	RSEQ_WRITE_ONCE(rseq_get_abi()->rseq_cs.arch.ptr, 0);
@@ -294,6 +294,78 @@ TEST_F(user, write_events) {
 	ASSERT_NE(-1, writev(self->data_fd, (const struct iovec *)io, 3));
 	after = trace_bytes();
 	ASSERT_GT(after, before);
+
+	/* Write should report the whole buffer, including the index */
+	ASSERT_EQ(sizeof(reg.write_index) + sizeof(field1) + sizeof(field2),
+		  writev(self->data_fd, (const struct iovec *)io, 3));
+}
+
+TEST_F(user, write_batch) {
+	struct user_reg reg = {0};
+	struct user_batch batch = {0};
+	struct user_batch_entry *entry;
+	__u64 data[9] = {0};
+	__u32 *fields;
+	int before = 0, after = 0;
+	int i;
+
+	reg.size = sizeof(reg);
+	reg.name_args = (__u64)"__test_event u32 field1; u32 field2";
+
+	/* Register should work */
+	ASSERT_EQ(0, ioctl(self->data_fd, DIAG_IOCSREG, &reg));
+
+	/* Three entries of header and two fields, each 8 byte aligned */
+	for (i = 0; i < 3; i++) {
+		entry = (struct user_batch_entry *)&data[i * 3];
+		entry->size = 2 * sizeof(__u32);
+		entry->write_index = reg.write_index;
+		fields = (__u32 *)&data[i * 3 + 1];
+		fields[0] = i;
+		fields[1] = i + 1;
+	}
+
+	batch.size = sizeof(batch);
+	batch.data = (__u64)data;
+	batch.data_len = 3 * 3 * sizeof(__u64);
+
+	/* Enable event */
+	self->enable_fd = open(enable_file, O_RDWR);
+	ASSERT_NE(-1, write(self->enable_fd, "1", sizeof("1")))
+
+	/* Batch should commit every entry to the ftrace buffers */
+	before = trace_bytes();
+	ASSERT_EQ(0, ioctl(self->data_fd, DIAG_IOCSBATCH, &batch));
+	ASSERT_EQ(3, batch.committed);
+	after = trace_bytes();
+	ASSERT_GT(after, before);
+
+	/* Unknown flags should fail with EINVAL */
+	batch.flags = 1;
+	ASSERT_EQ(-1, ioctl(self->data_fd, DIAG_IOCSBATCH, &batch));
+	ASSERT_EQ(EINVAL, errno);
+	batch.flags = 0;
+
+	/* Invalid index should stop the batch there with ENOENT */
+	entry = (struct user_batch_entry *)&data[3];
+	entry->write_index = reg.write_index + 1;
+	batch.committed = 0;
+	ASSERT_EQ(-1, ioctl(self->data_fd, DIAG_IOCSBATCH, &batch));
+	ASSERT_EQ(ENOENT, errno);
+	ASSERT_EQ(1, batch.committed);
+	entry->write_index = reg.write_index;
+
+	/* Entry larger than the remaining data should fail with EINVAL */
+	entry = (struct user_batch_entry *)&data[6];
+	entry->size = 3 * sizeof(__u64);
+	ASSERT_EQ(-1, ioctl(self->data_fd, DIAG_IOCSBATCH, &batch));
+	ASSERT_EQ(EINVAL, errno);
+	ASSERT_EQ(2, batch.committed);
+
+	/* Empty batch should commit nothing */
+	batch.data_len = 0;
+	ASSERT_EQ(0, ioctl(self->data_fd, DIAG_IOCSBATCH, &batch));
+	ASSERT_EQ(0, batch.committed);
 }
 
 TEST_F(user, write_fault) {
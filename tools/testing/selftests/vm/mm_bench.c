@@ -0,0 +1,652 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Microbenchmarks for mm hot paths.
+ *
+ * Each benchmark prints one line per configuration in "key=value" form,
+ * so results can be collected with a plain grep/awk and compared across
+ * kernels.  The reported figure is the median of the requested number
+ * of runs; min and max are printed alongside to show the spread.
+ *
+ *   fault    anonymous write faults, per base page and with THP
+ *   gup      GUP-fast, pin-fast and longterm pin rates (needs gup_test)
+ *   migrate  move_pages() bandwidth between the first two NUMA nodes
+ *   reclaim  proactive reclaim (memory.reclaim) throughput and scan/steal
+ *   mmap     page faults racing mmap()/munmap() at N threads
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <mm/gup_test.h>
+
+#define MB			(1UL << 20)
+#define GUP_TEST_FILE		"/sys/kernel/debug/gup_test"
+#define MAX_RUNS		64
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE		(1 << 1)
+#endif
+
+static unsigned long size = 256 * MB;
+static unsigned long pagesize;
+static int runs = 5;
+static int nr_threads = 4;
+static int duration_ms = 1000;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sort @v in place and print median/min/max under @key. */
+static void report(const char *key, double *v, int n)
+{
+	qsort(v, n, sizeof(*v), cmp_double);
+	printf(" %s=%.1f %s_min=%.1f %s_max=%.1f",
+	       key, v[n / 2], key, v[0], key, v[n - 1]);
+}
+
+static void *map_anon(unsigned long len, int advice)
+{
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (p == MAP_FAILED)
+		return NULL;
+	if (advice >= 0)
+		madvise(p, len, advice);
+	return p;
+}
+
+static void touch(char *p, unsigned long len)
+{
+	unsigned long off;
+
+	for (off = 0; off < len; off += pagesize)
+		p[off] = 1;
+}
+
+static void bench_fault_one(const char *name, int advice)
+{
+	double rate[MAX_RUNS], bw[MAX_RUNS];
+	int i;
+
+	for (i = 0; i < runs; i++) {
+		char *p = map_anon(size, advice);
+		double t;
+
+		if (!p) {
+			printf("bench=fault folio=%s skip=mmap\n", name);
+			return;
+		}
+		t = now();
+		touch(p, size);
+		t = now() - t;
+		munmap(p, size);
+
+		rate[i] = size / pagesize / t;
+		bw[i] = size / MB / t;
+	}
+
+	printf("bench=fault folio=%s size_mb=%lu", name, size / MB);
+	report("pages_per_sec", rate, runs);
+	report("mb_per_sec", bw, runs);
+	printf("\n");
+}
+
+static void bench_fault(void)
+{
+	bench_fault_one("base", MADV_NOHUGEPAGE);
+	bench_fault_one("thp", MADV_HUGEPAGE);
+}
+
+static void bench_gup_one(int fd, const char *name, const char *folio,
+			  unsigned long cmd, char *p, unsigned int nr_per_call)
+{
+	double get[MAX_RUNS], put[MAX_RUNS];
+	struct gup_test gup;
+	int i;
+
+	for (i = 0; i < runs; i++) {
+		memset(&gup, 0, sizeof(gup));
+		gup.addr = (unsigned long)p;
+		gup.size = size;
+		gup.nr_pages_per_call = nr_per_call;
+		gup.gup_flags = 0x1;	/* FOLL_WRITE */
+		if (ioctl(fd, cmd, &gup)) {
+			printf("bench=gup op=%s folio=%s skip=%s\n", name,
+			       folio, strerror(errno));
+			return;
+		}
+		/* pages per microsecond -> pages per second */
+		get[i] = size / pagesize * 1e6 /
+			 (gup.get_delta_usec ? gup.get_delta_usec : 1);
+		put[i] = size / pagesize * 1e6 /
+			 (gup.put_delta_usec ? gup.put_delta_usec : 1);
+	}
+
+	printf("bench=gup op=%s folio=%s size_mb=%lu batch=%u", name, folio,
+	       size / MB, nr_per_call);
+	report("get_pages_per_sec", get, runs);
+	report("put_pages_per_sec", put, runs);
+	printf("\n");
+}
+
+static void bench_gup(void)
+{
+	static const struct {
+		const char *name;
+		unsigned long cmd;
+	} ops[] = {
+		{ "gup_fast", GUP_FAST_BENCHMARK },
+		{ "pin_fast", PIN_FAST_BENCHMARK },
+		{ "pin_longterm", PIN_LONGTERM_BENCHMARK },
+	};
+	static const int advice[] = { MADV_NOHUGEPAGE, MADV_HUGEPAGE };
+	int fd, a, i;
+
+	fd = open(GUP_TEST_FILE, O_RDWR);
+	if (fd < 0) {
+		printf("bench=gup skip=%s\n", strerror(errno));
+		return;
+	}
+
+	for (a = 0; a < 2; a++) {
+		char *p = map_anon(size, advice[a]);
+
+		if (!p)
+			continue;
+		touch(p, size);
+		for (i = 0; i < 3; i++)
+			bench_gup_one(fd, ops[i].name, a ? "thp" : "base",
+				      ops[i].cmd, p, 512);
+		munmap(p, size);
+	}
+	close(fd);
+}
+
+static void bench_migrate(void)
+{
+	unsigned long nr = size / pagesize, i;
+	double bw[MAX_RUNS];
+	int *nodes, *status;
+	void **pages;
+	char *p;
+	int r;
+
+	if (access("/sys/devices/system/node/node1", F_OK)) {
+		printf("bench=migrate skip=single_node\n");
+		return;
+	}
+
+	p = map_anon(size, MADV_NOHUGEPAGE);
+	pages = calloc(nr, sizeof(*pages));
+	nodes = calloc(nr, sizeof(*nodes));
+	status = calloc(nr, sizeof(*status));
+	if (!p || !pages || !nodes || !status) {
+		printf("bench=migrate skip=nomem\n");
+		goto out;
+	}
+	touch(p, size);
+	for (i = 0; i < nr; i++)
+		pages[i] = p + i * pagesize;
+
+	for (r = 0; r < runs; r++) {
+		double t;
+
+		/* Alternate direction so every run moves every page. */
+		for (i = 0; i < nr; i++)
+			nodes[i] = !(r & 1);
+		t = now();
+		if (syscall(SYS_move_pages, 0, nr, pages, nodes, status,
+			    MPOL_MF_MOVE) < 0) {
+			printf("bench=migrate skip=%s\n", strerror(errno));
+			goto out;
+		}
+		t = now() - t;
+		bw[r] = size / MB / t;
+	}
+
+	printf("bench=migrate size_mb=%lu", size / MB);
+	report("mb_per_sec", bw, runs);
+	printf("\n");
+out:
+	free(status);
+	free(nodes);
+	free(pages);
+	if (p)
+		munmap(p, size);
+}
+
+/* Read one counter from the memory.stat file of cgroup @cg. */
+static unsigned long memcg_stat(const char *cg, const char *key)
+{
+	unsigned long val, ret = 0;
+	char path[PATH_MAX], name[64];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/memory.stat", cg);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %lu", name, &val) == 2) {
+		if (!strcmp(name, key)) {
+			ret = val;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+static int open_file(const char *dir, const char *file, int flags)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	return open(path, flags);
+}
+
+static int write_file(const char *dir, const char *file, const char *buf)
+{
+	int fd, ret = 0;
+
+	fd = open_file(dir, file, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, buf, strlen(buf)) < 0)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+/* Path of the cgroup v2 group we are running in. */
+static int cgroup_self(char *path, size_t len)
+{
+	char line[512];
+	int ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/cgroup", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "0::", 3))
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		snprintf(path, len, "/sys/fs/cgroup%s", line + 3);
+		ret = 0;
+		break;
+	}
+	fclose(f);
+	if (ret)
+		errno = ENOENT;
+	return ret;
+}
+
+static bool have_swap(void)
+{
+	unsigned long val;
+	char line[128];
+	bool ret = false;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return false;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "SwapTotal: %lu", &val) == 1) {
+			ret = val != 0;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+static int lru_gen_enabled(void)
+{
+	unsigned int val = 0;
+	FILE *f;
+
+	f = fopen("/sys/kernel/mm/lru_gen/enabled", "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%x", &val) != 1)
+		val = 0;
+	fclose(f);
+	return val != 0;
+}
+
+/* Whether the memory controller is enabled for the children of @cg. */
+static bool memcg_delegated(const char *cg)
+{
+	char buf[256] = "";
+	int fd;
+
+	fd = open_file(cg, "cgroup.subtree_control", O_RDONLY);
+	if (fd < 0)
+		return false;
+	if (read(fd, buf, sizeof(buf) - 1) < 0)
+		buf[0] = '\0';
+	close(fd);
+	return strstr(buf, "memory") != NULL;
+}
+
+/*
+ * Runs in its own cgroup, so that memory.reclaim only has the benchmark's
+ * anonymous memory to work on and the scan and steal counts from
+ * memory.stat are not mixed up with the rest of the system.
+ */
+static void reclaim_child(const char *cg)
+{
+	double bw[MAX_RUNS], eff[MAX_RUNS];
+	char req[32];
+	int fd, r;
+
+	snprintf(req, sizeof(req), "%d", getpid());
+	if (write_file(cg, "cgroup.procs", req)) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		return;
+	}
+
+	fd = open_file(cg, "memory.reclaim", O_WRONLY);
+	if (fd < 0) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		return;
+	}
+	snprintf(req, sizeof(req), "%lu", size);
+
+	for (r = 0; r < runs; r++) {
+		unsigned long scan, steal;
+		char *p = map_anon(size, MADV_NOHUGEPAGE);
+		double t;
+
+		if (!p) {
+			printf("bench=reclaim skip=mmap\n");
+			goto out;
+		}
+		touch(p, size);
+
+		scan = memcg_stat(cg, "pgscan");
+		steal = memcg_stat(cg, "pgsteal");
+		t = now();
+		/* EAGAIN only means less than @size could be reclaimed. */
+		if (write(fd, req, strlen(req)) < 0 && errno != EAGAIN) {
+			printf("bench=reclaim skip=%s\n", strerror(errno));
+			munmap(p, size);
+			goto out;
+		}
+		t = now() - t;
+		scan = memcg_stat(cg, "pgscan") - scan;
+		steal = memcg_stat(cg, "pgsteal") - steal;
+		munmap(p, size);
+
+		bw[r] = (double)steal * pagesize / MB / t;
+		eff[r] = scan ? 100.0 * steal / scan : 0;
+	}
+
+	printf("bench=reclaim size_mb=%lu lru_gen=%d", size / MB,
+	       lru_gen_enabled());
+	report("reclaimed_mb_per_sec", bw, runs);
+	report("steal_pct", eff, runs);
+	printf("\n");
+out:
+	close(fd);
+}
+
+/*
+ * A cgroup with processes in it can't enable controllers for its children,
+ * so the benchmark moves out of the way first:
+ *
+ *   <parent>/mm_bench.<pid>/ctl      the benchmark process while it waits
+ *   <parent>/mm_bench.<pid>/reclaim  the measured child
+ */
+static void bench_reclaim(void)
+{
+	/* Leave room for the names appended below and by open_file(). */
+	char parent[PATH_MAX - 128], top[PATH_MAX - 96];
+	char ctl[PATH_MAX - 64], cg[PATH_MAX - 64];
+	bool parent_memcg;
+	char req[32];
+	pid_t pid;
+
+	/* Without swap there is nothing to reclaim anonymous memory to. */
+	if (!have_swap()) {
+		printf("bench=reclaim skip=noswap\n");
+		return;
+	}
+	if (cgroup_self(parent, sizeof(parent))) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		return;
+	}
+	snprintf(top, sizeof(top), "%s/mm_bench.%d", parent, getpid());
+	snprintf(ctl, sizeof(ctl), "%s/ctl", top);
+	snprintf(cg, sizeof(cg), "%s/reclaim", top);
+	if (mkdir(top, 0755)) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		return;
+	}
+	if (mkdir(ctl, 0755) || mkdir(cg, 0755)) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		goto out_rmdir;
+	}
+	snprintf(req, sizeof(req), "%d", getpid());
+	if (write_file(ctl, "cgroup.procs", req)) {
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+		goto out_rmdir;
+	}
+
+	/*
+	 * @parent may only be able to delegate the controller now that we
+	 * left it.  This can still fail, e.g. when other tasks live in
+	 * @parent; the child then has no memory.reclaim and reports the skip.
+	 */
+	parent_memcg = memcg_delegated(parent);
+	if (!parent_memcg)
+		write_file(parent, "cgroup.subtree_control", "+memory");
+	write_file(top, "cgroup.subtree_control", "+memory");
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		reclaim_child(cg);
+		fflush(stdout);
+		_exit(0);
+	}
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+	else
+		printf("bench=reclaim skip=%s\n", strerror(errno));
+
+	/* Undo the delegation, or @parent can't take us back. */
+	write_file(top, "cgroup.subtree_control", "-memory");
+	if (!parent_memcg)
+		write_file(parent, "cgroup.subtree_control", "-memory");
+	write_file(parent, "cgroup.procs", req);
+out_rmdir:
+	rmdir(cg);
+	rmdir(ctl);
+	rmdir(top);
+}
+
+struct mmap_worker {
+	pthread_t thread;
+	bool mapper;
+	unsigned long ops;
+};
+
+static volatile bool stop;
+
+/*
+ * Faulting threads keep refaulting a private region (zapped with
+ * MADV_DONTNEED) while mapper threads churn mmap()/munmap(), so the
+ * fault path competes with writers for mmap_lock.
+ */
+static void *mmap_worker(void *arg)
+{
+	struct mmap_worker *w = arg;
+	unsigned long len = 64 * pagesize;
+	char *p = NULL;
+
+	if (!w->mapper) {
+		p = map_anon(len, MADV_NOHUGEPAGE);
+		if (!p)
+			return NULL;
+	}
+
+	while (!stop) {
+		if (w->mapper) {
+			p = map_anon(len, -1);
+			if (p) {
+				p[0] = 1;
+				munmap(p, len);
+			}
+		} else {
+			touch(p, len);
+			madvise(p, len, MADV_DONTNEED);
+		}
+		w->ops++;
+	}
+
+	if (!w->mapper)
+		munmap(p, len);
+	return NULL;
+}
+
+static void bench_mmap(void)
+{
+	double rate[MAX_RUNS], maps[MAX_RUNS];
+	struct mmap_worker *w;
+	int r, i;
+
+	w = calloc(nr_threads, sizeof(*w));
+	if (!w) {
+		printf("bench=mmap skip=nomem\n");
+		return;
+	}
+
+	for (r = 0; r < runs; r++) {
+		unsigned long faults = 0, mapops = 0;
+		double t;
+
+		stop = false;
+		for (i = 0; i < nr_threads; i++) {
+			w[i].mapper = nr_threads > 1 && (i & 1);
+			w[i].ops = 0;
+			pthread_create(&w[i].thread, NULL, mmap_worker, &w[i]);
+		}
+		t = now();
+		usleep(duration_ms * 1000);
+		stop = true;
+		for (i = 0; i < nr_threads; i++) {
+			pthread_join(w[i].thread, NULL);
+			if (w[i].mapper)
+				mapops += w[i].ops;
+			else
+				faults += w[i].ops * 64;
+		}
+		t = now() - t;
+
+		rate[r] = faults / t;
+		maps[r] = mapops / t;
+	}
+
+	printf("bench=mmap threads=%d", nr_threads);
+	report("faults_per_sec", rate, runs);
+	report("mmap_munmap_per_sec", maps, runs);
+	printf("\n");
+	free(w);
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} benches[] = {
+	{ "fault", bench_fault },
+	{ "gup", bench_gup },
+	{ "migrate", bench_migrate },
+	{ "reclaim", bench_reclaim },
+	{ "mmap", bench_mmap },
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b bench] [-m size_mb] [-r runs] [-t threads] [-d duration_ms]\n"
+		"  bench: fault, gup, migrate, reclaim, mmap (default: all)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *which = NULL;
+	bool found = false;
+	unsigned int i;
+	int opt;
+
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	while ((opt = getopt(argc, argv, "b:m:r:t:d:h")) != -1) {
+		switch (opt) {
+		case 'b':
+			which = optarg;
+			break;
+		case 'm':
+			size = strtoul(optarg, NULL, 0) * MB;
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'd':
+			duration_ms = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!size || runs < 1 || runs > MAX_RUNS || nr_threads < 1 ||
+	    duration_ms < 1)
+		usage(argv[0]);
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		if (which && strcmp(which, benches[i].name))
+			continue;
+		found = true;
+		benches[i].fn();
+		fflush(stdout);
+	}
+
+	if (!found)
+		usage(argv[0]);
+	return 0;
+}
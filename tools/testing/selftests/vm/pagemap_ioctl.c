@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * PAGEMAP_SCAN ioctl tests: argument checking, category masks, merging
+ * of adjacent pages, resuming an early stop from walk_end, and clearing
+ * soft-dirty on the reported pages.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fs.h>
+#include "../kselftest.h"
+#include "vm_util.h"
+
+#define PAGEMAP_FILE_PATH	"/proc/self/pagemap"
+#define NR_PAGES		16
+
+static int pagemap_fd;
+static unsigned long page_size;
+
+static long pagemap_scan(char *start, char *end, struct page_region *vec,
+			 unsigned long vec_len, unsigned long flags,
+			 unsigned long max_pages, unsigned long inverted,
+			 unsigned long mask, unsigned long anyof,
+			 unsigned long return_mask, unsigned long *walk_end)
+{
+	struct pm_scan_arg arg = {
+		.size = sizeof(arg),
+		.flags = flags,
+		.start = (unsigned long)start,
+		.end = (unsigned long)end,
+		.vec = (unsigned long)vec,
+		.vec_len = vec_len,
+		.max_pages = max_pages,
+		.category_inverted = inverted,
+		.category_mask = mask,
+		.category_anyof_mask = anyof,
+		.return_mask = return_mask,
+	};
+	long ret;
+
+	ret = ioctl(pagemap_fd, PAGEMAP_SCAN, &arg);
+	if (walk_end)
+		*walk_end = arg.walk_end;
+	return ret;
+}
+
+static char *map_pages(void)
+{
+	char *map;
+
+	map = mmap(NULL, NR_PAGES * page_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		ksft_exit_fail_msg("mmap failed\n");
+	/* Keep the layout in small pages so every pte is looked at. */
+	madvise(map, NR_PAGES * page_size, MADV_NOHUGEPAGE);
+	return map;
+}
+
+static bool region_is(struct page_region *r, char *start, unsigned long nr,
+		      unsigned long categories)
+{
+	return r->start == (unsigned long)start &&
+	       r->end == (unsigned long)start + nr * page_size &&
+	       r->categories == categories;
+}
+
+static void test_invalid_args(void)
+{
+	struct page_region vec[1];
+	struct pm_scan_arg arg = {};
+	char *map = map_pages();
+	char *end = map + NR_PAGES * page_size;
+
+	arg.size = sizeof(arg) - 1;
+	arg.start = (unsigned long)map;
+	arg.end = (unsigned long)end;
+	ksft_test_result(ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) < 0 &&
+			 errno == EINVAL, "wrong arg size is rejected\n");
+
+	ksft_test_result(pagemap_scan(map, end, vec, 1, 1UL << 63, 0, 0, 0, 0,
+				      PAGE_IS_PRESENT, NULL) < 0 &&
+			 errno == EINVAL, "unknown flags are rejected\n");
+
+	ksft_test_result(pagemap_scan(map, end, vec, 1, 0, 0, 0, 1UL << 63, 0,
+				      PAGE_IS_PRESENT, NULL) < 0 &&
+			 errno == EINVAL, "unknown categories are rejected\n");
+
+	ksft_test_result(pagemap_scan(map + 1, end, vec, 1, 0, 0, 0, 0, 0,
+				      PAGE_IS_PRESENT, NULL) < 0 &&
+			 errno == EINVAL, "unaligned start is rejected\n");
+
+	ksft_test_result(pagemap_scan(end, map, vec, 1, 0, 0, 0, 0, 0,
+				      PAGE_IS_PRESENT, NULL) < 0 &&
+			 errno == EINVAL, "end below start is rejected\n");
+
+	ksft_test_result(pagemap_scan(map, end, NULL, 1, 0, 0, 0, 0, 0,
+				      PAGE_IS_PRESENT, NULL) < 0 &&
+			 errno == EINVAL, "vec_len without vec is rejected\n");
+
+	munmap(map, NR_PAGES * page_size);
+}
+
+static void test_category_masks(void)
+{
+	struct page_region vec[NR_PAGES];
+	char *map = map_pages();
+	char *end = map + NR_PAGES * page_size;
+	bool ok;
+	long ret;
+	int i;
+
+	for (i = 0; i < NR_PAGES; i += 2)
+		map[i * page_size] = 1;
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT, NULL);
+	ok = ret == NR_PAGES / 2;
+	for (i = 0; ok && i < ret; i++)
+		ok = region_is(&vec[i], map + 2 * i * page_size, 1,
+			       PAGE_IS_PRESENT);
+	ksft_test_result(ok, "category_mask reports only present pages\n");
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, PAGE_IS_PRESENT,
+			   PAGE_IS_PRESENT, 0, PAGE_IS_PRESENT, NULL);
+	ok = ret == NR_PAGES / 2;
+	for (i = 0; ok && i < ret; i++)
+		ok = region_is(&vec[i], map + (2 * i + 1) * page_size, 1, 0);
+	ksft_test_result(ok, "category_inverted reports the other pages\n");
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0, 0,
+			   PAGE_IS_PRESENT | PAGE_IS_SWAPPED, PAGE_IS_PRESENT,
+			   NULL);
+	ok = ret == NR_PAGES / 2;
+	for (i = 0; ok && i < ret; i++)
+		ok = region_is(&vec[i], map + 2 * i * page_size, 1,
+			       PAGE_IS_PRESENT);
+	ksft_test_result(ok, "category_anyof_mask needs one matching category\n");
+
+	munmap(map, NR_PAGES * page_size);
+}
+
+static void test_merging(void)
+{
+	struct page_region vec[NR_PAGES];
+	char *map = map_pages();
+	char *end = map + NR_PAGES * page_size;
+	bool ok;
+	long ret;
+	int i;
+
+	/* Even pages map the zero page, odd pages get their own page. */
+	for (i = 0; i < NR_PAGES; i++) {
+		if (i % 2)
+			map[i * page_size] = 1;
+		else
+			(void)*(volatile char *)&map[i * page_size];
+	}
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT, NULL);
+	ksft_test_result(ret == 1 &&
+			 region_is(&vec[0], map, NR_PAGES, PAGE_IS_PRESENT),
+			 "pages with equal reported categories merge\n");
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT | PAGE_IS_PFNZERO, NULL);
+	ok = ret == NR_PAGES;
+	for (i = 0; ok && i < ret; i++)
+		ok = region_is(&vec[i], map + i * page_size, 1, i % 2 ?
+			       PAGE_IS_PRESENT :
+			       PAGE_IS_PRESENT | PAGE_IS_PFNZERO);
+	ksft_test_result(ok, "pages with other categories do not merge\n");
+
+	munmap(map, NR_PAGES * page_size);
+}
+
+static void test_resume(void)
+{
+	struct page_region vec[NR_PAGES];
+	char *map = map_pages();
+	char *end = map + NR_PAGES * page_size;
+	unsigned long walk_end;
+	bool ok;
+	long ret;
+	int i;
+
+	memset(map, 1, NR_PAGES * page_size);
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 3, 0, PAGE_IS_PRESENT,
+			   0, PAGE_IS_PRESENT, &walk_end);
+	ok = ret == 1 && region_is(&vec[0], map, 3, PAGE_IS_PRESENT) &&
+	     walk_end == (unsigned long)map + 3 * page_size;
+	ret = pagemap_scan((char *)walk_end, end, vec, NR_PAGES, 0, 0, 0,
+			   PAGE_IS_PRESENT, 0, PAGE_IS_PRESENT, &walk_end);
+	ok = ok && ret == 1 &&
+	     region_is(&vec[0], map + 3 * page_size, NR_PAGES - 3,
+		       PAGE_IS_PRESENT) &&
+	     walk_end == (unsigned long)end;
+	ksft_test_result(ok, "max_pages stops at walk_end and resumes\n");
+
+	/* Alternate pages so that every region is a single page. */
+	for (i = 1; i < NR_PAGES; i += 2)
+		madvise(map + i * page_size, page_size, MADV_DONTNEED);
+
+	ret = pagemap_scan(map, end, vec, 2, 0, 0, 0, PAGE_IS_PRESENT, 0,
+			   PAGE_IS_PRESENT, &walk_end);
+	ok = ret == 2 && region_is(&vec[0], map, 1, PAGE_IS_PRESENT) &&
+	     region_is(&vec[1], map + 2 * page_size, 1, PAGE_IS_PRESENT) &&
+	     walk_end == (unsigned long)map + 4 * page_size;
+	ret = pagemap_scan((char *)walk_end, end, vec, NR_PAGES, 0, 0, 0,
+			   PAGE_IS_PRESENT, 0, PAGE_IS_PRESENT, &walk_end);
+	ok = ok && ret == NR_PAGES / 2 - 2 &&
+	     region_is(&vec[0], map + 4 * page_size, 1, PAGE_IS_PRESENT) &&
+	     walk_end == (unsigned long)end;
+	ksft_test_result(ok, "full vec stops at walk_end and resumes\n");
+
+	munmap(map, NR_PAGES * page_size);
+}
+
+static void test_clear_soft_dirty(void)
+{
+	struct page_region vec[NR_PAGES];
+	char *map = map_pages();
+	char *end = map + NR_PAGES * page_size;
+	long ret;
+	bool ok;
+
+	/* A new VMA is soft-dirty as a whole; start from a clean state. */
+	clear_softdirty();
+	memset(map, 1, NR_PAGES * page_size);
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, PM_SCAN_CLEAR_SOFT_DIRTY,
+			   0, 0, PAGE_IS_SOFT_DIRTY, 0, PAGE_IS_SOFT_DIRTY,
+			   NULL);
+	if (ret < 0 && errno == EOPNOTSUPP) {
+		ksft_test_result_skip("soft-dirty tracking is not supported\n");
+		munmap(map, NR_PAGES * page_size);
+		return;
+	}
+	ok = ret == 1 &&
+	     region_is(&vec[0], map, NR_PAGES, PAGE_IS_SOFT_DIRTY);
+
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0,
+			   PAGE_IS_SOFT_DIRTY, 0, PAGE_IS_SOFT_DIRTY, NULL);
+	ok = ok && ret == 0;
+
+	map[5 * page_size] = 2;
+	ret = pagemap_scan(map, end, vec, NR_PAGES, 0, 0, 0,
+			   PAGE_IS_SOFT_DIRTY, 0, PAGE_IS_SOFT_DIRTY, NULL);
+	ok = ok && ret == 1 &&
+	     region_is(&vec[0], map + 5 * page_size, 1, PAGE_IS_SOFT_DIRTY);
+	ksft_test_result(ok, "PM_SCAN_CLEAR_SOFT_DIRTY clears reported pages\n");
+
+	munmap(map, NR_PAGES * page_size);
+}
+
+int main(void)
+{
+	struct pm_scan_arg arg = { .size = sizeof(arg) };
+
+	ksft_print_header();
+
+	page_size = getpagesize();
+	pagemap_fd = open(PAGEMAP_FILE_PATH, O_RDONLY);
+	if (pagemap_fd < 0)
+		ksft_exit_fail_msg("Failed to open %s\n", PAGEMAP_FILE_PATH);
+
+	/* An empty range is a cheap way to find out whether the ioctl exists. */
+	if (ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) < 0 && errno == ENOTTY)
+		ksft_exit_skip("PAGEMAP_SCAN is not supported\n");
+
+	ksft_set_plan(14);
+
+	test_invalid_args();
+	test_category_masks();
+	test_merging();
+	test_resume();
+	test_clear_soft_dirty();
+
+	close(pagemap_fd);
+	ksft_finished();
+}
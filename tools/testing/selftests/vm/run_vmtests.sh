@@ -267,6 +267,7 @@ then
 fi
 
 CATEGORY="soft_dirty" run_test ./soft-dirty
+CATEGORY="soft_dirty" run_test ./pagemap_ioctl
 
 # COW tests
 CATEGORY="cow" run_test ./cow